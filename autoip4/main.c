@@ -26,6 +26,8 @@
 #include <wicked/wireless.h>
 #include <wicked/objectmodel.h>
 #include "autoip4/autoip.h"
+#include "appconfig.h"
+#include "netshare.h"
 
 enum {
 	OPT_HELP,
@@ -179,6 +181,8 @@ main(int argc, char **argv)
 	if (ni_init("auto4") < 0)
 		return NI_LSB_RC_ERROR;
 
+	ni_trace_ring_open(program_name);
+
 	autoip4_supplicant();
 	return NI_LSB_RC_SUCCESS;
 }
@@ -257,6 +261,7 @@ autoip4_register_services(ni_dbus_server_t *server)
 
 	/* Register the root object /org/opensuse/Network/AUTO4 */
 	ni_dbus_object_register_service(root_object, &__wicked_dbus_autoip4_interface);
+	ni_dbus_object_register_service(root_object, &ni_objectmodel_metrics_service);
 
 	/* Register /org/opensuse/Network/AUTO4/Interface */
 	object = ni_dbus_server_register_object(server, "Interface", &ni_dbus_anonymous_class, NULL);
@@ -382,6 +387,10 @@ autoip4_discover_devices(ni_dbus_server_t *server)
 	/* Disable wireless AP scanning */
 	ni_wireless_set_scanning(FALSE);
 
+	/* use the wickedd netconfig state when it provides it */
+	if (ni_config_rtnl_event_shared_state())
+		ni_netshare_client_open();
+
 	if (!(nc = ni_global_state_handle(1)))
 		ni_fatal("cannot refresh interface list!");
 
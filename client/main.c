@@ -182,6 +182,8 @@ main(int argc, char **argv)
 				"  iaid        <action> ...\n"
 				"  duid        <action> ...\n"
 				"  arp         <action> ...\n"
+				"  stats       [options] [daemon ...]\n"
+				"  trace       [options] [daemon ...]\n"
 				"\n"
 				, program);
 			goto done;
@@ -330,6 +332,12 @@ main(int argc, char **argv)
 	} else
 	if (!strcmp(cmd, "ethtool")) {
 		status = ni_do_ethtool(program, argc - optind, argv + optind);
+	} else
+	if (!strcmp(cmd, "stats")) {
+		status = ni_do_stats(program, argc - optind, argv + optind);
+	} else
+	if (!strcmp(cmd, "trace")) {
+		status = ni_do_trace(program, argc - optind, argv + optind);
 	} else {
 		fprintf(stderr, "Unsupported command %s\n", cmd);
 		goto usage;
@@ -880,18 +888,76 @@ do_show_config(int argc, char **argv, const char *root_schema)
  * element with a "family" attribute of "ipv4", and within that,
  * any <ip> elements. For each of these, it obtains the address
  * and prefix attribute, and prints it separated by a slash.
+ *
+ * With --state, the expressions are evaluated by wickedd against
+ * the interface state, as shown by "wicked show-xml", and only the
+ * expanded strings are transferred:
+ *
+ * wicked xpath --state \
+ *	--reference "/object/interface" \
+ *	'%{name} %{index}'
  */
+static int
+do_xpath_state(const char *reference, int argc, char **argv)
+{
+	ni_dbus_object_t *list_object;
+	DBusError error = DBUS_ERROR_INIT;
+	unsigned int n;
+
+	ni_objectmodel_init(NULL);
+	if (!(list_object = ni_call_get_netif_list_object()))
+		return 1;
+
+	while (optind < argc) {
+		const char *expression = argv[optind++];
+		ni_dbus_variant_t arg = NI_DBUS_VARIANT_INIT;
+		ni_dbus_variant_t res = NI_DBUS_VARIANT_INIT;
+
+		ni_dbus_variant_init_dict(&arg);
+		ni_dbus_dict_add_string(&arg, "format", expression);
+		if (reference)
+			ni_dbus_dict_add_string(&arg, "reference", reference);
+
+		if (!ni_dbus_object_call_variant(list_object, NULL, "query",
+					1, &arg, 1, &res, &error)) {
+			ni_dbus_print_error(&error, "%s.query(%s): failed",
+					list_object->path, expression);
+			dbus_error_free(&error);
+			ni_dbus_variant_destroy(&arg);
+			return 1;
+		}
+
+		if (!ni_dbus_variant_is_string_array(&res)) {
+			fprintf(stderr, "%s.query(%s): unexpected result\n",
+					list_object->path, expression);
+			ni_dbus_variant_destroy(&arg);
+			ni_dbus_variant_destroy(&res);
+			return 1;
+		}
+
+		for (n = 0; n < res.array.len; ++n)
+			printf("%s\n", res.string_array_value[n]);
+
+		ni_dbus_variant_destroy(&arg);
+		ni_dbus_variant_destroy(&res);
+	}
+
+	return 0;
+}
+
 int
 do_xpath(int argc, char **argv)
 {
-	enum { OPT_HELP, OPT_REFERENCE, OPT_FILE };
+	enum { OPT_HELP, OPT_REFERENCE, OPT_FILE, OPT_STATE };
 	static struct option xpath_options[] = {
 		{ "help", no_argument, NULL, OPT_HELP },
 		{ "reference", required_argument, NULL, OPT_REFERENCE },
 		{ "file", required_argument, NULL, OPT_FILE },
+		{ "state", no_argument, NULL, OPT_STATE },
 		{ NULL }
 	};
 	const char *opt_reference = NULL, *opt_file = "-";
+	ni_bool_t opt_state = FALSE;
 	xpath_result_t *input;
 	xml_document_t *doc;
 	int c;
@@ -907,11 +973,15 @@ do_xpath(int argc, char **argv)
 			opt_file = optarg;
 			break;
 
+		case OPT_STATE:
+			opt_state = TRUE;
+			break;
+
 		case OPT_HELP:
 		default:
 usage:
 			fprintf(stderr,
-				"wicked [options] xpath [--reference <expr>] [--file <path>] expr ...\n");
+				"wicked [options] xpath [--reference <expr>] [--file <path>|--state] expr ...\n");
 			return 1;
 		}
 	}
@@ -921,6 +991,9 @@ usage:
 		goto usage;
 	}
 
+	if (opt_state)
+		return do_xpath_state(opt_reference, argc, argv);
+
 	/* FIXME:
 		An invalid expression blocks the command to return in a read()
 		call. Need a further check to validate given expression in
@@ -29,5 +29,7 @@ extern int	ni_do_test(const char *caller, int argc, char **argv);
 extern int	ni_do_duid(const char *caller, int argc, char **argv);
 extern int	ni_do_iaid(const char *caller, int argc, char **argv);
 extern int	ni_do_ethtool(const char *caller, int argc, char **argv);
+extern int	ni_do_stats(const char *caller, int argc, char **argv);
+extern int	ni_do_trace(const char *caller, int argc, char **argv);
 
 #endif /* WICKED_CLIENT_MAIN_H */
@@ -29,6 +29,7 @@
 #include <wicked/logging.h>
 #include <wicked/xml.h>
 #include <wicked/fsm.h>
+#include <wicked/resolver.h>
 
 #include "wicked-client.h"
 
@@ -40,34 +41,55 @@ typedef struct ni_reachability_check {
 	char *			hostname;
 	int			family;
 
+	ni_bool_t		resolving;
 	ni_bool_t		address_valid;
 	ni_sockaddr_t		address;
 } ni_reachability_check_t;
 
 
+/*
+ * The hostname lookup runs in the background of the fsm event loop,
+ * which schedules the workers again when it completed; the check is
+ * polling the result meanwhile and does not block the other workers.
+ */
 static ni_bool_t
 ni_fsm_require_check_reachable(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_require_t *req)
 {
 	ni_reachability_check_t *check = req->user_data;
 
-	/* Do not check too often. If the dhcp or routing info didn't change,
-	 * there is no point wasting time on another lookup. */
-	if (req->event_seq == fsm->last_event_seq[NI_EVENT_ADDRESS_ACQUIRED]) {
-		ni_debug_application("check reachability: %s SKIP", check->hostname);
-		return FALSE;
+	if (!check->resolving) {
+		/* Do not check too often. If the dhcp or routing info didn't change,
+		 * there is no point wasting time on another lookup. */
+		if (req->event_seq == fsm->last_event_seq[NI_EVENT_ADDRESS_ACQUIRED]) {
+			ni_debug_application("check reachability: %s SKIP", check->hostname);
+			return FALSE;
+		}
+		/* Force another lookup if the resolver was updated in the meantime */
+		if (req->event_seq < fsm->last_event_seq[NI_EVENT_RESOLVER_UPDATED]) {
+			ni_resolve_hostname_async_flush(check->hostname, check->family);
+			check->address_valid = FALSE;
+		}
+		req->event_seq = fsm->event_seq;
 	}
-	/* Force another lookup if the resolver was updated in the meantime */
-	if (req->event_seq < fsm->last_event_seq[NI_EVENT_RESOLVER_UPDATED])
-		check->address_valid = FALSE;
-	req->event_seq = fsm->event_seq;
-
-	if (!check->address_valid
-	 && ni_resolve_hostname_timed(check->hostname, check->family, &check->address, 1) <= 0) {
-		ni_debug_application("check reachability: %s not resolvable", check->hostname);
-		return FALSE;
+
+	if (!check->address_valid) {
+		switch (ni_resolve_hostname_async(check->hostname, check->family, &check->address)) {
+		case 0:
+			ni_debug_application("check reachability: %s resolving", check->hostname);
+			check->resolving = TRUE;
+			return FALSE;
+		case 1:
+			check->resolving = FALSE;
+			break;
+		default:
+			ni_debug_application("check reachability: %s not resolvable", check->hostname);
+			check->resolving = FALSE;
+			return FALSE;
+		}
 	}
 	check->address_valid = TRUE;
 
+	/* a connect on an udp socket is a route lookup, it does not block */
 	if (ni_host_is_reachable(check->hostname, &check->address) <= 0) {
 		ni_debug_application("check reachability: %s not reachable at %s",
 				check->hostname, ni_sockaddr_print(&check->address));
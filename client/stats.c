@@ -0,0 +1,441 @@
+/*
+ *	wicked client stats command
+ *
+ *	Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <wicked/types.h>
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/dbus.h>
+#include <wicked/dbus-errors.h>
+#include <wicked/objectmodel.h>
+#include "dbus-common.h"
+#include "main.h"
+
+typedef struct ni_stats_daemon {
+	const char *		name;
+	const char *		bus_name;
+	const char *		path;
+} ni_stats_daemon_t;
+
+static const ni_stats_daemon_t	ni_stats_daemons[] = {
+	{ "wickedd",	NI_OBJECTMODEL_DBUS_BUS_NAME,		NI_OBJECTMODEL_OBJECT_PATH		},
+	{ "nanny",	NI_OBJECTMODEL_DBUS_BUS_NAME_NANNY,	NI_OBJECTMODEL_NANNY_PATH		},
+	{ "dhcp4",	NI_OBJECTMODEL_DBUS_BUS_NAME_DHCP4,	NI_OBJECTMODEL_OBJECT_ROOT "/DHCP4"	},
+	{ "dhcp6",	NI_OBJECTMODEL_DBUS_BUS_NAME_DHCP6,	NI_OBJECTMODEL_OBJECT_ROOT "/DHCP6"	},
+	{ "auto4",	NI_OBJECTMODEL_DBUS_BUS_NAME_AUTO4,	NI_OBJECTMODEL_OBJECT_ROOT "/AUTO4"	},
+	{ NULL }
+};
+
+static const ni_stats_daemon_t *
+ni_stats_daemon_by_name(const char *name)
+{
+	const ni_stats_daemon_t *daemon;
+
+	for (daemon = ni_stats_daemons; daemon->name; ++daemon) {
+		if (ni_string_eq(daemon->name, name))
+			return daemon;
+	}
+	return NULL;
+}
+
+/*
+ * Call a method without starting a daemon that is not running
+ */
+static ni_dbus_message_t *
+ni_stats_call(ni_dbus_client_t *client, const char *path, const char *interface,
+		const char *method, const char *arg, DBusError *error)
+{
+	ni_dbus_message_t *call, *reply;
+	ni_dbus_object_t *proxy;
+
+	proxy = ni_dbus_client_object_new(client, &ni_dbus_anonymous_class,
+					path, interface, NULL);
+	if (!proxy)
+		return NULL;
+
+	call = ni_dbus_object_call_new(proxy, method, 0);
+	ni_dbus_object_free(proxy);
+	if (!call)
+		return NULL;
+
+	dbus_message_set_auto_start(call, FALSE);
+	if (arg)
+		ni_dbus_message_append_string(call, arg);
+
+	reply = ni_dbus_client_call(client, call, error);
+	dbus_message_unref(call);
+	return reply;
+}
+
+/*
+ * The upper bound in usec of the bucket containing the given
+ * percentile of the calls, the maximum for the last bucket.
+ */
+static uint64_t
+ni_stats_percentile(const ni_dbus_variant_t *histogram, uint64_t count,
+		uint64_t max, unsigned int percent)
+{
+	const ni_dbus_variant_t *entry;
+	uint64_t want, seen = 0, value, bound;
+	unsigned int i;
+	const char *key;
+
+	if (!histogram)
+		return max;
+
+	want = (count * percent + 99) / 100;
+	for (i = 0; (entry = ni_dbus_dict_get_entry(histogram, i, &key)); ++i) {
+		if (!ni_dbus_variant_get_uint64(entry, &value))
+			continue;
+
+		seen += value;
+		if (seen < want)
+			continue;
+
+		if (ni_parse_uint64(key, &bound, 10) < 0 || bound > max)
+			return max;
+		return bound;
+	}
+	return max;
+}
+
+static void
+ni_stats_print_histogram(const ni_dbus_variant_t *histogram)
+{
+	const ni_dbus_variant_t *entry;
+	uint64_t value;
+	unsigned int i;
+	const char *key;
+
+	for (i = 0; (entry = ni_dbus_dict_get_entry(histogram, i, &key)); ++i) {
+		if (!ni_dbus_variant_get_uint64(entry, &value))
+			continue;
+
+		if (ni_string_eq(key, "inf"))
+			printf("      %10s    %12llu\n", "more", (unsigned long long)value);
+		else
+			printf("      < %8sus %12llu\n", key, (unsigned long long)value);
+	}
+}
+
+static void
+ni_stats_print(const ni_stats_daemon_t *daemon, const ni_dbus_variant_t *dict,
+		ni_bool_t histograms)
+{
+	const ni_dbus_variant_t *handlers, *handler, *histogram;
+	uint64_t since = 0, count, failed, total, max;
+	unsigned int i;
+	const char *name;
+	char buf[64];
+
+	ni_dbus_dict_get_uint64(dict, "since", &since);
+	if (since) {
+		time_t t = since;
+
+		strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+		printf("%s (since %s):\n", daemon->name, buf);
+	} else {
+		printf("%s:\n", daemon->name);
+	}
+
+	if (!(handlers = ni_dbus_dict_get(dict, "handlers")) ||
+	    ni_dbus_dict_is_empty(handlers)) {
+		printf("  no handler calls recorded\n");
+		return;
+	}
+
+	printf("  %-52s %10s %8s %8s %8s %8s %10s\n", "handler", "count", "failed",
+			"avg-us", "p50-us", "p99-us", "max-us");
+
+	for (i = 0; (handler = ni_dbus_dict_get_entry(handlers, i, &name)); ++i) {
+		count = failed = total = max = 0;
+		ni_dbus_dict_get_uint64(handler, "count", &count);
+		ni_dbus_dict_get_uint64(handler, "failed", &failed);
+		ni_dbus_dict_get_uint64(handler, "total-usec", &total);
+		ni_dbus_dict_get_uint64(handler, "max-usec", &max);
+		if (!count)
+			continue;
+
+		histogram = ni_dbus_dict_get(handler, "histogram");
+		printf("  %-52s %10llu %8llu %8llu %8llu %8llu %10llu\n", name,
+				(unsigned long long)count,
+				(unsigned long long)failed,
+				(unsigned long long)(total / count),
+				(unsigned long long)ni_stats_percentile(histogram, count, max, 50),
+				(unsigned long long)ni_stats_percentile(histogram, count, max, 99),
+				(unsigned long long)max);
+
+		if (histograms && histogram)
+			ni_stats_print_histogram(histogram);
+	}
+}
+
+/*
+ * The growth per hour of a sample value between the oldest and the
+ * newest sample; FALSE when there are no two samples to compare.
+ */
+static ni_bool_t
+ni_stats_memory_trend(const ni_dbus_variant_t *samples, const char *dict_name,
+		const char *key, double *trend)
+{
+	const ni_dbus_variant_t *first, *last;
+	uint64_t t0 = 0, t1 = 0, v0 = 0, v1 = 0;
+
+	if (!samples || samples->array.len < 2)
+		return FALSE;
+
+	first = &samples->variant_array_value[0];
+	last = &samples->variant_array_value[samples->array.len - 1];
+	if (!ni_dbus_dict_get_uint64(first, "time", &t0) ||
+	    !ni_dbus_dict_get_uint64(last, "time", &t1) || t1 <= t0)
+		return FALSE;
+
+	if (dict_name) {
+		if (!(first = ni_dbus_dict_get(first, dict_name)) ||
+		    !(last = ni_dbus_dict_get(last, dict_name)))
+			return FALSE;
+	}
+	if (!ni_dbus_dict_get_uint64(first, key, &v0) ||
+	    !ni_dbus_dict_get_uint64(last, key, &v1))
+		return FALSE;
+
+	*trend = ((double)v1 - (double)v0) * 3600 / (t1 - t0);
+	return TRUE;
+}
+
+static void
+ni_stats_print_memory(const ni_stats_daemon_t *daemon, const ni_dbus_variant_t *dict)
+{
+	const ni_dbus_variant_t *memory, *tags, *tag, *heap, *samples;
+	uint64_t objects, bytes, allocs, frees, arena = 0, mmap = 0, in_use = 0, since = 0;
+	unsigned int i;
+	const char *name;
+	double trend;
+	char buf[64];
+
+	printf("%s:\n", daemon->name);
+	if (!(memory = ni_dbus_dict_get(dict, "memory"))) {
+		printf("  no memory accounting available\n");
+		return;
+	}
+
+	samples = ni_dbus_dict_get(memory, "samples");
+	if (samples && !ni_dbus_variant_is_dict_array(samples))
+		samples = NULL;
+
+	printf("  %-16s %10s %12s %12s %12s %14s\n", "tag", "objects", "bytes",
+			"allocs", "frees", "bytes/hour");
+	tags = ni_dbus_dict_get(memory, "tags");
+	for (i = 0; tags && (tag = ni_dbus_dict_get_entry(tags, i, &name)); ++i) {
+		objects = bytes = allocs = frees = 0;
+		ni_dbus_dict_get_uint64(tag, "objects", &objects);
+		ni_dbus_dict_get_uint64(tag, "bytes", &bytes);
+		ni_dbus_dict_get_uint64(tag, "allocs", &allocs);
+		ni_dbus_dict_get_uint64(tag, "frees", &frees);
+
+		if (ni_stats_memory_trend(samples, "bytes", name, &trend))
+			snprintf(buf, sizeof(buf), "%+.0f", trend);
+		else
+			snprintf(buf, sizeof(buf), "-");
+		printf("  %-16s %10llu %12llu %12llu %12llu %14s\n", name,
+				(unsigned long long)objects,
+				(unsigned long long)bytes,
+				(unsigned long long)allocs,
+				(unsigned long long)frees, buf);
+	}
+
+	if ((heap = ni_dbus_dict_get(memory, "heap"))) {
+		ni_dbus_dict_get_uint64(heap, "arena", &arena);
+		ni_dbus_dict_get_uint64(heap, "mmap", &mmap);
+		ni_dbus_dict_get_uint64(heap, "in-use", &in_use);
+		printf("  heap: %llu bytes in use, %llu bytes arena, %llu bytes mmap\n",
+				(unsigned long long)in_use,
+				(unsigned long long)arena,
+				(unsigned long long)mmap);
+	}
+
+	if (ni_stats_memory_trend(samples, NULL, "heap-in-use", &trend) &&
+	    ni_dbus_dict_get_uint64(&samples->variant_array_value[0], "time", &since)) {
+		time_t t = since;
+
+		strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t));
+		printf("  heap trend: %+.0f bytes/hour over %u samples since %s\n",
+				trend, samples->array.len, buf);
+	}
+}
+
+static int
+ni_stats_daemon(const ni_stats_daemon_t *daemon, ni_bool_t histograms, ni_bool_t reset,
+		ni_bool_t memory)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	DBusError error = DBUS_ERROR_INIT;
+	ni_dbus_message_t *reply = NULL;
+	ni_dbus_client_t *client;
+	int status = NI_WICKED_RC_ERROR;
+
+	if (!(client = ni_create_dbus_client(daemon->bus_name))) {
+		ni_error("%s: unable to connect to dbus service %s",
+				daemon->name, daemon->bus_name);
+		return status;
+	}
+
+	if (reset) {
+		reply = ni_stats_call(client, daemon->path,
+				NI_OBJECTMODEL_METRICS_INTERFACE, "reset", NULL, &error);
+	} else {
+		reply = ni_stats_call(client, daemon->path,
+				NI_DBUS_INTERFACE ".Properties", "GetAll",
+				NI_OBJECTMODEL_METRICS_INTERFACE, &error);
+	}
+
+	if (!reply) {
+		if (dbus_error_has_name(&error, DBUS_ERROR_SERVICE_UNKNOWN)) {
+			printf("%s: not running\n", daemon->name);
+			status = NI_WICKED_RC_SUCCESS;
+		} else {
+			ni_dbus_print_error(&error, "%s: unable to %s metrics",
+					daemon->name, reset ? "reset" : "get");
+		}
+		goto cleanup;
+	}
+
+	if (reset) {
+		printf("%s: metrics reset\n", daemon->name);
+		status = NI_WICKED_RC_SUCCESS;
+		goto cleanup;
+	}
+
+	if (ni_dbus_message_get_args_variants(reply, &result, 1) != 1 ||
+	    !ni_dbus_variant_is_dict(&result)) {
+		ni_error("%s: unable to parse metrics reply", daemon->name);
+		goto cleanup;
+	}
+
+	if (memory)
+		ni_stats_print_memory(daemon, &result);
+	else
+		ni_stats_print(daemon, &result, histograms);
+	status = NI_WICKED_RC_SUCCESS;
+
+cleanup:
+	ni_dbus_variant_destroy(&result);
+	if (reply)
+		dbus_message_unref(reply);
+	dbus_error_free(&error);
+	ni_dbus_client_free(client);
+	return status;
+}
+
+int
+ni_do_stats(const char *caller, int argc, char **argv)
+{
+	enum {	OPT_HELP = 'h', OPT_HISTOGRAM = 'H', OPT_RESET = 'r', OPT_MEMORY = 'm' };
+	static struct option	options[] = {
+		{ "help",	no_argument,		NULL,	OPT_HELP	},
+		{ "histogram",	no_argument,		NULL,	OPT_HISTOGRAM	},
+		{ "reset",	no_argument,		NULL,	OPT_RESET	},
+		{ "memory",	no_argument,		NULL,	OPT_MEMORY	},
+		{ NULL,		no_argument,		NULL,	0		}
+	};
+	int opt = 0, status = NI_WICKED_RC_USAGE, ret, i;
+	const ni_stats_daemon_t *daemon;
+	ni_bool_t histograms = FALSE;
+	ni_bool_t reset = FALSE;
+	ni_bool_t memory = FALSE;
+	char *program = NULL;
+
+	ni_string_printf(&program, "%s %s", caller  ? caller  : "wicked",
+					    argv[0] ? argv[0] : "stats");
+
+	optind = 1;
+	argv[0] = program;
+	while ((opt = getopt_long(argc, argv, "+hHrm", options, NULL)) != EOF) {
+		switch (opt) {
+		case OPT_HISTOGRAM:
+			histograms = TRUE;
+			break;
+
+		case OPT_RESET:
+			reset = TRUE;
+			break;
+
+		case OPT_MEMORY:
+			memory = TRUE;
+			break;
+
+		case OPT_HELP:
+			status = NI_WICKED_RC_SUCCESS;
+			/* fall through */
+		default:
+		usage:
+			fprintf(stderr,
+				"\nUsage:\n"
+				"  %s [options] [daemon ...]\n"
+				"\n"
+				"Show the handler latency metrics of the wicked daemons:\n"
+				"  wickedd, nanny, dhcp4, dhcp6, auto4 (default: all)\n"
+				"\n"
+				"Options:\n"
+				"  --help, -h           show this help text and exit.\n"
+				"  --histogram, -H      show the latency histogram of each handler\n"
+				"  --reset, -r          reset the metrics instead of showing them\n"
+				"  --memory, -m         show the memory accounting instead\n"
+				"\n", argv[0]);
+			goto cleanup;
+		}
+	}
+
+	for (i = optind; i < argc; ++i) {
+		if (!ni_stats_daemon_by_name(argv[i])) {
+			fprintf(stderr, "%s: unknown daemon '%s'\n", program, argv[i]);
+			status = NI_WICKED_RC_USAGE;
+			goto usage;
+		}
+	}
+
+	status = NI_WICKED_RC_SUCCESS;
+	if (optind < argc) {
+		for (; optind < argc; ++optind) {
+			daemon = ni_stats_daemon_by_name(argv[optind]);
+			if ((ret = ni_stats_daemon(daemon, histograms, reset, memory)))
+				status = ret;
+		}
+	} else {
+		for (daemon = ni_stats_daemons; daemon->name; ++daemon) {
+			if ((ret = ni_stats_daemon(daemon, histograms, reset, memory)))
+				status = ret;
+		}
+	}
+
+cleanup:
+	argv[0] = NULL;
+	ni_string_free(&program);
+	return status;
+}
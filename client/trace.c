@@ -0,0 +1,269 @@
+/*
+ *	wicked client trace command
+ *
+ *	Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include <wicked/types.h>
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include "trace-ring.h"
+#include "main.h"
+
+typedef struct ni_trace_daemon {
+	const char *		name;
+	const char *		program;
+} ni_trace_daemon_t;
+
+static const ni_trace_daemon_t	ni_trace_daemons[] = {
+	{ "wickedd",	"wickedd"		},
+	{ "nanny",	"wickedd-nanny"		},
+	{ "dhcp4",	"wickedd-dhcp4"		},
+	{ "dhcp6",	"wickedd-dhcp6"		},
+	{ "auto4",	"wickedd-auto4"		},
+	{ NULL }
+};
+
+/*
+ * A daemon name as accepted by wicked stats, its program name
+ * or the path of a ring file.
+ */
+static const char *
+ni_trace_ring_file(const char *name, ni_bool_t old)
+{
+	static char path[PATH_MAX];
+	const ni_trace_daemon_t *daemon;
+	const char *program = name;
+
+	if (strchr(name, '/'))
+		return name;
+
+	for (daemon = ni_trace_daemons; daemon->name; ++daemon) {
+		if (ni_string_eq(daemon->name, name)) {
+			program = daemon->program;
+			break;
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/%s%s", ni_config_statedir(), program,
+			old ? NI_TRACE_RING_OLD_SUFFIX : NI_TRACE_RING_SUFFIX);
+	return path;
+}
+
+static void
+ni_trace_print_info(const char *path)
+{
+	ni_trace_ring_info_t info;
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	const char *name;
+	time_t started;
+	char date[32];
+	unsigned int i;
+
+	if (!ni_trace_ring_info(path, &info))
+		return;
+
+	started = info.started / 1000000000ULL;
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&started));
+
+	for (i = 0; i < 32; ++i) {
+		if (!(info.facilities & (1U << i)))
+			continue;
+		if (!(name = ni_debug_facility_to_name(1U << i)))
+			continue;
+		if (buf.len)
+			ni_stringbuf_putc(&buf, ',');
+		ni_stringbuf_puts(&buf, name);
+	}
+
+	printf("%s:\n", path);
+	printf("  %-12s %s[%d]%s\n", "program", info.program, (int)info.pid,
+			kill(info.pid, 0) == 0 ? "" : " (not running)");
+	printf("  %-12s %s\n", "started", date);
+	printf("  %-12s %u\n", "level", info.level);
+	printf("  %-12s %s\n", "facilities", buf.len ? buf.string : "none");
+	printf("  %-12s %llu records, %llu bytes in a %zu bytes ring\n", "written",
+			(unsigned long long)info.records,
+			(unsigned long long)info.written, info.size);
+	printf("  %-12s %u\n", "formats", info.formats);
+	ni_stringbuf_destroy(&buf);
+}
+
+static int
+ni_trace_ring_action(const char *path, ni_bool_t list, const unsigned int *set_facilities,
+		const unsigned int *set_level, unsigned int facilities, unsigned int level)
+{
+	if (set_facilities || set_level) {
+		if (!ni_trace_ring_control(path, set_facilities, set_level))
+			return NI_WICKED_RC_ERROR;
+		list = TRUE;
+	}
+
+	if (list) {
+		ni_trace_print_info(path);
+		return NI_WICKED_RC_SUCCESS;
+	}
+
+	if (ni_trace_ring_dump(path, stdout, facilities, level) < 0)
+		return NI_WICKED_RC_ERROR;
+	return NI_WICKED_RC_SUCCESS;
+}
+
+int
+ni_do_trace(const char *caller, int argc, char **argv)
+{
+	enum {	OPT_HELP = 'h', OPT_LIST = 'l', OPT_OLD = 'o',
+		OPT_FACILITIES = 'f', OPT_LEVEL = 'L',
+		OPT_SET_FACILITIES = 'F', OPT_SET_LEVEL = 'S' };
+	static struct option	options[] = {
+		{ "help",		no_argument,		NULL,	OPT_HELP		},
+		{ "list",		no_argument,		NULL,	OPT_LIST		},
+		{ "old",		no_argument,		NULL,	OPT_OLD			},
+		{ "facilities",		required_argument,	NULL,	OPT_FACILITIES		},
+		{ "level",		required_argument,	NULL,	OPT_LEVEL		},
+		{ "set-facilities",	required_argument,	NULL,	OPT_SET_FACILITIES	},
+		{ "set-level",		required_argument,	NULL,	OPT_SET_LEVEL		},
+		{ NULL,			no_argument,		NULL,	0			}
+	};
+	int opt = 0, status = NI_WICKED_RC_USAGE, ret;
+	unsigned int facilities = -1U, level = NI_LOG_DEBUG3;
+	unsigned int set_facilities = 0, set_level = 0;
+	ni_bool_t do_set_facilities = FALSE;
+	ni_bool_t do_set_level = FALSE;
+	const ni_trace_daemon_t *daemon;
+	ni_bool_t list = FALSE;
+	ni_bool_t old = FALSE;
+	char *program = NULL;
+	const char *path;
+
+	ni_string_printf(&program, "%s %s", caller  ? caller  : "wicked",
+					    argv[0] ? argv[0] : "trace");
+
+	optind = 1;
+	argv[0] = program;
+	while ((opt = getopt_long(argc, argv, "+hlof:L:F:S:", options, NULL)) != EOF) {
+		switch (opt) {
+		case OPT_LIST:
+			list = TRUE;
+			break;
+
+		case OPT_OLD:
+			old = TRUE;
+			break;
+
+		case OPT_FACILITIES:
+			if (ni_debug_parse_facilities(optarg, &facilities) < 0) {
+				fprintf(stderr, "%s: invalid facilities '%s'\n", program, optarg);
+				goto usage;
+			}
+			break;
+
+		case OPT_LEVEL:
+			if (!ni_log_level_parse(optarg, &level)) {
+				fprintf(stderr, "%s: invalid level '%s'\n", program, optarg);
+				goto usage;
+			}
+			break;
+
+		case OPT_SET_FACILITIES:
+			if (ni_debug_parse_facilities(optarg, &set_facilities) < 0) {
+				fprintf(stderr, "%s: invalid facilities '%s'\n", program, optarg);
+				goto usage;
+			}
+			do_set_facilities = TRUE;
+			break;
+
+		case OPT_SET_LEVEL:
+			if (!ni_log_level_parse(optarg, &set_level)) {
+				fprintf(stderr, "%s: invalid level '%s'\n", program, optarg);
+				goto usage;
+			}
+			do_set_level = TRUE;
+			break;
+
+		case OPT_HELP:
+			status = NI_WICKED_RC_SUCCESS;
+			/* fall through */
+		default:
+		usage:
+			fprintf(stderr,
+				"\nUsage:\n"
+				"  %s [options] [daemon ...]\n"
+				"\n"
+				"Show the binary trace rings of the wicked daemons:\n"
+				"  wickedd, nanny, dhcp4, dhcp6, auto4 or a ring file\n"
+				"  (default: all rings in the state directory)\n"
+				"\n"
+				"Options:\n"
+				"  --help, -h           show this help text and exit.\n"
+				"  --list, -l           show the ring settings instead of the records\n"
+				"  --old, -o            use the rings of the previous daemon instances\n"
+				"  --facilities, -f <facility,...>\n"
+				"                       show the records of these facilities only\n"
+				"  --level, -L <level>  show the records up to this level only\n"
+				"  --set-facilities, -F <facility,...>\n"
+				"                       change the facilities the daemons record\n"
+				"  --set-level, -S <level>\n"
+				"                       change the level up to which the daemons record\n"
+				"\n", argv[0]);
+			goto cleanup;
+		}
+	}
+
+	status = NI_WICKED_RC_SUCCESS;
+	if (optind < argc) {
+		for (; optind < argc; ++optind) {
+			path = ni_trace_ring_file(argv[optind], old);
+			ret = ni_trace_ring_action(path, list,
+					do_set_facilities ? &set_facilities : NULL,
+					do_set_level ? &set_level : NULL,
+					facilities, level);
+			if (ret)
+				status = ret;
+		}
+	} else {
+		for (daemon = ni_trace_daemons; daemon->name; ++daemon) {
+			path = ni_trace_ring_file(daemon->name, old);
+			if (!ni_file_exists(path))
+				continue;
+
+			ret = ni_trace_ring_action(path, list,
+					do_set_facilities ? &set_facilities : NULL,
+					do_set_level ? &set_level : NULL,
+					facilities, level);
+			if (ret)
+				status = ret;
+		}
+	}
+
+cleanup:
+	argv[0] = NULL;
+	ni_string_free(&program);
+	return status;
+}
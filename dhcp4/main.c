@@ -23,6 +23,8 @@
 
 #include "dhcp4/dhcp4.h"
 #include "dhcp4/tester.h"
+#include "appconfig.h"
+#include "netshare.h"
 
 enum {
 	/* common */
@@ -279,6 +281,8 @@ main(int argc, char **argv)
 		return ni_dhcp4_tester_run(tester);
 	}
 
+	ni_trace_ring_open(program_name);
+
 	dhcp4_supplicant();
 	return NI_WICKED_RC_SUCCESS;
 }
@@ -358,6 +362,7 @@ dhcp4_register_services(ni_dbus_server_t *server)
 
 	/* Register the root object /org/opensuse/Network/DHCP4 */
 	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp4_interface);
+	ni_dbus_object_register_service(root_object, &ni_objectmodel_metrics_service);
 
 	/* Register /org/opensuse/Network/DHCP4/Interface */
 	object = ni_dbus_server_register_object(server, "Interface", &ni_dbus_anonymous_class, NULL);
@@ -438,6 +443,10 @@ dhcp4_discover_devices(ni_dbus_server_t *server)
 	ni_netconfig_t *nc;
 	ni_netdev_t *ifp;
 
+	/* use the wickedd netconfig state when it provides it */
+	if (ni_config_rtnl_event_shared_state())
+		ni_netshare_client_open();
+
 	if (!(nc = ni_global_state_handle(1)))
 		ni_fatal("cannot refresh interface list!");
 
@@ -43,6 +43,8 @@
 #include "dhcp6/tester.h"
 #include "netinfo_priv.h"
 #include "duid.h"
+#include "appconfig.h"
+#include "netshare.h"
 
 
 #define CONFIG_DHCP6_STATE_FILE	"dhcp6-state.xml"
@@ -298,6 +300,8 @@ main(int argc, char **argv)
 		return ni_dhcp6_tester_run(tester);
 	}
 
+	ni_trace_ring_open(program_name);
+
 	dhcp6_supplicant();
 	return NI_WICKED_RC_SUCCESS;
 }
@@ -326,6 +330,7 @@ dhcp6_register_services(ni_dbus_server_t *server)
 
 	/*  Register the root object (org.opensuse.Network.DHCP6) */
 	ni_dbus_object_register_service(root_object, &__ni_objectmodel_dhcp6_interface);
+	ni_dbus_object_register_service(root_object, &ni_objectmodel_metrics_service);
 
 	/* Register /org/opensuse/Network/DHCP6/Interface */
 	object = ni_dbus_server_register_object(server, "Interface", &ni_dbus_anonymous_class, NULL);
@@ -409,6 +414,10 @@ dhcp6_discover_devices(ni_dbus_server_t *server)
 	ni_netconfig_t *nc;
 	ni_netdev_t *	ifp;
 
+	/* use the wickedd netconfig state when it provides it */
+	if (ni_config_rtnl_event_shared_state())
+		ni_netshare_client_open();
+
 	if (!(nc = ni_global_state_handle(1)))
 		ni_fatal("Cannot refresh interface list!");
 
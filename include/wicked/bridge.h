@@ -87,10 +87,15 @@ extern void		ni_bridge_free(ni_bridge_t *);
 extern void		ni_bridge_ports_destroy(ni_bridge_t *);
 extern void		ni_bridge_status_destroy(ni_bridge_status_t *);
 extern void		ni_bridge_port_status_destroy(ni_bridge_port_status_t *);
+extern void		ni_bridge_port_status_copy(ni_bridge_port_status_t *,
+					const ni_bridge_port_status_t *);
 extern int		ni_bridge_add_port(ni_bridge_t *, ni_bridge_port_t *);
 extern int		ni_bridge_del_port(ni_bridge_t *, unsigned int);
 extern int		ni_bridge_del_port_ifname(ni_bridge_t *, const char *);
 extern int		ni_bridge_del_port_ifindex(ni_bridge_t *, unsigned int);
+extern ni_bridge_port_t *ni_bridge_bind_port(ni_bridge_t *, const char *, unsigned int,
+					const ni_bridge_port_t *);
+extern ni_bool_t	ni_bridge_unbind_port(ni_bridge_t *, unsigned int);
 extern void		ni_bridge_get_port_names(const ni_bridge_t *, ni_string_array_t *);
 
 extern ni_bridge_port_t *ni_bridge_port_new(ni_bridge_t *br, const char *ifname, unsigned int ifindex);
@@ -338,6 +338,8 @@ extern dbus_bool_t		ni_dbus_struct_get_string(const ni_dbus_variant_t *, unsigne
  * Client side functions
  */
 extern ni_dbus_client_t *	ni_dbus_client_open(const char *bus_type, const char *bus_name);
+extern ni_dbus_client_t *	ni_dbus_client_open_peer(const char *address,
+					const char *bus_type, const char *bus_name);
 extern void			ni_dbus_client_free(ni_dbus_client_t *);
 extern void			ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					const char *sender,
@@ -100,6 +100,8 @@ struct ni_fsm_transition {
 		ni_bool_t		parsed;
 		ni_fsm_require_t *	list;
 	} require;
+
+	struct ni_metric *		metric;		/* call latency */
 };
 
 typedef enum {
@@ -23,6 +23,8 @@ extern void		ni_warn(const char *, ...) __fmtattr;
 extern void		ni_error(const char *, ...) __fmtattr;
 extern void		ni_error_extra(const char *, ...) __fmtattr;
 extern void		ni_trace(const char *, ...) __fmtattr;
+extern void		__ni_debug_event(unsigned int, unsigned int, const char *, ...)
+				__attribute__ ((format (printf, 3, 4)));
 extern void		ni_fatal(const char *, ...) __fmtattr __noreturn;
 
 extern int		ni_enable_debug(const char *);
@@ -30,16 +32,21 @@ extern int		ni_debug_set_default(const char *);
 extern void		ni_debug_help(void);
 extern const char * 	ni_debug_facility_to_name(unsigned int);
 extern int		ni_debug_name_to_facility(const char *, unsigned int *);
+extern int		ni_debug_parse_facilities(const char *, unsigned int *);
 extern const char *	ni_debug_facility_to_description(unsigned int);
 
 extern void		ni_log_init(void);
 extern ni_bool_t	ni_log_level_set(const char *);
 extern unsigned int	ni_log_level_get(void);
+extern ni_bool_t	ni_log_level_parse(const char *, unsigned int *);
 
 extern ni_bool_t	ni_log_destination(const char *program, const char *destination);
 extern void		ni_log_reopen(void);
 extern void		ni_log_close(void);
 
+extern ni_bool_t	ni_trace_ring_open(const char *program);
+extern void		ni_trace_ring_close(void);
+
 enum {
 	NI_LOG_ERROR,
 	NI_LOG_WARNING,
@@ -78,16 +85,32 @@ enum {
 extern unsigned int	ni_debug;
 extern unsigned int	ni_log_level;
 
+/*
+ * The facilities and level recorded into the binary trace ring; it
+ * lives in the shared ring file header while a ring is open, so the
+ * reader can change it at runtime.
+ */
+typedef struct ni_trace_ring_ctl {
+	volatile unsigned int	facilities;
+	volatile unsigned int	loglevel;
+} ni_trace_ring_ctl_t;
+
+extern ni_trace_ring_ctl_t *	ni_trace_ring_ctl;
+
 #define ni_log_level_at(level)			(ni_log_level >= (level))
 #define ni_log_facility(facility)		(ni_debug & (facility))
 
 #define ni_debug_guard(level, facility) \
 	(ni_log_level_at(level) && ni_log_facility(facility))
 
+#define ni_trace_ring_guard(level, facility) \
+	(ni_trace_ring_ctl->loglevel >= (level) && (ni_trace_ring_ctl->facilities & (facility)))
+
 #define __ni_debug(level, facility, fmt, args...) \
 	do { \
-		if (ni_debug_guard(level, facility)) \
-			ni_trace(fmt, ##args); \
+		if (ni_debug_guard(level, facility) || \
+		    ni_trace_ring_guard(level, facility)) \
+			__ni_debug_event(level, facility, fmt, ##args); \
 	} while (0)
 
 #define ni_debug_ifconfig(fmt, args...)		__ni_debug(NI_LOG_DEBUG, NI_TRACE_IFCONFIG, fmt, ##args)
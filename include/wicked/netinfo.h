@@ -26,6 +26,7 @@ struct ni_slaveinfo {
 
 	union {
 	    ni_bonding_slave_info_t *	bond;
+	    ni_bridge_port_t *		bridge;
 	};
 };
 
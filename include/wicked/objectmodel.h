@@ -103,6 +103,7 @@ extern ni_dbus_class_t *	ni_objectmodel_class_new(const char *, const ni_dbus_cl
 #define NI_OBJECTMODEL_MANAGED_NETIF_INTERFACE	NI_OBJECTMODEL_INTERFACE ".ManagedInterface"
 #define NI_OBJECTMODEL_MANAGED_MODEM_INTERFACE	NI_OBJECTMODEL_INTERFACE ".ManagedModem"
 #define NI_OBJECTMODEL_MANAGED_POLICY_INTERFACE	NI_OBJECTMODEL_INTERFACE ".ManagedPolicy"
+#define NI_OBJECTMODEL_METRICS_INTERFACE	NI_OBJECTMODEL_INTERFACE ".Metrics"
 
 /*
  * Signals emitted by addrconf services
@@ -114,6 +115,7 @@ extern ni_dbus_class_t *	ni_objectmodel_class_new(const char *, const ni_dbus_cl
 
 extern const ni_dbus_class_t	ni_objectmodel_netif_class;
 extern const ni_dbus_class_t	ni_objectmodel_addrconf_device_class;
+extern const ni_dbus_service_t	ni_objectmodel_metrics_service;
 
 extern const char *		ni_objectmodel_link_classname(ni_iftype_t);
 extern const ni_dbus_class_t *	ni_objectmodel_link_class(ni_iftype_t);
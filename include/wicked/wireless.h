@@ -169,6 +169,7 @@ struct ni_wireless_network {
 
 	struct ni_wireless_scan_info {
 		time_t			timestamp;
+		time_t			updated;		/* last BSS properties retrieval */
 		ni_bool_t		updating;		/* retrieving new scan info */
 		int			noise;
 		double			level;			/* in dBm*/
@@ -64,6 +64,12 @@ extern xpath_enode_t *	xpath_expression_parse(const char *);
 extern void		xpath_expression_free(xpath_enode_t *);
 extern xpath_result_t *	xpath_expression_eval(const xpath_enode_t *, xml_node_t *);
 
+typedef struct xpath_iter	xpath_iter_t;
+
+extern xpath_iter_t *	xpath_iter_new(const xpath_enode_t *, xml_node_t *);
+extern xml_node_t *	xpath_iter_next(xpath_iter_t *);
+extern void		xpath_iter_free(xpath_iter_t *);
+
 extern xpath_format_t *	xpath_format_parse(const char *);
 extern int		xpath_format_eval(xpath_format_t *, xml_node_t *, ni_string_array_t *);
 extern void		xpath_format_free(xpath_format_t *);
@@ -259,6 +259,8 @@ babysit(void)
 	if (ni_init_ex("nanny", ni_nanny_config_callback, mgr) < 0)
 		ni_fatal("error in configuration file");
 
+	ni_trace_ring_open(program_name);
+
 	ni_nanny_start(mgr);
 
 	if (!opt_foreground) {
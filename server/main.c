@@ -31,6 +31,9 @@
 #include "netinfo_priv.h"
 #include "udev-utils.h"
 #include "auto6.h"
+#include "appconfig.h"
+#include "netshare.h"
+#include "client/client_state.h"
 
 enum {
 	OPT_HELP,
@@ -209,6 +212,8 @@ main(int argc, char **argv)
 	if (ni_init("server") < 0)
 		return NI_LSB_RC_ERROR;
 
+	ni_trace_ring_open(program_name);
+
 	if (opt_recover_state && ni_string_empty(opt_state_file)) {
 		static char dirname[PATH_MAX];
 
@@ -274,8 +279,18 @@ run_interface_server(void)
 			ni_fatal("unable to background server");
 	}
 
+	/* convert the client states after a backend switch */
+	if (!ni_client_state_backend_init())
+		ni_warn("unable to convert the client states to the %s backend",
+			ni_config_client_state_backend_to_name(
+				ni_config_client_state_backend()));
+
 	discover_state(dbus_server);
 
+	/* provide the discovered state to the addrconf supplicants */
+	if (ni_config_rtnl_event_shared_state() && !ni_netshare_server_open())
+		ni_error("unable to provide netconfig state to supplicants");
+
 	if (opt_recover_state)
 		recover_state(opt_state_file);
 
@@ -293,6 +308,7 @@ run_interface_server(void)
 	if (opt_recover_state)
 		ni_objectmodel_save_state(opt_state_file);
 
+	ni_netshare_server_close();
 	exit(0);
 }
 
@@ -383,6 +399,8 @@ handle_interface_event(ni_netdev_t *dev, ni_event_t event)
 {
 	const ni_uuid_t *event_uuid = NULL;
 
+	ni_netshare_server_netdev_event(dev, event);
+
 	if (dbus_server) {
 		ni_dbus_object_t *object;
 
@@ -444,6 +462,7 @@ handle_interface_addr_events(ni_netdev_t *dev, ni_event_t event, const ni_addres
 	ni_addrconf_lease_t *lease, *next;
 
 	ni_server_trace_interface_addr_events(dev, event, ap);
+	ni_netshare_server_addr_event(dev, event, ap);
 
 	if (ap->family != AF_INET6)
 		return;
@@ -480,6 +499,7 @@ static void
 handle_interface_prefix_events(ni_netdev_t *dev, ni_event_t event, const ni_ipv6_ra_pinfo_t *pi)
 {
 	ni_server_trace_interface_prefix_events(dev, event, pi);
+	ni_netshare_server_prefix_event(dev, event, pi);
 	ni_auto6_on_prefix_event(dev, event, pi);
 }
 
@@ -72,6 +72,7 @@ typedef struct ni_config_rtnl_event {
 	 */
 	unsigned int	recv_buff_length;
 	unsigned int	mesg_buff_length;
+	ni_bool_t	shared_state;
 } ni_config_rtnl_event_t;
 
 typedef enum {
@@ -93,8 +94,29 @@ typedef enum {
 typedef struct ni_config_teamd {
 	ni_bool_t		enabled;
 	ni_config_teamd_ctl_t	ctl;
+	char *			usock_dir;
 } ni_config_teamd_t;
 
+typedef enum {
+	NI_CONFIG_OVS_CTL_DETECT = 0,
+	NI_CONFIG_OVS_CTL_OVSDB,
+	NI_CONFIG_OVS_CTL_VSCTL,
+} ni_config_ovs_ctl_t;
+
+typedef struct ni_config_ovs {
+	ni_config_ovs_ctl_t	ctl;
+	char *			ovsdb_socket;
+} ni_config_ovs_t;
+
+typedef enum {
+	NI_CONFIG_CLIENT_STATE_FILES = 0,
+	NI_CONFIG_CLIENT_STATE_JOURNAL,
+} ni_config_client_state_backend_t;
+
+typedef struct ni_config_client_state {
+	ni_config_client_state_backend_t	backend;
+} ni_config_client_state_t;
+
 typedef enum {
 	NI_CONFIG_DHCP4_ROUTES_CSR,
 	NI_CONFIG_DHCP4_ROUTES_MSCSR,
@@ -132,6 +154,7 @@ typedef struct ni_config_dhcp6 {
 	char *			default_duid;
 	unsigned int		create_duid;
 	ni_bool_t		device_duid;
+	ni_bool_t		shared_socket;
 
 	unsigned int		allow_update;
 	unsigned int		lease_time;
@@ -162,6 +185,29 @@ typedef struct ni_config_auto6 {
 	unsigned int	allow_update;
 } ni_config_auto6_t;
 
+typedef struct ni_config_hostname_lookup {
+	unsigned int		concurrency;
+	unsigned int		timeout;
+	unsigned int		cache_time;
+} ni_config_hostname_lookup_t;
+
+typedef struct ni_config_dbus_peer {
+	ni_bool_t		enabled;
+	ni_bool_t		abstract;
+	char *			socket_dir;
+} ni_config_dbus_peer_t;
+
+typedef struct ni_config_memory_stats {
+	unsigned int		interval;
+	unsigned int		samples;
+} ni_config_memory_stats_t;
+
+typedef struct ni_config_trace {
+	unsigned int		facilities;
+	unsigned int		level;
+	unsigned int		buffer_size;
+} ni_config_trace_t;
+
 typedef struct ni_config {
 	ni_config_fslocation_t	piddir;
 	ni_config_fslocation_t	storedir;
@@ -171,6 +217,8 @@ typedef struct ni_config {
 
 	struct {
 	    unsigned int		default_allow_update;
+	    unsigned int		lease_write_delay;
+	    unsigned int		arp_verify_concurrency;
 
 	    ni_config_dhcp4_t		dhcp4;
 	    ni_config_dhcp6_t		dhcp6;
@@ -192,11 +240,20 @@ typedef struct ni_config {
 
 	char *			dbus_name;
 	char *			dbus_type;
+	ni_config_dbus_peer_t	dbus_peer;
 
 	ni_config_rtnl_event_t	rtnl_event;
 
 	ni_config_bonding_t	bonding;
 	ni_config_teamd_t	teamd;
+	ni_config_ovs_t		ovs;
+
+	ni_config_client_state_t client_state;
+	ni_config_memory_stats_t memory_stats;
+
+	ni_config_hostname_lookup_t hostname_lookup;
+
+	ni_config_trace_t	trace;
 } ni_config_t;
 
 extern ni_config_t *	ni_config_new();
@@ -207,6 +264,10 @@ extern ni_extension_t *	ni_config_find_system_updater(ni_config_t *, const char
 extern unsigned int	ni_config_addrconf_update_mask(ni_addrconf_mode_t, unsigned int);
 extern unsigned int	ni_config_addrconf_update(const char *, ni_addrconf_mode_t, unsigned int);
 extern ni_bool_t	ni_config_use_nanny(void);
+extern unsigned int	ni_config_addrconf_lease_write_delay(void);
+extern unsigned int	ni_config_addrconf_arp_verify_concurrency(void);
+extern ni_bool_t	ni_config_addrconf_dhcp6_shared_socket(void);
+extern ni_bool_t	ni_config_rtnl_event_shared_state(void);
 
 extern const ni_config_dhcp4_t *	ni_config_dhcp4_find_device(const char *);
 extern const ni_config_dhcp6_t *	ni_config_dhcp6_find_device(const char *);
@@ -218,6 +279,22 @@ extern ni_bool_t	ni_config_teamd_disable(void);
 extern ni_bool_t	ni_config_teamd_enabled(void);
 extern ni_config_teamd_ctl_t	ni_config_teamd_ctl(void);
 extern const char *	ni_config_teamd_ctl_type_to_name(ni_config_teamd_ctl_t);
+extern const char *	ni_config_teamd_usock_dir(void);
+
+extern ni_config_ovs_ctl_t	ni_config_ovs_ctl(void);
+extern const char *	ni_config_ovs_ovsdb_socket(void);
+
+extern ni_config_client_state_backend_t	ni_config_client_state_backend(void);
+extern const char *	ni_config_client_state_backend_to_name(ni_config_client_state_backend_t);
+
+extern const char *	ni_config_dbus_peer_socket_dir(void);
+extern const char *	ni_config_dbus_peer_address(const char *, char **);
+
+extern const ni_config_memory_stats_t *	ni_config_memory_stats(void);
+
+extern const ni_config_hostname_lookup_t *	ni_config_hostname_lookup(void);
+
+extern const ni_config_trace_t *	ni_config_trace(void);
 
 extern ni_extension_t *	ni_extension_list_find(ni_extension_t *, const char *);
 extern void		ni_extension_list_destroy(ni_extension_t **);
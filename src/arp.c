@@ -17,6 +17,7 @@
 #include "netinfo_priv.h"
 #include "socket_priv.h"
 #include "buffer.h"
+#include "util_priv.h"
 
 static void	ni_arp_socket_recv(ni_socket_t *);
 static int	ni_arp_parse(ni_arp_socket_t *, ni_buffer_t *, ni_arp_packet_t *);
@@ -218,6 +219,176 @@ ni_arp_timeout_left(struct timeval *started, const struct timeval *current, unsi
 }
 
 
+/*
+ * The verify and notify address sets get an IPv4 address index
+ * (open addressing over the ipaddrs positions) once they reach
+ * NI_ARP_ADDRESS_HASH_MIN addresses, kept at a load of max 1/2.
+ */
+#define NI_ARP_ADDRESS_HASH_MIN		8
+#define NI_ARP_VERIFY_PROBES_CHUNK	16
+
+static inline unsigned int
+ni_arp_address_hash(struct in_addr ip)
+{
+	unsigned int hash = ntohl(ip.s_addr);
+
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bU;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static inline struct in_addr
+ni_arp_address_ip(const ni_address_t *ap)
+{
+	return ap->local_addr.sin.sin_addr;
+}
+
+static void
+ni_arp_address_index_destroy(ni_arp_address_index_t *index)
+{
+	free(index->slot);
+	index->slot = NULL;
+	index->size = 0;
+}
+
+static void
+ni_arp_address_index_insert(ni_arp_address_index_t *index,
+		const ni_address_array_t *ipaddrs, unsigned int pos)
+{
+	unsigned int mask = index->size - 1;
+	unsigned int slot;
+
+	slot = ni_arp_address_hash(ni_arp_address_ip(ipaddrs->data[pos])) & mask;
+	while (index->slot[slot])
+		slot = (slot + 1) & mask;
+	index->slot[slot] = pos + 1;
+}
+
+static void
+ni_arp_address_index_build(ni_arp_address_index_t *index, const ni_address_array_t *ipaddrs)
+{
+	unsigned int size = 32;
+	unsigned int i;
+
+	while (size < ipaddrs->count * 2)
+		size <<= 1;
+
+	free(index->slot);
+	index->slot = xcalloc(size, sizeof(*index->slot));
+	index->size = size;
+	for (i = 0; i < ipaddrs->count; ++i)
+		ni_arp_address_index_insert(index, ipaddrs, i);
+}
+
+static int
+ni_arp_address_index_find(ni_arp_address_index_t *index,
+		const ni_address_array_t *ipaddrs, struct in_addr ip)
+{
+	unsigned int i, mask, slot;
+
+	if (ipaddrs->count < NI_ARP_ADDRESS_HASH_MIN) {
+		for (i = 0; i < ipaddrs->count; ++i) {
+			if (ni_arp_address_ip(ipaddrs->data[i]).s_addr == ip.s_addr)
+				return i;
+		}
+		return -1;
+	}
+
+	if (!index->slot)
+		ni_arp_address_index_build(index, ipaddrs);
+
+	mask = index->size - 1;
+	for (slot = ni_arp_address_hash(ip) & mask; index->slot[slot]; slot = (slot + 1) & mask) {
+		i = index->slot[slot] - 1;
+		if (ni_arp_address_ip(ipaddrs->data[i]).s_addr == ip.s_addr)
+			return i;
+	}
+	return -1;
+}
+
+static unsigned int
+ni_arp_address_index_add(ni_arp_address_index_t *index,
+		ni_address_array_t *ipaddrs, ni_address_t *ap)
+{
+	ni_address_t *ref;
+
+	if (ap->family != AF_INET || !ni_sockaddr_is_ipv4_specified(&ap->local_addr))
+		return 0;
+
+	if (ni_arp_address_index_find(index, ipaddrs, ni_arp_address_ip(ap)) >= 0)
+		return 0;	/* already have it */
+
+	ref = ni_address_ref(ap);
+	if (!ref || !ni_address_array_append(ipaddrs, ref)) {
+		ni_address_free(ref);
+		return 0;
+	}
+
+	if (index->slot) {
+		if (ipaddrs->count * 2 > index->size)
+			ni_arp_address_index_build(index, ipaddrs);
+		else
+			ni_arp_address_index_insert(index, ipaddrs, ipaddrs->count - 1);
+	}
+	return ipaddrs->count;
+}
+
+/*
+ * The hardware addresses of the other devices, to recognize replies
+ * from our own host. It is built on the first reply we have to check
+ * and dropped after each probe batch, so it follows device changes.
+ */
+static inline unsigned int
+ni_arp_hwaddr_hash(const ni_hwaddr_t *hwaddr)
+{
+	unsigned int hash = 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < hwaddr->len; ++i) {
+		hash ^= hwaddr->data[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static void
+ni_arp_hwaddr_index_destroy(ni_arp_hwaddr_index_t *index)
+{
+	free(index->entry);
+	index->entry = NULL;
+	index->size = 0;
+}
+
+static void
+ni_arp_hwaddr_index_build(ni_arp_hwaddr_index_t *index, ni_netconfig_t *nc,
+		unsigned int ifindex)
+{
+	unsigned int size = 16, count = 0, mask, slot;
+	const ni_netdev_t *dev;
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next)
+		count++;
+	while (size < count * 2)
+		size <<= 1;
+
+	free(index->entry);
+	index->entry = xcalloc(size, sizeof(*index->entry));
+	index->size = size;
+
+	mask = size - 1;
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		if (!dev->link.ifindex || dev->link.ifindex == ifindex || !dev->link.hwaddr.len)
+			continue;
+
+		slot = ni_arp_hwaddr_hash(&dev->link.hwaddr) & mask;
+		while (index->entry[slot].ifindex)
+			slot = (slot + 1) & mask;
+		index->entry[slot].ifindex = dev->link.ifindex;
+		index->entry[slot].hwaddr = dev->link.hwaddr;
+	}
+}
+
 void
 ni_arp_verify_init(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wait_ms)
 {
@@ -226,43 +397,57 @@ ni_arp_verify_init(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wai
 	vfy->wait_ms = wait_ms;
 }
 
+void
+ni_arp_verify_set_concurrency(ni_arp_verify_t *vfy, unsigned int concurrency)
+{
+	vfy->concurrency = concurrency;
+}
+
+static void
+ni_arp_verify_clear(ni_arp_verify_t *vfy)
+{
+	ni_address_array_destroy(&vfy->ipaddrs);
+	ni_arp_address_index_destroy(&vfy->index);
+	ni_arp_hwaddr_index_destroy(&vfy->hwaddrs);
+	free(vfy->probes);
+	vfy->probes = NULL;
+	vfy->first = 0;
+	vfy->next = 0;
+	vfy->active = 0;
+}
+
 void
 ni_arp_verify_reset(ni_arp_verify_t *vfy,  unsigned int nprobes, unsigned int wait_ms)
 {
 	vfy->nprobes = nprobes;
 	vfy->wait_ms = wait_ms;
-	timerclear(&vfy->started);
-	ni_address_array_destroy(&vfy->ipaddrs);
+	ni_arp_verify_clear(vfy);
 }
 
 void
 ni_arp_verify_destroy(ni_arp_verify_t *vfy)
 {
-	ni_address_array_destroy(&vfy->ipaddrs);
+	ni_arp_verify_clear(vfy);
 	memset(vfy, 0, sizeof(*vfy));
 }
 
 unsigned int
 ni_arp_verify_add_address(ni_arp_verify_t *vfy,  ni_address_t *ap)
 {
-	ni_address_t *ref;
+	unsigned int count;
 
 	if (!vfy || !ap || !vfy->nprobes)
 		return 0;
 
-	if (ap->family != AF_INET || !ni_sockaddr_is_ipv4_specified(&ap->local_addr))
+	if (!(count = ni_arp_address_index_add(&vfy->index, &vfy->ipaddrs, ap)))
 		return 0;
 
-	if (ni_address_array_find_match(&vfy->ipaddrs, ap, NULL, ni_address_equal_local_addr))
-		return 0;	/* already have it */
-
-	ref = ni_address_ref(ap);
-	if (!ref || !ni_address_array_append(&vfy->ipaddrs, ref)) {
-		ni_address_free(ref);
-		return 0;
+	if (((count - 1) % NI_ARP_VERIFY_PROBES_CHUNK) == 0) {
+		vfy->probes = xrealloc(vfy->probes, (count - 1 + NI_ARP_VERIFY_PROBES_CHUNK)
+						* sizeof(*vfy->probes));
 	}
-
-	return vfy->ipaddrs.count;
+	memset(&vfy->probes[count - 1], 0, sizeof(*vfy->probes));
+	return count;
 }
 
 void
@@ -270,28 +455,32 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 {
 	ni_arp_verify_t *vfy = (ni_arp_verify_t *)user_data;
 	ni_netconfig_t *nc = ni_global_state_handle(0);
+	const ni_arp_hwaddr_entry_t *entry;
 	const ni_netdev_t *dev;
 	ni_bool_t false_alarm = FALSE;
 	ni_bool_t found_addr = FALSE;
-	ni_address_t sip, *dup;
+	unsigned int mask, slot;
+	ni_sockaddr_t sip;
+	ni_address_t *dup;
 	const char *hwaddr;
+	int pos;
 
 	if (!sock || !pkt || pkt->op != ARPOP_REPLY || !vfy)
 		return;
 
 	/* Is it about the address we're validating? */
-	memset(&sip, 0, sizeof(sip));
-	ni_sockaddr_set_ipv4(&sip.local_addr, pkt->sip, 0);
-	dup = ni_address_array_find_match(&vfy->ipaddrs, &sip, NULL, ni_address_equal_local_addr);
-	if (!dup) {
+	pos = ni_arp_address_index_find(&vfy->index, &vfy->ipaddrs, pkt->sip);
+	if (pos < 0) {
+		ni_sockaddr_set_ipv4(&sip, pkt->sip, 0);
 		ni_debug_application("%s: ignore report about unrelated address %s from  %s",
-				sock->dev_info.ifname, ni_sockaddr_print(&sip.local_addr),
+				sock->dev_info.ifname, ni_sockaddr_print(&sip),
 				ni_link_address_print(&pkt->sha));
 		return;
-	} else
+	}
+	dup = vfy->ipaddrs.data[pos];
 	if (ni_address_is_duplicate(dup)) {
 		ni_debug_application("%s: ignore further reply about duplicate address %s from %s",
-				sock->dev_info.ifname, ni_sockaddr_print(&sip.local_addr),
+				sock->dev_info.ifname, ni_sockaddr_print(&dup->local_addr),
 				ni_link_address_print(&pkt->sha));
 		return;
 	}
@@ -301,7 +490,7 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 	 */
 	if (ni_link_address_equal(&sock->dev_info.hwaddr, &pkt->sha)) {
 		ni_debug_application("%s: ifgnore address %s in use by our own mac address %s",
-				sock->dev_info.ifname, ni_sockaddr_print(&sip.local_addr),
+				sock->dev_info.ifname, ni_sockaddr_print(&dup->local_addr),
 				ni_link_address_print(&pkt->sha));
 		return;
 	}
@@ -310,14 +499,19 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 	 * dup if same address, not a dup if there are two interfaces
 	 * connected to the same broadcast domain.
 	 */
-	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
-		if (dev->link.ifindex == sock->dev_info.ifindex)
+	if (!vfy->hwaddrs.entry)
+		ni_arp_hwaddr_index_build(&vfy->hwaddrs, nc, sock->dev_info.ifindex);
+
+	mask = vfy->hwaddrs.size - 1;
+	slot = ni_arp_hwaddr_hash(&pkt->sha) & mask;
+	for (; (entry = &vfy->hwaddrs.entry[slot])->ifindex; slot = (slot + 1) & mask) {
+		if (!ni_link_address_equal(&entry->hwaddr, &pkt->sha))
 			continue;
 
-		if (!ni_netdev_link_is_up(dev))
+		if (!(dev = ni_netdev_by_index(nc, entry->ifindex)))
 			continue;
 
-		if (!ni_link_address_equal(&dev->link.hwaddr, &pkt->sha))
+		if (!ni_netdev_link_is_up(dev))
 			continue;
 
 		/* OK, we have an interface matching the hwaddr,
@@ -326,7 +520,8 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 		 * alarm, except it really has the IP assigned.
 		 */
 		false_alarm = TRUE;
-		found_addr = !!ni_address_list_find(dev->addrs, &dup->local_addr);
+		if (ni_address_list_find(dev->addrs, &dup->local_addr))
+			found_addr = TRUE;
 	}
 	if (false_alarm && !found_addr) {
 		ni_debug_application("%s: reply from one of our interfaces",
@@ -342,57 +537,138 @@ ni_arp_verify_process(ni_arp_socket_t *sock, const ni_arp_packet_t *pkt, void *u
 			hwaddr ? " (in use by " : "", hwaddr ? hwaddr : "", hwaddr ? ")" : "");
 }
 
+/*
+ * The addresses are verified in a pipeline, with up to concurrency
+ * addresses at once, each on its own RFC 5227 like schedule scaled
+ * to wait_ms: the first probe after a random delay in [0, wait_ms/2),
+ * the further probes in random intervals of [wait_ms/2, wait_ms) and
+ * a wait for replies after the last probe until nprobes * wait_ms
+ * after the start, so the verify of an address takes as long as the
+ * lockstep probes did. The last probe is sent at most at
+ * (nprobes - 1/2) * wait_ms, leaving at least wait_ms/2 for replies.
+ * This spreads the probes of many addresses instead of sending them
+ * all in one burst.
+ */
+static unsigned int
+ni_arp_verify_delay(unsigned int min_ms, unsigned int max_ms)
+{
+	if (max_ms <= min_ms)
+		return min_ms;
+	return min_ms + (random() % (max_ms - min_ms));
+}
+
+static void
+ni_arp_verify_schedule(ni_arp_verify_probe_t *probe, const struct timeval *now,
+			unsigned int msec)
+{
+	struct timeval dif;
+
+	dif.tv_sec  = msec / 1000;
+	dif.tv_usec = (msec % 1000) * 1000;
+	timeradd(now, &dif, &probe->next);
+}
+
+static void
+ni_arp_verify_done(ni_arp_verify_t *vfy, unsigned int pos)
+{
+	ni_address_t *ap = vfy->ipaddrs.data[pos];
+
+	if (ni_address_is_tentative(ap))
+		ni_address_set_tentative(ap, FALSE);
+
+	timerclear(&vfy->probes[pos].next);
+	vfy->active--;
+}
+
 ni_bool_t
 ni_arp_verify_send(ni_arp_socket_t *sock, ni_arp_verify_t *vfy, unsigned int *timeout)
 {
 	static struct in_addr null = { 0 };
+	ni_arp_verify_probe_t *probe;
 	const struct in_addr *ip;
 	unsigned int i, count;
-	struct timeval now;
+	struct timeval now, dif;
+	unsigned long left;
 	ni_address_t *ap;
 
 	if (!sock || !vfy || !timeout)
 		return FALSE;
 
+	*timeout = 0;
 	ni_timer_get_time(&now);
-	if ((*timeout = ni_arp_timeout_left(&vfy->started, &now, vfy->wait_ms)))
-		return TRUE;
 
-	if (vfy->nprobes && vfy->ipaddrs.count) {
-		vfy->started = now;
-		vfy->nprobes--;
+	for (count = 0, i = vfy->first; i < vfy->next; ++i) {
+		probe = &vfy->probes[i];
+		ap = vfy->ipaddrs.data[i];
 
-		for (count = 0, i = 0; i < vfy->ipaddrs.count; ++i) {
-			ap = vfy->ipaddrs.data[i];
+		if (!timerisset(&probe->next))
+			continue;
 
-			if (ni_address_is_duplicate(ap))
-				continue;
+		if (ni_address_is_duplicate(ap) || !ni_address_is_tentative(ap)) {
+			ni_arp_verify_done(vfy, i);
+			continue;
+		}
 
-			if (!ni_address_is_tentative(ap))
-				continue;
+		if (timercmp(&probe->next, &now, >))
+			continue;
 
-			ni_debug_application("%s: sending arp verify for IP %s",
-					sock->dev_info.ifname,
-					ni_sockaddr_print(&ap->local_addr));
+		if (probe->sent >= vfy->nprobes) {
+			ni_arp_verify_done(vfy, i);
+			continue;
+		}
 
-			ip = &ap->local_addr.sin.sin_addr;
-			if (ni_arp_send_request(sock, null, *ip) > 0)
-				count++;
+		ni_debug_application("%s: sending arp verify for IP %s",
+				sock->dev_info.ifname,
+				ni_sockaddr_print(&ap->local_addr));
+
+		ip = &ap->local_addr.sin.sin_addr;
+		if (ni_arp_send_request(sock, null, *ip) <= 0) {
+			ni_arp_verify_done(vfy, i);
+			continue;
 		}
-		if (count) {
-			*timeout = vfy->wait_ms;
-			return TRUE;
+
+		count++;
+		if (++probe->sent < vfy->nprobes) {
+			ni_arp_verify_schedule(probe, &now, ni_arp_verify_delay(
+						vfy->wait_ms / 2, vfy->wait_ms));
+		} else {
+			probe->next = probe->deadline;
 		}
 	}
+	if (count)
+		ni_arp_hwaddr_index_destroy(&vfy->hwaddrs);
+
+	while (vfy->first < vfy->next && !timerisset(&vfy->probes[vfy->first].next))
+		vfy->first++;
+
+	/* start the next addresses up to the concurrency limit */
+	while (vfy->next < vfy->ipaddrs.count &&
+	       (!vfy->concurrency || vfy->active < vfy->concurrency)) {
+		probe = &vfy->probes[vfy->next++];
+		ni_arp_verify_schedule(probe, &now, vfy->nprobes * vfy->wait_ms);
+		probe->deadline = probe->next;
+		ni_arp_verify_schedule(probe, &now, ni_arp_verify_delay(0, vfy->wait_ms / 2));
+		vfy->active++;
+	}
 
-	for (count = 0, i = 0; i < vfy->ipaddrs.count; ++i) {
-		ap = vfy->ipaddrs.data[i];
+	if (!vfy->active)
+		return FALSE;
 
-		if (ni_address_is_tentative(ap))
-			ni_address_set_tentative(ap, FALSE);
-	}
+	/* wait for the earliest next probe or verify end */
+	for (i = vfy->first; i < vfy->next; ++i) {
+		probe = &vfy->probes[i];
+		if (!timerisset(&probe->next))
+			continue;
 
-	return FALSE;
+		left = 1;
+		if (timercmp(&probe->next, &now, >)) {
+			timersub(&probe->next, &now, &dif);
+			left = dif.tv_sec * 1000 + (dif.tv_usec + 999) / 1000;
+		}
+		if (!*timeout || left < *timeout)
+			*timeout = left;
+	}
+	return TRUE;
 }
 
 void
@@ -410,36 +686,24 @@ ni_arp_notify_reset(ni_arp_notify_t *nfy,  unsigned int nclaims, unsigned int wa
 	nfy->wait_ms = wait_ms;
 	timerclear(&nfy->started);
 	ni_address_array_destroy(&nfy->ipaddrs);
+	ni_arp_address_index_destroy(&nfy->index);
 }
 
 void
 ni_arp_notify_destroy(ni_arp_notify_t *nfy)
 {
 	ni_address_array_destroy(&nfy->ipaddrs);
+	ni_arp_address_index_destroy(&nfy->index);
 	memset(nfy, 0, sizeof(*nfy));
 }
 
 unsigned int
 ni_arp_notify_add_address(ni_arp_notify_t *nfy,  ni_address_t *ap)
 {
-	ni_address_t *ref;
-
 	if (!nfy || !ap || !nfy->nclaims)
 		return 0;
 
-	if (ap->family != AF_INET || !ni_sockaddr_is_ipv4_specified(&ap->local_addr))
-		return 0;
-
-	if (ni_address_array_find_match(&nfy->ipaddrs, ap, NULL, ni_address_equal_local_addr))
-		return 0;	/* already have it */
-
-	ref = ni_address_ref(ap);
-	if (!ref || !ni_address_array_append(&nfy->ipaddrs, ref)) {
-		ni_address_free(ref);
-		return 0;
-	}
-
-	return nfy->ipaddrs.count;
+	return ni_arp_address_index_add(&nfy->index, &nfy->ipaddrs, ap);
 }
 
 ni_bool_t
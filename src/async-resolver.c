@@ -12,6 +12,7 @@
 #include <wicked/logging.h>
 #include <wicked/socket.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -21,6 +22,11 @@
 #include <netdb.h>
 #include <errno.h>
 #include <poll.h>
+#include <fcntl.h>
+
+#include "trace-ring.h"
+#include "socket_priv.h"
+#include "appconfig.h"
 
 
 /*
@@ -198,6 +204,372 @@ ni_resolve_hostnames_timed(int af, unsigned int count, const char *hostnames[],
 	return 0;
 }
 
+/*
+ * Hostname lookups integrated into the socket/timer event loop.
+ *
+ * The getaddrinfo_a requests notify their completion by writing to a
+ * pipe, which is watched by a ni_socket_t. Results are cached per
+ * hostname and address family, so several callers checking the same
+ * host share one lookup; at most <hostname-lookup><concurrency> lookups
+ * are running at a time, the remaining ones are queued.
+ */
+#define NI_RESOLVE_ASYNC_NEGATIVE_TIME	2	/* sec */
+
+typedef enum {
+	NI_RESOLVE_ASYNC_QUEUED,
+	NI_RESOLVE_ASYNC_RUNNING,
+	NI_RESOLVE_ASYNC_RESOLVED,
+	NI_RESOLVE_ASYNC_FAILED,
+} ni_resolve_async_state_t;
+
+typedef struct ni_resolve_async_entry	ni_resolve_async_entry_t;
+struct ni_resolve_async_entry {
+	ni_resolve_async_entry_t *	next;
+
+	char *				hostname;
+	int				family;
+	ni_resolve_async_state_t	state;
+	struct gaicb *			cb;
+	ni_sockaddr_t			addr;
+	struct timeval			deadline;
+};
+
+static struct {
+	ni_resolve_async_entry_t *	entries;
+	ni_resolve_async_entry_t *	orphans;
+	unsigned int			running;
+	ni_socket_t *			sock;
+	int				notify_fd;
+	const ni_timer_t *		timer;
+} ni_resolve_async = {
+	.notify_fd = -1,
+};
+
+static void	ni_resolve_async_run(void);
+
+static void
+ni_resolve_async_entry_free(ni_resolve_async_entry_t *entry)
+{
+	if (entry->cb)
+		gaicb_free(entry->cb);
+	ni_string_free(&entry->hostname);
+	free(entry);
+}
+
+static ni_resolve_async_entry_t **
+ni_resolve_async_entry_find(const char *hostname, int family)
+{
+	ni_resolve_async_entry_t **pos, *entry;
+
+	for (pos = &ni_resolve_async.entries; (entry = *pos); pos = &entry->next) {
+		if (entry->family == family && ni_string_eq(entry->hostname, hostname))
+			return pos;
+	}
+	return NULL;
+}
+
+/*
+ * A lookup we're not waiting for anymore, but glibc is still working
+ * on, occupies a resolver thread until it finishes.
+ */
+static void
+ni_resolve_async_orphan(ni_resolve_async_entry_t *entry)
+{
+	ni_resolve_async_entry_t *orphan;
+
+	if (gai_cancel(entry->cb) != EAI_NOTCANCELED) {
+		gaicb_free(entry->cb);
+		entry->cb = NULL;
+		ni_resolve_async.running--;
+		return;
+	}
+
+	orphan = xcalloc(1, sizeof(*orphan));
+	orphan->hostname = entry->hostname;
+	orphan->family = entry->family;
+	orphan->state = NI_RESOLVE_ASYNC_RUNNING;
+	orphan->cb = entry->cb;
+	orphan->next = ni_resolve_async.orphans;
+	ni_resolve_async.orphans = orphan;
+
+	entry->hostname = xstrdup(orphan->hostname);
+	entry->cb = NULL;
+}
+
+static void
+ni_resolve_async_notify(union sigval sv)
+{
+	static const char c = 1;
+	ssize_t len;
+
+	/* called in a glibc resolver thread */
+	do {
+		len = write(sv.sival_int, &c, 1);
+	} while (len < 0 && errno == EINTR);
+}
+
+static void
+ni_resolve_async_complete(ni_resolve_async_entry_t *entry)
+{
+	const ni_config_hostname_lookup_t *conf = ni_config_hostname_lookup();
+	int gerr;
+
+	ni_resolve_async.running--;
+	ni_timer_get_time(&entry->deadline);
+
+	if ((gerr = gaicb_get_address(entry->cb, &entry->addr)) == 0) {
+		entry->state = NI_RESOLVE_ASYNC_RESOLVED;
+		entry->deadline.tv_sec += conf->cache_time;
+		ni_debug_objectmodel("resolved %s to %s", entry->hostname,
+				ni_sockaddr_print(&entry->addr));
+	} else {
+		entry->state = NI_RESOLVE_ASYNC_FAILED;
+		entry->deadline.tv_sec += NI_RESOLVE_ASYNC_NEGATIVE_TIME;
+		ni_debug_objectmodel("cannot resolve %s: %s", entry->hostname,
+				gai_strerror(gerr));
+	}
+	gaicb_free(entry->cb);
+	entry->cb = NULL;
+}
+
+static void
+ni_resolve_async_receive(ni_socket_t *sock)
+{
+	ni_resolve_async_entry_t **pos, *entry;
+	char buf[64];
+
+	while (read(sock->__fd, buf, sizeof(buf)) > 0)
+		;
+
+	for (pos = &ni_resolve_async.orphans; (entry = *pos); ) {
+		if (gai_error(entry->cb) == EAI_INPROGRESS) {
+			pos = &entry->next;
+			continue;
+		}
+		*pos = entry->next;
+		ni_resolve_async.running--;
+		ni_resolve_async_entry_free(entry);
+	}
+
+	for (entry = ni_resolve_async.entries; entry; entry = entry->next) {
+		if (entry->state == NI_RESOLVE_ASYNC_RUNNING &&
+		    gai_error(entry->cb) != EAI_INPROGRESS)
+			ni_resolve_async_complete(entry);
+	}
+
+	ni_resolve_async_run();
+}
+
+static ni_bool_t
+ni_resolve_async_init(void)
+{
+	int fd[2];
+
+	if (ni_resolve_async.sock)
+		return TRUE;
+
+	if (pipe2(fd, O_NONBLOCK | O_CLOEXEC) < 0) {
+		ni_error("unable to create hostname lookup notification pipe: %m");
+		return FALSE;
+	}
+
+	if (!(ni_resolve_async.sock = ni_socket_wrap(fd[0], SOCK_STREAM))) {
+		close(fd[0]);
+		close(fd[1]);
+		return FALSE;
+	}
+	ni_resolve_async.notify_fd = fd[1];
+	ni_resolve_async.sock->receive = ni_resolve_async_receive;
+	ni_socket_activate(ni_resolve_async.sock);
+	return TRUE;
+}
+
+static void
+ni_resolve_async_timeout(void *user_data, const ni_timer_t *timer)
+{
+	ni_resolve_async_entry_t *entry;
+	struct timeval now;
+
+	(void)user_data;
+	if (ni_resolve_async.timer != timer)
+		return;
+	ni_resolve_async.timer = NULL;
+
+	ni_timer_get_time(&now);
+	for (entry = ni_resolve_async.entries; entry; entry = entry->next) {
+		if (entry->state != NI_RESOLVE_ASYNC_RUNNING ||
+		    timercmp(&entry->deadline, &now, >))
+			continue;
+
+		ni_debug_objectmodel("cannot resolve %s: timeout", entry->hostname);
+		ni_resolve_async_orphan(entry);
+		entry->state = NI_RESOLVE_ASYNC_FAILED;
+		entry->deadline = now;
+		entry->deadline.tv_sec += NI_RESOLVE_ASYNC_NEGATIVE_TIME;
+	}
+
+	ni_resolve_async_run();
+}
+
+static void
+ni_resolve_async_arm_timer(void)
+{
+	ni_resolve_async_entry_t *entry;
+	struct timeval now, *next = NULL, delta;
+	unsigned long msec;
+
+	for (entry = ni_resolve_async.entries; entry; entry = entry->next) {
+		if (entry->state != NI_RESOLVE_ASYNC_RUNNING)
+			continue;
+		if (!next || timercmp(&entry->deadline, next, <))
+			next = &entry->deadline;
+	}
+
+	if (ni_resolve_async.timer) {
+		ni_timer_cancel(ni_resolve_async.timer);
+		ni_resolve_async.timer = NULL;
+	}
+	if (!next)
+		return;
+
+	ni_timer_get_time(&now);
+	msec = 0;
+	if (timercmp(next, &now, >)) {
+		timersub(next, &now, &delta);
+		msec = delta.tv_sec * 1000 + delta.tv_usec / 1000 + 1;
+	}
+	ni_resolve_async.timer = ni_timer_register(msec, ni_resolve_async_timeout, NULL);
+}
+
+static void
+ni_resolve_async_start(ni_resolve_async_entry_t *entry)
+{
+	const ni_config_hostname_lookup_t *conf = ni_config_hostname_lookup();
+	struct sigevent sev;
+	int rv;
+
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD;
+	sev.sigev_notify_function = ni_resolve_async_notify;
+	sev.sigev_value.sival_int = ni_resolve_async.notify_fd;
+
+	entry->cb = gaicb_new(entry->hostname, entry->family);
+	if ((rv = getaddrinfo_a(GAI_NOWAIT, &entry->cb, 1, &sev)) != 0) {
+		ni_error("getaddrinfo_a: %s", gai_strerror(rv));
+		gaicb_free(entry->cb);
+		entry->cb = NULL;
+		entry->state = NI_RESOLVE_ASYNC_FAILED;
+		ni_timer_get_time(&entry->deadline);
+		entry->deadline.tv_sec += NI_RESOLVE_ASYNC_NEGATIVE_TIME;
+		return;
+	}
+
+	entry->state = NI_RESOLVE_ASYNC_RUNNING;
+	ni_timer_get_time(&entry->deadline);
+	entry->deadline.tv_sec += conf->timeout;
+	ni_resolve_async.running++;
+}
+
+static void
+ni_resolve_async_run(void)
+{
+	const ni_config_hostname_lookup_t *conf = ni_config_hostname_lookup();
+	ni_resolve_async_entry_t *entry;
+
+	for (entry = ni_resolve_async.entries; entry; entry = entry->next) {
+		if (ni_resolve_async.running >= conf->concurrency)
+			break;
+		if (entry->state == NI_RESOLVE_ASYNC_QUEUED)
+			ni_resolve_async_start(entry);
+	}
+	ni_resolve_async_arm_timer();
+}
+
+/*
+ * Look up a hostname without blocking.
+ * Returns 1 and the address when resolved, 0 while the lookup is
+ * in progress and -1 when it failed. The caller is expected to poll
+ * again after the socket event loop processed the completion.
+ */
+int
+ni_resolve_hostname_async(const char *hostname, int af, ni_sockaddr_t *addr)
+{
+	ni_resolve_async_entry_t **pos, *entry, **tail;
+	struct timeval now;
+
+	if (ni_string_empty(hostname) || !addr || !ni_resolve_async_init())
+		return -1;
+
+	if ((pos = ni_resolve_async_entry_find(hostname, af))) {
+		entry = *pos;
+		switch (entry->state) {
+		case NI_RESOLVE_ASYNC_QUEUED:
+		case NI_RESOLVE_ASYNC_RUNNING:
+			return 0;
+
+		case NI_RESOLVE_ASYNC_RESOLVED:
+		case NI_RESOLVE_ASYNC_FAILED:
+			ni_timer_get_time(&now);
+			if (timercmp(&entry->deadline, &now, >)) {
+				if (entry->state == NI_RESOLVE_ASYNC_FAILED)
+					return -1;
+				*addr = entry->addr;
+				return 1;
+			}
+			*pos = entry->next;
+			ni_resolve_async_entry_free(entry);
+			break;
+		}
+	}
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->hostname = xstrdup(hostname);
+	entry->family = af;
+	entry->state = NI_RESOLVE_ASYNC_QUEUED;
+
+	/* append to keep the queue in the order of the requests */
+	for (tail = &ni_resolve_async.entries; *tail; tail = &(*tail)->next)
+		;
+	*tail = entry;
+
+	ni_resolve_async_run();
+	return entry->state == NI_RESOLVE_ASYNC_FAILED ? -1 : 0;
+}
+
+/*
+ * Drop the cached result of a hostname (all hostnames for NULL),
+ * e.g. when the resolver config changed. A lookup in progress is
+ * restarted.
+ */
+void
+ni_resolve_hostname_async_flush(const char *hostname, int af)
+{
+	ni_resolve_async_entry_t **pos, *entry;
+
+	for (pos = &ni_resolve_async.entries; (entry = *pos); ) {
+		if (hostname && (entry->family != af || !ni_string_eq(entry->hostname, hostname))) {
+			pos = &entry->next;
+			continue;
+		}
+
+		if (entry->state == NI_RESOLVE_ASYNC_RUNNING) {
+			ni_resolve_async_orphan(entry);
+			entry->state = NI_RESOLVE_ASYNC_QUEUED;
+			pos = &entry->next;
+			continue;
+		}
+		if (entry->state == NI_RESOLVE_ASYNC_QUEUED) {
+			pos = &entry->next;
+			continue;
+		}
+		*pos = entry->next;
+		ni_resolve_async_entry_free(entry);
+	}
+
+	if (ni_resolve_async.sock)
+		ni_resolve_async_run();
+}
+
 static int
 __ni_resolve_reverse(const ni_sockaddr_t *addr, char **hostname)
 {
@@ -354,6 +726,7 @@ ni_resolve_reverse_timed(const ni_sockaddr_t *addr, char **hostname, unsigned in
 		break;
 
 	case 0:
+		ni_trace_ring_detach();
 		close(fd[0]);
 		if (!freopen("/dev/null", "r", stdin) ||
 		    !freopen("/dev/null", "w", stderr)) {
@@ -1194,7 +1194,8 @@ ni_bonding_parse_sysfs_attrs(const char *ifname, ni_bonding_t *bonding)
 		{ NULL,			FALSE },
 	};
 	ni_string_array_t slave_names = NI_STRING_ARRAY_INIT;
-	char *attrval = NULL;
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+	char attrval[256];
 	unsigned int i;
 
 	__ni_bonding_clear(bonding);
@@ -1203,11 +1204,16 @@ ni_bonding_parse_sysfs_attrs(const char *ifname, ni_bonding_t *bonding)
 		ni_bonding_add_slave(bonding, slave_names.data[i]);
 	ni_string_array_destroy(&slave_names);
 
+	if (!ni_sysfs_netif_dir_open(&dir, ifname, "bonding")) {
+		ni_error("%s: cannot open bonding attribute directory", ifname);
+		return -1;
+	}
+
 	for (i = 0; attrs[i].name; ++i) {
 		const char *attrname = attrs[i].name;
 		int rv;
 
-		if (ni_sysfs_bonding_get_attr(ifname, attrname, &attrval) < 0) {
+		if (!ni_sysfs_dir_read(&dir, attrname, attrval, sizeof(attrval))) {
 			if (attrs[i].nofail)
 				continue;
 
@@ -1215,7 +1221,7 @@ ni_bonding_parse_sysfs_attrs(const char *ifname, ni_bonding_t *bonding)
 			goto failed;
 		}
 
-		if (attrval == NULL)
+		if (attrval[0] == '\0')
 			continue;
 
 		rv = ni_bonding_parse_sysfs_attribute(bonding, attrname, attrval);
@@ -1227,13 +1233,12 @@ ni_bonding_parse_sysfs_attrs(const char *ifname, ni_bonding_t *bonding)
 		}
 	}
 
+	ni_sysfs_dir_close(&dir);
 	ni_sysfs_bonding_get_arp_targets(ifname, &bonding->arpmon.targets);
-
-	ni_string_free(&attrval);
 	return 0;
 
 failed:
-	ni_string_free(&attrval);
+	ni_sysfs_dir_close(&dir);
 	return -1;
 }
 
@@ -212,6 +212,43 @@ ni_bridge_del_port_ifindex(ni_bridge_t *bridge, unsigned int ifindex)
 	return -1;
 }
 
+/*
+ * Bind/unbind a port to the bridge given the port device reference,
+ * updating the port config and status from the (optional) port info.
+ */
+ni_bridge_port_t *
+ni_bridge_bind_port(ni_bridge_t *bridge, const char *ifname, unsigned int ifindex,
+			const ni_bridge_port_t *info)
+{
+	ni_bridge_port_t *port;
+
+	if (!bridge || !ifindex || ni_string_empty(ifname))
+		return NULL;
+
+	if ((port = ni_bridge_port_by_index(bridge, ifindex))) {
+		if (!ni_string_eq(port->ifname, ifname))
+			ni_string_dup(&port->ifname, ifname);
+	} else {
+		port = ni_bridge_port_new(bridge, ifname, ifindex);
+	}
+
+	if (info && info != port) {
+		port->priority = info->priority;
+		port->path_cost = info->path_cost;
+		ni_bridge_port_status_copy(&port->status, &info->status);
+	}
+	return port;
+}
+
+ni_bool_t
+ni_bridge_unbind_port(ni_bridge_t *bridge, unsigned int ifindex)
+{
+	if (!bridge || !ifindex)
+		return FALSE;
+
+	return ni_bridge_del_port_ifindex(bridge, ifindex) == 0;
+}
+
 void
 ni_bridge_get_port_names(const ni_bridge_t *bridge, ni_string_array_t *names)
 {
@@ -284,6 +321,17 @@ ni_bridge_port_status_destroy(ni_bridge_port_status_t *ps)
 	ni_string_free(&ps->designated_bridge);
 }
 
+void
+ni_bridge_port_status_copy(ni_bridge_port_status_t *dst, const ni_bridge_port_status_t *src)
+{
+	ni_bridge_port_status_destroy(dst);
+	*dst = *src;
+	dst->designated_root = NULL;
+	dst->designated_bridge = NULL;
+	ni_string_dup(&dst->designated_root, src->designated_root);
+	ni_string_dup(&dst->designated_bridge, src->designated_bridge);
+}
+
 void
 ni_bridge_ports_destroy(ni_bridge_t *bridge)
 {
@@ -259,6 +259,49 @@ ni_capture_build_udp_header(ni_buffer_t *bp,
 	return 0;
 }
 
+/*
+ * Overwrite a part of the UDP payload of a packet built using
+ * ni_capture_build_udp_header() and update the UDP checksum
+ * incrementally (RFC 1624) instead of summing up the packet.
+ * The offset and length have to be 16 bit aligned.
+ */
+int
+ni_capture_update_udp_payload(ni_buffer_t *bp, unsigned int offset,
+		const void *data, size_t len)
+{
+	const unsigned char *tail = ni_buffer_tail(bp);
+	unsigned char *payload;
+	struct udphdr *udp;
+	struct ip *ip;
+	uint16_t old, new;
+	uint32_t sum;
+	size_t i;
+
+	if ((offset | len) & 1 || ni_buffer_count(bp) < sizeof(*ip) + sizeof(*udp))
+		return -1;
+
+	ip = ni_buffer_head(bp);
+	udp = (struct udphdr *)((unsigned char *)ip + (ip->ip_hl << 2));
+	payload = (unsigned char *)(udp + 1);
+	if (payload + offset + len > tail)
+		return -1;
+
+	/* HC' = ~(~HC + ~m + m') */
+	sum = (uint16_t)~udp->uh_sum;
+	for (i = 0; i < len; i += 2) {
+		memcpy(&old, payload + offset + i, sizeof(old));
+		memcpy(&new, (const unsigned char *)data + i, sizeof(new));
+		sum += (uint16_t)~old;
+		sum += new;
+	}
+	memcpy(payload + offset, data, len);
+
+	/* a zero checksum means there is none to update */
+	if (udp->uh_sum)
+		udp->uh_sum = checksum_fold(sum);
+	return 0;
+}
+
 static void *
 ni_capture_inspect_udp_header(void *data, size_t bytes, size_t *payload_len,
 				ni_bool_t partial_checksum)
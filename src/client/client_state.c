@@ -24,6 +24,7 @@
 #include <wicked/logging.h>
 
 #include "client/client_state.h"
+#include "appconfig.h"
 #include "util_priv.h"
 
 /*
@@ -427,8 +428,58 @@ ni_client_state_scripts_copy(ni_client_state_scripts_t *dst,
 		dst->node = xml_node_clone(src->node, NULL);
 }
 
+/*
+ * The client-state store dispatches to the configured backend:
+ * one state-<ifindex>.xml file per interface (default) or the
+ * client-state journal, see client_state_journal.c.
+ */
+static ni_bool_t
+ni_client_state_use_journal(void)
+{
+	return ni_config_client_state_backend() == NI_CONFIG_CLIENT_STATE_JOURNAL;
+}
+
+xml_node_t *
+ni_client_state_format_xml(const ni_client_state_t *client_state, const char *location)
+{
+	xml_node_t *node;
+
+	if (!(node = xml_node_new(NI_CLIENT_STATE_XML_NODE, NULL))) {
+		ni_error("Cannot create %s node for %s", NI_CLIENT_STATE_XML_NODE, location);
+		return NULL;
+	}
+
+	if (!ni_client_state_print_xml(client_state, node)) {
+		ni_error("Cannot format state into xml for %s", location);
+		xml_node_free(node);
+		return NULL;
+	}
+	return node;
+}
+
 ni_bool_t
-ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex)
+ni_client_state_parse_root_xml(const xml_node_t *xml, ni_client_state_t *client_state,
+				const char *location)
+{
+	const xml_node_t *node;
+
+	node = xml->name ? xml : xml->children;
+	if (!node || !ni_string_eq(node->name, NI_CLIENT_STATE_XML_NODE)) {
+		ni_error("State file '%s' does not contain %s node",
+			location, NI_CLIENT_STATE_XML_NODE);
+		return FALSE;
+	}
+
+	ni_client_state_reset(client_state);
+	if (!ni_client_state_parse_xml(node, client_state)) {
+		ni_error("Cannot parse state from file '%s'", location);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+ni_bool_t
+ni_client_state_file_save(const ni_client_state_t *client_state, unsigned int ifindex)
 {
 	char path[PATH_MAX] = {'\0'};
 	char temp[PATH_MAX] = {'\0'};
@@ -449,16 +500,8 @@ ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex
 		goto failure;
 	}
 
-	if (!(node = xml_node_new(NI_CLIENT_STATE_XML_NODE, NULL))) {
-		ni_error("Cannot create %s node for %s", NI_CLIENT_STATE_XML_NODE, path);
-		goto failure;
-	}
-
-	if (!ni_client_state_print_xml(client_state, node)) {
-		ni_error("Cannot format state into xml for %s", path);
-		xml_node_free(node);
+	if (!(node = ni_client_state_format_xml(client_state, path)))
 		goto failure;
-	}
 
 	if (xml_node_print(node, fp) < 0) {
 		ni_error("Cannot write into %s state temp file", path);
@@ -485,11 +528,10 @@ failure:
 }
 
 ni_bool_t
-ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
+ni_client_state_file_load(ni_client_state_t *client_state, unsigned int ifindex)
 {
 	char path[PATH_MAX] = {'\0'};
 	xml_node_t *xml;
-	xml_node_t *node;
 	FILE *fp;
 
 	if (!client_state)
@@ -509,17 +551,7 @@ ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
 	}
 	fclose(fp);
 
-	node = xml->name ? xml : xml->children;
-	if (!node || !ni_string_eq(node->name, NI_CLIENT_STATE_XML_NODE)) {
-		ni_error("State file '%s' does not contain %s node",
-			path, NI_CLIENT_STATE_XML_NODE);
-		xml_node_free(xml);
-		return FALSE;
-	}
-
-	ni_client_state_reset(client_state);
-	if (!ni_client_state_parse_xml(node, client_state)) {
-		ni_error("Cannot parse state from file '%s'", path);
+	if (!ni_client_state_parse_root_xml(xml, client_state, path)) {
 		xml_node_free(xml);
 		return FALSE;
 	}
@@ -528,16 +560,12 @@ ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
 	return TRUE;
 }
 
-
-ni_bool_t
-ni_client_state_move(unsigned int ifindex_old, unsigned int ifindex_new)
+static ni_bool_t
+ni_client_state_file_move(unsigned int ifindex_old, unsigned int ifindex_new)
 {
 	char path_old[PATH_MAX] = {'\0'};
 	char path_new[PATH_MAX] = {'\0'};
 
-	if (ifindex_old == ifindex_new)
-		return TRUE;
-
 	ni_client_state_filename(ifindex_old, path_old, sizeof(path_old));
 	ni_client_state_filename(ifindex_new, path_new, sizeof(path_new));
 
@@ -554,7 +582,7 @@ ni_client_state_move(unsigned int ifindex_old, unsigned int ifindex_new)
 }
 
 ni_bool_t
-ni_client_state_drop(unsigned int ifindex)
+ni_client_state_file_drop(unsigned int ifindex)
 {
 	char path[PATH_MAX] = {'\0'};
 
@@ -570,6 +598,67 @@ ni_client_state_drop(unsigned int ifindex)
 	return TRUE;
 }
 
+ni_bool_t
+ni_client_state_save(const ni_client_state_t *client_state, unsigned int ifindex)
+{
+	if (!client_state)
+		return FALSE;
+
+	if (ni_client_state_use_journal())
+		return ni_client_state_journal_save(client_state, ifindex);
+	return ni_client_state_file_save(client_state, ifindex);
+}
+
+ni_bool_t
+ni_client_state_load(ni_client_state_t *client_state, unsigned int ifindex)
+{
+	if (!client_state)
+		return FALSE;
+
+	/*
+	 * Until wickedd converted the states after a backend switch,
+	 * they are read from the other backend's store as they are.
+	 */
+	if (ni_client_state_use_journal()) {
+		return ni_client_state_journal_load(client_state, ifindex) ||
+			ni_client_state_file_load(client_state, ifindex);
+	} else {
+		return ni_client_state_file_load(client_state, ifindex) ||
+			ni_client_state_journal_load(client_state, ifindex);
+	}
+}
+
+ni_bool_t
+ni_client_state_move(unsigned int ifindex_old, unsigned int ifindex_new)
+{
+	if (ifindex_old == ifindex_new)
+		return TRUE;
+
+	if (ni_client_state_use_journal())
+		return ni_client_state_journal_move(ifindex_old, ifindex_new);
+	return ni_client_state_file_move(ifindex_old, ifindex_new);
+}
+
+ni_bool_t
+ni_client_state_drop(unsigned int ifindex)
+{
+	if (ni_client_state_use_journal())
+		return ni_client_state_journal_drop(ifindex);
+	return ni_client_state_file_drop(ifindex);
+}
+
+/*
+ * Convert the states left in the other backend's store after a
+ * backend switch; called by wickedd at startup only.
+ */
+ni_bool_t
+ni_client_state_backend_init(void)
+{
+	if (ni_client_state_use_journal())
+		return ni_client_state_journal_import();
+	return ni_client_state_journal_export();
+}
+
 ni_bool_t
 ni_client_state_set_persistent(xml_node_t *config)
 {
@@ -82,8 +82,24 @@ extern ni_bool_t	ni_client_state_load(ni_client_state_t *, unsigned int);
 extern ni_bool_t	ni_client_state_save(const ni_client_state_t *, unsigned int);
 extern ni_bool_t	ni_client_state_move(unsigned int, unsigned int);
 extern ni_bool_t	ni_client_state_drop(unsigned int);
+extern ni_bool_t	ni_client_state_backend_init(void);
 extern ni_bool_t	ni_client_state_set_persistent(xml_node_t *);
 
+extern xml_node_t *	ni_client_state_format_xml(const ni_client_state_t *, const char *);
+extern ni_bool_t	ni_client_state_parse_root_xml(const xml_node_t *, ni_client_state_t *, const char *);
+extern ni_bool_t	ni_client_state_file_load(ni_client_state_t *, unsigned int);
+extern ni_bool_t	ni_client_state_file_save(const ni_client_state_t *, unsigned int);
+extern ni_bool_t	ni_client_state_file_drop(unsigned int);
+
+extern ni_bool_t	ni_client_state_journal_load(ni_client_state_t *, unsigned int);
+extern ni_bool_t	ni_client_state_journal_save(const ni_client_state_t *, unsigned int);
+extern ni_bool_t	ni_client_state_journal_move(unsigned int, unsigned int);
+extern ni_bool_t	ni_client_state_journal_drop(unsigned int);
+extern ni_bool_t	ni_client_state_journal_compact(void);
+extern ni_bool_t	ni_client_state_journal_import(void);
+extern ni_bool_t	ni_client_state_journal_export(void);
+extern void		ni_client_state_journal_close(void);
+
 extern void		ni_client_state_control_debug(const char *, const ni_client_state_control_t *, const char *);
 extern void		ni_client_state_config_debug(const char *, const ni_client_state_config_t *, const char *);
 extern void		ni_client_state_debug(const char *, const ni_client_state_t *, const char *);
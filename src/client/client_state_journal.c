@@ -0,0 +1,882 @@
+/*
+ * Append-only journal backend for the runtime-persistent client state.
+ *
+ * Instead of one state-<ifindex>.xml file per interface, the states
+ * are stored as records in a single client-state.journal file in the
+ * state directory. Every save, move and drop appends one record and
+ * syncs the journal, a save of an unchanged state is not written at
+ * all. The latest state per ifindex is kept in memory, sorted by the
+ * ifindex and refreshed from the journal tail when another process
+ * appended records meanwhile.
+ *
+ * Crash safety: each record carries a checksum over its header and
+ * payload. A torn record at the journal end (crash while appending)
+ * is dropped on replay and truncated away. Compaction rewrites the
+ * live states into a temporary file, syncs it and renames it over
+ * the journal, so the journal is always either the old or the new
+ * one. An flock on the journal serializes all writers; a process
+ * holding a stale (replaced) journal descriptor reopens it.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <wicked/xml.h>
+#include <wicked/util.h>
+#include <wicked/netinfo.h>	/* for ni_config_statedir() */
+#include <wicked/logging.h>
+
+#include "client/client_state.h"
+#include "util_priv.h"
+
+#define NI_CLIENT_STATE_JOURNAL_NAME		"client-state.journal"
+#define NI_CLIENT_STATE_JOURNAL_MAGIC		0x4a53434eU	/* "NCSJ" */
+#define NI_CLIENT_STATE_JOURNAL_VERSION		1U
+#define NI_CLIENT_STATE_JOURNAL_MAX_DATA	(1U << 20)
+
+/*
+ * Compact when the journal contains more than twice as many records
+ * as there are live states, but not before it reached this minimum.
+ */
+#define NI_CLIENT_STATE_JOURNAL_COMPACT_MIN	256U
+
+enum {
+	NI_CLIENT_STATE_JOURNAL_SAVE	= 1,
+	NI_CLIENT_STATE_JOURNAL_MOVE,
+	NI_CLIENT_STATE_JOURNAL_DROP,
+};
+
+typedef struct ni_client_state_journal_head {
+	uint32_t		magic;
+	uint32_t		version;
+} ni_client_state_journal_head_t;
+
+typedef struct ni_client_state_journal_rec {
+	uint32_t		csum;		/* over the record, except csum */
+	uint16_t		type;
+	uint16_t		reserved;
+	uint32_t		ifindex;
+	uint32_t		arg;		/* new ifindex on move */
+	uint32_t		len;		/* length of the xml data */
+} ni_client_state_journal_rec_t;
+
+typedef struct ni_client_state_journal_entry {
+	unsigned int		ifindex;
+	size_t			len;
+	char *			data;		/* client-state xml */
+} ni_client_state_journal_entry_t;
+
+static struct {
+	int					fd;
+	dev_t					dev;
+	ino_t					ino;
+	off_t					size;
+	unsigned int				records;
+
+	unsigned int				count;
+	ni_client_state_journal_entry_t *	entries;
+} ni_client_state_journal = {
+	.fd		= -1,
+};
+
+static const char *
+ni_client_state_journal_path(char *path, size_t size)
+{
+	snprintf(path, size, "%s/%s", ni_config_statedir(),
+			NI_CLIENT_STATE_JOURNAL_NAME);
+	return path;
+}
+
+/*
+ * In-memory state table, sorted by ifindex
+ */
+static ni_bool_t
+ni_client_state_journal_find(unsigned int ifindex, unsigned int *pos)
+{
+	unsigned int lo = 0, hi = ni_client_state_journal.count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		unsigned int idx = ni_client_state_journal.entries[mid].ifindex;
+
+		if (idx == ifindex) {
+			*pos = mid;
+			return TRUE;
+		}
+		if (idx < ifindex)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*pos = lo;
+	return FALSE;
+}
+
+static ni_client_state_journal_entry_t *
+ni_client_state_journal_get(unsigned int ifindex)
+{
+	unsigned int pos;
+
+	if (!ni_client_state_journal_find(ifindex, &pos))
+		return NULL;
+	return &ni_client_state_journal.entries[pos];
+}
+
+static ni_bool_t
+ni_client_state_journal_set(unsigned int ifindex, const char *data, size_t len)
+{
+	ni_client_state_journal_entry_t *entry;
+	unsigned int pos;
+	char *copy;
+
+	if (!(copy = malloc(len + 1)))
+		return FALSE;
+	memcpy(copy, data, len);
+	copy[len] = '\0';
+
+	if (!ni_client_state_journal_find(ifindex, &pos)) {
+		unsigned int count = ni_client_state_journal.count;
+
+		if ((count % 64) == 0) {
+			entry = realloc(ni_client_state_journal.entries,
+					(count + 64) * sizeof(*entry));
+			if (!entry) {
+				free(copy);
+				return FALSE;
+			}
+			ni_client_state_journal.entries = entry;
+		}
+		entry = &ni_client_state_journal.entries[pos];
+		memmove(entry + 1, entry, (count - pos) * sizeof(*entry));
+		ni_client_state_journal.count++;
+		entry->ifindex = ifindex;
+		entry->data = NULL;
+	} else {
+		entry = &ni_client_state_journal.entries[pos];
+	}
+
+	free(entry->data);
+	entry->data = copy;
+	entry->len = len;
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_journal_unset(unsigned int ifindex)
+{
+	ni_client_state_journal_entry_t *entry;
+	unsigned int pos;
+
+	if (!ni_client_state_journal_find(ifindex, &pos))
+		return FALSE;
+
+	entry = &ni_client_state_journal.entries[pos];
+	free(entry->data);
+	ni_client_state_journal.count--;
+	memmove(entry, entry + 1, (ni_client_state_journal.count - pos) * sizeof(*entry));
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_journal_rekey(unsigned int ifindex_old, unsigned int ifindex_new)
+{
+	ni_client_state_journal_entry_t *entry;
+	ni_bool_t ret;
+
+	if (!(entry = ni_client_state_journal_get(ifindex_old)))
+		return FALSE;
+
+	ret = ni_client_state_journal_set(ifindex_new, entry->data, entry->len);
+	ni_client_state_journal_unset(ifindex_old);
+	return ret;
+}
+
+static void
+ni_client_state_journal_clear(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ni_client_state_journal.count; ++i)
+		free(ni_client_state_journal.entries[i].data);
+	free(ni_client_state_journal.entries);
+	ni_client_state_journal.entries = NULL;
+	ni_client_state_journal.count = 0;
+}
+
+/*
+ * Journal records
+ */
+static uint32_t
+ni_client_state_journal_csum(const ni_client_state_journal_rec_t *rec, const void *data)
+{
+	const unsigned char *ptr;
+	uint32_t hash = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	ptr = (const unsigned char *)rec + sizeof(rec->csum);
+	for (i = 0; i < sizeof(*rec) - sizeof(rec->csum); ++i) {
+		hash ^= ptr[i];
+		hash *= 16777619U;
+	}
+	for (ptr = data, i = 0; i < rec->len; ++i) {
+		hash ^= ptr[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static ni_bool_t
+ni_client_state_journal_apply(const ni_client_state_journal_rec_t *rec, const char *data)
+{
+	switch (rec->type) {
+	case NI_CLIENT_STATE_JOURNAL_SAVE:
+		return ni_client_state_journal_set(rec->ifindex, data, rec->len);
+	case NI_CLIENT_STATE_JOURNAL_MOVE:
+		ni_client_state_journal_unset(rec->arg);
+		ni_client_state_journal_rekey(rec->ifindex, rec->arg);
+		return TRUE;
+	case NI_CLIENT_STATE_JOURNAL_DROP:
+		ni_client_state_journal_unset(rec->ifindex);
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * Replay the records in buf, returns the length of the valid part.
+ */
+static size_t
+ni_client_state_journal_replay(const char *buf, size_t size)
+{
+	ni_client_state_journal_rec_t rec;
+	size_t off = 0;
+
+	while (size - off >= sizeof(rec)) {
+		memcpy(&rec, buf + off, sizeof(rec));
+
+		if (rec.len > NI_CLIENT_STATE_JOURNAL_MAX_DATA ||
+		    rec.len > size - off - sizeof(rec))
+			break;
+
+		if (rec.csum != ni_client_state_journal_csum(&rec, buf + off + sizeof(rec)))
+			break;
+
+		if (!ni_client_state_journal_apply(&rec, buf + off + sizeof(rec)))
+			break;
+
+		off += sizeof(rec) + rec.len;
+		ni_client_state_journal.records++;
+	}
+	return off;
+}
+
+/*
+ * Read and replay the journal tail appended since the last refresh.
+ */
+static ni_bool_t
+ni_client_state_journal_refresh(const char *path, off_t size)
+{
+	size_t len, valid;
+	char *buf;
+	ssize_t n;
+
+	if (size <= ni_client_state_journal.size)
+		return TRUE;
+
+	len = size - ni_client_state_journal.size;
+	if (!(buf = malloc(len)))
+		return FALSE;
+
+	n = pread(ni_client_state_journal.fd, buf, len, ni_client_state_journal.size);
+	if (n < 0 || (size_t)n != len) {
+		ni_error("Cannot read client-state journal %s: %m", path);
+		free(buf);
+		return FALSE;
+	}
+
+	valid = ni_client_state_journal_replay(buf, len);
+	free(buf);
+
+	ni_client_state_journal.size += valid;
+	if (valid != len) {
+		/* we're holding the lock: truncate the torn tail */
+		ni_warn("Discarding %zu trailing bytes of client-state journal %s",
+				len - valid, path);
+		if (ftruncate(ni_client_state_journal.fd, ni_client_state_journal.size) < 0 ||
+		    fdatasync(ni_client_state_journal.fd) < 0) {
+			ni_error("Cannot truncate client-state journal %s: %m", path);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_journal_init_head(const char *path)
+{
+	ni_client_state_journal_head_t head;
+	ssize_t n;
+
+	head.magic = NI_CLIENT_STATE_JOURNAL_MAGIC;
+	head.version = NI_CLIENT_STATE_JOURNAL_VERSION;
+
+	n = pwrite(ni_client_state_journal.fd, &head, sizeof(head), 0);
+	if (n != sizeof(head) || fdatasync(ni_client_state_journal.fd) < 0) {
+		ni_error("Cannot initialize client-state journal %s: %m", path);
+		return FALSE;
+	}
+	ni_client_state_journal.size = sizeof(head);
+	return TRUE;
+}
+
+static ni_bool_t
+ni_client_state_journal_check_head(const char *path)
+{
+	ni_client_state_journal_head_t head;
+
+	if (pread(ni_client_state_journal.fd, &head, sizeof(head), 0) != sizeof(head) ||
+	    head.magic != NI_CLIENT_STATE_JOURNAL_MAGIC ||
+	    head.version != NI_CLIENT_STATE_JOURNAL_VERSION) {
+		ni_error("Cannot use client-state journal %s: invalid header", path);
+		return FALSE;
+	}
+	ni_client_state_journal.size = sizeof(head);
+	return TRUE;
+}
+
+void
+ni_client_state_journal_close(void)
+{
+	if (ni_client_state_journal.fd >= 0)
+		close(ni_client_state_journal.fd);
+	ni_client_state_journal.fd = -1;
+	ni_client_state_journal.size = 0;
+	ni_client_state_journal.records = 0;
+	ni_client_state_journal_clear();
+}
+
+static ni_bool_t
+ni_client_state_journal_reopen(const char *path, ni_bool_t create)
+{
+	struct stat st;
+	int fd;
+
+	ni_client_state_journal_close();
+
+	fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+	if (fd < 0) {
+		if (errno != ENOENT || create)
+			ni_error("Cannot open client-state journal %s: %m", path);
+		return FALSE;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		ni_error("Cannot stat client-state journal %s: %m", path);
+		close(fd);
+		return FALSE;
+	}
+
+	ni_client_state_journal.fd = fd;
+	ni_client_state_journal.dev = st.st_dev;
+	ni_client_state_journal.ino = st.st_ino;
+	return TRUE;
+}
+
+/*
+ * Lock the journal and bring the in-memory states up to date.
+ */
+static ni_bool_t
+ni_client_state_journal_lock(const char *path, ni_bool_t create)
+{
+	struct stat st;
+
+	for (;;) {
+		if (ni_client_state_journal.fd < 0 &&
+		    !ni_client_state_journal_reopen(path, create))
+			return FALSE;
+
+		if (flock(ni_client_state_journal.fd, LOCK_EX) < 0) {
+			ni_error("Cannot lock client-state journal %s: %m", path);
+			return FALSE;
+		}
+
+		/* replaced by compaction or removed by another process? */
+		if (stat(path, &st) == 0) {
+			if (st.st_dev == ni_client_state_journal.dev &&
+			    st.st_ino == ni_client_state_journal.ino)
+				break;
+		} else
+		if (errno != ENOENT || !create) {
+			ni_client_state_journal_close();
+			return FALSE;
+		}
+		ni_client_state_journal_close();
+	}
+
+	if (ni_client_state_journal.size == 0) {
+		/* new journal or a crash while it has been initialized */
+		if (st.st_size < (off_t)sizeof(ni_client_state_journal_head_t)) {
+			if (!ni_client_state_journal_init_head(path))
+				goto failure;
+		} else
+		if (!ni_client_state_journal_check_head(path))
+			goto failure;
+	}
+
+	if (st.st_size < ni_client_state_journal.size) {
+		/* truncated behind our back, replay from scratch */
+		ni_client_state_journal_clear();
+		ni_client_state_journal.records = 0;
+		if (!ni_client_state_journal_check_head(path))
+			goto failure;
+	}
+
+	if (!ni_client_state_journal_refresh(path, st.st_size))
+		goto failure;
+
+	return TRUE;
+
+failure:
+	ni_client_state_journal_close();
+	return FALSE;
+}
+
+static void
+ni_client_state_journal_unlock(void)
+{
+	if (ni_client_state_journal.fd >= 0)
+		flock(ni_client_state_journal.fd, LOCK_UN);
+}
+
+static ni_bool_t
+ni_client_state_journal_append(const char *path, unsigned int type, unsigned int ifindex,
+				unsigned int arg, const char *data, size_t len)
+{
+	ni_client_state_journal_rec_t rec;
+	struct iovec iov[2];
+	ssize_t n;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = type;
+	rec.ifindex = ifindex;
+	rec.arg = arg;
+	rec.len = len;
+	rec.csum = ni_client_state_journal_csum(&rec, data);
+
+	iov[0].iov_base = &rec;
+	iov[0].iov_len = sizeof(rec);
+	iov[1].iov_base = (void *)data;
+	iov[1].iov_len = len;
+
+	n = pwritev(ni_client_state_journal.fd, iov, len ? 2 : 1, ni_client_state_journal.size);
+	if (n < 0 || (size_t)n != sizeof(rec) + len) {
+		ni_error("Cannot append to client-state journal %s: %m", path);
+		goto failure;
+	}
+
+	if (fdatasync(ni_client_state_journal.fd) < 0) {
+		ni_error("Cannot sync client-state journal %s: %m", path);
+		goto failure;
+	}
+
+	ni_client_state_journal.size += n;
+	ni_client_state_journal.records++;
+	return TRUE;
+
+failure:
+	if (ftruncate(ni_client_state_journal.fd, ni_client_state_journal.size) < 0)
+		ni_error("Cannot truncate client-state journal %s: %m", path);
+	return FALSE;
+}
+
+static ni_bool_t
+ni_client_state_journal_sync_dir(const char *dirname)
+{
+	int fd;
+
+	if ((fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+		return FALSE;
+	if (fsync(fd) < 0) {
+		close(fd);
+		return FALSE;
+	}
+	close(fd);
+	return TRUE;
+}
+
+/*
+ * Rewrite the live states into a new journal, called with the lock held.
+ */
+static ni_bool_t
+__ni_client_state_journal_compact(const char *path)
+{
+	ni_client_state_journal_head_t head;
+	char temp[PATH_MAX] = {'\0'};
+	unsigned int i, records;
+	struct stat st;
+	off_t size;
+	FILE *fp;
+	int fd;
+
+	snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+	if ((fd = mkstemp(temp)) < 0) {
+		ni_error("Cannot create %s journal temp file: %m", path);
+		return FALSE;
+	}
+	/* uncontended: nobody knows the new file yet */
+	if (flock(fd, LOCK_EX) < 0 || !(fp = fdopen(dup(fd), "we"))) {
+		ni_error("Cannot prepare %s journal temp file: %m", path);
+		goto failure;
+	}
+
+	head.magic = NI_CLIENT_STATE_JOURNAL_MAGIC;
+	head.version = NI_CLIENT_STATE_JOURNAL_VERSION;
+	fwrite(&head, sizeof(head), 1, fp);
+	size = sizeof(head);
+
+	for (records = i = 0; i < ni_client_state_journal.count; ++i) {
+		const ni_client_state_journal_entry_t *entry;
+		ni_client_state_journal_rec_t rec;
+
+		entry = &ni_client_state_journal.entries[i];
+		memset(&rec, 0, sizeof(rec));
+		rec.type = NI_CLIENT_STATE_JOURNAL_SAVE;
+		rec.ifindex = entry->ifindex;
+		rec.len = entry->len;
+		rec.csum = ni_client_state_journal_csum(&rec, entry->data);
+
+		fwrite(&rec, sizeof(rec), 1, fp);
+		fwrite(entry->data, 1, entry->len, fp);
+		size += sizeof(rec) + entry->len;
+		records++;
+	}
+
+	if (fflush(fp) != 0 || ferror(fp) || fsync(fd) < 0) {
+		ni_error("Cannot write %s journal temp file: %m", path);
+		fclose(fp);
+		goto failure;
+	}
+	fclose(fp);
+
+	if (fstat(fd, &st) < 0 || rename(temp, path) < 0) {
+		ni_error("Cannot move temp file to client-state journal %s: %m", path);
+		goto failure;
+	}
+	ni_client_state_journal_sync_dir(ni_config_statedir());
+
+	/* closing the replaced journal releases its lock */
+	close(ni_client_state_journal.fd);
+	ni_client_state_journal.fd = fd;
+	ni_client_state_journal.dev = st.st_dev;
+	ni_client_state_journal.ino = st.st_ino;
+	ni_client_state_journal.size = size;
+	ni_client_state_journal.records = records;
+
+	ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_READWRITE,
+			"compacted client-state journal %s to %u records",
+			path, records);
+	return TRUE;
+
+failure:
+	close(fd);
+	unlink(temp);
+	return FALSE;
+}
+
+static void
+ni_client_state_journal_compact_maybe(const char *path)
+{
+	unsigned int records = ni_client_state_journal.records;
+
+	if (records >= NI_CLIENT_STATE_JOURNAL_COMPACT_MIN &&
+	    records / 2 > ni_client_state_journal.count)
+		__ni_client_state_journal_compact(path);
+}
+
+static ni_bool_t
+__ni_client_state_journal_save(const char *path, unsigned int ifindex,
+				const char *data, size_t len)
+{
+	const ni_client_state_journal_entry_t *entry;
+
+	entry = ni_client_state_journal_get(ifindex);
+	if (entry && entry->len == len && !memcmp(entry->data, data, len)) {
+		ni_debug_verbose(NI_LOG_DEBUG3, NI_TRACE_READWRITE,
+				"client-state %u unchanged, not appended to %s",
+				ifindex, path);
+		return TRUE;
+	}
+
+	if (!ni_client_state_journal_append(path, NI_CLIENT_STATE_JOURNAL_SAVE,
+						ifindex, 0, data, len))
+		return FALSE;
+
+	return ni_client_state_journal_set(ifindex, data, len);
+}
+
+/*
+ * Import the per-interface state files into the journal and remove
+ * them afterwards; called with the lock held. A state file wins over
+ * the journal, it is left behind by the files backend only.
+ */
+static void
+ni_client_state_journal_migrate(const char *path)
+{
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_client_state_t cs;
+	unsigned int i;
+
+	if (!ni_scandir(ni_config_statedir(), "state-*.xml", &names)) {
+		ni_string_array_destroy(&names);
+		return;
+	}
+
+	ni_client_state_init(&cs);
+	for (i = 0; i < names.count; ++i) {
+		unsigned int ifindex;
+		xml_node_t *node;
+		char *data;
+		int n = 0;
+
+		if (sscanf(names.data[i], "state-%u.xml%n", &ifindex, &n) != 1 ||
+		    names.data[i][n] != '\0')
+			continue;
+
+		if (!ni_client_state_file_load(&cs, ifindex))
+			continue;
+
+		if (!(node = ni_client_state_format_xml(&cs, path)))
+			continue;
+
+		data = xml_node_sprint(node);
+		xml_node_free(node);
+		if (!data)
+			continue;
+
+		if (__ni_client_state_journal_save(path, ifindex, data, strlen(data))) {
+			ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_READWRITE,
+					"migrated %s into client-state journal",
+					names.data[i]);
+			ni_client_state_file_drop(ifindex);
+		}
+		free(data);
+	}
+	ni_client_state_reset(&cs);
+	ni_string_array_destroy(&names);
+}
+
+static ni_bool_t
+ni_client_state_journal_begin(char *path, size_t size)
+{
+	ni_client_state_journal_path(path, size);
+
+	return ni_client_state_journal_lock(path, TRUE);
+}
+
+ni_bool_t
+ni_client_state_journal_save(const ni_client_state_t *client_state, unsigned int ifindex)
+{
+	char path[PATH_MAX] = {'\0'};
+	xml_node_t *node;
+	ni_bool_t ret;
+	char *data;
+
+	if (!client_state)
+		return FALSE;
+
+	ni_client_state_journal_path(path, sizeof(path));
+	if (!(node = ni_client_state_format_xml(client_state, path)))
+		return FALSE;
+
+	data = xml_node_sprint(node);
+	xml_node_free(node);
+	if (!data) {
+		ni_error("Cannot format state into xml for %s", path);
+		return FALSE;
+	}
+
+	if (!ni_client_state_journal_begin(path, sizeof(path))) {
+		free(data);
+		return FALSE;
+	}
+
+	ret = __ni_client_state_journal_save(path, ifindex, data, strlen(data));
+	if (ret)
+		ni_client_state_journal_compact_maybe(path);
+
+	ni_client_state_journal_unlock();
+	free(data);
+	return ret;
+}
+
+ni_bool_t
+ni_client_state_journal_load(ni_client_state_t *client_state, unsigned int ifindex)
+{
+	const ni_client_state_journal_entry_t *entry;
+	char path[PATH_MAX] = {'\0'};
+	xml_document_t *doc = NULL;
+	ni_bool_t ret = FALSE;
+
+	if (!client_state)
+		return FALSE;
+
+	ni_client_state_journal_path(path, sizeof(path));
+	if (!ni_file_exists(path))
+		return FALSE;
+
+	if (!ni_client_state_journal_lock(path, FALSE))
+		return FALSE;
+
+	if ((entry = ni_client_state_journal_get(ifindex))) {
+		if (!(doc = xml_document_from_string(entry->data, path)))
+			ni_error("Cannot parse xml of state %u from journal '%s'",
+					ifindex, path);
+	}
+	ni_client_state_journal_unlock();
+
+	if (doc) {
+		ret = ni_client_state_parse_root_xml(xml_document_root(doc),
+							client_state, path);
+		xml_document_free(doc);
+	}
+	return ret;
+}
+
+ni_bool_t
+ni_client_state_journal_move(unsigned int ifindex_old, unsigned int ifindex_new)
+{
+	char path[PATH_MAX] = {'\0'};
+	ni_bool_t ret = TRUE;
+
+	if (!ni_client_state_journal_begin(path, sizeof(path)))
+		return FALSE;
+
+	if (!ni_client_state_journal_get(ifindex_old)) {
+		ni_debug_verbose(NI_LOG_DEBUG3, NI_TRACE_READWRITE,
+				"client-state %u does not exists, not moved to %u",
+				ifindex_old, ifindex_new);
+	} else
+	if ((ret = ni_client_state_journal_append(path, NI_CLIENT_STATE_JOURNAL_MOVE,
+					ifindex_old, ifindex_new, NULL, 0))) {
+		ni_client_state_journal_unset(ifindex_new);
+		ret = ni_client_state_journal_rekey(ifindex_old, ifindex_new);
+	}
+
+	ni_client_state_journal_unlock();
+	return ret;
+}
+
+ni_bool_t
+ni_client_state_journal_drop(unsigned int ifindex)
+{
+	char path[PATH_MAX] = {'\0'};
+	ni_bool_t ret = TRUE;
+
+	if (!ni_client_state_journal_begin(path, sizeof(path)))
+		return FALSE;
+
+	if (ni_client_state_journal_get(ifindex)) {
+		ret = ni_client_state_journal_append(path, NI_CLIENT_STATE_JOURNAL_DROP,
+							ifindex, 0, NULL, 0);
+		if (ret) {
+			ni_client_state_journal_unset(ifindex);
+			ni_client_state_journal_compact_maybe(path);
+		}
+	}
+
+	ni_client_state_journal_unlock();
+	return ret;
+}
+
+ni_bool_t
+ni_client_state_journal_compact(void)
+{
+	char path[PATH_MAX] = {'\0'};
+	ni_bool_t ret;
+
+	if (!ni_client_state_journal_begin(path, sizeof(path)))
+		return FALSE;
+
+	ret = __ni_client_state_journal_compact(path);
+	ni_client_state_journal_unlock();
+	return ret;
+}
+
+/*
+ * Import the state files into the journal, used by wickedd at startup
+ * after a switch to the journal backend.
+ */
+ni_bool_t
+ni_client_state_journal_import(void)
+{
+	char path[PATH_MAX] = {'\0'};
+
+	if (!ni_client_state_journal_begin(path, sizeof(path)))
+		return FALSE;
+
+	ni_client_state_journal_migrate(path);
+	ni_client_state_journal_unlock();
+	return TRUE;
+}
+
+/*
+ * Write the journal states back into per-interface state files and
+ * remove the journal, used by wickedd at startup after a switch back
+ * to the files backend.
+ */
+ni_bool_t
+ni_client_state_journal_export(void)
+{
+	char path[PATH_MAX] = {'\0'};
+	ni_client_state_t cs;
+	ni_bool_t ret = TRUE;
+	unsigned int i;
+
+	ni_client_state_journal_path(path, sizeof(path));
+	if (!ni_file_exists(path))
+		return TRUE;
+
+	if (!ni_client_state_journal_lock(path, FALSE))
+		return FALSE;
+
+	ni_client_state_init(&cs);
+	for (i = 0; i < ni_client_state_journal.count; ++i) {
+		const ni_client_state_journal_entry_t *entry;
+		xml_document_t *doc;
+
+		entry = &ni_client_state_journal.entries[i];
+		if (!(doc = xml_document_from_string(entry->data, path)))
+			continue;
+
+		if (!ni_client_state_parse_root_xml(xml_document_root(doc), &cs, path) ||
+		    !ni_client_state_file_save(&cs, entry->ifindex))
+			ret = FALSE;
+
+		xml_document_free(doc);
+	}
+	ni_client_state_reset(&cs);
+
+	if (ret) {
+		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_READWRITE,
+				"exported %u states from client-state journal %s",
+				ni_client_state_journal.count, path);
+		unlink(path);
+	}
+	ni_client_state_journal_close();
+	return ret;
+}
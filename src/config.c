@@ -51,6 +51,14 @@ static ni_bool_t	ni_config_parse_sources(ni_config_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_rtnl_event(ni_config_rtnl_event_t *, xml_node_t *);
 static ni_bool_t	ni_config_parse_bonding(ni_config_bonding_t *, const xml_node_t *);
 static ni_bool_t	ni_config_parse_teamd(ni_config_teamd_t *, const xml_node_t *);
+static ni_bool_t	ni_config_parse_ovs(ni_config_ovs_t *, const xml_node_t *);
+static ni_bool_t	ni_config_parse_client_state(ni_config_client_state_t *, const xml_node_t *);
+static ni_bool_t	ni_config_parse_trace(ni_config_trace_t *, const xml_node_t *);
+static void		ni_config_hostname_lookup_init(ni_config_hostname_lookup_t *);
+static ni_bool_t	ni_config_parse_hostname_lookup(ni_config_hostname_lookup_t *, const xml_node_t *);
+static ni_bool_t	ni_config_parse_dbus_peer(ni_config_dbus_peer_t *, const xml_node_t *);
+static void		ni_config_memory_stats_init(ni_config_memory_stats_t *);
+static ni_bool_t	ni_config_parse_memory_stats(ni_config_memory_stats_t *, const xml_node_t *);
 static ni_c_binding_t *	ni_c_binding_new(ni_c_binding_t **, const char *name, const char *lib, const char *symbol);
 static const char *	ni_config_build_include(const char *, const char *);
 static unsigned int	ni_config_addrconf_update_mask_all(void);
@@ -95,6 +103,13 @@ ni_config_new()
 	/* we enable it explicitly in wickedd only */
 	conf->teamd.enabled = FALSE;
 
+	ni_debug_parse_facilities("most", &conf->trace.facilities);
+	conf->trace.level = NI_LOG_DEBUG;
+	conf->trace.buffer_size = 512 * 1024;
+
+	ni_config_hostname_lookup_init(&conf->hostname_lookup);
+	ni_config_memory_stats_init(&conf->memory_stats);
+
 	return conf;
 }
 
@@ -247,6 +262,9 @@ ni_config_free(ni_config_t *conf)
 	ni_string_free(&conf->dbus_name);
 	ni_string_free(&conf->dbus_type);
 	ni_string_free(&conf->dbus_xml_schema_file);
+	ni_string_free(&conf->dbus_peer.socket_dir);
+	ni_string_free(&conf->teamd.usock_dir);
+	ni_string_free(&conf->ovs.ovsdb_socket);
 	ni_config_fslocation_destroy(&conf->piddir);
 	ni_config_fslocation_destroy(&conf->storedir);
 	ni_config_fslocation_destroy(&conf->statedir);
@@ -336,6 +354,9 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 			 *  <dbus>
 			 *    <service name="org.opensuse.Network" />
 			 *    <schema name="/some/path/wicked.xml" />
+			 *    <peer-to-peer>
+			 *      <enabled>true</enabled>
+			 *    </peer-to-peer>
 			 *  </dbus>
 			 */
 			for (gchild = child->children; gchild; gchild = gchild->next) {
@@ -348,6 +369,10 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				if (!strcmp(gchild->name, "schema")) {
 					if ((attrval = xml_node_get_attr(gchild, "name")) != NULL)
 						ni_string_dup(&conf->dbus_xml_schema_file, attrval);
+				} else
+				if (!strcmp(gchild->name, "peer-to-peer")) {
+					if (!ni_config_parse_dbus_peer(&conf->dbus_peer, gchild))
+						goto failed;
 				}
 			}
 		} else 
@@ -365,6 +390,20 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 				if (!strcmp(gchild->name, "default-allow-update"))
 					ni_config_parse_update_targets(&conf->addrconf.default_allow_update, gchild);
 
+				if (!strcmp(gchild->name, "lease-write-delay")
+				 && ni_parse_uint(gchild->cdata, &conf->addrconf.lease_write_delay, 10) < 0) {
+					ni_error("%s: invalid <addrconf><lease-write-delay>%s</lease-write-delay> option",
+						xml_node_location(gchild), gchild->cdata);
+					goto failed;
+				}
+
+				if (!strcmp(gchild->name, "arp-verify-concurrency")
+				 && ni_parse_uint(gchild->cdata, &conf->addrconf.arp_verify_concurrency, 10) < 0) {
+					ni_error("%s: invalid <addrconf><arp-verify-concurrency>%s</arp-verify-concurrency> option",
+						xml_node_location(gchild), gchild->cdata);
+					goto failed;
+				}
+
 				if (!strcmp(gchild->name, "dhcp4")
 				 && !ni_config_parse_addrconf_dhcp4(conf, gchild))
 					goto failed;
@@ -413,6 +452,26 @@ __ni_config_parse(ni_config_t *conf, const char *filename, ni_init_appdata_callb
 		if (strcmp(child->name, "teamd") == 0) {
 			if (!ni_config_parse_teamd(&conf->teamd, child))
 				goto failed;
+		} else
+		if (strcmp(child->name, "ovs") == 0) {
+			if (!ni_config_parse_ovs(&conf->ovs, child))
+				goto failed;
+		} else
+		if (strcmp(child->name, "client-state") == 0) {
+			if (!ni_config_parse_client_state(&conf->client_state, child))
+				goto failed;
+		} else
+		if (strcmp(child->name, "memory-stats") == 0) {
+			if (!ni_config_parse_memory_stats(&conf->memory_stats, child))
+				goto failed;
+		} else
+		if (strcmp(child->name, "trace") == 0) {
+			if (!ni_config_parse_trace(&conf->trace, child))
+				goto failed;
+		} else
+		if (strcmp(child->name, "hostname-lookup") == 0) {
+			if (!ni_config_parse_hostname_lookup(&conf->hostname_lookup, child))
+				goto failed;
 		}
 		if (cb != NULL) {
 			if (!cb(appdata, child))
@@ -1070,6 +1129,16 @@ ni_config_parse_addrconf_dhcp6_nodes(ni_config_dhcp6_t *dhcp6, xml_node_t *node)
 				dhcp6->vendor_opts_en = num;
 			}
 		} else
+		if (!strcmp(child->name, "shared-socket")) {
+			/* a property of the daemon, not of a device */
+			if (!ni_string_empty(dhcp6->device))
+				ni_warn("config: ignoring <shared-socket> in device scope (%s)",
+					xml_node_location(child));
+			else
+			if (ni_parse_boolean(child->cdata, &dhcp6->shared_socket))
+				ni_warn("config: unable to parse <shared-socket> (%s)",
+					xml_node_location(child));
+		} else
 		if (!strcmp(child->name, "lease-time") && child->cdata) {
 			dhcp6->lease_time = strtoul(child->cdata, NULL, 0);
 		} else
@@ -1535,6 +1604,10 @@ ni_config_parse_rtnl_event(ni_config_rtnl_event_t *conf, xml_node_t *node)
 		if (ni_string_eq(child->name, "message-buffer-length")) {
 			if (ni_parse_uint(child->cdata, &conf->mesg_buff_length, 0))
 				return FALSE;
+		} else
+		if (ni_string_eq(child->name, "shared-state")) {
+			if (ni_parse_boolean(child->cdata, &conf->shared_state))
+				return FALSE;
 		}
 	}
 	return TRUE;
@@ -1641,6 +1714,12 @@ ni_config_teamd_ctl(void)
 	return ni_global.config ? ni_global.config->teamd.ctl : NI_CONFIG_TEAMD_CTL_DETECT_ONCE;
 }
 
+const char *
+ni_config_teamd_usock_dir(void)
+{
+	return ni_global.config ? ni_global.config->teamd.usock_dir : NULL;
+}
+
 ni_bool_t
 ni_config_teamd_enable(ni_config_teamd_ctl_t type)
 {
@@ -1686,10 +1765,350 @@ ni_config_parse_teamd(ni_config_teamd_t *conf, const xml_node_t *node)
 				return FALSE;
 			}
 		}
+		if (ni_string_eq(child->name, "usock-dir")) {
+			if (ni_string_empty(child->cdata) || child->cdata[0] != '/') {
+				ni_error("%s: invalid <teamd><usock-dir>%s</usock-dir></teamd> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+			ni_string_dup(&conf->usock_dir, child->cdata);
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * openvswitch support config options
+ */
+static const ni_intmap_t	config_ovs_ctl_names[] = {
+	{ "detect",		NI_CONFIG_OVS_CTL_DETECT	},
+	{ "ovsdb",		NI_CONFIG_OVS_CTL_OVSDB		},
+	{ "vsctl",		NI_CONFIG_OVS_CTL_VSCTL		},
+	{ NULL,			-1U				}
+};
+
+ni_config_ovs_ctl_t
+ni_config_ovs_ctl(void)
+{
+	return ni_global.config ? ni_global.config->ovs.ctl : NI_CONFIG_OVS_CTL_DETECT;
+}
+
+const char *
+ni_config_ovs_ovsdb_socket(void)
+{
+	return ni_global.config ? ni_global.config->ovs.ovsdb_socket : NULL;
+}
+
+static ni_bool_t
+ni_config_parse_ovs(ni_config_ovs_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+	unsigned int ctl;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "ctl")) {
+			if (ni_parse_uint_mapped(child->cdata, config_ovs_ctl_names, &ctl) != 0) {
+				ni_error("%s: invalid <ovs><ctl>%s</ctl></ovs> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+			conf->ctl = ctl;
+		} else
+		if (ni_string_eq(child->name, "ovsdb-socket")) {
+			if (ni_string_empty(child->cdata) || child->cdata[0] != '/') {
+				ni_error("%s: invalid <ovs><ovsdb-socket>%s</ovsdb-socket></ovs> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+			ni_string_dup(&conf->ovsdb_socket, child->cdata);
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * client state store config options
+ */
+static const ni_intmap_t	config_client_state_backend_names[] = {
+	{ "files",		NI_CONFIG_CLIENT_STATE_FILES	},
+	{ "journal",		NI_CONFIG_CLIENT_STATE_JOURNAL	},
+	{ NULL,			-1U				}
+};
+
+const char *
+ni_config_client_state_backend_to_name(ni_config_client_state_backend_t backend)
+{
+	return ni_format_uint_mapped(backend, config_client_state_backend_names);
+}
+
+static ni_bool_t
+ni_config_client_state_name_to_backend(const char *name, ni_config_client_state_backend_t *backend)
+{
+	unsigned int _backend;
+
+	if (!name || !backend)
+		return FALSE;
+
+	if (ni_parse_uint_mapped(name, config_client_state_backend_names, &_backend) != 0)
+		return FALSE;
+
+	*backend = _backend;
+	return TRUE;
+}
+
+ni_config_client_state_backend_t
+ni_config_client_state_backend(void)
+{
+	return ni_global.config ? ni_global.config->client_state.backend : NI_CONFIG_CLIENT_STATE_FILES;
+}
+
+static ni_bool_t
+ni_config_parse_client_state(ni_config_client_state_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "backend")) {
+			if (!ni_config_client_state_name_to_backend(child->cdata, &conf->backend)) {
+				ni_error("%s: invalid <client-state><backend>%s</backend></client-state> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * binary trace ring options
+ */
+static ni_bool_t
+ni_config_parse_trace(ni_config_trace_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "facilities")) {
+			if (ni_debug_parse_facilities(child->cdata, &conf->facilities) < 0) {
+				ni_error("%s: invalid <trace><facilities>%s</facilities></trace> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "level")) {
+			if (!ni_log_level_parse(child->cdata, &conf->level)) {
+				ni_error("%s: invalid <trace><level>%s</level></trace> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "buffer-size")) {
+			if (ni_parse_uint(child->cdata, &conf->buffer_size, 0) < 0) {
+				ni_error("%s: invalid <trace><buffer-size>%s</buffer-size></trace> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		}
 	}
 	return TRUE;
 }
 
+const ni_config_trace_t *
+ni_config_trace(void)
+{
+	return ni_global.config ? &ni_global.config->trace : NULL;
+}
+
+/*
+ * asynchronous hostname lookup options
+ */
+static void
+ni_config_hostname_lookup_init(ni_config_hostname_lookup_t *conf)
+{
+	conf->concurrency = 8;
+	conf->timeout = 5;
+	conf->cache_time = 60;
+}
+
+static ni_bool_t
+ni_config_parse_hostname_lookup(ni_config_hostname_lookup_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "concurrency")) {
+			if (ni_parse_uint(child->cdata, &conf->concurrency, 0) || !conf->concurrency) {
+				ni_error("%s: invalid <hostname-lookup><concurrency>%s</concurrency></hostname-lookup> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "timeout")) {
+			if (ni_parse_uint(child->cdata, &conf->timeout, 0) || !conf->timeout) {
+				ni_error("%s: invalid <hostname-lookup><timeout>%s</timeout></hostname-lookup> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "cache-time")) {
+			if (ni_parse_uint(child->cdata, &conf->cache_time, 0)) {
+				ni_error("%s: invalid <hostname-lookup><cache-time>%s</cache-time></hostname-lookup> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+const ni_config_hostname_lookup_t *
+ni_config_hostname_lookup(void)
+{
+	static ni_config_hostname_lookup_t defaults;
+
+	if (ni_global.config)
+		return &ni_global.config->hostname_lookup;
+
+	if (!defaults.concurrency)
+		ni_config_hostname_lookup_init(&defaults);
+	return &defaults;
+}
+
+/*
+ * The private peer-to-peer dbus sockets of the wicked daemons
+ */
+static ni_bool_t
+ni_config_parse_dbus_peer(ni_config_dbus_peer_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "enabled")) {
+			if (ni_parse_boolean(child->cdata, &conf->enabled)) {
+				ni_error("%s: invalid <peer-to-peer><enabled>%s</enabled></peer-to-peer> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "abstract")) {
+			if (ni_parse_boolean(child->cdata, &conf->abstract)) {
+				ni_error("%s: invalid <peer-to-peer><abstract>%s</abstract></peer-to-peer> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "socket-dir")) {
+			if (ni_string_empty(child->cdata) || child->cdata[0] != '/') {
+				ni_error("%s: invalid <peer-to-peer><socket-dir>%s</socket-dir></peer-to-peer> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+			ni_string_dup(&conf->socket_dir, child->cdata);
+		}
+	}
+	return TRUE;
+}
+
+const char *
+ni_config_dbus_peer_socket_dir(void)
+{
+	static char dir[PATH_MAX];
+
+	if (!ni_global.config)
+		return NULL;
+
+	if (ni_global.config->dbus_peer.socket_dir)
+		return ni_global.config->dbus_peer.socket_dir;
+
+	snprintf(dir, sizeof(dir), "%s/dbus", ni_global.config->statedir.path);
+	return dir;
+}
+
+/*
+ * Return the dbus address of the peer-to-peer socket of a bus name,
+ * or NULL when the peer-to-peer transport is not enabled.
+ */
+const char *
+ni_config_dbus_peer_address(const char *bus_name, char **address)
+{
+	const char *dir;
+
+	if (!address || ni_string_empty(bus_name) || !ni_global.config)
+		return NULL;
+
+	if (!ni_global.config->dbus_peer.enabled)
+		return NULL;
+
+	dir = ni_config_dbus_peer_socket_dir();
+	if (ni_global.config->dbus_peer.abstract)
+		return ni_string_printf(address, "unix:abstract=%s/%s", dir, bus_name);
+	else
+		return ni_string_printf(address, "unix:path=%s/%s.socket", dir, bus_name);
+}
+
+static void
+ni_config_memory_stats_init(ni_config_memory_stats_t *conf)
+{
+	conf->interval = 900;
+	conf->samples = 96;
+}
+
+static ni_bool_t
+ni_config_parse_memory_stats(ni_config_memory_stats_t *conf, const xml_node_t *node)
+{
+	const xml_node_t *child;
+
+	if (!conf || !node)
+		return FALSE;
+
+	for (child = node->children; child; child = child->next) {
+		if (ni_string_eq(child->name, "interval")) {
+			if (ni_parse_uint(child->cdata, &conf->interval, 0)) {
+				ni_error("%s: invalid <memory-stats><interval>%s</interval></memory-stats> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		} else
+		if (ni_string_eq(child->name, "samples")) {
+			if (ni_parse_uint(child->cdata, &conf->samples, 0) ||
+			    conf->samples > 4096) {
+				ni_error("%s: invalid <memory-stats><samples>%s</samples></memory-stats> option",
+						xml_node_location(child), child->cdata);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+const ni_config_memory_stats_t *
+ni_config_memory_stats(void)
+{
+	static ni_config_memory_stats_t defaults;
+
+	if (ni_global.config)
+		return &ni_global.config->memory_stats;
+
+	if (!defaults.samples)
+		ni_config_memory_stats_init(&defaults);
+	return &defaults;
+}
+
 /*
  * Extension handling
  */
@@ -1946,6 +2365,30 @@ ni_config_use_nanny(void)
 	return ni_global.config ? ni_global.config->use_nanny : FALSE;
 }
 
+unsigned int
+ni_config_addrconf_lease_write_delay(void)
+{
+	return ni_global.config ? ni_global.config->addrconf.lease_write_delay : 0;
+}
+
+unsigned int
+ni_config_addrconf_arp_verify_concurrency(void)
+{
+	return ni_global.config ? ni_global.config->addrconf.arp_verify_concurrency : 0;
+}
+
+ni_bool_t
+ni_config_addrconf_dhcp6_shared_socket(void)
+{
+	return ni_global.config ? ni_global.config->addrconf.dhcp6.shared_socket : FALSE;
+}
+
+ni_bool_t
+ni_config_rtnl_event_shared_state(void)
+{
+	return ni_global.config ? ni_global.config->rtnl_event.shared_state : FALSE;
+}
+
 void
 ni_config_fslocation_init(ni_config_fslocation_t *loc, const char *path, unsigned int mode)
 {
@@ -22,6 +22,10 @@
 struct ni_dbus_client {
 	ni_dbus_connection_t *	connection;
 	char *			bus_name;
+	char *			bus_type;
+	char *			peer_address;
+	const ni_timer_t *	reconnect_timer;
+	unsigned int		reconnect_delay;
 	unsigned int		call_timeout;
 	const ni_intmap_t *	error_map;
 };
@@ -45,6 +49,14 @@ static dbus_bool_t	__ni_dbus_object_refresh_properties(ni_dbus_object_t *proxy,
 static void		__ni_dbus_object_mark_stale(ni_dbus_object_t *);
 static void		__ni_dbus_object_purge_stale(ni_dbus_object_t *);
 static const char *	__ni_dbus_print_argument(char, const void *);
+static void		ni_dbus_client_peer_disconnected(ni_dbus_connection_t *, void *);
+static void		ni_dbus_client_reconnect_timer(void *, const ni_timer_t *);
+
+/*
+ * Retry delays to get back to the peer socket of a restarted service
+ */
+#define NI_DBUS_CLIENT_RECONNECT_DELAY		100	/* msec */
+#define NI_DBUS_CLIENT_RECONNECT_DELAY_MAX	10000	/* msec */
 
 /*
  * Constructor for DBus client handle
@@ -67,6 +79,134 @@ ni_dbus_client_open(const char *bus_type, const char *bus_name)
 	return dbc;
 }
 
+/*
+ * Constructor for a DBus client handle talking to the service over its
+ * private peer-to-peer socket. Falls back to the bus when the service
+ * does not listen there or refuses us.
+ */
+ni_dbus_client_t *
+ni_dbus_client_open_peer(const char *address, const char *bus_type, const char *bus_name)
+{
+	ni_dbus_connection_t *conn;
+	ni_dbus_client_t *dbc;
+
+	if (ni_string_empty(address))
+		return ni_dbus_client_open(bus_type, bus_name);
+
+	NI_TRACE_ENTER_ARGS("address=%s, bus_type=%s, bus_name=%s", address, bus_type, bus_name);
+	if (!(conn = ni_dbus_connection_open_peer(address)))
+		conn = ni_dbus_connection_open(bus_type, NULL);
+	if (conn == NULL)
+		return NULL;
+
+	dbc = xcalloc(1, sizeof(*dbc));
+	ni_string_dup(&dbc->bus_name, bus_name);
+	ni_string_dup(&dbc->bus_type, bus_type);
+	ni_string_dup(&dbc->peer_address, address);
+	dbc->connection = conn;
+	dbc->call_timeout = 1000 * 60;
+	if (ni_dbus_connection_is_peer(conn))
+		ni_dbus_connection_set_disconnect_handler(conn, ni_dbus_client_peer_disconnected, dbc);
+	return dbc;
+}
+
+/*
+ * Replace the client connection by a connection to the peer socket
+ * or, unless a bus connection is in use already, to the bus and move
+ * the signal handlers to it.
+ */
+static ni_bool_t
+ni_dbus_client_reconnect(ni_dbus_client_t *dbc)
+{
+	ni_dbus_connection_t *conn;
+
+	if (!(conn = ni_dbus_connection_open_peer(dbc->peer_address))) {
+		if (!ni_dbus_connection_is_peer(dbc->connection) &&
+		    ni_dbus_connection_is_connected(dbc->connection))
+			return FALSE;
+		conn = ni_dbus_connection_open(dbc->bus_type, NULL);
+	}
+	if (conn == NULL)
+		return FALSE;
+
+	ni_debug_dbus("%s: reconnected to %s over the %s", __func__, dbc->bus_name,
+			ni_dbus_connection_is_peer(conn) ? "peer socket" : "bus");
+	if (ni_dbus_connection_is_peer(conn)) {
+		ni_dbus_connection_set_disconnect_handler(conn, ni_dbus_client_peer_disconnected, dbc);
+	} else if (!dbc->reconnect_timer) {
+		/* keep trying to get back to the peer socket */
+		dbc->reconnect_delay = NI_DBUS_CLIENT_RECONNECT_DELAY;
+		dbc->reconnect_timer = ni_timer_register(dbc->reconnect_delay,
+				ni_dbus_client_reconnect_timer, dbc);
+	}
+	ni_dbus_connection_move_signal_handlers(dbc->connection, conn);
+	ni_dbus_connection_free(dbc->connection);
+	dbc->connection = conn;
+	return TRUE;
+}
+
+/*
+ * A peer connection is lost when the service restarts. Reconnect from
+ * the main loop, so the signal handlers keep receiving the signals of
+ * the restarted service also without any call in between: over the bus
+ * until the service listens on its peer socket again, which is retried
+ * with an increasing delay, at most every 10 seconds, for as long as it
+ * takes.
+ */
+static void
+ni_dbus_client_reconnect_timer(void *user_data, const ni_timer_t *timer)
+{
+	ni_dbus_client_t *dbc = user_data;
+
+	if (dbc->reconnect_timer != timer)
+		return;
+	dbc->reconnect_timer = NULL;
+
+	if (ni_dbus_connection_is_peer(dbc->connection) &&
+	    ni_dbus_connection_is_connected(dbc->connection))
+		return;
+
+	ni_dbus_client_reconnect(dbc);
+	if (ni_dbus_connection_is_peer(dbc->connection) || dbc->reconnect_timer)
+		return;
+
+	if (dbc->reconnect_delay < NI_DBUS_CLIENT_RECONNECT_DELAY)
+		dbc->reconnect_delay = NI_DBUS_CLIENT_RECONNECT_DELAY;
+	else if (dbc->reconnect_delay < NI_DBUS_CLIENT_RECONNECT_DELAY_MAX / 2)
+		dbc->reconnect_delay *= 2;
+	else
+		dbc->reconnect_delay = NI_DBUS_CLIENT_RECONNECT_DELAY_MAX;
+	dbc->reconnect_timer = ni_timer_register(dbc->reconnect_delay,
+			ni_dbus_client_reconnect_timer, dbc);
+}
+
+static void
+ni_dbus_client_peer_disconnected(ni_dbus_connection_t *conn, void *user_data)
+{
+	ni_dbus_client_t *dbc = user_data;
+
+	if (dbc->connection != conn || dbc->reconnect_timer)
+		return;
+
+	dbc->reconnect_delay = 0;
+	dbc->reconnect_timer = ni_timer_register(0, ni_dbus_client_reconnect_timer, dbc);
+}
+
+/*
+ * Without a main loop, the lost peer connection is noticed and replaced
+ * before the next call.
+ */
+static ni_dbus_connection_t *
+ni_dbus_client_connection(ni_dbus_client_t *dbc)
+{
+	if (!dbc->peer_address || ni_dbus_connection_is_dispatching(dbc->connection) ||
+	    ni_dbus_connection_is_alive(dbc->connection))
+		return dbc->connection;
+
+	ni_dbus_client_reconnect(dbc);
+	return dbc->connection;
+}
+
 /*
  * Destructor for DBus client handle
  */
@@ -78,11 +218,17 @@ ni_dbus_client_free(ni_dbus_client_t *dbc)
 	if (!dbc)
 		return;
 
+	if (dbc->reconnect_timer)
+		ni_timer_cancel(dbc->reconnect_timer);
+	dbc->reconnect_timer = NULL;
+
 	if (dbc->connection)
 		ni_dbus_connection_free(dbc->connection);
 	dbc->connection = NULL;
 
 	ni_string_free(&dbc->bus_name);
+	ni_string_free(&dbc->bus_type);
+	ni_string_free(&dbc->peer_address);
 	free(dbc);
 }
 
@@ -205,7 +351,8 @@ ni_dbus_client_set_call_timeout(ni_dbus_client_t *dbc, unsigned int msec)
 ni_dbus_message_t *
 ni_dbus_client_call(ni_dbus_client_t *client, ni_dbus_message_t *call, DBusError *error)
 {
-	return ni_dbus_connection_call(client->connection, call, client->call_timeout, error);
+	return ni_dbus_connection_call(ni_dbus_client_connection(client), call,
+					client->call_timeout, error);
 }
 
 /*
@@ -219,7 +366,7 @@ ni_dbus_client_add_signal_handler(ni_dbus_client_t *client,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data)
 {
-	ni_dbus_add_signal_handler(client->connection,
+	ni_dbus_add_signal_handler(ni_dbus_client_connection(client),
 					sender, object_path, object_interface,
 					callback, user_data);
 }
@@ -461,7 +608,7 @@ ni_dbus_object_call_async(ni_dbus_object_t *proxy,
 		ni_error("%s: unable to build %s message", __FUNCTION__, method);
 		rv = -NI_ERROR_INVALID_ARGS;
 	} else {
-		rv = ni_dbus_connection_call_async(client->connection,
+		rv = ni_dbus_connection_call_async(ni_dbus_client_connection(client),
 			call, client->call_timeout,
 			callback, proxy);
 		dbus_message_unref(call);
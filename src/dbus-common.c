@@ -14,6 +14,7 @@
 #include "dbus-common.h"
 #include "dbus-dict.h"
 #include "debug.h"
+#include "memstat.h"
 
 int
 ni_dbus_translate_error(const DBusError *err, const ni_intmap_t *error_map)
@@ -590,7 +591,9 @@ __ni_dbus_array_grow(ni_dbus_variant_t *var, size_t element_size, unsigned int g
 					__FUNCTION__, len + grow_by);
 
 		memcpy(new_data, var->byte_array_value, len * element_size);
+		ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->byte_array_value);
 		free(var->byte_array_value);
+		ni_memstat_alloc(NI_MEMSTAT_DBUS_VARIANT, new_data);
 		var->byte_array_value = new_data;
 	}
 }
@@ -751,17 +754,20 @@ ni_dbus_variant_destroy(ni_dbus_variant_t *var)
 
 		switch (var->array.element_type) {
 		case DBUS_TYPE_BYTE:
+			ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->byte_array_value);
 			free(var->byte_array_value);
 			break;
 		case DBUS_TYPE_STRING:
 		case DBUS_TYPE_OBJECT_PATH:
 			for (i = 0; i < var->array.len; ++i)
 				free(var->string_array_value[i]);
+			ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->string_array_value);
 			free(var->string_array_value);
 			break;
 		case DBUS_TYPE_DICT_ENTRY:
 			for (i = 0; i < var->array.len; ++i)
 				ni_dbus_variant_destroy(&var->dict_array_value[i].datum);
+			ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->dict_array_value);
 			free(var->dict_array_value);
 			break;
 		case DBUS_TYPE_INVALID:
@@ -771,11 +777,13 @@ ni_dbus_variant_destroy(ni_dbus_variant_t *var)
 		case DBUS_TYPE_VARIANT:
 			for (i = 0; i < var->array.len; ++i)
 				ni_dbus_variant_destroy(&var->variant_array_value[i]);
+			ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->variant_array_value);
 			free(var->variant_array_value);
 			break;
 		case DBUS_TYPE_STRUCT:
 			for (i = 0; i < var->array.len; ++i)
 				ni_dbus_variant_destroy(&var->struct_value[i]);
+			ni_memstat_free(NI_MEMSTAT_DBUS_VARIANT, var->struct_value);
 			free(var->struct_value);
 			break;
 		default:
@@ -21,6 +21,8 @@
 
 #undef DEBUG_WATCH_VERBOSE
 
+#define NI_DBUS_PEER_PING_TIMEOUT	(1000 * 5)
+
 typedef struct ni_dbus_async_client_call ni_dbus_async_client_call_t;
 struct ni_dbus_async_client_call {
 	ni_dbus_async_client_call_t *next;
@@ -52,11 +54,15 @@ struct ni_dbus_sigaction {
 struct ni_dbus_connection {
 	DBusConnection *	conn;
 	ni_bool_t		private;
+	ni_bool_t		peer;
 
 	ni_dbus_async_client_call_t *async_client_calls;
 	ni_dbus_async_server_call_t *async_server_calls;
 	ni_dbus_sigaction_t *	sighandlers;
 
+	ni_dbus_disconnect_handler_t *disconnect_handler;
+	void *			disconnect_data;
+
 	ni_bool_t		dispatching;
 };
 
@@ -85,8 +91,10 @@ static void			__ni_dbus_async_client_call_free(ni_dbus_async_client_call_t *);
 static void			__ni_dbus_notify_async(DBusPendingCall *, void *);
 static dbus_bool_t		__ni_dbus_add_watch(DBusWatch *, void *);
 static void			__ni_dbus_remove_watch(DBusWatch *, void *);
+static void			__ni_dbus_toggle_watch(DBusWatch *, void *);
 static DBusHandlerResult	__ni_dbus_signal_filter(DBusConnection *, DBusMessage *, void *);
 static void			__ni_dbus_connection_dispatch(ni_dbus_connection_t *);
+static void			__ni_dbus_connection_setup(ni_dbus_connection_t *);
 
 static int			ni_dbus_use_socket_mainloop = 1;
 
@@ -189,25 +197,147 @@ ni_dbus_connection_open(const char *bus_type_string, const char *bus_name)
 		ni_debug_dbus("Successfully acquired bus name \"%s\"", bus_name);
 	}
 
+	__ni_dbus_connection_setup(connection);
+	return connection;
+
+failed_unexpectedly:
+	ni_error("%s: unexpected error", __FUNCTION__);
+
+failed:
+	ni_dbus_connection_free(connection);
+	dbus_error_free(&error);
+	return NULL;
+}
+
+/*
+ * Constructor for a private peer-to-peer connection to the socket
+ * a wicked service listens on. The connection is only returned once
+ * the service authenticated us and answered a Peer.Ping().
+ */
+ni_dbus_connection_t *
+ni_dbus_connection_open_peer(const char *address)
+{
+	ni_dbus_connection_t *connection;
+	DBusError error = DBUS_ERROR_INIT;
+	DBusMessage *call = NULL, *reply = NULL;
+
+	NI_TRACE_ENTER_ARGS("address=%s", address);
+
+	connection = xcalloc(1, sizeof(*connection));
+	connection->private = TRUE;
+	connection->peer = TRUE;
+
+	connection->conn = dbus_connection_open_private(address, &error);
+	if (dbus_error_is_set(&error)) {
+		ni_debug_dbus("Cannot open dbus peer connection to %s (%s)",
+				address, error.message);
+		goto failed;
+	}
+	if (connection->conn == NULL)
+		goto failed;
+
+	dbus_connection_set_exit_on_disconnect(connection->conn, FALSE);
+	__ni_dbus_connection_setup(connection);
+
+	call = dbus_message_new_method_call(NULL, "/", DBUS_INTERFACE_PEER, "Ping");
+	if (call == NULL)
+		goto failed;
+
+	reply = ni_dbus_connection_call(connection, call, NI_DBUS_PEER_PING_TIMEOUT, &error);
+	if (reply == NULL) {
+		ni_debug_dbus("dbus peer %s did not answer (%s)", address,
+				dbus_error_is_set(&error) ? error.message : "no reply");
+		goto failed;
+	}
+
+	ni_debug_dbus("Connected to dbus peer %s", address);
+	dbus_message_unref(reply);
+	dbus_message_unref(call);
+	return connection;
+
+failed:
+	if (call)
+		dbus_message_unref(call);
+	ni_dbus_connection_free(connection);
+	dbus_error_free(&error);
+	return NULL;
+}
+
+/*
+ * Wrap a connection a peer opened to our own peer-to-peer socket
+ */
+ni_dbus_connection_t *
+ni_dbus_connection_wrap_peer(DBusConnection *conn)
+{
+	ni_dbus_connection_t *connection;
+
+	connection = xcalloc(1, sizeof(*connection));
+	connection->conn = dbus_connection_ref(conn);
+	connection->private = TRUE;
+	connection->peer = TRUE;
+
+	dbus_connection_set_exit_on_disconnect(connection->conn, FALSE);
+	__ni_dbus_connection_setup(connection);
+	return connection;
+}
+
+static void
+__ni_dbus_connection_setup(ni_dbus_connection_t *connection)
+{
 	dbus_connection_add_filter(connection->conn, __ni_dbus_signal_filter, connection, NULL);
 	if (ni_dbus_use_socket_mainloop) {
 		dbus_connection_set_watch_functions(connection->conn,
 				__ni_dbus_add_watch,
 				__ni_dbus_remove_watch,
-				NULL,			/* toggle_function */
+				__ni_dbus_toggle_watch,
 				connection,		/* data */
 				NULL);			/* free_data_function */
 	}
+}
 
-	return connection;
+ni_bool_t
+ni_dbus_connection_is_peer(const ni_dbus_connection_t *connection)
+{
+	return connection && connection->peer;
+}
 
-failed_unexpectedly:
-	ni_error("%s: unexpected error", __FUNCTION__);
+ni_bool_t
+ni_dbus_connection_is_connected(const ni_dbus_connection_t *connection)
+{
+	return connection && connection->conn &&
+		dbus_connection_get_is_connected(connection->conn);
+}
 
-failed:
-	ni_dbus_connection_free(connection);
-	dbus_error_free(&error);
-	return NULL;
+/*
+ * A peer which went away is only noticed when reading from it,
+ * so check for a pending hangup without blocking.
+ */
+ni_bool_t
+ni_dbus_connection_is_alive(ni_dbus_connection_t *connection)
+{
+	if (!ni_dbus_connection_is_connected(connection))
+		return FALSE;
+	if (connection->peer && !connection->dispatching)
+		dbus_connection_read_write(connection->conn, 0);
+	return dbus_connection_get_is_connected(connection->conn);
+}
+
+ni_bool_t
+ni_dbus_connection_is_dispatching(const ni_dbus_connection_t *connection)
+{
+	return connection && connection->dispatching;
+}
+
+/*
+ * Notify about the loss of a peer connection. The handler is called
+ * while dispatching and must not free the connection.
+ */
+void
+ni_dbus_connection_set_disconnect_handler(ni_dbus_connection_t *connection,
+				ni_dbus_disconnect_handler_t *handler, void *user_data)
+{
+	connection->disconnect_handler = handler;
+	connection->disconnect_data = user_data;
 }
 
 /*
@@ -413,13 +543,16 @@ ni_dbus_connection_send_error(ni_dbus_connection_t *connection, ni_dbus_message_
  * Signal handling
  */
 static ni_dbus_sigaction_t *
-__ni_sigaction_new(const char *object_interface,
+__ni_sigaction_new(const char *sender, const char *object_path,
+				const char *object_interface,
 				ni_dbus_signal_handler_t *callback,
 				void *user_data)
 {
 	ni_dbus_sigaction_t *s;
 
 	s = calloc(1, sizeof(*s));
+	ni_string_dup(&s->sender, sender);
+	ni_string_dup(&s->object_path, object_path);
 	ni_string_dup(&s->object_interface, object_interface);
 	s->signal_handler = callback;
 	s->user_data = user_data;
@@ -430,6 +563,8 @@ __ni_sigaction_new(const char *object_interface,
 static void
 __ni_dbus_sigaction_free(ni_dbus_sigaction_t *s)
 {
+	ni_string_free(&s->sender);
+	ni_string_free(&s->object_path);
 	ni_string_free(&s->object_interface);
 	free(s);
 }
@@ -447,6 +582,10 @@ ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
 	ni_dbus_sigaction_t *sigact;
 	char specbuf[1024], *arg;
 
+	/* A peer sends us all of its signals, there is no bus to ask */
+	if (connection->peer)
+		goto add;
+
 	if (sender && object_path && object_interface) {
 		snprintf(specbuf, sizeof(specbuf), "type='signal',sender='%s',path='%s',interface='%s'",
 			sender, object_path, object_interface);
@@ -467,7 +606,8 @@ ni_dbus_add_signal_handler(ni_dbus_connection_t *connection,
 	if ((reply = ni_dbus_connection_call(connection, call, 1000 * 10, &error)) == NULL)
 		goto out;
 
-	sigact = __ni_sigaction_new(object_interface, callback, user_data);
+add:
+	sigact = __ni_sigaction_new(sender, object_path, object_interface, callback, user_data);
 	sigact->next = connection->sighandlers;
 	connection->sighandlers = sigact;
 
@@ -484,6 +624,23 @@ failed:
 	goto out;
 }
 
+/*
+ * Move the signal handlers of a lost connection to the one replacing it
+ */
+void
+ni_dbus_connection_move_signal_handlers(ni_dbus_connection_t *from, ni_dbus_connection_t *to)
+{
+	ni_dbus_sigaction_t *sig;
+
+	while ((sig = from->sighandlers) != NULL) {
+		from->sighandlers = sig->next;
+		ni_dbus_add_signal_handler(to, sig->sender, sig->object_path,
+				sig->object_interface, sig->signal_handler,
+				sig->user_data);
+		__ni_dbus_sigaction_free(sig);
+	}
+}
+
 static DBusHandlerResult
 __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 {
@@ -498,6 +655,13 @@ __ni_dbus_signal_filter(DBusConnection *conn, DBusMessage *msg, void *user_data)
 	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
+	/* A peer going away is only reported to ourselves */
+	if (connection->peer && dbus_message_is_signal(msg, DBUS_INTERFACE_LOCAL, "Disconnected")) {
+		ni_debug_dbus("dbus peer connection %p disconnected", connection);
+		if (connection->disconnect_handler)
+			connection->disconnect_handler(connection, connection->disconnect_data);
+	}
+
 	interface = dbus_message_get_interface(msg);
 	for (sigact = connection->sighandlers; sigact; sigact = sigact->next) {
 		if (!strcmp(sigact->object_interface, interface)) {
@@ -631,6 +795,19 @@ ni_dbus_connection_get_caller_uid(ni_dbus_connection_t *conn, const char *name,
 	uint32_t user_id;
 	int rv = 0;
 
+	/* A peer was authenticated with its credentials on connect */
+	if (conn->peer) {
+		unsigned long peer_uid;
+
+		if (!dbus_connection_get_unix_user(conn->conn, &peer_uid))
+			return -NI_ERROR_PERMISSION_DENIED;
+
+		ni_debug_dbus("%s(peer): user_id=%lu", __func__, peer_uid);
+		if (uidp)
+			*uidp = peer_uid;
+		return 0;
+	}
+
 	call = dbus_message_new_method_call("org.freedesktop.DBus",
 					"/org/freedesktop/DBus",
 					"org.freedesktop.DBus",
@@ -699,11 +876,38 @@ __ni_dbus_watch_flags(int flags)
 	return "???";
 }
 
+/*
+ * Poll for what any enabled watch of the socket is waiting for
+ */
+static void
+__ni_dbus_watch_update_poll_flags(ni_socket_t *sock)
+{
+	ni_dbus_watch_data_t *wd;
+	int poll_flags = 0;
+
+	if (sock == NULL)
+		return;
+
+	for (wd = ni_dbus_watches; wd; wd = wd->next) {
+		int watch_flags;
+
+		if (wd->socket != sock || !dbus_watch_get_enabled(wd->watch))
+			continue;
+
+		watch_flags = dbus_watch_get_flags(wd->watch);
+		if (watch_flags & DBUS_WATCH_READABLE)
+			poll_flags |= POLLIN;
+		if (watch_flags & DBUS_WATCH_WRITABLE)
+			poll_flags |= POLLOUT;
+	}
+	sock->poll_flags = poll_flags;
+}
+
 static inline void
 __ni_dbus_watch_handle(const char *func, ni_socket_t *sock, int flags)
 {
 	ni_dbus_watch_data_t *wd;
-	int found = 0, poll_flags = 0;
+	int found = 0;
 
 	/* All of this is somewhat more complicated than it may need to be.
 	 * For some odd reason, libdbus insists on maintaining two watches
@@ -712,9 +916,8 @@ __ni_dbus_watch_handle(const char *func, ni_socket_t *sock, int flags)
 	 */
 restart:
 	for (wd = ni_dbus_watches; wd; wd = wd->next) {
-		int new_watch_flags;
 #ifdef DEBUG_WATCH_VERBOSE
-		int old_watch_flags;
+		int old_watch_flags, new_watch_flags;
 #endif
 
 		if (wd->socket != sock)
@@ -736,6 +939,10 @@ restart:
 			ni_debug_dbus("%s wd %p has state %s, releasing",__func__,
 					wd, __ni_dbus_wd_state_name(wd->state));
 #endif
+			/* a lost connection has queued its Disconnected signal */
+			if (dbus_connection_get_dispatch_status(wd->connection->conn) ==
+					DBUS_DISPATCH_DATA_REMAINS)
+				__ni_dbus_connection_dispatch(wd->connection);
 			__ni_put_dbus_watch_data(wd);
 			goto restart;
 		}
@@ -743,15 +950,8 @@ restart:
 		if (flags & (DBUS_WATCH_READABLE | DBUS_WATCH_WRITABLE))
 			__ni_dbus_connection_dispatch(wd->connection);
 
-		new_watch_flags = dbus_watch_get_flags(wd->watch);
-		if (dbus_watch_get_enabled(wd->watch)) {
-			if (new_watch_flags & DBUS_WATCH_READABLE)
-				poll_flags |= POLLIN;
-			if (new_watch_flags & DBUS_WATCH_WRITABLE)
-				poll_flags |= POLLOUT;
-		}
-
 #ifdef DEBUG_WATCH_VERBOSE
+		new_watch_flags = dbus_watch_get_flags(wd->watch);
 		if (old_watch_flags != new_watch_flags) {
 			ni_debug_dbus("%s: changing watch flags %s to %s",
 					__func__,
@@ -762,7 +962,8 @@ restart:
 		__ni_put_dbus_watch_data(wd);
 	}
 
-	sock->poll_flags = poll_flags;
+	/* the watches may have been toggled while handling them */
+	__ni_dbus_watch_update_poll_flags(sock);
 	if (!found)
 		ni_warn("%s: dead socket", func);
 }
@@ -888,6 +1089,23 @@ __ni_dbus_remove_watch(DBusWatch *watch, void *dummy)
 	ni_warn("%s(%p): watch not found", __FUNCTION__, watch);
 }
 
+/*
+ * A connection enables its read watch only once authenticated,
+ * and its write watch whenever it has data queued.
+ */
+static void
+__ni_dbus_toggle_watch(DBusWatch *watch, void *dummy)
+{
+	ni_dbus_watch_data_t *wd;
+
+	for (wd = ni_dbus_watches; wd; wd = wd->next) {
+		if (wd->watch == watch) {
+			__ni_dbus_watch_update_poll_flags(wd->socket);
+			break;
+		}
+	}
+}
+
 void
 __ni_dbus_connection_dispatch(ni_dbus_connection_t *connection)
 {
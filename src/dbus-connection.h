@@ -11,7 +11,17 @@
 #include <dbus/dbus.h>
 #include "dbus-common.h"
 
+typedef void			ni_dbus_disconnect_handler_t(ni_dbus_connection_t *, void *);
+
 extern ni_dbus_connection_t *	ni_dbus_connection_open(const char *bus_type, const char *bus_name);
+extern ni_dbus_connection_t *	ni_dbus_connection_open_peer(const char *address);
+extern ni_dbus_connection_t *	ni_dbus_connection_wrap_peer(DBusConnection *);
+extern ni_bool_t		ni_dbus_connection_is_peer(const ni_dbus_connection_t *);
+extern ni_bool_t		ni_dbus_connection_is_connected(const ni_dbus_connection_t *);
+extern ni_bool_t		ni_dbus_connection_is_alive(ni_dbus_connection_t *);
+extern ni_bool_t		ni_dbus_connection_is_dispatching(const ni_dbus_connection_t *);
+extern void			ni_dbus_connection_set_disconnect_handler(ni_dbus_connection_t *,
+					ni_dbus_disconnect_handler_t *, void *);
 extern void			ni_dbus_connection_free(ni_dbus_connection_t *);
 extern ni_dbus_message_t *	ni_dbus_connection_call(ni_dbus_connection_t *connection,
 					ni_dbus_message_t *call, unsigned int call_timeout, DBusError *error);
@@ -26,6 +36,8 @@ extern void			ni_dbus_add_signal_handler(ni_dbus_connection_t *conn,
 					const char *object_interface,
 					ni_dbus_signal_handler_t *callback,
 					void *user_data);
+extern void			ni_dbus_connection_move_signal_handlers(ni_dbus_connection_t *from,
+					ni_dbus_connection_t *to);
 extern void			ni_dbus_connection_register_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern void			ni_dbus_connection_unregister_object(ni_dbus_connection_t *, ni_dbus_object_t *);
 extern int			ni_dbus_async_server_call_run_command(ni_dbus_connection_t *conn,
@@ -23,6 +23,7 @@
 #include <wicked/dbus-service.h>
 #include <wicked/system.h>
 #include <wicked/xml.h>
+#include <wicked/xpath.h>
 #include "netinfo_priv.h"
 #include "dbus-common.h"
 #include "xml-schema.h"
@@ -458,10 +459,131 @@ ni_objectmodel_netif_list_get_addresses(ni_dbus_object_t *object, const ni_dbus_
 	return rv;
 }
 
+/*
+ * InterfaceList.query
+ *
+ * Expand an xpath format string against the properties of the
+ * interfaces, in the same xml representation "wicked show-xml"
+ * uses, and return the expanded strings only.
+ * Every interface object is converted to xml and evaluated on its
+ * own; the xml document of all interfaces is never built. When a
+ * reference expression is given, the format is expanded for every
+ * element it refers to, as done by "wicked xpath --reference".
+ */
+static xml_node_t *
+ni_objectmodel_netif_list_query_xml(ni_dbus_object_t *object, DBusError *error)
+{
+	const ni_dbus_service_t *service;
+	xml_node_t *root, *node;
+	unsigned int i;
+
+	root = xml_node_new(NULL, NULL);
+	node = xml_node_new("object", root);
+	xml_node_add_attr(node, "path", object->path);
+
+	for (i = 0; object->interfaces && (service = object->interfaces[i]); ++i) {
+		ni_dbus_variant_t dict = NI_DBUS_VARIANT_INIT;
+
+		/* Ignore well-known interfaces that never have properties */
+		if (!ni_string_startswith(service->name, NI_OBJECTMODEL_NAMESPACE))
+			continue;
+
+		ni_dbus_variant_init_dict(&dict);
+		if (!ni_dbus_object_get_properties_as_dict(object, service, &dict, error)) {
+			ni_dbus_variant_destroy(&dict);
+			xml_node_free(root);
+			return NULL;
+		}
+		ni_dbus_xml_deserialize_properties(__ni_objectmodel_schema,
+						service->name, &dict, node);
+		ni_dbus_variant_destroy(&dict);
+	}
+
+	return root;
+}
+
+static dbus_bool_t
+ni_objectmodel_netif_list_query(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+			unsigned int argc, const ni_dbus_variant_t *argv,
+			ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_string_array_t strings = NI_STRING_ARRAY_INIT;
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	const char *format_string = NULL, *reference = NULL;
+	xpath_enode_t *enode = NULL;
+	xpath_format_t *format;
+	ni_dbus_object_t *child;
+	dbus_bool_t rv = FALSE;
+
+	if (argc != 1 || !ni_dbus_variant_is_dict(&argv[0])
+	 || !ni_dbus_dict_get_string(&argv[0], "format", &format_string))
+		return ni_dbus_error_invalid_args(error, object->path, method->name);
+
+	ni_dbus_dict_get_string(&argv[0], "reference", &reference);
+
+	if (!(format = xpath_format_parse(format_string))) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s.%s: cannot parse xpath format \"%s\"",
+				object->path, method->name, format_string);
+		return FALSE;
+	}
+	if (!ni_string_empty(reference) && !(enode = xpath_expression_parse(reference))) {
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"%s.%s: cannot parse xpath expression \"%s\"",
+				object->path, method->name, reference);
+		goto out;
+	}
+
+	for (child = object->children; child; child = child->next) {
+		xpath_iter_t *iter = NULL;
+		xml_node_t *root, *node;
+
+		if (child->class && child->class->refresh && !child->class->refresh(child))
+			continue;
+
+		if (!(root = ni_objectmodel_netif_list_query_xml(child, error)))
+			goto out;
+
+		if (enode && !(iter = xpath_iter_new(enode, root))) {
+			xml_node_free(root);
+			dbus_set_error(error, DBUS_ERROR_FAILED,
+					"%s.%s: cannot evaluate xpath expression \"%s\"",
+					object->path, method->name, reference);
+			goto out;
+		}
+
+		node = iter ? xpath_iter_next(iter) : root;
+		for (; node; node = iter ? xpath_iter_next(iter) : NULL) {
+			if (!xpath_format_eval(format, node, &strings))
+				break;
+		}
+
+		xpath_iter_free(iter);
+		xml_node_free(root);
+		if (node) {
+			dbus_set_error(error, DBUS_ERROR_FAILED,
+					"%s.%s: cannot evaluate xpath format \"%s\"",
+					object->path, method->name, format_string);
+			goto out;
+		}
+	}
+
+	ni_dbus_variant_set_string_array(&result, (const char **)strings.data, strings.count);
+	rv = ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+
+out:
+	ni_string_array_destroy(&strings);
+	xpath_expression_free(enode);
+	xpath_format_free(format);
+	return rv;
+}
+
 static ni_dbus_method_t		ni_objectmodel_netif_list_methods[] = {
 	{ "deviceByName",	"s",		.handler = ni_objectmodel_netif_list_device_by_name },
 	{ "identifyDevice",	"sa{sv}",	.handler = ni_objectmodel_netif_list_identify_device },
 	{ "getAddresses",	"a{sv}",	.handler = ni_objectmodel_netif_list_get_addresses },
+	{ "query",		"a{sv}",	.handler = ni_objectmodel_netif_list_query },
 	{ NULL }
 };
 
@@ -0,0 +1,195 @@
+/*
+ * DBus encapsulation of the daemon latency metrics
+ *
+ * The service is registered with the root object of each daemon
+ * and exports the metrics of this daemon process as a dict of
+ * handler name to a dict of the counters and latency histogram,
+ * and its memory accounting as a dict of the tag counters, the
+ * process heap usage and the periodic samples.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/dbus.h>
+#include <wicked/dbus-service.h>
+#include <wicked/objectmodel.h>
+#include "metrics.h"
+#include "memstat.h"
+
+static dbus_bool_t
+ni_objectmodel_metric_to_dict(const ni_metric_t *metric, ni_dbus_variant_t *dict)
+{
+	ni_dbus_variant_t *histogram;
+	unsigned int i;
+
+	ni_dbus_dict_add_uint64(dict, "count", metric->count);
+	ni_dbus_dict_add_uint64(dict, "failed", metric->failed);
+	ni_dbus_dict_add_uint64(dict, "total-usec", metric->total);
+	ni_dbus_dict_add_uint64(dict, "max-usec", metric->max);
+
+	/* the non-empty buckets, keyed by their upper bound in usec */
+	if (!(histogram = ni_dbus_dict_add(dict, "histogram")))
+		return FALSE;
+	ni_dbus_variant_init_dict(histogram);
+	for (i = 0; i < NI_METRIC_BUCKETS; ++i) {
+		if (metric->buckets[i])
+			ni_dbus_dict_add_uint64(histogram,
+					ni_metric_bucket_name(i),
+					metric->buckets[i]);
+	}
+	return TRUE;
+}
+
+static dbus_bool_t
+ni_objectmodel_metrics_get_since(const ni_dbus_object_t *object,
+				const ni_dbus_property_t *property,
+				ni_dbus_variant_t *result,
+				DBusError *error)
+{
+	ni_dbus_variant_set_uint64(result, ni_metrics_since());
+	return TRUE;
+}
+
+static dbus_bool_t
+ni_objectmodel_metrics_get_handlers(const ni_dbus_object_t *object,
+				const ni_dbus_property_t *property,
+				ni_dbus_variant_t *result,
+				DBusError *error)
+{
+	const ni_metric_t *metric;
+	ni_dbus_variant_t *dict;
+
+	ni_dbus_variant_init_dict(result);
+	for (metric = ni_metrics_list(); metric; metric = metric->next) {
+		if (!(dict = ni_dbus_dict_add(result, metric->name)))
+			return FALSE;
+
+		ni_dbus_variant_init_dict(dict);
+		if (!ni_objectmodel_metric_to_dict(metric, dict))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+ni_objectmodel_memstat_heap_to_dict(const ni_memstat_heap_t *heap, ni_dbus_variant_t *dict)
+{
+	ni_dbus_dict_add_uint64(dict, "arena", heap->arena);
+	ni_dbus_dict_add_uint64(dict, "mmap", heap->mmap);
+	ni_dbus_dict_add_uint64(dict, "in-use", heap->in_use);
+}
+
+static dbus_bool_t
+ni_objectmodel_memstat_sample_to_dict(const ni_memstat_sample_t *sample, ni_dbus_variant_t *dict)
+{
+	ni_dbus_variant_t *objects, *bytes;
+	unsigned int i;
+
+	ni_dbus_dict_add_uint64(dict, "time", sample->time);
+	ni_dbus_dict_add_uint64(dict, "heap-in-use", sample->heap.in_use);
+
+	if (!(objects = ni_dbus_dict_add(dict, "objects")) ||
+	    !(bytes = ni_dbus_dict_add(dict, "bytes")))
+		return FALSE;
+	ni_dbus_variant_init_dict(objects);
+	ni_dbus_variant_init_dict(bytes);
+	for (i = 0; i < NI_MEMSTAT_TAGS; ++i) {
+		ni_dbus_dict_add_uint64(objects, ni_memstat_tag_name(i), sample->objects[i]);
+		ni_dbus_dict_add_uint64(bytes, ni_memstat_tag_name(i), sample->bytes[i]);
+	}
+	return TRUE;
+}
+
+static dbus_bool_t
+ni_objectmodel_metrics_get_memory(const ni_dbus_object_t *object,
+				const ni_dbus_property_t *property,
+				ni_dbus_variant_t *result,
+				DBusError *error)
+{
+	const ni_memstat_sample_t *sample;
+	ni_dbus_variant_t *tags, *dict, *samples;
+	ni_memstat_heap_t heap;
+	unsigned int i;
+
+	ni_dbus_variant_init_dict(result);
+
+	if (!(tags = ni_dbus_dict_add(result, "tags")))
+		return FALSE;
+	ni_dbus_variant_init_dict(tags);
+	for (i = 0; i < NI_MEMSTAT_TAGS; ++i) {
+		const ni_memstat_t *stat = &ni_memstat_tags[i];
+
+		if (!(dict = ni_dbus_dict_add(tags, ni_memstat_tag_name(i))))
+			return FALSE;
+		ni_dbus_variant_init_dict(dict);
+		ni_dbus_dict_add_uint64(dict, "objects", stat->objects);
+		ni_dbus_dict_add_uint64(dict, "bytes", stat->bytes);
+		ni_dbus_dict_add_uint64(dict, "allocs", stat->allocs);
+		ni_dbus_dict_add_uint64(dict, "frees", stat->frees);
+	}
+
+	if (!(dict = ni_dbus_dict_add(result, "heap")))
+		return FALSE;
+	ni_dbus_variant_init_dict(dict);
+	ni_memstat_heap(&heap);
+	ni_objectmodel_memstat_heap_to_dict(&heap, dict);
+
+	if (!(samples = ni_dbus_dict_add(result, "samples")))
+		return FALSE;
+	ni_dbus_dict_array_init(samples);
+	for (i = 0; (sample = ni_memstat_sample(i)); ++i) {
+		if (!(dict = ni_dbus_dict_array_add(samples)))
+			return FALSE;
+		if (!ni_objectmodel_memstat_sample_to_dict(sample, dict))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Metrics.reset()
+ */
+static dbus_bool_t
+ni_objectmodel_metrics_reset(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+				unsigned int argc, const ni_dbus_variant_t *argv,
+				ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_debug_dbus("%s: resetting metrics", object->path);
+	ni_metrics_reset();
+	return TRUE;
+}
+
+static const ni_dbus_property_t		ni_objectmodel_metrics_properties[] = {
+	{
+		.name		= "since",
+		.signature	= DBUS_TYPE_UINT64_AS_STRING,
+		.get		= ni_objectmodel_metrics_get_since,
+	},
+	{
+		.name		= "handlers",
+		.signature	= NI_DBUS_DICT_SIGNATURE,
+		.get		= ni_objectmodel_metrics_get_handlers,
+	},
+	{
+		.name		= "memory",
+		.signature	= NI_DBUS_DICT_SIGNATURE,
+		.get		= ni_objectmodel_metrics_get_memory,
+	},
+	{ NULL }
+};
+
+static const ni_dbus_method_t		ni_objectmodel_metrics_methods[] = {
+	{ "reset",		"",		.handler = ni_objectmodel_metrics_reset },
+	{ NULL }
+};
+
+const ni_dbus_service_t			ni_objectmodel_metrics_service = {
+	.name		= NI_OBJECTMODEL_METRICS_INTERFACE,
+	.properties	= ni_objectmodel_metrics_properties,
+	.methods	= ni_objectmodel_metrics_methods,
+};
@@ -7,15 +7,20 @@
 #include "config.h"
 #endif
 
+#include <unistd.h>
+
 #include <wicked/util.h>
 #include <wicked/logging.h>
+#include <wicked/socket.h>
 #include <wicked/dbus-service.h>
 #include <wicked/dbus-errors.h>
+#include "socket_priv.h"
 #include "dbus-server.h"
 #include "dbus-object.h"
 #include "dbus-dict.h"
 #include "debug.h"
 #include "util_priv.h"
+#include "metrics.h"
 
 
 struct ni_dbus_server_object {
@@ -26,15 +31,28 @@ static const ni_dbus_class_t	dbus_root_object_class = {
 	.name = "<root>",
 };
 
+typedef struct ni_dbus_server_peer {
+	ni_dbus_server_t *	server;
+	ni_dbus_connection_t *	connection;
+} ni_dbus_server_peer_t;
+
 struct ni_dbus_server {
 	ni_dbus_connection_t *	connection;
 	ni_dbus_object_t *	root_object;
+
+	DBusServer *		listener;
+	struct {
+	    unsigned int	count;
+	    ni_dbus_server_peer_t **data;
+	} peers;
 };
 
 static dbus_bool_t		ni_dbus_object_register_object_manager(ni_dbus_object_t *);
 static dbus_bool_t		ni_dbus_object_register_introspectable_interface(ni_dbus_object_t *);
 static const char *		__ni_dbus_server_root_path(const char *);
 static void			__ni_dbus_server_object_init(ni_dbus_object_t *object, ni_dbus_server_t *server);
+static void			__ni_dbus_server_close_peers(ni_dbus_server_t *, ni_bool_t);
+static DBusHandlerResult	__ni_dbus_object_dispatch(ni_dbus_connection_t *, DBusMessage *, ni_dbus_object_t *);
 
 /*
  * Constructor for DBus server handle
@@ -71,6 +89,15 @@ ni_dbus_server_free(ni_dbus_server_t *server)
 {
 	NI_TRACE_ENTER();
 
+	if (server->listener) {
+		dbus_server_disconnect(server->listener);
+		dbus_server_unref(server->listener);
+		server->listener = NULL;
+	}
+	__ni_dbus_server_close_peers(server, TRUE);
+	free(server->peers.data);
+	server->peers.data = NULL;
+
 	if (server->root_object)
 		__ni_dbus_object_free(server->root_object);
 	server->root_object = NULL;
@@ -91,6 +118,191 @@ ni_dbus_server_get_root_object(const ni_dbus_server_t *server)
 	return server->root_object;
 }
 
+/*
+ * Private peer-to-peer transport.
+ *
+ * Besides owning its name on the bus, a server may listen on a unix
+ * socket of its own, so the other wicked daemons can talk to it without
+ * every call, reply and signal being copied and policy checked by the
+ * bus daemon. Only root and our own user may connect; the calls are
+ * dispatched to the same objects as the bus calls and the signals are
+ * sent to the bus and to every connected peer.
+ */
+static dbus_bool_t
+__ni_dbus_server_peer_allow_user(DBusConnection *conn, unsigned long uid, void *user_data)
+{
+	if (uid == 0 || uid == (unsigned long)geteuid())
+		return TRUE;
+
+	ni_debug_dbus("refusing dbus peer connection of uid %lu", uid);
+	return FALSE;
+}
+
+static ni_dbus_object_t *
+__ni_dbus_server_peer_lookup_object(ni_dbus_server_t *server, const char *path)
+{
+	ni_dbus_object_t *object;
+
+	if (!path || !ni_dbus_object_get_relative_path(server->root_object, path))
+		return NULL;
+
+	object = ni_dbus_object_lookup(server->root_object, path);
+	if (!object || ni_dbus_object_get_server(object) != server)
+		return NULL;
+	return object;
+}
+
+static DBusHandlerResult
+__ni_dbus_server_peer_message(DBusConnection *conn, DBusMessage *call, void *user_data)
+{
+	ni_dbus_server_peer_t *peer = user_data;
+	ni_dbus_object_t *object;
+
+	object = __ni_dbus_server_peer_lookup_object(peer->server, dbus_message_get_path(call));
+	if (object == NULL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	return __ni_dbus_object_dispatch(peer->connection, call, object);
+}
+
+static const DBusObjectPathVTable	__ni_dbus_server_peer_vtable = {
+	.message_function = __ni_dbus_server_peer_message,
+};
+
+static void
+__ni_dbus_server_peer_free(ni_dbus_server_peer_t *peer)
+{
+	ni_dbus_connection_free(peer->connection);
+	free(peer);
+}
+
+/*
+ * Release the peers which went away (or all of them)
+ */
+static void
+__ni_dbus_server_close_peers(ni_dbus_server_t *server, ni_bool_t all)
+{
+	ni_dbus_server_peer_t *peer;
+	unsigned int i;
+
+	for (i = 0; i < server->peers.count; ) {
+		peer = server->peers.data[i];
+		if (!all && (ni_dbus_connection_is_connected(peer->connection) ||
+			     ni_dbus_connection_is_dispatching(peer->connection))) {
+			++i;
+			continue;
+		}
+
+		ni_debug_dbus("closing dbus peer connection %p", peer->connection);
+		server->peers.count--;
+		memmove(&server->peers.data[i], &server->peers.data[i + 1],
+			(server->peers.count - i) * sizeof(server->peers.data[0]));
+		__ni_dbus_server_peer_free(peer);
+	}
+}
+
+static void
+__ni_dbus_server_new_peer(DBusServer *listener, DBusConnection *conn, void *user_data)
+{
+	ni_dbus_server_t *server = user_data;
+	ni_dbus_server_peer_t *peer, **data;
+
+	__ni_dbus_server_close_peers(server, FALSE);
+
+	data = realloc(server->peers.data, (server->peers.count + 1) * sizeof(*data));
+	if (data == NULL)
+		return;
+	server->peers.data = data;
+
+	/* has to be in place before the peer is authenticated */
+	dbus_connection_set_unix_user_function(conn, __ni_dbus_server_peer_allow_user, NULL, NULL);
+
+	peer = xcalloc(1, sizeof(*peer));
+	peer->server = server;
+	peer->connection = ni_dbus_connection_wrap_peer(conn);
+	if (!dbus_connection_register_fallback(conn, "/", &__ni_dbus_server_peer_vtable, peer)) {
+		__ni_dbus_server_peer_free(peer);
+		return;
+	}
+
+	server->peers.data[server->peers.count++] = peer;
+	ni_debug_dbus("accepted dbus peer connection %p", peer->connection);
+}
+
+static void
+__ni_dbus_server_listen_recv(ni_socket_t *sock)
+{
+	dbus_watch_handle(sock->user_data, DBUS_WATCH_READABLE);
+}
+
+static void
+__ni_dbus_server_listen_close(ni_socket_t *sock)
+{
+	/* the socket is owned by the dbus server */
+}
+
+static dbus_bool_t
+__ni_dbus_server_add_listen_watch(DBusWatch *watch, void *data)
+{
+	ni_socket_t *sock;
+
+	if (!(sock = ni_socket_wrap(dbus_watch_get_socket(watch), -1)))
+		return FALSE;
+
+	sock->close = __ni_dbus_server_listen_close;
+	sock->receive = __ni_dbus_server_listen_recv;
+	sock->user_data = watch;
+	dbus_watch_set_data(watch, sock, NULL);
+	ni_socket_activate(sock);
+	return TRUE;
+}
+
+static void
+__ni_dbus_server_remove_listen_watch(DBusWatch *watch, void *data)
+{
+	ni_socket_t *sock;
+
+	if ((sock = dbus_watch_get_data(watch)) != NULL) {
+		dbus_watch_set_data(watch, NULL, NULL);
+		ni_socket_close(sock);
+	}
+}
+
+int
+ni_dbus_server_listen_peer(ni_dbus_server_t *server, const char *address)
+{
+	static const char *mechanisms[] = { "EXTERNAL", NULL };
+	DBusError error = DBUS_ERROR_INIT;
+
+	if (!server || ni_string_empty(address) || server->listener)
+		return -1;
+
+	server->listener = dbus_server_listen(address, &error);
+	if (server->listener == NULL) {
+		ni_error("Cannot listen on dbus peer address %s (%s)", address,
+				dbus_error_is_set(&error) ? error.message : "unknown error");
+		dbus_error_free(&error);
+		return -1;
+	}
+
+	dbus_server_set_auth_mechanisms(server->listener, mechanisms);
+	dbus_server_set_new_connection_function(server->listener,
+			__ni_dbus_server_new_peer, server, NULL);
+	if (!dbus_server_set_watch_functions(server->listener,
+			__ni_dbus_server_add_listen_watch,
+			__ni_dbus_server_remove_listen_watch,
+			NULL, server, NULL)) {
+		ni_error("Cannot watch dbus peer address %s", address);
+		dbus_server_disconnect(server->listener);
+		dbus_server_unref(server->listener);
+		server->listener = NULL;
+		return -1;
+	}
+
+	ni_debug_dbus("Listening for dbus peers on %s", address);
+	return 0;
+}
+
 /*
  * Turn a dbus object into a server side object
  */
@@ -128,6 +340,7 @@ ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 	DBusError error = DBUS_ERROR_INIT;
 	DBusMessage *msg = NULL;
 	dbus_bool_t rv = FALSE;
+	unsigned int i;
 
 	if (interface) {
 		if (!(svc = ni_dbus_object_get_service(object, interface)))
@@ -157,6 +370,12 @@ ni_dbus_server_send_signal(ni_dbus_server_t *server, ni_dbus_object_t *object,
 	if (ni_dbus_connection_send_message(server->connection, msg) < 0)
 		goto out;
 
+	__ni_dbus_server_close_peers(server, FALSE);
+	for (i = 0; i < server->peers.count; ++i) {
+		if (ni_dbus_connection_send_message(server->peers.data[i]->connection, msg) < 0)
+			ni_debug_dbus("%s: unable to send %s signal to peer", __func__, signal_name);
+	}
+
 	rv = TRUE;
 
 out:
@@ -567,15 +786,30 @@ __ni_dbus_object_unregister(DBusConnection *conn, void *user_data)
 
 static DBusHandlerResult
 __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_data)
+{
+	ni_dbus_object_t *object = user_data;
+	ni_dbus_server_t *server;
+
+	if (!(server = ni_dbus_object_get_server(object)))
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	return __ni_dbus_object_dispatch(server->connection, call, object);
+}
+
+/*
+ * Dispatch a call received on the bus or peer connection
+ */
+static DBusHandlerResult
+__ni_dbus_object_dispatch(ni_dbus_connection_t *connection, DBusMessage *call, ni_dbus_object_t *object)
 {
 	const char *interface = dbus_message_get_interface(call);
 	const char *method_name = dbus_message_get_member(call);
-	ni_dbus_object_t *object = user_data;
 	const ni_dbus_method_t *method;
 	DBusError error = DBUS_ERROR_INIT;
 	DBusMessage *reply = NULL;
 	const ni_dbus_service_t *svc;
-	ni_dbus_server_t *server;
+	ni_metric_t *metric = NULL;
+	struct timespec start;
 	dbus_bool_t rv = FALSE;
 
 	/* Clean out deceased objects */
@@ -595,8 +829,7 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	}
 
-	server = ni_dbus_object_get_server(object);
-
+	ni_metric_start(&start);
 	method = ni_dbus_service_get_method(svc, method_name);
 	if (method == NULL
 	 || (!method->handler && !method->handler_ex && !method->async_handler)) {
@@ -611,6 +844,7 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 		uid_t caller_uid = -1;
 		int argc = 0;
 
+		metric = ni_metric_getf("dbus.%s.%s", svc->name, method->name);
 		memset(argv, 0, sizeof(argv));
 		if (method->call_signature) {
 			const char *signature = dbus_message_get_signature(call);
@@ -642,7 +876,8 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 		if (method->handler_ex) {
 			int err;
 
-			err = ni_dbus_object_get_caller_uid(object, call, &caller_uid);
+			err = ni_dbus_connection_get_caller_uid(connection,
+					dbus_message_get_sender(call), &caller_uid);
 			if (err < 0) {
 				ni_dbus_set_error_from_code(&error, err, "unable to get caller's uid");
 				goto error_reply;
@@ -679,7 +914,7 @@ __ni_dbus_object_message(DBusConnection *conn, DBusMessage *call, void *user_dat
 				ni_dbus_variant_destroy(&argv[argc]);
 		} else
 		if (method->async_handler) {
-			rv = method->async_handler(server->connection, object, method, call);
+			rv = method->async_handler(connection, object, method, call);
 		} else {
 			dbus_set_error(&error, DBUS_ERROR_FAILED, "No server side handler for method");
 			rv = FALSE;
@@ -696,9 +931,10 @@ error_reply:
 	}
 
 	/* send reply */
-	if (reply && ni_dbus_connection_send_message(server->connection, reply) < 0)
+	if (reply && ni_dbus_connection_send_message(connection, reply) < 0)
 		ni_error("unable to send reply (out of memory)");
 
+	ni_metric_stop(metric, &start, !rv);
 	dbus_error_free(&error);
 	if (reply)
 		dbus_message_unref(reply);
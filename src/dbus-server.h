@@ -14,6 +14,7 @@
 
 extern ni_dbus_server_t *	ni_dbus_server_open(const char *bus_type, const char *bus_name, void *root_handle);
 extern void			ni_dbus_server_free(ni_dbus_server_t *);
+extern int			ni_dbus_server_listen_peer(ni_dbus_server_t *, const char *address);
 
 #endif /* __WICKED_DBUS_SERVER_H__ */
 
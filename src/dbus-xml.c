@@ -17,6 +17,7 @@
 #include "util_priv.h"
 #include "limits.h"
 #include "debug.h"
+#include "memstat.h"
 
 #include <wicked/netinfo.h>
 #include <wicked/xpath.h>
@@ -924,7 +925,10 @@ ni_dbus_serialize_xml_array(xml_node_t *node, const ni_xs_type_t *type, ni_dbus_
 
 	if (array_info->notation) {
 		ni_dbus_variant_init_byte_array(var);
-		return ni_dbus_serialize_byte_array_notation(node, array_info, &var->byte_array_value, &var->array.len);
+		if (!ni_dbus_serialize_byte_array_notation(node, array_info, &var->byte_array_value, &var->array.len))
+			return FALSE;
+		ni_memstat_alloc(NI_MEMSTAT_DBUS_VARIANT, var->byte_array_value);
+		return TRUE;
 	}
 
 	if (!ni_dbus_variant_init_signature(var, ni_xs_type_to_dbus_signature(type)))
@@ -1759,6 +1763,62 @@ ni_dbus_xml_get_properties_schema(const ni_xs_scope_t *scope, const ni_xs_servic
 	return ni_xs_scope_lookup_local(scope, "properties");
 }
 
+/*
+ * Cache of compiled xpath expressions used in element references.
+ * The expressions are taken from the schema, so there's only a small
+ * set of them, but they're expanded for every interface on every
+ * call - keep them compiled for the lifetime of the process.
+ */
+#define NI_DBUS_XML_XPATH_CACHE_SIZE	64
+
+typedef struct ni_dbus_xml_xpath_entry	ni_dbus_xml_xpath_entry_t;
+struct ni_dbus_xml_xpath_entry {
+	ni_dbus_xml_xpath_entry_t *	next;
+	char *				expr;
+	xpath_enode_t *			enode;
+};
+
+static ni_dbus_xml_xpath_entry_t *	ni_dbus_xml_xpath_cache[NI_DBUS_XML_XPATH_CACHE_SIZE];
+
+static unsigned int
+ni_dbus_xml_xpath_hash(const char *expr)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*expr) {
+		hash ^= (unsigned char)*expr++;
+		hash *= 16777619U;
+	}
+	return hash % NI_DBUS_XML_XPATH_CACHE_SIZE;
+}
+
+static const xpath_enode_t *
+ni_dbus_xml_xpath_compile(const char *expr)
+{
+	ni_dbus_xml_xpath_entry_t **list, *entry;
+	xpath_enode_t *enode;
+
+	if (!expr)
+		return NULL;
+
+	list = &ni_dbus_xml_xpath_cache[ni_dbus_xml_xpath_hash(expr)];
+	for (entry = *list; entry; entry = entry->next) {
+		if (ni_string_eq(entry->expr, expr))
+			return entry->enode;
+	}
+
+	/* Do not cache failures; report them on every use */
+	if (!(enode = xpath_expression_parse(expr)))
+		return NULL;
+
+	entry = xcalloc(1, sizeof(*entry));
+	entry->expr = xstrdup(expr);
+	entry->enode = enode;
+	entry->next = *list;
+	*list = entry;
+	return enode;
+}
+
 /*
  * Given an xml node and an xpath expression, get list of nodes referenced by this
  */
@@ -1766,20 +1826,18 @@ int
 ni_dbus_xml_expand_element_reference(xml_node_t *doc_node, const char *expr_string,
 			xml_node_t **ret_nodes, unsigned int max_nodes)
 {
-	xpath_enode_t *expression;
+	const xpath_enode_t *expression;
 	xpath_result_t *result;
 	unsigned int i, nret;
 
 	if (xml_node_is_empty(doc_node))
 		return 0;
 
-	expression = xpath_expression_parse(expr_string);
+	expression = ni_dbus_xml_xpath_compile(expr_string);
 	if (expression == NULL)
 		return -NI_ERROR_DOCUMENT_ERROR;
 
 	result = xpath_expression_eval(expression, doc_node);
-	xpath_expression_free(expression);
-
 	if (result == NULL)
 		return -NI_ERROR_DOCUMENT_ERROR;
 
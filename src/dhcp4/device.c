@@ -35,6 +35,57 @@ static void		ni_dhcp4_config_set_request_options(const char *, ni_uint_array_t *
 
 ni_dhcp4_device_t *	ni_dhcp4_active;
 
+/*
+ * Hash tables to find the device of an interface index or of the
+ * transaction id of a message without walking the active list.
+ */
+#define NI_DHCP4_DEVICE_HASH_SIZE	1024
+
+static ni_dhcp4_device_t *	ni_dhcp4_index_hash[NI_DHCP4_DEVICE_HASH_SIZE];
+static ni_dhcp4_device_t *	ni_dhcp4_xid_hash[NI_DHCP4_DEVICE_HASH_SIZE];
+
+static inline unsigned int
+ni_dhcp4_index_hash_slot(unsigned int ifindex)
+{
+	return ifindex % NI_DHCP4_DEVICE_HASH_SIZE;
+}
+
+static inline unsigned int
+ni_dhcp4_xid_hash_slot(uint32_t xid)
+{
+	return (xid ^ (xid >> 16)) % NI_DHCP4_DEVICE_HASH_SIZE;
+}
+
+static void
+ni_dhcp4_index_hash_unlink(ni_dhcp4_device_t *dev)
+{
+	ni_dhcp4_device_t **pos;
+
+	pos = &ni_dhcp4_index_hash[ni_dhcp4_index_hash_slot(dev->system.ifindex)];
+	for (; *pos; pos = &(*pos)->index_next) {
+		if (*pos == dev) {
+			*pos = dev->index_next;
+			break;
+		}
+	}
+	dev->index_next = NULL;
+}
+
+static void
+ni_dhcp4_xid_hash_unlink(ni_dhcp4_device_t *dev)
+{
+	ni_dhcp4_device_t **pos;
+
+	pos = &ni_dhcp4_xid_hash[ni_dhcp4_xid_hash_slot(dev->dhcp4.xid)];
+	for (; *pos; pos = &(*pos)->xid_next) {
+		if (*pos == dev) {
+			*pos = dev->xid_next;
+			break;
+		}
+	}
+	dev->xid_next = NULL;
+}
+
 /*
  * Create and destroy dhcp4 device handles
  */
@@ -64,6 +115,10 @@ ni_dhcp4_device_new(const char *ifname, const ni_linkinfo_t *link)
 	/* append to end of list */
 	*pos = dev;
 
+	pos = &ni_dhcp4_index_hash[ni_dhcp4_index_hash_slot(dev->system.ifindex)];
+	dev->index_next = *pos;
+	*pos = dev;
+
 	return dev;
 }
 
@@ -72,7 +127,8 @@ ni_dhcp4_device_by_index(unsigned int ifindex)
 {
 	ni_dhcp4_device_t *dev;
 
-	for (dev = ni_dhcp4_active; dev; dev = dev->next) {
+	dev = ni_dhcp4_index_hash[ni_dhcp4_index_hash_slot(ifindex)];
+	for (; dev; dev = dev->index_next) {
 		if (dev->system.ifindex == ifindex)
 			return dev;
 	}
@@ -80,6 +136,42 @@ ni_dhcp4_device_by_index(unsigned int ifindex)
 	return NULL;
 }
 
+ni_dhcp4_device_t *
+ni_dhcp4_device_by_xid(uint32_t xid)
+{
+	ni_dhcp4_device_t *dev;
+
+	if (!xid)
+		return NULL;
+
+	dev = ni_dhcp4_xid_hash[ni_dhcp4_xid_hash_slot(xid)];
+	for (; dev; dev = dev->xid_next) {
+		if (dev->dhcp4.xid == xid)
+			return dev;
+	}
+
+	return NULL;
+}
+
+void
+ni_dhcp4_device_set_xid(ni_dhcp4_device_t *dev, uint32_t xid)
+{
+	ni_dhcp4_device_t **pos;
+
+	if (dev->dhcp4.xid == xid)
+		return;
+
+	if (dev->dhcp4.xid)
+		ni_dhcp4_xid_hash_unlink(dev);
+
+	dev->dhcp4.xid = xid;
+	if (xid) {
+		pos = &ni_dhcp4_xid_hash[ni_dhcp4_xid_hash_slot(xid)];
+		dev->xid_next = *pos;
+		*pos = dev;
+	}
+}
+
 static void
 ni_dhcp4_device_close(ni_dhcp4_device_t *dev)
 {
@@ -122,6 +214,7 @@ ni_dhcp4_device_set_config(ni_dhcp4_device_t *dev, ni_dhcp4_config_t *config)
 		free(dev->config);
 	}
 	dev->config = config;
+	ni_dhcp4_msg_templates_flush(dev);
 }
 
 void
@@ -145,6 +238,8 @@ ni_dhcp4_device_free(ni_dhcp4_device_t *dev)
 	ni_dhcp4_device_drop_lease(dev);
 	ni_dhcp4_device_drop_best_offer(dev);
 	ni_dhcp4_device_close(dev);
+	ni_dhcp4_device_set_xid(dev, 0);
+	ni_dhcp4_index_hash_unlink(dev);
 	ni_string_free(&dev->system.ifname);
 	ni_string_free(&dev->ifname);
 
@@ -249,6 +344,9 @@ ni_dhcp4_device_refresh(ni_dhcp4_device_t *dev)
 		return rv;
 	}
 
+	/* mtu and hwaddr are in the messages built before */
+	ni_dhcp4_msg_templates_flush(dev);
+
 	return ni_capture_devinfo_refresh(&dev->system, dev->ifname, &dev->link);
 }
 
@@ -669,8 +767,8 @@ ni_dhcp4_device_prepare_message(void *data)
 	/* Allocate an empty buffer */
 	ni_dhcp4_device_alloc_buffer(dev);
 
-	/* Build the DHCP4 message */
-	if (ni_dhcp4_build_message(dev, dev->transmit.msg_code, dev->transmit.lease, &dev->message) < 0) {
+	/* Build the DHCP4 message or update the xid and secs of its template */
+	if (ni_dhcp4_build_message_cached(dev, dev->transmit.msg_code, dev->transmit.lease, &dev->message) < 0) {
 		/* This is really terminal */
 		ni_error("unable to build DHCP4 message");
 		return -1;
@@ -1112,24 +1210,14 @@ ni_dhcp4_supported(const ni_netdev_t *ifp)
 void
 ni_dhcp4_new_xid(ni_dhcp4_device_t *cur)
 {
-	ni_dhcp4_device_t *dev;
 	unsigned int xid;
 
 	if (!cur)
 		return;
 
 	do {
-		do {
-			xid = random();
-		} while (!xid);
-
-		for (dev = ni_dhcp4_active; dev; dev = dev->next) {
-			if (xid == dev->dhcp4.xid) {
-				xid = 0;
-				break;
-			}
-		}
-	} while (!xid);
+		xid = random();
+	} while (!xid || ni_dhcp4_device_by_xid(xid));
 
-	cur->dhcp4.xid = xid;
+	ni_dhcp4_device_set_xid(cur, xid);
 }
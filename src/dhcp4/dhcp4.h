@@ -33,8 +33,72 @@ typedef struct ni_dhcp4_message ni_dhcp4_message_t;
 typedef struct ni_dhcp4_config ni_dhcp4_config_t;
 typedef struct ni_dhcp4_request	ni_dhcp4_request_t;
 
+/*
+ * Index of the options in a received DHCP4 message. It refers to the
+ * option data in the message buffer, which has to stay around while
+ * the index is used. Options split into several parts (RFC 3396) are
+ * chained in the order of the options, bootfile and servername fields.
+ */
+#define NI_DHCP4_OPTION_SEGMENTS_MAX	512
+
+enum {
+	NI_DHCP4_OPTION_AREA_OPTIONS = 0,
+	NI_DHCP4_OPTION_AREA_BOOTFILE,
+	NI_DHCP4_OPTION_AREA_SERVERNAME,
+
+	__NI_DHCP4_OPTION_AREA_MAX
+};
+
+typedef struct ni_dhcp4_option_segment {
+	uint16_t		offset;
+	uint8_t			len;
+	uint8_t			code;
+	uint8_t			area;
+	uint16_t		next;		/* 1-based, 0 for none */
+} ni_dhcp4_option_segment_t;
+
+typedef struct ni_dhcp4_option_index {
+	const ni_dhcp4_message_t *message;
+	const unsigned char *	area[__NI_DHCP4_OPTION_AREA_MAX];
+	int			msg_type;
+	int			overload;
+
+	uint16_t		first[256];	/* 1-based, 0 for none */
+	uint16_t		last[256];
+	uint16_t		length[256];
+
+	unsigned int		count;
+	ni_dhcp4_option_segment_t segment[NI_DHCP4_OPTION_SEGMENTS_MAX];
+} ni_dhcp4_option_index_t;
+
+/*
+ * A message built for a device is kept as template and reused for
+ * (re)transmits with just the xid and secs fields updated, as long
+ * as the message type, fsm state and the lease data it depends on
+ * do not change. Changes to the device config or system info flush
+ * the templates.
+ */
+#define NI_DHCP4_MSG_TEMPLATES_MAX	8
+
+typedef struct ni_dhcp4_msg_template {
+	unsigned int		msg_code;	/* 0 when unused */
+	enum fsm_state		state;
+
+	struct in_addr		address;
+	struct in_addr		server_id;
+	unsigned int		lease_time;
+	ni_dhcp_fqdn_t		fqdn;
+	char *			hostname;
+
+	ni_bool_t		udp;		/* has ip and udp header */
+	unsigned int		offset;		/* of the dhcp4 message */
+	ni_buffer_t		packet;
+} ni_dhcp4_msg_template_t;
+
 typedef struct ni_dhcp4_device {
 	struct ni_dhcp4_device *	next;
+	struct ni_dhcp4_device *	index_next;	/* ifindex hash chain */
+	struct ni_dhcp4_device *	xid_next;	/* xid hash chain */
 	unsigned int		users;
 
 	char *			ifname;
@@ -75,6 +139,7 @@ typedef struct ni_dhcp4_device {
 	} dhcp4;
 
 	ni_buffer_t		message;
+	ni_dhcp4_msg_template_t	templates[NI_DHCP4_MSG_TEMPLATES_MAX];
 
 	struct {
 	   ni_arp_socket_t *	handle;
@@ -228,11 +293,23 @@ extern int		ni_dhcp4_fsm_commit_lease(ni_dhcp4_device_t *, ni_addrconf_lease_t *
 extern int		ni_dhcp4_recover_lease(ni_dhcp4_device_t *);
 extern int		ni_dhcp4_build_message(const ni_dhcp4_device_t *,
 				unsigned int, const ni_addrconf_lease_t *, ni_buffer_t *);
+extern int		ni_dhcp4_build_message_cached(ni_dhcp4_device_t *,
+				unsigned int, const ni_addrconf_lease_t *, ni_buffer_t *);
+extern void		ni_dhcp4_msg_templates_flush(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_fsm_link_up(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_fsm_link_down(ni_dhcp4_device_t *);
 
 extern int		ni_dhcp4_parse_response(const ni_dhcp4_config_t *, const ni_dhcp4_message_t *,
 						ni_buffer_t *, ni_addrconf_lease_t **);
+extern int		ni_dhcp4_parse_lease(const ni_dhcp4_config_t *, const ni_dhcp4_option_index_t *,
+						ni_addrconf_lease_t **);
+extern int		ni_dhcp4_option_index_build(ni_dhcp4_option_index_t *,
+						const ni_dhcp4_message_t *, ni_buffer_t *);
+extern ni_bool_t	ni_dhcp4_option_index_has(const ni_dhcp4_option_index_t *, unsigned int);
+extern ni_bool_t	ni_dhcp4_option_index_get_ipv4(const ni_dhcp4_option_index_t *, unsigned int,
+						struct in_addr *);
+extern ni_bool_t	ni_dhcp4_option_index_get_opaque(const ni_dhcp4_option_index_t *, unsigned int,
+						ni_opaque_t *);
 
 extern int		ni_dhcp4_socket_open(ni_dhcp4_device_t *);
 
@@ -242,6 +319,7 @@ extern void		ni_dhcp4_device_stop(ni_dhcp4_device_t *);
 extern unsigned int	ni_dhcp4_device_uptime(const ni_dhcp4_device_t *, unsigned int);
 extern ni_dhcp4_device_t *ni_dhcp4_device_new(const char *, const ni_linkinfo_t *);
 extern ni_dhcp4_device_t *ni_dhcp4_device_by_index(unsigned int);
+extern ni_dhcp4_device_t *ni_dhcp4_device_by_xid(uint32_t);
 extern ni_dhcp4_device_t *ni_dhcp4_device_get(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_device_put(ni_dhcp4_device_t *);
 extern void		ni_dhcp4_device_event(ni_dhcp4_device_t *, ni_netdev_t *, ni_event_t);
@@ -263,6 +341,7 @@ extern void		ni_dhcp4_device_arp_close(ni_dhcp4_device_t *);
 extern ni_bool_t	ni_dhcp4_parse_client_id(ni_opaque_t *, unsigned short, const char *);
 extern ni_bool_t	ni_dhcp4_set_config_client_id(ni_opaque_t *, const ni_dhcp4_device_t *);
 extern void		ni_dhcp4_new_xid(ni_dhcp4_device_t *);
+extern void		ni_dhcp4_device_set_xid(ni_dhcp4_device_t *, uint32_t);
 extern void		ni_dhcp4_device_set_best_offer(ni_dhcp4_device_t *, ni_addrconf_lease_t *, int);
 extern void		ni_dhcp4_device_drop_best_offer(ni_dhcp4_device_t *);
 
@@ -75,6 +75,8 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 {
 	ni_dhcp4_message_t *message;
 	ni_addrconf_lease_t *lease = NULL;
+	ni_dhcp4_option_index_t index;
+	ni_opaque_t client_id;
 	const char *sender = NULL;
 	int msg_code;
 
@@ -109,7 +111,9 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 		return -1;
 	}
 
-	msg_code = ni_dhcp4_parse_response(dev->config, message, msgbuf, &lease);
+	/* Index the options first, so we can drop messages not meant
+	 * for us or from blacklisted servers without decoding a lease */
+	msg_code = ni_dhcp4_option_index_build(&index, message, msgbuf);
 	sender = ni_capture_from_hwaddr_print(from);
 	if (msg_code < 0) {
 		/* Ignore this message, time out later */
@@ -117,10 +121,10 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 				sender ? " sender " : "", sender ? sender : "");
 		return -1;
 	}
-	ni_string_dup(&lease->dhcp4.sender_hwa, sender);
-	sender = lease->dhcp4.sender_hwa;
 
-	if (dev->config->client_id.len && !lease->dhcp4.client_id.len) {
+	memset(&client_id, 0, sizeof(client_id));
+	ni_dhcp4_option_index_get_opaque(&index, DHCP4_CLIENTID, &client_id);
+	if (dev->config->client_id.len && !client_id.len) {
 		/*
 		 * https://tools.ietf.org/html/rfc6842:
 		 *
@@ -139,8 +143,7 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 		 */
 		ni_debug_dhcp("%s: server does not send client-id back", dev->ifname);
 	} else
-	if (lease->dhcp4.client_id.len &&
-	    !ni_opaque_eq(&dev->config->client_id, &lease->dhcp4.client_id)) {
+	if (client_id.len && !ni_opaque_eq(&dev->config->client_id, &client_id)) {
 		/*
 		 * https://tools.ietf.org/html/rfc6842:
 		 *
@@ -160,13 +163,39 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 			ni_dhcp4_fsm_state_name(dev->fsm.state),
 			sender ? " sender " : "", sender ? sender : "");
 
-	if (lease->dhcp4.client_id.len) {
+	if (client_id.len) {
 		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_DHCP,
 				"%s: and matching client id %s", dev->ifname,
-				ni_print_hex(lease->dhcp4.client_id.data,
-						lease->dhcp4.client_id.len));
+				ni_print_hex(client_id.data, client_id.len));
 	}
 
+	/* When receiving a DHCP4 OFFER, verify sender address against list of
+	 * servers to ignore before we decode it. */
+	if (msg_code == DHCP4_OFFER && dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
+		struct in_addr srv_addr = { .s_addr = 0 };
+		const char *ipaddr;
+
+		ni_dhcp4_option_index_get_ipv4(&index, DHCP4_SERVERIDENTIFIER, &srv_addr);
+		ipaddr = inet_ntoa(srv_addr);
+		if ((sender && ni_dhcp4_config_ignore_server(sender)) ||
+		    (ipaddr && ni_dhcp4_config_ignore_server(ipaddr))) {
+			ni_debug_dhcp("%s: ignoring DHCP4 offer from %s%s%s%s (blacklisted)",
+					dev->ifname, inet_ntoa(srv_addr),
+					sender ? " (" : "",
+					sender ? sender : "",
+					sender ? ")" : "");
+			goto out;
+		}
+	}
+
+	if (ni_dhcp4_parse_lease(dev->config, &index, &lease) < 0) {
+		ni_error("%s: unable to parse DHCP4 response%s%s", dev->ifname,
+				sender ? " sender " : "", sender ? sender : "");
+		return -1;
+	}
+	ni_string_dup(&lease->dhcp4.sender_hwa, sender);
+	sender = lease->dhcp4.sender_hwa;
+
 	/* set reqest client-id in the response early to have it in test mode */
 	if (!lease->dhcp4.client_id.len && dev->config->client_id.len) {
 		ni_opaque_set(&lease->dhcp4.client_id,	dev->config->client_id.data,
@@ -174,31 +203,12 @@ ni_dhcp4_fsm_process_dhcp4_packet(ni_dhcp4_device_t *dev, ni_buffer_t *msgbuf, n
 	}
 
 
-	/* When receiving a DHCP4 OFFER, verify sender address against list of
-	 * servers to ignore, and preferred servers. */
+	/* When receiving a DHCP4 OFFER, check it against the preferred servers. */
 	if (msg_code == DHCP4_OFFER && dev->fsm.state == NI_DHCP4_STATE_SELECTING) {
 		struct in_addr srv_addr = lease->dhcp4.server_id;
-		const char *ipaddr = inet_ntoa(srv_addr);
 		ni_hwaddr_t hwaddr;
 		int weight = 0;
 
-		if (sender && ni_dhcp4_config_ignore_server(sender)) {
-			ni_debug_dhcp("%s: ignoring DHCP4 offer from %s%s%s%s (blacklisted)",
-					dev->ifname, inet_ntoa(srv_addr),
-					sender ? " (" : "",
-					sender ? sender : "",
-					sender ? ")" : "");
-			goto out;
-		}
-		if (ipaddr && ni_dhcp4_config_ignore_server(ipaddr)) {
-			ni_debug_dhcp("%s: ignoring DHCP4 offer from %s%s%s%s (blacklisted)",
-					dev->ifname, inet_ntoa(srv_addr),
-					sender ? " (" : "",
-					sender ? sender : "",
-					sender ? ")" : "");
-			goto out;
-		}
-
 		/* If we're scanning all offers, we need to decide whether
 		 * this offer is accepted, or whether we want to wait for
 		 * more.
@@ -345,7 +355,7 @@ ni_dhcp4_fsm_restart(ni_dhcp4_device_t *dev)
 		ni_timer_cancel(dev->fsm.timer);
 		dev->fsm.timer = NULL;
 	}
-	dev->dhcp4.xid = 0;
+	ni_dhcp4_device_set_xid(dev, 0);
 	dev->config->elapsed_timeout = 0;
 
 	ni_dhcp4_device_drop_lease(dev);
@@ -28,6 +28,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -214,11 +215,11 @@ ni_dhcp4_option_next(ni_buffer_t *bp, ni_buffer_t *optbuf)
 		return -1;
 	if (bp->head == bp->tail)
 		return DHCP4_END;
-	if (bp->tail - bp->head < 2)
-		goto underflow;
 
 	code = bp->base[bp->head++];
 	if (code != DHCP4_PAD && code != DHCP4_END) {
+		if (bp->head == bp->tail)
+			goto underflow;
 		count = bp->base[bp->head++];
 		if (bp->tail - bp->head < count)
 			goto underflow;
@@ -1252,6 +1253,144 @@ failed:
 	return -1;
 }
 
+/*
+ * Message templates
+ */
+static void
+ni_dhcp4_msg_template_destroy(ni_dhcp4_msg_template_t *tmpl)
+{
+	ni_string_free(&tmpl->hostname);
+	ni_buffer_destroy(&tmpl->packet);
+	memset(tmpl, 0, sizeof(*tmpl));
+}
+
+void
+ni_dhcp4_msg_templates_flush(ni_dhcp4_device_t *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < NI_DHCP4_MSG_TEMPLATES_MAX; ++i)
+		ni_dhcp4_msg_template_destroy(&dev->templates[i]);
+}
+
+static void
+ni_dhcp4_msg_template_key(const ni_dhcp4_device_t *dev, unsigned int msg_code,
+			const ni_addrconf_lease_t *lease, ni_dhcp4_msg_template_t *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->msg_code = msg_code;
+	key->state = dev->fsm.state;
+	key->address = lease->dhcp4.address;
+	key->server_id = lease->dhcp4.server_id;
+	key->lease_time = lease->dhcp4.lease_time;
+	if (lease->fqdn.enabled == NI_TRISTATE_DEFAULT)
+		key->fqdn = dev->config->fqdn;
+	else
+		key->fqdn = lease->fqdn;
+	/* not owned by the key */
+	key->hostname = lease->hostname;
+}
+
+static ni_bool_t
+ni_dhcp4_msg_template_match(const ni_dhcp4_msg_template_t *tmpl,
+			const ni_dhcp4_msg_template_t *key)
+{
+	return	tmpl->address.s_addr == key->address.s_addr &&
+		tmpl->server_id.s_addr == key->server_id.s_addr &&
+		tmpl->lease_time == key->lease_time &&
+		tmpl->fqdn.enabled == key->fqdn.enabled &&
+		tmpl->fqdn.update == key->fqdn.update &&
+		tmpl->fqdn.encode == key->fqdn.encode &&
+		tmpl->fqdn.qualify == key->fqdn.qualify &&
+		ni_string_eq(tmpl->hostname, key->hostname);
+}
+
+static int
+ni_dhcp4_msg_template_apply(const ni_dhcp4_device_t *dev,
+			const ni_dhcp4_msg_template_t *tmpl, ni_buffer_t *msgbuf)
+{
+	uint32_t xid = dev->dhcp4.xid;
+	uint16_t secs = htons(ni_dhcp4_device_uptime(dev, 0xFFFF));
+	ni_dhcp4_message_t *message;
+
+	if (ni_buffer_put(msgbuf, ni_buffer_head(&tmpl->packet),
+				ni_buffer_count(&tmpl->packet)) < 0)
+		return -1;
+
+	if (tmpl->udp) {
+		if (ni_capture_update_udp_payload(msgbuf, offsetof(ni_dhcp4_message_t, xid),
+					&xid, sizeof(xid)) < 0 ||
+		    ni_capture_update_udp_payload(msgbuf, offsetof(ni_dhcp4_message_t, secs),
+					&secs, sizeof(secs)) < 0)
+			return -1;
+	} else {
+		message = (ni_dhcp4_message_t *)((unsigned char *)ni_buffer_head(msgbuf) + tmpl->offset);
+		message->xid = xid;
+		message->secs = secs;
+	}
+
+	ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_DHCP,
+			"%s: using %s message template, xid: %x, secs: %u", dev->ifname,
+			ni_dhcp4_message_name(tmpl->msg_code), ntohl(xid), ntohs(secs));
+	return 0;
+}
+
+/*
+ * Build a message using the template of a previous build when the
+ * data it depends on did not change, otherwise build it from scratch
+ * and keep it as template.
+ */
+int
+ni_dhcp4_build_message_cached(ni_dhcp4_device_t *dev, unsigned int msg_code,
+			const ni_addrconf_lease_t *lease, ni_buffer_t *msgbuf)
+{
+	ni_dhcp4_msg_template_t key, *tmpl, *slot = NULL;
+	size_t head = msgbuf->head, tail = msgbuf->tail;
+	unsigned int i;
+
+	if (!dev->config || !lease)
+		return ni_dhcp4_build_message(dev, msg_code, lease, msgbuf);
+
+	ni_dhcp4_msg_template_key(dev, msg_code, lease, &key);
+	for (i = 0; i < NI_DHCP4_MSG_TEMPLATES_MAX; ++i) {
+		tmpl = &dev->templates[i];
+		if (!tmpl->msg_code) {
+			if (!slot)
+				slot = tmpl;
+			continue;
+		}
+		if (tmpl->msg_code != key.msg_code || tmpl->state != key.state)
+			continue;
+
+		if (ni_dhcp4_msg_template_match(tmpl, &key) &&
+		    ni_dhcp4_msg_template_apply(dev, tmpl, msgbuf) == 0)
+			return 0;
+
+		/* outdated, rebuild it in place */
+		msgbuf->head = head;
+		msgbuf->tail = tail;
+		slot = tmpl;
+		break;
+	}
+	if (!slot)
+		slot = &dev->templates[(msg_code + key.state) % NI_DHCP4_MSG_TEMPLATES_MAX];
+	ni_dhcp4_msg_template_destroy(slot);
+
+	if (ni_dhcp4_build_message(dev, msg_code, lease, msgbuf) < 0)
+		return -1;
+	if (msgbuf->overflow)
+		return 0;
+
+	*slot = key;
+	slot->hostname = NULL;
+	ni_string_dup(&slot->hostname, key.hostname);
+	slot->udp = !(key.state == NI_DHCP4_STATE_RENEWING && msg_code == DHCP4_REQUEST);
+	slot->offset = slot->udp ? sizeof(struct ip) + sizeof(struct udphdr) : 0;
+	ni_buffer_init_dynamic(&slot->packet, ni_buffer_count(msgbuf));
+	ni_buffer_put(&slot->packet, ni_buffer_head(msgbuf), ni_buffer_count(msgbuf));
+	return 0;
+}
+
 /*
  * Decode an RFC3397 DNS search order option.
  */
@@ -1802,52 +1941,30 @@ ni_dhcp4_apply_routes(ni_addrconf_lease_t *lease, ni_route_array_t *routes)
 }
 
 /*
- * Parse a DHCP4 response.
+ * Index the options of a DHCP4 response.
+ *
+ * This is a single pass over the options field and the overloaded
+ * bootfile and servername fields, which records where the data of
+ * each option is located in the message buffer - nothing is copied
+ * or decoded here. Options split into several parts (RFC 3396) are
+ * chained in the order they appear.
+ *
+ * Returns the message type, or -1 if the message is invalid.
  */
-int
-ni_dhcp4_parse_response(const ni_dhcp4_config_t *config, const ni_dhcp4_message_t *message,
-			ni_buffer_t *options, ni_addrconf_lease_t **leasep)
+static int
+ni_dhcp4_option_index_area(ni_dhcp4_option_index_t *index, unsigned int area,
+			ni_buffer_t *options)
 {
-	ni_buffer_t overload_buf;
-	ni_addrconf_lease_t *lease;
-	ni_route_array_t default_routes = NI_ROUTE_ARRAY_INIT;
-	ni_route_array_t static_routes = NI_ROUTE_ARRAY_INIT;
-	ni_route_array_t classless_routes = NI_ROUTE_ARRAY_INIT;
-	ni_string_array_t dns_servers = NI_STRING_ARRAY_INIT;
-	ni_string_array_t dns_search = NI_STRING_ARRAY_INIT;
-	ni_string_array_t dns_domain = NI_STRING_ARRAY_INIT;
-	ni_string_array_t nis_servers = NI_STRING_ARRAY_INIT;
-	char *nisdomain = NULL;
-	char *tmp = NULL;
-	int opt_overload = 0;
-	int msg_type = -1;
-	int use_bootserver = 1;
-	int use_bootfile = 1;
-	unsigned int pfxlen;
-	ni_dhcp_option_t *opts = NULL, *opt;
-
-	lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+	const unsigned char *base = ni_buffer_head(options);
+	ni_dhcp4_option_segment_t *seg;
+	unsigned int pos;
 
-	lease->state = NI_ADDRCONF_STATE_GRANTED;
-	lease->type = NI_ADDRCONF_DHCP;
-	lease->family = AF_INET;
-	ni_timer_get_time(&lease->acquired);
-	lease->fqdn.enabled = NI_TRISTATE_DEFAULT;
-	lease->fqdn.qualify = config->fqdn.qualify;
-
-	lease->dhcp4.address.s_addr = message->yiaddr;
-	lease->dhcp4.boot_saddr.s_addr = message->siaddr;
-	lease->dhcp4.relay_addr.s_addr = message->giaddr;
-
-parse_more:
-	/* Loop as long as we still have data in the buffer. */
+	index->area[area] = base;
 	while (ni_buffer_count(options) && !options->underflow) {
 		ni_buffer_t buf;
 		int option;
 
 		option = ni_dhcp4_option_next(options, &buf);
-
-		//ni_debug_dhcp("handle option %s (%d)", ni_dhcp4_option_name(option), option);
 		if (option == DHCP4_END || option < 0)
 			break;
 
@@ -1857,17 +1974,17 @@ parse_more:
 
 		case DHCP4_MESSAGETYPE:
 			option = ni_buffer_getc(&buf);
-			if (option == EOF || msg_type != -1)
-				goto error;
-			msg_type = option;
+			if (option == EOF || index->msg_type != -1)
+				return -1;
+			index->msg_type = option;
 			continue;
 
 		case DHCP4_OPTIONSOVERLOADED:
-			if (options != &overload_buf) {
-				opt_overload = ni_buffer_getc(&buf);
-				if (opt_overload == EOF) {
+			if (area == NI_DHCP4_OPTION_AREA_OPTIONS) {
+				index->overload = ni_buffer_getc(&buf);
+				if (index->overload == EOF) {
 					ni_debug_dhcp("DHCP4: ignoring invalid OVERLOAD option");
-					opt_overload = 0;
+					index->overload = 0;
 				}
 			} else if (ni_buffer_getc(&buf) == EOF) {
 				ni_debug_dhcp("DHCP4: ignoring invalid OVERLOAD option in overloaded data");
@@ -1885,188 +2002,427 @@ parse_more:
 			continue;
 		}
 
-		if ((opt = ni_dhcp_option_list_find(opts, option))) {
-			if (ni_dhcp_option_append(opt, ni_buffer_count(&buf), ni_buffer_head(&buf)))
-				ni_buffer_pull_head(&buf, ni_buffer_count(&buf));
-		} else
-		if ((opt = ni_dhcp_option_new(option, ni_buffer_count(&buf), ni_buffer_head(&buf)))) {
-			if (ni_dhcp_option_list_append(&opts, opt))
-				ni_buffer_pull_head(&buf, ni_buffer_count(&buf));
-			else
-				ni_dhcp_option_free(opt);
-		} else {
-			ni_debug_dhcp("unable to allocate DHCP4 option %s", ni_dhcp4_option_name(option));
-			continue;
+		if (index->count >= NI_DHCP4_OPTION_SEGMENTS_MAX) {
+			ni_debug_dhcp("DHCP4: too many options in response");
+			return -1;
 		}
 
-		if (buf.underflow) {
-			ni_debug_dhcp("unable to parse DHCP4 option %s: too short",
-					ni_dhcp4_option_name(option));
-		} else if (ni_buffer_count(&buf)) {
-			ni_debug_dhcp("excess data in DHCP4 option %s - %u bytes left",
-					ni_dhcp4_option_name(option),
-					ni_buffer_count(&buf));
+		pos = index->count++;
+		seg = &index->segment[pos];
+		seg->code = option;
+		seg->area = area;
+		seg->offset = (const unsigned char *)ni_buffer_head(&buf) - base;
+		seg->len = ni_buffer_count(&buf);
+		seg->next = 0;
+
+		if (index->first[option]) {
+			index->segment[index->last[option] - 1].next = pos + 1;
+			index->length[option] += seg->len;
+		} else {
+			index->first[option] = pos + 1;
+			index->length[option] = seg->len;
 		}
+		index->last[option] = pos + 1;
 	}
 
 	if (options->underflow) {
 		ni_debug_dhcp("unable to parse DHCP4 response: truncated packet");
-		goto error;
+		return -1;
 	}
+	return 0;
+}
 
-	while ((opt = ni_dhcp_option_list_pull(&opts))) {
-		ni_buffer_t buf;
-		int option = opt->code;
+int
+ni_dhcp4_option_index_build(ni_dhcp4_option_index_t *index,
+			const ni_dhcp4_message_t *message, ni_buffer_t *options)
+{
+	ni_buffer_t overload_buf;
 
-		ni_buffer_init_reader(&buf, opt->data, opt->len);
-		switch (option) {
-		case DHCP4_ADDRESS:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.address);
-			break;
-		case DHCP4_NETMASK:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.netmask);
-			break;
-		case DHCP4_BROADCAST:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.broadcast);
-			break;
-		case DHCP4_SERVERIDENTIFIER:
-			ni_dhcp4_option_get_ipv4(&buf, &lease->dhcp4.server_id);
-			break;
-		case DHCP4_CLIENTID:
-			ni_dhcp4_option_get_opaque(&buf, &lease->dhcp4.client_id);
-			break;
-		case DHCP4_LEASETIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.lease_time);
-			break;
-		case DHCP4_RENEWALTIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.renewal_time);
-			break;
-		case DHCP4_REBINDTIME:
-			ni_dhcp4_option_get32(&buf, &lease->dhcp4.rebind_time);
-			break;
-		case DHCP4_MTU:
-			ni_dhcp4_option_get16(&buf, &lease->dhcp4.mtu);
-			/* Minimum legal mtu is 68 accoridng to
-			 * RFC 2132. In practise it's 576 which is the
-			 * minimum maximum message size. */
-			if (lease->dhcp4.mtu <= MTU_MIN) {
-				ni_debug_dhcp("MTU %u is too low, minimum is %d; ignoring",
-						lease->dhcp4.mtu, MTU_MIN);
-				lease->dhcp4.mtu = 0;
-			}
-			break;
-		case DHCP4_FQDN:
-			ni_dhcp4_option_get_fqdn(&buf, &lease->hostname, &lease->fqdn);
-			break;
-		case DHCP4_HOSTNAME:
-			if (lease->fqdn.enabled != NI_TRISTATE_ENABLE) {
-				ni_dhcp4_option_get_domain(&buf, &lease->hostname,
-								"hostname");
-			}
-			break;
-		case DHCP4_DNSDOMAIN:
-			ni_dhcp4_option_get_domain_list(&buf, &dns_domain,
-							"dns-domain");
-			break;
-		case DHCP4_MESSAGE:
-			ni_dhcp4_option_get_printable(&buf, &lease->dhcp4.message,
-							"dhcp4-message");
-			break;
-		case DHCP4_ROOTPATH:
-			ni_dhcp4_option_get_pathname(&buf, &lease->dhcp4.root_path,
-							"root-path");
-			break;
-		case DHCP4_NISDOMAIN:
-			ni_dhcp4_option_get_domain(&buf, &nisdomain,
-							"nis-domain");
-			break;
-		case DHCP4_NETBIOSNODETYPE:
-			ni_dhcp4_option_get_netbios_type(&buf, &lease->netbios_type);
-			break;
-		case DHCP4_NETBIOSSCOPE:
-			ni_dhcp4_option_get_domain(&buf, &lease->netbios_scope,
-							"netbios-scope");
-			break;
-		case DHCP4_DNSSERVER:
-			ni_dhcp4_decode_address_list(&buf, &dns_servers);
-			break;
-		case DHCP4_NTPSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->ntp_servers);
-			break;
-		case DHCP4_NISSERVER:
-			ni_dhcp4_decode_address_list(&buf, &nis_servers);
-			break;
-		case DHCP4_LPRSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->lpr_servers);
-			break;
-		case DHCP4_LOGSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->log_servers);
-			break;
-		case DHCP4_NETBIOSNAMESERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->netbios_name_servers);
-			break;
-		case DHCP4_NETBIOSDDSERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->netbios_dd_servers);
-			break;
-		case DHCP4_DNSSEARCH:
-			ni_dhcp4_decode_dnssearch(&buf, &dns_search, "dns-search domain");
-			break;
+	memset(index->first, 0, sizeof(index->first));
+	memset(index->last, 0, sizeof(index->last));
+	memset(index->area, 0, sizeof(index->area));
+	index->message = message;
+	index->msg_type = -1;
+	index->overload = 0;
+	index->count = 0;
 
-		case DHCP4_NDS_SERVER:
-			ni_dhcp4_decode_address_list(&buf, &lease->nds_servers);
-			break;
-		case DHCP4_NDS_CTX:
-			if (!ni_dhcp4_option_get_printable(&buf, &tmp, "nds-context"))
-				ni_string_array_append(&lease->nds_context, tmp);
-			ni_string_free(&tmp);
-			break;
-		case DHCP4_NDS_TREE:
-			ni_dhcp4_option_get_printable(&buf, &lease->nds_tree,
-							"nds-tree");
-			break;
+	if (ni_dhcp4_option_index_area(index, NI_DHCP4_OPTION_AREA_OPTIONS, options) < 0)
+		return -1;
 
-		case DHCP4_CSR:
-		case DHCP4_MSCSR:
-			ni_route_array_destroy(&classless_routes);
-			ni_dhcp4_decode_csr(&buf, &classless_routes);
-			break;
+	if (index->overload & DHCP4_OVERLOAD_BOOTFILE) {
+		ni_buffer_init_reader(&overload_buf, (void *) message->bootfile,
+					sizeof(message->bootfile));
+		if (ni_dhcp4_option_index_area(index, NI_DHCP4_OPTION_AREA_BOOTFILE,
+					&overload_buf) < 0)
+			return -1;
+	}
+	if (index->overload & DHCP4_OVERLOAD_SERVERNAME) {
+		ni_buffer_init_reader(&overload_buf, (void *) message->servername,
+					sizeof(message->servername));
+		if (ni_dhcp4_option_index_area(index, NI_DHCP4_OPTION_AREA_SERVERNAME,
+					&overload_buf) < 0)
+			return -1;
+	}
 
-		case DHCP4_SIPSERVER:
-			ni_dhcp4_decode_sipservers(&buf, &lease->sip_servers);
-			break;
+	return index->msg_type;
+}
 
-		case DHCP4_STATICROUTE:
-			ni_route_array_destroy(&static_routes);
-			ni_dhcp4_decode_static_routes(&buf, &static_routes);
-			break;
+/*
+ * Get a reader for the data of an indexed option. Only options
+ * split into several parts need to be copied to concatenate them;
+ * the copy is returned in *copy and has to be freed by the caller.
+ */
+static ni_bool_t
+ni_dhcp4_option_index_reader(const ni_dhcp4_option_index_t *index, unsigned int code,
+			ni_buffer_t *buf, unsigned char **copy)
+{
+	const ni_dhcp4_option_segment_t *seg;
+	unsigned int pos, len = 0;
 
-		case DHCP4_ROUTERS:
-			ni_route_array_destroy(&default_routes);
-			ni_dhcp4_decode_routers(&buf, &default_routes);
-			break;
+	*copy = NULL;
+	if (code > 255 || !(pos = index->first[code]))
+		return FALSE;
 
-		case DHCP4_POSIX_TZ_STRING:
-			ni_dhcp4_option_get_printable(&buf, &lease->posix_tz_string,
-							"posix-tz-string");
-			break;
+	seg = &index->segment[pos - 1];
+	if (!seg->next) {
+		ni_buffer_init_reader(buf, (void *) (index->area[seg->area] + seg->offset),
+					seg->len);
+		return TRUE;
+	}
 
-		case DHCP4_POSIX_TZ_DBNAME:
-			ni_dhcp4_option_get_printable(&buf, &lease->posix_tz_dbname,
-							"posix-tz-dbname");
-			break;
+	if (!(*copy = malloc(index->length[code])))
+		return FALSE;
 
-		default:
-			ni_debug_dhcp("adding unparsed DHCP4 option %s code %u len %u",
-					ni_dhcp4_option_name(option), option, opt->len);
+	for (; pos; pos = seg->next) {
+		seg = &index->segment[pos - 1];
+		memcpy(*copy + len, index->area[seg->area] + seg->offset, seg->len);
+		len += seg->len;
+	}
+	ni_buffer_init_reader(buf, *copy, len);
+	return TRUE;
+}
 
-			if (ni_dhcp_option_list_append(&lease->dhcp4.options, opt)) {
-				ni_buffer_clear(&buf);
-				opt = NULL;
-			}
-			break;
+ni_bool_t
+ni_dhcp4_option_index_has(const ni_dhcp4_option_index_t *index, unsigned int code)
+{
+	return code <= 255 && index->first[code];
+}
+
+ni_bool_t
+ni_dhcp4_option_index_get_ipv4(const ni_dhcp4_option_index_t *index, unsigned int code,
+			struct in_addr *addr)
+{
+	unsigned char *copy;
+	ni_buffer_t buf;
+	ni_bool_t ret;
+
+	if (!ni_dhcp4_option_index_reader(index, code, &buf, &copy))
+		return FALSE;
+
+	ret = ni_dhcp4_option_get_ipv4(&buf, addr) == 0;
+	free(copy);
+	return ret;
+}
+
+ni_bool_t
+ni_dhcp4_option_index_get_opaque(const ni_dhcp4_option_index_t *index, unsigned int code,
+			ni_opaque_t *opaque)
+{
+	unsigned char *copy;
+	ni_buffer_t buf;
+	ni_bool_t ret;
+
+	if (!ni_dhcp4_option_index_reader(index, code, &buf, &copy))
+		return FALSE;
+
+	ret = ni_dhcp4_option_get_opaque(&buf, opaque) == 0;
+	free(copy);
+	return ret;
+}
+
+/*
+ * Decoding of the indexed options into a lease.
+ *
+ * Options with a plain lease member type are described by their
+ * offset in the lease; anything that needs to be post-processed
+ * or checked has a decode function operating on the parser state.
+ */
+typedef struct ni_dhcp4_lease_parser {
+	const ni_dhcp4_config_t *config;
+	ni_addrconf_lease_t *	lease;
+
+	ni_route_array_t	default_routes;
+	ni_route_array_t	static_routes;
+	ni_route_array_t	classless_routes;
+	ni_string_array_t	dns_servers;
+	ni_string_array_t	dns_search;
+	ni_string_array_t	dns_domain;
+	ni_string_array_t	nis_servers;
+	char *			nisdomain;
+} ni_dhcp4_lease_parser_t;
+
+typedef enum ni_dhcp4_option_decode {
+	NI_DHCP4_DECODE_CUSTOM = 0,
+	NI_DHCP4_DECODE_IPV4,
+	NI_DHCP4_DECODE_UINT32,
+	NI_DHCP4_DECODE_OPAQUE,
+	NI_DHCP4_DECODE_ADDRESS_LIST,
+	NI_DHCP4_DECODE_DOMAIN,
+	NI_DHCP4_DECODE_PATHNAME,
+	NI_DHCP4_DECODE_PRINTABLE,
+	NI_DHCP4_DECODE_FUNC,
+} ni_dhcp4_option_decode_t;
+
+typedef struct ni_dhcp4_option_decoder {
+	ni_dhcp4_option_decode_t type;
+	size_t			offset;
+	const char *		what;
+	int			(*func)(ni_dhcp4_lease_parser_t *, ni_buffer_t *);
+} ni_dhcp4_option_decoder_t;
+
+static int
+ni_dhcp4_decode_opt_mtu(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	ni_addrconf_lease_t *lease = parser->lease;
+
+	ni_dhcp4_option_get16(buf, &lease->dhcp4.mtu);
+	/* Minimum legal mtu is 68 accoridng to
+	 * RFC 2132. In practise it's 576 which is the
+	 * minimum maximum message size. */
+	if (lease->dhcp4.mtu <= MTU_MIN) {
+		ni_debug_dhcp("MTU %u is too low, minimum is %d; ignoring",
+				lease->dhcp4.mtu, MTU_MIN);
+		lease->dhcp4.mtu = 0;
+	}
+	return 0;
+}
+
+static int
+ni_dhcp4_decode_opt_fqdn(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_option_get_fqdn(buf, &parser->lease->hostname, &parser->lease->fqdn);
+}
+
+static int
+ni_dhcp4_decode_opt_hostname(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	if (parser->lease->fqdn.enabled == NI_TRISTATE_ENABLE)
+		return 0;
+	return ni_dhcp4_option_get_domain(buf, &parser->lease->hostname, "hostname");
+}
+
+static int
+ni_dhcp4_decode_opt_dns_domain(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_option_get_domain_list(buf, &parser->dns_domain, "dns-domain");
+}
+
+static int
+ni_dhcp4_decode_opt_nis_domain(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_option_get_domain(buf, &parser->nisdomain, "nis-domain");
+}
+
+static int
+ni_dhcp4_decode_opt_netbios_type(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_option_get_netbios_type(buf, &parser->lease->netbios_type);
+}
+
+static int
+ni_dhcp4_decode_opt_dns_servers(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_decode_address_list(buf, &parser->dns_servers);
+}
+
+static int
+ni_dhcp4_decode_opt_nis_servers(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_decode_address_list(buf, &parser->nis_servers);
+}
+
+static int
+ni_dhcp4_decode_opt_dns_search(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_decode_dnssearch(buf, &parser->dns_search, "dns-search domain");
+}
+
+static int
+ni_dhcp4_decode_opt_nds_context(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	char *tmp = NULL;
+
+	if (!ni_dhcp4_option_get_printable(buf, &tmp, "nds-context"))
+		ni_string_array_append(&parser->lease->nds_context, tmp);
+	ni_string_free(&tmp);
+	return 0;
+}
+
+static int
+ni_dhcp4_decode_opt_classless_routes(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	ni_route_array_destroy(&parser->classless_routes);
+	return ni_dhcp4_decode_csr(buf, &parser->classless_routes);
+}
+
+static int
+ni_dhcp4_decode_opt_sip_servers(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	return ni_dhcp4_decode_sipservers(buf, &parser->lease->sip_servers);
+}
+
+static int
+ni_dhcp4_decode_opt_static_routes(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	ni_route_array_destroy(&parser->static_routes);
+	return ni_dhcp4_decode_static_routes(buf, &parser->static_routes);
+}
+
+static int
+ni_dhcp4_decode_opt_routers(ni_dhcp4_lease_parser_t *parser, ni_buffer_t *buf)
+{
+	ni_route_array_destroy(&parser->default_routes);
+	return ni_dhcp4_decode_routers(buf, &parser->default_routes);
+}
+
+#define NI_DHCP4_LEASE_MEMBER(_type, _member, _what)		\
+	{ .type = NI_DHCP4_DECODE_##_type,			\
+	  .offset = offsetof(ni_addrconf_lease_t, _member),	\
+	  .what = _what }
+#define NI_DHCP4_LEASE_DECODER(_func)				\
+	{ .type = NI_DHCP4_DECODE_FUNC, .func = _func }
+
+static const ni_dhcp4_option_decoder_t	ni_dhcp4_option_decoders[256] = {
+	[DHCP4_ADDRESS]			= NI_DHCP4_LEASE_MEMBER(IPV4, dhcp4.address, NULL),
+	[DHCP4_NETMASK]			= NI_DHCP4_LEASE_MEMBER(IPV4, dhcp4.netmask, NULL),
+	[DHCP4_BROADCAST]		= NI_DHCP4_LEASE_MEMBER(IPV4, dhcp4.broadcast, NULL),
+	[DHCP4_SERVERIDENTIFIER]	= NI_DHCP4_LEASE_MEMBER(IPV4, dhcp4.server_id, NULL),
+	[DHCP4_CLIENTID]		= NI_DHCP4_LEASE_MEMBER(OPAQUE, dhcp4.client_id, NULL),
+	[DHCP4_LEASETIME]		= NI_DHCP4_LEASE_MEMBER(UINT32, dhcp4.lease_time, NULL),
+	[DHCP4_RENEWALTIME]		= NI_DHCP4_LEASE_MEMBER(UINT32, dhcp4.renewal_time, NULL),
+	[DHCP4_REBINDTIME]		= NI_DHCP4_LEASE_MEMBER(UINT32, dhcp4.rebind_time, NULL),
+	[DHCP4_MTU]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_mtu),
+	[DHCP4_FQDN]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_fqdn),
+	[DHCP4_HOSTNAME]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_hostname),
+	[DHCP4_DNSDOMAIN]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_dns_domain),
+	[DHCP4_MESSAGE]			= NI_DHCP4_LEASE_MEMBER(PRINTABLE, dhcp4.message, "dhcp4-message"),
+	[DHCP4_ROOTPATH]		= NI_DHCP4_LEASE_MEMBER(PATHNAME, dhcp4.root_path, "root-path"),
+	[DHCP4_NISDOMAIN]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_nis_domain),
+	[DHCP4_NETBIOSNODETYPE]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_netbios_type),
+	[DHCP4_NETBIOSSCOPE]		= NI_DHCP4_LEASE_MEMBER(DOMAIN, netbios_scope, "netbios-scope"),
+	[DHCP4_DNSSERVER]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_dns_servers),
+	[DHCP4_NTPSERVER]		= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, ntp_servers, NULL),
+	[DHCP4_NISSERVER]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_nis_servers),
+	[DHCP4_LPRSERVER]		= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, lpr_servers, NULL),
+	[DHCP4_LOGSERVER]		= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, log_servers, NULL),
+	[DHCP4_NETBIOSNAMESERVER]	= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, netbios_name_servers, NULL),
+	[DHCP4_NETBIOSDDSERVER]		= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, netbios_dd_servers, NULL),
+	[DHCP4_DNSSEARCH]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_dns_search),
+	[DHCP4_NDS_SERVER]		= NI_DHCP4_LEASE_MEMBER(ADDRESS_LIST, nds_servers, NULL),
+	[DHCP4_NDS_CTX]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_nds_context),
+	[DHCP4_NDS_TREE]		= NI_DHCP4_LEASE_MEMBER(PRINTABLE, nds_tree, "nds-tree"),
+	[DHCP4_CSR]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_classless_routes),
+	[DHCP4_MSCSR]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_classless_routes),
+	[DHCP4_SIPSERVER]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_sip_servers),
+	[DHCP4_STATICROUTE]		= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_static_routes),
+	[DHCP4_ROUTERS]			= NI_DHCP4_LEASE_DECODER(ni_dhcp4_decode_opt_routers),
+	[DHCP4_POSIX_TZ_STRING]		= NI_DHCP4_LEASE_MEMBER(PRINTABLE, posix_tz_string, "posix-tz-string"),
+	[DHCP4_POSIX_TZ_DBNAME]		= NI_DHCP4_LEASE_MEMBER(PRINTABLE, posix_tz_dbname, "posix-tz-dbname"),
+};
+
+static void
+ni_dhcp4_option_decode(ni_dhcp4_lease_parser_t *parser, unsigned int option, ni_buffer_t *buf)
+{
+	const ni_dhcp4_option_decoder_t *decoder = &ni_dhcp4_option_decoders[option];
+	void *member = (char *)parser->lease + decoder->offset;
+	ni_dhcp_option_t *opt;
+
+	switch (decoder->type) {
+	case NI_DHCP4_DECODE_IPV4:
+		ni_dhcp4_option_get_ipv4(buf, member);
+		break;
+	case NI_DHCP4_DECODE_UINT32:
+		ni_dhcp4_option_get32(buf, member);
+		break;
+	case NI_DHCP4_DECODE_OPAQUE:
+		ni_dhcp4_option_get_opaque(buf, member);
+		break;
+	case NI_DHCP4_DECODE_ADDRESS_LIST:
+		ni_dhcp4_decode_address_list(buf, member);
+		break;
+	case NI_DHCP4_DECODE_DOMAIN:
+		ni_dhcp4_option_get_domain(buf, member, decoder->what);
+		break;
+	case NI_DHCP4_DECODE_PATHNAME:
+		ni_dhcp4_option_get_pathname(buf, member, decoder->what);
+		break;
+	case NI_DHCP4_DECODE_PRINTABLE:
+		ni_dhcp4_option_get_printable(buf, member, decoder->what);
+		break;
+	case NI_DHCP4_DECODE_FUNC:
+		decoder->func(parser, buf);
+		break;
+	case NI_DHCP4_DECODE_CUSTOM:
+	default:
+		ni_debug_dhcp("adding unparsed DHCP4 option %s code %u len %u",
+				ni_dhcp4_option_name(option), option,
+				ni_buffer_count(buf));
+
+		opt = ni_dhcp_option_new(option, ni_buffer_count(buf), ni_buffer_head(buf));
+		if (opt && ni_dhcp_option_list_append(&parser->lease->dhcp4.options, opt))
+			ni_buffer_clear(buf);
+		else
+			ni_dhcp_option_free(opt);
+		break;
+	}
+}
+
+/*
+ * Parse the lease from an indexed DHCP4 response.
+ */
+int
+ni_dhcp4_parse_lease(const ni_dhcp4_config_t *config, const ni_dhcp4_option_index_t *index,
+			ni_addrconf_lease_t **leasep)
+{
+	const ni_dhcp4_message_t *message = index->message;
+	ni_dhcp4_lease_parser_t parser;
+	ni_addrconf_lease_t *lease;
+	unsigned int pfxlen, i;
+
+	if (index->msg_type < 0)
+		return -1;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.config = config;
+	parser.lease = lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+
+	lease->state = NI_ADDRCONF_STATE_GRANTED;
+	lease->type = NI_ADDRCONF_DHCP;
+	lease->family = AF_INET;
+	ni_timer_get_time(&lease->acquired);
+	lease->fqdn.enabled = NI_TRISTATE_DEFAULT;
+	lease->fqdn.qualify = config->fqdn.qualify;
+
+	lease->dhcp4.address.s_addr = message->yiaddr;
+	lease->dhcp4.boot_saddr.s_addr = message->siaddr;
+	lease->dhcp4.relay_addr.s_addr = message->giaddr;
+
+	/* Decode the options in the order of their first appearance */
+	for (i = 0; i < index->count; ++i) {
+		unsigned int option = index->segment[i].code;
+		unsigned char *copy;
+		ni_buffer_t buf;
+
+		if (index->first[option] != i + 1)
+			continue;
+
+		if (!ni_dhcp4_option_index_reader(index, option, &buf, &copy)) {
+			ni_debug_dhcp("unable to allocate DHCP4 option %s",
+					ni_dhcp4_option_name(option));
+			continue;
 		}
 
-		ni_dhcp_option_free(opt);
+		ni_dhcp4_option_decode(&parser, option, &buf);
 		if (buf.underflow) {
 			ni_debug_dhcp("unable to parse DHCP4 option %s (%u): too short",
 					ni_dhcp4_option_name(option), option);
@@ -2075,34 +2431,10 @@ parse_more:
 					ni_dhcp4_option_name(option), option,
 					ni_buffer_count(&buf));
 		}
+		free(copy);
 	}
 
-	if (opt_overload) {
-		const void *more_data = NULL;
-		size_t size = 0;
-
-		if (opt_overload & DHCP4_OVERLOAD_BOOTFILE) {
-			use_bootfile = 0;
-			more_data = message->bootfile;
-			size = sizeof(message->bootfile);
-			opt_overload &= ~DHCP4_OVERLOAD_BOOTFILE;
-		} else
-		if (opt_overload & DHCP4_OVERLOAD_SERVERNAME) {
-			use_bootserver = 0;
-			more_data = message->servername;
-			size = sizeof(message->servername);
-			opt_overload &= ~DHCP4_OVERLOAD_SERVERNAME;
-		} else {
-			opt_overload = 0;
-		}
-		if (more_data) {
-			ni_buffer_init_reader(&overload_buf, (void *) more_data, size);
-			options = &overload_buf;
-			goto parse_more;
-		}
-	}
-
-	if (use_bootserver && message->servername[0]) {
+	if (!(index->overload & DHCP4_OVERLOAD_SERVERNAME) && message->servername[0]) {
 		char tmp[sizeof(message->servername)];
 		size_t len;
 
@@ -2117,7 +2449,7 @@ parse_more:
 				ni_print_suspect(tmp, len));
 		}
 	}
-	if (use_bootfile && message->bootfile[0]) {
+	if (!(index->overload & DHCP4_OVERLOAD_BOOTFILE) && message->bootfile[0]) {
 		char tmp[sizeof(message->bootfile)];
 		size_t len;
 
@@ -2159,65 +2491,68 @@ parse_more:
 			ni_sockaddr_set_ipv4(&ap->bcast_addr, lease->dhcp4.broadcast, 0);
 	}
 
-	if (classless_routes.count) {
+	if (parser.classless_routes.count) {
 		/* if CSR or MSCSR are available, ignore other routes */
-		ni_dhcp4_apply_routes(lease, &classless_routes);
-		ni_route_array_destroy(&classless_routes);
+		ni_dhcp4_apply_routes(lease, &parser.classless_routes);
 	} else {
-		ni_dhcp4_apply_routes(lease, &static_routes);
-		ni_route_array_destroy(&static_routes);
-		ni_dhcp4_apply_routes(lease, &default_routes);
-		ni_route_array_destroy(&default_routes);
+		ni_dhcp4_apply_routes(lease, &parser.static_routes);
+		ni_dhcp4_apply_routes(lease, &parser.default_routes);
 	}
 
-	if (dns_servers.count || dns_search.count || dns_domain.count) {
+	if (parser.dns_servers.count || parser.dns_search.count || parser.dns_domain.count) {
 		ni_resolver_info_t *resolver = ni_resolver_info_new();
 
-		if (dns_domain.count)
-			ni_string_dup(&resolver->default_domain, dns_domain.data[0]);
+		if (parser.dns_domain.count)
+			ni_string_dup(&resolver->default_domain, parser.dns_domain.data[0]);
 
-		if (dns_search.count)
-			ni_string_array_move(&resolver->dns_search, &dns_search);
+		if (parser.dns_search.count)
+			ni_string_array_move(&resolver->dns_search, &parser.dns_search);
 		else
-			ni_string_array_move(&resolver->dns_search, &dns_domain);
+			ni_string_array_move(&resolver->dns_search, &parser.dns_domain);
 
-		ni_string_array_move(&resolver->dns_servers, &dns_servers);
+		ni_string_array_move(&resolver->dns_servers, &parser.dns_servers);
 		lease->resolver = resolver;
 	}
-	if (nisdomain != NULL) {
+	if (parser.nisdomain != NULL) {
 		ni_nis_info_t *nis = ni_nis_info_new();
 
-		nis->domainname = nisdomain;
-		nisdomain = NULL;
+		nis->domainname = parser.nisdomain;
+		parser.nisdomain = NULL;
 
-		if (nis_servers.count == 0)
+		if (parser.nis_servers.count == 0)
 			nis->default_binding = NI_NISCONF_BROADCAST;
 		else
-			ni_string_array_move(&nis->default_servers, &nis_servers);
+			ni_string_array_move(&nis->default_servers, &parser.nis_servers);
 		lease->nis = nis;
 	}
 
 	*leasep = lease;
-	lease = NULL;
-
-done:
-	ni_route_array_destroy(&default_routes);
-	ni_route_array_destroy(&static_routes);
-	ni_route_array_destroy(&classless_routes);
-	ni_string_array_destroy(&dns_servers);
-	ni_string_array_destroy(&dns_search);
-	ni_string_array_destroy(&dns_domain);
-	ni_string_array_destroy(&nis_servers);
-	ni_string_free(&nisdomain);
-	ni_dhcp_option_list_destroy(&opts);
-
-	return msg_type;
-
-error:
-	if (lease)
-		ni_addrconf_lease_free(lease);
-	msg_type = -1;
-	goto done;
+
+	ni_route_array_destroy(&parser.default_routes);
+	ni_route_array_destroy(&parser.static_routes);
+	ni_route_array_destroy(&parser.classless_routes);
+	ni_string_array_destroy(&parser.dns_servers);
+	ni_string_array_destroy(&parser.dns_search);
+	ni_string_array_destroy(&parser.dns_domain);
+	ni_string_array_destroy(&parser.nis_servers);
+	ni_string_free(&parser.nisdomain);
+
+	return index->msg_type;
+}
+
+/*
+ * Parse a DHCP4 response.
+ */
+int
+ni_dhcp4_parse_response(const ni_dhcp4_config_t *config, const ni_dhcp4_message_t *message,
+			ni_buffer_t *options, ni_addrconf_lease_t **leasep)
+{
+	ni_dhcp4_option_index_t index;
+
+	if (ni_dhcp4_option_index_build(&index, message, options) < 0)
+		return -1;
+
+	return ni_dhcp4_parse_lease(config, &index, leasep);
 }
 
 /*
@@ -79,6 +79,15 @@
 
 ni_dhcp6_device_t *		ni_dhcp6_active;
 
+/*
+ * Hash tables to find the device of an interface index or of the
+ * transaction id of a message without walking the active list.
+ */
+#define NI_DHCP6_DEVICE_HASH_SIZE	1024
+
+static ni_dhcp6_device_t *		ni_dhcp6_index_hash[NI_DHCP6_DEVICE_HASH_SIZE];
+static ni_dhcp6_device_t *		ni_dhcp6_xid_hash[NI_DHCP6_DEVICE_HASH_SIZE];
+
 static void			ni_dhcp6_device_close(ni_dhcp6_device_t *);
 static void			ni_dhcp6_device_free(ni_dhcp6_device_t *);
 
@@ -91,6 +100,48 @@ static void			ni_dhcp6_device_config_free(ni_dhcp6_config_t *);
 static void			ni_dhcp6_config_set_request_options(const char *, ni_uint_array_t *, const ni_string_array_t *);
 
 
+static inline unsigned int
+ni_dhcp6_index_hash_slot(unsigned int ifindex)
+{
+	return ifindex % NI_DHCP6_DEVICE_HASH_SIZE;
+}
+
+static inline unsigned int
+ni_dhcp6_xid_hash_slot(unsigned int xid)
+{
+	return (xid ^ (xid >> 12)) % NI_DHCP6_DEVICE_HASH_SIZE;
+}
+
+static void
+ni_dhcp6_index_hash_unlink(ni_dhcp6_device_t *dev)
+{
+	ni_dhcp6_device_t **pos;
+
+	pos = &ni_dhcp6_index_hash[ni_dhcp6_index_hash_slot(dev->link.ifindex)];
+	for (; *pos; pos = &(*pos)->index_next) {
+		if (*pos == dev) {
+			*pos = dev->index_next;
+			break;
+		}
+	}
+	dev->index_next = NULL;
+}
+
+static void
+ni_dhcp6_xid_hash_unlink(ni_dhcp6_device_t *dev)
+{
+	ni_dhcp6_device_t **pos;
+
+	pos = &ni_dhcp6_xid_hash[ni_dhcp6_xid_hash_slot(dev->dhcp6.xid)];
+	for (; *pos; pos = &(*pos)->xid_next) {
+		if (*pos == dev) {
+			*pos = dev->xid_next;
+			break;
+		}
+	}
+	dev->xid_next = NULL;
+}
+
 /*
  * Create and destroy dhcp6 device handles
  */
@@ -113,6 +164,10 @@ ni_dhcp6_device_new(const char *ifname, const ni_linkinfo_t *link)
 	/* append to end of list */
 	*pos = dev;
 
+	pos = &ni_dhcp6_index_hash[ni_dhcp6_index_hash_slot(dev->link.ifindex)];
+	dev->index_next = *pos;
+	*pos = dev;
+
 	return dev;
 }
 
@@ -121,13 +176,49 @@ ni_dhcp6_device_by_index(unsigned int ifindex)
 {
 	ni_dhcp6_device_t *dev;
 
-	for (dev = ni_dhcp6_active; dev; dev = dev->next) {
+	dev = ni_dhcp6_index_hash[ni_dhcp6_index_hash_slot(ifindex)];
+	for (; dev; dev = dev->index_next) {
 		if (dev->link.ifindex == ifindex)
 			return dev;
 	}
 	return NULL;
 }
 
+ni_dhcp6_device_t *
+ni_dhcp6_device_by_xid(unsigned int xid)
+{
+	ni_dhcp6_device_t *dev;
+
+	if (!xid)
+		return NULL;
+
+	dev = ni_dhcp6_xid_hash[ni_dhcp6_xid_hash_slot(xid)];
+	for (; dev; dev = dev->xid_next) {
+		if (dev->dhcp6.xid == xid)
+			return dev;
+	}
+	return NULL;
+}
+
+void
+ni_dhcp6_device_set_xid(ni_dhcp6_device_t *dev, unsigned int xid)
+{
+	ni_dhcp6_device_t **pos;
+
+	if (dev->dhcp6.xid == xid)
+		return;
+
+	if (dev->dhcp6.xid)
+		ni_dhcp6_xid_hash_unlink(dev);
+
+	dev->dhcp6.xid = xid;
+	if (xid) {
+		pos = &ni_dhcp6_xid_hash[ni_dhcp6_xid_hash_slot(xid)];
+		dev->xid_next = *pos;
+		*pos = dev;
+	}
+}
+
 /*
  * Refcount handling
  */
@@ -208,6 +299,8 @@ ni_dhcp6_device_free(ni_dhcp6_device_t *dev)
 	ni_dhcp6_device_set_config(dev, NULL);
 	ni_dhcp6_device_set_request(dev, NULL);
 
+	ni_dhcp6_device_set_xid(dev, 0);
+	ni_dhcp6_index_hash_unlink(dev);
 	ni_string_free(&dev->ifname);
 	dev->link.ifindex = 0;
 
@@ -731,7 +824,7 @@ ni_dhcp6_device_retransmit_disarm(ni_dhcp6_device_t *dev)
 				dev->ifname, ni_dhcp6_print_timeval(&now));
 	}
 
-	dev->dhcp6.xid = 0;
+	ni_dhcp6_device_set_xid(dev, 0);
 	memset(&dev->retrans, 0, sizeof(dev->retrans));
 }
 
@@ -1233,7 +1326,7 @@ ni_dhcp6_device_transmit(ni_dhcp6_device_t *dev)
 		return rv;
 	}
 
-	rv = ni_dhcp6_socket_send(dev->mcast.sock, &dev->message, &dev->mcast.dest);
+	rv = ni_dhcp6_mcast_socket_send(dev, &dev->message);
 	if (rv <= 0 || (size_t)rv != cnt) {
 		/* Hmm... advance retrans.count here? Use stop? */
 
@@ -23,6 +23,8 @@
 #ifndef __WICKED_DHCP6_DEVICE_H__
 #define __WICKED_DHCP6_DEVICE_H__
 
+extern ni_dhcp6_device_t *ni_dhcp6_active;
+
 /* device functions used in fsm.c and protocol.c */
 extern int		ni_dhcp6_device_transmit_init(ni_dhcp6_device_t *);
 extern int		ni_dhcp6_device_transmit_start(ni_dhcp6_device_t *);
@@ -30,6 +32,7 @@ extern int		ni_dhcp6_device_transmit(ni_dhcp6_device_t *);
 
 extern int		ni_dhcp6_device_retransmit(ni_dhcp6_device_t *);
 extern void		ni_dhcp6_device_retransmit_disarm(ni_dhcp6_device_t *);
+extern void		ni_dhcp6_device_set_xid(ni_dhcp6_device_t *, unsigned int);
 
 extern ni_bool_t	ni_dhcp6_device_is_ready(const ni_dhcp6_device_t *, const ni_netdev_t *);
 extern void		ni_dhcp6_device_update_mode(ni_dhcp6_device_t *, const ni_netdev_t *);
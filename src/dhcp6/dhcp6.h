@@ -169,6 +169,8 @@ struct ni_dhcp6_config {
  */
 struct ni_dhcp6_device {
 	struct ni_dhcp6_device *next;
+	struct ni_dhcp6_device *index_next;	/* ifindex hash chain		*/
+	struct ni_dhcp6_device *xid_next;	/* xid hash chain		*/
 	unsigned int		users;
 
 	char *			ifname;		/* cached interface name	*/
@@ -238,6 +240,7 @@ extern void			ni_dhcp6_device_put(ni_dhcp6_device_t *);
 
 extern ni_dhcp6_device_t *	ni_dhcp6_device_by_index(unsigned int);
 extern ni_dhcp6_device_t *	ni_dhcp6_device_by_index_show_all(unsigned int);
+extern ni_dhcp6_device_t *	ni_dhcp6_device_by_xid(unsigned int);
 
 extern void			ni_dhcp6_device_set_request(ni_dhcp6_device_t *, ni_dhcp6_request_t *);
 extern ni_bool_t		ni_dhcp6_device_check_ready(ni_dhcp6_device_t *);
@@ -1418,7 +1418,7 @@ ni_dhcp6_fsm_solicit(ni_dhcp6_device_t *dev)
 		lease->fqdn.enabled = NI_TRISTATE_DEFAULT;
 		lease->fqdn.qualify = dev->config->fqdn.qualify;
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		ni_dhcp6_device_drop_best_offer(dev);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_SOLICIT, lease) != 0)
 			goto cleanup;
@@ -1490,7 +1490,7 @@ ni_dhcp6_fsm_request_lease(ni_dhcp6_device_t *dev, const ni_addrconf_lease_t *le
 		ni_info("%s: Requesting DHCPv6 lease with timeout %d sec",
 			dev->ifname, dev->config->acquire_timeout);
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_REQUEST, lease) != 0)
 			return -1;
 
@@ -1517,7 +1517,7 @@ ni_dhcp6_fsm_request_info(ni_dhcp6_device_t *dev)
 		ni_debug_dhcp("%s: Initiating DHCPv6 Info Request",
 				dev->ifname);
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_INFO_REQUEST, NULL) != 0)
 			return -1;
 
@@ -1551,7 +1551,7 @@ ni_dhcp6_fsm_confirm_lease(ni_dhcp6_device_t *dev, const ni_addrconf_lease_t *le
 		ni_debug_dhcp("%s: Initiating DHCPv6 Lease Confirmation",
 				dev->ifname);
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_CONFIRM, lease) != 0)
 			return -1;
 
@@ -1596,7 +1596,7 @@ ni_dhcp6_fsm_renew(ni_dhcp6_device_t *dev)
 		ni_info("%s: Initiating renewal of DHCPv6 lease, duration %u sec until %s",
 				dev->ifname, deadline, ni_dhcp6_print_timeval(&now));
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_RENEW, dev->lease) != 0)
 			return -1;
 
@@ -1651,7 +1651,7 @@ ni_dhcp6_fsm_rebind(ni_dhcp6_device_t *dev)
 		ni_info("%s: Initiating rebind of DHCPv6 lease, duration %u sec until %s",
 			dev->ifname, deadline, ni_dhcp6_print_timeval(&now));
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_REBIND, dev->lease) != 0)
 			return -1;
 
@@ -1732,7 +1732,7 @@ ni_dhcp6_fsm_decline(ni_dhcp6_device_t *dev)
 				"No DHCPv6 lease address marked to decline"))
 			return -1;
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_DECLINE, dev->lease) != 0)
 			return -1;
 
@@ -1766,7 +1766,7 @@ __ni_dhcp6_fsm_release(ni_dhcp6_device_t *dev, unsigned int nretries)
 		/* currently all addresses */
 		ni_dhcp6_ia_release_matching(dev->lease->dhcp6.ia_list, NULL, 0);
 
-		dev->dhcp6.xid = 0;
+		ni_dhcp6_device_set_xid(dev, 0);
 		if (ni_dhcp6_init_message(dev, NI_DHCP6_RELEASE, dev->lease) != 0)
 			return -1;
 
@@ -54,6 +54,7 @@
 #include "dhcp.h"
 #include "socket_priv.h"
 #include "netinfo_priv.h"
+#include "appconfig.h"
 #include "buffer.h"
 #include "debug.h"
 #include "duid.h"
@@ -72,6 +73,11 @@
  */
 #define NI_DHCP6_OPTION_REQUEST_CHUNK	16
 
+/*
+ * Receive buffer size of the socket shared by all devices
+ */
+#define NI_DHCP6_SHARED_SOCKET_RCVBUF	(4 * NI_DHCP6_RBUF_SIZE)
+
 
 //extern int	ni_dhcp6_device_retransmit(ni_dhcp6_device_t *dev);
 
@@ -82,6 +88,23 @@ static int	ni_dhcp6_process_packet		(ni_dhcp6_device_t *dev, ni_buffer_t *msgbuf
 static int	ni_dhcp6_socket_get_timeout	(const ni_socket_t *sock, struct timeval *tv);
 static void	ni_dhcp6_socket_check_timeout	(ni_socket_t *sock, const struct timeval *now);
 
+static ssize_t	__ni_dhcp6_socket_send		(ni_socket_t *, const ni_buffer_t *, const ni_sockaddr_t *,
+						 const struct ni_dhcp6_link *);
+static void	ni_dhcp6_shared_socket_recv	(ni_socket_t *);
+static int	ni_dhcp6_shared_socket_get_timeout(const ni_socket_t *sock, struct timeval *tv);
+static void	ni_dhcp6_shared_socket_check_timeout(ni_socket_t *sock, const struct timeval *now);
+
+/*
+ * In the shared socket mode, all devices send and receive using
+ * one socket bound to the unspecified address and client port.
+ * The devices hold a reference to it, the socket is closed when
+ * the last device is detached from it.
+ */
+static struct {
+	ni_socket_t *	sock;
+	unsigned int	users;
+} ni_dhcp6_shared;
+
 static int	ni_dhcp6_option_next(ni_buffer_t *options, ni_buffer_t *optbuf);
 static int	ni_dhcp6_option_get_duid(ni_buffer_t *bp, ni_opaque_t *duid);
 
@@ -162,6 +185,115 @@ __ni_dhcp6_mcast_socket_open(const struct ni_dhcp6_link *link, const char *ifnam
 	return fd;
 }
 
+/*
+ * Open the socket shared by all devices, bound to the unspecified address
+ * and dhcp6 client port. The outgoing interface and link-local source
+ * address are set per message using IPV6_PKTINFO and the incoming ones
+ * are dispatched to the devices using the received IPV6_PKTINFO.
+ */
+static int
+__ni_dhcp6_shared_socket_open(void)
+{
+	ni_sockaddr_t saddr;
+	int fd, on;
+
+	if ((fd = socket (PF_INET6, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
+		ni_error("Cannot open shared socket(INET6, DGRAM, UDP): %m");
+		return -1;
+	}
+
+	on = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1)
+		ni_error("Cannot set shared socket setsockopt(SO_REUSEADDR): %m");
+
+	on = NI_DHCP6_SHARED_SOCKET_RCVBUF;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &on, sizeof(on)) == -1)
+		ni_error("Cannot set shared socket setsockopt(SO_RCVBUF): %m");
+
+	on = 1;
+	if (setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &on, sizeof(on)) != 0) {
+		ni_error("Cannot set shared socket setsockopt(IPV6_RECVPKTINFO): %m");
+		close(fd);
+		return -1;
+	}
+
+	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+		ni_error("Cannot set shared socket fcntl(SETDF, CLOEXEC): %m");
+
+	ni_sockaddr_set_ipv6(&saddr, in6addr_any, NI_DHCP6_CLIENT_PORT);
+	if (bind(fd, &saddr.sa, sizeof(saddr.six)) == -1) {
+		ni_error("Cannot bind shared socket to %s: %m", ni_sockaddr_print(&saddr));
+		close(fd);
+		return -1;
+	}
+
+	ni_debug_dhcp("bound shared DHCPv6 socket to [%s]:%u",
+		ni_sockaddr_print(&saddr), ntohs(saddr.six.sin6_port));
+
+	return fd;
+}
+
+static inline ni_bool_t
+ni_dhcp6_socket_is_shared(const ni_socket_t *sock)
+{
+	return sock && sock->user_data == &ni_dhcp6_shared;
+}
+
+static int
+ni_dhcp6_shared_socket_attach(ni_dhcp6_device_t *dev)
+{
+	ni_socket_t *sock = ni_dhcp6_shared.sock;
+	int fd;
+
+	if (sock && (!sock->active || sock->error)) {
+		/* there were a receive error; the attached devices
+		 * release the old one on their next transmission */
+		ni_dhcp6_shared.sock = NULL;
+		ni_dhcp6_shared.users = 0;
+		ni_socket_close(sock);
+		sock = NULL;
+	}
+
+	if (!sock) {
+		if ((fd = __ni_dhcp6_shared_socket_open()) == -1)
+			return -1;
+
+		if (!(sock = ni_socket_wrap(fd, SOCK_DGRAM))) {
+			ni_error("Unable to prepare shared DHCPv6 socket");
+			close(fd);
+			return -1;
+		}
+		sock->user_data = &ni_dhcp6_shared;
+		sock->receive = ni_dhcp6_shared_socket_recv;
+		sock->get_timeout = ni_dhcp6_shared_socket_get_timeout;
+		sock->check_timeout = ni_dhcp6_shared_socket_check_timeout;
+
+		/* See rfc2460#section-5, Packet Size Issues. Allocate max buffer */
+		ni_buffer_init_dynamic(&sock->rbuf, NI_DHCP6_RBUF_SIZE);
+
+		ni_socket_activate(sock);
+		ni_dhcp6_shared.sock = sock;
+	}
+
+	ni_dhcp6_shared.users++;
+	dev->mcast.sock = ni_socket_hold(sock);
+	ni_debug_dhcp("%s: attached to shared DHCPv6 socket [fd=%d, users=%u]",
+			dev->ifname, sock->__fd, ni_dhcp6_shared.users);
+	return 0;
+}
+
+static void
+ni_dhcp6_shared_socket_detach(ni_socket_t *sock)
+{
+	if (sock == ni_dhcp6_shared.sock && ni_dhcp6_shared.users &&
+	    --ni_dhcp6_shared.users == 0) {
+		ni_debug_dhcp("closing shared DHCPv6 socket [fd=%d]", sock->__fd);
+		ni_dhcp6_shared.sock = NULL;
+		ni_socket_close(sock);
+	}
+	ni_socket_release(sock);
+}
+
 /*
  * Open a DHCP6 socket for send and receive
  */
@@ -203,6 +335,9 @@ ni_dhcp6_mcast_socket_open(ni_dhcp6_device_t *dev)
 	dev->mcast.dest.six.sin6_port = htons(NI_DHCP6_SERVER_PORT);
 	dev->mcast.dest.six.sin6_scope_id = dev->link.ifindex;
 
+	if (ni_config_addrconf_dhcp6_shared_socket())
+		return ni_dhcp6_shared_socket_attach(dev);
+
 	/* open the socket an bind to the link-local address */
 	if ((fd = __ni_dhcp6_mcast_socket_open(&dev->link, dev->ifname)) == -1)
 		return -1;
@@ -230,15 +365,43 @@ ni_dhcp6_mcast_socket_open(ni_dhcp6_device_t *dev)
 void
 ni_dhcp6_mcast_socket_close(ni_dhcp6_device_t *dev)
 {
+	if (ni_dhcp6_socket_is_shared(dev->mcast.sock))
+		ni_dhcp6_shared_socket_detach(dev->mcast.sock);
+	else
 	if (dev->mcast.sock)
 		ni_socket_close(dev->mcast.sock);
 	dev->mcast.sock = NULL;
 	memset(&dev->mcast.dest, 0, sizeof(dev->mcast.dest));
 }
 
+/*
+ * Send the message to the multicast destination of the device,
+ * using its link-local address on the shared socket explicitly.
+ */
+ssize_t
+ni_dhcp6_mcast_socket_send(ni_dhcp6_device_t *dev, const ni_buffer_t *mesg)
+{
+	if (ni_dhcp6_socket_is_shared(dev->mcast.sock))
+		return __ni_dhcp6_socket_send(dev->mcast.sock, mesg, &dev->mcast.dest, &dev->link);
+	else
+		return __ni_dhcp6_socket_send(dev->mcast.sock, mesg, &dev->mcast.dest, NULL);
+}
+
 ssize_t
 ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockaddr_t *dest)
 {
+	return __ni_dhcp6_socket_send(sock, mesg, dest, NULL);
+}
+
+static ssize_t
+__ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockaddr_t *dest,
+			const struct ni_dhcp6_link *link)
+{
+	unsigned char cbuf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+	struct in6_pktinfo *pinfo;
+	struct cmsghdr *cm;
+	struct iovec iov;
+	struct msghdr msg;
 	int flags = 0;
 	size_t cnt;
 
@@ -261,8 +424,31 @@ ni_dhcp6_socket_send(ni_socket_t *sock, const ni_buffer_t *mesg, const ni_sockad
 	    ni_sockaddr_is_ipv6_linklocal(dest))
 		flags |= MSG_DONTROUTE;
 
-	return sendto(sock->__fd, ni_buffer_head(mesg), cnt,
-			flags, &dest->sa, sizeof(dest->six));
+	if (!link) {
+		return sendto(sock->__fd, ni_buffer_head(mesg), cnt,
+				flags, &dest->sa, sizeof(dest->six));
+	}
+
+	memset(&cbuf, 0, sizeof(cbuf));
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = ni_buffer_head(mesg);
+	iov.iov_len = cnt;
+	msg.msg_name = (void *)&dest->six;
+	msg.msg_namelen = sizeof(dest->six);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = IPPROTO_IPV6;
+	cm->cmsg_type = IPV6_PKTINFO;
+	cm->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+	pinfo = (struct in6_pktinfo *)(CMSG_DATA(cm));
+	pinfo->ipi6_ifindex = link->ifindex;
+	pinfo->ipi6_addr = link->addr.six.sin6_addr;
+
+	return sendmsg(sock->__fd, &msg, flags);
 }
 
 
@@ -278,13 +464,12 @@ __ni_dhcp6_hexdump(ni_stringbuf_t *sbuf, const ni_buffer_t *packet)
 	return ni_format_hex(ni_buffer_head(packet), plen, sbuf->string, sbuf->size);
 }
 
-static void
-ni_dhcp6_socket_recv(ni_socket_t *sock)
+/*
+ * Receive a packet into the socket buffer and return its packet info
+ */
+static ssize_t
+__ni_dhcp6_socket_recv(ni_socket_t *sock, const char *ifname, struct in6_pktinfo *info)
 {
-#ifdef	NI_DHCP6_HEXDUMP_LEVEL
-	ni_stringbuf_t hexbuf = NI_STRINGBUF_INIT_DYNAMIC;
-#endif
-	ni_dhcp6_device_t * dev = sock->user_data;
 	ni_buffer_t * rbuf = &sock->rbuf;
 	unsigned char cbuf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
 	ni_sockaddr_t saddr;
@@ -312,14 +497,14 @@ ni_dhcp6_socket_recv(ni_socket_t *sock)
 	if(bytes < 0) {
 		if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
 			ni_error("%s: recvmsg error on socket %d: %m",
-				dev->ifname, sock->__fd);
+				ifname, sock->__fd);
 			ni_socket_deactivate(sock);
 		}
-		return;
+		return -1;
 	} else if (bytes == 0) {
 		ni_error("%s: recvmsg didn't returned any data on socket %d",
-			dev->ifname, sock->__fd);
-		return;
+			ifname, sock->__fd);
+		return -1;
 	}
 
 	for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
@@ -332,26 +517,94 @@ ni_dhcp6_socket_recv(ni_socket_t *sock)
 
 	if (pinfo == NULL) {
 		ni_error("%s: discarding packet without packet info on socket %d",
-			dev->ifname, sock->__fd);
-		return;
-	}
-	if(dev->link.ifindex != pinfo->ipi6_ifindex) {
-		ni_error("%s: discarding packet with interface index %u instead %u",
-			dev->ifname, pinfo->ipi6_ifindex, dev->link.ifindex);
-		return;
+			ifname, sock->__fd);
+		return -1;
 	}
 
+	*info = *pinfo;
 	ni_buffer_push_tail(rbuf, bytes);
+	return bytes;
+}
+
+static void
+__ni_dhcp6_socket_recv_packet(ni_dhcp6_device_t *dev, ni_buffer_t *rbuf,
+				const struct in6_pktinfo *pinfo)
+{
 #ifdef	NI_DHCP6_HEXDUMP_LEVEL
+	ni_stringbuf_t hexbuf = NI_STRINGBUF_INIT_DYNAMIC;
+
 	ni_debug_verbose(NI_DHCP6_HEXDUMP_LEVEL, NI_TRACE_SOCKET,
-			"%s: received %zd byte packet from %s: %s",
-			dev->ifname, bytes,
+			"%s: received %u byte packet from %s: %s",
+			dev->ifname, ni_buffer_count(rbuf),
 			ni_dhcp6_address_print(&pinfo->ipi6_addr),
 			__ni_dhcp6_hexdump(&hexbuf, rbuf));
 	ni_stringbuf_destroy(&hexbuf);
 #endif
 
 	ni_dhcp6_process_packet(dev, rbuf, &pinfo->ipi6_addr);
+}
+
+static void
+ni_dhcp6_socket_recv(ni_socket_t *sock)
+{
+	ni_dhcp6_device_t * dev = sock->user_data;
+	ni_buffer_t * rbuf = &sock->rbuf;
+	struct in6_pktinfo pinfo;
+
+	if (__ni_dhcp6_socket_recv(sock, dev->ifname, &pinfo) <= 0)
+		return;
+
+	if(dev->link.ifindex != pinfo.ipi6_ifindex) {
+		ni_error("%s: discarding packet with interface index %u instead %u",
+			dev->ifname, pinfo.ipi6_ifindex, dev->link.ifindex);
+	} else {
+		__ni_dhcp6_socket_recv_packet(dev, rbuf, &pinfo);
+	}
+	ni_buffer_reset(rbuf);
+}
+
+/*
+ * Dispatch a packet received on the shared socket to the device of
+ * the transaction id in the message header, which has to match the
+ * interface index, or of the interface index the packet arrived on.
+ */
+static ni_dhcp6_device_t *
+ni_dhcp6_shared_socket_dispatch(ni_socket_t *sock, ni_buffer_t *rbuf,
+				const struct in6_pktinfo *pinfo)
+{
+	const ni_dhcp6_client_header_t *header;
+	ni_dhcp6_device_t *dev;
+
+	if ((header = ni_buffer_peek_head(rbuf, sizeof(*header)))) {
+		dev = ni_dhcp6_device_by_xid(ni_dhcp6_message_xid(header->xid));
+		if (dev && dev->link.ifindex == pinfo->ipi6_ifindex &&
+		    dev->mcast.sock == sock)
+			return dev;
+	}
+
+	dev = ni_dhcp6_device_by_index(pinfo->ipi6_ifindex);
+	if (dev && dev->mcast.sock == sock)
+		return dev;
+
+	return NULL;
+}
+
+static void
+ni_dhcp6_shared_socket_recv(ni_socket_t *sock)
+{
+	ni_buffer_t * rbuf = &sock->rbuf;
+	struct in6_pktinfo pinfo;
+	ni_dhcp6_device_t *dev;
+
+	if (__ni_dhcp6_socket_recv(sock, "shared", &pinfo) <= 0)
+		return;
+
+	if (!(dev = ni_dhcp6_shared_socket_dispatch(sock, rbuf, &pinfo))) {
+		ni_debug_dhcp("discarding packet on shared socket for interface index %u"
+				" without an attached device", pinfo.ipi6_ifindex);
+	} else {
+		__ni_dhcp6_socket_recv_packet(dev, rbuf, &pinfo);
+	}
 	ni_buffer_reset(rbuf);
 }
 
@@ -487,6 +740,45 @@ ni_dhcp6_socket_check_timeout(ni_socket_t *sock, const struct timeval *now)
 	}
 }
 
+/*
+ * The shared socket provides the retransmission timeouts of all
+ * attached devices.
+ */
+static int
+ni_dhcp6_shared_socket_get_timeout(const ni_socket_t *sock, struct timeval *tv)
+{
+	ni_dhcp6_device_t *dev;
+
+	timerclear(tv);
+	for (dev = ni_dhcp6_active; dev; dev = dev->next) {
+		if (dev->mcast.sock != sock || !timerisset(&dev->retrans.deadline))
+			continue;
+
+		if (!timerisset(tv) || timercmp(&dev->retrans.deadline, tv, <))
+			*tv = dev->retrans.deadline;
+	}
+	return timerisset(tv) ? 0 : -1;
+}
+
+static void
+ni_dhcp6_shared_socket_check_timeout(ni_socket_t *sock, const struct timeval *now)
+{
+	ni_dhcp6_device_t *dev, *next;
+
+	/* a retransmission may detach the last device and close it */
+	ni_socket_hold(sock);
+	for (dev = ni_dhcp6_active; dev; dev = next) {
+		next = dev->next;
+
+		if (dev->mcast.sock != sock || !timerisset(&dev->retrans.deadline))
+			continue;
+
+		if (timercmp(&dev->retrans.deadline, now, <))
+			ni_dhcp6_device_retransmit(dev);
+	}
+	ni_socket_release(sock);
+}
+
 /*
  * Inline functions for setting/retrieving options from a buffer
  */
@@ -1880,13 +2172,15 @@ ni_dhcp6_can_send_unicast(ni_dhcp6_device_t *dev, unsigned int msg_code, const n
 int
 ni_dhcp6_init_message(ni_dhcp6_device_t *dev, unsigned int msg_code, const ni_addrconf_lease_t *lease)
 {
+	unsigned int xid;
 	int rv;
 
-	/* Assign a new XID to this message */
+	/* Assign a new XID to this message, unique among the devices */
 	ni_timer_get_time(&dev->retrans.start);
 	do {
-		dev->dhcp6.xid = random() & NI_DHCP6_XID_MASK;
-	} while (dev->dhcp6.xid == 0);
+		xid = random() & NI_DHCP6_XID_MASK;
+	} while (!xid || ni_dhcp6_device_by_xid(xid));
+	ni_dhcp6_device_set_xid(dev, xid);
 
 	ni_debug_dhcp("%s: building %s with xid 0x%x", dev->ifname,
 		ni_dhcp6_message_name(msg_code), dev->dhcp6.xid);
@@ -27,6 +27,13 @@
 
 #include <net/if_arp.h>
 #include <linux/ethtool.h>
+#if defined(HAVE_ETHTOOL_MSG_PAUSE_GET) && defined(HAVE_LINUX_ETHTOOL_NETLINK_H)
+#include <linux/genetlink.h>
+#include <linux/ethtool_netlink.h>
+#endif
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <stddef.h>
 #include <errno.h>
 
 #include <wicked/util.h>
@@ -2290,14 +2297,109 @@ ni_ethtool_get_feature_values(const ni_netdev_ref_t *ref, unsigned int count)
 	return gfeatures;
 }
 
+static ni_ethtool_feature_value_t
+ni_ethtool_feature_block_value(const struct ethtool_get_features_block *block, unsigned int bit)
+{
+	ni_ethtool_feature_value_t value = NI_ETHTOOL_FEATURE_OFF;
+
+	if (!(block->available & bit) || (block->never_changed & bit)) {
+		value |= NI_ETHTOOL_FEATURE_FIXED;
+		if (block->active & bit)
+			value |= NI_ETHTOOL_FEATURE_ON;
+	} else if ((block->requested & bit) ^ (block->active & bit)) {
+		value |= NI_ETHTOOL_FEATURE_REQUESTED;
+		if (block->requested & bit)
+			value |= NI_ETHTOOL_FEATURE_ON;
+	} else {
+		if (block->active & bit)
+			value |= NI_ETHTOOL_FEATURE_ON;
+	}
+	return value;
+}
+
+static inline void
+ni_ethtool_feature_value_debug(const ni_netdev_ref_t *ref, const ni_ethtool_feature_t *feature)
+{
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+			"%s: get ethtool feature[%u] %s: %s%s",
+			ref->name, feature->index, feature->map.name,
+			feature->value & NI_ETHTOOL_FEATURE_ON ? "on" : "off",
+			feature->value & NI_ETHTOOL_FEATURE_FIXED ? " fixed" :
+			feature->value & NI_ETHTOOL_FEATURE_REQUESTED ? " requested" : "");
+}
+
+static void
+ni_ethtool_features_init_values(const ni_netdev_ref_t *ref, ni_ethtool_features_t *features,
+		const struct ethtool_gfeatures *gfeatures, const struct ethtool_gstrings *gstrings,
+		ni_bool_t unavailable)
+{
+	ni_ethtool_feature_t *feature;
+	unsigned int i, count;
+
+	count = gfeatures->size * 32U;
+	if (count > gstrings->len)
+		count = gstrings->len;
+
+	for (i = 0; i < count; ++i) {
+		const struct ethtool_get_features_block *block;
+		const char *name;
+		unsigned int bit;
+
+		name = (const char *)(gstrings->data + i * ETH_GSTRING_LEN);
+		block = &gfeatures->features[i/32U];
+		bit = NI_BIT(i % 32U);
+
+		/* don't store unavailable features except requested */
+		if (!((block->available & bit) || unavailable))
+			continue;
+
+		if (!(feature = ni_ethtool_feature_new(name, i)))
+			continue;
+
+		feature->value = ni_ethtool_feature_block_value(block, bit);
+		ni_ethtool_feature_value_debug(ref, feature);
+
+		if (!ni_ethtool_features_add(features, feature)) {
+			ni_warn("%s: unable to store feature %s: %m", ref->name, feature->map.name);
+			ni_ethtool_feature_free(feature);
+		}
+	}
+}
+
+static void
+ni_ethtool_features_update_values(const ni_netdev_ref_t *ref, ni_ethtool_features_t *features,
+		const struct ethtool_gfeatures *gfeatures)
+{
+	ni_ethtool_feature_t *feature;
+	unsigned int i, count;
+
+	count = gfeatures->size * 32U;
+	for (i = 0; i < features->count; ++i) {
+		const struct ethtool_get_features_block *block;
+		unsigned int bit;
+
+		feature = features->data[i];
+		if (!feature || feature->index == -1U || feature->index >= count) {
+			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+				"%s: get ethtool feature[%u] %s: invalid index",
+				ref->name, i, feature ? feature->map.name : NULL);
+			continue;
+		}
+
+		block = &gfeatures->features[feature->index/32U];
+		bit = NI_BIT(feature->index % 32U);
+
+		feature->value = ni_ethtool_feature_block_value(block, bit);
+		ni_ethtool_feature_value_debug(ref, feature);
+	}
+}
+
 static int
 ni_ethtool_get_features_init(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, ni_bool_t unavailable)
 {
 	struct ethtool_gfeatures *gfeatures;
 	struct ethtool_gstrings *gstrings;
 	ni_ethtool_features_t *features;
-	ni_ethtool_feature_t *feature;
-	unsigned int i, count;
 
 	if (!ethtool->features && !(ethtool->features = ni_ethtool_features_new()))
 		return -ENOMEM;
@@ -2327,51 +2429,7 @@ ni_ethtool_get_features_init(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool,
 		return errno;
 	}
 
-	count = gfeatures->size * 32U;
-	if (count > gstrings->len)
-		count = gstrings->len;
-
-	for (i = 0; i < count; ++i) {
-		struct ethtool_get_features_block *block;
-		const char *name;
-		unsigned int bit;
-
-		name = (const char *)(gstrings->data + i * ETH_GSTRING_LEN);
-		block = &gfeatures->features[i/32U];
-		bit = NI_BIT(i % 32U);
-
-		/* don't store unavailable features except requested */
-		if (!((block->available & bit) || unavailable))
-			continue;
-
-		if (!(feature = ni_ethtool_feature_new(name, i)))
-			continue;
-
-		feature->value = NI_ETHTOOL_FEATURE_OFF;
-		if (!(block->available & bit) || (block->never_changed & bit)) {
-			feature->value |= NI_ETHTOOL_FEATURE_FIXED;
-			if (block->active & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		} else if ((block->requested & bit) ^ (block->active & bit)) {
-			feature->value |= NI_ETHTOOL_FEATURE_REQUESTED;
-			if (block->requested & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		} else {
-			if (block->active & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		}
-		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
-				"%s: get ethtool feature[%u] %s: %s%s",
-				ref->name, feature->index, feature->map.name,
-				feature->value & NI_ETHTOOL_FEATURE_ON ? "on" : "off",
-				feature->value & NI_ETHTOOL_FEATURE_FIXED ? " fixed" :
-				feature->value & NI_ETHTOOL_FEATURE_REQUESTED ? " requested" : "");
-
-		if (!ni_ethtool_features_add(features, feature)) {
-			ni_warn("%s: unable to store feature %s: %m", ref->name, feature->map.name);
-			ni_ethtool_feature_free(feature);
-		}
-	}
+	ni_ethtool_features_init_values(ref, features, gfeatures, gstrings, unavailable);
 
 	free(gstrings);
 	free(gfeatures);
@@ -2383,8 +2441,6 @@ ni_ethtool_get_features_update(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool
 {
 	struct ethtool_gfeatures *gfeatures;
 	ni_ethtool_features_t *features;
-	ni_ethtool_feature_t *feature;
-	unsigned int i, count;
 
 	if (!ethtool || !(features = ethtool->features) || !features->total)
 		return -EINVAL;
@@ -2397,42 +2453,7 @@ ni_ethtool_get_features_update(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool
 		return errno;
 	}
 
-	count = gfeatures->size * 32U;
-	for (i = 0; i < features->count; ++i) {
-		struct ethtool_get_features_block *block;
-		unsigned int bit;
-
-		feature = features->data[i];
-		if (!feature || feature->index == -1U || feature->index >= count) {
-			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
-				"%s: get ethtool feature[%u] %s: invalid index",
-				ref->name, i, feature ? feature->map.name : NULL);
-			continue;
-		}
-
-		block = &gfeatures->features[feature->index/32U];
-		bit = NI_BIT(feature->index % 32U);
-
-		feature->value = NI_ETHTOOL_FEATURE_OFF;
-		if (!(block->available & bit) || (block->never_changed & bit)) {
-			feature->value |= NI_ETHTOOL_FEATURE_FIXED;
-			if (block->active & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		} else if ((block->requested & bit) ^ (block->active & bit)) {
-			feature->value |= NI_ETHTOOL_FEATURE_REQUESTED;
-			if (block->requested & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		} else {
-			if (block->active & bit)
-				feature->value |= NI_ETHTOOL_FEATURE_ON;
-		}
-		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
-				"%s: get ethtool feature[%u] %s: %s%s",
-				ref->name, feature->index, feature->map.name,
-				feature->value & NI_ETHTOOL_FEATURE_ON ? "on" : "off",
-				feature->value & NI_ETHTOOL_FEATURE_FIXED ? " fixed" :
-				feature->value & NI_ETHTOOL_FEATURE_REQUESTED ? " requested" : "");
-	}
+	ni_ethtool_features_update_values(ref, features, gfeatures);
 
 	free(gfeatures);
 	return 0;
@@ -3606,6 +3627,950 @@ ni_ethtool_set_pause(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, const ni
 }
 
 
+/*
+ * ethtool generic netlink (ETHTOOL_GENL) query backend.
+ *
+ * A full refresh dumps every command for all devices at once, see
+ * ni_system_ethtool_refresh_begin(); a refresh of a single device
+ * uses a get request instead. Commands the kernel does not provide
+ * and devices without a netlink reply fall back to the ioctls.
+ */
+enum {
+	NI_ETHTOOL_NL_LINKMODES,
+	NI_ETHTOOL_NL_LINKINFO,
+	NI_ETHTOOL_NL_FEATURES,
+	NI_ETHTOOL_NL_RINGS,
+	NI_ETHTOOL_NL_CHANNELS,
+	NI_ETHTOOL_NL_COALESCE,
+	NI_ETHTOOL_NL_PAUSE,
+
+	NI_ETHTOOL_NL_CMD_MAX
+};
+
+#if defined(HAVE_ETHTOOL_MSG_PAUSE_GET) && defined(HAVE_LINUX_ETHTOOL_NETLINK_H)
+/* ETHTOOL_A_*_HEADER is the first attribute of all messages */
+#define NI_ETHTOOL_NL_A_HEADER		1
+
+typedef struct ni_ethtool_nl_cmd {
+	const char *		name;
+	uint8_t			get;
+	uint8_t			reply;
+	uint32_t		flags;
+	unsigned int		supp;
+	int			(*parse)(const ni_netdev_ref_t *, ni_ethtool_t *,
+						struct nlmsghdr *);
+} ni_ethtool_nl_cmd_t;
+
+typedef struct ni_ethtool_nl_reply {
+	unsigned int		ifindex;
+	struct nlmsghdr *	h;
+} ni_ethtool_nl_reply_t;
+
+typedef struct ni_ethtool_nl_dump {
+	struct ni_nlmsg_list	list;
+	unsigned int		count;
+	ni_ethtool_nl_reply_t *	data;
+} ni_ethtool_nl_dump_t;
+
+static struct {
+	ni_netlink_t *		nl;
+	int			family;		/* 0: unresolved, <0: unavailable */
+	unsigned int		ops;		/* NI_BIT(cmd) provided by kernel */
+	ni_bool_t		dumping;
+	ni_ethtool_nl_dump_t	dump[NI_ETHTOOL_NL_CMD_MAX];
+} ni_ethtool_nl;
+
+static /* const */ struct nla_policy	ni_ethtool_nl_header_policy[ETHTOOL_A_HEADER_MAX + 1] = {
+	[ETHTOOL_A_HEADER_DEV_INDEX]		= { .type = NLA_U32 },
+	[ETHTOOL_A_HEADER_DEV_NAME]		= { .type = NLA_STRING },
+	[ETHTOOL_A_HEADER_FLAGS]		= { .type = NLA_U32 },
+};
+
+static /* const */ struct nla_policy	ni_ethtool_nl_bitset_policy[ETHTOOL_A_BITSET_MAX + 1] = {
+	[ETHTOOL_A_BITSET_NOMASK]		= { .type = NLA_FLAG },
+	[ETHTOOL_A_BITSET_SIZE]			= { .type = NLA_U32 },
+	[ETHTOOL_A_BITSET_BITS]			= { .type = NLA_NESTED },
+};
+
+static /* const */ struct nla_policy	ni_ethtool_nl_bitset_bit_policy[ETHTOOL_A_BITSET_BIT_MAX + 1] = {
+	[ETHTOOL_A_BITSET_BIT_INDEX]		= { .type = NLA_U32 },
+	[ETHTOOL_A_BITSET_BIT_NAME]		= { .type = NLA_STRING },
+	[ETHTOOL_A_BITSET_BIT_VALUE]		= { .type = NLA_FLAG },
+};
+
+static inline unsigned int
+ni_ethtool_nl_get_u32(struct nlattr *nla)
+{
+	/* kernel omits unsupported params the ioctl reports as 0 */
+	return nla ? nla_get_u32(nla) : 0;
+}
+
+static inline unsigned int
+ni_ethtool_nl_get_u8(struct nlattr *nla)
+{
+	return nla ? nla_get_u8(nla) : 0;
+}
+
+static int
+ni_ethtool_nl_parse_header(struct nlmsghdr *h, unsigned int *ifindex, const char **ifname)
+{
+	struct nlattr *tb[ETHTOOL_A_HEADER_MAX + 1];
+	struct nlattr *nla;
+
+	if (!h || !nlmsg_valid_hdr(h, GENL_HDRLEN))
+		return -EINVAL;
+
+	if (!(nla = nlmsg_find_attr(h, GENL_HDRLEN, NI_ETHTOOL_NL_A_HEADER)))
+		return -EINVAL;
+
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, ETHTOOL_A_HEADER_MAX, nla, ni_ethtool_nl_header_policy) < 0)
+		return -EINVAL;
+
+	if (!tb[ETHTOOL_A_HEADER_DEV_INDEX])
+		return -EINVAL;
+
+	if (ifindex)
+		*ifindex = nla_get_u32(tb[ETHTOOL_A_HEADER_DEV_INDEX]);
+	if (ifname)
+		*ifname = tb[ETHTOOL_A_HEADER_DEV_NAME] ?
+			nla_get_string(tb[ETHTOOL_A_HEADER_DEV_NAME]) : NULL;
+	return 0;
+}
+
+/*
+ * bitset utilities
+ */
+static unsigned int
+ni_ethtool_nl_get_bitset_size(struct nlattr *bitset)
+{
+	struct nlattr *tb[ETHTOOL_A_BITSET_MAX + 1];
+
+	memset(tb, 0, sizeof(tb));
+	if (!bitset || nla_parse_nested(tb, ETHTOOL_A_BITSET_MAX, bitset,
+					ni_ethtool_nl_bitset_policy) < 0)
+		return 0;
+
+	return ni_ethtool_nl_get_u32(tb[ETHTOOL_A_BITSET_SIZE]);
+}
+
+static int
+ni_ethtool_nl_get_bitset_words(struct nlattr *bitset, unsigned int attr,
+				ni_bitfield_t *bitfield, int8_t *nwords)
+{
+	struct nlattr *tb[ETHTOOL_A_BITSET_MAX + 1];
+	unsigned int words;
+
+	if (!bitset)
+		return 0;
+
+	/* compact format: array of u32 words in value and mask */
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, ETHTOOL_A_BITSET_MAX, bitset, ni_ethtool_nl_bitset_policy) < 0)
+		return -EINVAL;
+
+	words = (ni_ethtool_nl_get_u32(tb[ETHTOOL_A_BITSET_SIZE]) + 31U) / 32U;
+	if (!words || words > SCHAR_MAX)
+		return -EINVAL;
+
+	if (nwords)
+		*nwords = words;
+
+	if (!tb[attr])
+		return 0;
+
+	if ((size_t)nla_len(tb[attr]) < words * sizeof(uint32_t))
+		return -EINVAL;
+
+	if (ni_ethtool_get_link_settings_adv_isset(words, nla_data(tb[attr])))
+		ni_bitfield_set_data(bitfield, nla_data(tb[attr]), words * sizeof(uint32_t));
+	return 0;
+}
+
+static int
+ni_ethtool_nl_get_feature_bits(struct nlattr *bitset, struct ethtool_gfeatures *gfeatures,
+				size_t field, struct ethtool_gstrings *gstrings)
+{
+	struct nlattr *tb[ETHTOOL_A_BITSET_MAX + 1];
+	struct nlattr *bit;
+	ni_bool_t list;
+	int rem;
+
+	if (!bitset)
+		return 0;
+
+	/* verbose format: nested bits with index, name and value flag */
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, ETHTOOL_A_BITSET_MAX, bitset, ni_ethtool_nl_bitset_policy) < 0)
+		return -EINVAL;
+
+	if (!tb[ETHTOOL_A_BITSET_BITS])
+		return 0;
+
+	/* a list (bitset without mask) contains the set bits only */
+	list = !!tb[ETHTOOL_A_BITSET_NOMASK];
+	nla_for_each_nested(bit, tb[ETHTOOL_A_BITSET_BITS], rem) {
+		struct nlattr *btb[ETHTOOL_A_BITSET_BIT_MAX + 1];
+		unsigned int index;
+		uint32_t *word;
+
+		if (nla_type(bit) != ETHTOOL_A_BITSET_BITS_BIT)
+			continue;
+
+		memset(btb, 0, sizeof(btb));
+		if (nla_parse_nested(btb, ETHTOOL_A_BITSET_BIT_MAX, bit,
+					ni_ethtool_nl_bitset_bit_policy) < 0)
+			return -EINVAL;
+
+		if (!btb[ETHTOOL_A_BITSET_BIT_INDEX])
+			continue;
+
+		index = nla_get_u32(btb[ETHTOOL_A_BITSET_BIT_INDEX]);
+		if (index >= gfeatures->size * 32U)
+			continue;
+
+		if (gstrings && index < gstrings->len && btb[ETHTOOL_A_BITSET_BIT_NAME]) {
+			snprintf((char *)(gstrings->data + index * ETH_GSTRING_LEN),
+					ETH_GSTRING_LEN, "%s",
+					nla_get_string(btb[ETHTOOL_A_BITSET_BIT_NAME]));
+		}
+
+		if (!list && !btb[ETHTOOL_A_BITSET_BIT_VALUE])
+			continue;
+
+		word = (uint32_t *)((char *)&gfeatures->features[index / 32U] + field);
+		*word |= NI_BIT(index % 32U);
+	}
+	return 0;
+}
+
+/*
+ * reply parsers
+ */
+static /* const */ struct nla_policy	ni_ethtool_nl_linkmodes_policy[ETHTOOL_A_LINKMODES_MAX + 1] = {
+	[ETHTOOL_A_LINKMODES_AUTONEG]		= { .type = NLA_U8 },
+	[ETHTOOL_A_LINKMODES_OURS]		= { .type = NLA_NESTED },
+	[ETHTOOL_A_LINKMODES_PEER]		= { .type = NLA_NESTED },
+	[ETHTOOL_A_LINKMODES_SPEED]		= { .type = NLA_U32 },
+	[ETHTOOL_A_LINKMODES_DUPLEX]		= { .type = NLA_U8 },
+};
+
+static int
+ni_ethtool_nl_parse_linkmodes(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_LINKMODES_MAX + 1];
+	ni_ethtool_link_settings_t *link;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_LINKMODES_MAX,
+				ni_ethtool_nl_linkmodes_policy) < 0)
+		return -EINVAL;
+
+	if (!tb[ETHTOOL_A_LINKMODES_OURS])
+		return -EINVAL;
+
+	if (!(link = ni_ethtool_link_settings_new()))
+		return -ENOMEM;
+
+	link->autoneg = ni_ethtool_nl_get_u8(tb[ETHTOOL_A_LINKMODES_AUTONEG]) == AUTONEG_ENABLE;
+	if (tb[ETHTOOL_A_LINKMODES_SPEED])
+		link->speed = nla_get_u32(tb[ETHTOOL_A_LINKMODES_SPEED]);
+	if (tb[ETHTOOL_A_LINKMODES_DUPLEX])
+		link->duplex = nla_get_u8(tb[ETHTOOL_A_LINKMODES_DUPLEX]);
+
+	if (ni_ethtool_nl_get_bitset_words(tb[ETHTOOL_A_LINKMODES_OURS],
+				ETHTOOL_A_BITSET_MASK, &link->supported, &link->nwords) < 0 ||
+	    ni_ethtool_nl_get_bitset_words(tb[ETHTOOL_A_LINKMODES_OURS],
+				ETHTOOL_A_BITSET_VALUE, &link->advertising, NULL) < 0 ||
+	    ni_ethtool_nl_get_bitset_words(tb[ETHTOOL_A_LINKMODES_PEER],
+				ETHTOOL_A_BITSET_VALUE, &link->lp_advertising, NULL) < 0) {
+		ni_warn("%s: unable to parse ethtool netlink link modes", ref->name);
+		ni_ethtool_link_settings_free(link);
+		return -EINVAL;
+	}
+
+	ni_ethtool_link_settings_free(ethtool->link_settings);
+	ethtool->link_settings = link;
+	return 0;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_linkinfo_policy[ETHTOOL_A_LINKINFO_MAX + 1] = {
+	[ETHTOOL_A_LINKINFO_PORT]		= { .type = NLA_U8 },
+	[ETHTOOL_A_LINKINFO_PHYADDR]		= { .type = NLA_U8 },
+	[ETHTOOL_A_LINKINFO_TP_MDIX]		= { .type = NLA_U8 },
+	[ETHTOOL_A_LINKINFO_TP_MDIX_CTRL]	= { .type = NLA_U8 },
+	[ETHTOOL_A_LINKINFO_TRANSCEIVER]	= { .type = NLA_U8 },
+};
+
+static int
+ni_ethtool_nl_parse_linkinfo(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_LINKINFO_MAX + 1];
+	ni_ethtool_link_settings_t *link;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_LINKINFO_MAX,
+				ni_ethtool_nl_linkinfo_policy) < 0)
+		return -EINVAL;
+
+	/* complements the link settings created from the link modes */
+	if (!(link = ethtool->link_settings)) {
+		if (!(link = ni_ethtool_link_settings_new()))
+			return -ENOMEM;
+		ethtool->link_settings = link;
+	}
+
+	if (tb[ETHTOOL_A_LINKINFO_PORT])
+		link->port = nla_get_u8(tb[ETHTOOL_A_LINKINFO_PORT]);
+	if (tb[ETHTOOL_A_LINKINFO_TRANSCEIVER])
+		link->transceiver = nla_get_u8(tb[ETHTOOL_A_LINKINFO_TRANSCEIVER]);
+	if (tb[ETHTOOL_A_LINKINFO_PHYADDR])
+		link->phy_address = nla_get_u8(tb[ETHTOOL_A_LINKINFO_PHYADDR]);
+
+	if (link->port == NI_ETHTOOL_PORT_TP) {
+		ni_ethtool_get_link_settings_map_mdix(link,
+				ni_ethtool_nl_get_u8(tb[ETHTOOL_A_LINKINFO_TP_MDIX_CTRL]),
+				ni_ethtool_nl_get_u8(tb[ETHTOOL_A_LINKINFO_TP_MDIX]));
+	}
+	return 0;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_features_policy[ETHTOOL_A_FEATURES_MAX + 1] = {
+	[ETHTOOL_A_FEATURES_HW]			= { .type = NLA_NESTED },
+	[ETHTOOL_A_FEATURES_WANTED]		= { .type = NLA_NESTED },
+	[ETHTOOL_A_FEATURES_ACTIVE]		= { .type = NLA_NESTED },
+	[ETHTOOL_A_FEATURES_NOCHANGE]		= { .type = NLA_NESTED },
+};
+
+static int
+ni_ethtool_nl_parse_features(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_FEATURES_MAX + 1];
+	struct ethtool_gfeatures *gfeatures = NULL;
+	struct ethtool_gstrings *gstrings = NULL;
+	ni_ethtool_features_t *features;
+	unsigned int count, blocks;
+	int ret = -EINVAL;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_FEATURES_MAX,
+				ni_ethtool_nl_features_policy) < 0)
+		return -EINVAL;
+
+	/* the hw bitset has a mask with all (named) features */
+	if (!(count = ni_ethtool_nl_get_bitset_size(tb[ETHTOOL_A_FEATURES_HW])))
+		return -EINVAL;
+
+	if (!ethtool->features && !(ethtool->features = ni_ethtool_features_new()))
+		return -ENOMEM;
+	features = ethtool->features;
+
+	/*
+	 * convert to the ioctl structures and use the same functions
+	 * to init resp. update the features; names are needed at init.
+	 */
+	blocks = ni_ethtool_get_feature_blocks(count);
+	gfeatures = calloc(1, sizeof(*gfeatures) + blocks * sizeof(gfeatures->features[0]));
+	if (!features->total)
+		gstrings = calloc(1, sizeof(*gstrings) + count * ETH_GSTRING_LEN);
+	if (!gfeatures || (!features->total && !gstrings)) {
+		ni_warn("%s: unable to allocate %u ethtool feature values", ref->name, count);
+		ret = -ENOMEM;
+		goto cleanup;
+	}
+	gfeatures->size = blocks;
+	if (gstrings)
+		gstrings->len = count;
+
+	if (ni_ethtool_nl_get_feature_bits(tb[ETHTOOL_A_FEATURES_HW], gfeatures,
+			offsetof(struct ethtool_get_features_block, available), gstrings) < 0 ||
+	    ni_ethtool_nl_get_feature_bits(tb[ETHTOOL_A_FEATURES_WANTED], gfeatures,
+			offsetof(struct ethtool_get_features_block, requested), NULL) < 0 ||
+	    ni_ethtool_nl_get_feature_bits(tb[ETHTOOL_A_FEATURES_ACTIVE], gfeatures,
+			offsetof(struct ethtool_get_features_block, active), NULL) < 0 ||
+	    ni_ethtool_nl_get_feature_bits(tb[ETHTOOL_A_FEATURES_NOCHANGE], gfeatures,
+			offsetof(struct ethtool_get_features_block, never_changed), NULL) < 0) {
+		ni_warn("%s: unable to parse ethtool netlink features", ref->name);
+		goto cleanup;
+	}
+
+	if (features->total) {
+		ni_ethtool_features_update_values(ref, features, gfeatures);
+	} else {
+		features->total = count;
+		ni_ethtool_features_init_values(ref, features, gfeatures, gstrings, FALSE);
+	}
+	ret = 0;
+
+cleanup:
+	free(gstrings);
+	free(gfeatures);
+	return ret;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_rings_policy[ETHTOOL_A_RINGS_MAX + 1] = {
+	[ETHTOOL_A_RINGS_RX]			= { .type = NLA_U32 },
+	[ETHTOOL_A_RINGS_RX_MINI]		= { .type = NLA_U32 },
+	[ETHTOOL_A_RINGS_RX_JUMBO]		= { .type = NLA_U32 },
+	[ETHTOOL_A_RINGS_TX]			= { .type = NLA_U32 },
+};
+
+static int
+ni_ethtool_nl_parse_rings(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_RINGS_MAX + 1];
+	ni_ethtool_ring_t *ring;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_RINGS_MAX,
+				ni_ethtool_nl_rings_policy) < 0)
+		return -EINVAL;
+
+	if (!(ring = ni_ethtool_ring_new()))
+		return -ENOMEM;
+
+	ring->tx        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_RINGS_TX]);
+	ring->rx        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_RINGS_RX]);
+	ring->rx_mini   = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_RINGS_RX_MINI]);
+	ring->rx_jumbo  = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_RINGS_RX_JUMBO]);
+
+	ni_ethtool_ring_free(ethtool->ring);
+	ethtool->ring = ring;
+	return 0;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_channels_policy[ETHTOOL_A_CHANNELS_MAX + 1] = {
+	[ETHTOOL_A_CHANNELS_RX_COUNT]		= { .type = NLA_U32 },
+	[ETHTOOL_A_CHANNELS_TX_COUNT]		= { .type = NLA_U32 },
+	[ETHTOOL_A_CHANNELS_OTHER_COUNT]	= { .type = NLA_U32 },
+	[ETHTOOL_A_CHANNELS_COMBINED_COUNT]	= { .type = NLA_U32 },
+};
+
+static int
+ni_ethtool_nl_parse_channels(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_CHANNELS_MAX + 1];
+	ni_ethtool_channels_t *channels;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_CHANNELS_MAX,
+				ni_ethtool_nl_channels_policy) < 0)
+		return -EINVAL;
+
+	if (!(channels = ni_ethtool_channels_new()))
+		return -ENOMEM;
+
+	channels->tx        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_CHANNELS_TX_COUNT]);
+	channels->rx        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_CHANNELS_RX_COUNT]);
+	channels->other     = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_CHANNELS_OTHER_COUNT]);
+	channels->combined  = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_CHANNELS_COMBINED_COUNT]);
+
+	ni_ethtool_channels_free(ethtool->channels);
+	ethtool->channels = channels;
+	return 0;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_coalesce_policy[ETHTOOL_A_COALESCE_MAX + 1] = {
+	[ETHTOOL_A_COALESCE_RX_USECS]		= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_MAX_FRAMES]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_USECS_IRQ]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_IRQ]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_USECS]		= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_MAX_FRAMES]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_USECS_IRQ]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_IRQ]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_STATS_BLOCK_USECS]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_USE_ADAPTIVE_RX]	= { .type = NLA_U8 },
+	[ETHTOOL_A_COALESCE_USE_ADAPTIVE_TX]	= { .type = NLA_U8 },
+	[ETHTOOL_A_COALESCE_PKT_RATE_LOW]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_USECS_LOW]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_LOW]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_USECS_LOW]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_LOW]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_PKT_RATE_HIGH]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_USECS_HIGH]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_HIGH]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_USECS_HIGH]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_HIGH]	= { .type = NLA_U32 },
+	[ETHTOOL_A_COALESCE_RATE_SAMPLE_INTERVAL] = { .type = NLA_U32 },
+};
+
+static int
+ni_ethtool_nl_parse_coalesce(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_COALESCE_MAX + 1];
+	ni_ethtool_coalesce_t *coalesce;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_COALESCE_MAX,
+				ni_ethtool_nl_coalesce_policy) < 0)
+		return -EINVAL;
+
+	if (!(coalesce = ni_ethtool_coalesce_new()))
+		return -ENOMEM;
+
+	ni_tristate_set(&coalesce->adaptive_tx,
+			ni_ethtool_nl_get_u8(tb[ETHTOOL_A_COALESCE_USE_ADAPTIVE_TX]));
+	ni_tristate_set(&coalesce->adaptive_rx,
+			ni_ethtool_nl_get_u8(tb[ETHTOOL_A_COALESCE_USE_ADAPTIVE_RX]));
+
+	coalesce->pkt_rate_low          = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_PKT_RATE_LOW]);
+	coalesce->pkt_rate_high         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_PKT_RATE_HIGH]);
+
+	coalesce->sample_interval       = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RATE_SAMPLE_INTERVAL]);
+	coalesce->stats_block_usecs     = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_STATS_BLOCK_USECS]);
+
+	coalesce->tx_usecs              = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_USECS]);
+	coalesce->tx_usecs_irq          = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_USECS_IRQ]);
+	coalesce->tx_usecs_low          = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_USECS_LOW]);
+	coalesce->tx_usecs_high         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_USECS_HIGH]);
+
+	coalesce->tx_frames             = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_MAX_FRAMES]);
+	coalesce->tx_frames_irq         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_IRQ]);
+	coalesce->tx_frames_low         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_LOW]);
+	coalesce->tx_frames_high        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_TX_MAX_FRAMES_HIGH]);
+
+	coalesce->rx_usecs              = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_USECS]);
+	coalesce->rx_usecs_irq          = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_USECS_IRQ]);
+	coalesce->rx_usecs_low          = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_USECS_LOW]);
+	coalesce->rx_usecs_high         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_USECS_HIGH]);
+
+	coalesce->rx_frames             = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_MAX_FRAMES]);
+	coalesce->rx_frames_irq         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_IRQ]);
+	coalesce->rx_frames_low         = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_LOW]);
+	coalesce->rx_frames_high        = ni_ethtool_nl_get_u32(tb[ETHTOOL_A_COALESCE_RX_MAX_FRAMES_HIGH]);
+
+	ni_ethtool_coalesce_free(ethtool->coalesce);
+	ethtool->coalesce = coalesce;
+	return 0;
+}
+
+static /* const */ struct nla_policy	ni_ethtool_nl_pause_policy[ETHTOOL_A_PAUSE_MAX + 1] = {
+	[ETHTOOL_A_PAUSE_AUTONEG]		= { .type = NLA_U8 },
+	[ETHTOOL_A_PAUSE_RX]			= { .type = NLA_U8 },
+	[ETHTOOL_A_PAUSE_TX]			= { .type = NLA_U8 },
+};
+
+static int
+ni_ethtool_nl_parse_pause(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	struct nlattr *tb[ETHTOOL_A_PAUSE_MAX + 1];
+	ni_ethtool_pause_t *pause;
+
+	memset(tb, 0, sizeof(tb));
+	if (nlmsg_parse(h, GENL_HDRLEN, tb, ETHTOOL_A_PAUSE_MAX,
+				ni_ethtool_nl_pause_policy) < 0)
+		return -EINVAL;
+
+	if (!(pause = ni_ethtool_pause_new()))
+		return -ENOMEM;
+
+	ni_tristate_set(&pause->tx, ni_ethtool_nl_get_u8(tb[ETHTOOL_A_PAUSE_TX]));
+	ni_tristate_set(&pause->rx, ni_ethtool_nl_get_u8(tb[ETHTOOL_A_PAUSE_RX]));
+	ni_tristate_set(&pause->autoneg, ni_ethtool_nl_get_u8(tb[ETHTOOL_A_PAUSE_AUTONEG]));
+
+	ni_ethtool_pause_free(ethtool->pause);
+	ethtool->pause = pause;
+	return 0;
+}
+
+static const ni_ethtool_nl_cmd_t	ni_ethtool_nl_cmds[NI_ETHTOOL_NL_CMD_MAX] = {
+	[NI_ETHTOOL_NL_LINKMODES] = {
+		"link modes",	ETHTOOL_MSG_LINKMODES_GET,	ETHTOOL_MSG_LINKMODES_GET_REPLY,
+		ETHTOOL_FLAG_COMPACT_BITSETS,	NI_ETHTOOL_SUPP_GET_LINK_SETTINGS,
+		ni_ethtool_nl_parse_linkmodes
+	},
+	[NI_ETHTOOL_NL_LINKINFO] = {
+		"link info",	ETHTOOL_MSG_LINKINFO_GET,	ETHTOOL_MSG_LINKINFO_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_LINK_SETTINGS,
+		ni_ethtool_nl_parse_linkinfo
+	},
+	[NI_ETHTOOL_NL_FEATURES] = {
+		"features",	ETHTOOL_MSG_FEATURES_GET,	ETHTOOL_MSG_FEATURES_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_FEATURES,
+		ni_ethtool_nl_parse_features
+	},
+	[NI_ETHTOOL_NL_RINGS] = {
+		"rings",	ETHTOOL_MSG_RINGS_GET,		ETHTOOL_MSG_RINGS_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_RING,
+		ni_ethtool_nl_parse_rings
+	},
+	[NI_ETHTOOL_NL_CHANNELS] = {
+		"channels",	ETHTOOL_MSG_CHANNELS_GET,	ETHTOOL_MSG_CHANNELS_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_CHANNELS,
+		ni_ethtool_nl_parse_channels
+	},
+	[NI_ETHTOOL_NL_COALESCE] = {
+		"coalesce",	ETHTOOL_MSG_COALESCE_GET,	ETHTOOL_MSG_COALESCE_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_COALESCE,
+		ni_ethtool_nl_parse_coalesce
+	},
+	[NI_ETHTOOL_NL_PAUSE] = {
+		"pause",	ETHTOOL_MSG_PAUSE_GET,		ETHTOOL_MSG_PAUSE_GET_REPLY,
+		0,				NI_ETHTOOL_SUPP_GET_PAUSE,
+		ni_ethtool_nl_parse_pause
+	},
+};
+
+/*
+ * family and command discovery, requests and dumps
+ */
+static /* const */ struct nla_policy	ni_ethtool_nl_ctrl_policy[CTRL_ATTR_MAX + 1] = {
+	[CTRL_ATTR_FAMILY_ID]			= { .type = NLA_U16 },
+	[CTRL_ATTR_OPS]				= { .type = NLA_NESTED },
+};
+
+static /* const */ struct nla_policy	ni_ethtool_nl_ctrl_op_policy[CTRL_ATTR_OP_MAX + 1] = {
+	[CTRL_ATTR_OP_ID]			= { .type = NLA_U32 },
+};
+
+static struct nl_msg *
+ni_ethtool_nl_msg_new(int family, uint8_t cmd, uint8_t version, int flags)
+{
+	struct genlmsghdr ghdr = {
+		.cmd		= cmd,
+		.version	= version,
+	};
+	struct nl_msg *msg;
+
+	if (!(msg = nlmsg_alloc_simple(family, flags)))
+		return NULL;
+
+	if (nlmsg_append(msg, &ghdr, sizeof(ghdr), NLMSG_ALIGNTO) < 0) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+	return msg;
+}
+
+static void
+ni_ethtool_nl_parse_ops(struct nlattr *ops)
+{
+	struct nlattr *op;
+	unsigned int cmd;
+	int rem;
+
+	nla_for_each_nested(op, ops, rem) {
+		struct nlattr *tb[CTRL_ATTR_OP_MAX + 1];
+		uint32_t id;
+
+		memset(tb, 0, sizeof(tb));
+		if (nla_parse_nested(tb, CTRL_ATTR_OP_MAX, op, ni_ethtool_nl_ctrl_op_policy) < 0 ||
+		    !tb[CTRL_ATTR_OP_ID])
+			continue;
+
+		id = nla_get_u32(tb[CTRL_ATTR_OP_ID]);
+		for (cmd = 0; cmd < NI_ETHTOOL_NL_CMD_MAX; ++cmd) {
+			if (ni_ethtool_nl_cmds[cmd].get == id)
+				ni_ethtool_nl.ops |= NI_BIT(cmd);
+		}
+	}
+}
+
+static ni_bool_t
+ni_ethtool_nl_init(void)
+{
+	struct nlattr *tb[CTRL_ATTR_MAX + 1];
+	struct ni_nlmsg_list list;
+	struct nl_msg *msg;
+	int ret;
+
+	if (ni_ethtool_nl.family)
+		return ni_ethtool_nl.family > 0;
+
+	/* don't retry on failure, use the ioctls */
+	ni_ethtool_nl.family = -1;
+	if (!(ni_ethtool_nl.nl = __ni_netlink_open(NETLINK_GENERIC)))
+		return FALSE;
+
+	/* features replies exceed a page */
+	nl_socket_enable_msg_peek(ni_ethtool_nl.nl->nl_sock);
+
+	if (!(msg = ni_ethtool_nl_msg_new(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1, 0)) ||
+	    nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, ETHTOOL_GENL_NAME) < 0) {
+		nlmsg_free(msg);
+		goto failure;
+	}
+
+	ni_nlmsg_list_init(&list);
+	ret = ni_nl_talk_store(ni_ethtool_nl.nl, msg, &list);
+	nlmsg_free(msg);
+
+	memset(tb, 0, sizeof(tb));
+	if (ret < 0 || !list.head ||
+	    nlmsg_parse(&list.head->h, GENL_HDRLEN, tb, CTRL_ATTR_MAX, ni_ethtool_nl_ctrl_policy) < 0 ||
+	    !tb[CTRL_ATTR_FAMILY_ID]) {
+		ni_nlmsg_list_destroy(&list);
+		goto failure;
+	}
+
+	ni_ethtool_nl.family = nla_get_u16(tb[CTRL_ATTR_FAMILY_ID]);
+	if (tb[CTRL_ATTR_OPS])
+		ni_ethtool_nl_parse_ops(tb[CTRL_ATTR_OPS]);
+	ni_nlmsg_list_destroy(&list);
+
+	ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_IFCONFIG,
+			"ethtool netlink family %d, supported query mask 0x%x",
+			ni_ethtool_nl.family, ni_ethtool_nl.ops);
+	return TRUE;
+
+failure:
+	ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_IFCONFIG,
+			"ethtool netlink family unavailable, using ioctl");
+	__ni_netlink_close(ni_ethtool_nl.nl);
+	ni_ethtool_nl.nl = NULL;
+	return FALSE;
+}
+
+static struct nl_msg *
+ni_ethtool_nl_request_new(const ni_ethtool_nl_cmd_t *info, unsigned int ifindex)
+{
+	struct nlattr *header;
+	struct nl_msg *msg;
+
+	/* without an ifindex, request a dump of all devices */
+	msg = ni_ethtool_nl_msg_new(ni_ethtool_nl.family, info->get,
+			ETHTOOL_GENL_VERSION, ifindex ? 0 : NLM_F_DUMP);
+	if (!msg)
+		return NULL;
+
+	if (!(header = nla_nest_start(msg, NI_ETHTOOL_NL_A_HEADER | NLA_F_NESTED)))
+		goto failure;
+	if (ifindex && nla_put_u32(msg, ETHTOOL_A_HEADER_DEV_INDEX, ifindex) < 0)
+		goto failure;
+	if (info->flags && nla_put_u32(msg, ETHTOOL_A_HEADER_FLAGS, info->flags) < 0)
+		goto failure;
+	nla_nest_end(msg, header);
+	return msg;
+
+failure:
+	nlmsg_free(msg);
+	return NULL;
+}
+
+static int
+ni_ethtool_nl_reply_cmp(const void *a, const void *b)
+{
+	const ni_ethtool_nl_reply_t *ra = a;
+	const ni_ethtool_nl_reply_t *rb = b;
+
+	return (ra->ifindex > rb->ifindex) - (ra->ifindex < rb->ifindex);
+}
+
+static void
+ni_ethtool_nl_dump_destroy(ni_ethtool_nl_dump_t *dump)
+{
+	ni_nlmsg_list_destroy(&dump->list);
+	free(dump->data);
+	dump->data = NULL;
+	dump->count = 0;
+}
+
+static int
+ni_ethtool_nl_dump(unsigned int cmd)
+{
+	const ni_ethtool_nl_cmd_t *info = &ni_ethtool_nl_cmds[cmd];
+	ni_ethtool_nl_dump_t *dump = &ni_ethtool_nl.dump[cmd];
+	struct ni_nlmsg *entry;
+	struct nl_msg *msg;
+	unsigned int count;
+	int ret;
+
+	if (!(msg = ni_ethtool_nl_request_new(info, 0)))
+		return -ENOMEM;
+
+	ni_nlmsg_list_init(&dump->list);
+	ret = ni_nl_talk_store(ni_ethtool_nl.nl, msg, &dump->list);
+	nlmsg_free(msg);
+	if (ret < 0) {
+		ni_debug_verbose(NI_LOG_DEBUG1, NI_TRACE_IFCONFIG,
+				"ethtool netlink %s dump failed: %s",
+				info->name, nl_geterror(ret));
+		if (ret == -NLE_OPNOTSUPP)
+			ni_ethtool_nl.ops &= ~NI_BIT(cmd);
+		ni_ethtool_nl_dump_destroy(dump);
+		return ret;
+	}
+
+	count = 0;
+	for (entry = dump->list.head; entry; entry = entry->next)
+		count++;
+
+	/* index the replies by ifindex for the device refresh lookups */
+	if (!(dump->data = calloc(count + 1, sizeof(dump->data[0])))) {
+		ni_ethtool_nl_dump_destroy(dump);
+		return -ENOMEM;
+	}
+
+	for (entry = dump->list.head; entry; entry = entry->next) {
+		const struct genlmsghdr *ghdr;
+		unsigned int ifindex;
+
+		if (ni_ethtool_nl_parse_header(&entry->h, &ifindex, NULL) < 0)
+			continue;
+
+		ghdr = nlmsg_data(&entry->h);
+		if (ghdr->cmd != info->reply)
+			continue;
+
+		dump->data[dump->count].ifindex = ifindex;
+		dump->data[dump->count].h = &entry->h;
+		dump->count++;
+	}
+	qsort(dump->data, dump->count, sizeof(dump->data[0]), ni_ethtool_nl_reply_cmp);
+
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+			"ethtool netlink %s dump: %u replies",
+			info->name, dump->count);
+	return 0;
+}
+
+static struct nlmsghdr *
+ni_ethtool_nl_dump_lookup(unsigned int cmd, unsigned int ifindex)
+{
+	ni_ethtool_nl_dump_t *dump = &ni_ethtool_nl.dump[cmd];
+	ni_ethtool_nl_reply_t key, *reply;
+
+	if (!dump->data)
+		return NULL;
+
+	key.ifindex = ifindex;
+	reply = bsearch(&key, dump->data, dump->count, sizeof(dump->data[0]),
+			ni_ethtool_nl_reply_cmp);
+	return reply ? reply->h : NULL;
+}
+
+static int
+ni_ethtool_nl_refresh(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, unsigned int cmd)
+{
+	const ni_ethtool_nl_cmd_t *info = &ni_ethtool_nl_cmds[cmd];
+	struct ni_nlmsg_list list;
+	struct nl_msg *msg;
+	struct nlmsghdr *h;
+	int ret;
+
+	if (!ni_ethtool_supported(ethtool, info->supp))
+		return -EOPNOTSUPP;
+
+	if (!ni_ethtool_nl_init() || !(ni_ethtool_nl.ops & NI_BIT(cmd)))
+		return -EOPNOTSUPP;
+
+	if (ni_ethtool_nl.dumping) {
+		/* not in the dump (unsupported or new device): use ioctl */
+		if (!(h = ni_ethtool_nl_dump_lookup(cmd, ref->index)))
+			return -ENOENT;
+		return info->parse(ref, ethtool, h);
+	}
+
+	if (!(msg = ni_ethtool_nl_request_new(info, ref->index)))
+		return -ENOMEM;
+
+	ni_nlmsg_list_init(&list);
+	ret = ni_nl_talk_store(ni_ethtool_nl.nl, msg, &list);
+	nlmsg_free(msg);
+	if (ret == -NLE_OPNOTSUPP) {
+		/* the kernel provides the command, the driver does not */
+		ni_ethtool_set_supported(ethtool, info->supp, FALSE);
+		ret = -EOPNOTSUPP;
+	} else if (ret < 0) {
+		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_IFCONFIG,
+				"%s[%u]: ethtool netlink get %s failed: %s",
+				ref->name, ref->index, info->name, nl_geterror(ret));
+		ret = -EIO;
+	} else if (!list.head) {
+		ret = -ENOENT;
+	} else {
+		ret = info->parse(ref, ethtool, &list.head->h);
+	}
+	ni_nlmsg_list_destroy(&list);
+	return ret;
+}
+
+void
+ni_system_ethtool_refresh_begin(void)
+{
+	unsigned int cmd;
+
+	ni_system_ethtool_refresh_end();
+	if (!ni_ethtool_nl_init())
+		return;
+
+	for (cmd = 0; cmd < NI_ETHTOOL_NL_CMD_MAX; ++cmd) {
+		if (ni_ethtool_nl.ops & NI_BIT(cmd))
+			ni_ethtool_nl_dump(cmd);
+	}
+	ni_ethtool_nl.dumping = TRUE;
+}
+
+void
+ni_system_ethtool_refresh_end(void)
+{
+	unsigned int cmd;
+
+	for (cmd = 0; cmd < NI_ETHTOOL_NL_CMD_MAX; ++cmd)
+		ni_ethtool_nl_dump_destroy(&ni_ethtool_nl.dump[cmd]);
+	ni_ethtool_nl.dumping = FALSE;
+}
+
+int
+ni_ethtool_nl_reply_ref(struct nlmsghdr *h, ni_netdev_ref_t *ref)
+{
+	const char *ifname = NULL;
+	unsigned int ifindex = 0;
+
+	if (!ref || ni_ethtool_nl_parse_header(h, &ifindex, &ifname) < 0)
+		return -EINVAL;
+
+	return ni_netdev_ref_set(ref, ifname, ifindex) ? 0 : -ENOMEM;
+}
+
+int
+ni_ethtool_nl_parse_reply(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	const struct genlmsghdr *ghdr;
+	unsigned int cmd;
+
+	if (!ref || !ethtool || !h || !nlmsg_valid_hdr(h, GENL_HDRLEN))
+		return -EINVAL;
+
+	ghdr = nlmsg_data(h);
+	for (cmd = 0; cmd < NI_ETHTOOL_NL_CMD_MAX; ++cmd) {
+		if (ni_ethtool_nl_cmds[cmd].reply == ghdr->cmd)
+			return ni_ethtool_nl_cmds[cmd].parse(ref, ethtool, h);
+	}
+	return -EOPNOTSUPP;
+}
+
+#else
+static inline int
+ni_ethtool_nl_refresh(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, unsigned int cmd)
+{
+	return -EOPNOTSUPP;
+}
+
+void
+ni_system_ethtool_refresh_begin(void)
+{
+}
+
+void
+ni_system_ethtool_refresh_end(void)
+{
+}
+
+int
+ni_ethtool_nl_reply_ref(struct nlmsghdr *h, ni_netdev_ref_t *ref)
+{
+	return -EOPNOTSUPP;
+}
+
+int
+ni_ethtool_nl_parse_reply(const ni_netdev_ref_t *ref, ni_ethtool_t *ethtool, struct nlmsghdr *h)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 /*
  * main system refresh and setup functions
  */
@@ -3624,14 +4589,21 @@ ni_ethtool_refresh(ni_netdev_t *dev)
 		ni_ethtool_get_driver_info(&ref, ethtool);
 	ni_ethtool_get_priv_flags(&ref, ethtool);
 	ni_ethtool_get_link_detected(&ref, ethtool);
-	ni_ethtool_get_link_settings(&ref, ethtool);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_LINKMODES) < 0 ||
+	    ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_LINKINFO) < 0)
+		ni_ethtool_get_link_settings(&ref, ethtool);
 	ni_ethtool_get_wake_on_lan(&ref, ethtool);
-	ni_ethtool_get_features(&ref, ethtool, FALSE);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_FEATURES) < 0)
+		ni_ethtool_get_features(&ref, ethtool, FALSE);
 	ni_ethtool_get_eee(&ref, ethtool);
-	ni_ethtool_get_ring(&ref, ethtool);
-	ni_ethtool_get_channels(&ref, ethtool);
-	ni_ethtool_get_coalesce(&ref, ethtool);
-	ni_ethtool_get_pause(&ref, ethtool);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_RINGS) < 0)
+		ni_ethtool_get_ring(&ref, ethtool);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_CHANNELS) < 0)
+		ni_ethtool_get_channels(&ref, ethtool);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_COALESCE) < 0)
+		ni_ethtool_get_coalesce(&ref, ethtool);
+	if (ni_ethtool_nl_refresh(&ref, ethtool, NI_ETHTOOL_NL_PAUSE) < 0)
+		ni_ethtool_get_pause(&ref, ethtool);
 
 	return TRUE;
 }
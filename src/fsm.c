@@ -32,6 +32,8 @@
 #include "client/ifconfig.h"
 #include "appconfig.h"
 #include "util_priv.h"
+#include "metrics.h"
+#include "memstat.h"
 
 static ni_fsm_user_prompt_fn_t *ni_fsm_user_prompt_fn;
 static void *			ni_fsm_user_prompt_data;
@@ -218,6 +220,7 @@ __ni_ifworker_new(ni_ifworker_type_t type, const char *name)
 	ni_ifworker_t *w;
 
 	w = xcalloc(1, sizeof(*w));
+	ni_memstat_alloc(NI_MEMSTAT_FSM_WORKER, w);
 	ni_string_dup(&w->name, name);
 	w->type = type;
 	w->refcount = 1;
@@ -413,6 +416,7 @@ ni_ifworker_free(ni_ifworker_t *w)
 	xml_node_free(w->state.node);
 	ni_string_free(&w->name);
 	ni_string_free(&w->old_name);
+	ni_memstat_free(NI_MEMSTAT_FSM_WORKER, w);
 	free(w);
 }
 
@@ -5101,6 +5105,7 @@ ni_fsm_schedule(ni_fsm_t *fsm)
 			ni_ifworker_t *w = fsm->workers.data[i];
 			ni_fsm_transition_t *action;
 			unsigned int prev_state;
+			struct timespec start;
 			int rv;
 
 			ni_ifworker_get(w);
@@ -5159,7 +5164,13 @@ ni_fsm_schedule(ni_fsm_t *fsm)
 			prev_state = w->fsm.state;
 			ni_fsm_events_block(fsm);
 
+			if (!action->metric)
+				action->metric = ni_metric_getf("fsm.%s",
+						action->common.method_name ?
+						action->common.method_name : "unknown");
+			ni_metric_start(&start);
 			rv = action->call_func(fsm, w, action);
+			ni_metric_stop(action->metric, &start, rv < 0);
 			if (w->fsm.next_action)
 				w->fsm.next_action++;
 
@@ -78,6 +78,7 @@
 #include "sysfs.h"
 #include "kernel.h"
 #include "appconfig.h"
+#include "metrics.h"
 #include "process.h"
 #include "debug.h"
 #include "modprobe.h"
@@ -266,7 +267,7 @@ ni_system_interface_enslave(ni_netconfig_t *nc, ni_netdev_t *master, ni_netdev_t
 			return -1;
 		}
 
-		ret = ni_ovs_vsctl_bridge_port_add(dev->name, &req->port->ovsbr, TRUE);
+		ret = ni_ovs_ctl_bridge_port_add(dev->name, &req->port->ovsbr, TRUE);
 		if (ret == 0)  {
 			ni_netdev_ref_set(&dev->link.masterdev,
 					master->name, master->link.ifindex);
@@ -330,7 +331,7 @@ ni_system_interface_link_change(ni_netdev_t *dev, const ni_netdev_req_t *ifp_req
 			if (master && master->link.type == NI_IFTYPE_OVS_SYSTEM) {
 				if (ifp_req->port && ifp_req->port->type == NI_IFTYPE_OVS_BRIDGE &&
 				    !ni_string_empty(ifp_req->port->ovsbr.bridge.name)) {
-					ni_ovs_vsctl_bridge_port_add(dev->name, &ifp_req->port->ovsbr, TRUE);
+					ni_ovs_ctl_bridge_port_add(dev->name, &ifp_req->port->ovsbr, TRUE);
 				}
 			}
 
@@ -931,6 +932,25 @@ ni_addrconf_updater_action_call(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 	return res;
 }
 
+static void
+ni_addrconf_updater_metric(const ni_addrconf_lease_t *lease, ni_event_t event,
+				const struct timeval *started, ni_bool_t failed)
+{
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	if (timercmp(&now, started, >))
+		timersub(&now, started, &delta);
+	else
+		timerclear(&delta);
+
+	ni_metric_add(ni_metric_getf("lease.%s.%s.%s",
+				ni_addrfamily_type_to_name(lease->family),
+				ni_addrconf_type_to_name(lease->type),
+				event == NI_EVENT_ADDRESS_ACQUIRED ? "apply" : "release"),
+			(uint64_t)delta.tv_sec * 1000000 + delta.tv_usec, failed);
+}
+
 int
 ni_addrconf_updater_execute(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 {
@@ -990,6 +1010,7 @@ ni_addrconf_updater_execute(ni_netdev_t *dev, ni_addrconf_lease_t *lease)
 				delta.tv_sec / 60, delta.tv_sec % 60,
 				delta.tv_usec / 1000);
 	}
+	ni_addrconf_updater_metric(lease, event, &pre, ret < 0);
 
 	if (ret == 0) {
 		if (lease->old) {
@@ -1932,7 +1953,7 @@ ni_system_ovs_bridge_create(ni_netconfig_t *nc, const ni_netdev_t *cfg, ni_netde
 		}
 	}
 
-	if (ni_ovs_vsctl_bridge_add(cfg, TRUE))
+	if (ni_ovs_ctl_bridge_add(cfg, TRUE))
 		return -1;
 
 	/* Wait for sysfs to appear */
@@ -1969,7 +1990,7 @@ ni_system_ovs_bridge_delete(ni_netconfig_t *nc, ni_netdev_t *dev)
 	if (!dev || dev->link.type != NI_IFTYPE_OVS_BRIDGE)
 		return -1;
 
-	return ni_ovs_vsctl_bridge_del(dev->name) ? -1 : 0;
+	return ni_ovs_ctl_bridge_del(dev->name) ? -1 : 0;
 }
 
 /*
@@ -5257,6 +5278,8 @@ ni_address_updater_arp_init(ni_address_updater_t *au, ni_netdev_t *dev)
 	if (ni_address_updater_arp_verify_enabled(dev)) {
 		ni_arp_verify_init(&au->verify, NI_ADDRCONF_UPDATER_ARP_NPROBES,
 						NI_ADDRCONF_UPDATER_ARP_TIMEOUT);
+		ni_arp_verify_set_concurrency(&au->verify,
+				ni_config_addrconf_arp_verify_concurrency());
 	}
 
 	if (ni_address_updater_arp_notify_enabled(dev)) {
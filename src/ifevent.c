@@ -27,6 +27,9 @@
 #include "sysfs.h"
 #include "kernel.h"
 #include "appconfig.h"
+#include "metrics.h"
+#include "teamd.h"
+#include "netshare.h"
 
 #ifndef NI_ND_OPT_RDNSS_INFORMATION
 #define NI_ND_OPT_RDNSS_INFORMATION	25	/* RFC 5006 */
@@ -132,6 +135,9 @@ __ni_netinfo_rule_event(ni_netconfig_t *nc, ni_event_t ev, const ni_rule_t *rule
 int
 __ni_rtevent_process(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struct nlmsghdr *h)
 {
+	static ni_metric_t *metrics[RTM_MAX];
+	ni_metric_t *metric = NULL;
+	struct timespec start;
 	int rv;
 #if 0
 	const char *rtnl_name;
@@ -142,6 +148,13 @@ __ni_rtevent_process(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		ni_debug_events("received rtnetlink event %u", h->nlmsg_type);
 #endif
 
+	if (h->nlmsg_type < RTM_MAX) {
+		if (!(metric = metrics[h->nlmsg_type]))
+			metric = metrics[h->nlmsg_type] = ni_metric_getf("netlink.%s",
+				ni_rtnl_msg_type_to_name(h->nlmsg_type, "unknown"));
+		ni_metric_start(&start);
+	}
+
 	switch (h->nlmsg_type) {
 	case RTM_NEWLINK:
 		rv = __ni_rtevent_newlink(nc, nladdr, h);
@@ -190,6 +203,7 @@ __ni_rtevent_process(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		rv = 0;
 	}
 
+	ni_metric_stop(metric, &start, rv < 0);
 	return rv;
 }
 
@@ -398,6 +412,8 @@ __ni_rtevent_dellink(ni_netconfig_t *nc, const struct sockaddr_nl *nladdr, struc
 		dev->deleted = 1;
 		__ni_netdev_process_events(nc, dev, old_flags);
 		ni_client_state_drop(dev->link.ifindex);
+		if (dev->link.type == NI_IFTYPE_TEAM)
+			ni_teamd_client_release(dev->name);
 		ni_netconfig_device_remove(nc, dev);
 	}
 
@@ -1161,6 +1177,12 @@ ni_server_listen_interface_events(void (*ifevent_handler)(ni_netdev_t *, ni_even
 		return -1;
 	}
 
+	/* the wickedd netconfig state stream provides the events */
+	if (ni_netshare_client_active()) {
+		ni_global.interface_event = ifevent_handler;
+		return 0;
+	}
+
 	if (!(__ni_rtevent_sock = __ni_rtevent_sock_open()))
 		return -1;
 
@@ -1199,6 +1221,11 @@ ni_server_enable_interface_addr_events(void (*ifaddr_handler)(ni_netdev_t *, ni_
 	ni_rtevent_handle_t *handle;
 	unsigned int family;
 
+	if (ni_netshare_client_active() && !ni_global.interface_addr_event) {
+		ni_global.interface_addr_event = ifaddr_handler;
+		return 0;
+	}
+
 	if (!__ni_rtevent_sock || ni_global.interface_addr_event) {
 		ni_error("Interface address event handler already set");
 		return -1;
@@ -1244,6 +1271,11 @@ ni_server_enable_interface_prefix_events(void (*ifprefix_handler)(ni_netdev_t *,
 {
 	ni_rtevent_handle_t *handle;
 
+	if (ni_netshare_client_active() && !ni_global.interface_prefix_event) {
+		ni_global.interface_prefix_event = ifprefix_handler;
+		return 0;
+	}
+
 	if (!__ni_rtevent_sock || ni_global.interface_prefix_event) {
 		ni_error("Interface prefix event handler already set");
 		return -1;
@@ -1432,6 +1464,7 @@ void
 ni_server_deactivate_interface_events(void)
 {
 	ni_server_deactivate_interface_uevents();
+	ni_netshare_client_close();
 
 	if (__ni_rtevent_sock) {
 		ni_socket_t *sock = __ni_rtevent_sock;
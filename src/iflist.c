@@ -69,7 +69,7 @@ static int		__ni_netdev_process_newroute(ni_netdev_t *, struct nlmsghdr *,
 					struct rtmsg *, ni_netconfig_t *);
 static int		__ni_netdev_process_newrule(struct nlmsghdr *, struct fib_rule_hdr *,
 					ni_netconfig_t *);
-static int		__ni_discover_bridge(ni_netdev_t *);
+static int		__ni_discover_bridge(ni_netdev_t *, struct nlattr **, ni_netconfig_t *);
 static int		__ni_discover_bond(ni_netdev_t *, struct nlattr **, ni_netconfig_t *);
 static int		__ni_discover_addrconf(ni_netdev_t *);
 static int		__ni_discover_infiniband(ni_netdev_t *, ni_netconfig_t *);
@@ -436,6 +436,12 @@ __ni_refresh_bonding_master_bind(ni_netdev_t *master, ni_linkinfo_t *link, const
 	ni_bonding_slave_set_info(slave, link->slave.bond);
 }
 
+static inline void
+__ni_refresh_bridge_master_bind(ni_netdev_t *master, ni_linkinfo_t *link, const char *ifname)
+{
+	ni_bridge_bind_port(ni_netdev_get_bridge(master), ifname, link->ifindex, link->slave.bridge);
+}
+
 static void
 __ni_refresh_bind_master(ni_netconfig_t *nc, ni_netdev_t *dev)
 {
@@ -458,6 +464,10 @@ __ni_refresh_bind_master(ni_netconfig_t *nc, ni_netdev_t *dev)
 		__ni_refresh_bonding_master_bind(master, &dev->link, dev->name);
 		break;
 
+	case NI_IFTYPE_BRIDGE:
+		__ni_refresh_bridge_master_bind(master, &dev->link, dev->name);
+		break;
+
 	default:
 		break;
 	}
@@ -502,6 +512,10 @@ __ni_refresh_unbind_master(ni_netconfig_t *nc, ni_netdev_t *dev)
 		__ni_refresh_bonding_master_unbind(master, &dev->link, dev->name);
 		break;
 
+	case NI_IFTYPE_BRIDGE:
+		ni_bridge_unbind_port(master->bridge, dev->link.ifindex);
+		break;
+
 	default:
 		break;
 	}
@@ -544,6 +558,10 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 	if (ni_rtnl_query(&query, 0, ni_netconfig_get_family_filter(nc)) < 0)
 		goto failed;
 
+	/* Dump ethtool details of all devices for the refresh below */
+	if (!ni_netconfig_discover_filtered(nc, NI_NETCONFIG_DISCOVER_LINK_EXTERN))
+		ni_system_ethtool_refresh_begin();
+
 	/* Find tail of iflist */
 	tail = ni_netconfig_device_list_head(nc);
 	while ((dev = *tail) != NULL)
@@ -663,6 +681,7 @@ __ni_system_refresh_all(ni_netconfig_t *nc, ni_netdev_t **del_list)
 	res = 0;
 
 failed:
+	ni_system_ethtool_refresh_end();
 	ni_rtnl_query_destroy(&query);
 	return res;
 }
@@ -1096,7 +1115,7 @@ __ni_process_ifinfomsg_ovs_type(ni_iftype_t *type, const char *ifname, ni_netcon
 	if (ni_netconfig_discover_filtered(nc, NI_NETCONFIG_DISCOVER_LINK_EXTERN))
 		return;
 
-	if (ni_ovs_vsctl_bridge_exists(ifname) == 0)
+	if (ni_ovs_ctl_bridge_exists(ifname) == 0)
 		*type = NI_IFTYPE_OVS_BRIDGE;
 }
 
@@ -1252,6 +1271,12 @@ __ni_process_ifinfomsg_masterdev_unbind(ni_linkinfo_t *link, const char *ifname,
 		case NI_IFTYPE_BOND:
 			ni_bonding_unbind_slave(master->bonding, &ref, master->name);
 			break;
+		case NI_IFTYPE_BRIDGE:
+			ni_bridge_unbind_port(master->bridge, link->ifindex);
+			break;
+		case NI_IFTYPE_TEAM:
+			ni_teamd_port_unbind(master, ifname);
+			break;
 		default:
 			break;
 		}
@@ -1271,6 +1296,12 @@ __ni_process_ifinfomsg_masterdev_bind(ni_linkinfo_t *link, const char *ifname,
 		case NI_IFTYPE_BOND:
 			ni_bonding_bind_slave(master->bonding, &ref, master->name);
 			break;
+		case NI_IFTYPE_BRIDGE:
+			ni_bridge_bind_port(ni_netdev_get_bridge(master), ifname, link->ifindex, NULL);
+			break;
+		case NI_IFTYPE_TEAM:
+			ni_teamd_port_bind(master, ifname);
+			break;
 		default:
 			break;
 		}
@@ -1400,6 +1431,117 @@ __ni_process_ifinfomsg_bond_slave_data(ni_linkinfo_t *link, const char *ifname,
 	}
 }
 
+static inline void
+__ni_bridge_id_print(char **str, const struct nlattr *aptr)
+{
+	const struct ifla_bridge_id *id;
+	char buf[32];
+
+	if (nla_len(aptr) < (int)sizeof(*id))
+		return;
+
+	/* same format as the kernel uses in sysfs */
+	id = nla_data(aptr);
+	snprintf(buf, sizeof(buf), "%.2x%.2x.%.2x%.2x%.2x%.2x%.2x%.2x",
+			id->prio[0], id->prio[1],
+			id->addr[0], id->addr[1], id->addr[2],
+			id->addr[3], id->addr[4], id->addr[5]);
+	ni_string_dup(str, buf);
+}
+
+static inline void
+__ni_process_ifinfomsg_bridge_port_data(ni_linkinfo_t *link, const char *ifname, struct nlattr *data)
+{
+	/* static const */ struct nla_policy	__port_policy[IFLA_BRPORT_MAX+1] = {
+		[IFLA_BRPORT_STATE]			= { .type = NLA_U8	},
+		[IFLA_BRPORT_PRIORITY]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_COST]			= { .type = NLA_U32	},
+		[IFLA_BRPORT_MODE]			= { .type = NLA_U8	},
+		[IFLA_BRPORT_ROOT_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BRPORT_BRIDGE_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BRPORT_DESIGNATED_PORT]		= { .type = NLA_U16	},
+		[IFLA_BRPORT_DESIGNATED_COST]		= { .type = NLA_U16	},
+		[IFLA_BRPORT_ID]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_NO]			= { .type = NLA_U16	},
+		[IFLA_BRPORT_TOPOLOGY_CHANGE_ACK]	= { .type = NLA_U8	},
+		[IFLA_BRPORT_CONFIG_PENDING]		= { .type = NLA_U8	},
+		[IFLA_BRPORT_MESSAGE_AGE_TIMER]		= { .type = NLA_U64	},
+		[IFLA_BRPORT_FORWARD_DELAY_TIMER]	= { .type = NLA_U64	},
+		[IFLA_BRPORT_HOLD_TIMER]		= { .type = NLA_U64	},
+	};
+	struct nlattr *tb[IFLA_BRPORT_MAX+1], *aptr;
+	ni_bridge_port_status_t *ps;
+	ni_bridge_port_t *port;
+	unsigned int attr;
+
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, IFLA_BRPORT_MAX, data, __port_policy) < 0) {
+		ni_warn("%s: unable to parse bridge port data", ifname);
+		return;
+	}
+
+	port = link->slave.bridge;
+	ps = &port->status;
+	for (attr = IFLA_BRPORT_STATE; attr <= IFLA_BRPORT_HOLD_TIMER; ++attr) {
+		if (!(aptr = tb[attr]))
+			continue;
+
+		switch (attr) {
+		case IFLA_BRPORT_STATE:
+			ps->state = nla_get_u8(aptr);
+			break;
+		case IFLA_BRPORT_PRIORITY:
+			port->priority = ps->priority = nla_get_u16(aptr);
+			break;
+		case IFLA_BRPORT_COST:
+			port->path_cost = ps->path_cost = nla_get_u32(aptr);
+			break;
+		case IFLA_BRPORT_MODE:
+			ps->hairpin_mode = nla_get_u8(aptr);
+			break;
+		case IFLA_BRPORT_ROOT_ID:
+			__ni_bridge_id_print(&ps->designated_root, aptr);
+			break;
+		case IFLA_BRPORT_BRIDGE_ID:
+			__ni_bridge_id_print(&ps->designated_bridge, aptr);
+			break;
+		case IFLA_BRPORT_DESIGNATED_PORT:
+			ps->designated_port = nla_get_u16(aptr);
+			break;
+		case IFLA_BRPORT_DESIGNATED_COST:
+			ps->designated_cost = nla_get_u16(aptr);
+			break;
+		case IFLA_BRPORT_ID:
+			ps->port_id = nla_get_u16(aptr);
+			break;
+		case IFLA_BRPORT_NO:
+			ps->port_no = nla_get_u16(aptr);
+			break;
+		case IFLA_BRPORT_TOPOLOGY_CHANGE_ACK:
+			ps->change_ack = nla_get_u8(aptr);
+			break;
+		case IFLA_BRPORT_CONFIG_PENDING:
+			ps->config_pending = nla_get_u8(aptr);
+			break;
+		case IFLA_BRPORT_MESSAGE_AGE_TIMER:
+			ps->message_age_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BRPORT_FORWARD_DELAY_TIMER:
+			ps->forward_delay_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BRPORT_HOLD_TIMER:
+			ps->hold_timer = nla_get_u64(aptr);
+			break;
+		default:
+			break;
+		}
+	}
+
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_EVENTS,
+			"%s: get bridge port attrs state=%d priority=%u cost=%u",
+			ifname, ps->state, ps->priority, ps->path_cost);
+}
+
 static inline void
 __ni_process_ifinfomsg_slave_data(ni_linkinfo_t *link, const char *ifname,
 		ni_netdev_t *master, const char *kind, struct nlattr *data)
@@ -1437,6 +1579,28 @@ __ni_process_ifinfomsg_slave_data(ni_linkinfo_t *link, const char *ifname,
 			__ni_process_ifinfomsg_bond_slave_data(link, ifname, data);
 		break;
 
+	case NI_IFTYPE_BRIDGE:
+		if (master && master->link.type != link->slave.type) {
+			ni_warn("%s: master %s link type does not match slaveinfo kind type",
+					master->name, ifname);
+			return;
+		}
+
+		if (!data) {
+			ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_EVENTS,
+					"%s: slave info does not provide any data", ifname);
+			return;
+		}
+
+		link->slave.bridge = ni_bridge_port_new(NULL, ifname, link->ifindex);
+		__ni_process_ifinfomsg_bridge_port_data(link, ifname, data);
+
+		/* port membership is derived from IFLA_MASTER, update status */
+		if (master)
+			ni_bridge_bind_port(ni_netdev_get_bridge(master), ifname,
+					link->ifindex, link->slave.bridge);
+		break;
+
 	default:
 		break;
 	}
@@ -1864,7 +2028,7 @@ __ni_netdev_process_newlink(ni_netdev_t *dev, struct nlmsghdr *h,
 		break;
 
 	case NI_IFTYPE_BRIDGE:
-		__ni_discover_bridge(dev);
+		__ni_discover_bridge(dev, tb, nc);
 		break;
 	case NI_IFTYPE_BOND:
 		__ni_discover_bond(dev, tb, nc);
@@ -3434,19 +3598,160 @@ failure:
  * Discover bridge topology
  */
 static int
-__ni_discover_bridge(ni_netdev_t *dev)
+__ni_discover_bridge_netlink_master(ni_netdev_t *dev, struct nlattr *info_data, ni_bridge_t *bridge)
 {
-	ni_bridge_t *bridge;
-	ni_string_array_t ports;
-	unsigned int i;
+	/* static const */ struct nla_policy	__bridge_master_policy[IFLA_BR_MAX+1] = {
+		[IFLA_BR_FORWARD_DELAY]			= { .type = NLA_U32	},
+		[IFLA_BR_HELLO_TIME]			= { .type = NLA_U32	},
+		[IFLA_BR_MAX_AGE]			= { .type = NLA_U32	},
+		[IFLA_BR_AGEING_TIME]			= { .type = NLA_U32	},
+		[IFLA_BR_STP_STATE]			= { .type = NLA_U32	},
+		[IFLA_BR_PRIORITY]			= { .type = NLA_U16	},
+		[IFLA_BR_ROOT_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BR_BRIDGE_ID]			= { .type = NLA_UNSPEC	},
+		[IFLA_BR_ROOT_PORT]			= { .type = NLA_U16	},
+		[IFLA_BR_ROOT_PATH_COST]		= { .type = NLA_U32	},
+		[IFLA_BR_TOPOLOGY_CHANGE]		= { .type = NLA_U8	},
+		[IFLA_BR_TOPOLOGY_CHANGE_DETECTED]	= { .type = NLA_U8	},
+		[IFLA_BR_HELLO_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_TCN_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_TOPOLOGY_CHANGE_TIMER]		= { .type = NLA_U64	},
+		[IFLA_BR_GC_TIMER]			= { .type = NLA_U64	},
+		[IFLA_BR_GROUP_ADDR]			= { .type = NLA_UNSPEC	},
+	};
+	struct nlattr *tb[IFLA_BR_MAX+1], *aptr;
+	ni_bridge_status_t *bs = &bridge->status;
+	unsigned int attr;
 
-	if (dev->link.type != NI_IFTYPE_BRIDGE)
-		return 0;
+	memset(tb, 0, sizeof(tb));
+	if (nla_parse_nested(tb, IFLA_BR_MAX, info_data, __bridge_master_policy) < 0) {
+		ni_error("%s: Unable to parse bridge IFLA_INFO_DATA", dev->name);
+		return -1;
+	}
+
+	for (attr = IFLA_BR_FORWARD_DELAY; attr <= IFLA_BR_GROUP_ADDR; ++attr) {
+		if (!(aptr = tb[attr]))
+			continue;
+
+		switch (attr) {
+		/* times are in USER_HZ (clock_t) units, as in sysfs */
+		case IFLA_BR_FORWARD_DELAY:
+			bridge->forward_delay = (double)nla_get_u32(aptr) / 100.0;
+			break;
+		case IFLA_BR_HELLO_TIME:
+			bridge->hello_time = (double)nla_get_u32(aptr) / 100.0;
+			break;
+		case IFLA_BR_MAX_AGE:
+			bridge->max_age = (double)nla_get_u32(aptr) / 100.0;
+			break;
+		case IFLA_BR_AGEING_TIME:
+			bridge->ageing_time = (double)nla_get_u32(aptr) / 100.0;
+			break;
+		case IFLA_BR_STP_STATE:
+			bs->stp_state = nla_get_u32(aptr);
+			bridge->stp = bs->stp_state ? TRUE : FALSE;
+			break;
+		case IFLA_BR_PRIORITY:
+			bridge->priority = nla_get_u16(aptr);
+			break;
+		case IFLA_BR_ROOT_ID:
+			__ni_bridge_id_print(&bs->root_id, aptr);
+			break;
+		case IFLA_BR_BRIDGE_ID:
+			__ni_bridge_id_print(&bs->bridge_id, aptr);
+			break;
+		case IFLA_BR_ROOT_PORT:
+			bs->root_port = nla_get_u16(aptr);
+			break;
+		case IFLA_BR_ROOT_PATH_COST:
+			bs->root_path_cost = nla_get_u32(aptr);
+			break;
+		case IFLA_BR_TOPOLOGY_CHANGE:
+			bs->topology_change = nla_get_u8(aptr);
+			break;
+		case IFLA_BR_TOPOLOGY_CHANGE_DETECTED:
+			bs->topology_change_detected = nla_get_u8(aptr);
+			break;
+		case IFLA_BR_HELLO_TIMER:
+			bs->hello_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BR_TCN_TIMER:
+			bs->tcn_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BR_TOPOLOGY_CHANGE_TIMER:
+			bs->topology_change_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BR_GC_TIMER:
+			bs->gc_timer = nla_get_u64(aptr);
+			break;
+		case IFLA_BR_GROUP_ADDR:
+			if (nla_len(aptr) == ETH_ALEN) {
+				const unsigned char *mac = nla_data(aptr);
+				char buf[32];
+
+				snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+						mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+				ni_string_dup(&bs->group_addr, buf);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_EVENTS,
+			"%s: get bridge attrs stp=%u priority=%u root-id=%s bridge-id=%s",
+			dev->name, bs->stp_state, bridge->priority,
+			bs->root_id, bs->bridge_id);
+	return 0;
+}
+
+static int
+__ni_discover_bridge_netlink(ni_netdev_t *dev, struct nlattr **tb, ni_bridge_t *bridge)
+{
+	/* static const */ struct nla_policy	__info_data_policy[IFLA_INFO_MAX+1] = {
+		[IFLA_INFO_KIND]			= { .type = NLA_STRING	},
+		[IFLA_INFO_DATA]			= { .type = NLA_NESTED	},
+		/* _here_, we handle only these attrs */
+	};
+	struct nlattr *info[IFLA_INFO_MAX+1];
+	static int fallback = 1;
 
-	bridge = ni_netdev_get_bridge(dev);
+	if (!tb || !tb[IFLA_LINKINFO])
+		return fallback;
 
-	ni_sysfs_bridge_get_config(dev->name, bridge);
-	ni_sysfs_bridge_get_status(dev->name, &bridge->status);
+	if (nla_parse_nested(info, IFLA_INFO_MAX, tb[IFLA_LINKINFO], __info_data_policy) < 0) {
+		ni_error("%s: Unable to parse IFLA_LINKINFO newlink attribute", dev->name);
+		return -1;
+	}
+
+	if (!info[IFLA_INFO_KIND] || !ni_string_eq("bridge", nla_get_string(info[IFLA_INFO_KIND])))
+		return fallback; /* just a safe guard, we've already checked this   */
+
+	if (!info[IFLA_INFO_DATA])
+		return fallback; /* ahm... no data provided in this newlink message */
+
+	fallback = 0;		 /* disable sysfs fallback, kernel supports netlink */
+
+	/*
+	 * The port list is maintained while processing the newlink messages
+	 * of the ports, that is derived from their IFLA_MASTER and the port
+	 * details from their IFLA_INFO_SLAVE_DATA.
+	 */
+	return __ni_discover_bridge_netlink_master(dev, info[IFLA_INFO_DATA], bridge);
+}
+
+static int
+__ni_discover_bridge_sysfs(ni_netdev_t *dev, ni_bridge_t *bridge)
+{
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+	ni_string_array_t ports;
+	unsigned int i;
+
+	if (ni_sysfs_netif_dir_open(&dir, dev->name, "bridge")) {
+		ni_sysfs_bridge_dir_get_config(&dir, bridge);
+		ni_sysfs_bridge_dir_get_status(&dir, &bridge->status);
+	}
 
 	ni_string_array_init(&ports);
 	ni_sysfs_bridge_get_port_names(dev->name, &ports);
@@ -3465,14 +3770,38 @@ __ni_discover_bridge(ni_netdev_t *dev)
 		}
 		port = ni_bridge_port_new(bridge, ifname, index);
 
-		ni_sysfs_bridge_port_get_config(port->ifname, port);
-		ni_sysfs_bridge_port_get_status(port->ifname, &port->status);
+		if (ni_sysfs_netif_dir_open(&dir, port->ifname, "brport")) {
+			ni_sysfs_bridge_port_dir_get_config(&dir, port);
+			ni_sysfs_bridge_port_dir_get_status(&dir, &port->status);
+		}
 	}
 	ni_string_array_destroy(&ports);
+	ni_sysfs_dir_close(&dir);
 
 	return 0;
 }
 
+static int
+__ni_discover_bridge(ni_netdev_t *dev, struct nlattr **tb, ni_netconfig_t *nc)
+{
+	ni_bridge_t *bridge;
+	int ret;
+
+	if (dev->link.type != NI_IFTYPE_BRIDGE)
+		return 0;
+
+	if (!(bridge = ni_netdev_get_bridge(dev))) {
+		ni_error("%s: Unable to discover bridge interface details",
+			dev->name);
+		return -1;
+	}
+
+	if ((ret = __ni_discover_bridge_netlink(dev, tb, bridge)) <= 0)
+		return ret;
+
+	return __ni_discover_bridge_sysfs(dev, bridge);
+}
+
 /*
  * Discover bonding configuration
  */
@@ -147,6 +147,7 @@ ni_ipv4_devinfo_free(ni_ipv4_devinfo_t *ipv4)
 int
 ni_system_ipv4_devinfo_get(ni_netdev_t *dev, ni_ipv4_devinfo_t *ipv4)
 {
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
 	ni_bool_t can_arp;
 
 	if (ipv4 == NULL)
@@ -161,17 +162,19 @@ ni_system_ipv4_devinfo_get(ni_netdev_t *dev, ni_ipv4_devinfo_t *ipv4)
 			NI_TRISTATE_ENABLE : NI_TRISTATE_DISABLE;
 	}
 
-	if (ni_sysctl_ipv4_ifconfig_is_present(dev->name)) {
+	if (ni_sysctl_ipv4_ifconfig_dir_open(&dir, dev->name)) {
 		int val;
 
-		if (ni_sysctl_ipv4_ifconfig_get_int(dev->name, "forwarding", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "forwarding", &val) >= 0)
 			ni_tristate_set(&ipv4->conf.forwarding, val);
 
-		if (can_arp && ni_sysctl_ipv4_ifconfig_get_int(dev->name, "arp_notify", &val) >= 0)
+		if (can_arp && ni_sysfs_dir_get_int(&dir, "arp_notify", &val) >= 0)
 			ni_tristate_set(&ipv4->conf.arp_notify, val);
 
-		if (ni_sysctl_ipv4_ifconfig_get_int(dev->name, "accept_redirects", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "accept_redirects", &val) >= 0)
 			ni_tristate_set(&ipv4->conf.accept_redirects, val);
+
+		ni_sysfs_dir_close(&dir);
 	} else {
 		ni_warn("%s: cannot get ipv4 device attributes", dev->name);
 
@@ -190,6 +190,8 @@ ni_ipv6_devinfo_free(ni_ipv6_devinfo_t *ipv6)
 int
 ni_system_ipv6_devinfo_get(ni_netdev_t *dev, ni_ipv6_devinfo_t *ipv6)
 {
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+
 	if (ipv6 == NULL)
 		ipv6 = ni_netdev_get_ipv6(dev);
 
@@ -209,30 +211,31 @@ ni_system_ipv6_devinfo_get(ni_netdev_t *dev, ni_ipv6_devinfo_t *ipv6)
 	 * When we bring the interface back up, everything is fine; but until
 	 * then we need to ignore this glitch.
 	 */
-	if (ni_sysctl_ipv6_ifconfig_is_present(dev->name)) {
+	if (ni_sysctl_ipv6_ifconfig_dir_open(&dir, dev->name)) {
 		int val;
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "disable_ipv6", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "disable_ipv6", &val) >= 0)
 			ni_tristate_set(&ipv6->conf.enabled, !val);
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "forwarding", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "forwarding", &val) >= 0)
 			ni_tristate_set(&ipv6->conf.forwarding, !!val);
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "autoconf", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "autoconf", &val) >= 0)
 			ni_tristate_set(&ipv6->conf.autoconf, !!val);
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "use_tempaddr", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "use_tempaddr", &val) >= 0)
 			ipv6->conf.privacy = val < -1 ? -1 : (val > 2 ? 2 : val);
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "accept_ra", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "accept_ra", &val) >= 0)
 			ipv6->conf.accept_ra = val < 0 ? 0 : val > 2 ? 2 : val;
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "accept_dad", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "accept_dad", &val) >= 0)
 			ipv6->conf.accept_dad = val < 0 ? 0 : val > 2 ? 2 : val;
 
-		if (ni_sysctl_ipv6_ifconfig_get_int(dev->name, "accept_redirects", &val) >= 0)
+		if (ni_sysfs_dir_get_int(&dir, "accept_redirects", &val) >= 0)
 			ni_tristate_set(&ipv6->conf.accept_redirects, !!val);
 
+		ni_sysfs_dir_close(&dir);
 	} else {
 		ni_warn("%s: cannot get ipv6 device attributes", dev->name);
 
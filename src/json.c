@@ -29,9 +29,6 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <ctype.h>
-#if 0
-#include <iconv.h>
-#endif
 #include <inttypes.h>
 #include <wicked/logging.h>
 
@@ -45,6 +42,13 @@
 #define	NI_JSON_OBJECT_CHUNK	4
 #define NI_JSON_ARRAY_CHUNK	4
 
+/*
+ * objects with at least this number of members get a name hash
+ * index (open addressing over the member positions), built on
+ * the first lookup and kept at a load factor of at most 1/2
+ */
+#define NI_JSON_OBJECT_HASH_MIN	16
+
 
 /*
  * structured types
@@ -67,12 +71,16 @@ struct ni_json_pair {
 	unsigned int		refcount;
 
 	char *			name;
+	unsigned int		hash;
 	ni_json_t *		value;
 };
 
 struct ni_json_object {
 	unsigned int		count;
 	ni_json_pair_t **	data;
+
+	unsigned int		hsize;
+	unsigned int *		hash;	/* member position + 1, 0 if unused */
 };
 
 struct ni_json_array {
@@ -195,17 +203,41 @@ ni_json_string_get(ni_json_t *json, char **ret)
 /*
  * json object name:value pair
  */
+static inline unsigned int
+ni_json_name_hash(const char *name)
+{
+	const unsigned char *ptr = (const unsigned char *)name;
+	unsigned int hash = 2166136261U;
+
+	while (*ptr) {
+		hash ^= *ptr++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static ni_json_pair_t *
+ni_json_pair_new_take(char **name, ni_json_t *value)
+{
+	ni_json_pair_t *pair;
+
+	pair = xcalloc(1, sizeof(*pair));
+	pair->refcount = 1;
+	pair->name = *name;
+	pair->hash = ni_json_name_hash(pair->name);
+	pair->value = value;
+	*name = NULL;
+	return pair;
+}
+
 ni_json_pair_t *
 ni_json_pair_new(const char *name, ni_json_t *value)
 {
-	ni_json_pair_t *pair;
+	char *copy;
 
 	if (name && value) {
-		pair = xcalloc(1, sizeof(*pair));
-		pair->refcount = 1;
-		pair->name = xstrdup(name);
-		pair->value = value;
-		return pair;
+		copy = xstrdup(name);
+		return ni_json_pair_new_take(&copy, value);
 	}
 	return NULL;
 }
@@ -275,6 +307,72 @@ ni_json_object_new(void)
 	return xcalloc(1, sizeof(ni_json_object_t));
 }
 
+static void
+ni_json_object_hash_drop(ni_json_object_t *njo)
+{
+	free(njo->hash);
+	njo->hash = NULL;
+	njo->hsize = 0;
+}
+
+static void
+ni_json_object_hash_insert(ni_json_object_t *njo, unsigned int pos)
+{
+	unsigned int mask = njo->hsize - 1;
+	unsigned int slot = njo->data[pos]->hash & mask;
+
+	while (njo->hash[slot])
+		slot = (slot + 1) & mask;
+	njo->hash[slot] = pos + 1;
+}
+
+static void
+ni_json_object_hash_build(ni_json_object_t *njo)
+{
+	unsigned int size = 32;
+	unsigned int i;
+
+	while (size < njo->count * 2)
+		size <<= 1;
+
+	free(njo->hash);
+	njo->hash = xcalloc(size, sizeof(*njo->hash));
+	njo->hsize = size;
+	for (i = 0; i < njo->count; ++i)
+		ni_json_object_hash_insert(njo, i);
+}
+
+static int
+ni_json_object_find(ni_json_object_t *njo, const char *name)
+{
+	unsigned int i, hash, mask, slot;
+	ni_json_pair_t *pair;
+
+	if (!name)
+		return -1;
+
+	if (njo->count < NI_JSON_OBJECT_HASH_MIN) {
+		for (i = 0; i < njo->count; ++i) {
+			if (ni_string_eq(njo->data[i]->name, name))
+				return i;
+		}
+		return -1;
+	}
+
+	if (!njo->hash)
+		ni_json_object_hash_build(njo);
+
+	hash = ni_json_name_hash(name);
+	mask = njo->hsize - 1;
+	for (slot = hash & mask; njo->hash[slot]; slot = (slot + 1) & mask) {
+		i = njo->hash[slot] - 1;
+		pair = njo->data[i];
+		if (pair->hash == hash && ni_string_eq(pair->name, name))
+			return i;
+	}
+	return -1;
+}
+
 static void
 ni_json_object_free(ni_json_object_t *njo)
 {
@@ -285,6 +383,7 @@ ni_json_object_free(ni_json_object_t *njo)
 	}
 	free(njo->data);
 	njo->data = NULL;
+	ni_json_object_hash_drop(njo);
 	free(njo);
 }
 
@@ -292,18 +391,14 @@ ni_json_pair_t *
 ni_json_object_get_pair(ni_json_t *json, const char *name)
 {
 	ni_json_object_t *njo;
-	unsigned int i;
+	int pos;
 
 	if (!(njo = ni_json_to_object(json)))
 		return NULL;
 
-	for (i = 0; i < njo->count; ++i) {
-		ni_json_pair_t *pair = njo->data[i];
-
-		if (ni_string_eq(pair->name, name))
-			return pair;
-	}
-	return NULL;
+	if ((pos = ni_json_object_find(njo, name)) < 0)
+		return NULL;
+	return njo->data[pos];
 }
 
 ni_json_pair_t *
@@ -356,6 +451,21 @@ ni_json_object_realloc(ni_json_object_t *njo, unsigned int size)
 		njo->data[i] = NULL;
 }
 
+static void
+ni_json_object_append_pair(ni_json_object_t *njo, ni_json_pair_t *pair)
+{
+	if ((njo->count % NI_JSON_OBJECT_CHUNK) == 0)
+		ni_json_object_realloc(njo, njo->count);
+
+	njo->data[njo->count++] = pair;
+	if (njo->hash) {
+		if (njo->count * 2 > njo->hsize)
+			ni_json_object_hash_build(njo);
+		else
+			ni_json_object_hash_insert(njo, njo->count - 1);
+	}
+}
+
 static ni_bool_t
 ni_json_object_append(ni_json_t *json, const char *name, ni_json_t *value)
 {
@@ -368,10 +478,7 @@ ni_json_object_append(ni_json_t *json, const char *name, ni_json_t *value)
 	if (!(pair = ni_json_pair_new(name, value)))
 		return FALSE;
 
-	if ((njo->count % NI_JSON_OBJECT_CHUNK) == 0)
-		ni_json_object_realloc(njo, njo->count);
-
-	njo->data[njo->count++] = pair;
+	ni_json_object_append_pair(njo, pair);
 	return TRUE;
 }
 
@@ -410,6 +517,27 @@ ni_json_object_set(ni_json_t *json, const char *name, ni_json_t *value)
 	return FALSE;
 }
 
+/*
+ * as ni_json_object_set, but takes over the allocated name
+ */
+static ni_bool_t
+ni_json_object_set_take(ni_json_t *json, char **name, ni_json_t *value)
+{
+	ni_json_object_t *njo;
+	ni_json_pair_t *pair;
+
+	if (!(njo = ni_json_to_object(json)) || !*name || !value)
+		return FALSE;
+
+	if ((pair = ni_json_object_get_pair(json, *name))) {
+		ni_string_free(name);
+		return ni_json_pair_set_value(pair, value);
+	}
+
+	ni_json_object_append_pair(njo, ni_json_pair_new_take(name, value));
+	return TRUE;
+}
+
 ni_json_t *
 ni_json_object_remove_at(ni_json_t *json, unsigned int pos)
 {
@@ -423,6 +551,9 @@ ni_json_object_remove_at(ni_json_t *json, unsigned int pos)
 	ni_json_pair_free(njo->data[pos]);
 	njo->count--;
 
+	/* positions shift, rebuild the index on next lookup */
+	ni_json_object_hash_drop(njo);
+
 	if (pos < njo->count) {
 		memmove(&njo->data[pos], &njo->data[pos + 1],
 			(njo->count - pos) * sizeof(ni_json_pair_t *));
@@ -444,18 +575,14 @@ ni_json_t *
 ni_json_object_remove(ni_json_t *json, const char *name)
 {
 	ni_json_object_t *njo;
-	unsigned int i;
+	int pos;
 
 	if (!(njo = ni_json_to_object(json)))
 		return NULL;
 
-	for (i = 0; i < njo->count; ++i) {
-		ni_json_pair_t *pair = njo->data[i];
-
-		if (ni_string_eq(pair->name, name))
-			return ni_json_object_remove_at(json, i);
-	}
-	return NULL;
+	if ((pos = ni_json_object_find(njo, name)) < 0)
+		return NULL;
+	return ni_json_object_remove_at(json, pos);
 }
 
 ni_bool_t
@@ -1035,14 +1162,22 @@ struct ni_json_reader_stack {
 	ni_json_t *			value;
 };
 
+/*
+ * The reader scans the input buffer in place in a single pass,
+ * validating the UTF-8 of the strings as it copies them.
+ * Its transient allocations are kept for the whole parse run:
+ * one token buffer, reused by every token, and a free list of
+ * the stack frames, so only the resulting json nodes allocate.
+ */
 struct ni_json_reader {
 	ni_buffer_t *			inbuf;
-#if 0
-	iconv_t				iconv;
-#endif
+	const unsigned char *		pos;
+	const unsigned char *		end;
 	ni_bool_t			quiet;
 	ni_string_array_t		error;
+	ni_stringbuf_t			token;
 	ni_json_reader_stack_t *	stack;
+	ni_json_reader_stack_t *	spare;
 };
 
 static ni_json_reader_stack_t *
@@ -1050,7 +1185,11 @@ ni_json_reader_stack_new(ni_json_reader_t *jr, ni_json_state_t state)
 {
 	ni_json_reader_stack_t *stack;
 
-	stack = xcalloc(1, sizeof(*stack));
+	if ((stack = jr->spare))
+		jr->spare = stack->parent;
+	else
+		stack = xcalloc(1, sizeof(*stack));
+
 	stack->state = state;
 	stack->parent = jr->stack;
 	jr->stack = stack;
@@ -1064,9 +1203,11 @@ ni_json_reader_stack_pop(ni_json_reader_t *jr)
 
 	if ((stack = jr->stack)) {
 		jr->stack = stack->parent;
-		stack->parent = NULL;
 		ni_string_free(&stack->name);
 		ni_json_free(stack->value);
+		stack->value = NULL;
+		stack->parent = jr->spare;
+		jr->spare = stack;
 	}
 	return jr->stack;
 }
@@ -1075,37 +1216,34 @@ static ni_bool_t
 ni_json_reader_init_buffer(ni_json_reader_t *jr, ni_buffer_t *buf)
 {
 	jr->inbuf = buf;
-#if 0
-	jr->iconv = (iconv_t)-1;
-#endif
+	jr->pos = buf ? ni_buffer_head(buf) : NULL;
+	jr->end = buf ? jr->pos + ni_buffer_count(buf) : NULL;
 	jr->stack = NULL;
+	jr->spare = NULL;
 	jr->quiet = FALSE;
+	ni_stringbuf_init(&jr->token);
 	ni_string_array_init(&jr->error);
 	return buf != NULL;
 }
 
-#if 0
-static ni_bool_t
-ni_json_reader_open_iconv(ni_json_reader_t *jr)
-{
-	if (jr->iconv == (iconv_t)-1)
-		jr->iconv = iconv_open("UTF-8", "UTF-16BE");
-	return	jr->iconv != (iconv_t)-1;
-}
-#endif
-
 static ni_bool_t
 ni_json_reader_destroy(ni_json_reader_t *jr)
 {
+	ni_json_reader_stack_t *stack;
+
 	ni_string_array_destroy(&jr->error);
 	while (ni_json_reader_stack_pop(jr))
 		;
+	while ((stack = jr->spare)) {
+		jr->spare = stack->parent;
+		free(stack);
+	}
+	ni_stringbuf_destroy(&jr->token);
+
+	if (jr->inbuf && jr->pos)
+		ni_buffer_pull_head(jr->inbuf, jr->pos - (const unsigned char *)ni_buffer_head(jr->inbuf));
 	jr->inbuf = NULL;
-#if 0
-	if (jr->iconv)
-		iconv_close(jr->iconv);
-	jr->iconv = (iconv_t)-1;
-#endif
+	jr->pos = jr->end = NULL;
 	return TRUE;
 }
 
@@ -1143,6 +1281,12 @@ ni_json_reader_set_error(ni_json_reader_t *jr, const char *fmt, ...)
 	return FALSE;
 }
 
+static inline const char *
+ni_json_reader_get_token(ni_json_reader_t *jr)
+{
+	return jr->token.string ? jr->token.string : "";
+}
+
 static inline const char *
 ni_json_reader_get_pair_name(ni_json_reader_t *jr)
 {
@@ -1173,106 +1317,170 @@ ni_json_reader_get_parent(ni_json_reader_t *jr)
 	return jr->stack->parent ? jr->stack->parent->value : NULL;
 }
 
+static inline int
+ni_json_reader_getc(ni_json_reader_t *jr)
+{
+	return jr->pos < jr->end ? *jr->pos++ : EOF;
+}
+
 static void
 ni_json_reader_skip_spaces(ni_json_reader_t *jr)
 {
-	int cc;
-
-	while ((cc = ni_buffer_getc(jr->inbuf)) != EOF) {
-		if (!isspace(cc)) {
-			ni_buffer_ungetc(jr->inbuf, cc);
-			break;
-		}
-	}
+	while (jr->pos < jr->end && isspace(*jr->pos))
+		jr->pos++;
 }
 
 static void
 ni_json_reader_get_literal(ni_json_reader_t *jr, ni_stringbuf_t *res)
 {
-	int cc;
+	const unsigned char *beg = jr->pos;
 
-	while ((cc = ni_buffer_getc(jr->inbuf)) != EOF) {
-		if (!isalpha(cc)) {
-			ni_buffer_ungetc(jr->inbuf, cc);
-			break;
-		}
-		ni_stringbuf_putc(res, cc);
-	}
+	while (jr->pos < jr->end && isalpha(*jr->pos))
+		jr->pos++;
+	ni_stringbuf_put(res, (const char *)beg, jr->pos - beg);
 }
 
 static void
 ni_json_reader_get_number(ni_json_reader_t *jr, ni_stringbuf_t *res)
 {
-	int cc;
+	const unsigned char *beg = jr->pos;
 
-	while ((cc = ni_buffer_getc(jr->inbuf)) != EOF) {
-		switch (cc) {
+	while (jr->pos < jr->end) {
+		switch (*jr->pos) {
 		case '+': case '-':
 		case 'e': case 'E':
 		case '.':
-			ni_stringbuf_putc(res, cc);
+			jr->pos++;
 			break;
 		default:
-			if (isdigit(cc)) {
-				ni_stringbuf_putc(res, cc);
+			if (isdigit(*jr->pos)) {
+				jr->pos++;
 				break;
 			}
-			ni_buffer_ungetc(jr->inbuf, cc);
-			return;
+			goto done;
 		}
 	}
+done:
+	ni_stringbuf_put(res, (const char *)beg, jr->pos - beg);
 }
 
-static ni_bool_t
-ni_json_reader_get_eunicode(ni_json_reader_t *jr, ni_stringbuf_t *res)
+static int
+ni_json_reader_get_hex4(ni_json_reader_t *jr)
 {
-	char hbuf[5], sbuf[2] /*, obuf[8], *sptr, *optr */;
-	/* size_t slen, olen, n; */
-	unsigned int octet;
-	char *end = NULL;
+	unsigned int i, cc;
+	int val = 0;
 
-	if (ni_buffer_count(jr->inbuf) < 4)
-		return FALSE;
+	if (jr->end - jr->pos < 4)
+		return -1;
 
-	/*
-	 * TODO: We decode mandatory control chars only...
-	 * Also.. do we need to handle multiple sequences:
-	 * "\uD834\uDD1E", a G clef character (U+1D11E)??
-	 */
-	memset(hbuf, 0, sizeof(hbuf));
-	if (ni_buffer_get(jr->inbuf, &hbuf[0], 2) < 0)
-		return FALSE;
+	for (i = 0; i < 4; ++i) {
+		cc = *jr->pos++;
+		if (cc >= '0' && cc <= '9')
+			val = (val << 4) | (cc - '0');
+		else if (cc >= 'a' && cc <= 'f')
+			val = (val << 4) | (cc - 'a' + 10);
+		else if (cc >= 'A' && cc <= 'F')
+			val = (val << 4) | (cc - 'A' + 10);
+		else
+			return -1;
+	}
+	return val;
+}
 
-	octet = strtoul(&hbuf[0], &end, 16);
-	if (octet > 255 || *end != '\0')
-		return FALSE;
-	sbuf[0] = octet & 0xff;
+static void
+ni_json_utf8_encode(ni_stringbuf_t *res, unsigned int cp)
+{
+	char out[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		out[0] = cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xc0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3f);
+		len = 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xe0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3f);
+		out[2] = 0x80 | (cp & 0x3f);
+		len = 3;
+	} else {
+		out[0] = 0xf0 | (cp >> 18);
+		out[1] = 0x80 | ((cp >> 12) & 0x3f);
+		out[2] = 0x80 | ((cp >> 6) & 0x3f);
+		out[3] = 0x80 | (cp & 0x3f);
+		len = 4;
+	}
+	ni_stringbuf_put(res, out, len);
+}
 
-	if (ni_buffer_get(jr->inbuf, &hbuf[2], 2) < 0)
-		return FALSE;
-	octet = strtoul(&hbuf[2], &end, 16);
-        if (octet > 255 || *end != '\0')
-		return FALSE;
-	sbuf[1] = octet & 0xff;
+/*
+ * Returns the length of the valid UTF-8 multibyte sequence at ptr
+ * or 0 for invalid, overlong, surrogate and truncated sequences.
+ */
+static size_t
+ni_json_utf8_sequence(const unsigned char *ptr, const unsigned char *end)
+{
+	unsigned char lo = 0x80, hi = 0xbf;
+	size_t len, i;
+
+	if (ptr[0] >= 0xc2 && ptr[0] <= 0xdf) {
+		len = 2;
+	} else if (ptr[0] >= 0xe0 && ptr[0] <= 0xef) {
+		len = 3;
+		if (ptr[0] == 0xe0)
+			lo = 0xa0;
+		else if (ptr[0] == 0xed)
+			hi = 0x9f;
+	} else if (ptr[0] >= 0xf0 && ptr[0] <= 0xf4) {
+		len = 4;
+		if (ptr[0] == 0xf0)
+			lo = 0x90;
+		else if (ptr[0] == 0xf4)
+			hi = 0x8f;
+	} else {
+		return 0;
+	}
+
+	if ((size_t)(end - ptr) < len)
+		return 0;
+	if (ptr[1] < lo || ptr[1] > hi)
+		return 0;
+	for (i = 2; i < len; ++i) {
+		if (ptr[i] < 0x80 || ptr[i] > 0xbf)
+			return 0;
+	}
+	return len;
+}
+
+static ni_bool_t
+ni_json_reader_get_eunicode(ni_json_reader_t *jr, ni_stringbuf_t *res)
+{
+	int cp, lo;
 
-	if (sbuf[0] != 0)
+	if ((cp = ni_json_reader_get_hex4(jr)) < 0)
 		return FALSE;
-	if (sbuf[1] != 0)
-		ni_stringbuf_putc(res, sbuf[1]);
-#if 0
-	sptr = sbuf;
-	slen = sizeof(sbuf);
-	while (slen > 0) {
-		optr = obuf;
-		olen = sizeof(obuf);
-
-		n = iconv(jr->iconv, &sptr, &slen, &optr, &olen);
-		if (n == (size_t)-1)
+
+	if (cp >= 0xd800 && cp <= 0xdbff) {
+		/* surrogate pair, e.g. "\uD834\uDD1E", a G clef (U+1D11E) */
+		if (jr->end - jr->pos < 2 || jr->pos[0] != '\\' || jr->pos[1] != 'u')
 			return FALSE;
+		jr->pos += 2;
 
-		ni_stringbuf_put(res, obuf, n);
+		lo = ni_json_reader_get_hex4(jr);
+		if (lo < 0xdc00 || lo > 0xdfff)
+			return FALSE;
+
+		cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+	} else
+	if (cp >= 0xdc00 && cp <= 0xdfff) {
+		return FALSE;	/* unpaired low surrogate */
 	}
-#endif
+
+	/* we can't represent \u0000 in a C string, skip it */
+	if (cp)
+		ni_json_utf8_encode(res, cp);
 	return TRUE;
 }
 
@@ -1295,37 +1503,46 @@ ni_json_string_unescape_map(unsigned char ec)
 static ni_bool_t
 ni_json_reader_get_qstring(ni_json_reader_t *jr, ni_stringbuf_t *res)
 {
-	ni_bool_t escaped = FALSE;
+	const unsigned char *run;
 	const char *us;
+	size_t len;
 	int cc;
 
-	while ((cc = ni_buffer_getc(jr->inbuf)) != EOF) {
-		if (escaped) {
-			if (cc == 'u') {
-#if 0
-				if (!ni_json_reader_open_iconv(jr))
-					return FALSE;	/* decoder failed */
-#endif
+	while (jr->pos < jr->end) {
+		/* copy runs of plain ascii at once */
+		run = jr->pos;
+		while (jr->pos < jr->end && *jr->pos < 0x80 &&
+				*jr->pos != '"' && *jr->pos != '\\')
+			jr->pos++;
+		if (jr->pos > run)
+			ni_stringbuf_put(res, (const char *)run, jr->pos - run);
+
+		switch ((cc = ni_json_reader_getc(jr))) {
+		case EOF:
+			return FALSE; /* unterminated quoted string */
+
+		case '"':
+			return TRUE; /* OK, end of quoted string */
+
+		case '\\':
+			if ((cc = ni_json_reader_getc(jr)) == 'u') {
 				if (!ni_json_reader_get_eunicode(jr, res))
 					return FALSE;	/* decoding error */
 			} else {
-				if (!(us = ni_json_string_unescape_map(cc)))
+				if (cc == EOF || !(us = ni_json_string_unescape_map(cc)))
 					return FALSE;	/* unknown escape */
 
 				ni_stringbuf_puts(res, us);
 			}
-			escaped = FALSE;
-		} else {
-			switch (cc) {
-			case '"':
-				return TRUE; /* OK, end of quoted string */
-			case '\\':
-				escaped = TRUE;
-				break;
-			default:
-				ni_stringbuf_putc(res, cc);
-				break;
-			}
+			break;
+
+		default:
+			if (!(len = ni_json_utf8_sequence(jr->pos - 1, jr->end)))
+				return FALSE;	/* invalid utf-8 */
+
+			ni_stringbuf_put(res, (const char *)jr->pos - 1, len);
+			jr->pos += len - 1;
+			break;
 		}
 	}
 	return FALSE; /* unterminated quoted string */
@@ -1336,7 +1553,8 @@ ni_json_get_token(ni_json_reader_t *jr, ni_stringbuf_t *res)
 {
 	int cc;
 
-	if ((cc = ni_buffer_getc(jr->inbuf)) == EOF)
+	ni_stringbuf_truncate(res, 0);
+	if ((cc = ni_json_reader_getc(jr)) == EOF)
 		return EndOfFile;
 
 	switch (cc) {
@@ -1361,13 +1579,13 @@ ni_json_get_token(ni_json_reader_t *jr, ni_stringbuf_t *res)
 	case 'n':
 	case 't':
 	case 'f':
-		ni_stringbuf_putc(res, cc);
+		jr->pos--;
 		ni_json_reader_get_literal(jr, res);
 		return Literal;
 
 	default:
 		if (isdigit(cc) || cc == '-') {
-			ni_stringbuf_putc(res, cc);
+			jr->pos--;
 			ni_json_reader_get_number(jr, res);
 			return Number;
 		}
@@ -1446,7 +1664,7 @@ ni_json_reader_process_object_add(ni_json_reader_t *jr)
 	if (!value)
 		ni_json_reader_set_error(jr, "object pair without value");
 	else
-	if (!ni_json_object_set(parent, name, value)) {
+	if (!ni_json_object_set_take(parent, &jr->stack->name, value)) {
 		ni_json_free(value);
 		ni_json_reader_set_error(jr, "unable to add member to object");
 	}
@@ -1465,7 +1683,7 @@ ni_json_reader_process_object_end(ni_json_reader_t *jr)
 	if (name && !value)
 		ni_json_reader_set_error(jr, "unexpected object end");
 	else
-	if (name && value && !ni_json_object_set(parent, name, value)) {
+	if (name && value && !ni_json_object_set_take(parent, &jr->stack->name, value)) {
 		ni_json_free(value);
 		ni_json_reader_set_error(jr, "unable to add member to object");
 	}
@@ -1511,11 +1729,10 @@ ni_json_reader_process_string_value(ni_json_reader_t *jr, const char *string)
 static void
 ni_json_reader_parse_array(ni_json_reader_t *jr)
 {
-	ni_stringbuf_t tokenValue = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_json_token_type_t token;
 
 	ni_json_reader_skip_spaces(jr);
-	token = ni_json_get_token(jr, &tokenValue);
+	token = ni_json_get_token(jr, &jr->token);
 
 	switch (token) {
 	case ArrayBegin:
@@ -1541,21 +1758,21 @@ ni_json_reader_parse_array(ni_json_reader_t *jr)
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed array element separator");
 		else
-			ni_json_reader_process_literal_value(jr, tokenValue.string);
+			ni_json_reader_process_literal_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case Number:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed array element separator");
 		else
-			ni_json_reader_process_number_value(jr, tokenValue.string);
+			ni_json_reader_process_number_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case String:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed array element separator");
 		else
-			ni_json_reader_process_string_value(jr, tokenValue.string);
+			ni_json_reader_process_string_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case EndOfFile:
@@ -1566,19 +1783,17 @@ ni_json_reader_parse_array(ni_json_reader_t *jr)
 		ni_json_reader_set_error(jr, "unexpected array token");
 		break;
 	}
-	ni_stringbuf_clear(&tokenValue);
 }
 
 static void
 ni_json_reader_parse_object(ni_json_reader_t *jr)
 {
-	ni_stringbuf_t tokenValue = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_json_token_type_t token;
 	ni_json_t *value;
 	const char *name;
 
 	ni_json_reader_skip_spaces(jr);
-	token = ni_json_get_token(jr, &tokenValue);
+	token = ni_json_get_token(jr, &jr->token);
 
 	switch (token) {
 	case ObjectEnd:
@@ -1593,7 +1808,7 @@ ni_json_reader_parse_object(ni_json_reader_t *jr)
 		if ((value = ni_json_reader_get_current(jr)))
 			ni_json_reader_set_error(jr, "unexpected object pair value");
 		else
-			ni_json_reader_set_pair_name(jr, tokenValue.string);
+			ni_json_reader_set_pair_name(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case Colon:
@@ -1611,17 +1826,15 @@ ni_json_reader_parse_object(ni_json_reader_t *jr)
 		ni_json_reader_set_error(jr, "unexpected object token");
 		break;
 	}
-	ni_stringbuf_clear(&tokenValue);
 }
 
 static void
 ni_json_reader_parse_pair(ni_json_reader_t *jr)
 {
-	ni_stringbuf_t tokenValue = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_json_token_type_t token;
 
 	ni_json_reader_skip_spaces(jr);
-	token = ni_json_get_token(jr, &tokenValue);
+	token = ni_json_get_token(jr, &jr->token);
 
 	switch (token) {
 	case ArrayBegin:
@@ -1644,21 +1857,21 @@ ni_json_reader_parse_pair(ni_json_reader_t *jr)
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed object member separator or end");
 		else
-			ni_json_reader_process_literal_value(jr, tokenValue.string);
+			ni_json_reader_process_literal_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case Number:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed object member separator or end");
 		else
-			ni_json_reader_process_number_value(jr, tokenValue.string);
+			ni_json_reader_process_number_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case String:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "missed object memmer separator or end");
 		else
-			ni_json_reader_process_string_value(jr, tokenValue.string);
+			ni_json_reader_process_string_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case EndOfFile:
@@ -1674,11 +1887,10 @@ ni_json_reader_parse_pair(ni_json_reader_t *jr)
 static void
 ni_json_reader_parse_initial(ni_json_reader_t *jr)
 {
-	ni_stringbuf_t tokenValue = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_json_token_type_t token;
 
 	ni_json_reader_skip_spaces(jr);
-	token = ni_json_get_token(jr, &tokenValue);
+	token = ni_json_get_token(jr, &jr->token);
 
 	switch (token) {
 	case ArrayBegin:
@@ -1693,21 +1905,21 @@ ni_json_reader_parse_initial(ni_json_reader_t *jr)
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "unexpected literal in scalar context");
 		else
-			ni_json_reader_process_literal_value(jr, tokenValue.string);
+			ni_json_reader_process_literal_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case Number:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "unexpected number in scalar context");
 		else
-			ni_json_reader_process_number_value(jr, tokenValue.string);
+			ni_json_reader_process_number_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case String:
 		if (ni_json_reader_get_current(jr))
 			ni_json_reader_set_error(jr, "unexpected string in scalar context");
 		else
-			ni_json_reader_process_string_value(jr, tokenValue.string);
+			ni_json_reader_process_string_value(jr, ni_json_reader_get_token(jr));
 		break;
 
 	case EndOfFile:
@@ -530,6 +530,60 @@ __ni_nl_dump_valid(struct nl_msg *msg, void *p)
 	return NL_OK;
 }
 
+static int
+__ni_nl_dump_recv(ni_netlink_t *nl, const char *name,
+		struct __ni_nl_dump_state *data, ni_bool_t verbose)
+{
+	struct nl_cb *cb;
+	int rv;
+
+	if (!(cb = __ni_nl_cb_clone(nl)))
+		return -NLE_NOMEM;
+
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, __ni_nl_dump_valid, data);
+
+retry:
+	rv = nl_recvmsgs(nl->nl_sock, cb);
+	switch (rv) {
+	case NLE_SUCCESS:
+		break;
+	case -NLE_AGAIN:
+		/* debug only, we retry to receive */
+		ni_debug_socket("%s: failed to receive response: %s",
+				name, nl_geterror(rv));
+		goto retry;
+	case -NLE_DUMP_INTR:
+		/* debug only, we repeat the query */
+		ni_debug_socket("%s: failed to receive response: %s",
+				name, nl_geterror(rv));
+		break;
+	default:
+		/* callers without verbose report errors as needed */
+		if (verbose) {
+			ni_error("%s: failed to receive response: %s",
+					name, nl_geterror(rv));
+		} else {
+			ni_debug_socket("%s: failed to receive response: %s",
+					name, nl_geterror(rv));
+		}
+		break;
+	}
+	nl_cb_put(cb);
+	return rv;
+}
+
+static struct {
+	ni_nl_dump_replay_fn_t *	func;
+	void *				user_data;
+} ni_nl_dump_replay;
+
+void
+ni_nl_dump_set_replay(ni_nl_dump_replay_fn_t *func, void *user_data)
+{
+	ni_nl_dump_replay.func = func;
+	ni_nl_dump_replay.user_data = user_data;
+}
+
 /*
  * Issue a DUMP request and store all replies in list
  */
@@ -541,10 +595,12 @@ ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list)
 		.msg_type = -1,
 		.list = list,
 	};
-	struct nl_cb *cb;
 	const char *name;
 	int rv;
 
+	if (ni_nl_dump_replay.func)
+		return ni_nl_dump_replay.func(af, type, list, ni_nl_dump_replay.user_data);
+
 	name = ni_rtnl_msg_type_to_name(type, __func__);
 	if (!__ni_global_netlink || !(nl_sock = __ni_global_netlink->nl_sock)) {
 		ni_error("%s: no netlink socket", name);
@@ -556,33 +612,34 @@ ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list)
 		return rv;
 	}
 
-	if (!(cb = __ni_nl_cb_clone(__ni_global_netlink)))
-		return -NLE_NOMEM;
+	return __ni_nl_dump_recv(__ni_global_netlink, name, &data, TRUE);
+}
 
-	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, __ni_nl_dump_valid, &data);
+/*
+ * Send a request on a netlink handle other than the global rtnl one,
+ * e.g. a generic netlink request, and store all replies in list.
+ * Works for dump requests, which aren't acknowledged by the kernel.
+ */
+int
+ni_nl_talk_store(ni_netlink_t *nl, struct nl_msg *msg, struct ni_nlmsg_list *list)
+{
+	struct __ni_nl_dump_state data = {
+		.msg_type = -1,
+		.list = list,
+	};
+	int rv;
 
-retry:
-	rv = nl_recvmsgs(nl_sock, cb);
-	switch (rv) {
-	case NLE_SUCCESS:
-		break;
-	case -NLE_AGAIN:
-		/* debug only, we retry to receive */
-		ni_debug_socket("%s: failed to receive response: %s",
-				name, nl_geterror(rv));
-		goto retry;
-	case -NLE_DUMP_INTR:
-		/* debug only, we repeat the query */
-		ni_debug_socket("%s: failed to receive response: %s",
-				name, nl_geterror(rv));
-		break;
-	default:
-		ni_error("%s: failed to receive response: %s",
-				name, nl_geterror(rv));
-		break;
+	if (!nl || !nl->nl_sock) {
+		ni_error("%s: no netlink socket", __func__);
+		return -NLE_BAD_SOCK;
 	}
-	nl_cb_put(cb);
-	return rv;
+
+	if ((rv = nl_send_auto(nl->nl_sock, msg)) < 0) {
+		ni_error("%s: unable to send: %s", __func__, nl_geterror(rv));
+		return rv;
+	}
+
+	return __ni_nl_dump_recv(nl, __func__, &data, FALSE);
 }
 
 /*
@@ -74,9 +74,18 @@ struct ni_nlmsg_list {
 
 extern int	ni_nl_talk(struct nl_msg *, struct ni_nlmsg_list *);
 extern int	ni_nl_dump_store(int af, int type, struct ni_nlmsg_list *list);
+extern int	ni_nl_talk_store(struct __ni_netlink *, struct nl_msg *, struct ni_nlmsg_list *);
+
+/*
+ * Replaces the kernel as the source of ni_nl_dump_store() replies,
+ * e.g. to feed recorded dumps through the refresh code.
+ */
+typedef int	ni_nl_dump_replay_fn_t(int af, int type, struct ni_nlmsg_list *, void *);
+extern void	ni_nl_dump_set_replay(ni_nl_dump_replay_fn_t *, void *);
 
 extern void	ni_nlmsg_list_init(struct ni_nlmsg_list *);
 extern void	ni_nlmsg_list_destroy(struct ni_nlmsg_list *);
+extern struct nlmsghdr *ni_nlmsg_list_append(struct ni_nlmsg_list *, struct nlmsghdr *);
 
 extern const char *	ni_rtnl_msg_type_to_name(unsigned int, const char *);
 
@@ -133,6 +142,9 @@ extern int	ni_rtnl_rule_parse_msg(struct nlmsghdr *, struct fib_rule_hdr *, ni_r
 extern int	__ni_rtnl_parse_newaddr(unsigned, struct nlmsghdr *, struct ifaddrmsg *, ni_address_t *);
 extern int	__ni_rtnl_parse_newprefix(const char *, struct nlmsghdr *, struct prefixmsg *, ni_ipv6_ra_pinfo_t *);
 
+extern int	ni_ethtool_nl_reply_ref(struct nlmsghdr *, ni_netdev_ref_t *);
+extern int	ni_ethtool_nl_parse_reply(const ni_netdev_ref_t *, ni_ethtool_t *, struct nlmsghdr *);
+
 extern int	__ni_netdev_process_newlink(ni_netdev_t *, struct nlmsghdr *, struct ifinfomsg *, ni_netconfig_t *);
 extern int	__ni_netdev_process_newlink_ipv6(ni_netdev_t *, struct nlmsghdr *, struct ifinfomsg *);
 extern int	__ni_netdev_process_newprefix(ni_netdev_t *, struct nlmsghdr *, struct prefixmsg *);
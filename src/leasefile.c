@@ -33,6 +33,7 @@
 #include <limits.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 
 #include <wicked/netinfo.h>
@@ -43,6 +44,7 @@
 #include <wicked/route.h>
 #include <wicked/logging.h>
 #include <wicked/xml.h>
+#include <wicked/socket.h>
 
 #include "appconfig.h"
 #include "leasefile.h"
@@ -429,6 +431,8 @@ ni_addrconf_lease_opts_data_unknown_to_xml(const ni_dhcp_option_t *opt)
 		xml_node_new_element("data", node, hstr);
 	}
 
+	ni_string_free(&hstr);
+	ni_string_free(&name);
 	return node;
 
 failure:
@@ -1245,32 +1249,363 @@ static const char *		__ni_addrconf_lease_file_path(char **,
 static void			__ni_addrconf_lease_file_remove(
 				const char *, const char *, int, int);
 
+/*
+ * Lease file write-back.
+ *
+ * A lease is formatted immediately, but written after the configured
+ * addrconf lease-write-delay only, so multiple updates of the same
+ * lease within this window are coalesced into one write.
+ *
+ * All pending leases are written in one batch: the data of all
+ * temporary files is synced first (one syncfs per file system or a
+ * fsync per file), then they're renamed over the lease files and the
+ * directories are synced once. The rename happens after the data is
+ * on disk only, so either the previous or the new lease survives a
+ * crash or power loss.
+ */
+typedef struct ni_addrconf_lease_file_wb ni_addrconf_lease_file_wb_t;
+
+struct ni_addrconf_lease_file_wb {
+	ni_addrconf_lease_file_wb_t *	next;
+
+	char *				ifname;
+	int				type;
+	int				family;
+	char *				data;
+
+	char *				filename;
+	char				tempname[PATH_MAX];
+	ni_bool_t			fallback;
+	int				fd;
+};
+
+static struct {
+	ni_addrconf_lease_file_wb_t *	pending;
+	const ni_timer_t *		timer;
+	ni_bool_t			atexit;
+} ni_addrconf_lease_file_wb;
+
+static void
+ni_addrconf_lease_file_wb_free(ni_addrconf_lease_file_wb_t *wb)
+{
+	if (wb) {
+		if (wb->fd >= 0)
+			close(wb->fd);
+		if (wb->tempname[0])
+			unlink(wb->tempname);
+		ni_string_free(&wb->ifname);
+		ni_string_free(&wb->data);
+		ni_string_free(&wb->filename);
+		free(wb);
+	}
+}
+
+static ni_addrconf_lease_file_wb_t *
+ni_addrconf_lease_file_wb_new(const char *ifname, int type, int family, char *data)
+{
+	ni_addrconf_lease_file_wb_t *wb;
+
+	if (!(wb = calloc(1, sizeof(*wb))))
+		return NULL;
+
+	wb->fd = -1;
+	wb->type = type;
+	wb->family = family;
+	wb->data = data;
+	if (!ni_string_dup(&wb->ifname, ifname)) {
+		wb->data = NULL;
+		ni_addrconf_lease_file_wb_free(wb);
+		return NULL;
+	}
+	return wb;
+}
+
+static ni_addrconf_lease_file_wb_t **
+ni_addrconf_lease_file_wb_find(const char *ifname, int type, int family)
+{
+	ni_addrconf_lease_file_wb_t **pos, *wb;
+
+	for (pos = &ni_addrconf_lease_file_wb.pending; (wb = *pos); pos = &wb->next) {
+		if (wb->type == type && wb->family == family &&
+		    ni_string_eq(wb->ifname, ifname))
+			return pos;
+	}
+	return NULL;
+}
+
+static ni_bool_t
+ni_addrconf_lease_file_wb_cancel(const char *ifname, int type, int family)
+{
+	ni_addrconf_lease_file_wb_t **pos, *wb;
+
+	if (!(pos = ni_addrconf_lease_file_wb_find(ifname, type, family)))
+		return FALSE;
+
+	wb = *pos;
+	*pos = wb->next;
+	ni_debug_dhcp("Discarded pending %s:%s lease write of %s",
+			ni_addrfamily_type_to_name(family),
+			ni_addrconf_type_to_name(type), ifname);
+	ni_addrconf_lease_file_wb_free(wb);
+
+	if (!ni_addrconf_lease_file_wb.pending && ni_addrconf_lease_file_wb.timer) {
+		ni_timer_cancel(ni_addrconf_lease_file_wb.timer);
+		ni_addrconf_lease_file_wb.timer = NULL;
+	}
+	return TRUE;
+}
+
+/*
+ * Create the temporary file and write the lease data into it.
+ */
+static int
+ni_addrconf_lease_file_wb_prepare(ni_addrconf_lease_file_wb_t *wb)
+{
+	size_t len, off;
+	ssize_t n;
+
+	if (!__ni_addrconf_lease_file_path(&wb->filename, ni_config_storedir(),
+					wb->ifname, wb->type, wb->family)) {
+		ni_error("Cannot construct lease file name: %m");
+		return -1;
+	}
+
+	snprintf(wb->tempname, sizeof(wb->tempname), "%s.XXXXXX", wb->filename);
+	if ((wb->fd = mkstemp(wb->tempname)) < 0) {
+		if (errno == EROFS && __ni_addrconf_lease_file_path(&wb->filename,
+						ni_config_statedir(), wb->ifname,
+						wb->type, wb->family)) {
+			ni_debug_dhcp("Read-only filesystem, try fallback to %s",
+					wb->filename);
+			snprintf(wb->tempname, sizeof(wb->tempname), "%s.XXXXXX",
+					wb->filename);
+			wb->fd = mkstemp(wb->tempname);
+			wb->fallback = TRUE;
+		}
+		if (wb->fd < 0) {
+			ni_error("Cannot create temporary lease file '%s': %m",
+					wb->tempname);
+			wb->tempname[0] = '\0';
+			return -1;
+		}
+	}
+	fcntl(wb->fd, F_SETFD, FD_CLOEXEC);
+
+	ni_debug_dhcp("Writing lease to temporary file for '%s'", wb->filename);
+	len = ni_string_len(wb->data);
+	for (off = 0; off < len; off += n) {
+		n = write(wb->fd, wb->data + off, len - off);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n <= 0) {
+			ni_error("Cannot write temporary lease file '%s': %m",
+					wb->tempname);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static ni_bool_t
+ni_addrconf_lease_file_sync_dir(const char *dirname)
+{
+	int fd;
+
+	if ((fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0 || fsync(fd) < 0) {
+		ni_error("Unable to sync lease directory '%s': %m", dirname);
+		if (fd >= 0)
+			close(fd);
+		return FALSE;
+	}
+	close(fd);
+	return TRUE;
+}
+
+/*
+ * Write the leases in the list in one batch, returns the number of
+ * failed lease writes.
+ */
+static unsigned int
+ni_addrconf_lease_file_wb_commit(ni_addrconf_lease_file_wb_t *list)
+{
+	ni_addrconf_lease_file_wb_t *wb;
+	ni_bool_t dirs[2] = { FALSE, FALSE };
+	ni_bool_t synced[2] = { FALSE, FALSE };
+	int sync_fd[2] = { -1, -1 };
+	unsigned int failed = 0;
+
+	/* 1. write the data into temporary files */
+	for (wb = list; wb; wb = wb->next) {
+		if (ni_addrconf_lease_file_wb_prepare(wb) < 0) {
+			if (wb->fd >= 0)
+				close(wb->fd);
+			wb->fd = -1;
+			continue;
+		}
+		sync_fd[wb->fallback] = wb->fd;
+	}
+
+	/* 2. sync the data before the files get renamed */
+#ifdef HAVE_SYNCFS
+	if (list->next) {
+		unsigned int i;
+
+		/* more than one file: sync each file system once */
+		for (i = 0; i < 2; ++i) {
+			if (sync_fd[i] >= 0 && syncfs(sync_fd[i]) == 0)
+				synced[i] = TRUE;
+		}
+	}
+#endif
+	for (wb = list; wb; wb = wb->next) {
+		if (wb->fd < 0 || synced[wb->fallback])
+			continue;
+
+		if (fsync(wb->fd) < 0) {
+			ni_error("Unable to sync temporary lease file '%s': %m",
+					wb->tempname);
+			close(wb->fd);
+			wb->fd = -1;
+		}
+	}
+
+	/* 3. replace the lease files */
+	for (wb = list; wb; wb = wb->next) {
+		if (wb->fd < 0) {
+			failed++;
+			continue;
+		}
+		close(wb->fd);
+		wb->fd = -1;
+
+		if (rename(wb->tempname, wb->filename) != 0) {
+			ni_error("Unable to rename temporary lease file '%s' to '%s': %m",
+					wb->tempname, wb->filename);
+			failed++;
+			continue;
+		}
+		wb->tempname[0] = '\0';
+		dirs[wb->fallback] = TRUE;
+
+		if (!wb->fallback) {
+			__ni_addrconf_lease_file_remove(ni_config_statedir(),
+					wb->ifname, wb->type, wb->family);
+		}
+		ni_debug_dhcp("Lease written to file '%s'", wb->filename);
+	}
+
+	/* 4. sync the directory entries once */
+	if (dirs[0])
+		ni_addrconf_lease_file_sync_dir(ni_config_storedir());
+	if (dirs[1])
+		ni_addrconf_lease_file_sync_dir(ni_config_statedir());
+
+	return failed;
+}
+
+/*
+ * Write all pending leases now.
+ */
+int
+ni_addrconf_lease_file_flush(void)
+{
+	ni_addrconf_lease_file_wb_t *list, *wb;
+	unsigned int failed;
+
+	if (ni_addrconf_lease_file_wb.timer) {
+		ni_timer_cancel(ni_addrconf_lease_file_wb.timer);
+		ni_addrconf_lease_file_wb.timer = NULL;
+	}
+
+	if (!(list = ni_addrconf_lease_file_wb.pending))
+		return 0;
+	ni_addrconf_lease_file_wb.pending = NULL;
+
+	failed = ni_addrconf_lease_file_wb_commit(list);
+	while ((wb = list)) {
+		list = wb->next;
+		ni_addrconf_lease_file_wb_free(wb);
+	}
+	return failed ? -1 : 0;
+}
+
+static void
+ni_addrconf_lease_file_wb_timeout(void *user_data, const ni_timer_t *timer)
+{
+	if (ni_addrconf_lease_file_wb.timer != timer)
+		return;
+
+	ni_addrconf_lease_file_wb.timer = NULL;
+	ni_addrconf_lease_file_flush();
+}
+
+static void
+ni_addrconf_lease_file_wb_atexit(void)
+{
+	/* don't touch the timer list while exiting */
+	ni_addrconf_lease_file_wb.timer = NULL;
+	ni_addrconf_lease_file_flush();
+}
+
+static int
+ni_addrconf_lease_file_wb_queue(const char *ifname, int type, int family,
+				char *data, unsigned int delay)
+{
+	ni_addrconf_lease_file_wb_t **pos, *wb;
+
+	if ((pos = ni_addrconf_lease_file_wb_find(ifname, type, family))) {
+		wb = *pos;
+		ni_string_free(&wb->data);
+		wb->data = data;
+		ni_debug_dhcp("Coalesced pending %s:%s lease write of %s",
+				ni_addrfamily_type_to_name(family),
+				ni_addrconf_type_to_name(type), ifname);
+		return 0;
+	}
+
+	if (!(wb = ni_addrconf_lease_file_wb_new(ifname, type, family, data))) {
+		ni_string_free(&data);
+		return -1;
+	}
+
+	/* keep the order, first queued is written first */
+	for (pos = &ni_addrconf_lease_file_wb.pending; *pos; pos = &(*pos)->next)
+		;
+	*pos = wb;
+
+	if (!ni_addrconf_lease_file_wb.atexit) {
+		ni_addrconf_lease_file_wb.atexit = TRUE;
+		atexit(ni_addrconf_lease_file_wb_atexit);
+	}
+	if (!ni_addrconf_lease_file_wb.timer) {
+		ni_addrconf_lease_file_wb.timer = ni_timer_register(delay,
+				ni_addrconf_lease_file_wb_timeout, NULL);
+	}
+	return 0;
+}
+
 /*
  * Write a lease to a file
  */
 int
 ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 {
-	char tempname[PATH_MAX] = {'\0'};
-	ni_bool_t fallback = FALSE;
-	char *filename = NULL;
+	ni_addrconf_lease_file_wb_t *wb;
 	xml_node_t *xml = NULL;
-	FILE *fp = NULL;
-	int ret = -1;
-	int fd;
+	unsigned int delay;
+	char *data;
+	int ret;
 
 	if (lease->state == NI_ADDRCONF_STATE_RELEASED) {
 		ni_addrconf_lease_file_remove(ifname, lease->type, lease->family);
 		return 0;
 	}
 
-	if (!__ni_addrconf_lease_file_path(&filename, ni_config_storedir(),
-					ifname, lease->type, lease->family)) {
-		ni_error("Cannot construct lease file name: %m");
-		return -1;
-	}
-
-	ni_debug_dhcp("Preparing xml lease data for '%s'", filename);
+	ni_debug_dhcp("Preparing xml lease data for %s:%s lease of %s",
+			ni_addrfamily_type_to_name(lease->family),
+			ni_addrconf_type_to_name(lease->type), ifname);
 	if ((ret = ni_addrconf_lease_to_xml(lease, &xml, ifname)) != 0) {
 		if (ret > 0) {
 			ni_debug_dhcp("Skipped, %s:%s leases are disabled",
@@ -1281,62 +1616,32 @@ ni_addrconf_lease_file_write(const char *ifname, ni_addrconf_lease_t *lease)
 					ni_addrfamily_type_to_name(lease->family),
 					ni_addrconf_type_to_name(lease->type));
 		}
-		goto failed;
-	}
-
-	snprintf(tempname, sizeof(tempname), "%s.XXXXXX", filename);
-	if ((fd = mkstemp(tempname)) < 0) {
-		if (errno == EROFS && __ni_addrconf_lease_file_path(&filename,
-						ni_config_statedir(), ifname,
-						lease->type, lease->family)) {
-			ni_debug_dhcp("Read-only filesystem, try fallback to %s",
-					filename);
-			snprintf(tempname, sizeof(tempname), "%s.XXXXXX", filename);
-			fd = mkstemp(tempname);
-			fallback = TRUE;
-		}
-		if (fd < 0) {
-			ni_error("Cannot create temporary lease file '%s': %m",
-					tempname);
-			tempname[0] = '\0';
-			ret = -1;
-			goto failed;
-		}
-	}
-	if ((fp = fdopen(fd, "we")) == NULL) {
-		ret = -1;
-		close(fd);
-		ni_error("Cannot reopen temporary lease file '%s': %m", tempname);
-		goto failed;
+		return -1;
 	}
 
-	ni_debug_dhcp("Writing lease to temporary file for '%s'", filename);
-	xml_node_print(xml, fp);
-	fclose(fp);
+	data = xml_node_sprint(xml);
 	xml_node_free(xml);
-
-	if ((ret = rename(tempname, filename)) != 0) {
-		ni_error("Unable to rename temporary lease file '%s' to '%s': %m",
-				tempname, filename);
-		goto failed;
-	} else if (!fallback) {
-		__ni_addrconf_lease_file_remove(ni_config_statedir(),
-				ifname, lease->type, lease->family);
+	if (!data) {
+		ni_error("Unable to format %s:%s lease as XML",
+				ni_addrfamily_type_to_name(lease->family),
+				ni_addrconf_type_to_name(lease->type));
+		return -1;
 	}
 
-	ni_debug_dhcp("Lease written to file '%s'", filename);
-	ni_string_free(&filename);
-	return 0;
+	if ((delay = ni_config_addrconf_lease_write_delay()))
+		return ni_addrconf_lease_file_wb_queue(ifname, lease->type,
+						lease->family, data, delay);
 
-failed:
-	if (fp)
-		fclose(fp);
-	if (xml)
-		xml_node_free(xml);
-	if (tempname[0])
-		unlink(tempname);
-	ni_string_free(&filename);
-	return -1;
+	/* no write-back delay: drop a pending write-back of this lease
+	 * (which this one supersedes) and write this lease out now */
+	if (!(wb = ni_addrconf_lease_file_wb_new(ifname, lease->type, lease->family, data))) {
+		ni_string_free(&data);
+		return -1;
+	}
+	ni_addrconf_lease_file_wb_cancel(ifname, lease->type, lease->family);
+	ret = ni_addrconf_lease_file_wb_commit(wb) ? -1 : 0;
+	ni_addrconf_lease_file_wb_free(wb);
+	return ret;
 }
 
 /*
@@ -1350,6 +1655,8 @@ ni_addrconf_lease_file_read(const char *ifname, int type, int family)
 	char *filename = NULL;
 	FILE *fp;
 
+	ni_addrconf_lease_file_flush();
+
 	if (!__ni_addrconf_lease_file_path(&filename,
 				ni_config_statedir(),
 				ifname, type, family)) {
@@ -1428,6 +1735,7 @@ __ni_addrconf_lease_file_remove(const char *dir, const char *ifname,
 void
 ni_addrconf_lease_file_remove(const char *ifname, int type, int family)
 {
+	ni_addrconf_lease_file_wb_cancel(ifname, type, family);
 	__ni_addrconf_lease_file_remove(ni_config_statedir(), ifname, type, family);
 	__ni_addrconf_lease_file_remove(ni_config_storedir(), ifname, type, family);
 }
@@ -1449,6 +1757,9 @@ ni_addrconf_lease_file_exists(const char *ifname, int type, int family)
 {
 	char *filename = NULL;
 
+	if (ni_addrconf_lease_file_wb_find(ifname, type, family))
+		return TRUE;
+
 	if (__ni_addrconf_lease_file_path(&filename, ni_config_statedir(), ifname, type, family)) {
 		if (ni_file_exists(filename)) {
 			ni_string_free(&filename);
@@ -8,6 +8,7 @@
 #endif
 
 #include <stdarg.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +20,7 @@
 #include <wicked/logging.h>
 #include <wicked/util.h>
 #include "util_priv.h"
+#include "trace-ring.h"
 
 #define NI_LOG_PID	(1 << 0)
 #define NI_LOG_TIME	(1 << 1)
@@ -169,8 +171,8 @@ ni_debug_facility_to_description(unsigned int facility)
 	return ni_format_uint_mapped(facility, __debug_flags_descriptions);
 }
 
-static int
-__ni_enable_debug(const char *fac)
+int
+ni_debug_parse_facilities(const char *fac, unsigned int *facilities)
 {
 	unsigned int _debug = 0;
 	char *copy, *s;
@@ -197,14 +199,25 @@ __ni_enable_debug(const char *fac)
 	}
 
 	free(copy);
-	if (rv == 0) {
-		ni_debug = _debug;
-		if (ni_log_level < NI_LOG_DEBUG)
-			__ni_log_level_set(NI_LOG_DEBUG);
-	}
+	if (rv == 0 && facilities)
+		*facilities = _debug;
 	return rv;
 }
 
+static int
+__ni_enable_debug(const char *fac)
+{
+	unsigned int _debug = 0;
+
+	if (ni_debug_parse_facilities(fac, &_debug) < 0)
+		return -1;
+
+	ni_debug = _debug;
+	if (ni_log_level < NI_LOG_DEBUG)
+		__ni_log_level_set(NI_LOG_DEBUG);
+	return 0;
+}
+
 int
 ni_enable_debug(const char *fac)
 {
@@ -284,17 +297,29 @@ __ni_log_level_set(unsigned int level)
 }
 
 ni_bool_t
-ni_log_level_set(const char *name)
+ni_log_level_parse(const char *name, unsigned int *level)
 {
 	unsigned int lvl;
 
-	if (!name)
+	if (!name || !level)
 		return FALSE;
 
 	/* accept only log level numbers for valid levels */
 	if (ni_parse_uint_maybe_mapped(name, __log_level_names, &lvl, 0) != 0)
 		return FALSE;
 
+	*level = lvl;
+	return TRUE;
+}
+
+ni_bool_t
+ni_log_level_set(const char *name)
+{
+	unsigned int lvl;
+
+	if (!ni_log_level_parse(name, &lvl))
+		return FALSE;
+
 	if (lvl >= NI_LOG_DEBUG && !ni_debug)
 		ni_debug = NI_TRACE_MINI;
 
@@ -591,6 +616,16 @@ ni_error_extra(const char *fmt, ...)
 	va_end(ap);
 }
 
+static inline void
+__ni_vtrace(const char *fmt, va_list ap)
+{
+	if (!ni_log_syslog) {
+		__ni_log_stderr("::: ", fmt, ap, "");
+	} else {
+		vsyslog(LOG_DEBUG, fmt, ap);
+	}
+}
+
 void
 ni_trace(const char *fmt, ...)
 {
@@ -600,14 +635,36 @@ ni_trace(const char *fmt, ...)
 		return;
 
 	va_start(ap, fmt);
-	if (!ni_log_syslog) {
-		__ni_log_stderr("::: ", fmt, ap, "");
-	} else {
-		vsyslog(LOG_DEBUG, fmt, ap);
-	}
+	__ni_vtrace(fmt, ap);
 	va_end(ap);
 }
 
+/*
+ * Called by the debug macros when either the debug log or the
+ * trace ring wants the message. The ring records the arguments
+ * raw and leaves the formatting to the reader.
+ */
+void
+__ni_debug_event(unsigned int level, unsigned int facility, const char *fmt, ...)
+{
+	int saved_errno = errno;
+	va_list ap;
+
+	if (ni_trace_ring_guard(level, facility)) {
+		va_start(ap, fmt);
+		ni_trace_ring_record(level, facility, saved_errno, fmt, ap);
+		va_end(ap);
+	}
+
+	if (ni_debug_guard(level, facility)) {
+		errno = saved_errno;
+		va_start(ap, fmt);
+		__ni_vtrace(fmt, ap);
+		va_end(ap);
+	}
+	errno = saved_errno;
+}
+
 void
 ni_fatal(const char *fmt, ...)
 {
@@ -0,0 +1,116 @@
+/*
+ * Memory accounting of the long-lived library objects.
+ *
+ * The per-tag counters are updated inline by the constructors and
+ * destructors; this file names the tags, reads the process heap usage
+ * and keeps the ring of periodic samples.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include "memstat.h"
+#include "appconfig.h"
+
+ni_memstat_t			ni_memstat_tags[NI_MEMSTAT_TAGS];
+
+static ni_memstat_sample_t *	ni_memstat_ring;
+static unsigned int		ni_memstat_ring_size;
+static unsigned int		ni_memstat_ring_count;
+static time_t			ni_memstat_next;
+static ni_bool_t		ni_memstat_disabled;
+
+const char *
+ni_memstat_tag_name(ni_memstat_tag_t tag)
+{
+	static const char *	names[NI_MEMSTAT_TAGS] = {
+		[NI_MEMSTAT_NETDEV]		= "netdev",
+		[NI_MEMSTAT_ROUTE]		= "route",
+		[NI_MEMSTAT_XML]		= "xml",
+		[NI_MEMSTAT_DBUS_VARIANT]	= "dbus-variant",
+		[NI_MEMSTAT_LEASE]		= "lease",
+		[NI_MEMSTAT_FSM_WORKER]		= "fsm-worker",
+		[NI_MEMSTAT_TIMER]		= "timer",
+	};
+
+	return (unsigned int)tag < NI_MEMSTAT_TAGS ? names[tag] : NULL;
+}
+
+void
+ni_memstat_heap(ni_memstat_heap_t *heap)
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 mi = mallinfo2();
+#else
+	struct mallinfo mi = mallinfo();
+#endif
+
+	heap->arena  = (uint64_t)mi.arena;
+	heap->mmap   = (uint64_t)mi.hblkhd;
+	heap->in_use = (uint64_t)mi.uordblks + (uint64_t)mi.hblkhd;
+}
+
+static void
+ni_memstat_take_sample(void)
+{
+	ni_memstat_sample_t *sample;
+	unsigned int i;
+
+	sample = &ni_memstat_ring[ni_memstat_ring_count++ % ni_memstat_ring_size];
+	sample->time = time(NULL);
+	ni_memstat_heap(&sample->heap);
+	for (i = 0; i < NI_MEMSTAT_TAGS; ++i) {
+		sample->objects[i] = ni_memstat_tags[i].objects;
+		sample->bytes[i] = ni_memstat_tags[i].bytes;
+	}
+}
+
+/*
+ * Called with the monotonic time of each socket loop wakeup;
+ * takes a first sample at startup and then one per interval.
+ */
+void
+ni_memstat_tick(const struct timespec *now)
+{
+	const ni_config_memory_stats_t *conf;
+
+	if (ni_memstat_disabled || now->tv_sec < ni_memstat_next)
+		return;
+
+	if (!ni_memstat_ring) {
+		conf = ni_config_memory_stats();
+		if (!conf->interval || !conf->samples ||
+		    !(ni_memstat_ring = calloc(conf->samples, sizeof(*ni_memstat_ring)))) {
+			ni_memstat_disabled = TRUE;
+			return;
+		}
+		ni_memstat_ring_size = conf->samples;
+	}
+
+	ni_memstat_take_sample();
+	ni_memstat_next = now->tv_sec + ni_config_memory_stats()->interval;
+}
+
+/*
+ * The retained samples, oldest first
+ */
+const ni_memstat_sample_t *
+ni_memstat_sample(unsigned int index)
+{
+	unsigned int count, first;
+
+	count = ni_memstat_ring_count < ni_memstat_ring_size ?
+		ni_memstat_ring_count : ni_memstat_ring_size;
+	if (index >= count)
+		return NULL;
+
+	first = ni_memstat_ring_count - count;
+	return &ni_memstat_ring[(first + index) % ni_memstat_ring_size];
+}
@@ -0,0 +1,87 @@
+/*
+ * Memory accounting of the long-lived library objects.
+ *
+ * The constructors and destructors of the objects below attribute
+ * their allocations to a subsystem tag: the number of live objects,
+ * their heap size as reported by malloc_usable_size and the number
+ * of allocations and frees. The bytes cover the object allocations
+ * themselves, not the strings and lists they own.
+ *
+ * From the socket loop, a sample of the tags and of the process heap
+ * is taken in the configured interval and kept in a ring, so a slow
+ * growth can be told from a one-time peak.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifndef __WICKED_MEMSTAT_H__
+#define __WICKED_MEMSTAT_H__
+
+#include <stdint.h>
+#include <malloc.h>
+#include <time.h>
+#include <wicked/types.h>
+
+typedef enum {
+	NI_MEMSTAT_NETDEV,
+	NI_MEMSTAT_ROUTE,
+	NI_MEMSTAT_XML,
+	NI_MEMSTAT_DBUS_VARIANT,
+	NI_MEMSTAT_LEASE,
+	NI_MEMSTAT_FSM_WORKER,
+	NI_MEMSTAT_TIMER,
+
+	NI_MEMSTAT_TAGS
+} ni_memstat_tag_t;
+
+typedef struct ni_memstat {
+	uint64_t		objects;
+	uint64_t		bytes;
+	uint64_t		allocs;
+	uint64_t		frees;
+} ni_memstat_t;
+
+typedef struct ni_memstat_heap {
+	uint64_t		arena;		/* sbrk'ed bytes	*/
+	uint64_t		mmap;		/* mmap'ed bytes	*/
+	uint64_t		in_use;		/* allocated bytes	*/
+} ni_memstat_heap_t;
+
+typedef struct ni_memstat_sample {
+	time_t			time;
+	ni_memstat_heap_t	heap;
+	uint64_t		objects[NI_MEMSTAT_TAGS];
+	uint64_t		bytes[NI_MEMSTAT_TAGS];
+} ni_memstat_sample_t;
+
+extern ni_memstat_t		ni_memstat_tags[NI_MEMSTAT_TAGS];
+
+extern const char *		ni_memstat_tag_name(ni_memstat_tag_t);
+extern void			ni_memstat_heap(ni_memstat_heap_t *);
+extern void			ni_memstat_tick(const struct timespec *);
+extern const ni_memstat_sample_t *ni_memstat_sample(unsigned int);
+
+static inline void
+ni_memstat_alloc(ni_memstat_tag_t tag, void *ptr)
+{
+	ni_memstat_t *stat = &ni_memstat_tags[tag];
+
+	if (ptr) {
+		stat->objects++;
+		stat->allocs++;
+		stat->bytes += malloc_usable_size(ptr);
+	}
+}
+
+static inline void
+ni_memstat_free(ni_memstat_tag_t tag, void *ptr)
+{
+	ni_memstat_t *stat = &ni_memstat_tags[tag];
+
+	if (ptr) {
+		stat->objects--;
+		stat->frees++;
+		stat->bytes -= malloc_usable_size(ptr);
+	}
+}
+
+#endif /* __WICKED_MEMSTAT_H__ */
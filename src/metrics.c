@@ -0,0 +1,159 @@
+/*
+ * Latency histograms and counters for the daemon hot paths.
+ *
+ * The metrics are created on first use and live until the process
+ * exits; they are found through a small hash table by name and kept
+ * in a list sorted by name for the export.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <wicked/util.h>
+#include "metrics.h"
+
+#define NI_METRICS_HASH_SIZE	127
+
+static ni_metric_t *		ni_metrics_hash[NI_METRICS_HASH_SIZE];
+static ni_metric_t *		ni_metrics;
+static time_t			ni_metrics_started;
+
+static unsigned int
+ni_metric_hash(const char *name)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+ni_metric_t *
+ni_metric_get(const char *name)
+{
+	ni_metric_t *metric, **pos;
+	unsigned int hash;
+
+	if (!name)
+		return NULL;
+
+	hash = ni_metric_hash(name);
+	for (metric = ni_metrics_hash[hash % NI_METRICS_HASH_SIZE]; metric; metric = metric->hnext) {
+		if (metric->hash == hash && !strcmp(metric->name, name))
+			return metric;
+	}
+
+	if (!(metric = calloc(1, sizeof(*metric))))
+		return NULL;
+	if (!ni_string_dup(&metric->name, name)) {
+		free(metric);
+		return NULL;
+	}
+	metric->hash = hash;
+	metric->hnext = ni_metrics_hash[hash % NI_METRICS_HASH_SIZE];
+	ni_metrics_hash[hash % NI_METRICS_HASH_SIZE] = metric;
+
+	for (pos = &ni_metrics; *pos; pos = &(*pos)->next) {
+		if (strcmp((*pos)->name, name) > 0)
+			break;
+	}
+	metric->next = *pos;
+	*pos = metric;
+
+	if (!ni_metrics_started)
+		ni_metrics_started = time(NULL);
+	return metric;
+}
+
+ni_metric_t *
+ni_metric_getf(const char *fmt, ...)
+{
+	char name[256];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(name, sizeof(name), fmt, ap);
+	va_end(ap);
+
+	if (len < 0 || (size_t)len >= sizeof(name))
+		return NULL;
+	return ni_metric_get(name);
+}
+
+void
+ni_metric_add(ni_metric_t *metric, uint64_t usec, ni_bool_t failed)
+{
+	unsigned int bucket = 0;
+
+	if (!metric)
+		return;
+
+	metric->count++;
+	if (failed)
+		metric->failed++;
+	metric->total += usec;
+	if (usec > metric->max)
+		metric->max = usec;
+
+	/* bucket i holds [2^(i-1), 2^i) usec, i.e. the bit width */
+	if (usec) {
+		bucket = 64 - __builtin_clzll(usec);
+		if (bucket >= NI_METRIC_BUCKETS)
+			bucket = NI_METRIC_BUCKETS - 1;
+	}
+	metric->buckets[bucket]++;
+}
+
+/*
+ * The exclusive upper bound of a bucket in usec as used in the export
+ */
+const char *
+ni_metric_bucket_name(unsigned int bucket)
+{
+	static const char *	names[NI_METRIC_BUCKETS] = {
+		"1",		"2",		"4",		"8",
+		"16",		"32",		"64",		"128",
+		"256",		"512",		"1024",		"2048",
+		"4096",		"8192",		"16384",	"32768",
+		"65536",	"131072",	"262144",	"524288",
+		"1048576",	"2097152",	"4194304",	"inf",
+	};
+
+	return bucket < NI_METRIC_BUCKETS ? names[bucket] : NULL;
+}
+
+const ni_metric_t *
+ni_metrics_list(void)
+{
+	return ni_metrics;
+}
+
+time_t
+ni_metrics_since(void)
+{
+	return ni_metrics_started;
+}
+
+void
+ni_metrics_reset(void)
+{
+	ni_metric_t *metric;
+
+	for (metric = ni_metrics; metric; metric = metric->next) {
+		metric->count = 0;
+		metric->failed = 0;
+		metric->total = 0;
+		metric->max = 0;
+		memset(metric->buckets, 0, sizeof(metric->buckets));
+	}
+	ni_metrics_started = time(NULL);
+}
@@ -0,0 +1,70 @@
+/*
+ * Latency histograms and counters for the daemon hot paths.
+ *
+ * Every metric counts the calls of one handler (a netlink message
+ * type, a D-Bus method, an fsm action, ...), the failed ones, the
+ * total and maximal time spent in it and a histogram of the call
+ * latencies in power of two microsecond buckets.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifndef __WICKED_METRICS_H__
+#define __WICKED_METRICS_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <wicked/types.h>
+
+/*
+ * Bucket 0 counts calls below 1us, bucket i calls in the range
+ * [2^(i-1), 2^i) us; the last one everything from about 4s on.
+ */
+#define NI_METRIC_BUCKETS	24
+
+typedef struct ni_metric	ni_metric_t;
+
+struct ni_metric {
+	ni_metric_t *		next;		/* sorted by name	*/
+	ni_metric_t *		hnext;		/* hash chain		*/
+	unsigned int		hash;
+	char *			name;
+
+	uint64_t		count;
+	uint64_t		failed;
+	uint64_t		total;		/* usec			*/
+	uint64_t		max;		/* usec			*/
+	uint64_t		buckets[NI_METRIC_BUCKETS];
+};
+
+extern ni_metric_t *		ni_metric_get(const char *);
+extern ni_metric_t *		ni_metric_getf(const char *, ...)
+					__attribute__ ((format (printf, 1, 2)));
+extern void			ni_metric_add(ni_metric_t *, uint64_t usec, ni_bool_t failed);
+extern const char *		ni_metric_bucket_name(unsigned int);
+
+extern const ni_metric_t *	ni_metrics_list(void);
+extern time_t			ni_metrics_since(void);
+extern void			ni_metrics_reset(void);
+
+static inline void
+ni_metric_start(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static inline void
+ni_metric_stop(ni_metric_t *metric, const struct timespec *start, ni_bool_t failed)
+{
+	struct timespec now;
+	int64_t usec;
+
+	if (!metric)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	usec = (int64_t)(now.tv_sec - start->tv_sec) * 1000000 +
+		(now.tv_nsec - start->tv_nsec) / 1000;
+	ni_metric_add(metric, usec > 0 ? usec : 0, failed);
+}
+
+#endif /* __WICKED_METRICS_H__ */
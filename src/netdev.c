@@ -39,6 +39,7 @@
 #include "netinfo_priv.h"
 #include "util_priv.h"
 #include "appconfig.h"
+#include "memstat.h"
 
 /*
  * Constructor for network interface.
@@ -52,6 +53,7 @@ ni_netdev_new(const char *name, unsigned int index)
 	dev = calloc(1, sizeof(*dev));
 	if (!dev)
 		return NULL;
+	ni_memstat_alloc(NI_MEMSTAT_NETDEV, dev);
 
 	dev->users = 1;
 	dev->link.type = NI_IFTYPE_UNKNOWN;
@@ -87,6 +89,10 @@ ni_netdev_slaveinfo_destroy(ni_slaveinfo_t *slave)
 	case NI_IFTYPE_BOND:
 		ni_bonding_slave_info_free(slave->bond);
 		break;
+	case NI_IFTYPE_BRIDGE:
+		if (slave->bridge)
+			ni_bridge_port_free(slave->bridge);
+		break;
 	default:
 		break;
 	}
@@ -139,6 +145,7 @@ ni_netdev_free(ni_netdev_t *dev)
 	ni_addrconf_lease_list_destroy(&dev->leases);
 
 	ni_string_free(&dev->name);
+	ni_memstat_free(NI_MEMSTAT_NETDEV, dev);
 	free(dev);
 }
 
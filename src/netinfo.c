@@ -33,6 +33,8 @@
 #include "modem-manager.h"
 #include "dhcp6/options.h"
 #include "dhcp.h"
+#include "netshare.h"
+#include "memstat.h"
 #include <gcrypt.h>
 
 extern void		ni_addrconf_updater_free(ni_addrconf_updater_t **);
@@ -399,9 +401,19 @@ ni_server_listen_other_events(void (*event_handler)(ni_event_t))
 	ni_global.other_event = event_handler;
 }
 
+/*
+ * When the peer-to-peer transport is enabled, the daemons listen on
+ * a private socket in addition to the bus and use the sockets of the
+ * other daemons for their own calls. Other clients use the bus.
+ */
+static ni_bool_t	ni_dbus_peer_client;
+
 ni_dbus_server_t *
 ni_server_listen_dbus(const char *dbus_name)
 {
+	ni_dbus_server_t *server;
+	char *address = NULL;
+
 	ni_global_assert_initialized();
 	if (dbus_name == NULL)
 		dbus_name = ni_global.config->dbus_name;
@@ -410,12 +422,24 @@ ni_server_listen_dbus(const char *dbus_name)
 		return NULL;
 	}
 
-	return ni_dbus_server_open(ni_global.config->dbus_type, dbus_name, NULL);
+	server = ni_dbus_server_open(ni_global.config->dbus_type, dbus_name, NULL);
+	if (server && ni_config_dbus_peer_address(dbus_name, &address)) {
+		ni_dbus_peer_client = TRUE;
+		if (!ni_global.config->dbus_peer.abstract)
+			ni_mkdir_maybe(ni_config_dbus_peer_socket_dir(), 0700);
+		if (ni_dbus_server_listen_peer(server, address) < 0)
+			ni_warn("%s: peer-to-peer dbus transport not available", dbus_name);
+		ni_string_free(&address);
+	}
+	return server;
 }
 
 ni_dbus_client_t *
 ni_create_dbus_client(const char *dbus_name)
 {
+	ni_dbus_client_t *client;
+	char *address = NULL;
+
 	ni_global_assert_initialized();
 	if (dbus_name == NULL)
 		dbus_name = ni_global.config->dbus_name;
@@ -424,7 +448,12 @@ ni_create_dbus_client(const char *dbus_name)
 		return NULL;
 	}
 
-	return ni_dbus_client_open(ni_global.config->dbus_type, dbus_name);
+	if (!ni_dbus_peer_client || !ni_config_dbus_peer_address(dbus_name, &address))
+		return ni_dbus_client_open(ni_global.config->dbus_type, dbus_name);
+
+	client = ni_dbus_client_open_peer(address, ni_global.config->dbus_type, dbus_name);
+	ni_string_free(&address);
+	return client;
 }
 
 ni_xs_scope_t *
@@ -476,6 +505,10 @@ ni_global_state_handle(int refresh)
 {
 	ni_netconfig_t *nc = ni_global_state_init();
 
+	/* kept up to date by the wickedd netconfig state stream */
+	if (nc && refresh && ni_netshare_client_active())
+		return nc;
+
 	if (nc && refresh) {
 		if (__ni_system_refresh_interfaces(nc) < 0) {
 			ni_error("failed to refresh interface list");
@@ -1102,6 +1135,7 @@ ni_addrconf_lease_new(int type, int family)
 
 	lease = calloc(1, sizeof(*lease));
 	if (lease) {
+		ni_memstat_alloc(NI_MEMSTAT_LEASE, lease);
 		lease->seqno = __ni_global_seqno++;
 		lease->type = type;
 		lease->family = family;
@@ -1113,8 +1147,10 @@ ni_addrconf_lease_new(int type, int family)
 void
 ni_addrconf_lease_free(ni_addrconf_lease_t *lease)
 {
-	if (lease)
+	if (lease) {
 		ni_addrconf_lease_destroy(lease);
+		ni_memstat_free(NI_MEMSTAT_LEASE, lease);
+	}
 	free(lease);
 }
 
@@ -97,6 +97,8 @@ extern int		__ni_system_interface_flush_routes(ni_netconfig_t *, ni_netdev_t *);
 extern void		__ni_system_ethernet_refresh(ni_netdev_t *);
 extern void		__ni_system_ethernet_update(ni_netdev_t *, ni_ethernet_t *);
 extern void		ni_system_ethtool_refresh(ni_netdev_t *);
+extern void		ni_system_ethtool_refresh_begin(void);
+extern void		ni_system_ethtool_refresh_end(void);
 
 /* FIXME: These should go elsewhere, maybe runtime.h */
 extern int		__ni_system_interface_update_lease(ni_netdev_t *, ni_addrconf_lease_t **, ni_event_t);
@@ -163,6 +165,8 @@ extern int		ni_capture_desc(const ni_capture_t *);
 extern int		ni_capture_build_udp_header(ni_buffer_t *,
 					struct in_addr src_addr, uint16_t src_port,
 					struct in_addr dst_addr, uint16_t dst_port);
+extern int		ni_capture_update_udp_payload(ni_buffer_t *, unsigned int,
+					const void *, size_t);
 extern void		ni_capture_set_user_data(ni_capture_t *, void *);
 extern void *		ni_capture_get_user_data(const ni_capture_t *);
 extern int		ni_capture_is_valid(const ni_capture_t *, int protocol);
@@ -197,16 +201,45 @@ extern int		ni_arp_send_grat_reply(ni_arp_socket_t *, struct in_addr);
 extern int		ni_arp_send_grat_request(ni_arp_socket_t *, struct in_addr);
 extern int		ni_arp_send(ni_arp_socket_t *, const ni_arp_packet_t *);
 
+typedef struct ni_arp_address_index {
+	unsigned int		size;
+	unsigned int *		slot;		/* ipaddrs position + 1, 0 if unused */
+} ni_arp_address_index_t;
+
+typedef struct ni_arp_hwaddr_entry {
+	unsigned int		ifindex;	/* 0 if unused */
+	ni_hwaddr_t		hwaddr;
+} ni_arp_hwaddr_entry_t;
+
+typedef struct ni_arp_hwaddr_index {
+	unsigned int		size;
+	ni_arp_hwaddr_entry_t *	entry;
+} ni_arp_hwaddr_index_t;
+
+typedef struct ni_arp_verify_probe {
+	unsigned int		sent;
+	struct timeval		next;		/* next probe or end of the verify */
+	struct timeval		deadline;	/* end of the verify */
+} ni_arp_verify_probe_t;
+
 typedef struct ni_arp_verify {
 	unsigned int		nprobes;
 
 	unsigned int		wait_ms;
-	struct timeval		started;
+	unsigned int		concurrency;	/* addresses verified at once, 0 for all */
 
 	ni_address_array_t	ipaddrs;
+	ni_arp_address_index_t	index;
+	ni_arp_verify_probe_t *	probes;		/* per ipaddrs position */
+	unsigned int		first;		/* first address still in verify */
+	unsigned int		next;		/* next address to start verify */
+	unsigned int		active;
+
+	ni_arp_hwaddr_index_t	hwaddrs;	/* of the other devices */
 } ni_arp_verify_t;
 
 extern void		ni_arp_verify_init(ni_arp_verify_t *, unsigned int, unsigned int);
+extern void		ni_arp_verify_set_concurrency(ni_arp_verify_t *, unsigned int);
 extern void		ni_arp_verify_reset(ni_arp_verify_t *, unsigned int, unsigned int);
 extern void		ni_arp_verify_destroy(ni_arp_verify_t *);
 extern unsigned int	ni_arp_verify_add_address(ni_arp_verify_t *,  ni_address_t *);
@@ -220,6 +253,7 @@ typedef struct ni_arp_notify {
 	struct timeval		started;
 
 	ni_address_array_t	ipaddrs;
+	ni_arp_address_index_t	index;
 } ni_arp_notify_t;
 
 extern void		ni_arp_notify_init(ni_arp_notify_t *, unsigned int, unsigned int);
@@ -0,0 +1,1166 @@
+/*
+ * Shared netconfig state of wickedd for the addrconf supplicants.
+ *
+ * wickedd listens on a unix seqpacket socket in the state directory.
+ * On connect, it passes a read-only file descriptor of a snapshot of
+ * its interface, address and ipv6 prefix state in a tmpfs file, which
+ * is rebuilt only when an event happened since it has been written.
+ * The snapshot header carries the event generation it has been taken
+ * at; each following event message carries the next generation, so a
+ * client detects a lost message and resynchronizes.
+ *
+ * A client applies the snapshot to its netconfig handle, emitting the
+ * events of the differences (none while not listening yet at startup),
+ * then applies the event stream and calls the interface, address and
+ * prefix event handlers as the rtnetlink event processing would do.
+ * When the connection is lost, e.g. because wickedd restarts or the
+ * client did not read the stream fast enough, it reconnects and syncs
+ * from a new snapshot again.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ *
+ *	This program is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License along
+ *	with this program; if not, see <http://www.gnu.org/licenses/> or write
+ *	to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *	Boston, MA 02110-1301 USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/address.h>
+#include <wicked/socket.h>
+#include <wicked/ipv6.h>
+
+#include "netinfo_priv.h"
+#include "socket_priv.h"
+#include "ipv6_priv.h"
+#include "appconfig.h"
+#include "util_priv.h"
+#include "netshare.h"
+
+#define NI_NETSHARE_MAGIC		0x4e49534eU	/* "NISN" */
+#define NI_NETSHARE_VERSION		1
+#define NI_NETSHARE_SNDBUF		(1024 * 1024)
+#define NI_NETSHARE_BACKLOG		16
+
+#define NI_NETSHARE_RADV_MANAGED	(1U << 0)
+#define NI_NETSHARE_RADV_OTHER		(1U << 1)
+
+typedef struct ni_netshare_header {
+	uint32_t		magic;
+	uint32_t		version;
+	uint32_t		generation;
+	uint32_t		nlinks;
+	uint32_t		naddrs;
+	uint32_t		nprefixes;
+	uint64_t		size;
+} ni_netshare_header_t;
+
+/*
+ * In the snapshot, the addresses and prefixes follow the links
+ * in the order of the links, each link counts its own records.
+ */
+typedef struct ni_netshare_link {
+	uint32_t		ifindex;
+	uint32_t		type;
+	uint32_t		ifflags;
+	uint32_t		mtu;
+	uint32_t		txqlen;
+	uint32_t		oper_state;
+	uint32_t		master;
+	uint32_t		lower;
+	uint32_t		radv;
+	uint32_t		naddrs;
+	uint32_t		nprefixes;
+	ni_hwaddr_t		hwaddr;
+	ni_hwaddr_t		hwpeer;
+	char			name[IFNAMSIZ];
+	char			master_name[IFNAMSIZ];
+	char			lower_name[IFNAMSIZ];
+} ni_netshare_link_t;
+
+typedef struct ni_netshare_addr {
+	uint32_t		ifindex;
+	uint32_t		family;
+	uint32_t		flags;
+	int32_t			scope;
+	uint32_t		prefixlen;
+	ni_sockaddr_t		local_addr;
+	ni_sockaddr_t		peer_addr;
+	ni_sockaddr_t		anycast_addr;
+	ni_sockaddr_t		bcast_addr;
+	ni_address_cache_info_t	cache_info;
+	char			label[IFNAMSIZ];
+} ni_netshare_addr_t;
+
+typedef struct ni_netshare_prefix {
+	uint32_t		ifindex;
+	uint32_t		length;
+	uint32_t		on_link;
+	uint32_t		autoconf;
+	ni_sockaddr_t		prefix;
+	struct timeval		acquired;
+	uint32_t		valid_lft;
+	uint32_t		preferred_lft;
+} ni_netshare_prefix_t;
+
+enum {
+	NI_NETSHARE_MSG_HELLO = 1,
+	NI_NETSHARE_MSG_LINK,
+	NI_NETSHARE_MSG_ADDR,
+	NI_NETSHARE_MSG_PREFIX,
+};
+
+typedef struct ni_netshare_msg {
+	uint32_t		type;
+	uint32_t		seq;
+	uint32_t		event;
+	uint32_t		version;
+	union {
+		ni_netshare_link_t	link;
+		ni_netshare_addr_t	addr;
+		ni_netshare_prefix_t	prefix;
+	};
+} ni_netshare_msg_t;
+
+typedef struct ni_netshare_server {
+	ni_socket_t *		listener;
+	char *			path;
+	ni_socket_array_t	peers;
+	unsigned int		generation;
+	struct {
+		int		fd;
+		unsigned int	generation;
+	}			snapshot;
+} ni_netshare_server_t;
+
+typedef struct ni_netshare_client {
+	ni_socket_t *		sock;
+	char *			path;
+	unsigned int		seq;
+	const ni_timer_t *	timer;
+} ni_netshare_client_t;
+
+static ni_netshare_server_t *	ni_netshare_server;
+static ni_netshare_client_t *	ni_netshare_client;
+
+static const char *
+ni_netshare_socket_path(void)
+{
+	static char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", ni_config_statedir(),
+			NI_NETSHARE_SOCKET_NAME);
+	return path;
+}
+
+static inline void
+ni_netshare_name_set(char *dst, const char *name)
+{
+	memset(dst, 0, IFNAMSIZ);
+	if (name)
+		strncpy(dst, name, IFNAMSIZ - 1);
+}
+
+static inline const char *
+ni_netshare_name_get(const char *name)
+{
+	return memchr(name, '\0', IFNAMSIZ) && *name ? name : NULL;
+}
+
+/*
+ * Conversion of the netdev state to the shared records
+ */
+static void
+ni_netshare_link_set(ni_netshare_link_t *link, const ni_netdev_t *dev)
+{
+	memset(link, 0, sizeof(*link));
+	link->ifindex    = dev->link.ifindex;
+	link->type       = dev->link.type;
+	link->ifflags    = dev->link.ifflags;
+	link->mtu        = dev->link.mtu;
+	link->txqlen     = dev->link.txqlen;
+	link->oper_state = dev->link.oper_state;
+	link->master     = dev->link.masterdev.index;
+	link->lower      = dev->link.lowerdev.index;
+	link->hwaddr     = dev->link.hwaddr;
+	link->hwpeer     = dev->link.hwpeer;
+	if (dev->ipv6 && dev->ipv6->radv.managed_addr)
+		link->radv |= NI_NETSHARE_RADV_MANAGED;
+	if (dev->ipv6 && dev->ipv6->radv.other_config)
+		link->radv |= NI_NETSHARE_RADV_OTHER;
+	ni_netshare_name_set(link->name, dev->name);
+	ni_netshare_name_set(link->master_name, dev->link.masterdev.name);
+	ni_netshare_name_set(link->lower_name, dev->link.lowerdev.name);
+}
+
+static void
+ni_netshare_addr_set(ni_netshare_addr_t *addr, const ni_netdev_t *dev, const ni_address_t *ap)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->ifindex      = dev->link.ifindex;
+	addr->family       = ap->family;
+	addr->flags        = ap->flags;
+	addr->scope        = ap->scope;
+	addr->prefixlen    = ap->prefixlen;
+	addr->local_addr   = ap->local_addr;
+	addr->peer_addr    = ap->peer_addr;
+	addr->anycast_addr = ap->anycast_addr;
+	addr->bcast_addr   = ap->bcast_addr;
+	addr->cache_info   = ap->cache_info;
+	ni_netshare_name_set(addr->label, ap->label);
+}
+
+static void
+ni_netshare_prefix_set(ni_netshare_prefix_t *prefix, const ni_netdev_t *dev,
+			const ni_ipv6_ra_pinfo_t *pi)
+{
+	memset(prefix, 0, sizeof(*prefix));
+	prefix->ifindex       = dev->link.ifindex;
+	prefix->length        = pi->length;
+	prefix->on_link       = pi->on_link;
+	prefix->autoconf      = pi->autoconf;
+	prefix->prefix        = pi->prefix;
+	prefix->acquired      = pi->acquired;
+	prefix->valid_lft     = pi->valid_lft;
+	prefix->preferred_lft = pi->preferred_lft;
+}
+
+/*
+ * Snapshot of the wickedd netconfig state in an unlinked tmpfs file
+ */
+static ni_bool_t
+ni_netshare_snapshot_write_data(int fd, const char *data, size_t size)
+{
+	ssize_t len;
+
+	while (size) {
+		len = write(fd, data, size);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			return FALSE;
+		data += len;
+		size -= len;
+	}
+	return TRUE;
+}
+
+static int
+ni_netshare_snapshot_write(ni_netconfig_t *nc, unsigned int generation)
+{
+	ni_netshare_header_t *hdr;
+	ni_netshare_link_t *link;
+	ni_netshare_addr_t *addr;
+	ni_netshare_prefix_t *prefix;
+	const ni_ipv6_ra_pinfo_t *pi;
+	const ni_address_t *ap;
+	const ni_netdev_t *dev;
+	unsigned int nlinks = 0, naddrs = 0, nprefixes = 0;
+	char path[PATH_MAX];
+	size_t size;
+	int fd, rfd = -1;
+	char *data;
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next) {
+		nlinks++;
+		for (ap = dev->addrs; ap; ap = ap->next)
+			naddrs++;
+		for (pi = dev->ipv6 ? dev->ipv6->radv.pinfo : NULL; pi; pi = pi->next)
+			nprefixes++;
+	}
+
+	size = sizeof(*hdr) + nlinks * sizeof(*link) +
+		naddrs * sizeof(*addr) + nprefixes * sizeof(*prefix);
+	data = xcalloc(1, size);
+
+	hdr = (ni_netshare_header_t *)data;
+	hdr->magic = NI_NETSHARE_MAGIC;
+	hdr->version = NI_NETSHARE_VERSION;
+	hdr->generation = generation;
+	hdr->nlinks = nlinks;
+	hdr->naddrs = naddrs;
+	hdr->nprefixes = nprefixes;
+	hdr->size = size;
+
+	link = (ni_netshare_link_t *)(hdr + 1);
+	addr = (ni_netshare_addr_t *)(link + nlinks);
+	prefix = (ni_netshare_prefix_t *)(addr + naddrs);
+	for (dev = ni_netconfig_devlist(nc); dev; dev = dev->next, link++) {
+		ni_netshare_link_set(link, dev);
+		for (ap = dev->addrs; ap; ap = ap->next, link->naddrs++)
+			ni_netshare_addr_set(addr++, dev, ap);
+		for (pi = dev->ipv6 ? dev->ipv6->radv.pinfo : NULL; pi; pi = pi->next, link->nprefixes++)
+			ni_netshare_prefix_set(prefix++, dev, pi);
+	}
+
+	snprintf(path, sizeof(path), "%s/netconfig-state.XXXXXX", ni_config_statedir());
+	if ((fd = mkstemp(path)) < 0) {
+		ni_error("Unable to create netconfig state snapshot %s: %m", path);
+		free(data);
+		return -1;
+	}
+
+	if (!ni_netshare_snapshot_write_data(fd, data, size) || fchmod(fd, 0400) < 0) {
+		ni_error("Unable to write netconfig state snapshot %s: %m", path);
+	} else
+	if ((rfd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		ni_error("Unable to reopen netconfig state snapshot %s: %m", path);
+	}
+	unlink(path);
+	close(fd);
+	free(data);
+
+	if (rfd >= 0) {
+		ni_debug_events("netconfig state snapshot of generation %u: "
+				"%u links, %u addresses, %u prefixes, %zu bytes",
+				generation, nlinks, naddrs, nprefixes, size);
+	}
+	return rfd;
+}
+
+/*
+ * wickedd side of the service
+ */
+static void
+ni_netshare_server_peer_drop(ni_socket_t *sock)
+{
+	if (!ni_netshare_server || !ni_socket_array_remove(&ni_netshare_server->peers, sock))
+		return;
+
+	ni_socket_close(sock);
+	ni_socket_release(sock);
+}
+
+static void
+ni_netshare_server_peer_recv(ni_socket_t *sock)
+{
+	char buf[64];
+	ssize_t len;
+
+	/* clients do not send anything, a read returns the hangup */
+	len = recv(sock->__fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+		ni_debug_events("netconfig state client on socket %d disconnected",
+				sock->__fd);
+		ni_netshare_server_peer_drop(sock);
+	}
+}
+
+static void
+ni_netshare_server_peer_hangup(ni_socket_t *sock)
+{
+	ni_netshare_server_peer_drop(sock);
+}
+
+static ni_bool_t
+ni_netshare_server_hello(ni_netshare_server_t *srv, int fd)
+{
+	unsigned char cbuf[CMSG_SPACE(sizeof(int))];
+	ni_netshare_msg_t msg;
+	struct cmsghdr *cm;
+	struct msghdr mh;
+	struct iovec iov;
+	ni_netconfig_t *nc;
+
+	if (srv->snapshot.fd < 0 || srv->snapshot.generation != srv->generation) {
+		if (!(nc = ni_global_state_handle(0)))
+			return FALSE;
+
+		if (srv->snapshot.fd >= 0)
+			close(srv->snapshot.fd);
+		srv->snapshot.generation = srv->generation;
+		if ((srv->snapshot.fd = ni_netshare_snapshot_write(nc, srv->generation)) < 0)
+			return FALSE;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = NI_NETSHARE_MSG_HELLO;
+	msg.seq = srv->snapshot.generation;
+	msg.version = NI_NETSHARE_VERSION;
+
+	memset(&cbuf, 0, sizeof(cbuf));
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(msg);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	cm = CMSG_FIRSTHDR(&mh);
+	cm->cmsg_level = SOL_SOCKET;
+	cm->cmsg_type = SCM_RIGHTS;
+	cm->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cm), &srv->snapshot.fd, sizeof(int));
+
+	if (sendmsg(fd, &mh, MSG_NOSIGNAL) != (ssize_t)sizeof(msg)) {
+		ni_error("Unable to send netconfig state snapshot: %m");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+ni_netshare_server_accept(ni_socket_t *listener)
+{
+	ni_netshare_server_t *srv = ni_netshare_server;
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	ni_socket_t *sock;
+	int fd, val;
+
+	if (!srv || (fd = accept4(listener->__fd, NULL, NULL, SOCK_CLOEXEC)) < 0)
+		return;
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+	    (cred.uid != 0 && cred.uid != geteuid())) {
+		ni_warn("Rejecting netconfig state client with uid %u",
+				len == sizeof(cred) ? cred.uid : -1U);
+		close(fd);
+		return;
+	}
+
+	val = NI_NETSHARE_SNDBUF;
+	if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val)) < 0)
+		ni_warn("Cannot set netconfig state socket send buffer size: %m");
+
+	if (!ni_netshare_server_hello(srv, fd) ||
+	    !(sock = ni_socket_wrap(fd, SOCK_SEQPACKET))) {
+		close(fd);
+		return;
+	}
+
+	sock->receive = ni_netshare_server_peer_recv;
+	sock->handle_hangup = ni_netshare_server_peer_hangup;
+	ni_socket_array_append(&srv->peers, ni_socket_hold(sock));
+	ni_socket_activate(sock);
+
+	ni_debug_events("netconfig state client pid %d connected at generation %u",
+			cred.pid, srv->snapshot.generation);
+}
+
+static void
+ni_netshare_server_publish(ni_netshare_msg_t *msg)
+{
+	ni_netshare_server_t *srv = ni_netshare_server;
+	unsigned int i;
+	ni_socket_t *sock;
+
+	msg->seq = ++srv->generation;
+	msg->version = NI_NETSHARE_VERSION;
+
+	for (i = 0; i < srv->peers.count; ) {
+		sock = srv->peers.data[i];
+
+		if (send(sock->__fd, msg, sizeof(*msg), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+			/* a client not reading its stream resyncs on reconnect */
+			ni_warn("Dropping netconfig state client on socket %d: %m",
+					sock->__fd);
+			ni_netshare_server_peer_drop(sock);
+			continue;
+		}
+		i++;
+	}
+}
+
+void
+ni_netshare_server_netdev_event(ni_netdev_t *dev, ni_event_t event)
+{
+	ni_netshare_msg_t msg;
+
+	if (!ni_netshare_server || !dev)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = NI_NETSHARE_MSG_LINK;
+	msg.event = event;
+	ni_netshare_link_set(&msg.link, dev);
+	ni_netshare_server_publish(&msg);
+}
+
+void
+ni_netshare_server_addr_event(ni_netdev_t *dev, ni_event_t event, const ni_address_t *ap)
+{
+	ni_netshare_msg_t msg;
+
+	if (!ni_netshare_server || !dev || !ap)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = NI_NETSHARE_MSG_ADDR;
+	msg.event = event;
+	ni_netshare_addr_set(&msg.addr, dev, ap);
+	ni_netshare_server_publish(&msg);
+}
+
+void
+ni_netshare_server_prefix_event(ni_netdev_t *dev, ni_event_t event, const ni_ipv6_ra_pinfo_t *pi)
+{
+	ni_netshare_msg_t msg;
+
+	if (!ni_netshare_server || !dev || !pi)
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = NI_NETSHARE_MSG_PREFIX;
+	msg.event = event;
+	ni_netshare_prefix_set(&msg.prefix, dev, pi);
+	ni_netshare_server_publish(&msg);
+}
+
+ni_bool_t
+ni_netshare_server_open(void)
+{
+	ni_netshare_server_t *srv;
+	struct sockaddr_un sun;
+	const char *path;
+	int fd;
+
+	if (ni_netshare_server)
+		return TRUE;
+
+	path = ni_netshare_socket_path();
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun.sun_path)) {
+		ni_error("netconfig state socket path too long: %s", path);
+		return FALSE;
+	}
+	strcpy(sun.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0) {
+		ni_error("Cannot open netconfig state socket: %m");
+		return FALSE;
+	}
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 ||
+	    chmod(path, 0600) < 0 || listen(fd, NI_NETSHARE_BACKLOG) < 0) {
+		ni_error("Cannot listen on netconfig state socket %s: %m", path);
+		unlink(path);
+		close(fd);
+		return FALSE;
+	}
+
+	srv = xcalloc(1, sizeof(*srv));
+	ni_string_dup(&srv->path, path);
+	ni_socket_array_init(&srv->peers);
+	srv->snapshot.fd = -1;
+
+	if (!(srv->listener = ni_socket_wrap(fd, SOCK_SEQPACKET))) {
+		unlink(path);
+		close(fd);
+		ni_string_free(&srv->path);
+		free(srv);
+		return FALSE;
+	}
+	srv->listener->receive = ni_netshare_server_accept;
+	ni_socket_activate(srv->listener);
+
+	ni_netshare_server = srv;
+	ni_debug_events("providing netconfig state on %s", path);
+	return TRUE;
+}
+
+void
+ni_netshare_server_close(void)
+{
+	ni_netshare_server_t *srv = ni_netshare_server;
+	ni_socket_t *sock;
+
+	if (!srv)
+		return;
+
+	while (srv->peers.count) {
+		sock = srv->peers.data[0];
+		ni_netshare_server_peer_drop(sock);
+	}
+	ni_socket_array_destroy(&srv->peers);
+
+	ni_socket_close(srv->listener);
+	unlink(srv->path);
+	ni_string_free(&srv->path);
+	if (srv->snapshot.fd >= 0)
+		close(srv->snapshot.fd);
+
+	ni_netshare_server = NULL;
+	free(srv);
+}
+
+/*
+ * Supplicant side of the service
+ */
+static inline void
+ni_netshare_addr_event(ni_netdev_t *dev, ni_event_t ev, const ni_address_t *ap)
+{
+	if (ni_global.interface_addr_event)
+		ni_global.interface_addr_event(dev, ev, ap);
+}
+
+static inline void
+ni_netshare_prefix_event(ni_netdev_t *dev, ni_event_t ev, const ni_ipv6_ra_pinfo_t *pi)
+{
+	if (ni_global.interface_prefix_event)
+		ni_global.interface_prefix_event(dev, ev, pi);
+}
+
+static inline ni_bool_t
+ni_netshare_family_filtered(ni_netconfig_t *nc, unsigned int family)
+{
+	unsigned int filter = ni_netconfig_get_family_filter(nc);
+
+	return filter != AF_UNSPEC && filter != family;
+}
+
+static void
+ni_netshare_link_apply(ni_netconfig_t *nc, ni_netdev_t *dev, const ni_netshare_link_t *link)
+{
+	ni_ipv6_devinfo_t *ipv6;
+
+	if (ni_netshare_name_get(link->name) && !ni_string_eq(dev->name, link->name))
+		ni_string_dup(&dev->name, link->name);
+
+	dev->link.type       = link->type;
+	dev->link.ifflags    = link->ifflags;
+	dev->link.mtu        = link->mtu;
+	dev->link.txqlen     = link->txqlen;
+	dev->link.oper_state = link->oper_state;
+	dev->link.hwaddr     = link->hwaddr;
+	dev->link.hwpeer     = link->hwpeer;
+	ni_netdev_ref_set(&dev->link.masterdev, ni_netshare_name_get(link->master_name), link->master);
+	ni_netdev_ref_set(&dev->link.lowerdev, ni_netshare_name_get(link->lower_name), link->lower);
+
+	if (ni_netshare_family_filtered(nc, AF_INET6))
+		return;
+	if ((link->radv || dev->ipv6) && (ipv6 = ni_netdev_get_ipv6(dev))) {
+		ipv6->radv.managed_addr = !!(link->radv & NI_NETSHARE_RADV_MANAGED);
+		ipv6->radv.other_config = !!(link->radv & NI_NETSHARE_RADV_OTHER);
+	}
+}
+
+static ni_bool_t
+ni_netshare_addr_apply(ni_address_t *ap, const ni_netshare_addr_t *addr)
+{
+	ni_bool_t changed;
+
+	changed = ap->flags != addr->flags || ap->scope != addr->scope ||
+		ap->prefixlen != addr->prefixlen ||
+		ap->cache_info.valid_lft != addr->cache_info.valid_lft ||
+		ap->cache_info.preferred_lft != addr->cache_info.preferred_lft ||
+		!ni_sockaddr_equal(&ap->peer_addr, &addr->peer_addr);
+
+	ap->flags        = addr->flags;
+	ap->scope        = addr->scope;
+	ap->prefixlen    = addr->prefixlen;
+	ap->peer_addr    = addr->peer_addr;
+	ap->anycast_addr = addr->anycast_addr;
+	ap->bcast_addr   = addr->bcast_addr;
+	ap->cache_info   = addr->cache_info;
+	ni_string_dup(&ap->label, ni_netshare_name_get(addr->label));
+	return changed;
+}
+
+static ni_ipv6_ra_pinfo_t *
+ni_netshare_prefix_new(const ni_netshare_prefix_t *prefix)
+{
+	ni_ipv6_ra_pinfo_t *pi;
+
+	pi = xcalloc(1, sizeof(*pi));
+	pi->prefix        = prefix->prefix;
+	pi->length        = prefix->length;
+	pi->on_link       = prefix->on_link;
+	pi->autoconf      = prefix->autoconf;
+	pi->acquired      = prefix->acquired;
+	pi->valid_lft     = prefix->valid_lft;
+	pi->preferred_lft = prefix->preferred_lft;
+	return pi;
+}
+
+static void
+ni_netshare_client_sync_netdev(ni_netconfig_t *nc, ni_netdev_t *dev, unsigned int seqno,
+		const ni_netshare_addr_t *addr, unsigned int naddrs,
+		const ni_netshare_prefix_t *prefix, unsigned int nprefixes)
+{
+	ni_ipv6_ra_pinfo_t *pinfo = NULL, *pi, *old;
+	ni_address_t *ap, *next;
+	unsigned int i;
+
+	for (i = 0; i < naddrs; ++i, ++addr) {
+		if (addr->ifindex != dev->link.ifindex ||
+		    ni_netshare_family_filtered(nc, addr->family))
+			continue;
+
+		if (!(ap = ni_address_list_find(dev->addrs, &addr->local_addr))) {
+			ap = ni_address_new(addr->family, addr->prefixlen,
+					&addr->local_addr, &dev->addrs);
+			if (!ap)
+				continue;
+			ni_netshare_addr_apply(ap, addr);
+			ap->seq = seqno;
+			ni_netshare_addr_event(dev, NI_EVENT_ADDRESS_UPDATE, ap);
+		} else {
+			ap->seq = seqno;
+			if (ni_netshare_addr_apply(ap, addr))
+				ni_netshare_addr_event(dev, NI_EVENT_ADDRESS_UPDATE, ap);
+		}
+	}
+	for (ap = dev->addrs; ap; ap = next) {
+		next = ap->next;
+		if (ap->seq == seqno)
+			continue;
+		ni_netshare_addr_event(dev, NI_EVENT_ADDRESS_DELETE, ap);
+		__ni_address_list_remove(&dev->addrs, ap);
+	}
+
+	if (!dev->ipv6 || ni_netshare_family_filtered(nc, AF_INET6))
+		return;
+
+	for (i = 0; i < nprefixes; ++i, ++prefix) {
+		if (prefix->ifindex != dev->link.ifindex)
+			continue;
+
+		pi = ni_netshare_prefix_new(prefix);
+		old = ni_ipv6_ra_pinfo_list_remove(&dev->ipv6->radv.pinfo, pi);
+		ni_ipv6_ra_pinfo_list_prepend(&pinfo, pi);
+		if (!old || old->valid_lft != pi->valid_lft ||
+		    old->preferred_lft != pi->preferred_lft ||
+		    timercmp(&old->acquired, &pi->acquired, !=))
+			ni_netshare_prefix_event(dev, NI_EVENT_PREFIX_UPDATE, pi);
+		free(old);
+	}
+	while ((old = dev->ipv6->radv.pinfo)) {
+		dev->ipv6->radv.pinfo = old->next;
+		ni_netshare_prefix_event(dev, NI_EVENT_PREFIX_DELETE, old);
+		free(old);
+	}
+	dev->ipv6->radv.pinfo = pinfo;
+}
+
+static ni_bool_t
+ni_netshare_client_sync(ni_netconfig_t *nc, const ni_netshare_header_t *hdr)
+{
+	static unsigned int seqno;
+	const ni_netshare_link_t *link;
+	const ni_netshare_addr_t *addr;
+	const ni_netshare_prefix_t *prefix;
+	ni_netdev_t *dev, *next;
+	unsigned int i, old_flags;
+	ni_bool_t renamed;
+
+	link = (const ni_netshare_link_t *)(hdr + 1);
+	addr = (const ni_netshare_addr_t *)(link + hdr->nlinks);
+	prefix = (const ni_netshare_prefix_t *)(addr + hdr->naddrs);
+
+	do {
+		seqno++;
+	} while (!seqno);
+
+	for (i = 0; i < hdr->nlinks; ++i, ++link) {
+		if (link->naddrs > hdr->naddrs || link->nprefixes > hdr->nprefixes)
+			return FALSE;
+
+		dev = ni_netdev_by_index(nc, link->ifindex);
+		if (!dev) {
+			if (!ni_netshare_name_get(link->name))
+				goto skip;
+			if (!(dev = ni_netdev_new(link->name, link->ifindex)))
+				return FALSE;
+			dev->created = 1;
+			ni_netconfig_device_append(nc, dev);
+		}
+
+		old_flags = dev->link.ifflags;
+		renamed = !dev->created && !ni_string_eq(dev->name, link->name);
+		ni_netshare_link_apply(nc, dev, link);
+		dev->seq = seqno;
+
+		if (renamed)
+			__ni_netdev_event(nc, dev, NI_EVENT_DEVICE_RENAME);
+		if (dev->created || old_flags != dev->link.ifflags)
+			__ni_netdev_process_events(nc, dev, old_flags);
+
+		ni_netshare_client_sync_netdev(nc, dev, seqno,
+				addr, link->naddrs, prefix, link->nprefixes);
+	skip:
+		addr += link->naddrs;
+		prefix += link->nprefixes;
+	}
+
+	for (dev = ni_netconfig_devlist(nc); dev; dev = next) {
+		next = dev->next;
+		if (dev->seq == seqno)
+			continue;
+
+		old_flags = dev->link.ifflags;
+		dev->link.ifflags = 0;
+		dev->deleted = 1;
+		__ni_netdev_process_events(nc, dev, old_flags);
+		ni_netconfig_device_remove(nc, dev);
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+ni_netshare_client_load(ni_netshare_client_t *nsc, int fd, unsigned int generation)
+{
+	const ni_netshare_header_t *hdr;
+	ni_netconfig_t *nc;
+	struct stat st;
+	ni_bool_t ret = FALSE;
+	void *map;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*hdr)) {
+		ni_error("Invalid netconfig state snapshot");
+		return FALSE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ni_error("Unable to map netconfig state snapshot: %m");
+		return FALSE;
+	}
+
+	hdr = map;
+	if (hdr->magic != NI_NETSHARE_MAGIC || hdr->version != NI_NETSHARE_VERSION ||
+	    hdr->generation != generation || hdr->size != (uint64_t)st.st_size ||
+	    hdr->size != sizeof(*hdr) +
+			(uint64_t)hdr->nlinks * sizeof(ni_netshare_link_t) +
+			(uint64_t)hdr->naddrs * sizeof(ni_netshare_addr_t) +
+			(uint64_t)hdr->nprefixes * sizeof(ni_netshare_prefix_t)) {
+		ni_error("Incompatible netconfig state snapshot");
+	} else
+	if ((nc = ni_global_state_handle(0)) && ni_netshare_client_sync(nc, hdr)) {
+		ni_debug_events("applied netconfig state snapshot of generation %u: "
+				"%u links, %u addresses, %u prefixes", hdr->generation,
+				hdr->nlinks, hdr->naddrs, hdr->nprefixes);
+		nsc->seq = generation;
+		ret = TRUE;
+	}
+
+	munmap(map, st.st_size);
+	return ret;
+}
+
+static void
+ni_netshare_client_link_event(ni_netconfig_t *nc, const ni_netshare_link_t *link, ni_event_t event)
+{
+	ni_netdev_t *dev;
+
+	if (!(dev = ni_netdev_by_index(nc, link->ifindex))) {
+		if (event == NI_EVENT_DEVICE_DELETE || !ni_netshare_name_get(link->name))
+			return;
+		if (!(dev = ni_netdev_new(link->name, link->ifindex)))
+			return;
+		ni_netconfig_device_append(nc, dev);
+	}
+
+	ni_netshare_link_apply(nc, dev, link);
+	if (event == NI_EVENT_DEVICE_DOWN && dev->ipv6)
+		ni_ipv6_ra_info_flush(&dev->ipv6->radv);
+
+	__ni_netdev_event(nc, dev, event);
+
+	if (event == NI_EVENT_DEVICE_DELETE)
+		ni_netconfig_device_remove(nc, dev);
+}
+
+static void
+ni_netshare_client_addr_event(ni_netconfig_t *nc, const ni_netshare_addr_t *addr, ni_event_t event)
+{
+	ni_address_t *ap, tmp;
+	ni_netdev_t *dev;
+
+	if (ni_netshare_family_filtered(nc, addr->family))
+		return;
+	if (!(dev = ni_netdev_by_index(nc, addr->ifindex)))
+		return;
+
+	ap = ni_address_list_find(dev->addrs, &addr->local_addr);
+	if (event == NI_EVENT_ADDRESS_DELETE) {
+		memset(&tmp, 0, sizeof(tmp));
+		tmp.family = addr->family;
+		tmp.local_addr = addr->local_addr;
+		ni_netshare_addr_apply(&tmp, addr);
+
+		if (ap)
+			__ni_address_list_remove(&dev->addrs, ap);
+		ni_netshare_addr_event(dev, event, &tmp);
+		ni_string_free(&tmp.label);
+		return;
+	}
+
+	if (!ap && !(ap = ni_address_new(addr->family, addr->prefixlen,
+					&addr->local_addr, &dev->addrs)))
+		return;
+	ni_netshare_addr_apply(ap, addr);
+	ni_netshare_addr_event(dev, event, ap);
+}
+
+static void
+ni_netshare_client_prefix_event(ni_netconfig_t *nc, const ni_netshare_prefix_t *prefix, ni_event_t event)
+{
+	ni_ipv6_ra_pinfo_t *pi, *old;
+	ni_ipv6_devinfo_t *ipv6;
+	ni_netdev_t *dev;
+
+	if (ni_netshare_family_filtered(nc, AF_INET6))
+		return;
+	if (!(dev = ni_netdev_by_index(nc, prefix->ifindex)) || !(ipv6 = ni_netdev_get_ipv6(dev)))
+		return;
+
+	pi = ni_netshare_prefix_new(prefix);
+	old = ni_ipv6_ra_pinfo_list_remove(&ipv6->radv.pinfo, pi);
+	if (event == NI_EVENT_PREFIX_DELETE) {
+		ni_netshare_prefix_event(dev, event, old ? old : pi);
+		ni_ipv6_ra_pinfo_free(pi);
+	} else {
+		ni_ipv6_ra_pinfo_list_prepend(&ipv6->radv.pinfo, pi);
+		ni_netshare_prefix_event(dev, event, pi);
+	}
+	free(old);
+}
+
+static void	ni_netshare_client_disconnect(ni_netshare_client_t *, unsigned long);
+
+static void
+ni_netshare_client_recv(ni_socket_t *sock)
+{
+	ni_netshare_client_t *nsc = sock->user_data;
+	ni_netshare_msg_t msg;
+	ni_netconfig_t *nc;
+	ssize_t len;
+
+	if (!nsc || !(nc = ni_global_state_handle(0)))
+		return;
+
+	while (nsc->sock == sock) {
+		len = recv(sock->__fd, &msg, sizeof(msg), MSG_DONTWAIT);
+		if (len < 0 && (errno == EAGAIN || errno == EINTR))
+			return;
+
+		if (len <= 0) {
+			ni_warn("Lost netconfig state connection to wickedd%s%s",
+				len ? ": " : "", len ? strerror(errno) : "");
+			ni_netshare_client_disconnect(nsc, NI_NETSHARE_RECONNECT);
+			return;
+		}
+
+		if (len != sizeof(msg) || msg.version != NI_NETSHARE_VERSION ||
+		    msg.seq != nsc->seq + 1) {
+			ni_warn("Unexpected netconfig state message %u, resyncing",
+				msg.seq);
+			ni_netshare_client_disconnect(nsc, 0);
+			return;
+		}
+		nsc->seq = msg.seq;
+
+		switch (msg.type) {
+		case NI_NETSHARE_MSG_LINK:
+			ni_netshare_client_link_event(nc, &msg.link, msg.event);
+			break;
+		case NI_NETSHARE_MSG_ADDR:
+			ni_netshare_client_addr_event(nc, &msg.addr, msg.event);
+			break;
+		case NI_NETSHARE_MSG_PREFIX:
+			ni_netshare_client_prefix_event(nc, &msg.prefix, msg.event);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void
+ni_netshare_client_hangup(ni_socket_t *sock)
+{
+	ni_netshare_client_t *nsc = sock->user_data;
+
+	if (nsc && nsc->sock == sock) {
+		ni_warn("Lost netconfig state connection to wickedd");
+		ni_netshare_client_disconnect(nsc, NI_NETSHARE_RECONNECT);
+	}
+}
+
+static ni_bool_t
+ni_netshare_client_connect(ni_netshare_client_t *nsc)
+{
+	unsigned char cbuf[CMSG_SPACE(sizeof(int))];
+	struct sockaddr_un sun;
+	ni_netshare_msg_t msg;
+	struct cmsghdr *cm;
+	struct pollfd pfd;
+	struct msghdr mh;
+	struct iovec iov;
+	int fd, sfd = -1;
+	ssize_t len;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(nsc->path) >= sizeof(sun.sun_path))
+		return FALSE;
+	strcpy(sun.sun_path, nsc->path);
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return FALSE;
+
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		ni_debug_events("Cannot connect to netconfig state socket %s: %m",
+				nsc->path);
+		goto failure;
+	}
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, NI_NETSHARE_TIMEOUT) <= 0) {
+		ni_error("Timeout waiting for the netconfig state snapshot");
+		goto failure;
+	}
+
+	memset(&cbuf, 0, sizeof(cbuf));
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = &msg;
+	iov.iov_len = sizeof(msg);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	len = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+	for (cm = CMSG_FIRSTHDR(&mh); len > 0 && cm; cm = CMSG_NXTHDR(&mh, cm)) {
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+		    cm->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&sfd, CMSG_DATA(cm), sizeof(int));
+	}
+	if (len != sizeof(msg) || sfd < 0 || msg.type != NI_NETSHARE_MSG_HELLO ||
+	    msg.version != NI_NETSHARE_VERSION) {
+		ni_error("Invalid netconfig state hello message");
+		goto failure;
+	}
+
+	if (!ni_netshare_client_load(nsc, sfd, msg.seq))
+		goto failure;
+	close(sfd);
+
+	if (!(nsc->sock = ni_socket_wrap(fd, SOCK_SEQPACKET)))
+		goto failure;
+	nsc->sock->user_data = nsc;
+	nsc->sock->receive = ni_netshare_client_recv;
+	nsc->sock->handle_hangup = ni_netshare_client_hangup;
+	ni_socket_activate(nsc->sock);
+	return TRUE;
+
+failure:
+	if (sfd >= 0)
+		close(sfd);
+	close(fd);
+	return FALSE;
+}
+
+static void
+ni_netshare_client_reconnect(void *user_data, const ni_timer_t *timer)
+{
+	ni_netshare_client_t *nsc = user_data;
+
+	if (nsc != ni_netshare_client || nsc->timer != timer)
+		return;
+
+	nsc->timer = NULL;
+	if (ni_netshare_client_connect(nsc)) {
+		ni_note("Resynchronized with the wickedd netconfig state");
+		return;
+	}
+	nsc->timer = ni_timer_register(NI_NETSHARE_RECONNECT,
+				ni_netshare_client_reconnect, nsc);
+}
+
+static void
+ni_netshare_client_disconnect(ni_netshare_client_t *nsc, unsigned long delay)
+{
+	if (nsc->sock) {
+		ni_socket_t *sock = nsc->sock;
+
+		nsc->sock = NULL;
+		sock->user_data = NULL;
+		ni_socket_close(sock);
+	}
+	if (nsc->timer)
+		ni_timer_cancel(nsc->timer);
+	nsc->timer = ni_timer_register(delay, ni_netshare_client_reconnect, nsc);
+}
+
+ni_bool_t
+ni_netshare_client_open(void)
+{
+	ni_netshare_client_t *nsc;
+
+	if (ni_netshare_client)
+		return TRUE;
+
+	nsc = xcalloc(1, sizeof(*nsc));
+	ni_string_dup(&nsc->path, ni_netshare_socket_path());
+	if (!ni_netshare_client_connect(nsc)) {
+		ni_note("wickedd netconfig state not available, using own netlink state");
+		ni_string_free(&nsc->path);
+		free(nsc);
+		return FALSE;
+	}
+
+	ni_netshare_client = nsc;
+	ni_debug_events("using wickedd netconfig state from %s", nsc->path);
+	return TRUE;
+}
+
+void
+ni_netshare_client_close(void)
+{
+	ni_netshare_client_t *nsc = ni_netshare_client;
+
+	if (!nsc)
+		return;
+
+	ni_netshare_client = NULL;
+	if (nsc->sock) {
+		nsc->sock->user_data = NULL;
+		ni_socket_close(nsc->sock);
+	}
+	if (nsc->timer)
+		ni_timer_cancel(nsc->timer);
+	ni_string_free(&nsc->path);
+	free(nsc);
+}
+
+ni_bool_t
+ni_netshare_client_active(void)
+{
+	return ni_netshare_client != NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ * Shared netconfig state of wickedd for the addrconf supplicants.
+ *
+ * wickedd publishes a read-only, versioned snapshot of its interface,
+ * address and ipv6 prefix state on a unix socket, followed by a stream
+ * of the link, address and prefix events it processes, so the dhcp4,
+ * dhcp6 and autoip4 supplicants do not need to dump and to listen to
+ * the kernel rtnetlink state themselves.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifndef NI_WICKED_NETSHARE_H
+#define NI_WICKED_NETSHARE_H
+
+#include <wicked/types.h>
+#include <wicked/netinfo.h>
+
+#define NI_NETSHARE_SOCKET_NAME		"netconfig-state.sock"
+#define NI_NETSHARE_TIMEOUT		5000	/* msec */
+#define NI_NETSHARE_RECONNECT		1000	/* msec */
+
+/* wickedd side */
+extern ni_bool_t		ni_netshare_server_open(void);
+extern void			ni_netshare_server_close(void);
+extern void			ni_netshare_server_netdev_event(ni_netdev_t *, ni_event_t);
+extern void			ni_netshare_server_addr_event(ni_netdev_t *, ni_event_t,
+							const ni_address_t *);
+extern void			ni_netshare_server_prefix_event(ni_netdev_t *, ni_event_t,
+							const ni_ipv6_ra_pinfo_t *);
+
+/* supplicant side */
+extern ni_bool_t		ni_netshare_client_open(void);
+extern void			ni_netshare_client_close(void);
+extern ni_bool_t		ni_netshare_client_active(void);
+
+#endif /* NI_WICKED_NETSHARE_H */
@@ -30,8 +30,10 @@
 #include <wicked/util.h>
 #include <wicked/netinfo.h>
 #include "ovs.h"
+#include "ovsdb.h"
 #include "buffer.h"
 #include "process.h"
+#include "appconfig.h"
 #include "util_priv.h"
 
 #define NI_OVS_BRIDGE_PORT_ARRAY_CHUNK		4
@@ -663,6 +665,122 @@ failure:
 	return rv;
 }
 
+/*
+ * The ovsdb client is used while the ovsdb-server socket is reachable,
+ * the ovs-vsctl utility is the fallback in the (default) detect mode.
+ */
+static ni_ovsdb_client_t *	ni_ovs_ovsdb_client;
+
+static ni_ovsdb_client_t *
+ni_ovs_ovsdb(void)
+{
+	ni_config_ovs_ctl_t ctl = ni_config_ovs_ctl();
+
+	if (ctl == NI_CONFIG_OVS_CTL_VSCTL)
+		return NULL;
+
+	if (!ni_ovs_ovsdb_client)
+		ni_ovs_ovsdb_client = ni_ovsdb_client_new(ni_config_ovs_ovsdb_socket());
+
+	if (ctl == NI_CONFIG_OVS_CTL_OVSDB || ni_ovsdb_client_connect(ni_ovs_ovsdb_client))
+		return ni_ovs_ovsdb_client;
+	return NULL;
+}
+
+int
+ni_ovs_ctl_bridge_add(const ni_netdev_t *cfg, ni_bool_t may_exist)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!cfg || ni_string_empty(cfg->name) || !cfg->ovsbr)
+		return -1;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_add(cfg, may_exist);
+
+	return ni_ovsdb_bridge_add(client, cfg->name, cfg->ovsbr->config.vlan.parent.name,
+				cfg->ovsbr->config.vlan.tag, may_exist);
+}
+
+int
+ni_ovs_ctl_bridge_del(const char *brname)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_del(brname);
+
+	return ni_ovsdb_bridge_del(client, brname);
+}
+
+int
+ni_ovs_ctl_bridge_exists(const char *brname)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_exists(brname);
+
+	return ni_ovsdb_bridge_exists(client, brname);
+}
+
+int
+ni_ovs_ctl_bridge_port_add(const char *pname, const ni_ovs_bridge_port_config_t *pconf,
+				ni_bool_t may_exist)
+{
+	ni_ovsdb_client_t *client;
+
+	if (ni_string_empty(pname) || !pconf || ni_string_empty(pconf->bridge.name))
+		return -1;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_port_add(pname, pconf, may_exist);
+
+	return ni_ovsdb_bridge_port_add(client, pconf->bridge.name, pname, may_exist);
+}
+
+int
+ni_ovs_ctl_bridge_port_del(const char *brname, const char *pname)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_port_del(brname, pname);
+
+	return ni_ovsdb_bridge_port_del(client, brname, pname);
+}
+
+int
+ni_ovs_ctl_bridge_port_to_bridge(const char *pname, char **brname)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!(client = ni_ovs_ovsdb()))
+		return ni_ovs_vsctl_bridge_port_to_bridge(pname, brname);
+
+	return ni_ovsdb_bridge_port_to_bridge(client, pname, brname);
+}
+
+static int
+ni_ovs_ctl_bridge_query(ni_ovs_bridge_t *ovsbr, const char *brname)
+{
+	ni_ovsdb_client_t *client;
+
+	if (!(client = ni_ovs_ovsdb())) {
+		if (ni_ovs_vsctl_bridge_to_parent(brname, &ovsbr->config.vlan.parent.name) ||
+		    ni_ovs_vsctl_bridge_to_vlan(brname, &ovsbr->config.vlan.tag) ||
+		    ni_ovs_vsctl_bridge_ports(brname, &ovsbr->ports))
+			return -1;
+		return 0;
+	}
+
+	if (ni_ovsdb_bridge_to_parent(client, brname, &ovsbr->config.vlan.parent.name) ||
+	    ni_ovsdb_bridge_to_vlan(client, brname, &ovsbr->config.vlan.tag) ||
+	    ni_ovsdb_bridge_ports(client, brname, &ovsbr->ports))
+		return -1;
+	return 0;
+}
+
 int
 ni_ovs_bridge_discover(ni_netdev_t *dev, ni_netconfig_t *nc)
 {
@@ -673,9 +791,7 @@ ni_ovs_bridge_discover(ni_netdev_t *dev, ni_netconfig_t *nc)
 		return -1;
 
 	ovsbr = ni_ovs_bridge_new();
-	if (ni_ovs_vsctl_bridge_to_parent(dev->name, &ovsbr->config.vlan.parent.name) ||
-	    ni_ovs_vsctl_bridge_to_vlan(dev->name, &ovsbr->config.vlan.tag) ||
-	    ni_ovs_vsctl_bridge_ports(dev->name, &ovsbr->ports)) {
+	if (ni_ovs_ctl_bridge_query(ovsbr, dev->name)) {
 		ni_ovs_bridge_free(ovsbr);
 		return -1;
 	}
@@ -39,6 +39,14 @@ extern int	ni_ovs_vsctl_bridge_port_add(const char *, const ni_ovs_bridge_port_c
 extern int	ni_ovs_vsctl_bridge_port_del(const char *, const char *);
 extern int	ni_ovs_vsctl_bridge_port_to_bridge(const char *, char **);
 
+extern int	ni_ovs_ctl_bridge_add(const ni_netdev_t *, ni_bool_t);
+extern int	ni_ovs_ctl_bridge_del(const char *);
+extern int	ni_ovs_ctl_bridge_exists(const char *);
+extern int	ni_ovs_ctl_bridge_port_add(const char *, const ni_ovs_bridge_port_config_t *,
+							ni_bool_t);
+extern int	ni_ovs_ctl_bridge_port_del(const char *, const char *);
+extern int	ni_ovs_ctl_bridge_port_to_bridge(const char *, char **);
+
 extern int	ni_ovs_bridge_discover(ni_netdev_t *, ni_netconfig_t *);
 
 #endif /* NI_WICKED_OVS_CTL_H */
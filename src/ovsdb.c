@@ -0,0 +1,1333 @@
+/*
+ * OVSDB (RFC 7047) JSON-RPC client of the Open_vSwitch database.
+ *
+ * The monitor subscription delivers the Bridge and Port rows once on
+ * connect and then every change as an "update" notification. Pending
+ * notifications are read without blocking before each cache lookup;
+ * a lookup that misses first flushes the connection with an "echo"
+ * round-trip, so a bridge created just before its netlink event is
+ * found. ovsdb-server sends the updates of a transaction before its
+ * reply, so the cache reflects our own changes once they returned.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include "ovsdb.h"
+#include "buffer.h"
+#include "json.h"
+#include "util_priv.h"
+
+#define NI_OVSDB_DATABASE		"Open_vSwitch"
+#define NI_OVSDB_MONITOR_ID		"wicked"
+#define NI_OVSDB_UUID_LEN		36
+#define NI_OVSDB_HASH_SIZE		1024
+#define NI_OVSDB_READ_CHUNK		16384
+#define NI_OVSDB_VLAN_MAX		4096
+
+typedef struct ni_ovsdb_row	ni_ovsdb_row_t;
+typedef struct ni_ovsdb_link	ni_ovsdb_link_t;
+
+struct ni_ovsdb_row {
+	ni_ovsdb_row_t *	next;
+	ni_ovsdb_row_t *	name_next;
+	char			uuid[NI_OVSDB_UUID_LEN + 1];
+
+	char *			name;
+	ni_string_array_t	ports;		/* bridge: port uuids		*/
+	unsigned int		tag;		/* port: vlan tag or 0		*/
+	ni_bool_t		fake_bridge;	/* port: local port of a fake bridge */
+};
+
+typedef struct ni_ovsdb_table {
+	unsigned int		count;
+	ni_ovsdb_row_t *	hash[NI_OVSDB_HASH_SIZE];
+	ni_ovsdb_row_t *	names[NI_OVSDB_HASH_SIZE];
+} ni_ovsdb_table_t;
+
+/* the bridge owning a port, by port uuid */
+struct ni_ovsdb_link {
+	ni_ovsdb_link_t *	next;
+	char			port[NI_OVSDB_UUID_LEN + 1];
+	ni_ovsdb_row_t *	bridge;
+};
+
+struct ni_ovsdb_client {
+	char *			path;
+	int			fd;
+
+	ni_buffer_t		rbuf;
+	struct {
+		size_t		pos;
+		unsigned int	depth;
+		ni_bool_t	string;
+		ni_bool_t	escape;
+	} scan;
+
+	unsigned int		xid;
+	unsigned int		wait_xid;
+	ni_json_t *		reply;
+
+	ni_ovsdb_table_t	bridges;
+	ni_ovsdb_table_t	ports;
+	ni_ovsdb_link_t *	port_bridge[NI_OVSDB_HASH_SIZE];
+};
+
+/*
+ * monitor cache tables, hashed by row uuid and by name
+ */
+static unsigned int
+ni_ovsdb_hash(const char *str)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619U;
+	}
+	return hash % NI_OVSDB_HASH_SIZE;
+}
+
+static void
+ni_ovsdb_row_free(ni_ovsdb_row_t *row)
+{
+	ni_string_free(&row->name);
+	ni_string_array_destroy(&row->ports);
+	free(row);
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_table_find(ni_ovsdb_table_t *table, const char *uuid)
+{
+	ni_ovsdb_row_t *row;
+
+	if (!uuid)
+		return NULL;
+
+	for (row = table->hash[ni_ovsdb_hash(uuid)]; row; row = row->next) {
+		if (ni_string_eq(row->uuid, uuid))
+			return row;
+	}
+	return NULL;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_table_find_name(ni_ovsdb_table_t *table, const char *name)
+{
+	ni_ovsdb_row_t *row;
+
+	if (!name)
+		return NULL;
+
+	for (row = table->names[ni_ovsdb_hash(name)]; row; row = row->name_next) {
+		if (ni_string_eq(row->name, name))
+			return row;
+	}
+	return NULL;
+}
+
+static void
+ni_ovsdb_table_unset_name(ni_ovsdb_table_t *table, ni_ovsdb_row_t *row)
+{
+	ni_ovsdb_row_t **pos;
+
+	if (!row->name)
+		return;
+
+	for (pos = &table->names[ni_ovsdb_hash(row->name)]; *pos; pos = &(*pos)->name_next) {
+		if (*pos == row) {
+			*pos = row->name_next;
+			break;
+		}
+	}
+	row->name_next = NULL;
+	ni_string_free(&row->name);
+}
+
+static void
+ni_ovsdb_table_set_name(ni_ovsdb_table_t *table, ni_ovsdb_row_t *row, char *name)
+{
+	ni_ovsdb_row_t **slot;
+
+	ni_ovsdb_table_unset_name(table, row);
+	if (!(row->name = name))
+		return;
+
+	slot = &table->names[ni_ovsdb_hash(name)];
+	row->name_next = *slot;
+	*slot = row;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_table_get(ni_ovsdb_table_t *table, const char *uuid)
+{
+	ni_ovsdb_row_t **slot, *row;
+
+	if ((row = ni_ovsdb_table_find(table, uuid)))
+		return row;
+
+	if (ni_string_len(uuid) != NI_OVSDB_UUID_LEN)
+		return NULL;
+
+	row = xcalloc(1, sizeof(*row));
+	memcpy(row->uuid, uuid, NI_OVSDB_UUID_LEN);
+
+	slot = &table->hash[ni_ovsdb_hash(uuid)];
+	row->next = *slot;
+	*slot = row;
+	table->count++;
+	return row;
+}
+
+static void
+ni_ovsdb_table_delete(ni_ovsdb_table_t *table, const char *uuid)
+{
+	ni_ovsdb_row_t **pos, *row;
+
+	for (pos = &table->hash[ni_ovsdb_hash(uuid)]; (row = *pos); pos = &row->next) {
+		if (ni_string_eq(row->uuid, uuid)) {
+			*pos = row->next;
+			ni_ovsdb_table_unset_name(table, row);
+			ni_ovsdb_row_free(row);
+			table->count--;
+			return;
+		}
+	}
+}
+
+static void
+ni_ovsdb_table_clear(ni_ovsdb_table_t *table)
+{
+	ni_ovsdb_row_t *row;
+	unsigned int i;
+
+	for (i = 0; i < NI_OVSDB_HASH_SIZE; ++i) {
+		while ((row = table->hash[i])) {
+			table->hash[i] = row->next;
+			ni_ovsdb_row_free(row);
+		}
+		table->names[i] = NULL;
+	}
+	table->count = 0;
+}
+
+/*
+ * port uuid to owning bridge index, maintained on bridge port updates
+ */
+static ni_ovsdb_row_t *
+ni_ovsdb_port_bridge(ni_ovsdb_client_t *client, const char *port_uuid)
+{
+	ni_ovsdb_link_t *link;
+
+	if (!port_uuid)
+		return NULL;
+
+	for (link = client->port_bridge[ni_ovsdb_hash(port_uuid)]; link; link = link->next) {
+		if (ni_string_eq(link->port, port_uuid))
+			return link->bridge;
+	}
+	return NULL;
+}
+
+static void
+ni_ovsdb_port_bridge_set(ni_ovsdb_client_t *client, const char *port_uuid, ni_ovsdb_row_t *bridge)
+{
+	ni_ovsdb_link_t **slot, *link;
+
+	if (ni_string_len(port_uuid) != NI_OVSDB_UUID_LEN)
+		return;
+
+	slot = &client->port_bridge[ni_ovsdb_hash(port_uuid)];
+	for (link = *slot; link; link = link->next) {
+		if (ni_string_eq(link->port, port_uuid)) {
+			link->bridge = bridge;
+			return;
+		}
+	}
+
+	link = xcalloc(1, sizeof(*link));
+	memcpy(link->port, port_uuid, NI_OVSDB_UUID_LEN);
+	link->bridge = bridge;
+	link->next = *slot;
+	*slot = link;
+}
+
+/* drops the links of the bridge ports, unless moved to another bridge */
+static void
+ni_ovsdb_port_bridge_unset(ni_ovsdb_client_t *client, ni_ovsdb_row_t *bridge)
+{
+	ni_ovsdb_link_t **pos, *link;
+	unsigned int i;
+
+	for (i = 0; i < bridge->ports.count; ++i) {
+		pos = &client->port_bridge[ni_ovsdb_hash(bridge->ports.data[i])];
+		for (; (link = *pos); pos = &link->next) {
+			if (ni_string_eq(link->port, bridge->ports.data[i])) {
+				if (link->bridge == bridge) {
+					*pos = link->next;
+					free(link);
+				}
+				break;
+			}
+		}
+	}
+}
+
+static void
+ni_ovsdb_port_bridge_clear(ni_ovsdb_client_t *client)
+{
+	ni_ovsdb_link_t *link;
+	unsigned int i;
+
+	for (i = 0; i < NI_OVSDB_HASH_SIZE; ++i) {
+		while ((link = client->port_bridge[i])) {
+			client->port_bridge[i] = link->next;
+			free(link);
+		}
+	}
+}
+
+/*
+ * ovsdb json value notations
+ */
+static ni_bool_t
+ni_ovsdb_json_is_kind(ni_json_t *json, const char *kind)
+{
+	char *str = NULL;
+	ni_bool_t ret;
+
+	if (ni_json_array_entries(json) != 2)
+		return FALSE;
+
+	ret = ni_json_string_get(ni_json_array_get(json, 0), &str) &&
+		ni_string_eq(str, kind);
+	ni_string_free(&str);
+	return ret;
+}
+
+/* a set is either its only atom or ["set", [atom, ...]] */
+static unsigned int
+ni_ovsdb_json_set_entries(ni_json_t *json)
+{
+	if (!json)
+		return 0;
+	if (ni_ovsdb_json_is_kind(json, "set"))
+		return ni_json_array_entries(ni_json_array_get(json, 1));
+	return 1;
+}
+
+static ni_json_t *
+ni_ovsdb_json_set_get(ni_json_t *json, unsigned int pos)
+{
+	if (ni_ovsdb_json_is_kind(json, "set"))
+		return ni_json_array_get(ni_json_array_get(json, 1), pos);
+	return pos == 0 ? json : NULL;
+}
+
+static ni_bool_t
+ni_ovsdb_json_uuid_get(ni_json_t *json, char **uuid)
+{
+	if (!ni_ovsdb_json_is_kind(json, "uuid"))
+		return FALSE;
+	return ni_json_string_get(ni_json_array_get(json, 1), uuid);
+}
+
+static ni_json_t *
+ni_ovsdb_json_uuid(const char *kind, const char *uuid)
+{
+	ni_json_t *json = ni_json_new_array();
+
+	ni_json_array_append(json, ni_json_new_string(kind));
+	ni_json_array_append(json, ni_json_new_string(uuid));
+	return json;
+}
+
+/*
+ * monitor updates
+ */
+static void
+ni_ovsdb_row_set_name(ni_ovsdb_table_t *table, ni_ovsdb_row_t *row, ni_json_t *data)
+{
+	char *name = NULL;
+
+	if (ni_json_object_get_value(data, "name")) {
+		ni_json_string_get(ni_json_object_get_value(data, "name"), &name);
+		ni_ovsdb_table_set_name(table, row, name);
+	}
+}
+
+static void
+ni_ovsdb_bridge_row_set(ni_ovsdb_client_t *client, ni_ovsdb_row_t *row, ni_json_t *data)
+{
+	unsigned int i, count;
+	ni_json_t *ports;
+	char *uuid = NULL;
+
+	ni_ovsdb_row_set_name(&client->bridges, row, data);
+
+	if ((ports = ni_json_object_get_value(data, "ports"))) {
+		ni_ovsdb_port_bridge_unset(client, row);
+		ni_string_array_destroy(&row->ports);
+		count = ni_ovsdb_json_set_entries(ports);
+		for (i = 0; i < count; ++i) {
+			if (ni_ovsdb_json_uuid_get(ni_ovsdb_json_set_get(ports, i), &uuid)) {
+				ni_string_array_append(&row->ports, uuid);
+				ni_ovsdb_port_bridge_set(client, uuid, row);
+			}
+			ni_string_free(&uuid);
+		}
+	}
+}
+
+static void
+ni_ovsdb_port_row_set(ni_ovsdb_client_t *client, ni_ovsdb_row_t *row, ni_json_t *data)
+{
+	ni_json_t *tag;
+	int64_t i64;
+
+	ni_ovsdb_row_set_name(&client->ports, row, data);
+
+	if ((tag = ni_json_object_get_value(data, "tag"))) {
+		row->tag = 0;
+		if (ni_json_int64_get(ni_ovsdb_json_set_get(tag, 0), &i64) &&
+		    i64 > 0 && i64 < NI_OVSDB_VLAN_MAX)
+			row->tag = i64;
+	}
+
+	if (ni_json_object_get_value(data, "fake_bridge"))
+		ni_json_bool_get(ni_json_object_get_value(data, "fake_bridge"), &row->fake_bridge);
+}
+
+static void
+ni_ovsdb_client_update(ni_ovsdb_client_t *client, ni_json_t *updates)
+{
+	unsigned int t, tables, r, rows;
+	ni_ovsdb_table_t *table;
+	ni_json_pair_t *tpair, *rpair;
+	ni_ovsdb_row_t *row;
+	const char *uuid;
+	ni_json_t *data;
+
+	tables = ni_json_object_entries(updates);
+	for (t = 0; t < tables; ++t) {
+		tpair = ni_json_object_get_pair_at(updates, t);
+		if (ni_string_eq(ni_json_pair_get_name(tpair), "Bridge"))
+			table = &client->bridges;
+		else
+		if (ni_string_eq(ni_json_pair_get_name(tpair), "Port"))
+			table = &client->ports;
+		else
+			continue;
+
+		rows = ni_json_object_entries(ni_json_pair_get_value(tpair));
+		for (r = 0; r < rows; ++r) {
+			rpair = ni_json_object_get_pair_at(ni_json_pair_get_value(tpair), r);
+			uuid = ni_json_pair_get_name(rpair);
+			data = ni_json_object_get_value(ni_json_pair_get_value(rpair), "new");
+
+			if (!data) {
+				if (table == &client->bridges &&
+				    (row = ni_ovsdb_table_find(table, uuid)))
+					ni_ovsdb_port_bridge_unset(client, row);
+				ni_ovsdb_table_delete(table, uuid);
+			} else
+			if ((row = ni_ovsdb_table_get(table, uuid))) {
+				if (table == &client->bridges)
+					ni_ovsdb_bridge_row_set(client, row, data);
+				else
+					ni_ovsdb_port_row_set(client, row, data);
+			}
+		}
+	}
+}
+
+/*
+ * json-rpc over the stream socket
+ */
+static ni_bool_t
+ni_ovsdb_client_send(ni_ovsdb_client_t *client, ni_json_t *msg)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	struct pollfd pfd;
+	size_t off = 0;
+	ssize_t len;
+
+	if (!ni_json_format_string(&buf, msg, NULL))
+		goto failure;
+
+	ni_debug_verbose(NI_LOG_DEBUG3, NI_TRACE_IFCONFIG, "ovsdb: send %s", buf.string);
+	while (off < buf.len) {
+		len = send(client->fd, buf.string + off, buf.len - off, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN) {
+				ni_error("ovsdb: unable to send to %s: %m", client->path);
+				goto failure;
+			}
+
+			pfd.fd = client->fd;
+			pfd.events = POLLOUT;
+			if (poll(&pfd, 1, NI_OVSDB_TIMEOUT) <= 0) {
+				ni_error("ovsdb: timeout sending to %s", client->path);
+				goto failure;
+			}
+			continue;
+		}
+		off += len;
+	}
+	ni_stringbuf_destroy(&buf);
+	return TRUE;
+
+failure:
+	ni_stringbuf_destroy(&buf);
+	return FALSE;
+}
+
+/* 1: data read, 0: nothing to read, -1: connection lost */
+static int
+ni_ovsdb_client_recv(ni_ovsdb_client_t *client)
+{
+	ni_buffer_t *rbuf = &client->rbuf;
+	ssize_t len;
+
+	if (rbuf->head && rbuf->head == rbuf->tail) {
+		rbuf->head = rbuf->tail = 0;
+	} else
+	if (rbuf->head > rbuf->size / 2) {
+		memmove(rbuf->base, rbuf->base + rbuf->head, rbuf->tail - rbuf->head);
+		rbuf->tail -= rbuf->head;
+		rbuf->head = 0;
+	}
+	ni_buffer_ensure_tailroom(rbuf, NI_OVSDB_READ_CHUNK);
+
+	len = recv(client->fd, ni_buffer_tail(rbuf), ni_buffer_tailroom(rbuf), 0);
+	if (len > 0) {
+		ni_buffer_push_tail(rbuf, len);
+		return 1;
+	}
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+
+	if (len == 0)
+		ni_error("ovsdb: connection to %s closed", client->path);
+	else
+		ni_error("ovsdb: unable to receive from %s: %m", client->path);
+	return -1;
+}
+
+/*
+ * Returns the next complete message in the read buffer, if any.
+ * The messages are just concatenated json objects on the stream.
+ */
+static ni_json_t *
+ni_ovsdb_client_next_message(ni_ovsdb_client_t *client, ni_bool_t *error)
+{
+	const unsigned char *data = ni_buffer_head(&client->rbuf);
+	size_t count = ni_buffer_count(&client->rbuf);
+	ni_buffer_t msgbuf;
+	ni_json_t *msg;
+	int cc;
+
+	while (client->scan.pos < count) {
+		cc = data[client->scan.pos++];
+
+		if (client->scan.string) {
+			if (client->scan.escape)
+				client->scan.escape = FALSE;
+			else if (cc == '\\')
+				client->scan.escape = TRUE;
+			else if (cc == '"')
+				client->scan.string = FALSE;
+			continue;
+		}
+
+		switch (cc) {
+		case '"':
+			client->scan.string = TRUE;
+			continue;
+		case '{':
+		case '[':
+			client->scan.depth++;
+			continue;
+		case '}':
+		case ']':
+			if (client->scan.depth && --client->scan.depth == 0)
+				break;
+			continue;
+		default:
+			continue;
+		}
+
+		ni_buffer_init_reader(&msgbuf, (void *)data, client->scan.pos);
+		if (!(msg = ni_json_parse_buffer(&msgbuf))) {
+			ni_error("ovsdb: unable to parse message from %s", client->path);
+			*error = TRUE;
+		}
+		ni_buffer_pull_head(&client->rbuf, client->scan.pos);
+		memset(&client->scan, 0, sizeof(client->scan));
+		return msg;
+	}
+	return NULL;
+}
+
+static ni_bool_t
+ni_ovsdb_client_echo_reply(ni_ovsdb_client_t *client, ni_json_t *msg)
+{
+	ni_json_t *reply;
+	ni_bool_t ret;
+
+	reply = ni_json_new_object();
+	ni_json_object_set(reply, "id", ni_json_object_ref_value(msg, "id"));
+	ni_json_object_set(reply, "result", ni_json_object_ref_value(msg, "params"));
+	ni_json_object_set(reply, "error", ni_json_new_null());
+	ret = ni_ovsdb_client_send(client, reply);
+	ni_json_free(reply);
+	return ret;
+}
+
+static ni_bool_t
+ni_ovsdb_client_process(ni_ovsdb_client_t *client, ni_json_t *msg)
+{
+	char *method = NULL;
+	ni_bool_t ret = TRUE;
+	int64_t xid;
+
+	if (ni_json_string_get(ni_json_object_get_value(msg, "method"), &method)) {
+		if (ni_string_eq(method, "update")) {
+			ni_ovsdb_client_update(client, ni_json_array_get(
+					ni_json_object_get_value(msg, "params"), 1));
+		} else
+		if (ni_string_eq(method, "echo")) {
+			ret = ni_ovsdb_client_echo_reply(client, msg);
+		}
+		ni_string_free(&method);
+		return ret;
+	}
+
+	if (client->wait_xid &&
+	    ni_json_int64_get(ni_json_object_get_value(msg, "id"), &xid) &&
+	    xid == client->wait_xid) {
+		ni_json_free(client->reply);
+		client->reply = ni_json_ref(msg);
+	}
+	return ret;
+}
+
+static ni_bool_t
+ni_ovsdb_client_dispatch(ni_ovsdb_client_t *client)
+{
+	ni_bool_t error = FALSE;
+	ni_json_t *msg;
+
+	while ((msg = ni_ovsdb_client_next_message(client, &error))) {
+		if (!ni_ovsdb_client_process(client, msg))
+			error = TRUE;
+		ni_json_free(msg);
+		if (error)
+			break;
+	}
+	return !error;
+}
+
+static ni_bool_t
+ni_ovsdb_client_drain(ni_ovsdb_client_t *client)
+{
+	int ret;
+
+	while ((ret = ni_ovsdb_client_recv(client)) > 0) {
+		if (!ni_ovsdb_client_dispatch(client))
+			return FALSE;
+	}
+	return ret == 0;
+}
+
+/*
+ * Sends a request and waits for its reply, processing the update
+ * notifications received meanwhile. Returns the result on success.
+ */
+static ni_json_t *
+ni_ovsdb_client_call(ni_ovsdb_client_t *client, const char *method, ni_json_t *params)
+{
+	struct timeval deadline, now, left;
+	ni_json_t *msg, *error, *result = NULL;
+	struct pollfd pfd;
+	int ret;
+
+	msg = ni_json_new_object();
+	ni_json_object_set(msg, "method", ni_json_new_string(method));
+	ni_json_object_set(msg, "params", params);
+	ni_json_object_set(msg, "id", ni_json_new_int64(++client->xid));
+
+	client->wait_xid = client->xid;
+	ret = ni_ovsdb_client_send(client, msg);
+	ni_json_free(msg);
+	if (!ret)
+		goto failure;
+
+	ni_timer_get_time(&deadline);
+	deadline.tv_sec  += NI_OVSDB_TIMEOUT / 1000;
+	deadline.tv_usec += (NI_OVSDB_TIMEOUT % 1000) * 1000;
+	if (deadline.tv_usec >= 1000000) {
+		deadline.tv_sec++;
+		deadline.tv_usec -= 1000000;
+	}
+
+	while (!client->reply) {
+		if (!ni_ovsdb_client_dispatch(client))
+			goto failure;
+		if (client->reply)
+			break;
+
+		ni_timer_get_time(&now);
+		if (!timercmp(&now, &deadline, <)) {
+			ni_error("ovsdb: %s timed out on %s", method, client->path);
+			goto failure;
+		}
+		timersub(&deadline, &now, &left);
+
+		pfd.fd = client->fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, left.tv_sec * 1000 + left.tv_usec / 1000 + 1) < 0 &&
+		    errno != EINTR) {
+			ni_error("ovsdb: poll failed: %m");
+			goto failure;
+		}
+		if (ni_ovsdb_client_recv(client) < 0)
+			goto failure;
+	}
+	client->wait_xid = 0;
+
+	msg = client->reply;
+	client->reply = NULL;
+	error = ni_json_object_get_value(msg, "error");
+	if (error && !ni_json_is_null(error)) {
+		ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+		ni_error("ovsdb: %s failed: %s", method,
+				ni_json_format_string(&buf, error, NULL));
+		ni_stringbuf_destroy(&buf);
+	} else {
+		result = ni_json_object_ref_value(msg, "result");
+	}
+	ni_json_free(msg);
+	return result;
+
+failure:
+	client->wait_xid = 0;
+	ni_ovsdb_client_disconnect(client);
+	return NULL;
+}
+
+/*
+ * client connection
+ */
+ni_ovsdb_client_t *
+ni_ovsdb_client_new(const char *path)
+{
+	ni_ovsdb_client_t *client;
+
+	client = xcalloc(1, sizeof(*client));
+	ni_string_dup(&client->path, path ? path : NI_OVSDB_DEFAULT_SOCKET);
+	ni_buffer_init_dynamic(&client->rbuf, NI_OVSDB_READ_CHUNK);
+	client->fd = -1;
+	return client;
+}
+
+void
+ni_ovsdb_client_free(ni_ovsdb_client_t *client)
+{
+	if (!client)
+		return;
+
+	ni_ovsdb_client_disconnect(client);
+	ni_buffer_destroy(&client->rbuf);
+	ni_string_free(&client->path);
+	free(client);
+}
+
+void
+ni_ovsdb_client_disconnect(ni_ovsdb_client_t *client)
+{
+	if (client->fd >= 0) {
+		close(client->fd);
+		client->fd = -1;
+	}
+	ni_buffer_clear(&client->rbuf);
+	memset(&client->scan, 0, sizeof(client->scan));
+	ni_json_free(client->reply);
+	client->reply = NULL;
+
+	ni_ovsdb_port_bridge_clear(client);
+	ni_ovsdb_table_clear(&client->bridges);
+	ni_ovsdb_table_clear(&client->ports);
+}
+
+static ni_json_t *
+ni_ovsdb_monitor_columns(const char *first, ...)
+{
+	ni_json_t *request, *columns;
+	const char *column;
+	va_list ap;
+
+	columns = ni_json_new_array();
+	va_start(ap, first);
+	for (column = first; column; column = va_arg(ap, const char *))
+		ni_json_array_append(columns, ni_json_new_string(column));
+	va_end(ap);
+
+	request = ni_json_new_object();
+	ni_json_object_set(request, "columns", columns);
+	return request;
+}
+
+ni_bool_t
+ni_ovsdb_client_connect(ni_ovsdb_client_t *client)
+{
+	struct sockaddr_un sun;
+	ni_json_t *params, *requests, *result;
+
+	if (!client)
+		return FALSE;
+	if (client->fd >= 0)
+		return TRUE;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (ni_string_len(client->path) >= sizeof(sun.sun_path)) {
+		ni_error("ovsdb: socket path %s too long", client->path);
+		return FALSE;
+	}
+	strcpy(sun.sun_path, client->path);
+
+	client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (client->fd < 0) {
+		ni_error("ovsdb: unable to create socket: %m");
+		return FALSE;
+	}
+	if (connect(client->fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		ni_debug_ifconfig("ovsdb: unable to connect to %s: %m", client->path);
+		ni_ovsdb_client_disconnect(client);
+		return FALSE;
+	}
+
+	requests = ni_json_new_object();
+	ni_json_object_set(requests, "Bridge",
+			ni_ovsdb_monitor_columns("name", "ports", NULL));
+	ni_json_object_set(requests, "Port",
+			ni_ovsdb_monitor_columns("name", "tag", "fake_bridge", NULL));
+
+	params = ni_json_new_array();
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_DATABASE));
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_MONITOR_ID));
+	ni_json_array_append(params, requests);
+
+	if (!(result = ni_ovsdb_client_call(client, "monitor", params))) {
+		ni_ovsdb_client_disconnect(client);
+		return FALSE;
+	}
+	ni_ovsdb_client_update(client, result);
+	ni_json_free(result);
+
+	ni_debug_ifconfig("ovsdb: monitoring %s, %u bridges and %u ports", client->path,
+			client->bridges.count, client->ports.count);
+	return TRUE;
+}
+
+/*
+ * Applies the pending monitor updates; a flush waits for an echo
+ * reply, so all updates sent before it are applied as well.
+ */
+ni_bool_t
+ni_ovsdb_client_sync(ni_ovsdb_client_t *client, ni_bool_t flush)
+{
+	ni_json_t *result;
+
+	if (!ni_ovsdb_client_connect(client))
+		return FALSE;
+
+	if (!flush) {
+		if (ni_ovsdb_client_drain(client))
+			return TRUE;
+		ni_ovsdb_client_disconnect(client);
+		return FALSE;
+	}
+
+	if (!(result = ni_ovsdb_client_call(client, "echo", ni_json_new_array())))
+		return FALSE;
+	ni_json_free(result);
+	return TRUE;
+}
+
+/*
+ * bridge and port queries with the ovs-vsctl semantics: a bridge is
+ * either a Bridge row or the local port of a fake (vlan) bridge, that
+ * owns the ports of its parent bridge with the same tag.
+ */
+static ni_ovsdb_row_t *
+ni_ovsdb_bridge_fake_by_tag(ni_ovsdb_client_t *client, ni_ovsdb_row_t *bridge, unsigned int tag)
+{
+	ni_ovsdb_row_t *port;
+	unsigned int i;
+
+	for (i = 0; tag && i < bridge->ports.count; ++i) {
+		port = ni_ovsdb_table_find(&client->ports, bridge->ports.data[i]);
+		if (port && port->fake_bridge && port->tag == tag)
+			return port;
+	}
+	return NULL;
+}
+
+static ni_bool_t
+ni_ovsdb_bridge_find(ni_ovsdb_client_t *client, const char *brname,
+			ni_ovsdb_row_t **bridge, ni_ovsdb_row_t **fake)
+{
+	*fake = NULL;
+	if ((*bridge = ni_ovsdb_table_find_name(&client->bridges, brname)))
+		return TRUE;
+
+	*fake = ni_ovsdb_table_find_name(&client->ports, brname);
+	if (*fake && (*fake)->fake_bridge &&
+	    (*bridge = ni_ovsdb_port_bridge(client, (*fake)->uuid)))
+		return TRUE;
+
+	*bridge = *fake = NULL;
+	return FALSE;
+}
+
+/* looks up the bridge, flushing pending updates on a miss */
+static int
+ni_ovsdb_bridge_lookup(ni_ovsdb_client_t *client, const char *brname,
+			ni_ovsdb_row_t **bridge, ni_ovsdb_row_t **fake)
+{
+	if (ni_string_empty(brname) || !ni_ovsdb_client_sync(client, FALSE))
+		return -1;
+
+	if (ni_ovsdb_bridge_find(client, brname, bridge, fake))
+		return 0;
+
+	if (!ni_ovsdb_client_sync(client, TRUE))
+		return -1;
+
+	return ni_ovsdb_bridge_find(client, brname, bridge, fake) ? 0 : 1;
+}
+
+int
+ni_ovsdb_bridge_exists(ni_ovsdb_client_t *client, const char *brname)
+{
+	ni_ovsdb_row_t *bridge, *fake;
+
+	return ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake);
+}
+
+int
+ni_ovsdb_bridge_to_parent(ni_ovsdb_client_t *client, const char *brname, char **parent)
+{
+	ni_ovsdb_row_t *bridge, *fake;
+
+	if (!parent || ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake))
+		return -1;
+
+	if (fake)
+		ni_string_dup(parent, bridge->name);
+	return 0;
+}
+
+int
+ni_ovsdb_bridge_to_vlan(ni_ovsdb_client_t *client, const char *brname, uint16_t *vlan)
+{
+	ni_ovsdb_row_t *bridge, *fake;
+
+	if (!vlan || ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake))
+		return -1;
+
+	*vlan = fake ? fake->tag : 0;
+	return 0;
+}
+
+static int
+ni_ovsdb_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+int
+ni_ovsdb_bridge_ports(ni_ovsdb_client_t *client, const char *brname,
+			ni_ovs_bridge_port_array_t *ports)
+{
+	unsigned char fakes[NI_OVSDB_VLAN_MAX / 8];
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_ovsdb_row_t *bridge, *fake, *port;
+	unsigned int i;
+
+	if (!ports || ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake))
+		return -1;
+
+	/* the tags of the fake bridges owning the tagged ports */
+	memset(fakes, 0, sizeof(fakes));
+	for (i = 0; !fake && i < bridge->ports.count; ++i) {
+		port = ni_ovsdb_table_find(&client->ports, bridge->ports.data[i]);
+		if (port && port->fake_bridge && port->tag)
+			fakes[port->tag / 8] |= 1 << (port->tag % 8);
+	}
+
+	for (i = 0; i < bridge->ports.count; ++i) {
+		port = ni_ovsdb_table_find(&client->ports, bridge->ports.data[i]);
+		if (!port || !port->name || port->fake_bridge)
+			continue;
+
+		if (fake) {
+			if (port->tag != fake->tag)
+				continue;
+		} else {
+			if (ni_string_eq(port->name, bridge->name))
+				continue;
+			if (fakes[port->tag / 8] & (1 << (port->tag % 8)))
+				continue;
+		}
+		ni_string_array_append(&names, port->name);
+	}
+
+	if (names.count)
+		qsort(names.data, names.count, sizeof(names.data[0]), ni_ovsdb_name_cmp);
+	for (i = 0; i < names.count; ++i)
+		ni_ovs_bridge_port_array_add_new(ports, names.data[i]);
+	ni_string_array_destroy(&names);
+	return 0;
+}
+
+static ni_ovsdb_row_t *
+ni_ovsdb_port_find(ni_ovsdb_client_t *client, const char *pname, ni_ovsdb_row_t **bridge)
+{
+	ni_ovsdb_row_t *port;
+
+	port = ni_ovsdb_table_find_name(&client->ports, pname);
+	if (!port || port->fake_bridge)
+		return NULL;
+	if (!(*bridge = ni_ovsdb_port_bridge(client, port->uuid)))
+		return NULL;
+	return port;
+}
+
+int
+ni_ovsdb_bridge_port_to_bridge(ni_ovsdb_client_t *client, const char *pname, char **brname)
+{
+	ni_ovsdb_row_t *bridge, *port, *fake;
+
+	if (ni_string_empty(pname) || !brname || !ni_ovsdb_client_sync(client, FALSE))
+		return -1;
+
+	if (!(port = ni_ovsdb_port_find(client, pname, &bridge))) {
+		if (!ni_ovsdb_client_sync(client, TRUE))
+			return -1;
+		if (!(port = ni_ovsdb_port_find(client, pname, &bridge)))
+			return -1;
+	}
+
+	if ((fake = ni_ovsdb_bridge_fake_by_tag(client, bridge, port->tag)))
+		ni_string_dup(brname, fake->name);
+	else
+		ni_string_dup(brname, bridge->name);
+	return 0;
+}
+
+/*
+ * transactions
+ */
+static void
+ni_ovsdb_op_insert(ni_json_t *params, const char *table, ni_json_t *row, const char *uuid_name)
+{
+	ni_json_t *op = ni_json_new_object();
+
+	ni_json_object_set(op, "op", ni_json_new_string("insert"));
+	ni_json_object_set(op, "table", ni_json_new_string(table));
+	ni_json_object_set(op, "row", row);
+	ni_json_object_set(op, "uuid-name", ni_json_new_string(uuid_name));
+	ni_json_array_append(params, op);
+}
+
+static ni_json_t *
+ni_ovsdb_mutation(const char *column, const char *mutator, ni_json_t *value)
+{
+	ni_json_t *mutation = ni_json_new_array();
+
+	ni_json_array_append(mutation, ni_json_new_string(column));
+	ni_json_array_append(mutation, ni_json_new_string(mutator));
+	ni_json_array_append(mutation, value);
+	return mutation;
+}
+
+/* mutates the rows with the given name or all rows without a name */
+static void
+ni_ovsdb_op_mutate(ni_json_t *params, const char *table, const char *name, ni_json_t *mutation)
+{
+	ni_json_t *op, *where, *mutations;
+
+	where = ni_json_new_array();
+	if (name) {
+		ni_json_t *cond = ni_json_new_array();
+
+		ni_json_array_append(cond, ni_json_new_string("name"));
+		ni_json_array_append(cond, ni_json_new_string("=="));
+		ni_json_array_append(cond, ni_json_new_string(name));
+		ni_json_array_append(where, cond);
+	}
+
+	mutations = ni_json_new_array();
+	ni_json_array_append(mutations, mutation);
+
+	op = ni_json_new_object();
+	ni_json_object_set(op, "op", ni_json_new_string("mutate"));
+	ni_json_object_set(op, "table", ni_json_new_string(table));
+	ni_json_object_set(op, "where", where);
+	ni_json_object_set(op, "mutations", mutations);
+	ni_json_array_append(params, op);
+}
+
+/* inserts the interface and port rows of a new port named pname */
+static void
+ni_ovsdb_op_insert_port(ni_json_t *params, const char *pname, unsigned int tag,
+			ni_bool_t fake_bridge, ni_bool_t internal)
+{
+	ni_json_t *row;
+
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(pname));
+	if (internal)
+		ni_json_object_set(row, "type", ni_json_new_string("internal"));
+	ni_ovsdb_op_insert(params, "Interface", row, "iface");
+
+	row = ni_json_new_object();
+	ni_json_object_set(row, "name", ni_json_new_string(pname));
+	ni_json_object_set(row, "interfaces", ni_ovsdb_json_uuid("named-uuid", "iface"));
+	if (tag)
+		ni_json_object_set(row, "tag", ni_json_new_int64(tag));
+	if (fake_bridge)
+		ni_json_object_set(row, "fake_bridge", ni_json_new_bool(TRUE));
+	ni_ovsdb_op_insert(params, "Port", row, "port");
+}
+
+static ni_json_t *
+ni_ovsdb_transact_new(void)
+{
+	ni_json_t *params = ni_json_new_array();
+
+	ni_json_array_append(params, ni_json_new_string(NI_OVSDB_DATABASE));
+	return params;
+}
+
+static int
+ni_ovsdb_transact(ni_ovsdb_client_t *client, ni_json_t *params)
+{
+	ni_json_t *result, *error;
+	unsigned int i, count;
+	char *err = NULL, *details = NULL;
+	int ret = 0;
+
+	/* ask ovs-vswitchd to reconfigure, as ovs-vsctl does */
+	ni_ovsdb_op_mutate(params, NI_OVSDB_DATABASE, NULL,
+			ni_ovsdb_mutation("next_cfg", "+=", ni_json_new_int64(1)));
+
+	if (!(result = ni_ovsdb_client_call(client, "transact", params)))
+		return -1;
+
+	count = ni_json_array_entries(result);
+	for (i = 0; i < count; ++i) {
+		error = ni_json_object_get_value(ni_json_array_get(result, i), "error");
+		if (!ni_json_string_get(error, &err))
+			continue;
+
+		ni_json_string_get(ni_json_object_get_value(ni_json_array_get(result, i),
+					"details"), &details);
+		ni_error("ovsdb: transaction failed: %s%s%s", err,
+				details ? ": " : "", details ? details : "");
+		ni_string_free(&err);
+		ni_string_free(&details);
+		ret = -1;
+		break;
+	}
+	ni_json_free(result);
+	return ret;
+}
+
+int
+ni_ovsdb_bridge_add(ni_ovsdb_client_t *client, const char *brname,
+			const char *parent, uint16_t vlan, ni_bool_t may_exist)
+{
+	ni_ovsdb_row_t *bridge, *fake;
+	ni_json_t *params, *row;
+	int ret;
+
+	if (ni_string_empty(parent))
+		parent = NULL;
+
+	if (!ni_ovsdb_client_sync(client, TRUE))
+		return -1;
+	if ((ret = ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake)) < 0)
+		return -1;
+
+	if (ret == 0) {
+		if (!may_exist) {
+			ni_error("ovsdb: bridge %s already exists", brname);
+			return -1;
+		}
+		if (parent && (!fake || !ni_string_eq(bridge->name, parent) || fake->tag != vlan)) {
+			ni_error("ovsdb: bridge %s exists, but is not a vlan %u bridge of %s",
+					brname, vlan, parent);
+			return -1;
+		}
+		if (!parent && fake) {
+			ni_error("ovsdb: bridge %s exists as a vlan bridge", brname);
+			return -1;
+		}
+		return 0;
+	}
+
+	params = ni_ovsdb_transact_new();
+	if (parent) {
+		if (ni_ovsdb_bridge_lookup(client, parent, &bridge, &fake) || fake) {
+			ni_error("ovsdb: parent bridge %s of %s does not exist", parent, brname);
+			ni_json_free(params);
+			return -1;
+		}
+		if (!vlan || vlan >= NI_OVSDB_VLAN_MAX) {
+			ni_error("ovsdb: invalid vlan %u of bridge %s", vlan, brname);
+			ni_json_free(params);
+			return -1;
+		}
+
+		ni_ovsdb_op_insert_port(params, brname, vlan, TRUE, TRUE);
+		ni_ovsdb_op_mutate(params, "Bridge", parent, ni_ovsdb_mutation("ports",
+				"insert", ni_ovsdb_json_uuid("named-uuid", "port")));
+	} else {
+		ni_ovsdb_op_insert_port(params, brname, 0, FALSE, TRUE);
+
+		row = ni_json_new_object();
+		ni_json_object_set(row, "name", ni_json_new_string(brname));
+		ni_json_object_set(row, "ports", ni_ovsdb_json_uuid("named-uuid", "port"));
+		ni_ovsdb_op_insert(params, "Bridge", row, "bridge");
+
+		ni_ovsdb_op_mutate(params, NI_OVSDB_DATABASE, NULL, ni_ovsdb_mutation("bridges",
+				"insert", ni_ovsdb_json_uuid("named-uuid", "bridge")));
+	}
+
+	ni_debug_ifconfig("ovsdb: adding bridge %s", brname);
+	return ni_ovsdb_transact(client, params);
+}
+
+int
+ni_ovsdb_bridge_del(ni_ovsdb_client_t *client, const char *brname)
+{
+	ni_ovsdb_row_t *bridge, *fake, *port;
+	ni_json_t *params, *uuids, *set;
+	unsigned int i;
+
+	if (!ni_ovsdb_client_sync(client, TRUE))
+		return -1;
+	if (ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake)) {
+		ni_error("ovsdb: bridge %s does not exist", brname);
+		return -1;
+	}
+
+	params = ni_ovsdb_transact_new();
+	if (fake) {
+		/* the fake bridge port and the ports with its tag */
+		uuids = ni_json_new_array();
+		for (i = 0; i < bridge->ports.count; ++i) {
+			port = ni_ovsdb_table_find(&client->ports, bridge->ports.data[i]);
+			if (port && port->tag == fake->tag)
+				ni_json_array_append(uuids, ni_ovsdb_json_uuid("uuid", port->uuid));
+		}
+		set = ni_json_new_array();
+		ni_json_array_append(set, ni_json_new_string("set"));
+		ni_json_array_append(set, uuids);
+
+		ni_ovsdb_op_mutate(params, "Bridge", bridge->name,
+				ni_ovsdb_mutation("ports", "delete", set));
+	} else {
+		ni_ovsdb_op_mutate(params, NI_OVSDB_DATABASE, NULL, ni_ovsdb_mutation("bridges",
+				"delete", ni_ovsdb_json_uuid("uuid", bridge->uuid)));
+	}
+
+	ni_debug_ifconfig("ovsdb: deleting bridge %s", brname);
+	return ni_ovsdb_transact(client, params);
+}
+
+int
+ni_ovsdb_bridge_port_add(ni_ovsdb_client_t *client, const char *brname,
+			const char *pname, ni_bool_t may_exist)
+{
+	ni_ovsdb_row_t *bridge, *fake, *port, *owner;
+	ni_json_t *params;
+
+	if (ni_string_empty(pname) || !ni_ovsdb_client_sync(client, TRUE))
+		return -1;
+
+	if (ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake)) {
+		ni_error("ovsdb: bridge %s does not exist", brname);
+		return -1;
+	}
+
+	if ((port = ni_ovsdb_port_find(client, pname, &owner))) {
+		if (!may_exist) {
+			ni_error("ovsdb: port %s already exists", pname);
+			return -1;
+		}
+		if (owner != bridge || (fake ? fake->tag : 0) != port->tag) {
+			ni_error("ovsdb: port %s already exists on another bridge", pname);
+			return -1;
+		}
+		return 0;
+	}
+
+	params = ni_ovsdb_transact_new();
+	ni_ovsdb_op_insert_port(params, pname, fake ? fake->tag : 0, FALSE, FALSE);
+	ni_ovsdb_op_mutate(params, "Bridge", bridge->name, ni_ovsdb_mutation("ports",
+			"insert", ni_ovsdb_json_uuid("named-uuid", "port")));
+
+	ni_debug_ifconfig("ovsdb: adding port %s to bridge %s", pname, brname);
+	return ni_ovsdb_transact(client, params);
+}
+
+int
+ni_ovsdb_bridge_port_del(ni_ovsdb_client_t *client, const char *brname, const char *pname)
+{
+	ni_ovsdb_row_t *bridge, *fake, *port, *owner;
+	ni_json_t *params;
+
+	if (ni_string_empty(pname) || !ni_ovsdb_client_sync(client, TRUE))
+		return -1;
+
+	if (ni_ovsdb_bridge_lookup(client, brname, &bridge, &fake)) {
+		ni_error("ovsdb: bridge %s does not exist", brname);
+		return -1;
+	}
+
+	port = ni_ovsdb_port_find(client, pname, &owner);
+	if (!port || owner != bridge || (fake && fake->tag != port->tag)) {
+		ni_error("ovsdb: bridge %s does not have a port %s", brname, pname);
+		return -1;
+	}
+
+	params = ni_ovsdb_transact_new();
+	ni_ovsdb_op_mutate(params, "Bridge", bridge->name, ni_ovsdb_mutation("ports",
+			"delete", ni_ovsdb_json_uuid("uuid", port->uuid)));
+
+	ni_debug_ifconfig("ovsdb: deleting port %s from bridge %s", pname, brname);
+	return ni_ovsdb_transact(client, params);
+}
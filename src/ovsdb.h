@@ -0,0 +1,44 @@
+/*
+ * OVSDB (RFC 7047) JSON-RPC client of the Open_vSwitch database.
+ *
+ * The client connects to the local ovsdb-server unix socket and keeps
+ * a monitor subscription of the Bridge and Port tables, so the bridge,
+ * fake (vlan) bridge and port queries are answered from an in-memory
+ * cache with the semantics of the ovs-vsctl commands of the same name,
+ * while add and delete operations are single transactions.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifndef NI_WICKED_OVSDB_H
+#define NI_WICKED_OVSDB_H
+
+#include <wicked/types.h>
+#include <wicked/ovs.h>
+
+#define NI_OVSDB_DEFAULT_SOCKET		"/var/run/openvswitch/db.sock"
+#define NI_OVSDB_TIMEOUT		5000	/* msec */
+
+typedef struct ni_ovsdb_client		ni_ovsdb_client_t;
+
+extern ni_ovsdb_client_t *	ni_ovsdb_client_new(const char *path);
+extern void			ni_ovsdb_client_free(ni_ovsdb_client_t *);
+extern ni_bool_t		ni_ovsdb_client_connect(ni_ovsdb_client_t *);
+extern void			ni_ovsdb_client_disconnect(ni_ovsdb_client_t *);
+extern ni_bool_t		ni_ovsdb_client_sync(ni_ovsdb_client_t *, ni_bool_t);
+
+extern int			ni_ovsdb_bridge_exists(ni_ovsdb_client_t *, const char *);
+extern int			ni_ovsdb_bridge_to_parent(ni_ovsdb_client_t *, const char *, char **);
+extern int			ni_ovsdb_bridge_to_vlan(ni_ovsdb_client_t *, const char *, uint16_t *);
+extern int			ni_ovsdb_bridge_ports(ni_ovsdb_client_t *, const char *,
+						ni_ovs_bridge_port_array_t *);
+extern int			ni_ovsdb_bridge_port_to_bridge(ni_ovsdb_client_t *, const char *, char **);
+
+extern int			ni_ovsdb_bridge_add(ni_ovsdb_client_t *, const char *,
+						const char *, uint16_t, ni_bool_t);
+extern int			ni_ovsdb_bridge_del(ni_ovsdb_client_t *, const char *);
+extern int			ni_ovsdb_bridge_port_add(ni_ovsdb_client_t *, const char *,
+						const char *, ni_bool_t);
+extern int			ni_ovsdb_bridge_port_del(ni_ovsdb_client_t *, const char *,
+						const char *);
+
+#endif /* NI_WICKED_OVSDB_H */
@@ -19,6 +19,7 @@
 #include <wicked/socket.h>
 #include "socket_priv.h"
 #include "process.h"
+#include "trace-ring.h"
 
 static int				__ni_process_run(ni_process_t *, int *);
 static int				__ni_process_run_info(ni_process_t *);
@@ -523,6 +524,7 @@ __ni_process_run(ni_process_t *pi, int *pfd)
 		int maxfd;
 		int fd;
 
+		ni_trace_ring_detach();
 		if (chdir("/") < 0)
 			ni_warn("%s: unable to chdir to /: %m", __func__);
 
@@ -37,6 +37,7 @@
 #include <wicked/route.h>
 #include "util_priv.h"
 #include "debug.h"
+#include "memstat.h"
 
 #define NI_ROUTE_ARRAY_CHUNK		16
 #define NI_RULE_ARRAY_CHUNK		4
@@ -162,6 +163,7 @@ ni_route_new(void)
 	rp = xcalloc(1, sizeof(ni_route_t));
 	if (rp)
 		rp->users = 1;
+	ni_memstat_alloc(NI_MEMSTAT_ROUTE, rp);
 	return rp;
 }
 
@@ -312,6 +314,7 @@ do_route_free(ni_route_t *rp)
 	ni_route_nexthop_list_destroy(&rp->nh.next);
 	ni_route_nexthop_destroy(&rp->nh);
 
+	ni_memstat_free(NI_MEMSTAT_ROUTE, rp);
 	free(rp);
 }
 
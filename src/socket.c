@@ -27,6 +27,8 @@
 #include "netinfo_priv.h"
 #include "socket_priv.h"
 #include "appconfig.h"
+#include "metrics.h"
+#include "memstat.h"
 
 #define	NI_SOCKET_ARRAY_CHUNK	16
 
@@ -116,9 +118,11 @@ __ni_default_hangup_handler(ni_socket_t *sock)
 int
 ni_socket_array_wait(ni_socket_array_t *array, long timeout)
 {
+	static ni_metric_t *metric;
 	struct pollfd pfd[array->count];
 	struct timeval now, expires;
 	unsigned int i, socket_count;
+	struct timespec start;
 
 	/* First step - cleanup empty socket slots from the array. */
 	ni_socket_array_cleanup(array);
@@ -171,6 +175,11 @@ ni_socket_array_wait(ni_socket_array_t *array, long timeout)
 		return -1;
 	}
 
+	/* the time spent handling the events and timeouts of a wakeup */
+	if (!metric)
+		metric = ni_metric_get("socket.loop");
+	ni_metric_start(&start);
+
 	for (i = 0; i < socket_count; ++i) {
 		ni_socket_t *sock = array->data[i];
 
@@ -234,6 +243,8 @@ done_with_this_socket:
 	/* Finally cleanup deactivated/released sockets */
 	ni_socket_array_cleanup(array);
 
+	ni_metric_stop(metric, &start, FALSE);
+	ni_memstat_tick(&start);
 	return 0;
 }
 
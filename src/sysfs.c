@@ -9,6 +9,8 @@
 
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <net/if_arp.h>
 
 #include <wicked/netinfo.h>
@@ -51,6 +53,7 @@ static int		__ni_sysfs_netif_put_attr(const char *, const char *, const char *);
 static int		__ni_sysfs_printf(const char *, const char *, ...);
 static int		__ni_sysfs_read_list(const char *, ni_string_array_t *);
 static int		__ni_sysfs_read_string(const char *, char **);
+static const char *	__ni_sysfs_read_attr(int, const char *, char *, size_t);
 
 
 /*
@@ -200,19 +203,9 @@ __ni_sysfs_netif_get_attr(const char *ifname, const char *attr_name)
 {
 	static char buffer[256];
 	const char *filename;
-	char *result = NULL;
-	FILE *fp;
 
 	filename = __ni_sysfs_netif_attrpath(ifname, attr_name);
-	if (!(fp = fopen(filename, "r")))
-		return NULL;
-
-	if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-		buffer[strcspn(buffer, "\n")] = '\0';
-		result = buffer;
-	}
-	fclose(fp);
-	return result;
+	return __ni_sysfs_read_attr(AT_FDCWD, filename, buffer, sizeof(buffer));
 }
 
 static int
@@ -250,6 +243,193 @@ __ni_sysfs_netif_attrpath(const char *ifname, const char *attr_name)
 	return pathbuf;
 }
 
+/*
+ * Read the first line of an attribute file relative to dirfd
+ * into the caller supplied buffer, without the trailing newline.
+ * Returns NULL when the attribute cannot be opened or read.
+ */
+static const char *
+__ni_sysfs_read_attr(int dirfd, const char *attr_name, char *buffer, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	if (!attr_name || !buffer || size < 2)
+		return NULL;
+
+	if ((fd = openat(dirfd, attr_name, O_RDONLY | O_CLOEXEC)) < 0)
+		return NULL;
+
+	do {
+		len = pread(fd, buffer, size - 1, 0);
+	} while (len < 0 && errno == EINTR);
+	close(fd);
+
+	if (len < 0)
+		return NULL;
+
+	buffer[len] = '\0';
+	buffer[strcspn(buffer, "\n")] = '\0';
+	return buffer;
+}
+
+/*
+ * Attribute directory handles.
+ *
+ * The directory is opened once with O_PATH; the attributes are then
+ * read via openat/pread into a stack buffer, which avoids the path
+ * lookup from / and the stdio setup for every single attribute.
+ */
+ni_bool_t
+ni_sysfs_dir_open(ni_sysfs_dir_t *dir, const char *path)
+{
+	int fd;
+
+	if (!dir || ni_string_empty(path))
+		return FALSE;
+
+	ni_sysfs_dir_close(dir);
+	if ((fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC)) < 0)
+		return FALSE;
+
+	dir->fd = fd;
+	ni_string_dup(&dir->path, path);
+	return TRUE;
+}
+
+ni_bool_t
+ni_sysfs_netif_dir_open(ni_sysfs_dir_t *dir, const char *ifname, const char *subdir)
+{
+	char pathbuf[PATH_MAX];
+
+	if (ni_string_empty(ifname))
+		return FALSE;
+
+	if (subdir)
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s/%s",
+				_PATH_SYS_CLASS_NET, ifname, subdir);
+	else
+		snprintf(pathbuf, sizeof(pathbuf), "%s/%s",
+				_PATH_SYS_CLASS_NET, ifname);
+
+	return ni_sysfs_dir_open(dir, pathbuf);
+}
+
+void
+ni_sysfs_dir_close(ni_sysfs_dir_t *dir)
+{
+	if (!dir)
+		return;
+
+	if (dir->fd >= 0)
+		close(dir->fd);
+	dir->fd = -1;
+	ni_string_free(&dir->path);
+}
+
+const char *
+ni_sysfs_dir_read(const ni_sysfs_dir_t *dir, const char *attr_name, char *buffer, size_t size)
+{
+	if (!dir || dir->fd < 0)
+		return NULL;
+
+	return __ni_sysfs_read_attr(dir->fd, attr_name, buffer, size);
+}
+
+int
+ni_sysfs_dir_get_int(const ni_sysfs_dir_t *dir, const char *attr_name, int *result)
+{
+	char buffer[256];
+
+	if (!result || !ni_sysfs_dir_read(dir, attr_name, buffer, sizeof(buffer)))
+		return -1;
+
+	*result = strtol(buffer, NULL, 0);
+	return 0;
+}
+
+int
+ni_sysfs_dir_get_uint(const ni_sysfs_dir_t *dir, const char *attr_name, unsigned int *result)
+{
+	char buffer[256];
+
+	if (!result || !ni_sysfs_dir_read(dir, attr_name, buffer, sizeof(buffer)))
+		return -1;
+
+	*result = strtoul(buffer, NULL, 0);
+	return 0;
+}
+
+int
+ni_sysfs_dir_get_ulong(const ni_sysfs_dir_t *dir, const char *attr_name, unsigned long *result)
+{
+	char buffer[256];
+
+	if (!result || !ni_sysfs_dir_read(dir, attr_name, buffer, sizeof(buffer)))
+		return -1;
+
+	*result = strtoul(buffer, NULL, 0);
+	return 0;
+}
+
+int
+ni_sysfs_dir_get_string(const ni_sysfs_dir_t *dir, const char *attr_name, char **result)
+{
+	char buffer[256];
+
+	if (!result || !ni_sysfs_dir_read(dir, attr_name, buffer, sizeof(buffer)))
+		return -1;
+
+	ni_string_dup(result, buffer);
+	return 0;
+}
+
+/*
+ * Read a set of attributes from an open directory handle in one go.
+ * Values of attributes that can't be read are left untouched.
+ * Returns the number of attributes read successfully.
+ */
+unsigned int
+ni_sysfs_dir_get_attrs(const ni_sysfs_dir_t *dir, const ni_sysfs_attr_t *attrs, unsigned int count)
+{
+	const ni_sysfs_attr_t *attr;
+	char buffer[256];
+	unsigned int i, n = 0;
+
+	if (!dir || dir->fd < 0 || !attrs)
+		return 0;
+
+	for (i = 0, attr = attrs; i < count && attr->name; ++i, ++attr) {
+		if (!attr->value)
+			continue;
+
+		if (!__ni_sysfs_read_attr(dir->fd, attr->name, buffer, sizeof(buffer)))
+			continue;
+
+		switch (attr->type) {
+		case NI_SYSFS_ATTR_INT:
+			*(int *)attr->value = strtol(buffer, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_UINT:
+			*(unsigned int *)attr->value = strtoul(buffer, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_LONG:
+			*(long *)attr->value = strtol(buffer, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_ULONG:
+			*(unsigned long *)attr->value = strtoul(buffer, NULL, 0);
+			break;
+		case NI_SYSFS_ATTR_STRING:
+			ni_string_dup((char **)attr->value, buffer);
+			break;
+		default:
+			continue;
+		}
+		n++;
+	}
+	return n;
+}
+
 /*
  * Bonding support
  */
@@ -413,23 +593,44 @@ done:
 void
 ni_sysfs_bridge_get_config(const char *ifname, ni_bridge_t *bridge)
 {
-	unsigned int  ui;
-	unsigned long ul;
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
 
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/stp_state", &ui) == 0)
-		bridge->stp = ui ? TRUE : FALSE;
+	if (!ni_sysfs_netif_dir_open(&dir, ifname, SYSFS_BRIDGE_ATTR))
+		return;
 
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/priority", &ui) == 0)
-		bridge->priority = ui;
+	ni_sysfs_bridge_dir_get_config(&dir, bridge);
+	ni_sysfs_dir_close(&dir);
+}
 
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/forward_delay", &ui) == 0)
-		bridge->forward_delay = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/ageing_time", &ul) == 0)
-		bridge->ageing_time = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/hello_time", &ui) == 0)
-		bridge->hello_time = (double)ui / 100.0;
-	if (ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/max_age", &ui) == 0)
-		bridge->max_age = (double)ui / 100.0;
+void
+ni_sysfs_bridge_dir_get_config(const ni_sysfs_dir_t *dir, ni_bridge_t *bridge)
+{
+	unsigned int stp_state = -1U, priority = -1U;
+	unsigned long forward_delay = -1UL, ageing_time = -1UL;
+	unsigned long hello_time = -1UL, max_age = -1UL;
+	const ni_sysfs_attr_t attrs[] = {
+		{ "stp_state",		NI_SYSFS_ATTR_UINT,	&stp_state	},
+		{ "priority",		NI_SYSFS_ATTR_UINT,	&priority	},
+		{ "forward_delay",	NI_SYSFS_ATTR_ULONG,	&forward_delay	},
+		{ "ageing_time",	NI_SYSFS_ATTR_ULONG,	&ageing_time	},
+		{ "hello_time",		NI_SYSFS_ATTR_ULONG,	&hello_time	},
+		{ "max_age",		NI_SYSFS_ATTR_ULONG,	&max_age	},
+	};
+
+	ni_sysfs_dir_get_attrs(dir, attrs, sizeof(attrs)/sizeof(attrs[0]));
+
+	if (stp_state != -1U)
+		bridge->stp = stp_state ? TRUE : FALSE;
+	if (priority != -1U)
+		bridge->priority = priority;
+	if (forward_delay != -1UL)
+		bridge->forward_delay = (double)forward_delay / 100.0;
+	if (ageing_time != -1UL)
+		bridge->ageing_time = (double)ageing_time / 100.0;
+	if (hello_time != -1UL)
+		bridge->hello_time = (double)hello_time / 100.0;
+	if (max_age != -1UL)
+		bridge->max_age = (double)max_age / 100.0;
 }
 
 int
@@ -470,18 +671,34 @@ ni_sysfs_bridge_update_config(const char *ifname, const ni_bridge_t *bridge)
 void
 ni_sysfs_bridge_get_status(const char *ifname, ni_bridge_status_t *bs)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/stp_state", &bs->stp_state);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/root_id", &bs->root_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/bridge_id", &bs->bridge_id);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_ATTR "/group_addr", &bs->group_addr);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_port", &bs->root_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/root_path_cost", &bs->root_path_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change", &bs->topology_change);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_ATTR "/topology_change_detected", &bs->topology_change_detected);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/gc_timer", &bs->gc_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/tcn_timer", &bs->tcn_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/hello_timer", &bs->hello_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_ATTR "/topology_change_timer", &bs->topology_change_timer);
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+
+	if (!ni_sysfs_netif_dir_open(&dir, ifname, SYSFS_BRIDGE_ATTR))
+		return;
+
+	ni_sysfs_bridge_dir_get_status(&dir, bs);
+	ni_sysfs_dir_close(&dir);
+}
+
+void
+ni_sysfs_bridge_dir_get_status(const ni_sysfs_dir_t *dir, ni_bridge_status_t *bs)
+{
+	const ni_sysfs_attr_t attrs[] = {
+		{ "stp_state",			NI_SYSFS_ATTR_UINT,	&bs->stp_state			},
+		{ "root_id",			NI_SYSFS_ATTR_STRING,	&bs->root_id			},
+		{ "bridge_id",			NI_SYSFS_ATTR_STRING,	&bs->bridge_id			},
+		{ "group_addr",			NI_SYSFS_ATTR_STRING,	&bs->group_addr			},
+		{ "root_port",			NI_SYSFS_ATTR_UINT,	&bs->root_port			},
+		{ "root_path_cost",		NI_SYSFS_ATTR_UINT,	&bs->root_path_cost		},
+		{ "topology_change",		NI_SYSFS_ATTR_UINT,	&bs->topology_change		},
+		{ "topology_change_detected",	NI_SYSFS_ATTR_UINT,	&bs->topology_change_detected	},
+		{ "gc_timer",			NI_SYSFS_ATTR_ULONG,	&bs->gc_timer			},
+		{ "tcn_timer",			NI_SYSFS_ATTR_ULONG,	&bs->tcn_timer			},
+		{ "hello_timer",		NI_SYSFS_ATTR_ULONG,	&bs->hello_timer		},
+		{ "topology_change_timer",	NI_SYSFS_ATTR_ULONG,	&bs->topology_change_timer	},
+	};
+
+	ni_sysfs_dir_get_attrs(dir, attrs, sizeof(attrs)/sizeof(attrs[0]));
 }
 
 int
@@ -493,8 +710,24 @@ ni_sysfs_bridge_get_port_names(const char *ifname, ni_string_array_t *names)
 void
 ni_sysfs_bridge_port_get_config(const char *ifname, ni_bridge_port_t *port)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/priority", &port->priority);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/path_cost", &port->path_cost);
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+
+	if (!ni_sysfs_netif_dir_open(&dir, ifname, SYSFS_BRIDGE_PORT_ATTR))
+		return;
+
+	ni_sysfs_bridge_port_dir_get_config(&dir, port);
+	ni_sysfs_dir_close(&dir);
+}
+
+void
+ni_sysfs_bridge_port_dir_get_config(const ni_sysfs_dir_t *dir, ni_bridge_port_t *port)
+{
+	const ni_sysfs_attr_t attrs[] = {
+		{ "priority",		NI_SYSFS_ATTR_UINT,	&port->priority		},
+		{ "path_cost",		NI_SYSFS_ATTR_UINT,	&port->path_cost	},
+	};
+
+	ni_sysfs_dir_get_attrs(dir, attrs, sizeof(attrs)/sizeof(attrs[0]));
 }
 
 int
@@ -516,23 +749,37 @@ ni_sysfs_bridge_port_update_config(const char *ifname, const ni_bridge_port_t *p
 void
 ni_sysfs_bridge_port_get_status(const char *ifname, ni_bridge_port_status_t *ps)
 {
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/priority", &ps->priority);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/path_cost", &ps->path_cost);
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
 
-	ni_sysfs_netif_get_int(ifname, SYSFS_BRIDGE_PORT_ATTR "/state", &ps->state);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_no", &ps->port_no);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/port_id", &ps->port_no);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_root", &ps->designated_root);
-	ni_sysfs_netif_get_string(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_bridge", &ps->designated_bridge);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_port", &ps->designated_port);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/designated_cost", &ps->designated_cost);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/change_ack", &ps->change_ack);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/hairpin_mode", &ps->hairpin_mode);
-	ni_sysfs_netif_get_uint(ifname, SYSFS_BRIDGE_PORT_ATTR "/config_pending", &ps->config_pending);
+	if (!ni_sysfs_netif_dir_open(&dir, ifname, SYSFS_BRIDGE_PORT_ATTR))
+		return;
 
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/hold_timer", &ps->hold_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/message_age_timer", &ps->message_age_timer);
-	ni_sysfs_netif_get_ulong(ifname, SYSFS_BRIDGE_PORT_ATTR "/forward_delay_timer", &ps->forward_delay_timer);
+	ni_sysfs_bridge_port_dir_get_status(&dir, ps);
+	ni_sysfs_dir_close(&dir);
+}
+
+void
+ni_sysfs_bridge_port_dir_get_status(const ni_sysfs_dir_t *dir, ni_bridge_port_status_t *ps)
+{
+	const ni_sysfs_attr_t attrs[] = {
+		{ "priority",		NI_SYSFS_ATTR_UINT,	&ps->priority		},
+		{ "path_cost",		NI_SYSFS_ATTR_UINT,	&ps->path_cost		},
+		{ "state",		NI_SYSFS_ATTR_INT,	&ps->state		},
+		{ "port_no",		NI_SYSFS_ATTR_UINT,	&ps->port_no		},
+		{ "port_id",		NI_SYSFS_ATTR_UINT,	&ps->port_id		},
+		{ "designated_root",	NI_SYSFS_ATTR_STRING,	&ps->designated_root	},
+		{ "designated_bridge",	NI_SYSFS_ATTR_STRING,	&ps->designated_bridge	},
+		{ "designated_port",	NI_SYSFS_ATTR_UINT,	&ps->designated_port	},
+		{ "designated_cost",	NI_SYSFS_ATTR_UINT,	&ps->designated_cost	},
+		{ "change_ack",		NI_SYSFS_ATTR_UINT,	&ps->change_ack		},
+		{ "hairpin_mode",	NI_SYSFS_ATTR_UINT,	&ps->hairpin_mode	},
+		{ "config_pending",	NI_SYSFS_ATTR_UINT,	&ps->config_pending	},
+		{ "hold_timer",		NI_SYSFS_ATTR_ULONG,	&ps->hold_timer		},
+		{ "message_age_timer",	NI_SYSFS_ATTR_ULONG,	&ps->message_age_timer	},
+		{ "forward_delay_timer",NI_SYSFS_ATTR_ULONG,	&ps->forward_delay_timer},
+	};
+
+	ni_sysfs_dir_get_attrs(dir, attrs, sizeof(attrs)/sizeof(attrs[0]));
 }
 
 /*
@@ -558,6 +805,12 @@ ni_sysctl_ipv4_ifconfig_is_present(const char *ifname)
 	return access(pathname, F_OK) == 0;
 }
 
+ni_bool_t
+ni_sysctl_ipv4_ifconfig_dir_open(ni_sysfs_dir_t *dir, const char *ifname)
+{
+	return ni_sysfs_dir_open(dir, __ni_sysctl_ipv4_ifconfig_path(ifname, NULL));
+}
+
 int
 ni_sysctl_ipv4_ifconfig_get_int(const char *ifname, const char *ctl_name, int *value)
 {
@@ -635,6 +888,12 @@ ni_sysctl_ipv6_ifconfig_is_present(const char *ifname)
 	return access(pathname, F_OK) == 0;
 }
 
+ni_bool_t
+ni_sysctl_ipv6_ifconfig_dir_open(ni_sysfs_dir_t *dir, const char *ifname)
+{
+	return ni_sysfs_dir_open(dir, __ni_sysctl_ipv6_ifconfig_path(ifname, NULL));
+}
+
 int
 ni_sysctl_ipv6_ifconfig_get_int(const char *ifname, const char *ctl_name, int *value)
 {
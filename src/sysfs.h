@@ -10,6 +10,40 @@
 #include <wicked/bridge.h>
 #include <wicked/pci.h>
 
+/*
+ * Attribute directory handle, see ni_sysfs_dir_open()
+ */
+typedef struct ni_sysfs_dir {
+	int			fd;
+	char *			path;
+} ni_sysfs_dir_t;
+
+#define NI_SYSFS_DIR_INIT	{ .fd = -1, .path = NULL }
+
+typedef enum ni_sysfs_attr_type {
+	NI_SYSFS_ATTR_INT,
+	NI_SYSFS_ATTR_UINT,
+	NI_SYSFS_ATTR_LONG,
+	NI_SYSFS_ATTR_ULONG,
+	NI_SYSFS_ATTR_STRING,
+} ni_sysfs_attr_type_t;
+
+typedef struct ni_sysfs_attr {
+	const char *		name;
+	ni_sysfs_attr_type_t	type;
+	void *			value;
+} ni_sysfs_attr_t;
+
+extern ni_bool_t	ni_sysfs_dir_open(ni_sysfs_dir_t *, const char *);
+extern ni_bool_t	ni_sysfs_netif_dir_open(ni_sysfs_dir_t *, const char *, const char *);
+extern void		ni_sysfs_dir_close(ni_sysfs_dir_t *);
+extern const char *	ni_sysfs_dir_read(const ni_sysfs_dir_t *, const char *, char *, size_t);
+extern int		ni_sysfs_dir_get_int(const ni_sysfs_dir_t *, const char *, int *);
+extern int		ni_sysfs_dir_get_uint(const ni_sysfs_dir_t *, const char *, unsigned int *);
+extern int		ni_sysfs_dir_get_ulong(const ni_sysfs_dir_t *, const char *, unsigned long *);
+extern int		ni_sysfs_dir_get_string(const ni_sysfs_dir_t *, const char *, char **);
+extern unsigned int	ni_sysfs_dir_get_attrs(const ni_sysfs_dir_t *, const ni_sysfs_attr_t *, unsigned int);
+
 extern int	ni_sysfs_netif_get_int(const char *, const char *, int *);
 extern int	ni_sysfs_netif_get_long(const char *, const char *, long *);
 extern int	ni_sysfs_netif_get_uint(const char *, const char *, unsigned int *);
@@ -45,15 +79,21 @@ extern int	ni_sysfs_bridge_get_port_names(const char *, ni_string_array_t *);
 extern void	ni_sysfs_bridge_port_get_config(const char *, ni_bridge_port_t *);
 extern int	ni_sysfs_bridge_port_update_config(const char *, const ni_bridge_port_t *);
 extern void	ni_sysfs_bridge_port_get_status(const char *, ni_bridge_port_status_t *);
+extern void	ni_sysfs_bridge_dir_get_config(const ni_sysfs_dir_t *, ni_bridge_t *);
+extern void	ni_sysfs_bridge_dir_get_status(const ni_sysfs_dir_t *, ni_bridge_status_t *);
+extern void	ni_sysfs_bridge_port_dir_get_config(const ni_sysfs_dir_t *, ni_bridge_port_t *);
+extern void	ni_sysfs_bridge_port_dir_get_status(const ni_sysfs_dir_t *, ni_bridge_port_status_t *);
 extern ni_pci_dev_t *ni_sysfs_netdev_get_pci(const char *ifname);
 
 extern int	ni_sysctl_ipv6_ifconfig_is_present(const char *ifname);
+extern ni_bool_t ni_sysctl_ipv6_ifconfig_dir_open(ni_sysfs_dir_t *, const char *);
 extern int	ni_sysctl_ipv6_ifconfig_get_int(const char *, const char *, int *);
 extern int	ni_sysctl_ipv6_ifconfig_get_uint(const char *, const char *, unsigned int *);
 extern int	ni_sysctl_ipv6_ifconfig_set_int(const char *, const char *, int);
 extern int	ni_sysctl_ipv6_ifconfig_set_uint(const char *, const char *, unsigned int);
 
 extern int	ni_sysctl_ipv4_ifconfig_is_present(const char *ifname);
+extern ni_bool_t ni_sysctl_ipv4_ifconfig_dir_open(ni_sysfs_dir_t *, const char *);
 extern int	ni_sysctl_ipv4_ifconfig_get_int(const char *, const char *, int *);
 extern int	ni_sysctl_ipv4_ifconfig_get_uint(const char *, const char *, unsigned int *);
 extern int	ni_sysctl_ipv4_ifconfig_set_int(const char *, const char *, int);
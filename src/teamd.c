@@ -28,7 +28,11 @@
 
 #include <limits.h>
 #include <pwd.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <wicked/util.h>
 #include <wicked/dbus-service.h>
@@ -68,6 +72,14 @@
 
 #define NI_TEAMD_CALL_PORT_ADD			"PortAdd"
 #define NI_TEAMD_CALL_PORT_CONFIG_UPDATE	"PortConfigUpdate"
+#define NI_TEAMD_CALL_PORT_CONFIG_DUMP		"PortConfigDump"
+
+#define NI_TEAMD_USOCK_DIR			"/var/run/teamd"
+#define NI_TEAMD_USOCK_FMT			"%s/%s.sock"
+#define NI_TEAMD_USOCK_TIMEOUT			5000	/* msec */
+#define NI_TEAMD_USOCK_REQUEST			"REQUEST"
+#define NI_TEAMD_USOCK_REPLY_SUCCESS		"REPLY_SUCCESS"
+#define NI_TEAMD_USOCK_REPLY_ERROR		"REPLY_ERROR"
 
 
 typedef struct ni_teamd_client_ops {
@@ -78,6 +90,7 @@ typedef struct ni_teamd_client_ops {
 	int	(*ctl_state_set_item)(ni_teamd_client_t *, const char *, const char *);
 	int	(*ctl_port_add)(ni_teamd_client_t *, const char *);
 	int	(*ctl_port_config_update)(ni_teamd_client_t *, const char *, const char *);
+	int	(*ctl_port_config_dump)(ni_teamd_client_t *, const char *, char **);
 } ni_teamd_client_ops_t;
 
 struct ni_teamd_client {
@@ -89,7 +102,13 @@ struct ni_teamd_client {
 	ni_dbus_object_t *	proxy;
 
 	/* unix */
-	ni_shellcmd_t *		cmd;
+	int			usock;
+
+	/* long-lived clients with the actual config of their team */
+	ni_teamd_client_t *	next;
+	unsigned int		ifindex;
+	ni_json_t *		config;
+	ni_string_array_t	changed;	/* ports to refresh in config */
 };
 
 static inline const char *
@@ -321,146 +340,266 @@ ni_teamd_dbus_ctl_port_config_update(ni_teamd_client_t *tdc, const char *port_na
 	return rv;
 }
 
+static int
+ni_teamd_dbus_ctl_port_config_dump(ni_teamd_client_t *tdc, const char *port_name, char **result)
+{
+	int rv;
+
+	if (ni_string_empty(port_name) || !result)
+		return -NI_ERROR_INVALID_ARGS;
+
+	rv = ni_dbus_object_call_simple(tdc->proxy,
+		NI_TEAMD_INTERFACE, NI_TEAMD_CALL_PORT_CONFIG_DUMP,
+		DBUS_TYPE_STRING, &port_name,
+		DBUS_TYPE_STRING, result);
+
+	if (rv < 0) {
+		ni_debug_application("Call to %s."NI_TEAMD_CALL_PORT_CONFIG_DUMP"(%s) failed: %s",
+			ni_dbus_object_get_path(tdc->proxy), port_name, ni_strerror(rv));
+	}
+
+	return rv;
+}
+
 /*
  * === unix client ===
+ *
+ * Speaks the teamd control socket protocol directly, as teamdctl
+ * does: a request packet is "REQUEST\n<method>\n[<arg>\n]...", the
+ * reply "REPLY_SUCCESS\n<result>" or "REPLY_ERROR\n<code>\n<msg>\n".
  */
-static const char *
-ni_teamdctl_tool_path()
+
+static void
+ni_teamd_unix_client_disconnect(ni_teamd_client_t *tdc)
 {
-	static const char *paths[] = {
-		"/usr/sbin/teamdctl",
-		NULL
-	};
-	const char *path = ni_find_executable(paths);
-	if (!path)
-		ni_warn("unable to find teamdctl utility");
-	return path;
+	if (tdc->usock >= 0) {
+		close(tdc->usock);
+		tdc->usock = -1;
+	}
 }
 
 static ni_bool_t
-ni_teamd_unix_client_init(ni_teamd_client_t *tdc)
+ni_teamd_unix_client_connect(ni_teamd_client_t *tdc)
 {
-	const char *tool;
+	const char *dir = ni_config_teamd_usock_dir();
+	struct sockaddr_un sun;
+	int len;
 
-	if (!(tool = ni_teamdctl_tool_path()))
-		goto failure;
+	if (tdc->usock >= 0)
+		return TRUE;
 
-	if (!(tdc->cmd = ni_shellcmd_new(NULL)))
-		goto failure;
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	len = snprintf(sun.sun_path, sizeof(sun.sun_path), NI_TEAMD_USOCK_FMT,
+			dir ? dir : NI_TEAMD_USOCK_DIR, tdc->instance);
+	if (len < 0 || (size_t)len >= sizeof(sun.sun_path)) {
+		ni_error("%s: teamd control socket path too long", tdc->instance);
+		return FALSE;
+	}
 
-	if (!ni_shellcmd_add_arg(tdc->cmd, tool))
-		goto failure;
+	tdc->usock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (tdc->usock < 0) {
+		ni_error("%s: unable to create teamd control socket: %m", tdc->instance);
+		return FALSE;
+	}
+	if (connect(tdc->usock, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		ni_debug_application("%s: unable to connect to %s: %m",
+				tdc->instance, sun.sun_path);
+		ni_teamd_unix_client_disconnect(tdc);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-	if (!ni_shellcmd_add_arg(tdc->cmd, "--force-usock"))
-		goto failure;
+static ni_bool_t
+ni_teamd_unix_client_init(ni_teamd_client_t *tdc)
+{
+	return ni_teamd_unix_client_connect(tdc);
+}
 
-	if (!ni_shellcmd_add_arg(tdc->cmd, "--oneline"))
-		goto failure;
+static void
+ni_teamd_unix_client_destroy(ni_teamd_client_t *tdc)
+{
+	ni_teamd_unix_client_disconnect(tdc);
+}
 
-	if (!ni_shellcmd_add_arg(tdc->cmd, tdc->instance))
-		goto failure;
+static char *
+ni_teamd_unix_client_recv(ni_teamd_client_t *tdc)
+{
+	struct pollfd pfd;
+	ssize_t len;
+	char *data;
+	int ret;
 
-	return TRUE;
-failure:
-	return FALSE;
+	pfd.fd = tdc->usock;
+	pfd.events = POLLIN;
+	do {
+		ret = poll(&pfd, 1, NI_TEAMD_USOCK_TIMEOUT);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0) {
+		ni_error("%s: no reply from teamd", tdc->instance);
+		return NULL;
+	}
+
+	/* a reply is one packet, peek at its size first */
+	if ((len = recv(tdc->usock, NULL, 0, MSG_PEEK | MSG_TRUNC)) <= 0) {
+		if (len < 0)
+			ni_error("%s: unable to receive teamd reply: %m", tdc->instance);
+		else
+			ni_debug_application("%s: teamd closed the control socket", tdc->instance);
+		return NULL;
+	}
+
+	data = xmalloc(len + 1);
+	if ((len = recv(tdc->usock, data, len, 0)) <= 0) {
+		ni_error("%s: unable to receive teamd reply: %m", tdc->instance);
+		free(data);
+		return NULL;
+	}
+	data[len] = '\0';
+	return data;
 }
 
-void
-ni_teamd_unix_client_destroy(ni_teamd_client_t *tdc)
+/*
+ * Sends a request and returns the reply result. A connection teamd has
+ * closed meanwhile (e.g. restarted) is reopened and the cached config
+ * is dropped, as the team is most likely a new one.
+ */
+static int
+ni_teamd_unix_ctl_call(ni_teamd_client_t *tdc, const char *method,
+			const char *arg1, const char *arg2, char **result)
 {
-	ni_shellcmd_release(tdc->cmd);
+	ni_stringbuf_t req = NI_STRINGBUF_INIT_DYNAMIC;
+	char *reply = NULL, *ptr, *code;
+	unsigned int attempt;
+	int rv = -1;
+
+	ni_stringbuf_printf(&req, NI_TEAMD_USOCK_REQUEST"\n%s\n", method);
+	if (arg1)
+		ni_stringbuf_printf(&req, "%s\n", arg1);
+	if (arg2)
+		ni_stringbuf_printf(&req, "%s\n", arg2);
+
+	for (attempt = 0; attempt < 2 && !reply; ++attempt) {
+		if (tdc->usock < 0) {
+			if (!ni_teamd_unix_client_connect(tdc))
+				break;
+			ni_json_free(tdc->config);
+			tdc->config = NULL;
+		}
+
+		if (send(tdc->usock, req.string, req.len, MSG_NOSIGNAL) < 0) {
+			ni_debug_application("%s: unable to send teamd request: %m", tdc->instance);
+			ni_teamd_unix_client_disconnect(tdc);
+			continue;
+		}
+		if (!(reply = ni_teamd_unix_client_recv(tdc))) {
+			ni_teamd_unix_client_disconnect(tdc);
+			break;
+		}
+	}
+	ni_stringbuf_destroy(&req);
+	if (!reply)
+		return -1;
+
+	if (!strncmp(reply, NI_TEAMD_USOCK_REPLY_SUCCESS"\n", sizeof(NI_TEAMD_USOCK_REPLY_SUCCESS))) {
+		if (result) {
+			ni_string_free(result);
+			ni_string_dup(result, reply + sizeof(NI_TEAMD_USOCK_REPLY_SUCCESS));
+		}
+		rv = 0;
+	} else
+	if (!strncmp(reply, NI_TEAMD_USOCK_REPLY_ERROR"\n", sizeof(NI_TEAMD_USOCK_REPLY_ERROR))) {
+		code = reply + sizeof(NI_TEAMD_USOCK_REPLY_ERROR);
+		if ((ptr = strchr(code, '\n')))
+			*ptr++ = '\0';
+		if (ptr)
+			ptr[strcspn(ptr, "\n")] = '\0';
+		ni_debug_application("%s: teamd %s%s%s failed: %s%s%s", tdc->instance,
+				method, arg1 ? " " : "", arg1 ? arg1 : "",
+				code, ptr && *ptr ? ": " : "", ptr ? ptr : "");
+	} else {
+		ni_error("%s: invalid teamd reply to %s", tdc->instance, method);
+		ni_teamd_unix_client_disconnect(tdc);
+	}
+	free(reply);
+	return rv;
 }
 
-int
+static int
 ni_teamd_unix_ctl_config_dump(ni_teamd_client_t *tdc, ni_bool_t actual, char **result)
 {
-	ni_buffer_t buf;
-	ni_process_t *pi;
-	int rv;
+	if (!result)
+		return -1;
 
+	return ni_teamd_unix_ctl_call(tdc, actual ? NI_TEAMD_CALL_CONFIG_DUMP_ACTUAL :
+			NI_TEAMD_CALL_CONFIG_DUMP, NULL, NULL, result);
+}
+
+static int
+ni_teamd_unix_ctl_state_dump(ni_teamd_client_t *tdc, char **result)
+{
 	if (!result)
 		return -1;
 
-	ni_buffer_init_dynamic(&buf, 1024);
-	if (!(pi = ni_process_new(tdc->cmd)))
-		goto failure;
+	return ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_STATE_DUMP, NULL, NULL, result);
+}
 
-	ni_string_array_append(&pi->argv, "config");
-	ni_string_array_append(&pi->argv, "dump");
-	if (actual)
-		ni_string_array_append(&pi->argv, "actual");
+static int
+ni_teamd_unix_ctl_state_get_item(ni_teamd_client_t *tdc, const char *item_name, char **result)
+{
+	if (ni_string_empty(item_name) || !result)
+		return -1;
 
-	rv = ni_process_run_and_capture_output(pi, &buf);
-	ni_process_free(pi);
-	if (rv) {
-		ni_error("%s: unable to dump team config", tdc->instance);
-		goto failure;
-	}
+	return ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_STATE_ITEM_GET, item_name, NULL, result);
+}
 
-	ni_buffer_put(&buf, "\0", 1);
-	ni_string_free(result);
-	*result = (char *)buf.base;
-	buf.base = NULL;
-	ni_buffer_destroy(&buf);
-	return 0;
+static int
+ni_teamd_unix_ctl_state_set_item(ni_teamd_client_t *tdc, const char *item_name, const char *item_val)
+{
+	if (ni_string_empty(item_name))
+		return -1;
 
-failure:
-	ni_buffer_destroy(&buf);
-	return -1;
+	return ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_STATE_ITEM_SET, item_name,
+			item_val ? item_val : "", NULL);
 }
 
-int
+static int
 ni_teamd_unix_ctl_port_add(ni_teamd_client_t *tdc, const char *port_name)
 {
-	ni_process_t *pi;
-	int rv;
-
 	if (ni_string_empty(port_name))
 		return -1;
 
-	if (!(pi = ni_process_new(tdc->cmd)))
-		return -1;
-
-	ni_string_array_append(&pi->argv, "port");
-	ni_string_array_append(&pi->argv, "add");
-	ni_string_array_append(&pi->argv, port_name);
-
-	rv = ni_process_run_and_wait(pi);
-	ni_process_free(pi);
-	if (rv) {
+	if (ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_PORT_ADD, port_name, NULL, NULL) < 0) {
 		ni_error("%s: unable to add team port %s", tdc->instance, port_name);
 		return -1;
 	}
 	return 0;
 }
 
-int
+static int
 ni_teamd_unix_ctl_port_config_update(ni_teamd_client_t *tdc, const char *port_name, const char *port_conf)
 {
-	ni_process_t *pi;
-	int rv;
-
-	if (!tdc || ni_string_empty(port_name))
-		return -1;
-
-	if (!(pi = ni_process_new(tdc->cmd)))
+	if (ni_string_empty(port_name))
 		return -1;
 
-	ni_string_array_append(&pi->argv, "port");
-	ni_string_array_append(&pi->argv, "config");
-	ni_string_array_append(&pi->argv, "update");
-	ni_string_array_append(&pi->argv, port_name);
-	ni_string_array_append(&pi->argv, port_conf ? port_conf : "");
-
-	rv = ni_process_run_and_wait(pi);
-	ni_process_free(pi);
-	if (rv) {
+	if (ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_PORT_CONFIG_UPDATE, port_name,
+				port_conf ? port_conf : "", NULL) < 0) {
 		ni_error("%s: unable to update team port %s config", tdc->instance, port_name);
 		return -1;
 	}
 	return 0;
 }
 
+static int
+ni_teamd_unix_ctl_port_config_dump(ni_teamd_client_t *tdc, const char *port_name, char **result)
+{
+	if (ni_string_empty(port_name) || !result)
+		return -1;
+
+	return ni_teamd_unix_ctl_call(tdc, NI_TEAMD_CALL_PORT_CONFIG_DUMP, port_name, NULL, result);
+}
+
 /*
  *  === teamd client ===
  */
@@ -472,13 +611,18 @@ static const ni_teamd_client_ops_t	teamd_dbus_ops = {
 	.ctl_state_set_item	= ni_teamd_dbus_ctl_state_set_item,
 	.ctl_port_add		= ni_teamd_dbus_ctl_port_add,
 	.ctl_port_config_update	= ni_teamd_dbus_ctl_port_config_update,
+	.ctl_port_config_dump	= ni_teamd_dbus_ctl_port_config_dump,
 };
 
 static const ni_teamd_client_ops_t	teamd_unix_ops = {
 	.destroy		= ni_teamd_unix_client_destroy,
 	.ctl_config_dump	= ni_teamd_unix_ctl_config_dump,
+	.ctl_state_dump		= ni_teamd_unix_ctl_state_dump,
+	.ctl_state_get_item	= ni_teamd_unix_ctl_state_get_item,
+	.ctl_state_set_item	= ni_teamd_unix_ctl_state_set_item,
 	.ctl_port_add		= ni_teamd_unix_ctl_port_add,
 	.ctl_port_config_update	= ni_teamd_unix_ctl_port_config_update,
+	.ctl_port_config_dump	= ni_teamd_unix_ctl_port_config_dump,
 };
 
 ni_bool_t
@@ -558,6 +702,7 @@ ni_teamd_client_open(const char *instance)
 
 	tdc = xcalloc(1, sizeof(*tdc));
 	ni_string_dup(&tdc->instance, instance);
+	tdc->usock = -1;
 
 	ctl = ni_teamd_client_ctl_detect(instance, &busname);
 	switch (ctl) {
@@ -595,10 +740,67 @@ ni_teamd_client_free(ni_teamd_client_t *tdc)
 		if (tdc->ops.destroy)
 			tdc->ops.destroy(tdc);
 		ni_string_free(&tdc->instance);
+		ni_json_free(tdc->config);
+		ni_string_array_destroy(&tdc->changed);
 		free(tdc);
 	}
 }
 
+/*
+ * The long-lived client of a team keeps its control connection open
+ * and caches the actual config, which the port bind and unbind events
+ * and our own port changes update per port instead of a full dump.
+ */
+static ni_teamd_client_t *	ni_teamd_clients;
+
+static ni_teamd_client_t *
+ni_teamd_client_find(const char *instance)
+{
+	ni_teamd_client_t *tdc;
+
+	for (tdc = ni_teamd_clients; tdc; tdc = tdc->next) {
+		if (ni_string_eq(tdc->instance, instance))
+			return tdc;
+	}
+	return NULL;
+}
+
+static ni_teamd_client_t *
+ni_teamd_client_get(const char *instance)
+{
+	ni_teamd_client_t *tdc;
+
+	if ((tdc = ni_teamd_client_find(instance)))
+		return tdc;
+
+	if ((tdc = ni_teamd_client_open(instance))) {
+		tdc->next = ni_teamd_clients;
+		ni_teamd_clients = tdc;
+	}
+	return tdc;
+}
+
+void
+ni_teamd_client_release(const char *instance)
+{
+	ni_teamd_client_t **pos, *tdc;
+
+	for (pos = &ni_teamd_clients; (tdc = *pos); pos = &tdc->next) {
+		if (ni_string_eq(tdc->instance, instance)) {
+			*pos = tdc->next;
+			ni_teamd_client_free(tdc);
+			return;
+		}
+	}
+}
+
+static void
+ni_teamd_client_port_changed(ni_teamd_client_t *tdc, const char *port_name)
+{
+	if (tdc && tdc->config && ni_string_array_index(&tdc->changed, port_name) < 0)
+		ni_string_array_append(&tdc->changed, port_name);
+}
+
 /*
  * teamd ctl ops
  */
@@ -650,6 +852,14 @@ ni_teamd_ctl_port_config_update(ni_teamd_client_t *tdc, const char *port_name, c
 	return tdc->ops.ctl_port_config_update(tdc, port_name, port_conf);
 }
 
+int
+ni_teamd_ctl_port_config_dump(ni_teamd_client_t *tdc, const char *port_name, char **result)
+{
+	if (!tdc || !tdc->ops.ctl_port_config_dump)
+		return -1;
+	return tdc->ops.ctl_port_config_dump(tdc, port_name, result);
+}
+
 static ni_json_t *
 ni_teamd_port_config_json(const ni_team_port_config_t *config)
 {
@@ -676,16 +886,16 @@ ni_teamd_port_enslave(const ni_netdev_t *master, const ni_netdev_t *port, const
 {
 	ni_stringbuf_t dump = NI_STRINGBUF_INIT_DYNAMIC;
 	ni_teamd_client_t *tdc;
-	int ret = -1;
 
 	if (!master || !master->name || !port || !port->name)
 		return -1;
 
-	if (!(tdc = ni_teamd_client_open(master->name)))
+	if (!(tdc = ni_teamd_client_get(master->name)))
 		return -1;
 
 	if (ni_teamd_ctl_port_add(tdc, port->name) < 0)
-		goto failure;
+		return -1;
+	ni_teamd_client_port_changed(tdc, port->name);
 
 	if (config) {
 		ni_json_t *object = ni_teamd_port_config_json(config);
@@ -698,12 +908,7 @@ ni_teamd_port_enslave(const ni_netdev_t *master, const ni_netdev_t *port, const
 		ni_json_free(object);
 		ni_stringbuf_destroy(&dump);
 	}
-
-	ret = 0;
-
-failure:
-        ni_teamd_client_free(tdc);
-	return ret;
+	return 0;
 }
 
 
@@ -1017,13 +1222,65 @@ ni_teamd_discover_ports(ni_team_t *team, ni_json_t *conf)
 	return 0;
 }
 
+/*
+ * Brings the cached actual config of the team up to date: the full
+ * dump on first use or for a new team device, otherwise a dump of the
+ * changed ports only. A port teamd does not know (any more) falls back
+ * to the full dump, as we've missed its unbind then.
+ */
+static int
+ni_teamd_config_refresh(ni_teamd_client_t *tdc, unsigned int ifindex)
+{
+	ni_json_t *ports, *port;
+	char *val = NULL;
+	const char *name;
+
+	if (tdc->ifindex != ifindex) {
+		ni_json_free(tdc->config);
+		tdc->config = NULL;
+		tdc->ifindex = ifindex;
+	}
+
+	while (tdc->config && tdc->changed.count) {
+		name = tdc->changed.data[tdc->changed.count - 1];
+		port = NULL;
+		if (ni_teamd_ctl_port_config_dump(tdc, name, &val) == 0)
+			port = ni_json_parse_string(val);
+		ni_string_free(&val);
+
+		if (!port || !tdc->config) {
+			ni_json_free(tdc->config);
+			tdc->config = NULL;
+			ni_json_free(port);
+			break;
+		}
+
+		if (!(ports = ni_json_object_get_value(tdc->config, "ports"))) {
+			ports = ni_json_new_object();
+			ni_json_object_set(tdc->config, "ports", ports);
+		}
+		ni_json_object_set(ports, name, port);
+		ni_string_array_remove_index(&tdc->changed, tdc->changed.count - 1);
+	}
+
+	if (!tdc->config) {
+		ni_string_array_destroy(&tdc->changed);
+		if (ni_teamd_ctl_config_dump(tdc, TRUE, &val) < 0)
+			return -1;
+
+		tdc->config = ni_json_parse_string(val);
+		ni_string_free(&val);
+		if (!tdc->config)
+			return -1;
+	}
+	return 0;
+}
+
 int
 ni_teamd_discover(ni_netdev_t *dev)
 {
 	ni_teamd_client_t *tdc = NULL;
-	ni_json_t *conf = NULL;
 	ni_team_t *team = NULL;
-	char *val = NULL;
 
 	if (!dev || dev->link.type != NI_IFTYPE_TEAM)
 		return -1;
@@ -1033,38 +1290,80 @@ ni_teamd_discover(ni_netdev_t *dev)
 	if (!(team = ni_team_new()))
 		goto failure;
 
-	if (!(tdc = ni_teamd_client_open(dev->name)))
-		goto failure;
-
-	if (ni_teamd_ctl_config_dump(tdc, TRUE, &val) < 0)
+	if (!(tdc = ni_teamd_client_get(dev->name)))
 		goto failure;
 
-	if (!(conf = ni_json_parse_string(val)))
-		goto failure;
+	if (ni_teamd_config_refresh(tdc, dev->link.ifindex) < 0)
+		goto release;
 
-	if (ni_teamd_discover_runner(team, conf) < 0)
-		goto failure;
+	if (ni_teamd_discover_runner(team, tdc->config) < 0)
+		goto release;
 
-	if (ni_teamd_discover_link_watch(team, conf) < 0)
-		goto failure;
+	if (ni_teamd_discover_link_watch(team, tdc->config) < 0)
+		goto release;
 
-	if (ni_teamd_discover_ports(team, conf) < 0)
-		goto failure;
+	if (ni_teamd_discover_ports(team, tdc->config) < 0)
+		goto release;
 
 	ni_netdev_set_team(dev, team);
-	ni_teamd_client_free(tdc);
-	ni_json_free(conf);
-	ni_string_free(&val);
 	return 0;
 
+release:
+	ni_teamd_client_release(dev->name);
 failure:
-	ni_json_free(conf);
 	ni_team_free(team);
-	ni_teamd_client_free(tdc);
-	ni_string_free(&val);
 	return -1;
 }
 
+/*
+ * Port bind and unbind events of the team device: the port list of the
+ * team is updated right away, the config of a new port is refreshed on
+ * the next discovery.
+ */
+void
+ni_teamd_port_bind(ni_netdev_t *master, const char *port_name)
+{
+	ni_team_port_t *port;
+
+	if (!master || !master->team || ni_string_empty(port_name))
+		return;
+
+	if (ni_team_port_array_find_by_name(&master->team->ports, port_name))
+		return;
+
+	port = ni_team_port_new();
+	ni_netdev_ref_set_ifname(&port->device, port_name);
+	if (!ni_team_port_array_append(&master->team->ports, port)) {
+		ni_team_port_free(port);
+		return;
+	}
+	ni_teamd_client_port_changed(ni_teamd_client_find(master->name), port_name);
+}
+
+void
+ni_teamd_port_unbind(ni_netdev_t *master, const char *port_name)
+{
+	ni_teamd_client_t *tdc;
+	unsigned int i;
+	int pos;
+
+	if (!master || ni_string_empty(port_name))
+		return;
+
+	for (i = 0; master->team && i < master->team->ports.count; ++i) {
+		if (ni_string_eq(master->team->ports.data[i]->device.name, port_name)) {
+			ni_team_port_array_delete_at(&master->team->ports, i);
+			break;
+		}
+	}
+
+	if ((tdc = ni_teamd_client_find(master->name)) && tdc->config) {
+		ni_json_object_delete(ni_json_object_get_value(tdc->config, "ports"), port_name);
+		if ((pos = ni_string_array_index(&tdc->changed, port_name)) >= 0)
+			ni_string_array_remove_index(&tdc->changed, pos);
+	}
+}
+
 /*
  * teamd startup config file
  */
@@ -1486,6 +1785,7 @@ ni_teamd_service_stop(const char *ifname)
 	int rv;
 	char *service = NULL;
 
+	ni_teamd_client_release(ifname);
 	ni_string_printf(&service, NI_TEAMD_SERVICE_FMT, ifname);
 	rv = ni_systemctl_service_stop(service);
 	ni_teamd_config_file_remove(ifname);
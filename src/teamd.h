@@ -32,6 +32,7 @@ typedef struct ni_teamd_client		ni_teamd_client_t;
 
 ni_teamd_client_t *			ni_teamd_client_open(const char*);
 void					ni_teamd_client_free(ni_teamd_client_t *);
+extern void				ni_teamd_client_release(const char *);
 
 extern int				ni_teamd_ctl_config_dump(ni_teamd_client_t *, ni_bool_t, char **);
 extern int				ni_teamd_ctl_state_dump(ni_teamd_client_t *, char **);
@@ -40,10 +41,13 @@ extern int				ni_teamd_ctl_state_set_item(ni_teamd_client_t *, const char *,
 											 const char *);
 extern int				ni_teamd_ctl_port_add(ni_teamd_client_t *, const char *);
 extern int				ni_teamd_ctl_port_config_update(ni_teamd_client_t *, const char *, const char *);
+extern int				ni_teamd_ctl_port_config_dump(ni_teamd_client_t *, const char *, char **);
 
 extern int				ni_teamd_port_enslave(const ni_netdev_t *, const ni_netdev_t *, const ni_team_port_config_t *);
 
 extern int				ni_teamd_discover(ni_netdev_t *);
+extern void				ni_teamd_port_bind(ni_netdev_t *, const char *);
+extern void				ni_teamd_port_unbind(ni_netdev_t *, const char *);
 
 extern int				ni_teamd_service_start(const ni_netdev_t *);
 extern int				ni_teamd_service_stop (const char *);
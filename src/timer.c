@@ -11,6 +11,7 @@
 #include <wicked/socket.h>
 #include "netinfo_priv.h"
 #include "util_priv.h"
+#include "memstat.h"
 
 struct ni_timer {
 	ni_timer_t *		next;
@@ -32,6 +33,7 @@ ni_timer_register(unsigned long timeout, ni_timeout_callback_t *callback, void *
 	ni_timer_t *timer;
 
 	timer = xcalloc(1, sizeof(*timer));
+	ni_memstat_alloc(NI_MEMSTAT_TIMER, timer);
 	timer->callback = callback;
 	timer->user_data = data;
 	timer->ident = id_counter++;
@@ -51,6 +53,7 @@ ni_timer_cancel(const ni_timer_t *handle)
 
 	if ((timer = __ni_timer_disarm(handle)) != NULL) {
 		user_data = timer->user_data;
+		ni_memstat_free(NI_MEMSTAT_TIMER, timer);
 		free(timer);
 		ni_debug_verbose(NI_LOG_DEBUG2, NI_TRACE_TIMER,
 				"%s: released timer %p", __func__, timer);
@@ -99,6 +102,7 @@ ni_timer_next_timeout(void)
 				(long) timer->expires.tv_sec, (long) timer->expires.tv_usec);
 		ni_timer_list = timer->next;
 		timer->callback(timer->user_data, timer);
+		ni_memstat_free(NI_MEMSTAT_TIMER, timer);
 		free(timer);
 	}
 
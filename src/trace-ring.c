@@ -0,0 +1,1005 @@
+/*
+ * Binary trace ring of the debug messages.
+ *
+ * The ring file consists of a header page, an append-only table of
+ * the format strings seen so far and the record ring itself. Every
+ * record carries the id of its format string, the level, facility
+ * and time stamp and the raw arguments as parsed from the format;
+ * strings are copied, %m stores the errno value. Formats the ring
+ * can't represent (positional or wide arguments, %n, too many args)
+ * are formatted at record time into the reserved "%s" format 0.
+ *
+ * There is exactly one writer, the daemon owning the ring. It moves
+ * the tail over the records it is about to overwrite before writing
+ * and publishes the new head afterwards, so a reader copying the
+ * ring can discard everything the writer touched meanwhile.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include "appconfig.h"
+#include "trace-ring.h"
+
+#define NI_TRACE_RING_MAGIC		0x4e495452	/* NITR */
+#define NI_TRACE_RING_VERSION		1
+#define NI_TRACE_RING_HEADER_SIZE	4096
+#define NI_TRACE_RING_MIN_SIZE		65536
+#define NI_TRACE_RING_RECORD_MAX	4096
+#define NI_TRACE_RING_STRING_MAX	1024
+#define NI_TRACE_RING_ARGS_MAX		16
+#define NI_TRACE_RING_FORMATS_MAX	4096		/* power of 2 */
+#define NI_TRACE_RING_FORMAT_PAD	0xffff
+#define NI_TRACE_RING_STRING_NULL	0xffff
+
+typedef struct ni_trace_ring_header {
+	uint32_t		magic;
+	uint32_t		version;
+	ni_trace_ring_ctl_t	ctl;
+	uint32_t		pid;
+	uint32_t		fmt_offset;
+	uint32_t		fmt_size;
+	uint32_t		fmt_used;
+	uint32_t		data_offset;
+	uint32_t		data_size;
+	uint64_t		started;
+	uint64_t		head;
+	uint64_t		tail;
+	uint64_t		records;
+	char			program[64];
+} ni_trace_ring_header_t;
+
+typedef struct ni_trace_ring_record {
+	uint32_t		size;		/* incl. header, 8 aligned	*/
+	uint16_t		format;
+	uint8_t			level;
+	uint8_t			facility;	/* bit number			*/
+	uint64_t		time;		/* realtime nsec		*/
+} ni_trace_ring_record_t;
+
+typedef enum {
+	NI_TRACE_ARG_INT = 1,
+	NI_TRACE_ARG_LONG,
+	NI_TRACE_ARG_LLONG,
+	NI_TRACE_ARG_SIZE,
+	NI_TRACE_ARG_PTRDIFF,
+	NI_TRACE_ARG_INTMAX,
+	NI_TRACE_ARG_DOUBLE,
+	NI_TRACE_ARG_LDOUBLE,
+	NI_TRACE_ARG_STRING,
+	NI_TRACE_ARG_POINTER,
+	NI_TRACE_ARG_ERRNO,
+} ni_trace_ring_arg_type_t;
+
+/*
+ * One conversion of a format string: the arguments it consumes are
+ * an optional int width, an optional int precision and its value.
+ */
+typedef struct ni_trace_ring_spec {
+	const char *		beg;
+	const char *		end;
+	ni_bool_t		width;
+	ni_bool_t		prec;
+	int			precision;
+	unsigned int		type;
+} ni_trace_ring_spec_t;
+
+typedef struct ni_trace_ring_arg {
+	unsigned char		type;
+	short			precision;	/* strings: -1 none, -2 from the last int */
+} ni_trace_ring_arg_t;
+
+typedef struct ni_trace_ring_format {
+	const char *		fmt;
+	unsigned int		id;
+	int			nargs;		/* -1: format at record time */
+	ni_trace_ring_arg_t	args[NI_TRACE_RING_ARGS_MAX];
+} ni_trace_ring_format_t;
+
+static ni_trace_ring_ctl_t	ni_trace_ring_ctl_off;
+ni_trace_ring_ctl_t *		ni_trace_ring_ctl = &ni_trace_ring_ctl_off;
+
+static struct {
+	ni_trace_ring_header_t *	hdr;
+	size_t				size;
+	unsigned char *			fmt;
+	unsigned char *			data;
+	ni_trace_ring_format_t **	formats;
+	unsigned int			nformats;
+} ni_trace_ring;
+
+static inline uint64_t
+ni_trace_ring_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Parse the conversion at pos, which points to a '%'. Returns 1 for
+ * a conversion, 0 for a "%%" and -1 when the ring can't record it.
+ */
+static int
+ni_trace_ring_spec_parse(const char *pos, ni_trace_ring_spec_t *spec)
+{
+	enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_LD, LEN_Z, LEN_T, LEN_J };
+	const char *p = pos + 1;
+	unsigned int len = LEN_NONE;
+
+	memset(spec, 0, sizeof(*spec));
+	spec->beg = pos;
+	spec->precision = -1;
+
+	if (*p == '%') {
+		spec->end = p + 1;
+		return 0;
+	}
+
+	while (*p && strchr("-+ #0'I", *p))
+		p++;
+	if (*p == '*') {
+		spec->width = TRUE;
+		p++;
+	} else {
+		while (isdigit((unsigned char)*p))
+			p++;
+	}
+	if (*p == '$')
+		return -1;
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->prec = TRUE;
+			p++;
+		} else {
+			spec->precision = 0;
+			while (isdigit((unsigned char)*p)) {
+				if (spec->precision < NI_TRACE_RING_STRING_MAX)
+					spec->precision = spec->precision * 10 + (*p - '0');
+				p++;
+			}
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		len = (p[1] == 'h') ? LEN_HH : LEN_H;
+		break;
+	case 'l':
+		len = (p[1] == 'l') ? LEN_LL : LEN_L;
+		break;
+	case 'q':
+		len = LEN_LL;
+		break;
+	case 'L':
+		len = LEN_LD;
+		break;
+	case 'z':
+	case 'Z':
+		len = LEN_Z;
+		break;
+	case 't':
+		len = LEN_T;
+		break;
+	case 'j':
+		len = LEN_J;
+		break;
+	}
+	if (len == LEN_HH || len == LEN_LL) {
+		p += (*p == 'q') ? 1 : 2;
+	} else if (len != LEN_NONE) {
+		p++;
+	}
+
+	switch (*p) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+		switch (len) {
+		case LEN_L:	spec->type = NI_TRACE_ARG_LONG;		break;
+		case LEN_LL:	spec->type = NI_TRACE_ARG_LLONG;	break;
+		case LEN_Z:	spec->type = NI_TRACE_ARG_SIZE;		break;
+		case LEN_T:	spec->type = NI_TRACE_ARG_PTRDIFF;	break;
+		case LEN_J:	spec->type = NI_TRACE_ARG_INTMAX;	break;
+		case LEN_LD:	return -1;
+		default:	spec->type = NI_TRACE_ARG_INT;		break;
+		}
+		if (*p == 'c' && len != LEN_NONE)
+			return -1;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		spec->type = len == LEN_LD ? NI_TRACE_ARG_LDOUBLE : NI_TRACE_ARG_DOUBLE;
+		break;
+	case 's':
+		if (len != LEN_NONE)
+			return -1;
+		spec->type = NI_TRACE_ARG_STRING;
+		break;
+	case 'p':
+		spec->type = NI_TRACE_ARG_POINTER;
+		break;
+	case 'm':
+		spec->type = NI_TRACE_ARG_ERRNO;
+		break;
+	default:
+		return -1;
+	}
+
+	spec->end = p + 1;
+	return 1;
+}
+
+/*
+ * Flatten the arguments of a format; -1 if it has to be formatted
+ * at record time.
+ */
+static int
+ni_trace_ring_format_parse(const char *fmt, ni_trace_ring_arg_t *args, unsigned int max)
+{
+	ni_trace_ring_spec_t spec;
+	unsigned int nargs = 0;
+	const char *p;
+	int ret;
+
+	for (p = strchr(fmt, '%'); p; p = strchr(spec.end, '%')) {
+		if ((ret = ni_trace_ring_spec_parse(p, &spec)) < 0)
+			return -1;
+		if (ret == 0)
+			continue;
+
+		if (nargs + spec.width + spec.prec + 1 > max)
+			return -1;
+
+		if (spec.width) {
+			args[nargs].type = NI_TRACE_ARG_INT;
+			args[nargs++].precision = -1;
+		}
+		if (spec.prec) {
+			args[nargs].type = NI_TRACE_ARG_INT;
+			args[nargs++].precision = -1;
+		}
+		args[nargs].type = spec.type;
+		args[nargs++].precision = spec.prec ? -2 : spec.precision;
+	}
+	return nargs;
+}
+
+/*
+ * Append a format to the shared format table; its id is its index.
+ */
+static int
+ni_trace_ring_format_publish(const char *fmt)
+{
+	ni_trace_ring_header_t *hdr = ni_trace_ring.hdr;
+	size_t len = strlen(fmt) + 1;
+	uint32_t used = hdr->fmt_used;
+
+	if (ni_trace_ring.nformats >= NI_TRACE_RING_FORMAT_PAD ||
+	    used + len > hdr->fmt_size)
+		return -1;
+
+	memcpy(ni_trace_ring.fmt + used, fmt, len);
+	__atomic_store_n(&hdr->fmt_used, used + len, __ATOMIC_RELEASE);
+	return ni_trace_ring.nformats++;
+}
+
+static const ni_trace_ring_format_t *
+ni_trace_ring_format_get(const char *fmt)
+{
+	ni_trace_ring_format_t *format;
+	unsigned int hash, i;
+	int id;
+
+	hash = ((uintptr_t)fmt >> 3) * 2654435761U;
+	for (i = 0; i < NI_TRACE_RING_FORMATS_MAX; ++i) {
+		hash &= NI_TRACE_RING_FORMATS_MAX - 1;
+		if (!(format = ni_trace_ring.formats[hash]))
+			break;
+		if (format->fmt == fmt)
+			return format;
+		hash++;
+	}
+
+	/* keep the probe chains short, fall back to format 0 */
+	if (ni_trace_ring.nformats >= NI_TRACE_RING_FORMATS_MAX * 3 / 4)
+		return NULL;
+
+	if (!(format = calloc(1, sizeof(*format))))
+		return NULL;
+
+	format->fmt = fmt;
+	format->nargs = ni_trace_ring_format_parse(fmt, format->args, NI_TRACE_RING_ARGS_MAX);
+	if (format->nargs < 0 || (id = ni_trace_ring_format_publish(fmt)) < 0) {
+		format->nargs = -1;
+		format->id = 0;
+	} else {
+		format->id = id;
+	}
+
+	ni_trace_ring.formats[hash] = format;
+	return format;
+}
+
+static inline unsigned char *
+ni_trace_ring_put(unsigned char *p, const void *val, size_t len)
+{
+	memcpy(p, val, len);
+	return p + len;
+}
+
+static unsigned char *
+ni_trace_ring_put_string(unsigned char *p, const char *str, int precision, ptrdiff_t room)
+{
+	uint16_t len;
+
+	if (!str) {
+		len = NI_TRACE_RING_STRING_NULL;
+		return ni_trace_ring_put(p, &len, sizeof(len));
+	}
+
+	room -= sizeof(len);
+	if (room < 0)
+		room = 0;
+	if (room > NI_TRACE_RING_STRING_MAX)
+		room = NI_TRACE_RING_STRING_MAX;
+	if (precision >= 0 && precision < room)
+		room = precision;
+
+	len = strnlen(str, room);
+	p = ni_trace_ring_put(p, &len, sizeof(len));
+	return ni_trace_ring_put(p, str, len);
+}
+
+static unsigned char *
+ni_trace_ring_put_args(unsigned char *p, unsigned char *end,
+		const ni_trace_ring_format_t *format, int err, va_list ap)
+{
+	const ni_trace_ring_arg_t *arg;
+	int last = -1, precision;
+	int64_t ival;
+	double dval;
+	int i;
+
+	for (i = 0; i < format->nargs; ++i) {
+		arg = &format->args[i];
+
+		switch (arg->type) {
+		case NI_TRACE_ARG_INT:
+			ival = last = va_arg(ap, int);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_LONG:
+			ival = va_arg(ap, long);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_LLONG:
+			ival = va_arg(ap, long long);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_SIZE:
+			ival = va_arg(ap, size_t);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_PTRDIFF:
+			ival = va_arg(ap, ptrdiff_t);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_INTMAX:
+			ival = va_arg(ap, intmax_t);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_POINTER:
+			ival = (uintptr_t)va_arg(ap, void *);
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_DOUBLE:
+			dval = va_arg(ap, double);
+			p = ni_trace_ring_put(p, &dval, sizeof(dval));
+			break;
+		case NI_TRACE_ARG_LDOUBLE:
+			dval = va_arg(ap, long double);
+			p = ni_trace_ring_put(p, &dval, sizeof(dval));
+			break;
+		case NI_TRACE_ARG_ERRNO:
+			ival = err;
+			p = ni_trace_ring_put(p, &ival, sizeof(ival));
+			break;
+		case NI_TRACE_ARG_STRING:
+			precision = arg->precision == -2 ? last : arg->precision;
+			/* leave 8 bytes for each of the remaining arguments */
+			p = ni_trace_ring_put_string(p, va_arg(ap, const char *), precision,
+					end - p - 8 * (format->nargs - i - 1));
+			break;
+		}
+	}
+	return p;
+}
+
+static void
+ni_trace_ring_write(const ni_trace_ring_record_t *rec)
+{
+	ni_trace_ring_header_t *hdr = ni_trace_ring.hdr;
+	uint32_t size = hdr->data_size;
+	uint64_t head = hdr->head;
+	uint64_t tail = hdr->tail;
+	uint32_t off = head % size;
+	uint32_t pad = 0, len;
+
+	if (off + rec->size > size)
+		pad = size - off;
+
+	/* drop the oldest records to make room */
+	while (head + pad + rec->size - tail > size) {
+		memcpy(&len, ni_trace_ring.data + tail % size, sizeof(len));
+		if (len < sizeof(len) || len > size) {
+			tail = head;
+			break;
+		}
+		tail += len;
+	}
+	__atomic_store_n(&hdr->tail, tail, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (pad) {
+		ni_trace_ring_record_t marker = {
+			.size	= pad,
+			.format	= NI_TRACE_RING_FORMAT_PAD,
+		};
+
+		memcpy(ni_trace_ring.data + off, &marker, pad < sizeof(marker) ?
+				offsetof(ni_trace_ring_record_t, level) : sizeof(marker));
+		head += pad;
+		off = 0;
+	}
+
+	memcpy(ni_trace_ring.data + off, rec, rec->size);
+	hdr->records++;
+	__atomic_store_n(&hdr->head, head + rec->size, __ATOMIC_RELEASE);
+}
+
+void
+ni_trace_ring_record(unsigned int level, unsigned int facility, int err,
+			const char *fmt, va_list ap)
+{
+	union {
+		ni_trace_ring_record_t	rec;
+		unsigned char		buf[NI_TRACE_RING_RECORD_MAX];
+	} u;
+	const ni_trace_ring_format_t *format;
+	unsigned char *p, *end;
+	char msg[NI_TRACE_RING_STRING_MAX];
+	size_t len;
+
+	if (!ni_trace_ring.hdr || !fmt || !facility)
+		return;
+
+	u.rec.time = ni_trace_ring_now();
+	u.rec.level = level;
+	u.rec.facility = __builtin_ctz(facility);
+
+	p = u.buf + sizeof(u.rec);
+	end = u.buf + sizeof(u.buf);
+	if ((format = ni_trace_ring_format_get(fmt)) && format->nargs >= 0) {
+		u.rec.format = format->id;
+		p = ni_trace_ring_put_args(p, end, format, err, ap);
+	} else {
+		errno = err;
+		vsnprintf(msg, sizeof(msg), fmt, ap);
+
+		u.rec.format = 0;
+		p = ni_trace_ring_put_string(p, msg, -1, end - p);
+	}
+
+	len = p - u.buf;
+	u.rec.size = (len + 7) & ~7U;
+	memset(p, 0, u.rec.size - len);
+	ni_trace_ring_write(&u.rec);
+}
+
+static ni_bool_t
+ni_trace_ring_map(const char *path, size_t data_size, const char *program)
+{
+	ni_trace_ring_header_t *hdr;
+	size_t fmt_size, size;
+	void *addr;
+	int fd;
+
+	data_size = (data_size + 4095) & ~4095UL;
+	if (data_size < NI_TRACE_RING_MIN_SIZE)
+		data_size = NI_TRACE_RING_MIN_SIZE;
+	fmt_size = ((data_size / 4) + 4095) & ~4095UL;
+	if (fmt_size < NI_TRACE_RING_MIN_SIZE)
+		fmt_size = NI_TRACE_RING_MIN_SIZE;
+	size = NI_TRACE_RING_HEADER_SIZE + fmt_size + data_size;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) < 0) {
+		ni_error("unable to create trace ring %s: %m", path);
+		return FALSE;
+	}
+	if (ftruncate(fd, size) < 0) {
+		ni_error("unable to resize trace ring %s: %m", path);
+		close(fd);
+		unlink(path);
+		return FALSE;
+	}
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		ni_error("unable to map trace ring %s: %m", path);
+		unlink(path);
+		return FALSE;
+	}
+
+	hdr = addr;
+	hdr->version = NI_TRACE_RING_VERSION;
+	hdr->pid = getpid();
+	hdr->fmt_offset = NI_TRACE_RING_HEADER_SIZE;
+	hdr->fmt_size = fmt_size;
+	hdr->data_offset = NI_TRACE_RING_HEADER_SIZE + fmt_size;
+	hdr->data_size = data_size;
+	hdr->started = ni_trace_ring_now();
+	snprintf(hdr->program, sizeof(hdr->program), "%s", program);
+
+	ni_trace_ring.hdr = hdr;
+	ni_trace_ring.size = size;
+	ni_trace_ring.fmt = (unsigned char *)addr + hdr->fmt_offset;
+	ni_trace_ring.data = (unsigned char *)addr + hdr->data_offset;
+	ni_trace_ring.nformats = 0;
+
+	/* format 0 carries the messages formatted at record time */
+	ni_trace_ring_format_publish("%s");
+
+	__atomic_store_n(&hdr->magic, NI_TRACE_RING_MAGIC, __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+/*
+ * Create the trace ring of a daemon as configured; the ring of a
+ * previous instance is kept as .old for a post mortem look.
+ */
+ni_bool_t
+ni_trace_ring_open(const char *program)
+{
+	const ni_config_trace_t *conf = ni_config_trace();
+	unsigned int facilities = conf ? conf->facilities : 0;
+	unsigned int level = conf ? conf->level : NI_LOG_DEBUG;
+	char path[PATH_MAX], old[PATH_MAX];
+	const char *var;
+
+	if (ni_trace_ring.hdr || ni_string_empty(program))
+		return FALSE;
+
+	if (!conf || !conf->buffer_size)
+		return TRUE;
+
+	if (!ni_string_empty(var = getenv("WICKED_TRACE")) &&
+	    ni_debug_parse_facilities(var, &facilities) < 0)
+		ni_warn("ignoring invalid WICKED_TRACE facilities '%s'", var);
+
+	if (!(ni_trace_ring.formats = calloc(NI_TRACE_RING_FORMATS_MAX,
+					sizeof(*ni_trace_ring.formats))))
+		return FALSE;
+
+	snprintf(path, sizeof(path), "%s/%s" NI_TRACE_RING_SUFFIX,
+			ni_config_statedir(), program);
+	snprintf(old, sizeof(old), "%s/%s" NI_TRACE_RING_OLD_SUFFIX,
+			ni_config_statedir(), program);
+	if (rename(path, old) < 0 && errno != ENOENT)
+		unlink(path);
+
+	if (!ni_trace_ring_map(path, conf->buffer_size, program)) {
+		ni_trace_ring_close();
+		return FALSE;
+	}
+
+	ni_trace_ring.hdr->ctl.loglevel = level;
+	ni_trace_ring.hdr->ctl.facilities = facilities;
+	ni_trace_ring_ctl = &ni_trace_ring.hdr->ctl;
+	return TRUE;
+}
+
+void
+ni_trace_ring_close(void)
+{
+	unsigned int i;
+
+	ni_trace_ring_ctl = &ni_trace_ring_ctl_off;
+	if (ni_trace_ring.hdr)
+		munmap(ni_trace_ring.hdr, ni_trace_ring.size);
+
+	if (ni_trace_ring.formats) {
+		for (i = 0; i < NI_TRACE_RING_FORMATS_MAX; ++i)
+			free(ni_trace_ring.formats[i]);
+		free(ni_trace_ring.formats);
+	}
+	memset(&ni_trace_ring, 0, sizeof(ni_trace_ring));
+}
+
+/*
+ * A forked child must not write into the ring of its parent
+ */
+void
+ni_trace_ring_detach(void)
+{
+	ni_trace_ring_ctl = &ni_trace_ring_ctl_off;
+	ni_trace_ring.hdr = NULL;
+}
+
+void
+ni_trace_ring_reown(void)
+{
+	if (ni_trace_ring.hdr)
+		ni_trace_ring.hdr->pid = getpid();
+}
+
+/*
+ * Reader side
+ */
+static void *
+ni_trace_ring_load(const char *path, int prot, size_t *size)
+{
+	const ni_trace_ring_header_t *hdr;
+	struct stat st;
+	void *addr;
+	int fd;
+
+	if ((fd = open(path, (prot & PROT_WRITE ? O_RDWR : O_RDONLY) | O_CLOEXEC)) < 0) {
+		ni_error("unable to open trace ring %s: %m", path);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < NI_TRACE_RING_HEADER_SIZE) {
+		ni_error("%s: not a trace ring", path);
+		close(fd);
+		return NULL;
+	}
+
+	addr = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		ni_error("unable to map trace ring %s: %m", path);
+		return NULL;
+	}
+
+	hdr = addr;
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != NI_TRACE_RING_MAGIC ||
+	    hdr->version != NI_TRACE_RING_VERSION ||
+	    hdr->fmt_offset < sizeof(*hdr) ||
+	    (uint64_t)hdr->fmt_offset + hdr->fmt_size > hdr->data_offset ||
+	    (uint64_t)hdr->data_offset + hdr->data_size > (uint64_t)st.st_size ||
+	    hdr->data_size < NI_TRACE_RING_RECORD_MAX) {
+		ni_error("%s: not a trace ring or unsupported version", path);
+		munmap(addr, st.st_size);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return addr;
+}
+
+static unsigned int
+ni_trace_ring_format_index(const char *fmt, size_t used, const char ***index)
+{
+	unsigned int count = 0, n = 0;
+	size_t i;
+
+	for (i = 0; i < used; ++i) {
+		if (fmt[i] == '\0')
+			count++;
+	}
+
+	if (!(*index = calloc(count + 1, sizeof(**index))))
+		return 0;
+
+	for (i = 0; i < used && n < count; i += strlen(fmt + i) + 1)
+		(*index)[n++] = fmt + i;
+	return n;
+}
+
+ni_bool_t
+ni_trace_ring_info(const char *path, ni_trace_ring_info_t *info)
+{
+	const ni_trace_ring_header_t *hdr;
+	size_t size, used, i;
+	const char *fmt;
+
+	if (!info || !(hdr = ni_trace_ring_load(path, PROT_READ, &size)))
+		return FALSE;
+
+	memset(info, 0, sizeof(*info));
+	snprintf(info->program, sizeof(info->program), "%.*s",
+			(int)sizeof(hdr->program) - 1, hdr->program);
+	info->pid = hdr->pid;
+	info->facilities = hdr->ctl.facilities;
+	info->level = hdr->ctl.loglevel;
+	info->started = hdr->started;
+	info->size = hdr->data_size;
+	info->written = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	info->records = hdr->records;
+
+	fmt = (const char *)hdr + hdr->fmt_offset;
+	used = __atomic_load_n(&hdr->fmt_used, __ATOMIC_ACQUIRE);
+	for (i = 0; i < used && i < hdr->fmt_size; ++i) {
+		if (fmt[i] == '\0')
+			info->formats++;
+	}
+
+	munmap((void *)hdr, size);
+	return TRUE;
+}
+
+ni_bool_t
+ni_trace_ring_control(const char *path, const unsigned int *facilities,
+			const unsigned int *level)
+{
+	ni_trace_ring_header_t *hdr;
+	size_t size;
+
+	if (!(hdr = ni_trace_ring_load(path, PROT_READ | PROT_WRITE, &size)))
+		return FALSE;
+
+	if (level)
+		__atomic_store_n(&hdr->ctl.loglevel, *level, __ATOMIC_RELAXED);
+	if (facilities)
+		__atomic_store_n(&hdr->ctl.facilities, *facilities, __ATOMIC_RELAXED);
+
+	munmap(hdr, size);
+	return TRUE;
+}
+
+/*
+ * Rewrite the '*' width and precision of a conversion with the
+ * recorded values, so it can be handed to snprintf on its own.
+ */
+static void
+ni_trace_ring_spec_fixup(const ni_trace_ring_spec_t *spec, int width, int prec,
+			char *buf, size_t size)
+{
+	unsigned int stars = 0;
+	const char *p;
+	size_t len = 0;
+
+	for (p = spec->beg; p < spec->end && len + 16 < size; ++p) {
+		if (*p == '*') {
+			if (stars++ == 0 && spec->width)
+				len += snprintf(buf + len, size - len, "%d", width);
+			else
+				len += snprintf(buf + len, size - len, "%d", prec);
+			continue;
+		}
+		/* a negative precision argument means no precision */
+		if (*p == '.' && p[1] == '*' && spec->prec && prec < 0) {
+			stars++;
+			p++;
+			continue;
+		}
+		buf[len++] = *p;
+	}
+	buf[len] = '\0';
+}
+
+static const unsigned char *
+ni_trace_ring_get(const unsigned char *p, const unsigned char *end, void *val, size_t len)
+{
+	if (!p || p + len > end)
+		return NULL;
+	memcpy(val, p, len);
+	return p + len;
+}
+
+static void
+ni_trace_ring_format_record(ni_stringbuf_t *out, const char *fmt,
+			const unsigned char *p, const unsigned char *end)
+{
+	ni_trace_ring_spec_t spec;
+	char conv[64], str[NI_TRACE_RING_STRING_MAX + 1];
+	int width, prec, ret;
+	const char *pos;
+	uint16_t slen;
+	int64_t ival;
+	double dval;
+
+	for (pos = fmt; (fmt = strchr(pos, '%')); pos = spec.end) {
+		ni_stringbuf_put(out, pos, fmt - pos);
+
+		if ((ret = ni_trace_ring_spec_parse(fmt, &spec)) < 0) {
+			ni_stringbuf_puts(out, fmt);
+			return;
+		}
+		if (ret == 0) {
+			ni_stringbuf_putc(out, '%');
+			continue;
+		}
+
+		width = 0;
+		prec = -1;
+		if (spec.width && (p = ni_trace_ring_get(p, end, &ival, sizeof(ival))))
+			width = ival;
+		if (spec.prec && (p = ni_trace_ring_get(p, end, &ival, sizeof(ival))))
+			prec = ival;
+		ni_trace_ring_spec_fixup(&spec, width, prec, conv, sizeof(conv));
+
+		switch (spec.type) {
+		case NI_TRACE_ARG_STRING:
+			if (!(p = ni_trace_ring_get(p, end, &slen, sizeof(slen))))
+				break;
+			if (slen == NI_TRACE_RING_STRING_NULL) {
+				ni_stringbuf_printf(out, conv, "(null)");
+				break;
+			}
+			if (slen > NI_TRACE_RING_STRING_MAX || p + slen > end) {
+				p = NULL;
+				break;
+			}
+			memcpy(str, p, slen);
+			str[slen] = '\0';
+			p += slen;
+			ni_stringbuf_printf(out, conv, str);
+			break;
+
+		case NI_TRACE_ARG_DOUBLE:
+			if ((p = ni_trace_ring_get(p, end, &dval, sizeof(dval))))
+				ni_stringbuf_printf(out, conv, dval);
+			break;
+		case NI_TRACE_ARG_LDOUBLE:
+			if ((p = ni_trace_ring_get(p, end, &dval, sizeof(dval))))
+				ni_stringbuf_printf(out, conv, (long double)dval);
+			break;
+
+		default:
+			if (!(p = ni_trace_ring_get(p, end, &ival, sizeof(ival))))
+				break;
+
+			switch (spec.type) {
+			case NI_TRACE_ARG_INT:
+				ni_stringbuf_printf(out, conv, (int)ival);
+				break;
+			case NI_TRACE_ARG_LONG:
+				ni_stringbuf_printf(out, conv, (long)ival);
+				break;
+			case NI_TRACE_ARG_LLONG:
+				ni_stringbuf_printf(out, conv, (long long)ival);
+				break;
+			case NI_TRACE_ARG_SIZE:
+				ni_stringbuf_printf(out, conv, (size_t)ival);
+				break;
+			case NI_TRACE_ARG_PTRDIFF:
+				ni_stringbuf_printf(out, conv, (ptrdiff_t)ival);
+				break;
+			case NI_TRACE_ARG_INTMAX:
+				ni_stringbuf_printf(out, conv, (intmax_t)ival);
+				break;
+			case NI_TRACE_ARG_POINTER:
+				ni_stringbuf_printf(out, conv, (void *)(uintptr_t)ival);
+				break;
+			case NI_TRACE_ARG_ERRNO:
+				ni_stringbuf_puts(out, strerror(ival));
+				break;
+			}
+			break;
+		}
+
+		if (!p) {
+			ni_stringbuf_puts(out, " <truncated>");
+			return;
+		}
+	}
+	ni_stringbuf_puts(out, pos);
+}
+
+static void
+ni_trace_ring_print_record(FILE *out, const ni_trace_ring_header_t *hdr,
+			const ni_trace_ring_record_t *rec, const char *fmt)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	const unsigned char *data = (const unsigned char *)rec;
+	const char *facility;
+	time_t sec = rec->time / 1000000000ULL;
+	char date[32];
+	struct tm tm;
+
+	localtime_r(&sec, &tm);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+	facility = ni_debug_facility_to_name(1U << rec->facility);
+
+	if (fmt) {
+		ni_trace_ring_format_record(&buf, fmt, data + sizeof(*rec), data + rec->size);
+	} else {
+		ni_stringbuf_printf(&buf, "<unknown format %u>", rec->format);
+	}
+
+	fprintf(out, "%s.%06u %.*s[%d] %s: %s\n", date,
+			(unsigned int)(rec->time % 1000000000ULL) / 1000,
+			(int)sizeof(hdr->program), hdr->program, (int)hdr->pid,
+			facility ? facility : "?",
+			buf.string ? buf.string : "");
+	ni_stringbuf_destroy(&buf);
+}
+
+/*
+ * Print the records of a ring, oldest first. Returns the number
+ * of records printed or -1 on error.
+ */
+int
+ni_trace_ring_dump(const char *path, FILE *out, unsigned int facilities, unsigned int level)
+{
+	const ni_trace_ring_header_t *hdr;
+	const ni_trace_ring_record_t *rec;
+	const char **formats = NULL;
+	unsigned char *data = NULL;
+	unsigned int nformats;
+	uint64_t head, tail, pos;
+	char *fmt = NULL;
+	size_t size, used;
+	int count = 0;
+
+	if (!(hdr = ni_trace_ring_load(path, PROT_READ, &size)))
+		return -1;
+
+	used = __atomic_load_n(&hdr->fmt_used, __ATOMIC_ACQUIRE);
+	if (used > hdr->fmt_size)
+		used = hdr->fmt_size;
+	head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+
+	if (!(fmt = malloc(used + 1)) || !(data = malloc(hdr->data_size))) {
+		count = -1;
+		goto done;
+	}
+	memcpy(fmt, (const char *)hdr + hdr->fmt_offset, used);
+	fmt[used] = '\0';
+	memcpy(data, (const unsigned char *)hdr + hdr->data_offset, hdr->data_size);
+
+	/* everything before the current tail may have been overwritten */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	tail = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+	nformats = ni_trace_ring_format_index(fmt, used, &formats);
+
+	for (pos = tail; pos < head; pos += rec->size) {
+		rec = (const ni_trace_ring_record_t *)(data + pos % hdr->data_size);
+		if (rec->size < sizeof(rec->size) || rec->size % 8 ||
+		    rec->size > NI_TRACE_RING_RECORD_MAX ||
+		    pos % hdr->data_size + rec->size > hdr->data_size ||
+		    pos + rec->size > head) {
+			fprintf(out, "%s: corrupted record at %llu, stopping\n",
+					path, (unsigned long long)pos);
+			break;
+		}
+
+		if (rec->size < sizeof(*rec) || rec->format == NI_TRACE_RING_FORMAT_PAD)
+			continue;
+		if (rec->facility >= sizeof(facilities) * 8) {
+			fprintf(out, "%s: invalid facility %u in record at %llu, skipped\n",
+					path, rec->facility, (unsigned long long)pos);
+			continue;
+		}
+		if (rec->level > level || !(facilities & (1U << rec->facility)))
+			continue;
+
+		ni_trace_ring_print_record(out, hdr, rec,
+				rec->format < nformats ? formats[rec->format] : NULL);
+		count++;
+	}
+
+done:
+	free(formats);
+	free(data);
+	free(fmt);
+	munmap((void *)hdr, size);
+	return count;
+}
@@ -0,0 +1,48 @@
+/*
+ * Binary trace ring of the debug messages.
+ *
+ * A daemon maps a ring file in the state directory and records the
+ * debug messages of the enabled facilities in it as format id, time
+ * stamp and raw arguments; the formatting is deferred to the reader
+ * (wicked trace), which can also change the recorded facilities and
+ * level of a running daemon through the shared ring header.
+ *
+ * Copyright (C) 2016 SUSE Linux GmbH, Nuernberg, Germany.
+ */
+#ifndef __WICKED_TRACE_RING_H__
+#define __WICKED_TRACE_RING_H__
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <wicked/types.h>
+
+#define NI_TRACE_RING_SUFFIX		".trace"
+#define NI_TRACE_RING_OLD_SUFFIX	".trace.old"
+
+typedef struct ni_trace_ring_info {
+	char			program[64];
+	pid_t			pid;
+	unsigned int		facilities;
+	unsigned int		level;
+	uint64_t		started;	/* realtime nsec	*/
+	size_t			size;		/* data bytes		*/
+	uint64_t		written;	/* data bytes		*/
+	uint64_t		records;
+	unsigned int		formats;
+} ni_trace_ring_info_t;
+
+extern void		ni_trace_ring_record(unsigned int level, unsigned int facility,
+					int err, const char *fmt, va_list ap);
+extern void		ni_trace_ring_detach(void);
+extern void		ni_trace_ring_reown(void);
+
+extern ni_bool_t	ni_trace_ring_info(const char *path, ni_trace_ring_info_t *);
+extern int		ni_trace_ring_dump(const char *path, FILE *out,
+					unsigned int facilities, unsigned int level);
+extern ni_bool_t	ni_trace_ring_control(const char *path,
+					const unsigned int *facilities,
+					const unsigned int *level);
+
+#endif /* __WICKED_TRACE_RING_H__ */
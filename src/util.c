@@ -26,6 +26,7 @@
 #include <wicked/netinfo.h> /* only for CONFIG_WICKED_STATEDIR */
 #include <wicked/fsm.h> /* for NI_IFWORKER_INFINITE_TIMEOUT */
 #include "util_priv.h"
+#include "trace-ring.h"
 
 #define NI_STRING_ARRAY_CHUNK	16
 #define NI_UINT_ARRAY_CHUNK	16
@@ -2134,6 +2135,7 @@ ni_daemonize(const char *pidfile, unsigned int permissions, ni_daemon_close_t cl
 	/* fork, chdir to root and close fds */
 	if (daemon(0, TRUE) < 0)
 		ni_fatal("unable to background process! daemon() failed: %m");
+	ni_trace_ring_reown();
 
 	if (close_flags & NI_DAEMON_CLOSE_IN)
 		rv = freopen("/dev/null", "r", stdin);
@@ -53,6 +53,14 @@
 #define NI_WPA_BSS_INTERFACE	"fi.epitest.hostap.WPASupplicant.BSSID"
 #define NI_WPA_NETWORK_INTERFACE "fi.epitest.hostap.WPASupplicant.Network"
 
+/*
+ * The BSS properties are retrieved with one call per BSS object. Keep
+ * a bounded window of calls in flight, and retrieve the properties of
+ * a BSS seen in the scan results again only after the refresh time.
+ */
+#define NI_WPA_BSS_REQUEST_WINDOW	8
+#define NI_WPA_BSS_REFRESH_TIME		60	/* sec */
+
 struct ni_wpa_client {
 	ni_dbus_client_t *	dbus;
 
@@ -78,7 +86,7 @@ static int		ni_wpa_prepare_interface(ni_wpa_client_t *, ni_wpa_interface_t *, co
 static int		ni_wpa_interface_get_state(ni_wpa_client_t *, ni_wpa_interface_t *);
 static int		ni_wpa_interface_get_capabilities(ni_wpa_client_t *, ni_wpa_interface_t *);
 static void		ni_wpa_interface_update_state(ni_wpa_interface_t *, ni_wpa_ifstate_t);
-static void		ni_wpa_network_request_properties(ni_dbus_object_t *);
+static void		ni_wpa_bss_properties_result(ni_dbus_object_t *, ni_dbus_message_t *);
 static void		ni_wpa_signal(ni_dbus_connection_t *, ni_dbus_message_t *, void *);
 static const char *	ni_wpa_auth_protocol_as_string(ni_wireless_auth_mode_t, DBusError *);
 static dbus_bool_t	ni_wpa_auth_protocol_from_string(const char *, ni_wireless_auth_mode_t *, DBusError *);
@@ -301,6 +309,7 @@ static void
 ni_wpa_interface_free(ni_wpa_interface_t *wpa_dev)
 {
 	ni_string_free(&wpa_dev->ifname);
+	ni_string_array_destroy(&wpa_dev->scan.queue);
 	ni_wpa_interface_unbind(wpa_dev);
 	free(wpa_dev);
 }
@@ -359,6 +368,9 @@ ni_wpa_interface_expire_networks(ni_wpa_interface_t *dev, unsigned int max_age)
 
 	now = time(NULL) - max_age;
 	for (net = ni_wpa_interface_first_network(dev, &pos, &cur); net; net = ni_wpa_interface_next_network(dev, &pos, &cur)) {
+		/* Keep BSSes with a properties call in flight */
+		if (net->scan_info.updating)
+			continue;
 		if (net->scan_info.timestamp && net->scan_info.timestamp < now) {
 			/* This will also remove child from the list of dev_object->children */
 			ni_dbus_object_free(cur);
@@ -607,28 +619,41 @@ ni_wpa_interface_scan_in_progress(ni_wpa_interface_t *wpa_dev)
 	return FALSE;
 }
 
+static ni_wireless_network_t *
+ni_wpa_scan_network_by_bssid(const ni_wireless_network_array_t *networks, const ni_hwaddr_t *bssid)
+{
+	unsigned int i;
+
+	for (i = 0; i < networks->count; ++i) {
+		if (ni_link_address_equal(&networks->data[i]->access_point, bssid))
+			return networks->data[i];
+	}
+	return NULL;
+}
+
 /*
  * Copy scan results from wpa objects to generic ni_wireless_scan_t object
- * Returns TRUE iff the list of networks in scanning range changed.
+ * Returns TRUE iff the list of networks in scanning range changed, that
+ * is, when a BSSID appeared or disappeared, or its properties changed.
  */
 ni_bool_t
 ni_wpa_interface_retrieve_scan(ni_wpa_interface_t *wpa_dev, ni_wireless_scan_t *scan)
 {
+	ni_wireless_network_array_t networks;
 	ni_wireless_network_t *net;
 	ni_dbus_object_t *pos;
 	ni_bool_t send_event = FALSE;
 
 	/* Prune old BSSes */
 	if (ni_wpa_interface_expire_networks(wpa_dev, scan->interval + 1) == 0) {
-		/* Nothing pruned. If we didn't receive new scan results in the
-		 * mean time, there's nothing we need to do. */
-		if (scan->timestamp == wpa_dev->scan.timestamp)
+		/* Nothing pruned. If we didn't receive new scan results or
+		 * BSS properties in the mean time, there's nothing to do. */
+		if (!wpa_dev->scan.changed)
 			return FALSE;
-
-		send_event = TRUE;
 	}
+	wpa_dev->scan.changed = 0;
 
-	ni_wireless_network_array_destroy(&scan->networks);
+	ni_wireless_network_array_init(&networks);
 	for (net = ni_wpa_interface_first_network(wpa_dev, &pos, NULL); net; net = ni_wpa_interface_next_network(wpa_dev, &pos, NULL)) {
 		/* We mix networks learned through scanning with those we configured manually.
 		 * We can tell them apart by their timestamp field. Manually configured networks
@@ -638,14 +663,23 @@ ni_wpa_interface_retrieve_scan(ni_wpa_interface_t *wpa_dev, ni_wireless_scan_t *
 		 * new network from wpa-supplicant. In this case, the access_point has not been
 		 * set yet.
 		 */
-		if (net->scan_info.timestamp && net->access_point.len != 0) {
-			ni_wireless_network_array_append(&scan->networks, net);
-			if (!net->notified) {
-				net->notified = TRUE;
-				send_event = TRUE;
-			}
+		if (!net->scan_info.timestamp || net->access_point.len == 0)
+			continue;
+
+		ni_wireless_network_array_append(&networks, net);
+		if (!net->notified || ni_wpa_scan_network_by_bssid(&scan->networks,
+						&net->access_point) != net) {
+			net->notified = TRUE;
+			send_event = TRUE;
 		}
 	}
+
+	/* all remaining BSSIDs are unchanged, so any other difference is a removal */
+	if (networks.count != scan->networks.count)
+		send_event = TRUE;
+
+	ni_wireless_network_array_destroy(&scan->networks);
+	scan->networks = networks;
 	scan->timestamp = wpa_dev->scan.timestamp;
 
 	return send_event;
@@ -896,10 +930,73 @@ ni_wpa_interface_update_state(ni_wpa_interface_t *dev, ni_wpa_ifstate_t new_stat
 	ni_wireless_association_changed(dev->ifindex, assoc_state);
 }
 
+/*
+ * Request the properties of the queued BSS objects, keeping at most
+ * NI_WPA_BSS_REQUEST_WINDOW calls in flight.
+ */
+static void
+ni_wpa_interface_request_bss_properties(ni_wpa_interface_t *wpa_dev)
+{
+	ni_string_array_t *queue = &wpa_dev->scan.queue;
+	ni_dbus_object_t *net_object;
+	ni_wireless_network_t *net;
+
+	while (wpa_dev->scan.requests < NI_WPA_BSS_REQUEST_WINDOW && wpa_dev->scan.next < queue->count) {
+		const char *path = queue->data[wpa_dev->scan.next++];
+
+		if (!(net_object = ni_wpa_interface_network_by_path(wpa_dev, path)))
+			continue;
+
+		net = net_object->handle;
+		if (!wpa_dev->proxy) {
+			net->scan_info.updating = FALSE;
+			continue;
+		}
+		if (ni_dbus_object_call_async(net_object, ni_wpa_bss_properties_result,
+						"properties", 0) < 0) {
+			net->scan_info.updating = FALSE;
+			continue;
+		}
+		wpa_dev->scan.requests++;
+	}
+
+	if (wpa_dev->scan.next >= queue->count) {
+		ni_string_array_destroy(queue);
+		wpa_dev->scan.next = 0;
+	}
+}
+
+/*
+ * Drop the BSS objects not in the latest scan results
+ */
+static unsigned int
+ni_wpa_interface_prune_networks(ni_wpa_interface_t *wpa_dev, char **paths, unsigned int count)
+{
+	ni_dbus_object_t *pos, *cur;
+	ni_wireless_network_t *net;
+	unsigned int i, num_pruned = 0;
+
+	for (net = ni_wpa_interface_first_network(wpa_dev, &pos, &cur); net; net = ni_wpa_interface_next_network(wpa_dev, &pos, &cur)) {
+		if (net->scan_info.updating)
+			continue;
+
+		for (i = 0; i < count && !ni_string_eq(cur->path, paths[i]); ++i)
+			;
+		if (i < count)
+			continue;
+
+		ni_dbus_object_free(cur);
+		num_pruned++;
+	}
+	return num_pruned;
+}
+
 /*
  * Handle async retrieval of scan results.
  * The results of a scan consists of a list of object path names,
- * each of which identifies a BSS object.
+ * each of which identifies a BSS object. We queue the BSSes that
+ * are new or have not been refreshed for a while for retrieval of
+ * their properties and drop the ones that are gone.
  */
 static void
 ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
@@ -907,6 +1004,7 @@ ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 	ni_wpa_interface_t *wpa_dev = proxy->handle;
 	char **object_path_array = NULL;
 	unsigned int object_path_count = 0;
+	unsigned int queued = 0, pruned;
 	int rv;
 
 	rv = ni_dbus_message_get_args(msg,
@@ -918,8 +1016,9 @@ ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 
 	if (rv >= 0) {
 		unsigned int i;
+		time_t now;
 
-		wpa_dev->scan.timestamp = time(NULL);
+		wpa_dev->scan.timestamp = now = time(NULL);
 		for (i = 0; i < object_path_count; ++i) {
 			const char *path = object_path_array[i];
 			ni_dbus_object_t *net_object;
@@ -929,9 +1028,26 @@ ni_wpa_interface_scan_results(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 				continue;
 
 			net = net_object->handle;
+			if (net->scan_info.updating)
+				continue;
+
+			if (net->access_point.len &&
+			    net->scan_info.updated + NI_WPA_BSS_REFRESH_TIME > now) {
+				net->scan_info.timestamp = now;
+				continue;
+			}
+
 			net->scan_info.updating = TRUE;
-			ni_wpa_network_request_properties(net_object);
+			ni_string_array_append(&wpa_dev->scan.queue, path);
+			queued++;
 		}
+
+		pruned = ni_wpa_interface_prune_networks(wpa_dev, object_path_array, object_path_count);
+		wpa_dev->scan.changed = 1;
+		ni_debug_wireless("%s: %u BSSes in scan results, %u to retrieve, %u gone",
+				wpa_dev->ifname, object_path_count, queued, pruned);
+
+		ni_wpa_interface_request_bss_properties(wpa_dev);
 	}
 
 	if (object_path_array)
@@ -1788,17 +1904,45 @@ static ni_dbus_service_t	ni_wpa_network_service = {
 	.compatible	= &ni_objectmodel_wpanet_class,
 };
 
+static ni_wpa_interface_t *
+ni_wpa_network_interface(ni_dbus_object_t *net_object)
+{
+	ni_dbus_object_t *obj;
+
+	for (obj = net_object->parent; obj; obj = obj->parent) {
+		if (obj->class == &ni_objectmodel_wpadev_class)
+			return obj->handle;
+	}
+	return NULL;
+}
+
 /*
  * Callback invoked when the properties() call on a BSS object returns.
  */
 static void
 ni_wpa_bss_properties_result(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 {
+	ni_wpa_interface_t *wpa_dev = ni_wpa_network_interface(proxy);
 	ni_wireless_network_t *net = proxy->handle;
 	ni_dbus_variant_t dict = NI_DBUS_VARIANT_INIT;
 	ni_wireless_ssid_t old_essid;
+	double old_frequency;
+	uint16_t old_capabilities;
 	DBusMessageIter iter;
 
+	net->scan_info.updating = FALSE;
+	if (wpa_dev) {
+		if (wpa_dev->scan.requests)
+			wpa_dev->scan.requests--;
+		wpa_dev->scan.changed = 1;
+	}
+
+	if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_ERROR) {
+		ni_debug_wireless("%s: unable to retrieve BSS properties: %s",
+				proxy->path, dbus_message_get_error_name(msg));
+		goto done;
+	}
+
 	dbus_message_iter_init(msg, &iter);
 
 	ni_dbus_variant_init_dict(&dict);
@@ -1806,6 +1950,8 @@ ni_wpa_bss_properties_result(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 		goto failed;
 
 	old_essid = net->essid;
+	old_frequency = net->scan_info.frequency;
+	old_capabilities = net->scan_info.capabilities;
 	ni_wpa_network_properties_destroy(net);
 
 	if (!ni_dbus_object_set_properties_from_dict(proxy, &ni_wpa_bssid_service, &dict, NULL))
@@ -1820,31 +1966,24 @@ ni_wpa_bss_properties_result(ni_dbus_object_t *proxy, ni_dbus_message_t *msg)
 			net->scan_info.max_bitrate / 1000000,
 			ni_wireless_print_ssid(&net->essid));
 
-	if (net->notified && memcmp(&old_essid, &net->essid, sizeof(old_essid)) != 0) {
-		ni_debug_wireless("%s: essid changed", ni_link_address_print(&net->access_point));
+	/* signal level changes alone are not worth a scan update event */
+	if (net->notified && (memcmp(&old_essid, &net->essid, sizeof(old_essid)) != 0 ||
+			old_frequency != net->scan_info.frequency ||
+			old_capabilities != net->scan_info.capabilities)) {
+		ni_debug_wireless("%s: BSS changed", ni_link_address_print(&net->access_point));
 		net->notified = FALSE;
 	}
-	net->scan_info.timestamp = time(NULL);
+	net->scan_info.updated = net->scan_info.timestamp = time(NULL);
 
 	ni_dbus_variant_destroy(&dict);
-	return;
+	goto done;
 
 failed:
 	ni_error("trouble parsing BSS properties response");
 	ni_dbus_variant_destroy(&dict);
-}
-
-/*
- * Ask for current properties of a BSS object.
- * This is an async call.
- */
-static void
-ni_wpa_network_request_properties(ni_dbus_object_t *net_object)
-{
-	ni_dbus_object_call_async(net_object,
-			ni_wpa_bss_properties_result,
-			"properties",
-			0);
+done:
+	if (wpa_dev)
+		ni_wpa_interface_request_bss_properties(wpa_dev);
 }
 
 /*
@@ -40,6 +40,10 @@ struct ni_wpa_interface {
 	struct {
 		time_t		timestamp;
 		unsigned char	pending;
+		unsigned char	changed;	/* BSS objects changed since retrieve */
+		unsigned int	requests;	/* BSS properties calls in flight */
+		unsigned int	next;		/* next BSS in queue to request */
+		ni_string_array_t queue;	/* BSS objects to retrieve */
 	} scan;
 
 	struct {
@@ -26,6 +26,7 @@
 #include <wicked/xml.h>
 #include <wicked/logging.h>
 #include "util_priv.h"
+#include "memstat.h"
 #include <inttypes.h>
 
 #define XML_DOCUMENTARRAY_CHUNK		1
@@ -142,6 +143,7 @@ xml_node_new(const char *ident, xml_node_t *parent)
 	xml_node_t *node;
 
 	node = xcalloc(1, sizeof(xml_node_t));
+	ni_memstat_alloc(NI_MEMSTAT_XML, node);
 	if (ident)
 		node->name = xstrdup(ident);
 
@@ -302,6 +304,7 @@ xml_node_free(xml_node_t *node)
 	ni_var_array_destroy(&node->attrs);
 	free(node->cdata);
 	free(node->name);
+	ni_memstat_free(NI_MEMSTAT_XML, node);
 	free(node);
 }
 
@@ -74,12 +74,15 @@ static xpath_operator_t	__xpath_operator_getattr;
 static xpath_operator_t	__xpath_operator_predicate;
 static xpath_operator_t	__xpath_operator_stringconst;
 static xpath_operator_t	__xpath_operator_intconst;
+static xpath_operator_t	__xpath_operator_self;
+static xpath_operator_t	__xpath_operator_last;
 static xpath_operator_t *xpath_get_axis_ops(const char *);
 static xpath_operator_t *xpath_get_comparison_ops(const char **);
 static xpath_operator_t *xpath_get_infix_ops(const char *);
 static xpath_operator_t *xpath_get_function(const char *);
 
 static xpath_result_t *	__xpath_expression_eval(const xpath_enode_t *, xpath_result_t *);
+static xpath_result_t *	__xpath_expression_stream(const xpath_enode_t *, xpath_result_t *);
 static xpath_result_t *	__xpath_build_boolean(int);
 
 static xpath_enode_t *	__xpath_build_expr(const char **, char, int infixprio);
@@ -131,15 +134,74 @@ failed:
 	return NULL;
 }
 
+/*
+ * Fast path for simple child paths such as "ipv4:static" or "/a/b/c",
+ * i.e. a chain of child:: steps on top of the context node.
+ * These are walked depth first, appending the matching elements to
+ * the final result directly instead of building an intermediate
+ * result set per step. The depth first walk produces the elements
+ * in the same order as the step by step evaluation.
+ */
+#define XPATH_CHILD_PATH_MAX	16
+
+static unsigned int
+__xpath_expression_child_path(const xpath_enode_t *enode, const char **names)
+{
+	unsigned int count = 0, n;
+
+	for (; enode->ops == &__xpath_operator_child; enode = enode->left) {
+		if (!enode->left || enode->right || count >= XPATH_CHILD_PATH_MAX)
+			return 0;
+		names[count++] = enode->identifier;
+	}
+	if (enode->ops != &__xpath_operator_node || enode->left || !count)
+		return 0;
+
+	/* the steps have been collected from the last one down */
+	for (n = 0; n < count / 2; ++n) {
+		const char *name = names[n];
+
+		names[n] = names[count - 1 - n];
+		names[count - 1 - n] = name;
+	}
+	return count;
+}
+
+static void
+__xpath_child_path_match(xml_node_t *xn, const char **names, unsigned int count,
+			xpath_result_t *result)
+{
+	const char *match_name = names[0];
+	xml_node_t *cn;
+
+	for (cn = xn->children; cn; cn = cn->next) {
+		if (match_name && strcmp(cn->name, match_name))
+			continue;
+
+		if (count == 1)
+			xpath_result_append_element(result, cn);
+		else if (cn->children)
+			__xpath_child_path_match(cn, names + 1, count - 1, result);
+	}
+}
+
 /*
  * Evaluate a parsed XPATH expression
  */
 xpath_result_t *
 xpath_expression_eval(const xpath_enode_t *enode, xml_node_t *xn)
 {
-	xpath_result_t *in = xpath_result_new(XPATH_ELEMENT);
-	xpath_result_t *result;
+	const char *names[XPATH_CHILD_PATH_MAX];
+	xpath_result_t *in, *result;
+	unsigned int count;
+
+	if ((count = __xpath_expression_child_path(enode, names))) {
+		result = xpath_result_new(XPATH_ELEMENT);
+		__xpath_child_path_match(xn, names, count, result);
+		return result;
+	}
 
+	in = xpath_result_new(XPATH_ELEMENT);
 	xpath_result_append_element(in, xn);
 	result = __xpath_expression_eval(enode, in);
 	xpath_result_free(in);
@@ -710,6 +772,9 @@ __xpath_expression_eval(const xpath_enode_t *enode, xpath_result_t *in)
 	assert(enode);
 	assert(in);
 
+	if ((result = __xpath_expression_stream(enode, in)) != NULL)
+		return result;
+
 	if (enode->ops->evaluate2) {
 		xpath_result_t *left = NULL, *right = NULL;
 
@@ -1052,10 +1117,13 @@ __xpath_enode_predicate_evaluate(const xpath_enode_t *enode, xpath_result_t *lef
 				break;
 
 			case XPATH_BOOLEAN:
-				/* Just return all elements */
+				/* Just return all elements; the caller frees left */
 				if (rn->value.boolean) {
-					xpath_result_free(result);
-					return left;
+					for (m = 0; m < left->count; ++m)
+						xpath_result_append_element(result,
+								left->node[m].value.node);
+					xpath_result_free(right);
+					goto out;
 				}
 				break;
 
@@ -1128,6 +1196,408 @@ static xpath_operator_t __xpath_operator_predicate = {
 	.evaluate = __xpath_enode_predicate_evaluate
 };
 
+/*
+ * Lazy evaluation of location paths.
+ *
+ * Paths built from child::, descendant::, self:: and predicate steps
+ * are evaluated as a chain of iterators, where each step pulls the
+ * next node from the step below it. This yields the nodes in the same
+ * order as the step by step evaluation above, but does not build the
+ * node set of every intermediate step - which is what makes "//name"
+ * style expressions expensive on large documents - and stops early
+ * once a constant index predicate is satisfied.
+ *
+ * Predicates refering to last() need the size of the whole node set
+ * and are left to the generic evaluation.
+ */
+#define XPATH_ITER_STEPS_MAX	16
+
+typedef enum xpath_iter_type {
+	XPATH_ITER_INPUT = 0,		/* the context node set */
+	XPATH_ITER_CHILD,
+	XPATH_ITER_DESCENDANT,
+	XPATH_ITER_SELF,
+	XPATH_ITER_FILTER,		/* predicate evaluated for each node */
+	XPATH_ITER_INDEX,		/* constant index predicate */
+} xpath_iter_type_t;
+
+typedef struct xpath_iter_step {
+	xpath_iter_type_t	type;
+	const xpath_enode_t *	enode;
+	xml_node_t *		base;
+	xml_node_t *		cursor;
+	xpath_integer_t		count;
+	xpath_integer_t		index;
+} xpath_iter_step_t;
+
+struct xpath_iter {
+	xpath_result_t *	input;
+	xpath_result_t *	result;		/* fully evaluated fallback */
+	unsigned int		pos;
+
+	unsigned int		nsteps;
+	xpath_iter_step_t	steps[XPATH_ITER_STEPS_MAX];
+};
+
+static ni_bool_t
+__xpath_expression_uses_last(const xpath_enode_t *enode)
+{
+	if (!enode)
+		return FALSE;
+	if (enode->ops == &__xpath_operator_last)
+		return TRUE;
+	return __xpath_expression_uses_last(enode->left) ||
+		__xpath_expression_uses_last(enode->right);
+}
+
+/*
+ * Reduce a constant predicate to the (1 based) index of the
+ * node it selects, 0 if it selects none, or -1 if it selects
+ * all nodes.
+ */
+static ni_bool_t
+__xpath_iter_constant_index(const xpath_enode_t *enode, xpath_integer_t *index)
+{
+	xpath_result_t *in, *right;
+	ni_bool_t ret = TRUE;
+
+	if (__xpath_expression_uses_last(enode))
+		return FALSE;
+
+	in = xpath_result_new(XPATH_ELEMENT);
+	right = __xpath_expression_eval(enode, in);
+	xpath_result_free(in);
+	if (!right)
+		return FALSE;
+
+	if (right->count == 0) {
+		*index = 0;
+	} else
+	if (right->count > 1) {
+		ret = FALSE;
+	} else
+	if (right->type == XPATH_INTEGER) {
+		*index = right->node[0].value.integer > 0 ? right->node[0].value.integer : 0;
+	} else
+	if (right->type == XPATH_BOOLEAN) {
+		*index = right->node[0].value.boolean ? -1 : 0;
+	} else {
+		*index = 0;
+	}
+
+	xpath_result_free(right);
+	return ret;
+}
+
+static ni_bool_t
+__xpath_iter_build(xpath_iter_t *it, const xpath_enode_t *enode)
+{
+	xpath_iter_step_t *step;
+	unsigned int n;
+
+	memset(it->steps, 0, sizeof(it->steps));
+	it->nsteps = 0;
+
+	for (; enode; enode = enode->left) {
+		if (it->nsteps >= XPATH_ITER_STEPS_MAX)
+			return FALSE;
+
+		step = &it->steps[it->nsteps];
+		step->enode = enode;
+
+		if (enode->ops == &__xpath_operator_node) {
+			if (enode->left)
+				return FALSE;
+			step->type = XPATH_ITER_INPUT;
+		} else
+		if (enode->ops == &__xpath_operator_child) {
+			step->type = XPATH_ITER_CHILD;
+		} else
+		if (enode->ops == &__xpath_operator_descendant) {
+			step->type = XPATH_ITER_DESCENDANT;
+		} else
+		if (enode->ops == &__xpath_operator_self) {
+			step->type = XPATH_ITER_SELF;
+		} else
+		if (enode->ops == &__xpath_operator_predicate) {
+			if (!__xpath_expression_constant(enode->right)) {
+				step->type = XPATH_ITER_FILTER;
+			} else
+			if (!__xpath_iter_constant_index(enode->right, &step->index)) {
+				return FALSE;
+			} else
+			if (step->index < 0) {
+				/* selects all nodes: drop the step */
+				continue;
+			} else {
+				step->type = XPATH_ITER_INDEX;
+			}
+		} else {
+			return FALSE;
+		}
+
+		if (step->type != XPATH_ITER_INPUT && !enode->left)
+			return FALSE;
+		it->nsteps++;
+	}
+
+	/* Needs at least one step on top of the context node */
+	if (it->nsteps < 2 || it->steps[it->nsteps - 1].type != XPATH_ITER_INPUT)
+		return FALSE;
+
+	/* the steps have been collected from the last one down */
+	for (n = 0; n < it->nsteps / 2; ++n) {
+		xpath_iter_step_t tmp = it->steps[n];
+
+		it->steps[n] = it->steps[it->nsteps - 1 - n];
+		it->steps[it->nsteps - 1 - n] = tmp;
+	}
+	return TRUE;
+}
+
+static inline ni_bool_t
+__xpath_iter_name_match(const xpath_iter_step_t *step, const xml_node_t *xn)
+{
+	const char *match_name = step->enode->identifier;
+
+	return !match_name || !strcmp(xn->name, match_name);
+}
+
+/*
+ * Pre-order walk of the subtree below step->base
+ */
+static xml_node_t *
+__xpath_iter_descend(xpath_iter_step_t *step)
+{
+	xml_node_t *xn = step->cursor;
+
+	if (!step->base)
+		return NULL;
+
+	if (xn == NULL) {
+		xn = step->base->children;
+	} else
+	if (xn->children) {
+		xn = xn->children;
+	} else {
+		while (xn != step->base && !xn->next)
+			xn = xn->parent;
+		xn = xn != step->base ? xn->next : NULL;
+	}
+
+	if (!(step->cursor = xn))
+		step->base = NULL;
+	return xn;
+}
+
+/*
+ * Evaluate the predicate for a single node, as the generic
+ * predicate evaluation does for each element of its input.
+ */
+static ni_bool_t
+__xpath_iter_filter_match(const xpath_iter_step_t *step, xml_node_t *xn)
+{
+	xpath_result_t *tmp, *right;
+	ni_bool_t match = FALSE;
+	unsigned int n;
+
+	tmp = xpath_result_new(XPATH_ELEMENT);
+	xpath_result_append_element(tmp, xn);
+	right = __xpath_expression_eval(step->enode->right, tmp);
+	xpath_result_free(tmp);
+
+	if (!right)
+		return FALSE;
+
+	for (n = 0; n < right->count && !match; ++n) {
+		xpath_node_t *rn = &right->node[n];
+
+		switch (rn->type) {
+		case XPATH_ELEMENT:
+			match = rn->value.node != NULL;
+			break;
+
+		case XPATH_INTEGER:
+			/* Predicate indices are 1 based */
+			match = rn->value.integer == step->count;
+			break;
+
+		case XPATH_BOOLEAN:
+			match = !!rn->value.boolean;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	xpath_result_free(right);
+	return match;
+}
+
+static xml_node_t *
+__xpath_iter_pull(xpath_iter_t *it, unsigned int level)
+{
+	xpath_iter_step_t *step = &it->steps[level];
+	xml_node_t *xn;
+
+	while (TRUE) {
+		/* Continue with the current input node */
+		switch (step->type) {
+		case XPATH_ITER_INPUT:
+			if (it->pos >= it->input->count)
+				return NULL;
+			return it->input->node[it->pos++].value.node;
+
+		case XPATH_ITER_CHILD:
+			while ((xn = step->cursor) != NULL) {
+				step->cursor = xn->next;
+				if (__xpath_iter_name_match(step, xn))
+					return xn;
+			}
+			break;
+
+		case XPATH_ITER_DESCENDANT:
+			while ((xn = __xpath_iter_descend(step)) != NULL) {
+				if (__xpath_iter_name_match(step, xn))
+					return xn;
+			}
+			break;
+
+		case XPATH_ITER_INDEX:
+			if (step->count >= step->index)
+				return NULL;
+			break;
+
+		default:
+			break;
+		}
+
+		/* Advance to the next input node */
+		if (!(xn = __xpath_iter_pull(it, level - 1)))
+			return NULL;
+
+		switch (step->type) {
+		case XPATH_ITER_CHILD:
+			step->cursor = xn->children;
+			break;
+
+		case XPATH_ITER_DESCENDANT:
+			step->base = xn;
+			step->cursor = NULL;
+			break;
+
+		case XPATH_ITER_SELF:
+			if (__xpath_iter_name_match(step, xn))
+				return xn;
+			break;
+
+		case XPATH_ITER_FILTER:
+			step->count++;
+			if (__xpath_iter_filter_match(step, xn))
+				return xn;
+			break;
+
+		case XPATH_ITER_INDEX:
+			if (++step->count == step->index)
+				return xn;
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Evaluate a location path lazily, returning only the final node set.
+ * Returns NULL if the expression isn't a location path we can handle
+ * this way.
+ */
+static xpath_result_t *
+__xpath_expression_stream(const xpath_enode_t *enode, xpath_result_t *in)
+{
+	xpath_result_t *result;
+	xpath_iter_t it;
+	xml_node_t *xn;
+
+	if (enode->ops->outtype != XPATH_ELEMENT || in->type != XPATH_ELEMENT)
+		return NULL;
+
+	if (!__xpath_iter_build(&it, enode))
+		return NULL;
+
+	it.input = in;
+	it.result = NULL;
+	it.pos = 0;
+
+	xtrace("  STREAM %u steps", it.nsteps - 1);
+	result = xpath_result_new(XPATH_ELEMENT);
+	while ((xn = __xpath_iter_pull(&it, it.nsteps - 1)) != NULL)
+		xpath_result_append_element(result, xn);
+
+	__xpath_expression_eval_print_output(enode, result);
+	return result;
+}
+
+/*
+ * Iterate over the element nodes an expression refers to, without
+ * evaluating the whole node set up front where possible.
+ */
+xpath_iter_t *
+xpath_iter_new(const xpath_enode_t *enode, xml_node_t *xn)
+{
+	xpath_iter_t *it;
+
+	if (!enode || !xn)
+		return NULL;
+
+	if (enode->ops->outtype != XPATH_ELEMENT) {
+		ni_error("XPATH expression \"%s\" does not produce %s values",
+				enode->ops->name, xpath_node_type_name(XPATH_ELEMENT));
+		return NULL;
+	}
+
+	it = xcalloc(1, sizeof(*it));
+	it->input = xpath_result_new(XPATH_ELEMENT);
+	xpath_result_append_element(it->input, xn);
+
+	if (!__xpath_iter_build(it, enode)) {
+		it->nsteps = 0;
+		it->result = __xpath_expression_eval(enode, it->input);
+		if (!it->result) {
+			xpath_iter_free(it);
+			return NULL;
+		}
+	}
+	return it;
+}
+
+xml_node_t *
+xpath_iter_next(xpath_iter_t *it)
+{
+	if (!it)
+		return NULL;
+
+	if (it->result) {
+		if (it->pos >= it->result->count)
+			return NULL;
+		return it->result->node[it->pos++].value.node;
+	}
+	return __xpath_iter_pull(it, it->nsteps - 1);
+}
+
+void
+xpath_iter_free(xpath_iter_t *it)
+{
+	if (!it)
+		return;
+
+	xpath_result_free(it->input);
+	xpath_result_free(it->result);
+	free(it);
+}
+
 /*
  * Boolean AND
  */
@@ -0,0 +1,136 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wicked/types.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/bridge.h>
+
+#include "sysfs.h"
+
+/*
+ * Compare the bridge and bridge port details discovered via netlink
+ * with the details read from sysfs. Timer values are not compared,
+ * as they're changing between the reads.
+ */
+static unsigned int	failures;
+
+static void
+check_uint(const char *ifname, const char *what, unsigned int nl, unsigned int fs)
+{
+	if (nl == fs)
+		return;
+	printf("%s: %s mismatch: netlink %u, sysfs %u\n", ifname, what, nl, fs);
+	failures++;
+}
+
+static void
+check_double(const char *ifname, const char *what, double nl, double fs)
+{
+	if (nl == fs)
+		return;
+	printf("%s: %s mismatch: netlink %.2f, sysfs %.2f\n", ifname, what, nl, fs);
+	failures++;
+}
+
+static void
+check_string(const char *ifname, const char *what, const char *nl, const char *fs)
+{
+	if (ni_string_eq(nl, fs))
+		return;
+	printf("%s: %s mismatch: netlink %s, sysfs %s\n", ifname, what, nl, fs);
+	failures++;
+}
+
+static void
+check_port(const ni_bridge_port_t *nl)
+{
+	ni_bridge_port_t *fs;
+
+	fs = ni_bridge_port_new(NULL, nl->ifname, nl->ifindex);
+	ni_sysfs_bridge_port_get_config(fs->ifname, fs);
+	ni_sysfs_bridge_port_get_status(fs->ifname, &fs->status);
+
+	check_uint(nl->ifname, "port priority", nl->priority, fs->priority);
+	check_uint(nl->ifname, "port path-cost", nl->path_cost, fs->path_cost);
+	check_uint(nl->ifname, "port state", nl->status.state, fs->status.state);
+	check_uint(nl->ifname, "port no", nl->status.port_no, fs->status.port_no);
+	check_uint(nl->ifname, "port id", nl->status.port_id, fs->status.port_id);
+	check_string(nl->ifname, "designated root", nl->status.designated_root,
+			fs->status.designated_root);
+	check_string(nl->ifname, "designated bridge", nl->status.designated_bridge,
+			fs->status.designated_bridge);
+	check_uint(nl->ifname, "designated port", nl->status.designated_port,
+			fs->status.designated_port);
+	check_uint(nl->ifname, "designated cost", nl->status.designated_cost,
+			fs->status.designated_cost);
+	check_uint(nl->ifname, "hairpin mode", nl->status.hairpin_mode,
+			fs->status.hairpin_mode);
+
+	ni_bridge_port_free(fs);
+}
+
+int main(int argc, char **argv)
+{
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	ni_bridge_t *nl, *fs;
+	unsigned int i;
+
+	if (argc != 2) {
+		printf("Usage: bridge-test bridge-ifname\n");
+		return -2;
+	}
+
+	if (ni_init("bridge-test") < 0)
+		return -1;
+
+	if (!(nc = ni_global_state_handle(1)))
+		ni_fatal("cannot refresh global state!");
+
+	if (!(dev = ni_netdev_by_name(nc, argv[1])) || !(nl = dev->bridge)) {
+		printf("%s: not a bridge\n", argv[1]);
+		return 1;
+	}
+
+	fs = ni_bridge_new();
+	ni_sysfs_bridge_get_config(dev->name, fs);
+	ni_sysfs_bridge_get_status(dev->name, &fs->status);
+	ni_sysfs_bridge_get_port_names(dev->name, &names);
+
+	check_uint(dev->name, "stp", nl->stp, fs->stp);
+	check_uint(dev->name, "priority", nl->priority, fs->priority);
+	check_double(dev->name, "forward-delay", nl->forward_delay, fs->forward_delay);
+	check_double(dev->name, "ageing-time", nl->ageing_time, fs->ageing_time);
+	check_double(dev->name, "hello-time", nl->hello_time, fs->hello_time);
+	check_double(dev->name, "max-age", nl->max_age, fs->max_age);
+	check_string(dev->name, "root id", nl->status.root_id, fs->status.root_id);
+	check_string(dev->name, "bridge id", nl->status.bridge_id, fs->status.bridge_id);
+	check_string(dev->name, "group address", nl->status.group_addr, fs->status.group_addr);
+	check_uint(dev->name, "root port", nl->status.root_port, fs->status.root_port);
+	check_uint(dev->name, "root path cost", nl->status.root_path_cost,
+			fs->status.root_path_cost);
+	check_uint(dev->name, "port count", nl->ports.count, names.count);
+
+	for (i = 0; i < names.count; ++i) {
+		const ni_bridge_port_t *port;
+
+		if (!(port = ni_bridge_port_by_name(nl, names.data[i]))) {
+			printf("%s: port %s not discovered via netlink\n",
+					dev->name, names.data[i]);
+			failures++;
+			continue;
+		}
+		check_port(port);
+	}
+
+	printf("%s: %u ports, %u mismatches\n", dev->name, names.count, failures);
+
+	ni_string_array_destroy(&names);
+	ni_bridge_free(fs);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,1220 @@
+/*
+ * Core library microbenchmarks.
+ *
+ * Runs each benchmark on a fixed, generated or recorded input, repeats
+ * it a number of times and writes the best and the median time of the
+ * repetitions as JSON, so the results can be compared between releases:
+ *
+ *	xml-parse, xml-print		xml-reader.c and xml-writer.c
+ *	dbus-serialize, dbus-deserialize
+ *					the xml <-> dbus variant mapping
+ *	fsm-schedule			ni_fsm_schedule on a bond/vlan/bridge
+ *					hierarchy with dependencies
+ *	netlink-refresh			__ni_system_refresh_all replaying the
+ *					dump in netlink/veth.hex
+ *	json-parse, json-format		json.c
+ *	json-teamd-parse, json-teamd-lookup
+ *					json.c on the teamd dumps in teamd/
+ *	dhcp4-option-parse		the packets in dhcp4/basic.hex
+ *	arp-verify-process		ARP replies to a verify of 256 addresses
+ *					on a host with 64 devices
+ *
+ *	core-bench [--data-dir DIR] [--output FILE] [--repeat N]
+ *	           [--filter NAME] [--debug FACILITY]
+ *	core-bench --record FILE
+ *
+ * --record writes the netlink dumps of the current network namespace,
+ * in the format read by the netlink-refresh benchmark.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include <wicked/xml.h>
+#include <wicked/dbus.h>
+#include <wicked/fsm.h>
+
+#include "netinfo_priv.h"
+#include "appconfig.h"
+#include "kernel.h"
+#include "xml-schema.h"
+#include "json.h"
+#include "buffer.h"
+#include "dhcp4/dhcp4.h"
+#include "dhcp4/protocol.h"
+#include "test-util.h"
+
+#define BENCH_MAX_DUMPS		16
+
+enum {
+	OPT_DEBUG,
+	OPT_DATA_DIR,
+	OPT_OUTPUT,
+	OPT_REPEAT,
+	OPT_FILTER,
+	OPT_RECORD,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "data-dir",		required_argument,	NULL,	OPT_DATA_DIR },
+	{ "output",		required_argument,	NULL,	OPT_OUTPUT },
+	{ "repeat",		required_argument,	NULL,	OPT_REPEAT },
+	{ "filter",		required_argument,	NULL,	OPT_FILTER },
+	{ "record",		required_argument,	NULL,	OPT_RECORD },
+
+	{ NULL }
+};
+
+typedef struct bench {
+	const char *		name;
+	unsigned int		iterations;
+	int			(*setup)(void);
+	unsigned int		(*run)(unsigned int);
+	void			(*teardown)(void);
+} bench_t;
+
+static const char *		bench_data_dir = ".";
+
+static char *
+bench_data_path(const char *name)
+{
+	static char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", bench_data_dir, name);
+	return path;
+}
+
+/*
+ * xml-parse, xml-print: an interface config of 200 interfaces
+ */
+static char *			bench_xml_string;
+static xml_document_t *		bench_xml_doc;
+
+static int
+bench_xml_setup(void)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	unsigned int n, a;
+
+	ni_stringbuf_printf(&buf, "<interfaces>\n");
+	for (n = 0; n < 200; ++n) {
+		ni_stringbuf_printf(&buf,
+			"  <!-- interface %u -->\n"
+			"  <interface origin=\"compat:suse:/etc/sysconfig/network/ifcfg-eth%u\">\n"
+			"    <name>eth%u</name>\n"
+			"    <control>\n"
+			"      <mode>boot</mode>\n"
+			"      <link-detection><timeout>30</timeout></link-detection>\n"
+			"    </control>\n"
+			"    <link><mtu>1500</mtu></link>\n"
+			"    <ipv4:static>\n", n, n, n);
+		for (a = 0; a < 4; ++a) {
+			ni_stringbuf_printf(&buf,
+				"      <address><local>10.%u.%u.%u/24</local></address>\n",
+				n / 250, n % 250, a + 1);
+		}
+		ni_stringbuf_printf(&buf,
+			"      <route>\n"
+			"        <destination>0.0.0.0/0</destination>\n"
+			"        <nexthop><gateway>10.%u.%u.254</gateway></nexthop>\n"
+			"      </route>\n"
+			"    </ipv4:static>\n"
+			"    <ipv6:static>\n"
+			"      <address><local>fd00:%x::1/64</local></address>\n"
+			"    </ipv6:static>\n"
+			"    <ipv6:dhcp><enabled>true</enabled><mode>auto</mode></ipv6:dhcp>\n"
+			"    <description>&lt;uplink&gt; &amp; friends</description>\n"
+			"  </interface>\n", n / 250, n % 250, n);
+	}
+	ni_stringbuf_printf(&buf, "</interfaces>\n");
+
+	bench_xml_string = buf.string;
+	if (!(bench_xml_doc = xml_document_from_string(bench_xml_string, "bench")))
+		return -1;
+	return 0;
+}
+
+static unsigned int
+bench_xml_parse(unsigned int iterations)
+{
+	xml_document_t *doc;
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!(doc = xml_document_from_string(bench_xml_string, "bench")))
+			failures++;
+		xml_document_free(doc);
+	}
+	return failures;
+}
+
+static unsigned int
+bench_xml_print(unsigned int iterations)
+{
+	unsigned int i, failures = 0;
+	char *string;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!(string = xml_document_sprint(bench_xml_doc)))
+			failures++;
+		free(string);
+	}
+	return failures;
+}
+
+static void
+bench_xml_teardown(void)
+{
+	xml_document_free(bench_xml_doc);
+	bench_xml_doc = NULL;
+	ni_string_free(&bench_xml_string);
+}
+
+/*
+ * dbus-serialize, dbus-deserialize: interface properties with 32
+ * addresses, using the type notations of schema/types.xml
+ */
+static const char *		bench_dbus_schema =
+	"<define name=\"ethernet-address\">\n"
+	"  <array element-type=\"byte\" minlen=\"6\" maxlen=\"6\" notation=\"hwaddr\"/>\n"
+	"</define>\n"
+	"<define name=\"network-address\">\n"
+	"  <array element-type=\"byte\" notation=\"net-address\"/>\n"
+	"</define>\n"
+	"<define name=\"network-address-prefix\">\n"
+	"  <array element-type=\"byte\" notation=\"net-address-prefix\"/>\n"
+	"</define>\n"
+	"<service name=\"bench\" interface=\"bench\">\n"
+	"  <define name=\"address\" class=\"dict\">\n"
+	"    <local type=\"network-address-prefix\"/>\n"
+	"    <peer type=\"network-address\"/>\n"
+	"    <scope type=\"uint32\"/>\n"
+	"    <flags type=\"uint32\"/>\n"
+	"    <label type=\"string\"/>\n"
+	"    <cache-info class=\"dict\">\n"
+	"      <valid-lifetime type=\"uint32\"/>\n"
+	"      <preferred-lifetime type=\"uint32\"/>\n"
+	"    </cache-info>\n"
+	"  </define>\n"
+	"  <define name=\"properties\" class=\"dict\">\n"
+	"    <name type=\"string\"/>\n"
+	"    <index type=\"uint32\"/>\n"
+	"    <mtu type=\"uint32\"/>\n"
+	"    <hwaddr type=\"ethernet-address\"/>\n"
+	"    <addresses class=\"array\" element-type=\"address\"/>\n"
+	"    <search class=\"array\" element-type=\"string\"/>\n"
+	"  </define>\n"
+	"</service>\n";
+
+static ni_xs_scope_t *		bench_dbus_scope;
+static xml_document_t *		bench_dbus_doc;
+static ni_dbus_variant_t	bench_dbus_var = NI_DBUS_VARIANT_INIT;
+
+static int
+bench_dbus_setup(void)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	xml_document_t *schema;
+	unsigned int n;
+	int rv;
+
+	if (!(schema = xml_document_from_string(bench_dbus_schema, "bench-schema")))
+		return -1;
+	bench_dbus_scope = ni_dbus_xml_init();
+	rv = ni_xs_process_schema(schema->root, bench_dbus_scope);
+	xml_document_free(schema);
+	if (rv < 0)
+		return -1;
+
+	ni_stringbuf_printf(&buf,
+		"<bench>\n"
+		"  <name>eth0</name>\n"
+		"  <index>2</index>\n"
+		"  <mtu>1500</mtu>\n"
+		"  <hwaddr>52:54:00:12:34:56</hwaddr>\n"
+		"  <addresses>\n");
+	for (n = 0; n < 32; ++n) {
+		ni_stringbuf_printf(&buf,
+			"    <e>\n"
+			"      <local>%s%u/%u</local>\n"
+			"      <peer>%s%u</peer>\n"
+			"      <scope>0</scope>\n"
+			"      <flags>128</flags>\n"
+			"      <label>eth0:%u</label>\n"
+			"      <cache-info>\n"
+			"        <valid-lifetime>4294967295</valid-lifetime>\n"
+			"        <preferred-lifetime>4294967295</preferred-lifetime>\n"
+			"      </cache-info>\n"
+			"    </e>\n",
+			n % 2 ? "fd00::" : "10.0.0.", n + 1, n % 2 ? 64 : 24,
+			n % 2 ? "fd00::ff" : "10.0.1.", n + 1, n);
+	}
+	ni_stringbuf_printf(&buf,
+		"  </addresses>\n"
+		"  <search>\n"
+		"    <e>example.com</e>\n"
+		"    <e>example.net</e>\n"
+		"  </search>\n"
+		"</bench>\n");
+
+	bench_dbus_doc = xml_document_from_string(buf.string, "bench");
+	ni_stringbuf_destroy(&buf);
+	if (!bench_dbus_doc || !bench_dbus_doc->root->children)
+		return -1;
+
+	return ni_dbus_xml_serialize_properties(bench_dbus_scope, &bench_dbus_var,
+			bench_dbus_doc->root->children);
+}
+
+static unsigned int
+bench_dbus_serialize(unsigned int iterations)
+{
+	ni_dbus_variant_t var = NI_DBUS_VARIANT_INIT;
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < iterations; ++i) {
+		if (ni_dbus_xml_serialize_properties(bench_dbus_scope, &var,
+					bench_dbus_doc->root->children) < 0)
+			failures++;
+		ni_dbus_variant_destroy(&var);
+	}
+	return failures;
+}
+
+static unsigned int
+bench_dbus_deserialize(unsigned int iterations)
+{
+	unsigned int i, failures = 0;
+	xml_node_t *node;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!(node = ni_dbus_xml_deserialize_properties(bench_dbus_scope,
+					"bench", &bench_dbus_var, NULL)))
+			failures++;
+		xml_node_free(node);
+	}
+	return failures;
+}
+
+static void
+bench_dbus_teardown(void)
+{
+	ni_dbus_variant_destroy(&bench_dbus_var);
+	xml_document_free(bench_dbus_doc);
+	bench_dbus_doc = NULL;
+	ni_xs_scope_free(bench_dbus_scope);
+	bench_dbus_scope = NULL;
+}
+
+/*
+ * fsm-schedule: 32 bonds of 4 ports, each with 4 vlans bridged into
+ * a bridge of its own. Every transition of a master waits for all of
+ * its subordinates to reach the target state of the transition, and
+ * the workers are listed top-down, so the scheduler needs a pass per
+ * hierarchy level and state.
+ */
+#define BENCH_FSM_BONDS		32
+#define BENCH_FSM_PORTS		4
+#define BENCH_FSM_VLANS		4
+#define BENCH_FSM_TARGET	NI_FSM_STATE_ADDRCONF_UP
+
+static ni_fsm_t *		bench_fsm;
+
+static int
+bench_fsm_call(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_transition_t *action)
+{
+	w->fsm.state = action->next_state;
+	return 0;
+}
+
+static ni_bool_t
+bench_fsm_require_children(ni_fsm_t *fsm, ni_ifworker_t *w, ni_fsm_require_t *req)
+{
+	unsigned int i, min_state = (unsigned long)req->user_data;
+
+	for (i = 0; i < w->children.count; ++i) {
+		if (w->children.data[i]->fsm.state < min_state)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static ni_ifworker_t *
+bench_fsm_worker(const char *fmt, ...)
+{
+	ni_ifworker_t *w;
+	xml_node_t *config;
+	char name[IFNAMSIZ];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(name, sizeof(name), fmt, ap);
+	va_end(ap);
+
+	config = xml_node_new("interface", NULL);
+	xml_node_new_element("name", config, name);
+	ni_fsm_workers_from_xml(bench_fsm, config, "bench");
+	xml_node_free(config);
+
+	if (!(w = ni_fsm_ifworker_by_name(bench_fsm, NI_IFWORKER_TYPE_NETDEV, name)))
+		ni_fatal("unable to create worker %s", name);
+	return w;
+}
+
+static void
+bench_fsm_add_child(ni_ifworker_t *parent, ni_ifworker_t *child)
+{
+	ni_ifworker_array_append(&parent->children, child);
+	if (!child->masterdev)
+		child->masterdev = parent;
+}
+
+static void
+bench_fsm_bind(ni_ifworker_t *w)
+{
+	ni_fsm_transition_t *action;
+	ni_fsm_require_t *req;
+	unsigned int state;
+
+	w->fsm.action_table = xcalloc(BENCH_FSM_TARGET + 1, sizeof(*action));
+	for (state = NI_FSM_STATE_NONE; state < BENCH_FSM_TARGET; ++state) {
+		action = &w->fsm.action_table[state];
+		action->from_state = state;
+		action->next_state = state + 1;
+		action->call_func = bench_fsm_call;
+		action->common.method_name = ni_ifworker_state_name(state + 1);
+		action->bound = TRUE;
+
+		if (w->children.count && state >= NI_FSM_STATE_DEVICE_EXISTS) {
+			req = ni_fsm_require_new(bench_fsm_require_children, NULL);
+			req->user_data = (void *)(unsigned long)(state + 1);
+			action->require.list = req;
+		}
+	}
+}
+
+static int
+bench_fsm_setup(void)
+{
+	ni_ifworker_t *bridge, *vlans[BENCH_FSM_VLANS], *bond, *port;
+	unsigned int b, v, p, i;
+
+	bench_fsm = ni_fsm_new();
+	for (b = 0; b < BENCH_FSM_BONDS; ++b) {
+		for (v = 0; v < BENCH_FSM_VLANS; ++v) {
+			bridge = bench_fsm_worker("br%u", b * BENCH_FSM_VLANS + v);
+			vlans[v] = bench_fsm_worker("bond%u.%u", b, v + 1);
+			bench_fsm_add_child(bridge, vlans[v]);
+		}
+		bond = bench_fsm_worker("bond%u", b);
+		for (v = 0; v < BENCH_FSM_VLANS; ++v)
+			bench_fsm_add_child(vlans[v], bond);
+		for (p = 0; p < BENCH_FSM_PORTS; ++p) {
+			port = bench_fsm_worker("eth%u", b * BENCH_FSM_PORTS + p);
+			bench_fsm_add_child(bond, port);
+		}
+	}
+
+	for (i = 0; i < bench_fsm->workers.count; ++i)
+		bench_fsm_bind(bench_fsm->workers.data[i]);
+	return 0;
+}
+
+static unsigned int
+bench_fsm_schedule(unsigned int iterations)
+{
+	unsigned int i, n, failures = 0;
+	ni_ifworker_t *w;
+
+	for (i = 0; i < iterations; ++i) {
+		for (n = 0; n < bench_fsm->workers.count; ++n) {
+			w = bench_fsm->workers.data[n];
+			w->done = FALSE;
+			w->kickstarted = FALSE;
+			w->target_state = BENCH_FSM_TARGET;
+			w->fsm.state = NI_FSM_STATE_NONE;
+			w->fsm.next_action = w->fsm.action_table;
+		}
+
+		if (ni_fsm_schedule(bench_fsm) != 0)
+			failures++;
+
+		for (n = 0; n < bench_fsm->workers.count; ++n) {
+			w = bench_fsm->workers.data[n];
+			if (w->failed || w->fsm.state != BENCH_FSM_TARGET)
+				failures++;
+		}
+	}
+	return failures;
+}
+
+static void
+bench_fsm_teardown(void)
+{
+	ni_fsm_free(bench_fsm);
+	bench_fsm = NULL;
+}
+
+/*
+ * netlink-refresh: the recorded link, address, route and rule dumps
+ * replayed instead of the kernel ones. Only the netlink data is used,
+ * the devices don't need to exist.
+ */
+typedef struct bench_dump {
+	int			type;
+	int			af;
+	struct ni_nlmsg_list	list;
+} bench_dump_t;
+
+static bench_dump_t		bench_dumps[BENCH_MAX_DUMPS];
+static unsigned int		bench_num_dumps;
+static ni_netconfig_t *		bench_nc;
+
+static int
+bench_netlink_replay(int af, int type, struct ni_nlmsg_list *list, void *user_data)
+{
+	struct ni_nlmsg *entry;
+	unsigned int i;
+
+	for (i = 0; i < bench_num_dumps; ++i) {
+		if (bench_dumps[i].type != type || bench_dumps[i].af != af)
+			continue;
+
+		for (entry = bench_dumps[i].list.head; entry; entry = entry->next) {
+			if (!ni_nlmsg_list_append(list, &entry->h))
+				return -NLE_NOMEM;
+		}
+		break;
+	}
+	return NLE_SUCCESS;
+}
+
+static int
+bench_netlink_record(int af, int type, struct ni_nlmsg_list *list, void *user_data)
+{
+	FILE *fp = user_data;
+	struct ni_nlmsg *entry;
+	char *hex;
+	int rv;
+
+	ni_nl_dump_set_replay(NULL, NULL);
+	rv = ni_nl_dump_store(af, type, list);
+	ni_nl_dump_set_replay(bench_netlink_record, fp);
+	if (rv != NLE_SUCCESS)
+		return rv;
+
+	fprintf(fp, "# %s\ndump %d %d\n", ni_rtnl_msg_type_to_name(type, "unknown"), type, af);
+	for (entry = list->head; entry; entry = entry->next) {
+		if ((hex = ni_sprint_hex((unsigned char *)&entry->h, entry->h.nlmsg_len))) {
+			fprintf(fp, "%s\n", hex);
+			free(hex);
+		}
+	}
+	return rv;
+}
+
+static int
+bench_netlink_load(const char *filename)
+{
+	static unsigned char data[65536];
+	bench_dump_t *dump = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	unsigned int num = 0;
+	ssize_t len;
+	FILE *fp;
+	int type, af;
+
+	if (!(fp = fopen(filename, "r"))) {
+		ni_error("%s: unable to open: %m", filename);
+		return -1;
+	}
+
+	while (getline(&line, &size, fp) > 0) {
+		num++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		if (sscanf(line, "dump %d %d", &type, &af) == 2) {
+			if (bench_num_dumps >= BENCH_MAX_DUMPS) {
+				ni_error("%s:%u: too many dumps", filename, num);
+				break;
+			}
+			dump = &bench_dumps[bench_num_dumps++];
+			dump->type = type;
+			dump->af = af;
+			ni_nlmsg_list_init(&dump->list);
+			continue;
+		}
+
+		len = ni_parse_hex_data(line, data, sizeof(data), ":");
+		if (!dump || len < (ssize_t)sizeof(struct nlmsghdr) ||
+		    ((struct nlmsghdr *)data)->nlmsg_len != (size_t)len) {
+			ni_error("%s:%u: invalid netlink message", filename, num);
+			continue;
+		}
+		ni_nlmsg_list_append(&dump->list, (struct nlmsghdr *)data);
+	}
+
+	free(line);
+	fclose(fp);
+	return bench_num_dumps ? 0 : -1;
+}
+
+static int
+bench_netlink_setup(void)
+{
+	if (bench_netlink_load(bench_data_path("netlink/veth.hex")) < 0)
+		return -1;
+
+	bench_nc = ni_netconfig_new();
+	ni_netconfig_set_discover_filter(bench_nc, NI_NETCONFIG_DISCOVER_LINK_EXTERN);
+	ni_nl_dump_set_replay(bench_netlink_replay, NULL);
+	return 0;
+}
+
+static unsigned int
+bench_netlink_refresh(unsigned int iterations)
+{
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < iterations; ++i) {
+		if (__ni_system_refresh_all(bench_nc, NULL) < 0)
+			failures++;
+	}
+	if (!ni_netconfig_devlist(bench_nc))
+		failures++;
+	return failures;
+}
+
+static void
+bench_netlink_teardown(void)
+{
+	unsigned int i;
+
+	ni_nl_dump_set_replay(NULL, NULL);
+	ni_netconfig_free(bench_nc);
+	bench_nc = NULL;
+
+	for (i = 0; i < bench_num_dumps; ++i)
+		ni_nlmsg_list_destroy(&bench_dumps[i].list);
+	bench_num_dumps = 0;
+}
+
+/*
+ * json-parse, json-format: an array of 200 interface objects
+ */
+static ni_json_t *		bench_json;
+static char *			bench_json_string;
+
+static int
+bench_json_setup(void)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	ni_json_t *iface, *addrs, *opts;
+	char addr[64];
+	unsigned int n, a;
+
+	bench_json = ni_json_new_array();
+	for (n = 0; n < 200; ++n) {
+		iface = ni_json_new_object();
+		snprintf(addr, sizeof(addr), "eth%u", n);
+		ni_json_object_set(iface, "name", ni_json_new_string(addr));
+		ni_json_object_set(iface, "index", ni_json_new_int64(n + 2));
+		ni_json_object_set(iface, "mtu", ni_json_new_int64(1500));
+		ni_json_object_set(iface, "up", ni_json_new_bool(n % 3 != 0));
+		ni_json_object_set(iface, "load", ni_json_new_double(n / 7.0));
+
+		addrs = ni_json_new_array();
+		for (a = 0; a < 4; ++a) {
+			snprintf(addr, sizeof(addr), "10.%u.%u.%u/24", n / 250, n % 250, a + 1);
+			ni_json_array_append(addrs, ni_json_new_string(addr));
+		}
+		ni_json_object_set(iface, "addresses", addrs);
+
+		opts = ni_json_new_object();
+		ni_json_object_set(opts, "bridge", ni_json_new_null());
+		ni_json_object_set(opts, "description",
+				ni_json_new_string("\"uplink\"\tport \\ caf\xc3\xa9"));
+		ni_json_object_set(iface, "options", opts);
+
+		ni_json_array_append(bench_json, iface);
+	}
+
+	ni_json_format_string(&buf, bench_json, NULL);
+	bench_json_string = buf.string;
+	return bench_json_string ? 0 : -1;
+}
+
+static unsigned int
+bench_json_parse(unsigned int iterations)
+{
+	unsigned int i, failures = 0;
+	ni_json_t *json;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!(json = ni_json_parse_string(bench_json_string)))
+			failures++;
+		ni_json_free(json);
+	}
+	return failures;
+}
+
+static unsigned int
+bench_json_format(unsigned int iterations)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < iterations; ++i) {
+		if (!ni_json_format_string(&buf, bench_json, NULL))
+			failures++;
+		ni_stringbuf_destroy(&buf);
+	}
+	return failures;
+}
+
+static void
+bench_json_teardown(void)
+{
+	ni_json_free(bench_json);
+	bench_json = NULL;
+	ni_string_free(&bench_json_string);
+}
+
+/*
+ * json-teamd-parse, json-teamd-lookup: the config and state dumps of
+ * a lacp team of 32 ports in teamd/, walked per port as teamd.c does
+ */
+static char *			bench_teamd_config_string;
+static char *			bench_teamd_state_string;
+static ni_json_t *		bench_teamd_config;
+static ni_json_t *		bench_teamd_state;
+
+static char *
+bench_teamd_load(const char *name)
+{
+	const char *filename = bench_data_path(name);
+	char *data;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		ni_error("%s: unable to open: %m", filename);
+		return NULL;
+	}
+	data = ni_file_read(fp, NULL, 0);
+	fclose(fp);
+	return data;
+}
+
+static int
+bench_teamd_setup(void)
+{
+	if (!(bench_teamd_config_string = bench_teamd_load("teamd/lacp-32-config.json")))
+		return -1;
+	if (!(bench_teamd_state_string = bench_teamd_load("teamd/lacp-32-state.json")))
+		return -1;
+
+	bench_teamd_config = ni_json_parse_string(bench_teamd_config_string);
+	bench_teamd_state = ni_json_parse_string(bench_teamd_state_string);
+	return bench_teamd_config && bench_teamd_state ? 0 : -1;
+}
+
+static unsigned int
+bench_teamd_parse(unsigned int iterations)
+{
+	unsigned int i, failures = 0;
+	ni_json_t *config, *state;
+
+	for (i = 0; i < iterations; ++i) {
+		config = ni_json_parse_string(bench_teamd_config_string);
+		state = ni_json_parse_string(bench_teamd_state_string);
+		if (!config || !state)
+			failures++;
+		ni_json_free(config);
+		ni_json_free(state);
+	}
+	return failures;
+}
+
+static int
+bench_teamd_lookup_port(const char *name)
+{
+	ni_json_t *cport, *sport, *runner, *aggr;
+	ni_bool_t up = FALSE, selected = FALSE;
+	int64_t prio = 0, key = 0, id = 0;
+
+	cport = ni_json_object_get_value(ni_json_object_get_value(bench_teamd_config, "ports"), name);
+	sport = ni_json_object_get_value(ni_json_object_get_value(bench_teamd_state, "ports"), name);
+	if (!cport || !sport)
+		return -1;
+
+	if (!ni_json_int64_get(ni_json_object_get_value(cport, "lacp_prio"), &prio) ||
+	    !ni_json_int64_get(ni_json_object_get_value(cport, "lacp_key"), &key))
+		return -1;
+
+	if (!ni_json_bool_get(ni_json_object_get_value(
+			ni_json_object_get_value(sport, "link"), "up"), &up) ||
+	    !ni_json_bool_get(ni_json_object_get_value(
+			ni_json_object_get_value(sport, "link_watches"), "up"), &up))
+		return -1;
+
+	runner = ni_json_object_get_value(sport, "runner");
+	aggr = ni_json_object_get_value(runner, "aggregator");
+	if (!ni_json_bool_get(ni_json_object_get_value(runner, "selected"), &selected) ||
+	    !ni_json_int64_get(ni_json_object_get_value(aggr, "id"), &id))
+		return -1;
+	return 0;
+}
+
+static unsigned int
+bench_teamd_lookup(unsigned int iterations)
+{
+	unsigned int i, n, count, failures = 0;
+	ni_json_t *ports, *runner;
+	ni_json_pair_t *pair;
+
+	for (i = 0; i < iterations; ++i) {
+		runner = ni_json_object_get_value(bench_teamd_config, "runner");
+		if (!ni_json_object_get_value(runner, "name") ||
+		    !ni_json_object_get_value(bench_teamd_config, "link_watch"))
+			failures++;
+
+		ports = ni_json_object_get_value(bench_teamd_state, "ports");
+		count = ni_json_object_entries(ports);
+		for (n = 0; n < count; ++n) {
+			pair = ni_json_object_get_pair_at(ports, n);
+			if (bench_teamd_lookup_port(ni_json_pair_get_name(pair)) < 0)
+				failures++;
+		}
+	}
+	return failures;
+}
+
+static void
+bench_teamd_teardown(void)
+{
+	ni_json_free(bench_teamd_config);
+	ni_json_free(bench_teamd_state);
+	bench_teamd_config = bench_teamd_state = NULL;
+	ni_string_free(&bench_teamd_config_string);
+	ni_string_free(&bench_teamd_state_string);
+}
+
+/*
+ * arp-verify-process: replies about each verified address from the
+ * hwaddr of another local device (the false alarm check) and replies
+ * about unrelated addresses
+ */
+#define BENCH_ARP_DEVICES	64
+#define BENCH_ARP_ADDRESSES	256
+
+static ni_netconfig_t *		bench_arp_nc;
+static ni_netconfig_t *		bench_arp_saved_nc;
+static ni_address_t *		bench_arp_addrs;
+static ni_arp_verify_t		bench_arp_verify;
+static ni_arp_socket_t		bench_arp_sock;
+
+static void
+bench_arp_hwaddr(ni_hwaddr_t *hwaddr, unsigned int n)
+{
+	memset(hwaddr, 0, sizeof(*hwaddr));
+	hwaddr->type = ARPHRD_ETHER;
+	hwaddr->len = ni_link_address_length(ARPHRD_ETHER);
+	hwaddr->data[0] = 0x02;
+	hwaddr->data[4] = n >> 8;
+	hwaddr->data[5] = n & 0xff;
+}
+
+static struct in_addr
+bench_arp_ipaddr(unsigned int n)
+{
+	struct in_addr ip;
+
+	ip.s_addr = htonl(0x0a000000 + n);
+	return ip;
+}
+
+static int
+bench_arp_setup(void)
+{
+	ni_sockaddr_t addr;
+	ni_address_t *ap;
+	ni_netdev_t *dev;
+	unsigned int i;
+	char name[IFNAMSIZ];
+
+	bench_arp_nc = ni_netconfig_new();
+	for (i = 0; i < BENCH_ARP_DEVICES; ++i) {
+		snprintf(name, sizeof(name), "eth%u", i);
+		dev = ni_netdev_new(name, i + 1);
+		dev->link.type = NI_IFTYPE_ETHERNET;
+		dev->link.ifflags = NI_IFF_DEVICE_UP | NI_IFF_LINK_UP;
+		bench_arp_hwaddr(&dev->link.hwaddr, i + 1);
+
+		ni_sockaddr_set_ipv4(&addr, bench_arp_ipaddr(0x10000 + i), 0);
+		ni_address_new(AF_INET, 16, &addr, &dev->addrs);
+		ni_netconfig_device_append(bench_arp_nc, dev);
+	}
+
+	bench_arp_saved_nc = ni_global.state;
+	ni_global.state = bench_arp_nc;
+
+	ni_string_dup(&bench_arp_sock.dev_info.ifname, "eth0");
+	bench_arp_sock.dev_info.ifindex = 1;
+	bench_arp_hwaddr(&bench_arp_sock.dev_info.hwaddr, 1);
+
+	ni_arp_verify_init(&bench_arp_verify, 3, 300);
+	for (i = 0; i < BENCH_ARP_ADDRESSES; ++i) {
+		ni_sockaddr_set_ipv4(&addr, bench_arp_ipaddr(i + 1), 0);
+		ap = ni_address_new(AF_INET, 16, &addr, &bench_arp_addrs);
+		ni_address_set_tentative(ap, TRUE);
+		if (!ni_arp_verify_add_address(&bench_arp_verify, ap))
+			return -1;
+	}
+	return 0;
+}
+
+static unsigned int
+bench_arp_verify_process(unsigned int iterations)
+{
+	unsigned int i, n, failures = 0;
+	ni_arp_packet_t pkt;
+
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.op = ARPOP_REPLY;
+	for (i = 0; i < iterations; ++i) {
+		for (n = 0; n < BENCH_ARP_ADDRESSES; ++n) {
+			bench_arp_hwaddr(&pkt.sha, 2 + n % (BENCH_ARP_DEVICES - 1));
+			pkt.sip = bench_arp_ipaddr(n + 1);
+			ni_arp_verify_process(&bench_arp_sock, &pkt, &bench_arp_verify);
+
+			pkt.sip = bench_arp_ipaddr(0x20000 + n);
+			ni_arp_verify_process(&bench_arp_sock, &pkt, &bench_arp_verify);
+		}
+	}
+
+	/* the replies from our own devices are no duplicates */
+	for (n = 0; n < bench_arp_verify.ipaddrs.count; ++n) {
+		if (ni_address_is_duplicate(bench_arp_verify.ipaddrs.data[n]))
+			failures++;
+	}
+	return failures;
+}
+
+static void
+bench_arp_teardown(void)
+{
+	ni_arp_verify_destroy(&bench_arp_verify);
+	ni_address_list_destroy(&bench_arp_addrs);
+	ni_string_free(&bench_arp_sock.dev_info.ifname);
+
+	ni_global.state = bench_arp_saved_nc;
+	ni_netconfig_free(bench_arp_nc);
+	bench_arp_nc = NULL;
+}
+
+/*
+ * dhcp4-option-parse: option index and lease of each valid packet
+ */
+#define BENCH_DHCP4_MAX		16
+
+static struct {
+	unsigned char *		data;
+	size_t			len;
+} bench_dhcp4_packets[BENCH_DHCP4_MAX];
+static unsigned int		bench_dhcp4_count;
+static ni_dhcp4_config_t	bench_dhcp4_config;
+
+static int
+bench_dhcp4_parse(unsigned char *data, size_t len)
+{
+	ni_addrconf_lease_t *lease = NULL;
+	ni_dhcp4_option_index_t index;
+	ni_dhcp4_message_t *message;
+	ni_buffer_t buf;
+	int rv;
+
+	ni_buffer_init_reader(&buf, data, len);
+	if (!(message = ni_buffer_pull_head(&buf, sizeof(*message))))
+		return -1;
+	if (ni_dhcp4_option_index_build(&index, message, &buf) < 0)
+		return -1;
+
+	rv = ni_dhcp4_parse_lease(&bench_dhcp4_config, &index, &lease);
+	if (lease)
+		ni_addrconf_lease_free(lease);
+	else
+		rv = -1;
+	return rv;
+}
+
+static int
+bench_dhcp4_setup(void)
+{
+	static unsigned char packet[65536];
+	const char *filename = bench_data_path("dhcp4/basic.hex");
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		ni_error("%s: unable to open: %m", filename);
+		return -1;
+	}
+
+	while (getline(&line, &size, fp) > 0 && bench_dhcp4_count < BENCH_DHCP4_MAX) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		len = ni_parse_hex_data(line, packet, sizeof(packet), ":");
+		if (len <= 0 || bench_dhcp4_parse(packet, len) < 0)
+			continue;
+
+		bench_dhcp4_packets[bench_dhcp4_count].data = xcalloc(1, len);
+		memcpy(bench_dhcp4_packets[bench_dhcp4_count].data, packet, len);
+		bench_dhcp4_packets[bench_dhcp4_count].len = len;
+		bench_dhcp4_count++;
+	}
+
+	free(line);
+	fclose(fp);
+	return bench_dhcp4_count ? 0 : -1;
+}
+
+static unsigned int
+bench_dhcp4_option_parse(unsigned int iterations)
+{
+	unsigned int i, n, failures = 0;
+
+	for (i = 0; i < iterations; ++i) {
+		n = i % bench_dhcp4_count;
+		if (bench_dhcp4_parse(bench_dhcp4_packets[n].data,
+					bench_dhcp4_packets[n].len) < 0)
+			failures++;
+	}
+	return failures;
+}
+
+static void
+bench_dhcp4_teardown(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < bench_dhcp4_count; ++n)
+		free(bench_dhcp4_packets[n].data);
+	bench_dhcp4_count = 0;
+}
+
+static const bench_t		benchmarks[] = {
+	{ "xml-parse",		100,	bench_xml_setup,	bench_xml_parse,	bench_xml_teardown },
+	{ "xml-print",		500,	bench_xml_setup,	bench_xml_print,	bench_xml_teardown },
+	{ "dbus-serialize",	10000,	bench_dbus_setup,	bench_dbus_serialize,	bench_dbus_teardown },
+	{ "dbus-deserialize",	10000,	bench_dbus_setup,	bench_dbus_deserialize,	bench_dbus_teardown },
+	{ "fsm-schedule",	1000,	bench_fsm_setup,	bench_fsm_schedule,	bench_fsm_teardown },
+	{ "netlink-refresh",	10000,	bench_netlink_setup,	bench_netlink_refresh,	bench_netlink_teardown },
+	{ "json-parse",		200,	bench_json_setup,	bench_json_parse,	bench_json_teardown },
+	{ "json-format",	1000,	bench_json_setup,	bench_json_format,	bench_json_teardown },
+	{ "json-teamd-parse",	200,	bench_teamd_setup,	bench_teamd_parse,	bench_teamd_teardown },
+	{ "json-teamd-lookup",	20000,	bench_teamd_setup,	bench_teamd_lookup,	bench_teamd_teardown },
+	{ "dhcp4-option-parse",	200000,	bench_dhcp4_setup,	bench_dhcp4_option_parse, bench_dhcp4_teardown },
+	{ "arp-verify-process",	1000,	bench_arp_setup,	bench_arp_verify_process, bench_arp_teardown },
+
+	{ NULL }
+};
+
+static int
+bench_cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Runs a warm-up round and the given number of timed repetitions,
+ * reporting the best and the median of them.
+ */
+static ni_json_t *
+bench_run(const bench_t *bench, unsigned int repeat, unsigned int *failed)
+{
+	unsigned int r, failures;
+	double *times, start, best, median;
+	ni_json_t *result;
+
+	if (bench->setup() < 0) {
+		ni_error("%s: setup failed", bench->name);
+		bench->teardown();
+		return NULL;
+	}
+
+	times = xcalloc(repeat, sizeof(*times));
+	failures = bench->run(bench->iterations);
+	for (r = 0; r < repeat; ++r) {
+		start = bench_now();
+		failures += bench->run(bench->iterations);
+		times[r] = bench_now() - start;
+	}
+	bench->teardown();
+
+	qsort(times, repeat, sizeof(*times), bench_cmp_double);
+	best = times[0];
+	median = times[repeat / 2];
+	free(times);
+
+	fprintf(stderr, "%-20s %8u in %8.4fs: %12.0f/sec%s\n", bench->name,
+			bench->iterations, best,
+			best > 0 ? bench->iterations / best : 0.0,
+			failures ? " FAILED" : "");
+
+	result = ni_json_new_object();
+	ni_json_object_set(result, "name", ni_json_new_string(bench->name));
+	ni_json_object_set(result, "iterations", ni_json_new_int64(bench->iterations));
+	ni_json_object_set(result, "repeat", ni_json_new_int64(repeat));
+	/* integers, json.c formats doubles with 2 significant digits */
+	ni_json_object_set(result, "best_ns", ni_json_new_int64(best * 1e9));
+	ni_json_object_set(result, "median_ns", ni_json_new_int64(median * 1e9));
+	ni_json_object_set(result, "ns_per_op", ni_json_new_int64(best * 1e9 / bench->iterations));
+	ni_json_object_set(result, "ops_per_sec", ni_json_new_int64(best > 0 ?
+				bench->iterations / best : 0));
+	ni_json_object_set(result, "failures", ni_json_new_int64(failures));
+	*failed += failures;
+	return result;
+}
+
+static int
+bench_record(const char *filename)
+{
+	ni_netconfig_t *nc;
+	FILE *fp;
+	int rv;
+
+	if (!(fp = fopen(filename, "w"))) {
+		ni_error("%s: unable to create: %m", filename);
+		return 1;
+	}
+
+	/* opens the netlink socket */
+	if (!ni_global_state_handle(0)) {
+		fclose(fp);
+		return 1;
+	}
+
+	fprintf(fp, "# netlink dumps recorded by core-bench --record\n");
+	nc = ni_netconfig_new();
+	ni_netconfig_set_discover_filter(nc, NI_NETCONFIG_DISCOVER_LINK_EXTERN);
+	ni_nl_dump_set_replay(bench_netlink_record, fp);
+	rv = __ni_system_refresh_all(nc, NULL);
+	ni_nl_dump_set_replay(NULL, NULL);
+	ni_netconfig_free(nc);
+
+	if (fclose(fp) < 0 || rv < 0) {
+		ni_error("%s: unable to record the netlink dumps", filename);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	const char *output = NULL, *filter = NULL;
+	ni_json_t *results, *list, *result;
+	unsigned int repeat = 5, failures = 0;
+	const bench_t *bench;
+	FILE *fp = stdout;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./core-bench [--data-dir DIR] [--output FILE] [--repeat N]\n"
+				"             [--filter NAME] [--debug FACILITY]\n"
+				"./core-bench --record FILE\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_DATA_DIR:
+			bench_data_dir = optarg;
+			break;
+
+		case OPT_OUTPUT:
+			output = optarg;
+			break;
+
+		case OPT_REPEAT:
+			if (ni_parse_uint(optarg, &repeat, 10) < 0 || !repeat)
+				goto usage;
+			break;
+
+		case OPT_FILTER:
+			filter = optarg;
+			break;
+
+		case OPT_RECORD:
+			if (ni_init("core-bench") < 0)
+				return 1;
+			return bench_record(optarg);
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("core-bench") < 0)
+		return 1;
+
+	list = ni_json_new_array();
+	for (bench = benchmarks; bench->name; ++bench) {
+		if (filter && !strstr(bench->name, filter))
+			continue;
+
+		if (!(result = bench_run(bench, repeat, &failures))) {
+			failures++;
+			continue;
+		}
+		ni_json_array_append(list, result);
+	}
+
+	results = ni_json_new_object();
+	ni_json_object_set(results, "package", ni_json_new_string(PACKAGE_NAME));
+	ni_json_object_set(results, "version", ni_json_new_string(PACKAGE_VERSION));
+	ni_json_object_set(results, "benchmarks", list);
+
+	if (output && !(fp = fopen(output, "w"))) {
+		ni_error("%s: unable to create: %m", output);
+		return 1;
+	}
+	fprintf(fp, "%s\n", ni_json_format_string(&buf, results, NULL));
+	if (output)
+		fclose(fp);
+
+	ni_stringbuf_destroy(&buf);
+	ni_json_free(results);
+	return failures ? 1 : 0;
+}
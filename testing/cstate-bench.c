@@ -0,0 +1,197 @@
+/*
+ * Client-state store benchmark: state writes/sec of the per-interface
+ * files and the journal backends, plus the migration between them.
+ *
+ *	cstate-bench [--backend files|journal] [--interfaces N] [--rounds N]
+ *	             [--statedir DIR] [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <wicked/fsm.h>
+#include <wicked/util.h>
+#include <wicked/logging.h>
+
+#include "appconfig.h"
+#include "client/client_state.h"
+#include "test-util.h"
+
+extern ni_global_t ni_global;
+
+enum {
+	OPT_DEBUG,
+	OPT_BACKEND,
+	OPT_INTERFACES,
+	OPT_ROUNDS,
+	OPT_STATEDIR,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "backend",		required_argument,	NULL,	OPT_BACKEND },
+	{ "interfaces",		required_argument,	NULL,	OPT_INTERFACES },
+	{ "rounds",		required_argument,	NULL,	OPT_ROUNDS },
+	{ "statedir",		required_argument,	NULL,	OPT_STATEDIR },
+
+	{ NULL }
+};
+
+static void
+cstate_report(const char *backend, const char *what, unsigned int count, double elapsed)
+{
+	printf("%-8s ", backend);
+	bench_report(what, count, elapsed);
+}
+
+static unsigned int
+bench_verify(unsigned int interfaces, const char *origin)
+{
+	ni_client_state_t cs;
+	unsigned int i, failures = 0;
+
+	ni_client_state_init(&cs);
+	for (i = 1; i <= interfaces; ++i) {
+		if (!ni_client_state_load(&cs, i) ||
+		    !ni_string_eq(cs.config.origin, origin)) {
+			printf("state %u: load mismatch: %s != %s\n", i,
+					cs.config.origin, origin);
+			failures++;
+		}
+	}
+	ni_client_state_reset(&cs);
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	ni_config_client_state_backend_t backend = NI_CONFIG_CLIENT_STATE_JOURNAL;
+	unsigned int interfaces = 1000, rounds = 10;
+	unsigned int i, r, failures = 0;
+	char *statedir = NULL, *origin = NULL;
+	char template[] = "/tmp/cstate-bench.XXXXXX";
+	const char *name;
+	ni_client_state_t *cs;
+	double start;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./cstate-bench [--backend files|journal] [--interfaces N]"
+				" [--rounds N] [--statedir DIR] [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_BACKEND:
+			if (ni_string_eq(optarg, "files"))
+				backend = NI_CONFIG_CLIENT_STATE_FILES;
+			else if (ni_string_eq(optarg, "journal"))
+				backend = NI_CONFIG_CLIENT_STATE_JOURNAL;
+			else
+				goto usage;
+			break;
+
+		case OPT_INTERFACES:
+			if (ni_parse_uint(optarg, &interfaces, 10) < 0 || !interfaces)
+				goto usage;
+			break;
+
+		case OPT_ROUNDS:
+			if (ni_parse_uint(optarg, &rounds, 10) < 0 || !rounds)
+				goto usage;
+			break;
+
+		case OPT_STATEDIR:
+			ni_string_dup(&statedir, optarg);
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (!statedir && !ni_string_dup(&statedir, mkdtemp(template)))
+		ni_fatal("Cannot create temporary state directory: %m");
+
+	ni_global.config = ni_config_new();
+	ni_string_dup(&ni_global.config->statedir.path, statedir);
+	ni_global.config->client_state.backend = backend;
+	name = ni_config_client_state_backend_to_name(backend);
+
+	if (!(cs = ni_client_state_new(NI_FSM_STATE_DEVICE_UP)))
+		return 1;
+
+	start = bench_now();
+	for (r = 0; r < rounds; ++r) {
+		ni_string_printf(&cs->config.origin, "cstate-bench:round-%u", r);
+		for (i = 1; i <= interfaces; ++i) {
+			if (!ni_client_state_save(cs, i))
+				failures++;
+		}
+	}
+	cstate_report(name, "writes", interfaces * rounds, bench_now() - start);
+
+	start = bench_now();
+	for (i = 1; i <= interfaces; ++i) {
+		if (!ni_client_state_save(cs, i))
+			failures++;
+	}
+	cstate_report(name, "unchanged", interfaces, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_verify(interfaces, cs->config.origin);
+	cstate_report(name, "loads", interfaces, bench_now() - start);
+
+	/* switch the backend and migrate the states over as wickedd does */
+	ni_string_dup(&origin, cs->config.origin);
+	if (backend == NI_CONFIG_CLIENT_STATE_JOURNAL)
+		backend = NI_CONFIG_CLIENT_STATE_FILES;
+	else
+		backend = NI_CONFIG_CLIENT_STATE_JOURNAL;
+	ni_global.config->client_state.backend = backend;
+	name = ni_config_client_state_backend_to_name(backend);
+
+	start = bench_now();
+	if (!ni_client_state_backend_init())
+		failures++;
+	cstate_report(name, "migrate", interfaces, bench_now() - start);
+
+	failures += bench_verify(interfaces, origin);
+
+	for (i = 1; i <= interfaces; ++i) {
+		if (!ni_client_state_drop(i))
+			failures++;
+	}
+	ni_client_state_journal_close();
+	if (ni_string_eq(statedir, template)) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/client-state.journal", statedir);
+		unlink(path);
+		rmdir(statedir);
+	}
+
+	printf("%u failures\n", failures);
+
+	ni_string_free(&origin);
+	ni_string_free(&statedir);
+	ni_client_state_free(cs);
+	ni_config_free(ni_global.config);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,561 @@
+/*
+ * Peer-to-peer dbus transport test.
+ *
+ * Starts a private dbus-daemon as system bus and a small wicked dbus
+ * server in a child process (this program, re-executed with --server
+ * so it does not share the client's sockets), which owns a name on the
+ * bus and listens on a private peer-to-peer socket as well. The server
+ * implements an Echo method, a method returning the caller's uid and
+ * transport and a method emitting a number of signals.
+ *
+ * Checks that calls and signals work over the peer socket, that the
+ * caller is identified by its credentials, that another user is
+ * refused, and that a client reconnects when the server restarts:
+ * from the main loop, receiving the signals of the restarted server
+ * without any call, as well as on the next call.
+ * Prints the call and signal throughput over the bus and over the
+ * peer socket, and the CPU time the bus daemon spent on each.
+ *
+ *	dbus-peer-test [--count N] [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <dbus/dbus.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/socket.h>
+#include <wicked/dbus.h>
+
+#include "dbus-server.h"
+#include "dbus-connection.h"
+#include "test-util.h"
+
+enum {
+	OPT_COUNT,
+	OPT_DEBUG,
+	OPT_SERVER,
+	OPT_READY_FD,
+};
+
+static struct option	options[] = {
+	{ "count",		required_argument,	NULL,	OPT_COUNT },
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "server",		required_argument,	NULL,	OPT_SERVER },
+	{ "ready-fd",		required_argument,	NULL,	OPT_READY_FD },
+
+	{ NULL }
+};
+
+#define TEST_BUS_NAME		"org.opensuse.Network.PeerTest"
+#define TEST_OBJECT_PATH	"/org/opensuse/Network/PeerTest/Test"
+#define TEST_INTERFACE		"org.opensuse.Network.PeerTest"
+#define TEST_SIGNAL_TIMEOUT	30	/* sec */
+#define TEST_NOTICE_TIME	500	/* msec */
+#define TEST_RECONNECT_TIME	5000	/* msec */
+
+static const char *	test_bus_config =
+	"<!DOCTYPE busconfig PUBLIC \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\"\n"
+	" \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+	"<busconfig>\n"
+	"  <type>system</type>\n"
+	"  <listen>unix:path=%s/bus</listen>\n"
+	"  <auth>EXTERNAL</auth>\n"
+	"  <policy context=\"default\">\n"
+	"    <allow user=\"*\"/>\n"
+	"    <allow own=\"*\"/>\n"
+	"    <allow send_destination=\"*\"/>\n"
+	"    <allow receive_sender=\"*\"/>\n"
+	"  </policy>\n"
+	"</busconfig>\n";
+
+/*
+ * private system bus
+ */
+static pid_t
+test_bus_start(const char *dir)
+{
+	char config[PATH_MAX], address[PATH_MAX + 16], fdarg[32];
+	int pfd[2];
+	ssize_t len;
+	FILE *fp;
+	pid_t pid;
+
+	snprintf(config, sizeof(config), "%s/bus.conf", dir);
+	if (!(fp = fopen(config, "w")))
+		ni_fatal("Cannot create %s: %m", config);
+	fprintf(fp, test_bus_config, dir);
+	fclose(fp);
+
+	if (pipe(pfd) < 0)
+		ni_fatal("Cannot create pipe: %m");
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork dbus-daemon: %m");
+	if (pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		close(pfd[0]);
+		snprintf(fdarg, sizeof(fdarg), "--print-address=%d", pfd[1]);
+		snprintf(address, sizeof(address), "--config-file=%s", config);
+		execlp("dbus-daemon", "dbus-daemon", "--nofork", address, fdarg, NULL);
+		ni_error("Cannot execute dbus-daemon: %m");
+		_exit(127);
+	}
+	close(pfd[1]);
+
+	len = read(pfd[0], address, sizeof(address) - 1);
+	close(pfd[0]);
+	if (len <= 0)
+		ni_fatal("dbus-daemon did not report its address");
+	address[len] = '\0';
+	address[strcspn(address, "\n")] = '\0';
+
+	setenv("DBUS_SYSTEM_BUS_ADDRESS", address, 1);
+	return pid;
+}
+
+/*
+ * CPU time of a process in msec
+ */
+static double
+test_cpu_time(pid_t pid)
+{
+	unsigned long utime = 0, stime = 0;
+	char path[64], buf[1024], *s;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	if (!(fp = fopen(path, "r")))
+		return 0;
+	if (fgets(buf, sizeof(buf), fp) && (s = strrchr(buf, ')')))
+		sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+				&utime, &stime);
+	fclose(fp);
+	return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static double
+test_elapsed(const struct timespec *begin)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - begin->tv_sec) * 1000.0 +
+		(now.tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+/*
+ * wicked dbus server
+ */
+static ni_dbus_class_t	test_class = {
+	.name		= "dbus-peer-test",
+};
+
+static dbus_bool_t
+test_echo(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply, DBusError *error)
+{
+	return ni_dbus_message_serialize_variants(reply, 1, argv, error);
+}
+
+static dbus_bool_t
+test_caller(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		uid_t caller_uid, ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	dbus_bool_t rv;
+
+	ni_dbus_variant_set_uint32(&result, caller_uid);
+	rv = ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+static dbus_bool_t
+test_via_peer(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_variant_t result = NI_DBUS_VARIANT_INIT;
+	dbus_bool_t rv;
+
+	/* without a bus, the call has no sender to reply to */
+	ni_dbus_variant_set_uint32(&result, dbus_message_get_destination(reply) == NULL);
+	rv = ni_dbus_message_serialize_variants(reply, 1, &result, error);
+	ni_dbus_variant_destroy(&result);
+	return rv;
+}
+
+static dbus_bool_t
+test_emit(ni_dbus_object_t *object, const ni_dbus_method_t *method,
+		unsigned int argc, const ni_dbus_variant_t *argv,
+		ni_dbus_message_t *reply, DBusError *error)
+{
+	ni_dbus_server_t *server = ni_dbus_object_get_server(object);
+	ni_dbus_variant_t arg = NI_DBUS_VARIANT_INIT;
+	uint32_t count, i;
+
+	if (!ni_dbus_variant_get_uint32(&argv[0], &count))
+		return FALSE;
+
+	for (i = 0; i < count; ++i) {
+		ni_dbus_variant_set_uint32(&arg, i);
+		ni_dbus_server_send_signal(server, object, TEST_INTERFACE, "Event", 1, &arg);
+	}
+	ni_dbus_variant_destroy(&arg);
+	return TRUE;
+}
+
+static const ni_dbus_method_t	test_methods[] = {
+	{ "Echo",	"s",	.handler = test_echo		},
+	{ "Caller",	"",	.handler_ex = test_caller	},
+	{ "ViaPeer",	"",	.handler = test_via_peer	},
+	{ "Emit",	"u",	.handler = test_emit		},
+	{ NULL }
+};
+
+static const ni_dbus_method_t	test_signals[] = {
+	{ "Event",	"u"	},
+	{ NULL }
+};
+
+static const ni_dbus_service_t	test_service = {
+	.name		= TEST_INTERFACE,
+	.compatible	= &test_class,
+	.methods	= test_methods,
+	.signals	= test_signals,
+};
+
+static int
+test_server(const char *address, int ready)
+{
+	ni_dbus_server_t *server;
+	ni_dbus_object_t *object;
+
+	if (!(server = ni_dbus_server_open("system", TEST_BUS_NAME, NULL)))
+		return 1;
+	if (ni_dbus_server_listen_peer(server, address) < 0)
+		return 1;
+
+	/* let the credentials decide who may talk to us */
+	if (!strncmp(address, "unix:path=", 10))
+		chmod(address + 10, 0666);
+
+	object = ni_dbus_server_register_object(server, "Test", &test_class, NULL);
+	if (!object || !ni_dbus_object_register_service(object, &test_service))
+		return 1;
+
+	if (write(ready, "", 1) < 0)
+		return 1;
+	close(ready);
+
+	while (1)
+		ni_socket_wait(1000);
+	return 0;
+}
+
+static pid_t
+test_server_start(const char *address)
+{
+	char fdarg[32];
+	int pfd[2];
+	pid_t pid;
+	char ready;
+
+	if (pipe(pfd) < 0)
+		ni_fatal("Cannot create pipe: %m");
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork server: %m");
+	if (pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		close(pfd[0]);
+		snprintf(fdarg, sizeof(fdarg), "%d", pfd[1]);
+		execl("/proc/self/exe", "dbus-peer-test", "--server", address,
+				"--ready-fd", fdarg, NULL);
+		ni_error("Cannot execute test server: %m");
+		_exit(127);
+	}
+	close(pfd[1]);
+	if (read(pfd[0], &ready, 1) != 1)
+		ni_fatal("test server did not start");
+	close(pfd[0]);
+	return pid;
+}
+
+static void
+test_server_stop(pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+/*
+ * checks
+ */
+static unsigned int
+test_call_uint(ni_dbus_object_t *proxy, const char *method)
+{
+	uint32_t value = -1U;
+
+	if (ni_dbus_object_call_simple(proxy, TEST_INTERFACE, method,
+				DBUS_TYPE_INVALID, NULL, DBUS_TYPE_UINT32, &value) < 0)
+		return -1U;
+	return value;
+}
+
+static ni_bool_t
+test_echo_call(ni_dbus_object_t *proxy, const char *data)
+{
+	char *result = NULL;
+	ni_bool_t ok;
+
+	if (ni_dbus_object_call_simple(proxy, TEST_INTERFACE, "Echo",
+				DBUS_TYPE_STRING, &data, DBUS_TYPE_STRING, &result) < 0)
+		return FALSE;
+	ok = ni_string_eq(result, data);
+	ni_string_free(&result);
+	return ok;
+}
+
+static unsigned int	test_events;
+static unsigned int	test_bus_events;
+static unsigned int	test_peer_events;
+
+static void
+test_event_signal(ni_dbus_connection_t *conn, ni_dbus_message_t *msg, void *user_data)
+{
+	unsigned int *events = user_data;
+
+	if (ni_string_eq(dbus_message_get_member(msg), "Event"))
+		(*events)++;
+}
+
+/*
+ * Run the main loop, including the timers, until the counter
+ * reaches the count or the time (msec) is up
+ */
+static void
+test_mainloop(const unsigned int *counter, unsigned int count, unsigned int msec)
+{
+	struct timespec begin;
+	long timeout;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	while ((!counter || *counter < count) && test_elapsed(&begin) < msec) {
+		timeout = ni_timer_next_timeout();
+		if (timeout < 0 || timeout > 100)
+			timeout = 100;
+		ni_socket_wait(timeout);
+	}
+}
+
+/*
+ * Let the server emit signals on the call of the proxy and wait
+ * until the client receives them
+ */
+static ni_bool_t
+test_emit_signals_to(ni_dbus_object_t *proxy, unsigned int *events, unsigned int count)
+{
+	*events = 0;
+	if (ni_dbus_object_call_simple(proxy, TEST_INTERFACE, "Emit",
+				DBUS_TYPE_UINT32, &count, DBUS_TYPE_INVALID, NULL) < 0)
+		return FALSE;
+
+	test_mainloop(events, count, TEST_SIGNAL_TIMEOUT * 1000);
+	test_events = *events;
+	return *events == count;
+}
+
+static ni_bool_t
+test_emit_signals(ni_dbus_object_t *proxy, unsigned int count)
+{
+	return test_emit_signals_to(proxy, &test_peer_events, count);
+}
+
+/*
+ * Connect as another user and expect the peer to refuse us
+ */
+static ni_bool_t
+test_refused_user(const char *address)
+{
+	ni_dbus_connection_t *conn;
+	int status;
+	pid_t pid;
+
+	if ((pid = fork()) < 0)
+		return FALSE;
+	if (pid == 0) {
+		if (setgid(65534) < 0 || setuid(65534) < 0)
+			_exit(2);
+		conn = ni_dbus_connection_open_peer(address);
+		_exit(conn ? 1 : 0);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+		return FALSE;
+	return WEXITSTATUS(status) == 0;
+}
+
+static void
+test_throughput(const char *transport, ni_dbus_object_t *proxy, unsigned int count, pid_t bus)
+{
+	struct timespec begin;
+	double elapsed, bus_cpu;
+	unsigned int i, ok = 0;
+
+	bus_cpu = test_cpu_time(bus);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < count; ++i)
+		ok += test_echo_call(proxy, "eth0 ipv4 dhcp up") ? 1 : 0;
+	elapsed = test_elapsed(&begin);
+	bus_cpu = test_cpu_time(bus) - bus_cpu;
+	printf("%s: %u calls in %.1f ms, %.0f calls/s, bus daemon cpu %.0f ms\n",
+			transport, count, elapsed, count * 1000.0 / elapsed, bus_cpu);
+	if (ok != count)
+		test_failures++;
+
+	bus_cpu = test_cpu_time(bus);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (!test_emit_signals(proxy, count))
+		test_failures++;
+	elapsed = test_elapsed(&begin);
+	bus_cpu = test_cpu_time(bus) - bus_cpu;
+	printf("%s: %u signals in %.1f ms, %.0f signals/s, bus daemon cpu %.0f ms\n",
+			transport, test_events, elapsed, test_events * 1000.0 / elapsed, bus_cpu);
+}
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/dbus-peer-test.XXXXXX";
+	char address[PATH_MAX + 16], socket_path[PATH_MAX];
+	ni_dbus_client_t *bus_client, *peer_client;
+	ni_dbus_object_t *bus_proxy, *peer_proxy;
+	const char *opt_server = NULL;
+	unsigned int count = 5000;
+	unsigned int ready_fd = 0;
+	pid_t bus, server;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./dbus-peer-test [--count N] [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_COUNT:
+			if (ni_parse_uint(optarg, &count, 10) < 0 || !count)
+				goto usage;
+			break;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_SERVER:
+			opt_server = optarg;
+			break;
+
+		case OPT_READY_FD:
+			if (ni_parse_uint(optarg, &ready_fd, 10) < 0)
+				goto usage;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("dbus-peer-test") < 0)
+		return 1;
+	if (opt_server)
+		return test_server(opt_server, ready_fd);
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	chmod(template, 0755);
+	snprintf(socket_path, sizeof(socket_path), "%s/%s.socket", template, TEST_BUS_NAME);
+	snprintf(address, sizeof(address), "unix:path=%s", socket_path);
+
+	bus = test_bus_start(template);
+	server = test_server_start(address);
+
+	if (!(bus_client = ni_dbus_client_open("system", TEST_BUS_NAME)))
+		ni_fatal("Cannot open bus client");
+	if (!(peer_client = ni_dbus_client_open_peer(address, "system", TEST_BUS_NAME)))
+		ni_fatal("Cannot open peer client");
+
+	bus_proxy = ni_dbus_client_object_new(bus_client, &test_class,
+			TEST_OBJECT_PATH, TEST_INTERFACE, NULL);
+	peer_proxy = ni_dbus_client_object_new(peer_client, &test_class,
+			TEST_OBJECT_PATH, TEST_INTERFACE, NULL);
+	ni_dbus_client_add_signal_handler(bus_client, TEST_BUS_NAME, NULL,
+			TEST_INTERFACE, test_event_signal, &test_bus_events);
+	ni_dbus_client_add_signal_handler(peer_client, TEST_BUS_NAME, NULL,
+			TEST_INTERFACE, test_event_signal, &test_peer_events);
+
+	check(test_call_uint(bus_proxy, "ViaPeer") == 0, "bus client calls over the bus");
+	check(test_call_uint(peer_proxy, "ViaPeer") == 1, "peer client calls over the peer socket");
+	check(test_echo_call(peer_proxy, "hello"), "peer call returns its reply");
+	check(test_call_uint(peer_proxy, "Caller") == getuid(), "peer caller uid from its credentials");
+	check(test_emit_signals(peer_proxy, 10), "peer receives the signals once");
+	if (getuid() == 0)
+		check(test_refused_user(address), "peer of another user refused");
+	else
+		printf("SKIP: peer of another user refused (not root)\n");
+
+	/*
+	 * a restarted server is reconnected from the main loop: the signals
+	 * it emits on a call of another client arrive without a peer call,
+	 * over the bus until the retry gets back to the peer socket
+	 */
+	test_server_stop(server);
+	test_mainloop(NULL, 0, TEST_NOTICE_TIME);
+	server = test_server_start(address);
+	check(test_emit_signals_to(bus_proxy, &test_peer_events, 10),
+			"peer client receives signals after a restart without a call");
+	test_mainloop(NULL, 0, TEST_RECONNECT_TIME);
+	check(test_call_uint(peer_proxy, "ViaPeer") == 1, "peer client returns to the peer socket");
+	check(test_emit_signals_to(bus_proxy, &test_peer_events, 10),
+			"peer client receives signals over the peer socket again");
+
+	/* a restarted server is reconnected on the next call */
+	test_server_stop(server);
+	server = test_server_start(address);
+	check(test_echo_call(peer_proxy, "again") &&
+	      test_call_uint(peer_proxy, "ViaPeer") == 1, "peer client reconnects");
+	check(test_emit_signals(peer_proxy, 10), "peer signal handlers survive the reconnect");
+
+	test_throughput("bus ", bus_proxy, count, bus);
+	test_throughput("peer", peer_proxy, count, bus);
+
+	ni_dbus_object_free(bus_proxy);
+	ni_dbus_object_free(peer_proxy);
+	ni_dbus_client_free(bus_client);
+	ni_dbus_client_free(peer_client);
+
+	test_server_stop(server);
+	kill(bus, SIGTERM);
+	waitpid(bus, NULL, 0);
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}
@@ -0,0 +1,258 @@
+/*
+ * DHCP4 and DHCP6 device lookup throughput with many devices.
+ *
+ * Creates the given number of simulated devices in both supplicants
+ * and drives events across them in random order: the ifindex lookup
+ * done for every netlink event and D-Bus request, compared with the
+ * linear walk of the active device list it replaces, and the xid
+ * allocation and dispatch of every new transaction.
+ *
+ *	dhcp-device-bench [--devices N] [--rounds N] [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+
+#include "dhcp4/dhcp4.h"
+#include "dhcp6/dhcp6.h"
+#include "dhcp6/device.h"
+#include "dhcp6/protocol.h"
+#include "test-util.h"
+
+extern ni_dhcp6_device_t *	ni_dhcp6_active;
+
+enum {
+	OPT_DEBUG,
+	OPT_DEVICES,
+	OPT_ROUNDS,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "devices",		required_argument,	NULL,	OPT_DEVICES },
+	{ "rounds",		required_argument,	NULL,	OPT_ROUNDS },
+
+	{ NULL }
+};
+
+/* the interface indexes of the devices, in random event order */
+static unsigned int *
+bench_events(unsigned int devices)
+{
+	unsigned int *order, i, j, tmp;
+
+	if (!(order = calloc(devices, sizeof(*order))))
+		ni_fatal("unable to allocate event order");
+
+	/* leave some gaps as deleted interfaces do */
+	for (i = 0; i < devices; ++i)
+		order[i] = 2 + i + i / 3;
+
+	for (i = devices - 1; i > 0; --i) {
+		j = random() % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	return order;
+}
+
+static unsigned int
+bench_create(unsigned int *order, unsigned int devices)
+{
+	char ifname[IFNAMSIZ];
+	ni_linkinfo_t link;
+	unsigned int i;
+
+	for (i = 0; i < devices; ++i) {
+		memset(&link, 0, sizeof(link));
+		link.ifindex = order[i];
+		link.type = NI_IFTYPE_VLAN;
+		link.mtu = 1500;
+		link.hwaddr.type = ARPHRD_ETHER;
+		link.hwaddr.len = 6;
+		link.hwaddr.data[0] = 0x52;
+		link.hwaddr.data[4] = order[i] >> 8;
+		link.hwaddr.data[5] = order[i];
+		snprintf(ifname, sizeof(ifname), "vlan%u", order[i]);
+
+		if (!ni_dhcp4_device_new(ifname, &link) ||
+		    !ni_dhcp6_device_new(ifname, &link))
+			return 1;
+	}
+	return 0;
+}
+
+static unsigned int
+bench_index(const unsigned int *order, unsigned int devices, unsigned int rounds)
+{
+	ni_dhcp4_device_t *dev4;
+	ni_dhcp6_device_t *dev6;
+	unsigned int r, i, failures = 0;
+
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < devices; ++i) {
+			dev4 = ni_dhcp4_device_by_index(order[i]);
+			dev6 = ni_dhcp6_device_by_index(order[i]);
+			if (!dev4 || dev4->link.ifindex != order[i] ||
+			    !dev6 || dev6->link.ifindex != order[i])
+				failures++;
+		}
+	}
+	return failures;
+}
+
+/* the active list walk done before the device hash tables */
+static unsigned int
+bench_linear(const unsigned int *order, unsigned int devices, unsigned int rounds)
+{
+	ni_dhcp4_device_t *dev4;
+	ni_dhcp6_device_t *dev6;
+	unsigned int r, i, failures = 0;
+
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < devices; ++i) {
+			for (dev4 = ni_dhcp4_active; dev4; dev4 = dev4->next) {
+				if (dev4->system.ifindex == order[i])
+					break;
+			}
+			for (dev6 = ni_dhcp6_active; dev6; dev6 = dev6->next) {
+				if (dev6->link.ifindex == order[i])
+					break;
+			}
+			if (!dev4 || !dev6)
+				failures++;
+		}
+	}
+	return failures;
+}
+
+/* a new transaction on every device and the dispatch of its reply */
+static unsigned int
+bench_xid(const unsigned int *order, unsigned int devices, unsigned int rounds)
+{
+	ni_dhcp4_device_t *dev4;
+	ni_dhcp6_device_t *dev6;
+	unsigned int r, i, xid, failures = 0;
+
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < devices; ++i) {
+			if (!(dev4 = ni_dhcp4_device_by_index(order[i])) ||
+			    !(dev6 = ni_dhcp6_device_by_index(order[i]))) {
+				failures++;
+				continue;
+			}
+
+			ni_dhcp4_new_xid(dev4);
+			do {
+				xid = random() & NI_DHCP6_XID_MASK;
+			} while (!xid || ni_dhcp6_device_by_xid(xid));
+			ni_dhcp6_device_set_xid(dev6, xid);
+
+			if (ni_dhcp4_device_by_xid(dev4->dhcp4.xid) != dev4 ||
+			    ni_dhcp6_device_by_xid(xid) != dev6)
+				failures++;
+		}
+	}
+	return failures;
+}
+
+static unsigned int
+bench_destroy(const unsigned int *order, unsigned int devices)
+{
+	ni_dhcp4_device_t *dev4;
+	ni_dhcp6_device_t *dev6;
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < devices; ++i) {
+		if ((dev4 = ni_dhcp4_device_by_index(order[i])))
+			ni_dhcp4_device_put(dev4);
+		if ((dev6 = ni_dhcp6_device_by_index(order[i])))
+			ni_dhcp6_device_put(dev6);
+
+		if (ni_dhcp4_device_by_index(order[i]) ||
+		    ni_dhcp6_device_by_index(order[i]))
+			failures++;
+	}
+	if (ni_dhcp4_active || ni_dhcp6_active)
+		failures++;
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int devices = 5000, rounds = 10, failures = 0;
+	unsigned int *order;
+	double start;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./dhcp-device-bench [--devices N] [--rounds N]"
+				" [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_DEVICES:
+			if (ni_parse_uint(optarg, &devices, 10) < 0 || !devices)
+				goto usage;
+			break;
+
+		case OPT_ROUNDS:
+			if (ni_parse_uint(optarg, &rounds, 10) < 0 || !rounds)
+				goto usage;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	srandom(1);
+	order = bench_events(devices);
+
+	start = bench_now();
+	failures += bench_create(order, devices);
+	bench_report("create", devices, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_index(order, devices, rounds);
+	bench_report("index", devices * rounds, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_linear(order, devices, rounds);
+	bench_report("linear", devices * rounds, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_xid(order, devices, rounds);
+	bench_report("xid", devices * rounds, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_destroy(order, devices);
+	bench_report("destroy", devices, bench_now() - start);
+
+	printf("%u devices, %u rounds: %u failures\n", devices, rounds, failures);
+	free(order);
+	return failures ? 1 : 0;
+}
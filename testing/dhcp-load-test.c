@@ -0,0 +1,950 @@
+/*
+ * DHCPv4/DHCPv6 supplicant load test.
+ *
+ * Creates N veth pairs inside a private network namespace (using an
+ * unprivileged user namespace when needed), runs a minimal DHCPv4 and
+ * DHCPv6 responder on the server ends in a child process and acquires
+ * a lease on every client end using the dhcp4 and dhcp6 supplicant
+ * code, as wickedd-dhcp4 and wickedd-dhcp6 run it, minus D-Bus.
+ *
+ * Reports the lease acquisition latency percentiles, the CPU time of
+ * the supplicant and the responder and the packet rate.
+ *
+ * With --shared-socket, the dhcp6 supplicant uses one socket for all
+ * devices as configured by <addrconf><dhcp6><shared-socket>.
+ *
+ *	dhcp-load-test [--clients N] [--family ipv4|ipv6|both]
+ *	               [--timeout SEC] [--no-netns] [--shared-socket]
+ *	               [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
+#include <errno.h>
+#include <poll.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/if_link.h>
+#include <linux/veth.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/socket.h>
+#include <wicked/system.h>
+#include <wicked/addrconf.h>
+
+#include "dhcp4/dhcp4.h"
+#include "dhcp4/protocol.h"
+#include "dhcp6/dhcp6.h"
+#include "dhcp6/protocol.h"
+#include "dhcp6/options.h"
+#include "appconfig.h"
+#include "kernel.h"
+
+extern ni_global_t ni_global;
+
+enum {
+	OPT_DEBUG,
+	OPT_CLIENTS,
+	OPT_FAMILY,
+	OPT_TIMEOUT,
+	OPT_NO_NETNS,
+	OPT_SHARED_SOCKET,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "clients",		required_argument,	NULL,	OPT_CLIENTS },
+	{ "family",		required_argument,	NULL,	OPT_FAMILY },
+	{ "timeout",		required_argument,	NULL,	OPT_TIMEOUT },
+	{ "no-netns",		no_argument,		NULL,	OPT_NO_NETNS },
+	{ "shared-socket",	no_argument,		NULL,	OPT_SHARED_SOCKET },
+
+	{ NULL }
+};
+
+#define LOAD_LEASE_TIME		3600
+
+typedef struct load_client {
+	char			ifname[IFNAMSIZ];
+	char			peer[IFNAMSIZ];
+	unsigned int		ifindex;
+	unsigned int		peer_index;
+
+	ni_dhcp4_device_t *	dev4;
+	ni_dhcp6_device_t *	dev6;
+	struct timeval		start4, done4;
+	struct timeval		start6, done6;
+} load_client_t;
+
+typedef struct load_stats {
+	unsigned long		rx;
+	unsigned long		tx;
+} load_stats_t;
+
+static load_client_t *		clients;
+static unsigned int		nclients;
+static load_client_t **		clients_by_index;
+static unsigned int		max_index;
+static unsigned int		pending;
+
+static volatile sig_atomic_t	responder_done;
+
+/*
+ * The address handed out to a client and the one of its server
+ */
+static struct in_addr
+load_ipv4_addr(unsigned int n, unsigned int host)
+{
+	struct in_addr addr;
+
+	addr.s_addr = htonl(0x0a000000 | ((n + 1) << 8) | host);
+	return addr;
+}
+
+static struct in6_addr
+load_ipv6_addr(unsigned int n, unsigned int host)
+{
+	struct in6_addr addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.s6_addr[0] = 0xfd;
+	addr.s6_addr[6] = (n + 1) >> 8;
+	addr.s6_addr[7] = (n + 1);
+	addr.s6_addr[15] = host;
+	return addr;
+}
+
+static double
+load_elapsed_ms(const struct timeval *start, const struct timeval *end)
+{
+	struct timeval delta;
+
+	timersub(end, start, &delta);
+	return delta.tv_sec * 1000.0 + delta.tv_usec / 1000.0;
+}
+
+/*
+ * Network namespace and veth pair setup
+ */
+static int
+load_write_file(const char *path, const char *data)
+{
+	FILE *fp;
+	int ret;
+
+	if (!(fp = fopen(path, "w")))
+		return -1;
+	ret = fputs(data, fp) < 0 ? -1 : 0;
+	if (fclose(fp) < 0)
+		ret = -1;
+	return ret;
+}
+
+static int
+load_enter_netns(void)
+{
+	char map[64];
+	uid_t uid = getuid();
+	gid_t gid = getgid();
+
+	if (unshare(CLONE_NEWNET) == 0)
+		return 0;
+	if (errno != EPERM)
+		return -1;
+
+	if (unshare(CLONE_NEWUSER | CLONE_NEWNET) < 0)
+		return -1;
+
+	snprintf(map, sizeof(map), "0 %u 1\n", uid);
+	if (load_write_file("/proc/self/uid_map", map) < 0)
+		return -1;
+	load_write_file("/proc/self/setgroups", "deny\n");
+	snprintf(map, sizeof(map), "0 %u 1\n", gid);
+	return load_write_file("/proc/self/gid_map", map);
+}
+
+static int
+load_link_up(const char *ifname)
+{
+	struct ifinfomsg ifi;
+	struct nl_msg *msg;
+	int err = -1;
+
+	memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_flags = IFF_UP;
+	ifi.ifi_change = IFF_UP;
+
+	msg = nlmsg_alloc_simple(RTM_NEWLINK, 0);
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+	NLA_PUT_STRING(msg, IFLA_IFNAME, ifname);
+
+	if ((err = ni_nl_talk(msg, NULL)))
+		ni_error("%s: unable to set link up: %s", ifname, nl_geterror(err));
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return err ? -1 : 0;
+}
+
+static int
+load_veth_create(const char *ifname, const char *peer)
+{
+	struct nlattr *linkinfo, *infodata, *peerinfo;
+	struct ifinfomsg ifi;
+	struct nl_msg *msg;
+	int err = -1;
+
+	memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_flags = IFF_UP;
+	ifi.ifi_change = IFF_UP;
+
+	msg = nlmsg_alloc_simple(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+
+	NLA_PUT_STRING(msg, IFLA_IFNAME, ifname);
+	if (!(linkinfo = nla_nest_start(msg, IFLA_LINKINFO)))
+		goto nla_put_failure;
+	NLA_PUT_STRING(msg, IFLA_INFO_KIND, "veth");
+	if (!(infodata = nla_nest_start(msg, IFLA_INFO_DATA)))
+		goto nla_put_failure;
+	if (!(peerinfo = nla_nest_start(msg, VETH_INFO_PEER)))
+		goto nla_put_failure;
+	/* a veth end can't be brought up before its peer exists */
+	ifi.ifi_flags = 0;
+	ifi.ifi_change = 0;
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+	NLA_PUT_STRING(msg, IFLA_IFNAME, peer);
+	nla_nest_end(msg, peerinfo);
+	nla_nest_end(msg, infodata);
+	nla_nest_end(msg, linkinfo);
+
+	if ((err = ni_nl_talk(msg, NULL)))
+		ni_error("%s: unable to create veth pair: %s", ifname, nl_geterror(err));
+	else
+		err = load_link_up(peer);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return err ? -1 : 0;
+}
+
+static int
+load_veth_delete(unsigned int ifindex)
+{
+	struct ifinfomsg ifi;
+	struct nl_msg *msg;
+	int err = -1;
+
+	memset(&ifi, 0, sizeof(ifi));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_index = ifindex;
+
+	msg = nlmsg_alloc_simple(RTM_DELLINK, 0);
+	if (nlmsg_append(msg, &ifi, sizeof(ifi), NLMSG_ALIGNTO) == 0)
+		err = ni_nl_talk(msg, NULL);
+	nlmsg_free(msg);
+	return err ? -1 : 0;
+}
+
+static int
+load_setup(ni_bool_t netns)
+{
+	ni_netconfig_t *nc;
+	ni_netdev_t *dev;
+	unsigned int n;
+
+	/* skip the DAD of the link-local addresses in our own namespace */
+	if (netns) {
+		load_write_file("/proc/sys/net/ipv6/conf/all/accept_dad", "0");
+		load_write_file("/proc/sys/net/ipv6/conf/default/accept_dad", "0");
+	}
+
+	/* opens the netlink socket used to create the pairs */
+	if (!ni_global_state_handle(0))
+		return -1;
+
+	for (n = 0; n < nclients; ++n) {
+		snprintf(clients[n].ifname, IFNAMSIZ, "dlc%u", n);
+		snprintf(clients[n].peer, IFNAMSIZ, "dls%u", n);
+		if (load_veth_create(clients[n].ifname, clients[n].peer) < 0)
+			return -1;
+	}
+
+	if (!(nc = ni_global_state_handle(1)))
+		return -1;
+
+	for (n = 0; n < nclients; ++n) {
+		if (!(dev = ni_netdev_by_name(nc, clients[n].ifname)))
+			return -1;
+		clients[n].ifindex = dev->link.ifindex;
+		if (!(dev = ni_netdev_by_name(nc, clients[n].peer)))
+			return -1;
+		clients[n].peer_index = dev->link.ifindex;
+
+		if (max_index < clients[n].ifindex)
+			max_index = clients[n].ifindex;
+	}
+
+	clients_by_index = xcalloc(max_index + 1, sizeof(*clients_by_index));
+	for (n = 0; n < nclients; ++n)
+		clients_by_index[clients[n].ifindex] = &clients[n];
+	return 0;
+}
+
+static void
+load_cleanup(void)
+{
+	unsigned int n;
+
+	/* deleting one end of a veth pair deletes both */
+	for (n = 0; n < nclients; ++n) {
+		if (clients[n].dev4)
+			ni_dhcp4_device_put(clients[n].dev4);
+		if (clients[n].dev6)
+			ni_dhcp6_device_put(clients[n].dev6);
+		if (clients[n].ifindex)
+			load_veth_delete(clients[n].ifindex);
+	}
+}
+
+/*
+ * The responder, answering DISCOVER/REQUEST and SOLICIT/REQUEST
+ * with an OFFER/ACK and ADVERTISE/REPLY of a fixed lease per pair.
+ */
+static int
+load_responder_socket(int family, const char *ifname, unsigned int ifindex)
+{
+	struct sockaddr_in6 sin6;
+	struct sockaddr_in sin;
+	struct ipv6_mreq mreq;
+	int fd, on = 1;
+
+	if ((fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname) + 1) < 0)
+		goto failure;
+
+	if (family == AF_INET) {
+		setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(DHCP4_SERVER_PORT);
+		if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			goto failure;
+	} else {
+		setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+		memset(&sin6, 0, sizeof(sin6));
+		sin6.sin6_family = AF_INET6;
+		sin6.sin6_port = htons(NI_DHCP6_SERVER_PORT);
+		if (bind(fd, (struct sockaddr *)&sin6, sizeof(sin6)) < 0)
+			goto failure;
+
+		memset(&mreq, 0, sizeof(mreq));
+		inet_pton(AF_INET6, "ff02::1:2", &mreq.ipv6mr_multiaddr);
+		mreq.ipv6mr_interface = ifindex;
+		if (setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) < 0)
+			goto failure;
+	}
+	return fd;
+
+failure:
+	ni_error("%s: unable to open responder socket: %m", ifname);
+	close(fd);
+	return -1;
+}
+
+static unsigned char *
+load_dhcp4_put_option(unsigned char *ptr, unsigned int code, const void *data, size_t len)
+{
+	*ptr++ = code;
+	*ptr++ = len;
+	memcpy(ptr, data, len);
+	return ptr + len;
+}
+
+static void
+load_responder_dhcp4(int fd, unsigned int n, load_stats_t *stats)
+{
+	unsigned char in[1500], out[576], *opt, *ptr;
+	const ni_dhcp4_message_t *req = (const ni_dhcp4_message_t *)in;
+	ni_dhcp4_message_t *rep = (ni_dhcp4_message_t *)out;
+	struct in_addr server = load_ipv4_addr(n, 1);
+	struct sockaddr_in sin;
+	uint32_t lease_time = htonl(LOAD_LEASE_TIME);
+	uint32_t netmask = htonl(0xffffff00);
+	unsigned char type = 0;
+	ssize_t len;
+
+	if ((len = recv(fd, in, sizeof(in), 0)) < (ssize_t)sizeof(*req))
+		return;
+	stats->rx++;
+
+	if (req->op != DHCP4_BOOTREQUEST || req->cookie != htonl(MAGIC_COOKIE))
+		return;
+
+	for (opt = in + sizeof(*req); opt < in + len && *opt != DHCP4_END; ) {
+		if (*opt == DHCP4_PAD) {
+			opt++;
+			continue;
+		}
+		if (opt + 2 > in + len || opt + 2 + opt[1] > in + len)
+			return;
+		if (opt[0] == DHCP4_MESSAGETYPE && opt[1] == 1)
+			type = opt[2];
+		opt += 2 + opt[1];
+	}
+
+	switch (type) {
+	case DHCP4_DISCOVER:
+		type = DHCP4_OFFER;
+		break;
+	case DHCP4_REQUEST:
+		type = DHCP4_ACK;
+		break;
+	default:
+		return;
+	}
+
+	memset(out, 0, sizeof(out));
+	rep->op = DHCP4_BOOTREPLY;
+	rep->hwtype = req->hwtype;
+	rep->hwlen = req->hwlen;
+	rep->xid = req->xid;
+	rep->flags = req->flags;
+	rep->yiaddr = load_ipv4_addr(n, 100).s_addr;
+	rep->siaddr = server.s_addr;
+	memcpy(rep->chaddr, req->chaddr, sizeof(rep->chaddr));
+	rep->cookie = htonl(MAGIC_COOKIE);
+
+	ptr = out + sizeof(*rep);
+	ptr = load_dhcp4_put_option(ptr, DHCP4_MESSAGETYPE, &type, 1);
+	ptr = load_dhcp4_put_option(ptr, DHCP4_SERVERIDENTIFIER, &server, 4);
+	ptr = load_dhcp4_put_option(ptr, DHCP4_LEASETIME, &lease_time, 4);
+	ptr = load_dhcp4_put_option(ptr, DHCP4_NETMASK, &netmask, 4);
+	*ptr++ = DHCP4_END;
+	if (ptr < out + 300)
+		ptr = out + 300;
+
+	/* the client has no address yet, always broadcast */
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(DHCP4_CLIENT_PORT);
+	sin.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+	if (sendto(fd, out, ptr - out, 0, (struct sockaddr *)&sin, sizeof(sin)) > 0)
+		stats->tx++;
+}
+
+static unsigned char *
+load_dhcp6_put_option(unsigned char *ptr, unsigned int code, const void *data, size_t len)
+{
+	ptr[0] = code >> 8;
+	ptr[1] = code;
+	ptr[2] = len >> 8;
+	ptr[3] = len;
+	memcpy(ptr + 4, data, len);
+	return ptr + 4 + len;
+}
+
+static void
+load_responder_dhcp6(int fd, unsigned int n, load_stats_t *stats)
+{
+	unsigned char in[1500], out[512], ia_na[40], duid[10], *opt, *ptr;
+	const unsigned char *client_id = NULL, *iaid = NULL;
+	struct in6_addr addr = load_ipv6_addr(n, 100);
+	struct sockaddr_in6 from;
+	socklen_t slen = sizeof(from);
+	unsigned int code, olen, client_id_len = 0;
+	uint32_t val;
+	ssize_t len;
+
+	if ((len = recvfrom(fd, in, sizeof(in), 0, (struct sockaddr *)&from, &slen)) < 4)
+		return;
+	stats->rx++;
+
+	for (opt = in + 4; opt + 4 <= in + len; opt += 4 + olen) {
+		code = (opt[0] << 8) | opt[1];
+		olen = (opt[2] << 8) | opt[3];
+		if (opt + 4 + olen > in + len)
+			return;
+		if (code == NI_DHCP6_OPTION_CLIENTID) {
+			client_id = opt + 4;
+			client_id_len = olen;
+		} else
+		if (code == NI_DHCP6_OPTION_IA_NA && olen >= 12) {
+			iaid = opt + 4;
+		}
+	}
+	if (!client_id || !iaid)
+		return;
+
+	memcpy(out, in, 4);
+	switch (in[0]) {
+	case NI_DHCP6_SOLICIT:
+		out[0] = NI_DHCP6_ADVERTISE;
+		break;
+	case NI_DHCP6_REQUEST:
+		out[0] = NI_DHCP6_REPLY;
+		break;
+	default:
+		return;
+	}
+
+	/* DUID-LL of a made-up server link layer address */
+	memset(duid, 0, sizeof(duid));
+	duid[1] = 3;
+	duid[3] = 1;
+	duid[4] = 0x52;
+	duid[8] = (n + 1) >> 8;
+	duid[9] = (n + 1);
+
+	/* IA_NA with T1, T2 and the IA address option */
+	memcpy(ia_na, iaid, 4);
+	val = htonl(LOAD_LEASE_TIME / 2);
+	memcpy(ia_na + 4, &val, 4);
+	val = htonl(LOAD_LEASE_TIME * 4 / 5);
+	memcpy(ia_na + 8, &val, 4);
+	ia_na[12] = 0;
+	ia_na[13] = NI_DHCP6_OPTION_IA_ADDRESS;
+	ia_na[14] = 0;
+	ia_na[15] = 24;
+	memcpy(ia_na + 16, &addr, 16);
+	val = htonl(LOAD_LEASE_TIME);
+	memcpy(ia_na + 32, &val, 4);
+	val = htonl(LOAD_LEASE_TIME * 2);
+	memcpy(ia_na + 36, &val, 4);
+
+	ptr = out + 4;
+	ptr = load_dhcp6_put_option(ptr, NI_DHCP6_OPTION_CLIENTID, client_id, client_id_len);
+	ptr = load_dhcp6_put_option(ptr, NI_DHCP6_OPTION_SERVERID, duid, sizeof(duid));
+	ptr = load_dhcp6_put_option(ptr, NI_DHCP6_OPTION_IA_NA, ia_na, sizeof(ia_na));
+
+	if (sendto(fd, out, ptr - out, 0, (struct sockaddr *)&from, slen) > 0)
+		stats->tx++;
+}
+
+static void
+load_responder_stop(int sig)
+{
+	(void)sig;
+	responder_done = 1;
+}
+
+static void
+load_responder_run(unsigned int family, int pipefd)
+{
+	load_stats_t stats = { 0, 0 };
+	struct pollfd *pfd;
+	unsigned int *pair, npfd = 0, n;
+	int *pfamily;
+
+	signal(SIGTERM, load_responder_stop);
+
+	pfd = xcalloc(2 * nclients, sizeof(*pfd));
+	pair = xcalloc(2 * nclients, sizeof(*pair));
+	pfamily = xcalloc(2 * nclients, sizeof(*pfamily));
+	for (n = 0; n < nclients; ++n) {
+		if (family != AF_INET6) {
+			pfd[npfd].fd = load_responder_socket(AF_INET,
+					clients[n].peer, clients[n].peer_index);
+			pfd[npfd].events = POLLIN;
+			pfamily[npfd] = AF_INET;
+			pair[npfd++] = n;
+		}
+		if (family != AF_INET) {
+			pfd[npfd].fd = load_responder_socket(AF_INET6,
+					clients[n].peer, clients[n].peer_index);
+			pfd[npfd].events = POLLIN;
+			pfamily[npfd] = AF_INET6;
+			pair[npfd++] = n;
+		}
+	}
+
+	/* tell the parent we're listening */
+	if (write(pipefd, &stats, sizeof(stats)) < 0)
+		_exit(1);
+
+	while (!responder_done) {
+		if (poll(pfd, npfd, 200) <= 0)
+			continue;
+
+		for (n = 0; n < npfd; ++n) {
+			if (!(pfd[n].revents & POLLIN))
+				continue;
+			if (pfamily[n] == AF_INET)
+				load_responder_dhcp4(pfd[n].fd, pair[n], &stats);
+			else
+				load_responder_dhcp6(pfd[n].fd, pair[n], &stats);
+		}
+	}
+
+	if (write(pipefd, &stats, sizeof(stats)) < 0)
+		_exit(1);
+	_exit(0);
+}
+
+/*
+ * The supplicant side
+ */
+static void
+load_dhcp4_event(enum ni_dhcp4_event ev, const ni_dhcp4_device_t *dev,
+		ni_addrconf_lease_t *lease)
+{
+	load_client_t *client;
+
+	if (ev != NI_DHCP4_EVENT_ACQUIRED || !lease || lease->state != NI_ADDRCONF_STATE_GRANTED)
+		return;
+	if (dev->link.ifindex > max_index || !(client = clients_by_index[dev->link.ifindex]))
+		return;
+	if (timerisset(&client->done4))
+		return;
+
+	ni_timer_get_time(&client->done4);
+	pending--;
+}
+
+static void
+load_dhcp6_event(enum ni_dhcp6_event ev, const ni_dhcp6_device_t *dev,
+		ni_addrconf_lease_t *lease)
+{
+	load_client_t *client;
+
+	if (ev != NI_DHCP6_EVENT_ACQUIRED || !lease || lease->state != NI_ADDRCONF_STATE_GRANTED)
+		return;
+	if (dev->link.ifindex > max_index || !(client = clients_by_index[dev->link.ifindex]))
+		return;
+	if (timerisset(&client->done6))
+		return;
+
+	ni_timer_get_time(&client->done6);
+	pending--;
+}
+
+static int
+load_acquire_dhcp4(load_client_t *client, unsigned int timeout)
+{
+	ni_dhcp4_request_t *req;
+	ni_netconfig_t *nc = ni_global_state_handle(0);
+	ni_netdev_t *ifp;
+	int rv;
+
+	if (!(ifp = ni_netdev_by_index(nc, client->ifindex)))
+		return -1;
+	if (!(client->dev4 = ni_dhcp4_device_new(ifp->name, &ifp->link)))
+		return -1;
+
+	req = ni_dhcp4_request_new();
+	req->dry_run = NI_DHCP4_RUN_LEASE;
+	req->update = ~0;
+	req->acquire_timeout = timeout;
+	ni_uuid_generate(&req->uuid);
+
+	ni_timer_get_time(&client->start4);
+	rv = ni_dhcp4_acquire(client->dev4, req);
+	ni_dhcp4_request_free(req);
+	return rv;
+}
+
+static int
+load_acquire_dhcp6(load_client_t *client, unsigned int timeout)
+{
+	ni_dhcp6_request_t *req;
+	ni_netconfig_t *nc = ni_global_state_handle(0);
+	ni_netdev_t *ifp;
+	char *err = NULL;
+	int rv;
+
+	if (!(ifp = ni_netdev_by_index(nc, client->ifindex)))
+		return -1;
+	if (!(client->dev6 = ni_dhcp6_device_new(ifp->name, &ifp->link)))
+		return -1;
+
+	req = ni_dhcp6_request_new();
+	req->dry_run = NI_DHCP6_RUN_LEASE;
+	req->mode = NI_DHCP6_MODE_MANAGED;
+	req->update = ~0;
+	req->acquire_timeout = timeout;
+	ni_uuid_generate(&req->uuid);
+
+	ni_timer_get_time(&client->start6);
+	if ((rv = ni_dhcp6_acquire(client->dev6, req, &err)) < 0)
+		ni_error("%s: %s", client->ifname, err ? err : ni_strerror(rv));
+	ni_string_free(&err);
+	ni_dhcp6_request_free(req);
+	return rv;
+}
+
+/* wait until the link-local addresses are usable for DHCPv6 */
+static int
+load_wait_ipv6_ready(unsigned int timeout)
+{
+	ni_dhcp6_device_t *dev;
+	ni_netdev_t *ifp;
+	unsigned int n, ready;
+	ni_netconfig_t *nc;
+
+	for (timeout *= 10; timeout; --timeout) {
+		if (!(nc = ni_global_state_handle(1)))
+			return -1;
+
+		for (n = ready = 0; n < nclients; ++n) {
+			if (!(ifp = ni_netdev_by_index(nc, clients[n].ifindex)))
+				return -1;
+			dev = ni_dhcp6_device_new(ifp->name, &ifp->link);
+			if (ni_dhcp6_device_check_ready(dev))
+				ready++;
+			ni_dhcp6_device_put(dev);
+		}
+		if (ready == nclients)
+			return 0;
+		usleep(100000);
+	}
+	return -1;
+}
+
+static int
+load_compare_ms(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+load_report(const char *family, unsigned int offset)
+{
+	const struct timeval *start, *done;
+	double *latency, elapsed = 0;
+	struct timeval first, last;
+	unsigned int n, count = 0;
+
+	latency = xcalloc(nclients, sizeof(*latency));
+	timerclear(&first);
+	timerclear(&last);
+	for (n = 0; n < nclients; ++n) {
+		start = (const struct timeval *)((const char *)&clients[n] + offset);
+		done = start + 1;
+		if (!timerisset(done))
+			continue;
+
+		latency[count++] = load_elapsed_ms(start, done);
+		if (!timerisset(&first) || timercmp(start, &first, <))
+			first = *start;
+		if (!timerisset(&last) || timercmp(done, &last, >))
+			last = *done;
+	}
+
+	if (count) {
+		qsort(latency, count, sizeof(*latency), load_compare_ms);
+		elapsed = load_elapsed_ms(&first, &last) / 1000.0;
+	}
+	printf("%s: %u/%u leases in %.3fs", family, count, nclients, elapsed);
+	if (count) {
+		printf(", latency p50 %.1fms p90 %.1fms p99 %.1fms max %.1fms",
+			latency[count * 50 / 100], latency[count * 90 / 100],
+			latency[count * 99 / 100], latency[count - 1]);
+	}
+	printf("\n");
+	free(latency);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int family = AF_UNSPEC, timeout = 60, n, expected;
+	char template[] = "/tmp/dhcp-load-test.XXXXXX";
+	char storedir[PATH_MAX], statedir[PATH_MAX];
+	struct timeval start, end, deadline, now;
+	struct rusage self0, self1, child;
+	ni_bool_t netns = TRUE;
+	ni_bool_t shared = FALSE;
+	load_stats_t stats;
+	struct rlimit rlim;
+	int pipefd[2], c;
+	double elapsed;
+	pid_t pid;
+
+	/* no per lease notices; --debug raises the level again */
+	ni_log_level_set("warning");
+
+	nclients = 100;
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./dhcp-load-test [--clients N] [--family ipv4|ipv6|both]\n"
+				"                 [--timeout SEC] [--no-netns] [--shared-socket]\n"
+				"                 [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_CLIENTS:
+			if (ni_parse_uint(optarg, &nclients, 10) < 0 ||
+			    !nclients || nclients > 0xfffe)
+				goto usage;
+			break;
+
+		case OPT_FAMILY:
+			if (ni_string_eq(optarg, "ipv4"))
+				family = AF_INET;
+			else if (ni_string_eq(optarg, "ipv6"))
+				family = AF_INET6;
+			else if (ni_string_eq(optarg, "both"))
+				family = AF_UNSPEC;
+			else
+				goto usage;
+			break;
+
+		case OPT_TIMEOUT:
+			if (ni_parse_uint(optarg, &timeout, 10) < 0 || !timeout)
+				goto usage;
+			break;
+
+		case OPT_NO_NETNS:
+			netns = FALSE;
+			break;
+
+		case OPT_SHARED_SOCKET:
+			shared = TRUE;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("dhcp-load-test") < 0)
+		return 1;
+
+	if (netns && load_enter_netns() < 0)
+		ni_fatal("Cannot enter a private network namespace: %m");
+
+	/* two packet sockets per client and two responder sockets per pair */
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur < rlim.rlim_max) {
+		rlim.rlim_cur = rlim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	snprintf(storedir, sizeof(storedir), "%s/store", template);
+	snprintf(statedir, sizeof(statedir), "%s/state", template);
+	ni_string_dup(&ni_global.config->storedir.path, storedir);
+	ni_string_dup(&ni_global.config->statedir.path, statedir);
+	ni_config_storedir();
+	ni_config_statedir();
+	ni_global.config->addrconf.dhcp6.shared_socket = shared;
+
+	clients = xcalloc(nclients, sizeof(*clients));
+	if (load_setup(netns) < 0)
+		ni_fatal("Cannot create %u veth pairs", nclients);
+
+	if (family != AF_INET && load_wait_ipv6_ready(timeout) < 0)
+		ni_fatal("IPv6 link-local addresses did not become ready");
+
+	if (pipe(pipefd) < 0 || (pid = fork()) < 0)
+		ni_fatal("Cannot start responder: %m");
+	if (pid == 0) {
+		close(pipefd[0]);
+		load_responder_run(family, pipefd[1]);
+	}
+	close(pipefd[1]);
+	if (read(pipefd[0], &stats, sizeof(stats)) != sizeof(stats))
+		ni_fatal("Responder failed to start");
+
+	ni_dhcp4_set_event_handler(load_dhcp4_event);
+	ni_dhcp6_set_event_handler(load_dhcp6_event);
+
+	getrusage(RUSAGE_SELF, &self0);
+	ni_timer_get_time(&start);
+	for (n = 0; n < nclients; ++n) {
+		if (family != AF_INET6 && load_acquire_dhcp4(&clients[n], timeout) >= 0)
+			pending++;
+		if (family != AF_INET && load_acquire_dhcp6(&clients[n], timeout) >= 0)
+			pending++;
+	}
+	expected = pending;
+
+	deadline = start;
+	deadline.tv_sec += timeout;
+	while (pending && !ni_caught_terminal_signal()) {
+		long wait, left;
+
+		ni_timer_get_time(&now);
+		if ((left = load_elapsed_ms(&now, &deadline)) <= 0)
+			break;
+
+		/* runs the expired timers, which may complete a lease */
+		wait = ni_timer_next_timeout();
+		if (!pending)
+			break;
+		if (wait < 0 || wait > left)
+			wait = left;
+		if (ni_socket_wait(wait) != 0)
+			break;
+	}
+	ni_timer_get_time(&end);
+	getrusage(RUSAGE_SELF, &self1);
+
+	kill(pid, SIGTERM);
+	if (read(pipefd[0], &stats, sizeof(stats)) != sizeof(stats))
+		memset(&stats, 0, sizeof(stats));
+	waitpid(pid, NULL, 0);
+	getrusage(RUSAGE_CHILDREN, &child);
+
+	elapsed = load_elapsed_ms(&start, &end) / 1000.0;
+	if (family != AF_INET6)
+		load_report("ipv4", offsetof(load_client_t, start4));
+	if (family != AF_INET)
+		load_report("ipv6", offsetof(load_client_t, start6));
+
+	timersub(&self1.ru_utime, &self0.ru_utime, &self1.ru_utime);
+	timersub(&self1.ru_stime, &self0.ru_stime, &self1.ru_stime);
+	printf("cpu: supplicant %ld.%03lds user %ld.%03lds sys, "
+		"responder %ld.%03lds user %ld.%03lds sys\n",
+		self1.ru_utime.tv_sec, self1.ru_utime.tv_usec / 1000,
+		self1.ru_stime.tv_sec, self1.ru_stime.tv_usec / 1000,
+		child.ru_utime.tv_sec, child.ru_utime.tv_usec / 1000,
+		child.ru_stime.tv_sec, child.ru_stime.tv_usec / 1000);
+	printf("packets: %lu received, %lu sent in %.3fs: %.0f/sec\n",
+		stats.rx, stats.tx, elapsed,
+		elapsed > 0 ? (stats.rx + stats.tx) / elapsed : 0.0);
+
+	load_cleanup();
+	ni_file_remove_recursively(template);
+	free(clients_by_index);
+	free(clients);
+
+	printf("%u clients: %u of %u leases missing\n", nclients, pending, expected);
+	return pending ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * DHCP4 message build throughput, from scratch and using the device
+ * message templates, and the response parse throughput over a corpus
+ * of packets: option indexing only, the checks done before a lease
+ * is decoded and the complete lease parse.
+ *
+ *	dhcp4-bench [--rounds N] [--debug FACILITY] [file ...]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+
+#include "dhcp4/dhcp4.h"
+#include "dhcp4/protocol.h"
+#include "buffer.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+	OPT_ROUNDS,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "rounds",		required_argument,	NULL,	OPT_ROUNDS },
+
+	{ NULL }
+};
+
+typedef struct bench_packet {
+	unsigned char *		data;
+	size_t			len;
+} bench_packet_t;
+
+typedef enum {
+	BENCH_INDEX,
+	BENCH_FILTER,
+	BENCH_PARSE,
+	BENCH_BUILD,
+	BENCH_TEMPLATE,
+} bench_mode_t;
+
+static bench_packet_t *		packets;
+static unsigned int		npackets;
+
+static int
+load_corpus(const char *filename)
+{
+	static unsigned char data[65536];
+	bench_packet_t *packet;
+	char *line = NULL;
+	size_t size = 0;
+	unsigned int num = 0;
+	ssize_t len;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		printf("%s: unable to open: %m\n", filename);
+		return -1;
+	}
+
+	while (getline(&line, &size, fp) > 0) {
+		num++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		if ((len = ni_parse_hex_data(line, data, sizeof(data), ":")) < 0) {
+			printf("%s:%u: invalid hex data\n", filename, num);
+			continue;
+		}
+
+		if (!(packet = realloc(packets, (npackets + 1) * sizeof(*packet))))
+			ni_fatal("unable to allocate packet");
+		packets = packet;
+
+		packet = &packets[npackets++];
+		if (!(packet->data = malloc(len ? len : 1)))
+			ni_fatal("unable to allocate packet");
+		memcpy(packet->data, data, len);
+		packet->len = len;
+	}
+
+	free(line);
+	fclose(fp);
+	return 0;
+}
+
+static void
+bench_device_init(ni_dhcp4_device_t *dev, ni_addrconf_lease_t **lease)
+{
+	static const unsigned char hwaddr[] = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 };
+	ni_dhcp4_config_t *config;
+
+	memset(dev, 0, sizeof(*dev));
+	dev->ifname = "bench0";
+	dev->fsm.state = NI_DHCP4_STATE_SELECTING;
+	dev->start_time = time(NULL);
+	dev->system.mtu = 1500;
+	dev->system.hwaddr.type = ARPHRD_ETHER;
+	dev->system.hwaddr.len = sizeof(hwaddr);
+	memcpy(dev->system.hwaddr.data, hwaddr, sizeof(hwaddr));
+
+	if (!(config = calloc(1, sizeof(*config))))
+		ni_fatal("unable to allocate config");
+	config->doflags = ~0U;
+	config->fqdn.enabled = NI_TRISTATE_ENABLE;
+	config->fqdn.update = NI_DHCP_FQDN_UPDATE_BOTH;
+	config->fqdn.encode = TRUE;
+	config->fqdn.qualify = TRUE;
+	strcpy(config->hostname, "bench.example.com");
+	strcpy(config->classid, "wicked-bench");
+	config->client_id.data[0] = ARPHRD_ETHER;
+	memcpy(config->client_id.data + 1, hwaddr, sizeof(hwaddr));
+	config->client_id.len = 1 + sizeof(hwaddr);
+	config->user_class.format = NI_DHCP4_USER_CLASS_RFC3004;
+	ni_string_array_append(&config->user_class.class_id, "bench");
+	ni_uint_array_append(&config->request_options, 224);
+	ni_dhcp4_device_set_config(dev, config);
+
+	*lease = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+	inet_aton("192.168.1.100", &(*lease)->dhcp4.address);
+	inet_aton("192.168.1.1", &(*lease)->dhcp4.server_id);
+	(*lease)->dhcp4.lease_time = 3600;
+}
+
+static const struct {
+	enum fsm_state		state;
+	unsigned int		msg_code;
+} bench_msgs[] = {
+	{ NI_DHCP4_STATE_SELECTING,	DHCP4_DISCOVER	},
+	{ NI_DHCP4_STATE_REQUESTING,	DHCP4_REQUEST	},
+	{ NI_DHCP4_STATE_RENEWING,	DHCP4_REQUEST	},
+	{ NI_DHCP4_STATE_REBINDING,	DHCP4_REQUEST	},
+};
+#define BENCH_MSGS	(sizeof(bench_msgs) / sizeof(bench_msgs[0]))
+
+static int
+bench_build_msg(ni_dhcp4_device_t *dev, const ni_addrconf_lease_t *lease,
+		bench_mode_t mode, unsigned int i, ni_buffer_t *buf)
+{
+	dev->fsm.state = bench_msgs[i].state;
+	ni_buffer_clear(buf);
+	if (mode == BENCH_TEMPLATE)
+		return ni_dhcp4_build_message_cached(dev, bench_msgs[i].msg_code, lease, buf);
+	else
+		return ni_dhcp4_build_message(dev, bench_msgs[i].msg_code, lease, buf);
+}
+
+static unsigned int
+bench_build(ni_dhcp4_device_t *dev, const ni_addrconf_lease_t *lease,
+		bench_mode_t mode, unsigned int rounds)
+{
+	unsigned int r, i, failures = 0;
+	ni_buffer_t buf;
+
+	ni_buffer_init_dynamic(&buf, dev->system.mtu);
+	for (r = 0; r < rounds; ++r) {
+		/* the retransmits of a message exchange */
+		dev->dhcp4.xid = 0x12345678 + r / 4;
+		for (i = 0; i < BENCH_MSGS; ++i) {
+			if (bench_build_msg(dev, lease, mode, i, &buf) < 0)
+				failures++;
+		}
+	}
+	ni_buffer_destroy(&buf);
+	return failures;
+}
+
+/*
+ * The messages built using a template have to match the ones built
+ * from scratch, except of a zero UDP checksum in its other encoding.
+ */
+static unsigned int
+bench_verify(ni_dhcp4_device_t *dev, ni_addrconf_lease_t *lease)
+{
+	static const unsigned int xids[] = { 1, 0xffff, 0x10000, 0x12345678, 0xffffffff };
+	const unsigned int sum = sizeof(struct ip) + 6;	/* the udp checksum */
+	unsigned int i, x, failures = 0;
+	ni_buffer_t built, cached;
+	unsigned char *b, *c;
+	size_t len;
+
+	ni_buffer_init_dynamic(&built, dev->system.mtu);
+	ni_buffer_init_dynamic(&cached, dev->system.mtu);
+	for (x = 0; x < sizeof(xids) / sizeof(xids[0]); ++x) {
+		/* a changed lease has to invalidate the templates */
+		if (x == 3)
+			ni_string_dup(&lease->hostname, "other.example.com");
+
+		dev->dhcp4.xid = xids[x];
+		for (i = 0; i < BENCH_MSGS; ++i) {
+			if (bench_build_msg(dev, lease, BENCH_BUILD, i, &built) < 0 ||
+			    bench_build_msg(dev, lease, BENCH_TEMPLATE, i, &cached) < 0 ||
+			    ni_buffer_count(&built) != ni_buffer_count(&cached)) {
+				failures++;
+				continue;
+			}
+
+			b = ni_buffer_head(&built);
+			c = ni_buffer_head(&cached);
+			len = ni_buffer_count(&built);
+			if (!memcmp(b, c, len))
+				continue;
+
+			if (len < sum + 2 || b[sum] || b[sum + 1] ||
+			    c[sum] != 0xff || c[sum + 1] != 0xff ||
+			    memcmp(b + sum + 2, c + sum + 2, len - sum - 2) ||
+			    memcmp(b, c, sum)) {
+				printf("%s xid 0x%x: template differs\n",
+					ni_dhcp4_message_name(bench_msgs[i].msg_code),
+					xids[x]);
+				failures++;
+			}
+		}
+	}
+	ni_string_free(&lease->hostname);
+	ni_buffer_destroy(&built);
+	ni_buffer_destroy(&cached);
+	return failures;
+}
+
+static unsigned int
+bench_run(bench_mode_t mode, unsigned int rounds)
+{
+	static const ni_dhcp4_config_t config;
+	ni_dhcp4_option_index_t index;
+	ni_addrconf_lease_t *lease;
+	ni_dhcp4_message_t *message;
+	struct in_addr server_id;
+	ni_opaque_t client_id;
+	unsigned int r, i, failures = 0;
+	ni_buffer_t buf;
+
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < npackets; ++i) {
+			ni_buffer_init_reader(&buf, packets[i].data, packets[i].len);
+			if (!(message = ni_buffer_pull_head(&buf, sizeof(*message))) ||
+			    ni_dhcp4_option_index_build(&index, message, &buf) < 0) {
+				failures++;
+				continue;
+			}
+
+			switch (mode) {
+			case BENCH_INDEX:
+				break;
+
+			case BENCH_FILTER:
+				ni_dhcp4_option_index_get_ipv4(&index,
+						DHCP4_SERVERIDENTIFIER, &server_id);
+				ni_dhcp4_option_index_get_opaque(&index,
+						DHCP4_CLIENTID, &client_id);
+				break;
+
+			case BENCH_PARSE:
+				lease = NULL;
+				if (ni_dhcp4_parse_lease(&config, &index, &lease) < 0)
+					failures++;
+				ni_addrconf_lease_free(lease);
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct {
+		const char *	name;
+		bench_mode_t	mode;
+	} *b, benches[] = {
+		{ "index",	BENCH_INDEX	},
+		{ "filter",	BENCH_FILTER	},
+		{ "parse",	BENCH_PARSE	},
+		{ NULL }
+	};
+	unsigned int rounds = 10000, failures = 0, i;
+	ni_addrconf_lease_t *lease;
+	ni_dhcp4_device_t dev;
+	double start;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./dhcp4-bench [--rounds N] [--debug FACILITY] [file ...]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_ROUNDS:
+			if (ni_parse_uint(optarg, &rounds, 10) < 0 || !rounds)
+				goto usage;
+			break;
+		}
+	}
+	bench_device_init(&dev, &lease);
+	failures = bench_verify(&dev, lease);
+
+	start = bench_now();
+	failures += bench_build(&dev, lease, BENCH_BUILD, rounds);
+	bench_report("build", rounds * BENCH_MSGS, bench_now() - start);
+
+	start = bench_now();
+	failures += bench_build(&dev, lease, BENCH_TEMPLATE, rounds);
+	bench_report("template", rounds * BENCH_MSGS, bench_now() - start);
+
+	ni_dhcp4_device_set_config(&dev, NULL);
+	ni_addrconf_lease_free(lease);
+	printf("%u build failures\n", failures);
+	if (failures)
+		return 1;
+
+	for (; optind < argc; ++optind) {
+		if (load_corpus(argv[optind]) < 0)
+			return 1;
+	}
+	if (!npackets)
+		return 0;
+
+	for (b = benches; b->name; ++b) {
+		start = bench_now();
+		failures += bench_run(b->mode, rounds);
+		bench_report(b->name, npackets * rounds, bench_now() - start);
+	}
+
+	/* the corpus contains malformed packets on purpose */
+	printf("%u packets, %u rejected per round\n", npackets,
+			failures / (rounds * 3));
+
+	for (i = 0; i < npackets; ++i)
+		free(packets[i].data);
+	free(packets);
+	return 0;
+}
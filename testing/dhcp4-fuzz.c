@@ -0,0 +1,244 @@
+/*
+ * DHCP4 response parser fuzz target.
+ *
+ * LLVMFuzzerTestOneInput() feeds a raw DHCP4 message (starting with
+ * the BOOTP header) through the option indexer and lease parser.
+ * Build it with -DNI_LIBFUZZER and -fsanitize=fuzzer to use it with
+ * libFuzzer; the lines of the hex corpus files in testing/dhcp4 can
+ * be converted into seed files using `tr -d : | xxd -r -p`.
+ *
+ * Without libFuzzer, the packets in the given hex corpus files are
+ * replayed, printing the parsed lease of each, followed by a number
+ * of random mutations of each packet:
+ *
+ *	dhcp4-fuzz [--mutations N] [--seed N] [--debug FACILITY] file ...
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+#include <wicked/xml.h>
+
+#include "dhcp4/dhcp4.h"
+#include "dhcp4/protocol.h"
+#include "buffer.h"
+
+int	LLVMFuzzerTestOneInput(const uint8_t *, size_t);
+
+static ni_dhcp4_config_t	fuzz_config;
+
+static int
+fuzz_parse(unsigned char *data, size_t size, ni_addrconf_lease_t **leasep)
+{
+	ni_dhcp4_option_index_t index;
+	ni_dhcp4_message_t *message;
+	struct in_addr server_id;
+	ni_opaque_t client_id;
+	ni_buffer_t buf;
+
+	ni_buffer_init_reader(&buf, data, size);
+	if (!(message = ni_buffer_pull_head(&buf, sizeof(*message))))
+		return -1;
+
+	if (ni_dhcp4_option_index_build(&index, message, &buf) < 0)
+		return -1;
+
+	/* the checks done before a lease is decoded */
+	ni_dhcp4_option_index_get_ipv4(&index, DHCP4_SERVERIDENTIFIER, &server_id);
+	ni_dhcp4_option_index_get_opaque(&index, DHCP4_CLIENTID, &client_id);
+
+	return ni_dhcp4_parse_lease(&fuzz_config, &index, leasep);
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	ni_addrconf_lease_t *lease = NULL;
+	unsigned char *copy;
+	xml_node_t *xml;
+
+	/* an exact size copy, so any over-read is caught */
+	if (!(copy = malloc(size ? size : 1)))
+		return 0;
+	memcpy(copy, data, size);
+
+	if (fuzz_parse(copy, size, &lease) >= 0 && lease) {
+		if (ni_addrconf_lease_to_xml(lease, &xml, NULL) == 0)
+			xml_node_free(xml);
+		ni_addrconf_lease_free(lease);
+	}
+	free(copy);
+	return 0;
+}
+
+#ifndef NI_LIBFUZZER
+enum {
+	OPT_DEBUG,
+	OPT_MUTATIONS,
+	OPT_SEED,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "mutations",		required_argument,	NULL,	OPT_MUTATIONS },
+	{ "seed",		required_argument,	NULL,	OPT_SEED },
+
+	{ NULL }
+};
+
+static void
+replay_packet(const char *filename, unsigned int num, unsigned char *data, size_t size)
+{
+	ni_addrconf_lease_t *lease = NULL;
+	xml_node_t *xml = NULL;
+	int msg_type;
+
+	if ((msg_type = fuzz_parse(data, size, &lease)) < 0 || !lease) {
+		printf("%s:%u: rejected\n", filename, num);
+		return;
+	}
+
+	printf("%s:%u: %s\n", filename, num, ni_dhcp4_message_name(msg_type));
+
+	/* strip the time of the parse for a stable output */
+	lease->acquired.tv_sec = 0;
+	lease->acquired.tv_usec = 0;
+	if (ni_addrconf_lease_to_xml(lease, &xml, NULL) == 0) {
+		xml_node_print(xml, stdout);
+		xml_node_free(xml);
+	}
+	ni_addrconf_lease_free(lease);
+}
+
+static void
+mutate_packet(unsigned char *data, size_t *size)
+{
+	unsigned int n, edits = 1 + random() % 4;
+	size_t pos;
+
+	for (n = 0; n < edits && *size; ++n) {
+		/* prefer the options following the 240 byte header */
+		if (*size > sizeof(ni_dhcp4_message_t) && random() % 4)
+			pos = sizeof(ni_dhcp4_message_t) + random() %
+				(*size - sizeof(ni_dhcp4_message_t));
+		else
+			pos = random() % *size;
+
+		switch (random() % 4) {
+		case 0:
+			data[pos] ^= 1 << (random() % 8);
+			break;
+		case 1:
+			data[pos] = random();
+			break;
+		case 2:
+			/* option lengths are where it hurts */
+			data[pos] = random() % 2 ? 0xff : data[pos] + 1;
+			break;
+		case 3:
+			*size = pos;
+			break;
+		}
+	}
+}
+
+static int
+process_corpus(const char *filename, unsigned int mutations, unsigned int *count)
+{
+	static unsigned char packet[65536], data[65536];
+	char *line = NULL;
+	size_t size = 0, len;
+	unsigned int num = 0, m;
+	ssize_t ret;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		printf("%s: unable to open: %m\n", filename);
+		return -1;
+	}
+
+	while (getline(&line, &size, fp) > 0) {
+		num++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		if ((ret = ni_parse_hex_data(line, packet, sizeof(packet), ":")) < 0) {
+			printf("%s:%u: invalid hex data\n", filename, num);
+			continue;
+		}
+
+		len = ret;
+		memcpy(data, packet, len);
+		replay_packet(filename, num, data, len);
+		(*count)++;
+
+		for (m = 0; m < mutations; ++m) {
+			len = ret;
+			memcpy(data, packet, len);
+			mutate_packet(data, &len);
+			LLVMFuzzerTestOneInput(data, len);
+			(*count)++;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int mutations = 1000, seed = 1, count = 0;
+	int c, ret = 0;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./dhcp4-fuzz [--mutations N] [--seed N]"
+				" [--debug FACILITY] file ...\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_MUTATIONS:
+			if (ni_parse_uint(optarg, &mutations, 10) < 0)
+				goto usage;
+			break;
+
+		case OPT_SEED:
+			if (ni_parse_uint(optarg, &seed, 10) < 0)
+				goto usage;
+			break;
+		}
+	}
+	if (optind >= argc)
+		goto usage;
+
+	srandom(seed);
+	for (; optind < argc; ++optind) {
+		if (process_corpus(argv[optind], mutations, &count) < 0)
+			ret = 1;
+	}
+
+	fprintf(stderr, "%u packets processed\n", count);
+	return ret;
+}
+#endif
@@ -0,0 +1,244 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wicked/types.h>
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/ethtool.h>
+
+#include "kernel.h"
+
+/*
+ * Parse recorded ethtool generic netlink replies and print the
+ * resulting ethtool details per device.
+ *
+ * The record files contain one netlink message per line as hex
+ * string with ':' separator. Link modes have to be passed before
+ * link info, as the latter complements the link settings.
+ */
+typedef struct ethtool_nl_dev {
+	ni_netdev_ref_t		ref;
+	ni_ethtool_t *		ethtool;
+} ethtool_nl_dev_t;
+
+static ethtool_nl_dev_t *	devs;
+static unsigned int		ndevs;
+
+static ethtool_nl_dev_t *
+ethtool_nl_dev_get(const ni_netdev_ref_t *ref)
+{
+	ethtool_nl_dev_t *dev;
+	unsigned int i;
+
+	for (i = 0; i < ndevs; ++i) {
+		if (devs[i].ref.index == ref->index)
+			return &devs[i];
+	}
+
+	if (!(dev = realloc(devs, (ndevs + 1) * sizeof(*dev))))
+		ni_fatal("unable to allocate device");
+	devs = dev;
+
+	dev = &devs[ndevs++];
+	memset(dev, 0, sizeof(*dev));
+	ni_netdev_ref_set(&dev->ref, ref->name, ref->index);
+	if (!(dev->ethtool = ni_ethtool_new()))
+		ni_fatal("unable to allocate ethtool");
+	return dev;
+}
+
+static int
+ethtool_nl_dev_cmp(const void *a, const void *b)
+{
+	const ethtool_nl_dev_t *da = a;
+	const ethtool_nl_dev_t *db = b;
+
+	return (da->ref.index > db->ref.index) - (da->ref.index < db->ref.index);
+}
+
+static int
+process_record(const char *filename)
+{
+	static uint32_t buf[65536 / sizeof(uint32_t)];
+	ni_netdev_ref_t ref = { .name = NULL, .index = 0 };
+	char *line = NULL;
+	size_t size = 0;
+	unsigned int num = 0;
+	ssize_t len;
+	FILE *fp;
+	int ret = 0;
+
+	if (!(fp = fopen(filename, "r"))) {
+		printf("%s: unable to open: %m\n", filename);
+		return -1;
+	}
+
+	while ((len = getline(&line, &size, fp)) > 0) {
+		struct nlmsghdr *h = (struct nlmsghdr *)buf;
+		ethtool_nl_dev_t *dev;
+
+		num++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!*line || *line == '#')
+			continue;
+
+		len = ni_parse_hex_data(line, (unsigned char *)buf, sizeof(buf), ":");
+		if (len < (ssize_t)sizeof(*h) || h->nlmsg_len > (size_t)len) {
+			printf("%s:%u: invalid netlink message\n", filename, num);
+			ret = -1;
+			continue;
+		}
+
+		if (ni_ethtool_nl_reply_ref(h, &ref) < 0) {
+			printf("%s:%u: invalid ethtool reply header\n", filename, num);
+			ret = -1;
+			continue;
+		}
+
+		dev = ethtool_nl_dev_get(&ref);
+		if (ni_ethtool_nl_parse_reply(&dev->ref, dev->ethtool, h) < 0) {
+			printf("%s:%u: unable to parse ethtool reply\n", filename, num);
+			ret = -1;
+		}
+	}
+
+	ni_netdev_ref_destroy(&ref);
+	free(line);
+	fclose(fp);
+	return ret;
+}
+
+static void
+print_link_modes(const char *name, const ni_bitfield_t *bitfield, int8_t nwords)
+{
+	unsigned int bit, count = 0;
+
+	if (nwords <= 0)
+		return;
+
+	for (bit = 0; bit < nwords * 32U; ++bit) {
+		if (!ni_bitfield_testbit(bitfield, bit))
+			continue;
+		printf("%s%u", count++ ? " " : "    ", bit);
+	}
+	if (count)
+		printf(" %s\n", name);
+}
+
+static void
+print_ethtool(const ethtool_nl_dev_t *dev)
+{
+	const ni_ethtool_t *ethtool = dev->ethtool;
+	unsigned int i;
+
+	printf("%s[%u]:\n", dev->ref.name, dev->ref.index);
+
+	if (ethtool->link_settings) {
+		const ni_ethtool_link_settings_t *link = ethtool->link_settings;
+
+		printf("  link-settings: autoneg %s, speed %u, duplex %u, port %u\n",
+				ni_tristate_to_name(link->autoneg), link->speed,
+				link->duplex, link->port);
+		printf("    transceiver %u, phy-address %u, mdix %u, nwords %d\n",
+				link->transceiver, link->phy_address,
+				link->tp_mdix, link->nwords);
+		print_link_modes("supported", &link->supported, link->nwords);
+		print_link_modes("advertising", &link->advertising, link->nwords);
+		print_link_modes("lp-advertising", &link->lp_advertising, link->nwords);
+	}
+
+	if (ethtool->features) {
+		const ni_ethtool_features_t *features = ethtool->features;
+
+		printf("  features: %u of %u\n", features->count, features->total);
+		for (i = 0; i < features->count; ++i) {
+			const ni_ethtool_feature_t *feature = features->data[i];
+
+			if (!feature)
+				continue;
+
+			printf("    [%u] %s: %s%s\n", feature->index, feature->map.name,
+				feature->value & NI_ETHTOOL_FEATURE_ON ? "on" : "off",
+				feature->value & NI_ETHTOOL_FEATURE_FIXED ? " fixed" :
+				feature->value & NI_ETHTOOL_FEATURE_REQUESTED ? " requested" : "");
+		}
+	}
+
+	if (ethtool->ring) {
+		const ni_ethtool_ring_t *ring = ethtool->ring;
+
+		printf("  ring: tx %u, rx %u, rx-jumbo %u, rx-mini %u\n",
+				ring->tx, ring->rx, ring->rx_jumbo, ring->rx_mini);
+	}
+
+	if (ethtool->channels) {
+		const ni_ethtool_channels_t *channels = ethtool->channels;
+
+		printf("  channels: tx %u, rx %u, other %u, combined %u\n",
+				channels->tx, channels->rx,
+				channels->other, channels->combined);
+	}
+
+	if (ethtool->coalesce) {
+		const ni_ethtool_coalesce_t *coalesce = ethtool->coalesce;
+
+		printf("  coalesce: adaptive-tx %s, adaptive-rx %s\n",
+				ni_tristate_to_name(coalesce->adaptive_tx),
+				ni_tristate_to_name(coalesce->adaptive_rx));
+		printf("    pkt-rate-low %u, pkt-rate-high %u, sample-interval %u, stats-block-usecs %u\n",
+				coalesce->pkt_rate_low, coalesce->pkt_rate_high,
+				coalesce->sample_interval, coalesce->stats_block_usecs);
+		printf("    tx-usecs %u, irq %u, low %u, high %u\n",
+				coalesce->tx_usecs, coalesce->tx_usecs_irq,
+				coalesce->tx_usecs_low, coalesce->tx_usecs_high);
+		printf("    tx-frames %u, irq %u, low %u, high %u\n",
+				coalesce->tx_frames, coalesce->tx_frames_irq,
+				coalesce->tx_frames_low, coalesce->tx_frames_high);
+		printf("    rx-usecs %u, irq %u, low %u, high %u\n",
+				coalesce->rx_usecs, coalesce->rx_usecs_irq,
+				coalesce->rx_usecs_low, coalesce->rx_usecs_high);
+		printf("    rx-frames %u, irq %u, low %u, high %u\n",
+				coalesce->rx_frames, coalesce->rx_frames_irq,
+				coalesce->rx_frames_low, coalesce->rx_frames_high);
+	}
+
+	if (ethtool->pause) {
+		const ni_ethtool_pause_t *pause = ethtool->pause;
+
+		printf("  pause: tx %s, rx %s, autoneg %s\n",
+				ni_tristate_to_name(pause->tx),
+				ni_tristate_to_name(pause->rx),
+				ni_tristate_to_name(pause->autoneg));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (argc < 2) {
+		printf("Usage: ethtool-nl-test record-file ...\n");
+		return -2;
+	}
+
+	for (i = 1; i < (unsigned int)argc; ++i) {
+		if (process_record(argv[i]) < 0)
+			ret = 1;
+	}
+
+	qsort(devs, ndevs, sizeof(devs[0]), ethtool_nl_dev_cmp);
+	for (i = 0; i < ndevs; ++i) {
+		print_ethtool(&devs[i]);
+		ni_ethtool_free(devs[i].ethtool);
+		ni_netdev_ref_destroy(&devs[i].ref);
+	}
+	free(devs);
+
+	return ret;
+}
@@ -190,6 +190,18 @@ test_case2()
 	ni_json_free(json);
 }
 
+void
+test_case3()
+{
+	/* escaped unicode incl. a surrogate pair and invalid UTF-8 */
+	printf("#<-- j3:\n");
+	test_parse("{ \"\": \"caf\\u00e9 \\u20ac \\ud834\\udd1e\" }");
+	test_parse("\"\\udd1e\"");
+	test_parse("\"\xc3\x28\"");
+	test_parse("\"\xed\xa0\x80\"");
+	printf("\n");
+}
+
 int
 main(int argc, char **argv)
 {
@@ -198,6 +210,7 @@ main(int argc, char **argv)
 	if (argc == 1) {
 		test_case1();
 		test_case2();
+		test_case3();
 	}
 
 	for (n = 1; n < argc; ++n) {
@@ -0,0 +1,201 @@
+/*
+ * Lease file write-back fault injection test.
+ *
+ * A child process keeps rewriting the leases of a set of interfaces
+ * with an increasing sequence number in the hostname and gets killed
+ * with SIGKILL at a random time. Afterwards every lease file has to
+ * be complete and parseable and must not be older than the lease
+ * seen after the previous kill, i.e. a kill in the middle of a write
+ * leaves either the previous or the new lease behind.
+ *
+ *	leasefile-test [--iterations N] [--interfaces N] [--delay MSEC]
+ *	               [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include <wicked/netinfo.h>
+#include <wicked/addrconf.h>
+
+#include "appconfig.h"
+
+extern ni_global_t ni_global;
+
+enum {
+	OPT_DEBUG,
+	OPT_ITERATIONS,
+	OPT_INTERFACES,
+	OPT_DELAY,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "iterations",		required_argument,	NULL,	OPT_ITERATIONS },
+	{ "interfaces",		required_argument,	NULL,	OPT_INTERFACES },
+	{ "delay",		required_argument,	NULL,	OPT_DELAY },
+
+	{ NULL }
+};
+
+static void
+lease_writer(unsigned int interfaces, unsigned long seq)
+{
+	ni_addrconf_lease_t *lease;
+	char ifname[IFNAMSIZ];
+	unsigned int i;
+
+	for (;; ++seq) {
+		for (i = 0; i < interfaces; ++i) {
+			if (!(lease = ni_addrconf_lease_new(NI_ADDRCONF_STATIC, AF_INET)))
+				_exit(2);
+
+			lease->state = NI_ADDRCONF_STATE_GRANTED;
+			lease->acquired.tv_sec = seq;
+			ni_string_printf(&lease->hostname, "seq-%lu", seq);
+
+			snprintf(ifname, sizeof(ifname), "test%u", i);
+			ni_addrconf_lease_file_write(ifname, lease);
+			ni_addrconf_lease_free(lease);
+		}
+		/* run the write-back timer */
+		ni_timer_next_timeout();
+	}
+}
+
+static unsigned int
+lease_check(unsigned int interfaces, unsigned long *seen)
+{
+	ni_addrconf_lease_t *lease;
+	char ifname[IFNAMSIZ];
+	unsigned int i, failures = 0;
+	unsigned long seq;
+
+	for (i = 0; i < interfaces; ++i) {
+		snprintf(ifname, sizeof(ifname), "test%u", i);
+
+		if (!ni_addrconf_lease_file_exists(ifname, NI_ADDRCONF_STATIC, AF_INET)) {
+			if (seen[i]) {
+				printf("%s: lease seq-%lu lost\n", ifname, seen[i]);
+				failures++;
+			}
+			continue;
+		}
+
+		lease = ni_addrconf_lease_file_read(ifname, NI_ADDRCONF_STATIC, AF_INET);
+		if (!lease || !lease->hostname ||
+		    sscanf(lease->hostname, "seq-%lu", &seq) != 1) {
+			printf("%s: incomplete or invalid lease file\n", ifname);
+			ni_addrconf_lease_free(lease);
+			failures++;
+			continue;
+		}
+		ni_addrconf_lease_free(lease);
+
+		if (seq < seen[i]) {
+			printf("%s: lease seq-%lu is older than seq-%lu\n",
+					ifname, seq, seen[i]);
+			failures++;
+		}
+		seen[i] = seq;
+	}
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int iterations = 50, interfaces = 16, delay = 0;
+	char template[] = "/tmp/leasefile-test.XXXXXX";
+	char storedir[PATH_MAX], statedir[PATH_MAX];
+	unsigned int n, failures = 0;
+	unsigned long *seen;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./leasefile-test [--iterations N] [--interfaces N]"
+				" [--delay MSEC] [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_ITERATIONS:
+			if (ni_parse_uint(optarg, &iterations, 10) < 0 || !iterations)
+				goto usage;
+			break;
+
+		case OPT_INTERFACES:
+			if (ni_parse_uint(optarg, &interfaces, 10) < 0 || !interfaces)
+				goto usage;
+			break;
+
+		case OPT_DELAY:
+			if (ni_parse_uint(optarg, &delay, 10) < 0)
+				goto usage;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	snprintf(storedir, sizeof(storedir), "%s/store", template);
+	snprintf(statedir, sizeof(statedir), "%s/state", template);
+
+	ni_global.config = ni_config_new();
+	ni_string_dup(&ni_global.config->storedir.path, storedir);
+	ni_string_dup(&ni_global.config->statedir.path, statedir);
+	ni_global.config->addrconf.lease_write_delay = delay;
+	ni_config_storedir();
+	ni_config_statedir();
+
+	if (!(seen = calloc(interfaces, sizeof(*seen))))
+		ni_fatal("Cannot allocate sequence array");
+
+	srandom(getpid());
+	for (n = 0; n < iterations; ++n) {
+		pid_t pid;
+
+		if ((pid = fork()) < 0)
+			ni_fatal("Cannot fork writer: %m");
+
+		if (pid == 0)
+			lease_writer(interfaces, (n + 1) * 1000000UL);
+
+		usleep(1000 + random() % 20000);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+
+		failures += lease_check(interfaces, seen);
+	}
+
+	printf("%u iterations, %u interfaces, %u ms write delay: %u failures\n",
+			iterations, interfaces, delay, failures);
+
+	ni_file_remove_recursively(template);
+	free(seen);
+	ni_config_free(ni_global.config);
+	return failures ? 1 : 0;
+}
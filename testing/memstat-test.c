@@ -0,0 +1,242 @@
+/*
+ * Memory accounting test.
+ *
+ * Creates and frees the netdev, route, xml, dbus-variant, lease and
+ * timer objects and checks that their tag counters follow the live
+ * objects and return to the start values, that the sample ring keeps
+ * the configured number of samples in the configured interval, and
+ * prints the cost of the accounting per allocation.
+ *
+ *	memstat-test [--count N]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/route.h>
+#include <wicked/addrconf.h>
+#include <wicked/socket.h>
+#include <wicked/xml.h>
+#include <wicked/dbus.h>
+#include "dbus-common.h"
+#include "appconfig.h"
+#include "memstat.h"
+#include "test-util.h"
+
+#define TEST_OBJECTS		100
+
+enum {
+	OPT_COUNT,
+};
+
+static struct option	options[] = {
+	{ "count",	required_argument,	NULL,	OPT_COUNT },
+	{ NULL }
+};
+
+static ni_bool_t
+check_tag(ni_memstat_tag_t tag, const ni_memstat_t *start, uint64_t objects, size_t size)
+{
+	const ni_memstat_t *stat = &ni_memstat_tags[tag];
+
+	if (stat->objects != start->objects + objects)
+		return FALSE;
+	if (stat->bytes < start->bytes + objects * size)
+		return FALSE;
+	return objects || stat->bytes == start->bytes;
+}
+
+static double
+test_elapsed_ns(const struct timespec *begin, unsigned int count)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - begin->tv_sec) * 1e9 +
+		(now.tv_nsec - begin->tv_nsec)) / count;
+}
+
+static void
+timer_expired(void *user_data, const ni_timer_t *timer)
+{
+	(*(unsigned int *)user_data)++;
+}
+
+static void
+check_objects(void)
+{
+	ni_memstat_t start[NI_MEMSTAT_TAGS];
+	ni_netdev_t *devs[TEST_OBJECTS];
+	ni_route_t *routes[TEST_OBJECTS];
+	ni_addrconf_lease_t *leases[TEST_OBJECTS];
+	const ni_timer_t *timers[TEST_OBJECTS];
+	ni_dbus_variant_t dict = NI_DBUS_VARIANT_INIT;
+	xml_document_t *doc;
+	unsigned int i, expired = 0;
+	char name[32];
+
+	memcpy(start, ni_memstat_tags, sizeof(start));
+
+	for (i = 0; i < TEST_OBJECTS; ++i) {
+		snprintf(name, sizeof(name), "eth%u", i);
+		devs[i] = ni_netdev_new(name, i + 1);
+		routes[i] = ni_route_new();
+		leases[i] = ni_addrconf_lease_new(NI_ADDRCONF_DHCP, AF_INET);
+		timers[i] = ni_timer_register(i < TEST_OBJECTS / 2 ? 0 : 60000,
+				timer_expired, &expired);
+	}
+	check(check_tag(NI_MEMSTAT_NETDEV, &start[NI_MEMSTAT_NETDEV], TEST_OBJECTS, sizeof(ni_netdev_t)),
+			"netdevs accounted");
+	check(check_tag(NI_MEMSTAT_ROUTE, &start[NI_MEMSTAT_ROUTE], TEST_OBJECTS, sizeof(ni_route_t)),
+			"routes accounted");
+	check(check_tag(NI_MEMSTAT_LEASE, &start[NI_MEMSTAT_LEASE], TEST_OBJECTS, sizeof(ni_addrconf_lease_t)),
+			"leases accounted");
+	check(ni_memstat_tags[NI_MEMSTAT_TIMER].objects == start[NI_MEMSTAT_TIMER].objects + TEST_OBJECTS,
+			"timers accounted");
+
+	/* a reference does not allocate, the last put frees */
+	ni_netdev_get(devs[0]);
+	ni_netdev_put(devs[0]);
+	ni_route_ref(routes[0]);
+	ni_route_free(routes[0]);
+	check(check_tag(NI_MEMSTAT_NETDEV, &start[NI_MEMSTAT_NETDEV], TEST_OBJECTS, sizeof(ni_netdev_t)) &&
+	      check_tag(NI_MEMSTAT_ROUTE, &start[NI_MEMSTAT_ROUTE], TEST_OBJECTS, sizeof(ni_route_t)),
+			"references not accounted");
+
+	/* expire the first half of the timers, cancel the others */
+	ni_timer_next_timeout();
+	for (i = TEST_OBJECTS / 2; i < TEST_OBJECTS; ++i)
+		ni_timer_cancel(timers[i]);
+	check(expired == TEST_OBJECTS / 2 &&
+	      check_tag(NI_MEMSTAT_TIMER, &start[NI_MEMSTAT_TIMER], 0, 0),
+			"expired and cancelled timers released");
+
+	for (i = 0; i < TEST_OBJECTS; ++i) {
+		ni_netdev_put(devs[i]);
+		ni_route_free(routes[i]);
+		ni_addrconf_lease_free(leases[i]);
+	}
+	check(check_tag(NI_MEMSTAT_NETDEV, &start[NI_MEMSTAT_NETDEV], 0, 0) &&
+	      check_tag(NI_MEMSTAT_ROUTE, &start[NI_MEMSTAT_ROUTE], 0, 0) &&
+	      check_tag(NI_MEMSTAT_LEASE, &start[NI_MEMSTAT_LEASE], 0, 0),
+			"netdevs, routes and leases released");
+
+	doc = xml_document_new();
+	for (i = 0; i < TEST_OBJECTS; ++i)
+		xml_node_new_element("node", doc->root, "data");
+	check(check_tag(NI_MEMSTAT_XML, &start[NI_MEMSTAT_XML], TEST_OBJECTS + 1, sizeof(xml_node_t)),
+			"xml nodes accounted");
+	xml_document_free(doc);
+	check(check_tag(NI_MEMSTAT_XML, &start[NI_MEMSTAT_XML], 0, 0), "xml nodes released");
+
+	/* the dict entry array grows in chunks, one allocation at a time */
+	ni_dbus_variant_init_dict(&dict);
+	for (i = 0; i < TEST_OBJECTS; ++i) {
+		snprintf(name, sizeof(name), "key%u", i);
+		ni_dbus_dict_add_uint32(&dict, name, i);
+	}
+	check(ni_memstat_tags[NI_MEMSTAT_DBUS_VARIANT].objects == start[NI_MEMSTAT_DBUS_VARIANT].objects + 1 &&
+	      ni_memstat_tags[NI_MEMSTAT_DBUS_VARIANT].bytes >= start[NI_MEMSTAT_DBUS_VARIANT].bytes +
+			TEST_OBJECTS * sizeof(ni_dbus_dict_entry_t),
+			"dbus variant arrays accounted");
+	ni_dbus_variant_destroy(&dict);
+	check(check_tag(NI_MEMSTAT_DBUS_VARIANT, &start[NI_MEMSTAT_DBUS_VARIANT], 0, 0),
+			"dbus variant arrays released");
+}
+
+static void
+check_samples(void)
+{
+	ni_config_memory_stats_t *conf = &ni_global.config->memory_stats;
+	const ni_memstat_sample_t *sample;
+	struct timespec now = { .tv_sec = 1000 };
+	ni_route_t *rp;
+	unsigned int i;
+
+	conf->interval = 10;
+	conf->samples = 3;
+
+	/* 5 samples in 50 seconds, checked every second */
+	for (i = 0; i < 50; ++i, now.tv_sec++)
+		ni_memstat_tick(&now);
+	for (i = 0; ni_memstat_sample(i); ++i)
+		;
+	check(i == conf->samples, "sample ring keeps the configured samples");
+
+	rp = ni_route_new();
+	ni_memstat_tick(&now);
+	sample = ni_memstat_sample(conf->samples - 1);
+	check(sample && sample->objects[NI_MEMSTAT_ROUTE] ==
+			ni_memstat_sample(conf->samples - 2)->objects[NI_MEMSTAT_ROUTE] + 1,
+			"newest sample is the last one");
+	ni_route_free(rp);
+}
+
+static void
+bench(unsigned int count)
+{
+	struct timespec begin;
+	ni_route_t **routes;
+	unsigned int i;
+
+	routes = calloc(count, sizeof(*routes));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < count; ++i)
+		routes[i] = ni_route_new();
+	for (i = 0; i < count; ++i)
+		ni_route_free(routes[i]);
+	printf("route new+free: %.1f ns\n", test_elapsed_ns(&begin, count));
+
+	for (i = 0; i < count; ++i)
+		routes[i] = ni_route_new();
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < count; ++i) {
+		ni_memstat_alloc(NI_MEMSTAT_ROUTE, routes[i]);
+		ni_memstat_free(NI_MEMSTAT_ROUTE, routes[i]);
+	}
+	printf("accounting per alloc+free: %.1f ns\n", test_elapsed_ns(&begin, count));
+	for (i = 0; i < count; ++i)
+		ni_route_free(routes[i]);
+	free(routes);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int count = 1000000;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./memstat-test [--count N]\n");
+			return 1;
+
+		case OPT_COUNT:
+			if (ni_parse_uint(optarg, &count, 10) < 0 || !count)
+				goto usage;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("memstat-test") < 0)
+		return 1;
+
+	check_objects();
+	check_samples();
+	bench(count);
+
+	return test_summary();
+}
@@ -0,0 +1,571 @@
+/*
+ * Shared netconfig state test.
+ *
+ * Runs the wickedd side of the netconfig state service in a child
+ * process (this program, re-executed with --server), which publishes
+ * a netconfig built from the commands the test writes to its stdin.
+ * The supplicant side connects through a second child (--proxy), which
+ * forwards the snapshot descriptor and the event stream and can drop
+ * one event message on request.
+ *
+ * Checks that the client applies the initial snapshot and the link and
+ * address events, that a lost event message makes it resync from a new
+ * snapshot, and that it reconnects and syncs when the server restarts.
+ *
+ *	netshare-test [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/address.h>
+#include <wicked/socket.h>
+
+#include "netinfo_priv.h"
+#include "socket_priv.h"
+#include "appconfig.h"
+#include "netshare.h"
+#include "test-util.h"
+
+#define TEST_TIMEOUT		10	/* sec */
+#define TEST_PROXY_BUFSIZE	65536
+
+enum {
+	OPT_DEBUG,
+	OPT_SERVER,
+	OPT_PROXY,
+	OPT_UPSTREAM,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "server",		required_argument,	NULL,	OPT_SERVER },
+	{ "proxy",		required_argument,	NULL,	OPT_PROXY },
+	{ "upstream",		required_argument,	NULL,	OPT_UPSTREAM },
+
+	{ NULL }
+};
+
+static void
+test_socket_path(char *path, size_t size, const char *dir)
+{
+	snprintf(path, size, "%s/%s", dir, NI_NETSHARE_SOCKET_NAME);
+}
+
+/*
+ * wickedd side: a netconfig changed by the commands on stdin
+ *
+ *	link <name> <index>		create a link
+ *	dellink <index>			delete a link
+ *	addr <index> <addr/len>		add an address
+ *	deladdr <index> <addr/len>	delete an address
+ *	listen				start serving, reply on stdout
+ */
+static void
+test_server_command(char *line)
+{
+	ni_netconfig_t *nc = ni_global_state_handle(0);
+	char *cmd, *arg1, *arg2;
+	unsigned int index = 0, plen;
+	ni_sockaddr_t addr;
+	ni_address_t *ap;
+	ni_netdev_t *dev;
+
+	cmd  = strtok(line, " \t");
+	arg1 = strtok(NULL, " \t");
+	arg2 = strtok(NULL, " \t");
+	if (!cmd)
+		return;
+
+	if (!strcmp(cmd, "listen")) {
+		if (!ni_netshare_server_open() || write(STDOUT_FILENO, "", 1) != 1)
+			exit(1);
+		return;
+	}
+
+	if (!strcmp(cmd, "link")) {
+		if (!arg1 || !arg2 || ni_parse_uint(arg2, &index, 10) < 0)
+			exit(2);
+		if ((dev = ni_netdev_by_index(nc, index)))
+			return;
+		dev = ni_netdev_new(arg1, index);
+		dev->link.type = NI_IFTYPE_ETHERNET;
+		dev->link.ifflags = NI_IFF_DEVICE_READY | NI_IFF_DEVICE_UP |
+			NI_IFF_LINK_UP | NI_IFF_NETWORK_UP;
+		ni_netconfig_device_append(nc, dev);
+		ni_netshare_server_netdev_event(dev, NI_EVENT_DEVICE_CREATE);
+		return;
+	}
+
+	if (!arg1 || ni_parse_uint(arg1, &index, 10) < 0 ||
+	    !(dev = ni_netdev_by_index(nc, index)))
+		exit(2);
+
+	if (!strcmp(cmd, "dellink")) {
+		dev->link.ifflags = 0;
+		ni_netshare_server_netdev_event(dev, NI_EVENT_DEVICE_DELETE);
+		ni_netconfig_device_remove(nc, dev);
+		return;
+	}
+
+	if (!arg2 || !ni_sockaddr_prefix_parse(arg2, &addr, &plen))
+		exit(2);
+
+	if (!strcmp(cmd, "addr")) {
+		if (!(ap = ni_address_new(addr.ss_family, plen, &addr, &dev->addrs)))
+			exit(1);
+		ni_netshare_server_addr_event(dev, NI_EVENT_ADDRESS_UPDATE, ap);
+	} else
+	if (!strcmp(cmd, "deladdr")) {
+		if (!(ap = ni_address_list_find(dev->addrs, &addr)))
+			exit(2);
+		ni_netshare_server_addr_event(dev, NI_EVENT_ADDRESS_DELETE, ap);
+		__ni_address_list_remove(&dev->addrs, ap);
+	} else
+		exit(2);
+}
+
+static void
+test_server_recv(ni_socket_t *sock)
+{
+	static char buf[4096];
+	static size_t used;
+	char *line, *end;
+	ssize_t len;
+
+	len = read(sock->__fd, buf + used, sizeof(buf) - used - 1);
+	if (len <= 0)
+		exit(0);
+	used += len;
+	buf[used] = '\0';
+
+	for (line = buf; (end = strchr(line, '\n')); line = end + 1) {
+		*end = '\0';
+		test_server_command(line);
+	}
+	used -= line - buf;
+	memmove(buf, line, used);
+}
+
+static int
+test_server(const char *dir)
+{
+	ni_socket_t *sock;
+
+	ni_string_dup(&ni_global.config->statedir.path, dir);
+	if (!(sock = ni_socket_wrap(STDIN_FILENO, SOCK_STREAM)))
+		return 1;
+	sock->receive = test_server_recv;
+	ni_socket_activate(sock);
+
+	while (1)
+		ni_socket_wait(ni_timer_next_timeout());
+	return 0;
+}
+
+/*
+ * A proxy between the client and the server socket; "drop" on stdin
+ * drops the next event message, confirmed by a byte on stdout.
+ */
+static ni_bool_t
+test_proxy_sockaddr(struct sockaddr_un *sun, const char *path)
+{
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun->sun_path))
+		return FALSE;
+	strcpy(sun->sun_path, path);
+	return TRUE;
+}
+
+static int
+test_proxy_listen(const char *path)
+{
+	struct sockaddr_un sun;
+	int fd;
+
+	if (!test_proxy_sockaddr(&sun, path))
+		return -1;
+
+	unlink(path);
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0 ||
+	    bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 || listen(fd, 4) < 0)
+		return -1;
+	return fd;
+}
+
+static int
+test_proxy_connect(const char *path)
+{
+	struct sockaddr_un sun;
+	int fd;
+
+	if (!test_proxy_sockaddr(&sun, path))
+		return -1;
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* forward one message with the descriptor it carries, or drop it */
+static ni_bool_t
+test_proxy_forward(int from, int to, ni_bool_t *drop)
+{
+	static char buf[TEST_PROXY_BUFSIZE];
+	unsigned char cbuf[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr *cm;
+	struct msghdr mh;
+	struct iovec iov;
+	ssize_t len;
+	int fd = -1;
+	ni_bool_t ok;
+
+	memset(&mh, 0, sizeof(mh));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = cbuf;
+	mh.msg_controllen = sizeof(cbuf);
+
+	if ((len = recvmsg(from, &mh, MSG_CMSG_CLOEXEC)) <= 0)
+		return FALSE;
+	for (cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+			memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+	}
+	if (drop && *drop) {
+		*drop = FALSE;
+		if (fd >= 0)
+			close(fd);
+		return TRUE;
+	}
+
+	iov.iov_len = len;
+	if (fd < 0) {
+		mh.msg_control = NULL;
+		mh.msg_controllen = 0;
+	}
+	ok = sendmsg(to, &mh, MSG_NOSIGNAL) == len;
+	if (fd >= 0)
+		close(fd);
+	return ok;
+}
+
+static int
+test_proxy(const char *dir, const char *upstream_dir)
+{
+	char path[PATH_MAX], upstream[PATH_MAX], cmd[64];
+	int listener, down = -1, up = -1;
+	ni_bool_t drop = FALSE;
+	struct pollfd pfd[4];
+	ssize_t len;
+
+	test_socket_path(path, sizeof(path), dir);
+	test_socket_path(upstream, sizeof(upstream), upstream_dir);
+	if ((listener = test_proxy_listen(path)) < 0)
+		return 1;
+	if (write(STDOUT_FILENO, "", 1) != 1)
+		return 1;
+
+	while (1) {
+		pfd[0].fd = STDIN_FILENO;
+		pfd[1].fd = listener;
+		pfd[2].fd = up;
+		pfd[3].fd = down;
+		pfd[0].events = pfd[1].events = pfd[2].events = pfd[3].events = POLLIN;
+		if (poll(pfd, 4, -1) < 0 && errno != EINTR)
+			return 1;
+
+		if (pfd[0].revents) {
+			if ((len = read(STDIN_FILENO, cmd, sizeof(cmd))) <= 0)
+				return 0;
+			drop = TRUE;
+			if (write(STDOUT_FILENO, "", 1) != 1)
+				return 1;
+		}
+
+		if (pfd[1].revents & POLLIN) {
+			if (down >= 0)
+				close(down);
+			if (up >= 0)
+				close(up);
+			down = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+			if ((up = test_proxy_connect(upstream)) < 0 && down >= 0) {
+				close(down);
+				down = -1;
+			}
+			continue;
+		}
+
+		if ((pfd[2].revents && !test_proxy_forward(up, down, &drop)) ||
+		    (pfd[3].revents && !test_proxy_forward(down, up, NULL))) {
+			close(down);
+			close(up);
+			down = up = -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Child processes
+ */
+typedef struct test_child {
+	pid_t			pid;
+	int			in;
+	int			out;
+} test_child_t;
+
+static void
+test_child_start(test_child_t *child, const char *opt, const char *arg,
+		const char *opt2, const char *arg2)
+{
+	int ipfd[2], opfd[2];
+
+	if (pipe(ipfd) < 0 || pipe(opfd) < 0)
+		ni_fatal("Cannot create pipe: %m");
+	if ((child->pid = fork()) < 0)
+		ni_fatal("Cannot fork: %m");
+	if (child->pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		dup2(ipfd[0], STDIN_FILENO);
+		dup2(opfd[1], STDOUT_FILENO);
+		close(ipfd[0]);
+		close(ipfd[1]);
+		close(opfd[0]);
+		close(opfd[1]);
+		execl("/proc/self/exe", "netshare-test", opt, arg, opt2, arg2, NULL);
+		_exit(127);
+	}
+	close(ipfd[0]);
+	close(opfd[1]);
+	child->in = ipfd[1];
+	child->out = opfd[0];
+}
+
+static void
+test_child_stop(test_child_t *child)
+{
+	close(child->in);
+	close(child->out);
+	kill(child->pid, SIGTERM);
+	waitpid(child->pid, NULL, 0);
+	child->pid = 0;
+}
+
+static void
+test_child_send(test_child_t *child, const char *cmd)
+{
+	if (write(child->in, cmd, strlen(cmd)) != (ssize_t)strlen(cmd))
+		ni_fatal("Cannot send command to child %d: %m", (int)child->pid);
+}
+
+static void
+test_child_reply(test_child_t *child)
+{
+	char ready;
+
+	if (read(child->out, &ready, 1) != 1)
+		ni_fatal("Child %d did not reply", (int)child->pid);
+}
+
+/*
+ * supplicant side
+ */
+static unsigned int	test_addr_updates;
+static unsigned int	test_addr_deletes;
+static unsigned int	test_link_deletes;
+
+static void
+test_link_event(ni_netdev_t *dev, ni_event_t event)
+{
+	if (event == NI_EVENT_DEVICE_DELETE)
+		test_link_deletes++;
+}
+
+static void
+test_addr_event(ni_netdev_t *dev, ni_event_t event, const ni_address_t *ap)
+{
+	if (event == NI_EVENT_ADDRESS_UPDATE)
+		test_addr_updates++;
+	else
+	if (event == NI_EVENT_ADDRESS_DELETE)
+		test_addr_deletes++;
+}
+
+static ni_bool_t
+test_has_link(unsigned int index)
+{
+	return ni_netdev_by_index(ni_global_state_handle(0), index) != NULL;
+}
+
+static ni_bool_t
+test_has_addr(unsigned int index, const char *prefix)
+{
+	ni_netdev_t *dev;
+	ni_address_t *ap;
+	ni_sockaddr_t addr;
+	unsigned int plen;
+
+	if (!(dev = ni_netdev_by_index(ni_global_state_handle(0), index)) ||
+	    !ni_sockaddr_prefix_parse(prefix, &addr, &plen))
+		return FALSE;
+	ap = ni_address_list_find(dev->addrs, &addr);
+	return ap && ap->prefixlen == plen;
+}
+
+/* run the event loop until the condition holds */
+#define test_wait(cond)		({ \
+	time_t __deadline = time(NULL) + TEST_TIMEOUT; \
+	while (!(cond) && time(NULL) < __deadline) { \
+		long __timeout = ni_timer_next_timeout(); \
+		ni_socket_wait(__timeout < 0 || __timeout > 100 ? 100 : __timeout); \
+	} \
+	(cond); })
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/netshare-test.XXXXXX";
+	char server_dir[PATH_MAX], client_dir[PATH_MAX];
+	const char *opt_server = NULL, *opt_proxy = NULL, *opt_upstream = NULL;
+	test_child_t server, proxy;
+	unsigned int updates, deletes;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./netshare-test [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_SERVER:
+			opt_server = optarg;
+			break;
+
+		case OPT_PROXY:
+			opt_proxy = optarg;
+			break;
+
+		case OPT_UPSTREAM:
+			opt_upstream = optarg;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (opt_proxy)
+		return test_proxy(opt_proxy, opt_upstream);
+
+	if (ni_init("netshare-test") < 0)
+		return 1;
+
+	if (opt_server)
+		return test_server(opt_server);
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	snprintf(server_dir, sizeof(server_dir), "%s/server", template);
+	snprintf(client_dir, sizeof(client_dir), "%s/client", template);
+	if (ni_mkdir_maybe(server_dir, 0700) < 0 || ni_mkdir_maybe(client_dir, 0700) < 0)
+		ni_fatal("Cannot create state directories: %m");
+	ni_string_dup(&ni_global.config->statedir.path, client_dir);
+
+	test_child_start(&server, "--server", server_dir, NULL, NULL);
+	test_child_send(&server,
+			"link ns0 10\n"
+			"link ns1 11\n"
+			"addr 10 192.0.2.1/24\n"
+			"addr 11 2001:db8::1/64\n"
+			"listen\n");
+	test_child_reply(&server);
+	test_child_start(&proxy, "--proxy", client_dir, "--upstream", server_dir);
+	test_child_reply(&proxy);
+
+	/* initial snapshot */
+	check(ni_netshare_client_open(), "client connects");
+	check(test_has_link(10) && test_has_link(11) &&
+	      test_has_addr(10, "192.0.2.1/24") && test_has_addr(11, "2001:db8::1/64"),
+			"client applies the initial snapshot");
+	if (ni_server_listen_interface_events(test_link_event) < 0 ||
+	    ni_server_enable_interface_addr_events(test_addr_event) < 0)
+		ni_fatal("Cannot set the event handlers");
+
+	/* incremental events */
+	test_child_send(&server, "addr 10 192.0.2.2/24\n");
+	check(test_wait(test_has_addr(10, "192.0.2.2/24")) && test_addr_updates == 1,
+			"client applies an address event");
+	test_child_send(&server, "deladdr 11 2001:db8::1/64\n");
+	check(test_wait(!test_has_addr(11, "2001:db8::1/64")) && test_addr_deletes == 1,
+			"client applies an address delete event");
+	test_child_send(&server, "link ns2 12\ndellink 11\n");
+	check(test_wait(test_has_link(12) && !test_has_link(11)) && test_link_deletes == 1,
+			"client applies link events");
+
+	/* a lost event message: only the resync brings 192.0.2.3 */
+	test_child_send(&proxy, "drop\n");
+	test_child_reply(&proxy);
+	updates = test_addr_updates;
+	test_child_send(&server, "addr 10 192.0.2.3/24\naddr 10 192.0.2.4/24\n");
+	check(test_wait(test_has_addr(10, "192.0.2.3/24") && test_has_addr(10, "192.0.2.4/24")) &&
+	      test_addr_updates == updates + 2,
+			"client resyncs after a sequence gap");
+
+	/* a restarted server with another state */
+	test_child_stop(&server);
+	deletes = test_addr_deletes;
+	test_child_start(&server, "--server", server_dir, NULL, NULL);
+	test_child_send(&server,
+			"link ns0 10\n"
+			"link ns3 13\n"
+			"addr 10 198.51.100.1/24\n"
+			"listen\n");
+	test_child_reply(&server);
+	check(test_wait(test_has_addr(10, "198.51.100.1/24") && test_has_link(13)) &&
+	      !test_has_addr(10, "192.0.2.1/24") && !test_has_link(12) &&
+	      test_addr_deletes > deletes,
+			"client reconnects and syncs to a restarted server");
+	test_child_send(&server, "addr 13 198.51.100.2/24\n");
+	check(test_wait(test_has_addr(13, "198.51.100.2/24")),
+			"client applies events after the reconnect");
+
+	ni_netshare_client_close();
+	test_child_stop(&proxy);
+	test_child_stop(&server);
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}
@@ -0,0 +1,949 @@
+/*
+ * OVSDB client test.
+ *
+ * Runs a small stand-in ovsdb-server in a child process, that speaks
+ * the subset of RFC 7047 used by the client over a unix socket: the
+ * monitor, echo and transact methods with insert and mutate operations
+ * on the Open_vSwitch, Bridge, Port and Interface tables, including the
+ * garbage collection of unreferenced rows and the "update" notifications
+ * sent to all monitoring clients before the transaction reply.
+ *
+ * Checks the bridge, fake (vlan) bridge and port queries on a seeded
+ * database, the bridge and port add and delete transactions and that
+ * the changes of another client appear in the monitor cache.
+ *
+ *	ovsdb-test [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+
+#include "ovsdb.h"
+#include "json.h"
+#include "util_priv.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+
+	{ NULL }
+};
+
+/*
+ * stand-in ovsdb-server
+ */
+#define MOCK_ROWS_MAX		256
+#define MOCK_CLIENTS_MAX	8
+
+enum {
+	MOCK_BRIDGE,
+	MOCK_PORT,
+	MOCK_INTERFACE,
+};
+
+static const char *	mock_tables[] = { "Bridge", "Port", "Interface", NULL };
+
+typedef struct mock_row {
+	char			uuid[40];
+	unsigned int		table;
+	char *			name;
+	ni_string_array_t	refs;		/* bridge: ports, port: interfaces */
+	unsigned int		tag;
+	ni_bool_t		fake_bridge;
+} mock_row_t;
+
+typedef struct mock_db {
+	ni_string_array_t	bridges;	/* the Open_vSwitch root row */
+	unsigned int		count;
+	mock_row_t *		rows[MOCK_ROWS_MAX];
+} mock_db_t;
+
+typedef struct mock_client {
+	int			fd;
+	ni_stringbuf_t		input;
+	ni_json_t *		monitor;
+} mock_client_t;
+
+static unsigned int		mock_uuid_seq;
+
+static int
+mock_table_index(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; mock_tables[i]; ++i) {
+		if (ni_string_eq(mock_tables[i], name))
+			return i;
+	}
+	return -1;
+}
+
+static mock_row_t *
+mock_row_new(mock_db_t *db, unsigned int table, const char *name)
+{
+	mock_row_t *row;
+
+	if (db->count >= MOCK_ROWS_MAX)
+		return NULL;
+
+	row = xcalloc(1, sizeof(*row));
+	snprintf(row->uuid, sizeof(row->uuid), "%08x-0000-4000-8000-%012x",
+			++mock_uuid_seq, table);
+	row->table = table;
+	ni_string_dup(&row->name, name);
+	db->rows[db->count++] = row;
+	return row;
+}
+
+static void
+mock_row_free(mock_row_t *row)
+{
+	ni_string_free(&row->name);
+	ni_string_array_destroy(&row->refs);
+	free(row);
+}
+
+static mock_row_t *
+mock_db_find(const mock_db_t *db, const char *uuid)
+{
+	unsigned int i;
+
+	for (i = 0; i < db->count; ++i) {
+		if (ni_string_eq(db->rows[i]->uuid, uuid))
+			return db->rows[i];
+	}
+	return NULL;
+}
+
+static void
+mock_db_copy(mock_db_t *dst, const mock_db_t *src)
+{
+	mock_row_t *row;
+	unsigned int i;
+
+	memset(dst, 0, sizeof(*dst));
+	ni_string_array_copy(&dst->bridges, &src->bridges);
+	for (i = 0; i < src->count; ++i) {
+		row = xcalloc(1, sizeof(*row));
+		*row = *src->rows[i];
+		row->name = NULL;
+		ni_string_dup(&row->name, src->rows[i]->name);
+		ni_string_array_init(&row->refs);
+		ni_string_array_copy(&row->refs, &src->rows[i]->refs);
+		dst->rows[dst->count++] = row;
+	}
+}
+
+static void
+mock_db_destroy(mock_db_t *db)
+{
+	while (db->count)
+		mock_row_free(db->rows[--db->count]);
+	ni_string_array_destroy(&db->bridges);
+}
+
+/* drops the bridges, ports and interfaces not referenced any more */
+static void
+mock_db_gc(mock_db_t *db)
+{
+	const ni_string_array_t *refs;
+	ni_bool_t used;
+	unsigned int i, j;
+	unsigned int table;
+
+	for (table = MOCK_BRIDGE; table <= MOCK_INTERFACE; ++table) {
+		for (i = 0; i < db->count; ) {
+			if (db->rows[i]->table != table) {
+				i++;
+				continue;
+			}
+
+			used = FALSE;
+			if (table == MOCK_BRIDGE) {
+				used = ni_string_array_index(&db->bridges, db->rows[i]->uuid) >= 0;
+			} else {
+				for (j = 0; !used && j < db->count; ++j) {
+					if (db->rows[j]->table != table - 1)
+						continue;
+					refs = &db->rows[j]->refs;
+					used = ni_string_array_index(refs, db->rows[i]->uuid) >= 0;
+				}
+			}
+			if (used) {
+				i++;
+				continue;
+			}
+
+			mock_row_free(db->rows[i]);
+			db->rows[i] = db->rows[--db->count];
+		}
+	}
+}
+
+static ni_bool_t
+mock_db_unique(const mock_db_t *db, char **details)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < db->count; ++i) {
+		for (j = i + 1; j < db->count; ++j) {
+			if (db->rows[i]->table != db->rows[j]->table ||
+			    !ni_string_eq(db->rows[i]->name, db->rows[j]->name))
+				continue;
+
+			ni_string_printf(details, "duplicate %s name %s",
+					mock_tables[db->rows[i]->table], db->rows[i]->name);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* row in the monitor notation, a set of one element as atom */
+static ni_json_t *
+mock_row_json(const mock_row_t *row)
+{
+	ni_json_t *json, *uuid, *set, *atoms;
+	unsigned int i;
+
+	json = ni_json_new_object();
+	ni_json_object_set(json, "name", ni_json_new_string(row->name));
+
+	if (row->table == MOCK_BRIDGE) {
+		atoms = ni_json_new_array();
+		for (i = 0; i < row->refs.count; ++i) {
+			uuid = ni_json_new_array();
+			ni_json_array_append(uuid, ni_json_new_string("uuid"));
+			ni_json_array_append(uuid, ni_json_new_string(row->refs.data[i]));
+			ni_json_array_append(atoms, uuid);
+		}
+		if (row->refs.count == 1) {
+			set = ni_json_array_ref(atoms, 0);
+			ni_json_free(atoms);
+		} else {
+			set = ni_json_new_array();
+			ni_json_array_append(set, ni_json_new_string("set"));
+			ni_json_array_append(set, atoms);
+		}
+		ni_json_object_set(json, "ports", set);
+	} else {
+		if (row->tag) {
+			ni_json_object_set(json, "tag", ni_json_new_int64(row->tag));
+		} else {
+			set = ni_json_new_array();
+			ni_json_array_append(set, ni_json_new_string("set"));
+			ni_json_array_append(set, ni_json_new_array());
+			ni_json_object_set(json, "tag", set);
+		}
+		ni_json_object_set(json, "fake_bridge", ni_json_new_bool(row->fake_bridge));
+	}
+	return json;
+}
+
+static ni_bool_t
+mock_row_eq(const mock_row_t *a, const mock_row_t *b)
+{
+	return ni_string_eq(a->name, b->name) && a->tag == b->tag &&
+		a->fake_bridge == b->fake_bridge && ni_string_array_eq(&a->refs, &b->refs);
+}
+
+/* the monitored Bridge and Port changes from old to new */
+static ni_json_t *
+mock_db_updates(const mock_db_t *old, const mock_db_t *new)
+{
+	ni_json_t *updates, *tables[MOCK_INTERFACE], *update;
+	const mock_row_t *row, *prev;
+	unsigned int i, t;
+
+	for (t = MOCK_BRIDGE; t < MOCK_INTERFACE; ++t)
+		tables[t] = ni_json_new_object();
+
+	for (i = 0; old && i < old->count; ++i) {
+		row = old->rows[i];
+		if (row->table == MOCK_INTERFACE || mock_db_find(new, row->uuid))
+			continue;
+
+		update = ni_json_new_object();
+		ni_json_object_set(update, "old", mock_row_json(row));
+		ni_json_object_set(tables[row->table], row->uuid, update);
+	}
+	for (i = 0; i < new->count; ++i) {
+		row = new->rows[i];
+		if (row->table == MOCK_INTERFACE)
+			continue;
+		if (old && (prev = mock_db_find(old, row->uuid)) && mock_row_eq(prev, row))
+			continue;
+
+		update = ni_json_new_object();
+		ni_json_object_set(update, "new", mock_row_json(row));
+		ni_json_object_set(tables[row->table], row->uuid, update);
+	}
+
+	updates = ni_json_new_object();
+	for (t = MOCK_BRIDGE; t < MOCK_INTERFACE; ++t) {
+		if (ni_json_object_entries(tables[t]))
+			ni_json_object_set(updates, mock_tables[t], tables[t]);
+		else
+			ni_json_free(tables[t]);
+	}
+	return updates;
+}
+
+/* ["uuid", uuid] or ["named-uuid", name] of this transaction */
+static const char *
+mock_uuid_get(ni_json_t *json, const ni_string_array_t *names, const ni_string_array_t *uuids)
+{
+	static char buf[40];
+	char *kind = NULL, *value = NULL;
+	int pos;
+
+	if (ni_json_array_entries(json) != 2 ||
+	    !ni_json_string_get(ni_json_array_get(json, 0), &kind) ||
+	    !ni_json_string_get(ni_json_array_get(json, 1), &value))
+		goto failure;
+
+	if (ni_string_eq(kind, "uuid"))
+		snprintf(buf, sizeof(buf), "%s", value);
+	else
+	if (ni_string_eq(kind, "named-uuid") && (pos = ni_string_array_index(names, value)) >= 0)
+		snprintf(buf, sizeof(buf), "%s", uuids->data[pos]);
+	else
+		goto failure;
+
+	ni_string_free(&kind);
+	ni_string_free(&value);
+	return buf;
+
+failure:
+	ni_string_free(&kind);
+	ni_string_free(&value);
+	return NULL;
+}
+
+static ni_bool_t
+mock_uuid_set_get(ni_json_t *json, ni_string_array_t *set,
+		const ni_string_array_t *names, const ni_string_array_t *uuids)
+{
+	ni_json_t *atoms = NULL;
+	const char *uuid;
+	char *kind = NULL;
+	unsigned int i;
+
+	if (ni_json_array_entries(json) == 2 &&
+	    ni_json_string_get(ni_json_array_get(json, 0), &kind) &&
+	    ni_string_eq(kind, "set"))
+		atoms = ni_json_array_get(json, 1);
+	ni_string_free(&kind);
+
+	if (!atoms) {
+		if (!(uuid = mock_uuid_get(json, names, uuids)))
+			return FALSE;
+		ni_string_array_append(set, uuid);
+		return TRUE;
+	}
+
+	for (i = 0; i < ni_json_array_entries(atoms); ++i) {
+		if (!(uuid = mock_uuid_get(ni_json_array_get(atoms, i), names, uuids)))
+			return FALSE;
+		ni_string_array_append(set, uuid);
+	}
+	return TRUE;
+}
+
+static ni_bool_t
+mock_op_insert(mock_db_t *db, ni_json_t *op, ni_string_array_t *names,
+		ni_string_array_t *uuids, ni_json_t *result)
+{
+	char *table = NULL, *name = NULL, *uuid_name = NULL;
+	ni_json_t *data, *value;
+	mock_row_t *row = NULL;
+	int64_t tag;
+	int t;
+
+	ni_json_string_get(ni_json_object_get_value(op, "table"), &table);
+	ni_json_string_get(ni_json_object_get_value(op, "uuid-name"), &uuid_name);
+	data = ni_json_object_get_value(op, "row");
+	ni_json_string_get(ni_json_object_get_value(data, "name"), &name);
+
+	if ((t = mock_table_index(table)) < 0 || !name || !(row = mock_row_new(db, t, name)))
+		goto failure;
+
+	if ((value = ni_json_object_get_value(data, t == MOCK_BRIDGE ? "ports" : "interfaces")) &&
+	    !mock_uuid_set_get(value, &row->refs, names, uuids))
+		goto failure;
+	if (ni_json_int64_get(ni_json_object_get_value(data, "tag"), &tag))
+		row->tag = tag;
+	ni_json_bool_get(ni_json_object_get_value(data, "fake_bridge"), &row->fake_bridge);
+
+	if (uuid_name) {
+		ni_string_array_append(names, uuid_name);
+		ni_string_array_append(uuids, row->uuid);
+	}
+
+	value = ni_json_new_array();
+	ni_json_array_append(value, ni_json_new_string("uuid"));
+	ni_json_array_append(value, ni_json_new_string(row->uuid));
+	ni_json_object_set(result, "uuid", value);
+
+	ni_string_free(&table);
+	ni_string_free(&name);
+	ni_string_free(&uuid_name);
+	return TRUE;
+
+failure:
+	ni_string_free(&table);
+	ni_string_free(&name);
+	ni_string_free(&uuid_name);
+	return FALSE;
+}
+
+static ni_bool_t
+mock_mutate_set(ni_string_array_t *set, const char *mutator, ni_json_t *value,
+		const ni_string_array_t *names, const ni_string_array_t *uuids)
+{
+	ni_string_array_t arg = NI_STRING_ARRAY_INIT;
+	unsigned int i;
+	int pos;
+
+	if (!mock_uuid_set_get(value, &arg, names, uuids))
+		return FALSE;
+
+	for (i = 0; i < arg.count; ++i) {
+		pos = ni_string_array_index(set, arg.data[i]);
+		if (ni_string_eq(mutator, "insert") && pos < 0)
+			ni_string_array_append(set, arg.data[i]);
+		else
+		if (ni_string_eq(mutator, "delete") && pos >= 0)
+			ni_string_array_remove_index(set, pos);
+	}
+	ni_string_array_destroy(&arg);
+	return ni_string_eq(mutator, "insert") || ni_string_eq(mutator, "delete");
+}
+
+static ni_bool_t
+mock_op_mutate(mock_db_t *db, ni_json_t *op, const ni_string_array_t *names,
+		const ni_string_array_t *uuids, ni_json_t *result)
+{
+	char *table = NULL, *column = NULL, *mutator = NULL, *name = NULL;
+	ni_json_t *where, *mutation;
+	unsigned int i, count = 0;
+	ni_bool_t ret = FALSE;
+
+	ni_json_string_get(ni_json_object_get_value(op, "table"), &table);
+	mutation = ni_json_array_get(ni_json_object_get_value(op, "mutations"), 0);
+	ni_json_string_get(ni_json_array_get(mutation, 0), &column);
+	ni_json_string_get(ni_json_array_get(mutation, 1), &mutator);
+
+	/* [] or [["name", "==", name]] */
+	where = ni_json_object_get_value(op, "where");
+	if (ni_json_array_entries(where))
+		ni_json_string_get(ni_json_array_get(ni_json_array_get(where, 0), 2), &name);
+
+	if (ni_string_eq(table, "Open_vSwitch")) {
+		if (ni_string_eq(column, "next_cfg"))
+			ret = TRUE;
+		else
+		if (ni_string_eq(column, "bridges"))
+			ret = mock_mutate_set(&db->bridges, mutator,
+					ni_json_array_get(mutation, 2), names, uuids);
+		count = 1;
+	} else
+	if (ni_string_eq(table, "Bridge") && ni_string_eq(column, "ports") && name) {
+		ret = TRUE;
+		for (i = 0; ret && i < db->count; ++i) {
+			if (db->rows[i]->table != MOCK_BRIDGE || !ni_string_eq(db->rows[i]->name, name))
+				continue;
+
+			ret = mock_mutate_set(&db->rows[i]->refs, mutator,
+					ni_json_array_get(mutation, 2), names, uuids);
+			count++;
+		}
+	}
+	ni_json_object_set(result, "count", ni_json_new_int64(count));
+
+	ni_string_free(&table);
+	ni_string_free(&column);
+	ni_string_free(&mutator);
+	ni_string_free(&name);
+	return ret;
+}
+
+static void
+mock_send(mock_client_t *client, ni_json_t *msg)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+	size_t off = 0;
+	ssize_t len;
+
+	ni_json_format_string(&buf, msg, NULL);
+	while (off < buf.len) {
+		if ((len = write(client->fd, buf.string + off, buf.len - off)) <= 0)
+			break;
+		off += len;
+	}
+	ni_stringbuf_destroy(&buf);
+}
+
+static ni_json_t *
+mock_transact(mock_db_t *db, ni_json_t *params, mock_client_t *clients, unsigned int nclients)
+{
+	ni_string_array_t names = NI_STRING_ARRAY_INIT;
+	ni_string_array_t uuids = NI_STRING_ARRAY_INIT;
+	ni_json_t *results, *result, *op, *updates, *msg;
+	char *opname = NULL, *details = NULL;
+	ni_bool_t ok = TRUE;
+	mock_db_t work;
+	unsigned int i;
+
+	mock_db_copy(&work, db);
+	results = ni_json_new_array();
+	for (i = 1; ok && i < ni_json_array_entries(params); ++i) {
+		op = ni_json_array_get(params, i);
+		result = ni_json_new_object();
+		ni_json_string_get(ni_json_object_get_value(op, "op"), &opname);
+
+		if (ni_string_eq(opname, "insert"))
+			ok = mock_op_insert(&work, op, &names, &uuids, result);
+		else
+		if (ni_string_eq(opname, "mutate"))
+			ok = mock_op_mutate(&work, op, &names, &uuids, result);
+		else
+			ok = FALSE;
+
+		if (!ok) {
+			ni_json_free(result);
+			result = ni_json_new_object();
+			ni_json_object_set(result, "error", ni_json_new_string("syntax error"));
+			ni_json_object_set(result, "details", ni_json_new_string(opname));
+		}
+		ni_json_array_append(results, result);
+		ni_string_free(&opname);
+	}
+
+	if (ok) {
+		mock_db_gc(&work);
+		if (!mock_db_unique(&work, &details)) {
+			result = ni_json_new_object();
+			ni_json_object_set(result, "error", ni_json_new_string("constraint violation"));
+			ni_json_object_set(result, "details", ni_json_new_string(details));
+			ni_json_array_append(results, result);
+			ni_string_free(&details);
+			ok = FALSE;
+		}
+	}
+
+	if (ok) {
+		updates = mock_db_updates(db, &work);
+		for (i = 0; i < nclients && ni_json_object_entries(updates); ++i) {
+			if (clients[i].fd < 0 || !clients[i].monitor)
+				continue;
+
+			msg = ni_json_new_object();
+			ni_json_object_set(msg, "method", ni_json_new_string("update"));
+			params = ni_json_new_array();
+			ni_json_array_append(params, ni_json_ref(clients[i].monitor));
+			ni_json_array_append(params, ni_json_ref(updates));
+			ni_json_object_set(msg, "params", params);
+			ni_json_object_set(msg, "id", ni_json_new_null());
+			mock_send(&clients[i], msg);
+			ni_json_free(msg);
+		}
+		ni_json_free(updates);
+
+		mock_db_destroy(db);
+		*db = work;
+	} else {
+		mock_db_destroy(&work);
+	}
+
+	ni_string_array_destroy(&names);
+	ni_string_array_destroy(&uuids);
+	return results;
+}
+
+static void
+mock_request(mock_db_t *db, mock_client_t *client, ni_json_t *msg,
+		mock_client_t *clients, unsigned int nclients)
+{
+	ni_json_t *params, *reply, *result = NULL;
+	char *method = NULL;
+
+	ni_json_string_get(ni_json_object_get_value(msg, "method"), &method);
+	params = ni_json_object_get_value(msg, "params");
+
+	if (ni_string_eq(method, "monitor")) {
+		ni_json_free(client->monitor);
+		client->monitor = ni_json_array_ref(params, 1);
+		result = mock_db_updates(NULL, db);
+	} else
+	if (ni_string_eq(method, "echo")) {
+		result = ni_json_ref(params);
+	} else
+	if (ni_string_eq(method, "transact")) {
+		result = mock_transact(db, params, clients, nclients);
+	}
+
+	/* replies of our echo requests are ignored */
+	if (method) {
+		reply = ni_json_new_object();
+		ni_json_object_set(reply, "id", ni_json_object_ref_value(msg, "id"));
+		if (result) {
+			ni_json_object_set(reply, "result", result);
+			ni_json_object_set(reply, "error", ni_json_new_null());
+		} else {
+			ni_json_object_set(reply, "result", ni_json_new_null());
+			ni_json_object_set(reply, "error", ni_json_new_string("unknown method"));
+		}
+		mock_send(client, reply);
+		ni_json_free(reply);
+	}
+	ni_string_free(&method);
+}
+
+/* the length of the first complete message in the input, or 0 */
+static size_t
+mock_message_len(const ni_stringbuf_t *input)
+{
+	ni_bool_t string = FALSE, escape = FALSE;
+	unsigned int depth = 0;
+	size_t i;
+
+	for (i = 0; i < input->len; ++i) {
+		char cc = input->string[i];
+
+		if (string) {
+			if (escape)
+				escape = FALSE;
+			else if (cc == '\\')
+				escape = TRUE;
+			else if (cc == '"')
+				string = FALSE;
+		} else if (cc == '"') {
+			string = TRUE;
+		} else if (cc == '{' || cc == '[') {
+			depth++;
+		} else if ((cc == '}' || cc == ']') && depth && --depth == 0) {
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+static void
+mock_seed(mock_db_t *db)
+{
+	mock_row_t *bridge, *port;
+	const struct {
+		const char *	name;
+		unsigned int	tag;
+		ni_bool_t	fake_bridge;
+	} *p, ports[] = {
+		{ "br0",	0,	FALSE	},
+		{ "eth0",	0,	FALSE	},
+		{ "eth1",	10,	FALSE	},
+		{ "br0.10",	10,	TRUE	},
+		{ NULL }
+	};
+
+	bridge = mock_row_new(db, MOCK_BRIDGE, "br0");
+	ni_string_array_append(&db->bridges, bridge->uuid);
+	for (p = ports; p->name; ++p) {
+		port = mock_row_new(db, MOCK_PORT, p->name);
+		port->tag = p->tag;
+		port->fake_bridge = p->fake_bridge;
+		ni_string_array_append(&bridge->refs, port->uuid);
+		ni_string_array_append(&port->refs, mock_row_new(db, MOCK_INTERFACE, p->name)->uuid);
+	}
+}
+
+static void
+mock_server(int lfd)
+{
+	mock_client_t clients[MOCK_CLIENTS_MAX];
+	struct pollfd pfd[MOCK_CLIENTS_MAX + 1];
+	unsigned int i, n;
+	char data[4096];
+	ni_json_t *msg;
+	mock_db_t db;
+	ssize_t len;
+	size_t mlen;
+	int fd;
+
+	memset(&db, 0, sizeof(db));
+	mock_seed(&db);
+
+	for (i = 0; i < MOCK_CLIENTS_MAX; ++i) {
+		clients[i].fd = -1;
+		ni_stringbuf_init(&clients[i].input);
+		clients[i].monitor = NULL;
+	}
+
+	for (;;) {
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < MOCK_CLIENTS_MAX; ++i) {
+			pfd[i + 1].fd = clients[i].fd;
+			pfd[i + 1].events = POLLIN;
+		}
+		if (poll(pfd, MOCK_CLIENTS_MAX + 1, -1) < 0 && errno != EINTR)
+			_exit(2);
+
+		if (pfd[0].revents & POLLIN) {
+			if ((fd = accept(lfd, NULL, NULL)) >= 0) {
+				for (i = 0; i < MOCK_CLIENTS_MAX && clients[i].fd >= 0; ++i)
+					;
+				if (i < MOCK_CLIENTS_MAX)
+					clients[i].fd = fd;
+				else
+					close(fd);
+			}
+		}
+
+		for (n = 0; n < MOCK_CLIENTS_MAX; ++n) {
+			mock_client_t *client = &clients[n];
+
+			if (client->fd < 0 || !(pfd[n + 1].revents & (POLLIN | POLLHUP)))
+				continue;
+
+			if ((len = read(client->fd, data, sizeof(data))) <= 0) {
+				close(client->fd);
+				client->fd = -1;
+				ni_stringbuf_destroy(&client->input);
+				ni_json_free(client->monitor);
+				client->monitor = NULL;
+				continue;
+			}
+			ni_stringbuf_put(&client->input, data, len);
+
+			while ((mlen = mock_message_len(&client->input))) {
+				char *text = xstrdup(client->input.string);
+
+				ni_stringbuf_truncate(&client->input, 0);
+				ni_stringbuf_puts(&client->input, text + mlen);
+				text[mlen] = '\0';
+				if ((msg = ni_json_parse_string(text))) {
+					mock_request(&db, client, msg, clients, MOCK_CLIENTS_MAX);
+					ni_json_free(msg);
+				}
+				free(text);
+			}
+		}
+	}
+}
+
+/*
+ * client checks
+ */
+/* the sorted port names of a bridge, "-" on error */
+static const char *
+ports(ni_ovsdb_client_t *client, const char *brname)
+{
+	static char buf[256];
+	ni_ovs_bridge_port_array_t array;
+	ni_stringbuf_t names = NI_STRINGBUF_INIT_DYNAMIC;
+	unsigned int i;
+
+	ni_ovs_bridge_port_array_init(&array);
+	if (ni_ovsdb_bridge_ports(client, brname, &array) == 0) {
+		for (i = 0; i < array.count; ++i) {
+			if (i)
+				ni_stringbuf_putc(&names, ',');
+			ni_stringbuf_puts(&names, array.data[i]->device.name);
+		}
+		snprintf(buf, sizeof(buf), "%s", names.string ? names.string : "");
+	} else {
+		snprintf(buf, sizeof(buf), "-");
+	}
+	ni_stringbuf_destroy(&names);
+	ni_ovs_bridge_port_array_destroy(&array);
+	return buf;
+}
+
+static ni_bool_t
+port_bridge_is(ni_ovsdb_client_t *client, const char *pname, const char *brname)
+{
+	char *name = NULL;
+	ni_bool_t ret;
+
+	if (ni_ovsdb_bridge_port_to_bridge(client, pname, &name))
+		return brname == NULL;
+	ret = ni_string_eq(name, brname);
+	ni_string_free(&name);
+	return ret;
+}
+
+static void
+check_queries(ni_ovsdb_client_t *client)
+{
+	char *parent = NULL;
+	uint16_t vlan = 0;
+
+	check(ni_ovsdb_bridge_exists(client, "br0") == 0, "br0 exists");
+	check(ni_ovsdb_bridge_exists(client, "br0.10") == 0, "fake br0.10 exists");
+	check(ni_ovsdb_bridge_exists(client, "eth0") == 1, "port eth0 is not a bridge");
+	check(ni_ovsdb_bridge_exists(client, "br9") == 1, "br9 does not exist");
+
+	check(ni_string_eq(ports(client, "br0"), "eth0"), "br0 ports");
+	check(ni_string_eq(ports(client, "br0.10"), "eth1"), "br0.10 ports");
+
+	check(ni_ovsdb_bridge_to_parent(client, "br0", &parent) == 0 && !parent,
+			"br0 has no parent");
+	check(ni_ovsdb_bridge_to_parent(client, "br0.10", &parent) == 0 &&
+			ni_string_eq(parent, "br0"), "br0.10 parent is br0");
+	ni_string_free(&parent);
+	check(ni_ovsdb_bridge_to_vlan(client, "br0.10", &vlan) == 0 && vlan == 10,
+			"br0.10 vlan is 10");
+
+	check(port_bridge_is(client, "eth0", "br0"), "eth0 is on br0");
+	check(port_bridge_is(client, "eth1", "br0.10"), "eth1 is on br0.10");
+	check(port_bridge_is(client, "eth9", NULL), "eth9 is not on a bridge");
+}
+
+static void
+check_transactions(ni_ovsdb_client_t *client)
+{
+	check(ni_ovsdb_bridge_add(client, "br1", NULL, 0, FALSE) == 0, "add br1");
+	check(ni_ovsdb_bridge_add(client, "br1", NULL, 0, FALSE) != 0, "add existing br1 fails");
+	check(ni_ovsdb_bridge_add(client, "br1", NULL, 0, TRUE) == 0, "add existing br1 with may-exist");
+	check(ni_ovsdb_bridge_add(client, "br1", "br0", 5, TRUE) != 0, "add br1 as vlan bridge fails");
+	check(ni_ovsdb_bridge_exists(client, "br1") == 0, "br1 exists");
+	check(ni_string_eq(ports(client, "br1"), ""), "br1 has no ports");
+
+	check(ni_ovsdb_bridge_port_add(client, "br1", "eth2", FALSE) == 0, "add eth2 to br1");
+	check(ni_ovsdb_bridge_port_add(client, "br1", "eth2", TRUE) == 0, "add eth2 to br1 with may-exist");
+	check(ni_ovsdb_bridge_port_add(client, "br0", "eth2", TRUE) != 0, "add eth2 to br0 fails");
+	check(ni_ovsdb_bridge_port_add(client, "br1", "eth3", FALSE) == 0, "add eth3 to br1");
+	check(ni_string_eq(ports(client, "br1"), "eth2,eth3"), "br1 ports");
+
+	check(ni_ovsdb_bridge_port_del(client, "br1", "eth2") == 0, "delete eth2 from br1");
+	check(ni_ovsdb_bridge_port_del(client, "br1", "eth2") != 0, "delete eth2 again fails");
+	check(ni_string_eq(ports(client, "br1"), "eth3"), "br1 ports after delete");
+
+	check(ni_ovsdb_bridge_add(client, "br1.20", "br1", 20, FALSE) == 0, "add br1.20 on br1");
+	check(ni_ovsdb_bridge_port_add(client, "br1.20", "eth4", FALSE) == 0, "add eth4 to br1.20");
+	check(ni_string_eq(ports(client, "br1.20"), "eth4"), "br1.20 ports");
+	check(ni_string_eq(ports(client, "br1"), "eth3"), "br1 ports without br1.20 ports");
+	check(port_bridge_is(client, "eth4", "br1.20"), "eth4 is on br1.20");
+
+	check(ni_ovsdb_bridge_del(client, "br1.20") == 0, "delete br1.20");
+	check(ni_ovsdb_bridge_exists(client, "br1.20") == 1, "br1.20 is gone");
+	check(port_bridge_is(client, "eth4", NULL), "eth4 is gone with br1.20");
+	check(ni_string_eq(ports(client, "br1"), "eth3"), "br1 ports after br1.20 delete");
+
+	check(ni_ovsdb_bridge_del(client, "br1") == 0, "delete br1");
+	check(ni_ovsdb_bridge_exists(client, "br1") == 1, "br1 is gone");
+	check(port_bridge_is(client, "eth3", NULL), "eth3 is gone with br1");
+	check(ni_ovsdb_bridge_del(client, "br1") != 0, "delete br1 again fails");
+}
+
+static void
+check_monitor(ni_ovsdb_client_t *client, ni_ovsdb_client_t *other)
+{
+	check(ni_ovsdb_bridge_exists(client, "br2") == 1, "br2 does not exist yet");
+	check(ni_ovsdb_bridge_add(other, "br2", NULL, 0, FALSE) == 0, "other client adds br2");
+	check(ni_ovsdb_bridge_exists(client, "br2") == 0, "br2 exists");
+	check(ni_string_eq(ports(client, "br2"), ""), "br2 has no ports");
+
+	/* a cache hit, the update has to be read without a flush */
+	check(ni_ovsdb_bridge_port_add(other, "br2", "eth5", FALSE) == 0, "other client adds eth5 to br2");
+	check(ni_string_eq(ports(client, "br2"), "eth5"), "br2 ports updated");
+
+	check(ni_ovsdb_bridge_del(other, "br2") == 0, "other client deletes br2");
+	check(ni_ovsdb_bridge_exists(client, "br2") == 1, "br2 is gone");
+	check(ni_string_eq(ports(client, "br0"), "eth0"), "br0 ports unchanged");
+}
+
+static int
+mock_listen(const char *path)
+{
+	struct sockaddr_un sun;
+	int fd;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if ((size_t)snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path) >= sizeof(sun.sun_path))
+		ni_fatal("Socket path %s too long", path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		ni_fatal("Cannot create socket: %m");
+	if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 || listen(fd, 8) < 0)
+		ni_fatal("Cannot listen on %s: %m", path);
+	return fd;
+}
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/ovsdb-test.XXXXXX";
+	ni_ovsdb_client_t *client, *other;
+	char path[PATH_MAX];
+	pid_t pid;
+	int c, fd;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./ovsdb-test [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	snprintf(path, sizeof(path), "%s/db.sock", template);
+
+	fd = mock_listen(path);
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork server: %m");
+	if (pid == 0)
+		mock_server(fd);
+	close(fd);
+
+	client = ni_ovsdb_client_new(path);
+	other = ni_ovsdb_client_new(path);
+	check(ni_ovsdb_client_connect(client), "connect");
+	check(ni_ovsdb_client_connect(other), "connect other client");
+
+	check_queries(client);
+	check_transactions(client);
+	check_monitor(client, other);
+
+	ni_ovsdb_client_free(client);
+	ni_ovsdb_client_free(other);
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}
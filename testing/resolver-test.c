@@ -0,0 +1,454 @@
+/*
+ * Asynchronous hostname lookup test.
+ *
+ * Runs in a private mount and network namespace (using an unprivileged
+ * user namespace when needed), with a resolv.conf and nsswitch.conf
+ * pointing glibc to a stand-in DNS responder on the loopback, which is
+ * served from the same socket event loop as the lookups. The responder
+ * answers A queries for hostN.wicked.test with 192.0.2.N after a delay,
+ * NXDOMAIN for other names and does not answer slow.wicked.test.
+ *
+ * Checks that the lookups do not block, run at most <concurrency> at
+ * a time, are shared and cached per hostname, and that a flush, a
+ * failure and a timeout are reported.
+ *
+ *	resolver-test [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/socket.h>
+#include <wicked/resolver.h>
+
+#include "socket_priv.h"
+#include "appconfig.h"
+#include "util_priv.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+
+	{ NULL }
+};
+
+#define TEST_HOSTS		10
+#define TEST_CONCURRENCY	3
+
+/*
+ * stand-in DNS responder
+ */
+#define MOCK_DELAY		200	/* msec */
+#define MOCK_QUERIES_MAX	64
+#define MOCK_NAMES_MAX		64
+
+typedef struct mock_query {
+	struct sockaddr_in	from;
+	unsigned char		buf[512];
+	size_t			len;
+	char			name[256];
+	unsigned int		qtype;
+} mock_query_t;
+
+static struct {
+	ni_socket_t *		sock;
+	const ni_timer_t *	timer;
+	mock_query_t		pending[MOCK_QUERIES_MAX];
+	unsigned int		npending;
+	unsigned int		max_pending;
+
+	struct {
+		char		name[256];
+		unsigned int	count;
+	}			names[MOCK_NAMES_MAX];
+	unsigned int		nnames;
+} mock;
+
+static unsigned int
+mock_queries(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < mock.nnames; ++i) {
+		if (!strcmp(mock.names[i].name, name))
+			return mock.names[i].count;
+	}
+	return 0;
+}
+
+static void
+mock_count(const char *name)
+{
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < mock.nnames; ++i) {
+		if (!strcmp(mock.names[i].name, name)) {
+			mock.names[i].count++;
+			return;
+		}
+	}
+	if (mock.nnames < MOCK_NAMES_MAX) {
+		/* name is a pending query of the mock itself */
+		len = strlen(name);
+		if (len >= sizeof(mock.names[i].name))
+			len = sizeof(mock.names[i].name) - 1;
+		memmove(mock.names[i].name, name, len);
+		mock.names[i].name[len] = '\0';
+		mock.names[i].count = 1;
+		mock.nnames++;
+	}
+}
+
+/* parse the question name, returns the offset behind the question */
+static size_t
+mock_parse_question(mock_query_t *q)
+{
+	size_t pos = 12, out = 0;
+	unsigned int len;
+
+	while (pos < q->len && (len = q->buf[pos++])) {
+		if (len > 63 || pos + len > q->len || out + len + 1 >= sizeof(q->name))
+			return 0;
+		if (out)
+			q->name[out++] = '.';
+		memcpy(q->name + out, q->buf + pos, len);
+		out += len;
+		pos += len;
+	}
+	q->name[out] = '\0';
+
+	if (pos + 4 > q->len)
+		return 0;
+	q->qtype = (q->buf[pos] << 8) | q->buf[pos + 1];
+	return pos + 4;
+}
+
+static void
+mock_answer(mock_query_t *q)
+{
+	unsigned char *p;
+	unsigned int n;
+	size_t len;
+
+	if (!(len = mock_parse_question(q)))
+		return;
+
+	/* the header and question of the query with the answer appended */
+	q->buf[2] = 0x81;
+	q->buf[3] = 0x80;
+	q->buf[4] = 0; q->buf[5] = 1;
+	q->buf[6] = 0; q->buf[7] = 0;
+	q->buf[8] = 0; q->buf[9] = 0;
+	q->buf[10] = 0; q->buf[11] = 0;
+
+	if (sscanf(q->name, "host%u.wicked.test", &n) != 1 || n == 0 || n > 254) {
+		q->buf[3] |= 3;		/* NXDOMAIN */
+	} else
+	if (q->qtype == 1 && len + 16 <= sizeof(q->buf)) {
+		p = q->buf + len;
+		*p++ = 0xc0; *p++ = 12;			/* name */
+		*p++ = 0; *p++ = 1;			/* type A */
+		*p++ = 0; *p++ = 1;			/* class IN */
+		*p++ = 0; *p++ = 0; *p++ = 0; *p++ = 60;	/* ttl */
+		*p++ = 0; *p++ = 4;
+		*p++ = 192; *p++ = 0; *p++ = 2; *p++ = n;
+		q->buf[7] = 1;
+		len += 16;
+	}
+
+	if (sendto(mock.sock->__fd, q->buf, len, 0,
+			(struct sockaddr *)&q->from, sizeof(q->from)) < 0)
+		ni_error("mock: unable to send answer: %m");
+}
+
+static void
+mock_flush(void *user_data, const ni_timer_t *timer)
+{
+	unsigned int i;
+
+	(void)user_data;
+	if (mock.timer != timer)
+		return;
+	mock.timer = NULL;
+
+	for (i = 0; i < mock.npending; ++i)
+		mock_answer(&mock.pending[i]);
+	mock.npending = 0;
+}
+
+static void
+mock_receive(ni_socket_t *sock)
+{
+	mock_query_t *q;
+	socklen_t alen;
+	ssize_t len;
+
+	while (mock.npending < MOCK_QUERIES_MAX) {
+		q = &mock.pending[mock.npending];
+		alen = sizeof(q->from);
+		len = recvfrom(sock->__fd, q->buf, sizeof(q->buf), MSG_DONTWAIT,
+				(struct sockaddr *)&q->from, &alen);
+		if (len < 12)
+			break;
+
+		q->len = len;
+		if (!mock_parse_question(q))
+			continue;
+
+		mock_count(q->name);
+		if (!strcmp(q->name, "slow.wicked.test"))
+			continue;
+
+		mock.npending++;
+		if (mock.npending > mock.max_pending)
+			mock.max_pending = mock.npending;
+		if (!mock.timer)
+			mock.timer = ni_timer_register(MOCK_DELAY, mock_flush, NULL);
+	}
+}
+
+static void
+mock_listen(void)
+{
+	struct sockaddr_in sin;
+	int fd;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(53);
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0 ||
+	    bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		ni_fatal("mock: cannot bind dns responder: %m");
+
+	mock.sock = ni_socket_wrap(fd, SOCK_DGRAM);
+	mock.sock->receive = mock_receive;
+	ni_socket_activate(mock.sock);
+}
+
+/*
+ * Namespace setup
+ */
+static int
+test_bind_file(const char *dir, const char *name, const char *data, const char *target)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if (test_write_file(path, data) < 0)
+		return -1;
+	return mount(path, target, NULL, MS_BIND, NULL);
+}
+
+static int
+test_setup(const char *dir)
+{
+	struct ifreq ifr;
+	int fd, ret;
+
+	if (test_enter_namespace() < 0)
+		return -1;
+
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0)
+		return -1;
+	if (test_bind_file(dir, "resolv.conf", "nameserver 127.0.0.1\n"
+				"options timeout:1 attempts:1\n", _PATH_RESOLV_CONF) < 0)
+		return -1;
+	if (test_bind_file(dir, "nsswitch.conf", "hosts: dns\n", "/etc/nsswitch.conf") < 0)
+		return -1;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, "lo");
+	ifr.ifr_flags = IFF_UP;
+	ret = ioctl(fd, SIOCSIFFLAGS, &ifr);
+	close(fd);
+	return ret;
+}
+
+/*
+ * Lookup checks
+ */
+static const char *
+hostname(unsigned int n)
+{
+	static char buf[64];
+
+	snprintf(buf, sizeof(buf), "host%u.wicked.test", n);
+	return buf;
+}
+
+static ni_bool_t
+resolved_to(int rv, const ni_sockaddr_t *addr, unsigned int n)
+{
+	return rv == 1 && addr->ss_family == AF_INET &&
+		ntohl(addr->sin.sin_addr.s_addr) == (0xc0000200U | n);
+}
+
+static long
+elapsed_ms(const struct timeval *start)
+{
+	struct timeval now, delta;
+
+	ni_timer_get_time(&now);
+	timersub(&now, start, &delta);
+	return delta.tv_sec * 1000 + delta.tv_usec / 1000;
+}
+
+/* run the event loop until the lookup completed */
+static int
+wait_for(const char *name, ni_sockaddr_t *addr, long max_ms)
+{
+	struct timeval start;
+	long timeout;
+	int rv;
+
+	ni_timer_get_time(&start);
+	while ((rv = ni_resolve_hostname_async(name, AF_INET, addr)) == 0) {
+		if (elapsed_ms(&start) > max_ms)
+			break;
+		timeout = ni_timer_next_timeout();
+		if (timeout < 0 || timeout > 100)
+			timeout = 100;
+		if (ni_socket_wait(timeout) != 0)
+			ni_fatal("ni_socket_wait failed");
+	}
+	return rv;
+}
+
+static void
+check_lookups(void)
+{
+	ni_sockaddr_t addr[TEST_HOSTS + 1];
+	ni_bool_t pending = TRUE, ok = TRUE, once = TRUE;
+	struct timeval start;
+	unsigned int n;
+	long ms;
+
+	ni_timer_get_time(&start);
+	for (n = 1; n <= TEST_HOSTS; ++n) {
+		/* two callers per host */
+		if (ni_resolve_hostname_async(hostname(n), AF_INET, &addr[n]) != 0 ||
+		    ni_resolve_hostname_async(hostname(n), AF_INET, &addr[n]) != 0)
+			pending = FALSE;
+	}
+	ms = elapsed_ms(&start);
+	check(pending && ms < MOCK_DELAY, "lookups started without blocking");
+
+	for (n = 1; n <= TEST_HOSTS; ++n) {
+		if (!resolved_to(wait_for(hostname(n), &addr[n], 5000), &addr[n], n))
+			ok = FALSE;
+		if (mock_queries(hostname(n)) != 1)
+			once = FALSE;
+	}
+	check(ok, "all hosts resolved");
+	check(once, "one query per hostname");
+	check(mock.max_pending == TEST_CONCURRENCY, "concurrency limit used and respected");
+
+	ni_timer_get_time(&start);
+	for (n = 1, ok = TRUE; n <= TEST_HOSTS; ++n) {
+		if (!resolved_to(ni_resolve_hostname_async(hostname(n), AF_INET, &addr[n]), &addr[n], n))
+			ok = FALSE;
+		if (mock_queries(hostname(n)) != 1)
+			ok = FALSE;
+	}
+	check(ok && elapsed_ms(&start) < MOCK_DELAY, "results served from the cache");
+
+	ni_resolve_hostname_async_flush(hostname(1), AF_INET);
+	check(ni_resolve_hostname_async(hostname(1), AF_INET, &addr[1]) == 0,
+			"flushed host looked up again");
+	check(resolved_to(wait_for(hostname(1), &addr[1], 5000), &addr[1], 1) &&
+			mock_queries(hostname(1)) == 2, "flushed host resolved");
+}
+
+static void
+check_failures(void)
+{
+	ni_sockaddr_t addr;
+	struct timeval start;
+
+	check(wait_for("missing.wicked.test", &addr, 5000) == -1,
+			"unknown host not resolvable");
+	check(ni_resolve_hostname_async("missing.wicked.test", AF_INET, &addr) == -1 &&
+			mock_queries("missing.wicked.test") == 1, "failure cached");
+
+	ni_timer_get_time(&start);
+	check(wait_for("slow.wicked.test", &addr, 5000) == -1 &&
+			elapsed_ms(&start) < 3000, "unanswered lookup timed out");
+
+	check(resolved_to(wait_for(hostname(TEST_HOSTS + 1), &addr, 5000), &addr,
+			TEST_HOSTS + 1), "lookups continue after a timeout");
+}
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/resolver-test.XXXXXX";
+	ni_config_hostname_lookup_t *conf;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./resolver-test [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("resolver-test") < 0)
+		return 1;
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	if (test_setup(template) < 0)
+		ni_fatal("Cannot set up a private mount and network namespace: %m");
+
+	conf = &ni_global.config->hostname_lookup;
+	conf->concurrency = TEST_CONCURRENCY;
+	conf->timeout = 1;
+	conf->cache_time = 60;
+
+	mock_listen();
+
+	check_lookups();
+	check_failures();
+
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}
@@ -0,0 +1,217 @@
+/*
+ * sysfs and sysctl attribute read throughput.
+ *
+ * Reads the attributes of all interfaces in the current network
+ * namespace as a full refresh does: the ipv4 and ipv6 sysctl settings
+ * of every interface, the config and status of every bridge and its
+ * ports, and the bonding options of every bond. Run it in a namespace
+ * with the devices to measure, e.g.
+ *
+ *	unshare -n -m sh -c 'mount -t sysfs sysfs /sys;
+ *		ip link add br0 type bridge; ip link add bond0 type bond;
+ *		...; ./sysfs-bench'
+ *
+ *	sysfs-bench [--rounds N] [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <net/if.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/bridge.h>
+#include <wicked/bonding.h>
+#include <wicked/ipv4.h>
+#include <wicked/ipv6.h>
+
+#include "sysfs.h"
+#include "util_priv.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+	OPT_ROUNDS,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+	{ "rounds",		required_argument,	NULL,	OPT_ROUNDS },
+
+	{ NULL }
+};
+
+static ni_netdev_t **	devs;
+static unsigned int	ndevs;
+static ni_string_array_t bridges = NI_STRING_ARRAY_INIT;
+static ni_string_array_t bonds = NI_STRING_ARRAY_INIT;
+static unsigned int	nports;
+
+static unsigned int
+bench_scan(void)
+{
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+	ni_string_array_t ports = NI_STRING_ARRAY_INIT;
+	struct dirent *de;
+	unsigned int i;
+	DIR *d;
+
+	if (!(d = opendir("/sys/class/net")))
+		return 1;
+
+	while ((de = readdir(d))) {
+		if (de->d_name[0] == '.' || ni_string_eq(de->d_name, "bonding_masters"))
+			continue;
+
+		devs = xrealloc(devs, (ndevs + 1) * sizeof(*devs));
+		devs[ndevs++] = ni_netdev_new(de->d_name, if_nametoindex(de->d_name));
+
+		if (ni_sysfs_netif_dir_open(&dir, de->d_name, "bridge"))
+			ni_string_array_append(&bridges, de->d_name);
+		if (ni_sysfs_netif_dir_open(&dir, de->d_name, "bonding"))
+			ni_string_array_append(&bonds, de->d_name);
+	}
+	ni_sysfs_dir_close(&dir);
+	closedir(d);
+
+	for (i = 0; i < bridges.count; ++i) {
+		ni_sysfs_bridge_get_port_names(bridges.data[i], &ports);
+		nports += ports.count;
+		ni_string_array_destroy(&ports);
+	}
+	return 0;
+}
+
+static unsigned int
+bench_devinfo(void)
+{
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < ndevs; ++i) {
+		if (ni_system_ipv4_devinfo_get(devs[i], NULL) < 0)
+			failures++;
+		if (ni_system_ipv6_devinfo_get(devs[i], NULL) < 0)
+			failures++;
+	}
+	return failures;
+}
+
+/* as __ni_discover_bridge_sysfs */
+static unsigned int
+bench_bridge(void)
+{
+	ni_string_array_t ports = NI_STRING_ARRAY_INIT;
+	ni_sysfs_dir_t dir = NI_SYSFS_DIR_INIT;
+	unsigned int i, j, failures = 0;
+	ni_bridge_port_t *port;
+	ni_bridge_t *bridge;
+
+	for (i = 0; i < bridges.count; ++i) {
+		bridge = ni_bridge_new();
+		if (ni_sysfs_netif_dir_open(&dir, bridges.data[i], "bridge")) {
+			ni_sysfs_bridge_dir_get_config(&dir, bridge);
+			ni_sysfs_bridge_dir_get_status(&dir, &bridge->status);
+		} else {
+			failures++;
+		}
+
+		ni_sysfs_bridge_get_port_names(bridges.data[i], &ports);
+		for (j = 0; j < ports.count; ++j) {
+			port = ni_bridge_port_new(bridge, ports.data[j], 0);
+			if (ni_sysfs_netif_dir_open(&dir, port->ifname, "brport")) {
+				ni_sysfs_bridge_port_dir_get_config(&dir, port);
+				ni_sysfs_bridge_port_dir_get_status(&dir, &port->status);
+			} else {
+				failures++;
+			}
+		}
+		ni_string_array_destroy(&ports);
+		ni_bridge_free(bridge);
+	}
+	ni_sysfs_dir_close(&dir);
+	return failures;
+}
+
+static unsigned int
+bench_bond(void)
+{
+	unsigned int i, failures = 0;
+	ni_bonding_t *bond;
+
+	for (i = 0; i < bonds.count; ++i) {
+		bond = ni_bonding_new();
+		if (ni_bonding_parse_sysfs_attrs(bonds.data[i], bond) < 0)
+			failures++;
+		ni_bonding_free(bond);
+	}
+	return failures;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int rounds = 100, failures = 0, r;
+	double start;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr,
+				"./sysfs-bench [--rounds N] [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+
+		case OPT_ROUNDS:
+			if (ni_parse_uint(optarg, &rounds, 10) < 0 || !rounds)
+				goto usage;
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (bench_scan()) {
+		fprintf(stderr, "Cannot read /sys/class/net: %m\n");
+		return 1;
+	}
+
+	start = bench_now();
+	for (r = 0; r < rounds; ++r)
+		failures += bench_devinfo();
+	bench_report("devinfo", ndevs * rounds, bench_now() - start);
+
+	start = bench_now();
+	for (r = 0; r < rounds; ++r)
+		failures += bench_bridge();
+	bench_report("bridge", bridges.count * rounds, bench_now() - start);
+
+	start = bench_now();
+	for (r = 0; r < rounds; ++r)
+		failures += bench_bond();
+	bench_report("bond", bonds.count * rounds, bench_now() - start);
+
+	printf("%u interfaces, %u bridges with %u ports, %u bonds, %u rounds:"
+		" %u failures\n", ndevs, bridges.count, nports, bonds.count,
+		rounds, failures);
+
+	ni_string_array_destroy(&bridges);
+	ni_string_array_destroy(&bonds);
+	for (r = 0; r < ndevs; ++r)
+		ni_netdev_put(devs[r]);
+	free(devs);
+	return failures ? 1 : 0;
+}
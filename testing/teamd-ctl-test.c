@@ -0,0 +1,433 @@
+/*
+ * teamd control client test.
+ *
+ * Runs a small stand-in teamd control socket server in a child process,
+ * implementing the ConfigDumpActual, PortConfigDump, PortAdd and
+ * PortConfigUpdate methods of the teamd usock protocol on one team
+ * config, plus a few mock-only methods to read the log of the methods
+ * called by wicked, to remove a port and to drop all connections as a
+ * teamd restart does.
+ *
+ * Checks that the team discovery reuses the cached config, refreshes
+ * the bound ports only, drops the config of a new team device and
+ * reconnects to a restarted teamd.
+ *
+ *	teamd-ctl-test [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/team.h>
+
+#include "teamd.h"
+#include "json.h"
+#include "appconfig.h"
+#include "util_priv.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+
+	{ NULL }
+};
+
+#define MOCK_TEAM		"team0"
+#define MOCK_CLIENTS_MAX	8
+#define MOCK_PACKET_MAX		65536
+
+static const char *	mock_config =
+	"{\"device\": \"team0\","
+	" \"runner\": {\"name\": \"activebackup\"},"
+	" \"link_watch\": {\"name\": \"ethtool\"},"
+	" \"ports\": {\"eth0\": {\"prio\": 10}}}";
+
+/*
+ * stand-in teamd
+ */
+static void
+mock_reply(int fd, const char *result, const char *error)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+	if (error)
+		ni_stringbuf_printf(&buf, "REPLY_ERROR\n%s\nmock error\n", error);
+	else
+		ni_stringbuf_printf(&buf, "REPLY_SUCCESS\n%s", result ? result : "");
+	if (send(fd, buf.string, buf.len, MSG_NOSIGNAL) < 0)
+		ni_error("mock: unable to send reply: %m");
+	ni_stringbuf_destroy(&buf);
+}
+
+static void
+mock_reply_json(int fd, ni_json_t *json)
+{
+	ni_stringbuf_t buf = NI_STRINGBUF_INIT_DYNAMIC;
+
+	ni_json_format_string(&buf, json, NULL);
+	mock_reply(fd, buf.string, NULL);
+	ni_stringbuf_destroy(&buf);
+}
+
+/*
+ * Handles a request, returns FALSE when all connections are to be dropped.
+ */
+static ni_bool_t
+mock_request(ni_json_t *config, ni_stringbuf_t *log, int fd, char *data)
+{
+	ni_json_t *ports, *port;
+	char *method, *arg1, *arg2, *end;
+	char *saveptr = NULL;
+
+	if (strncmp(data, "REQUEST\n", 8)) {
+		mock_reply(fd, NULL, "InvalidMessage");
+		return TRUE;
+	}
+
+	method = data + 8;
+	if ((end = strchr(method, '\n')))
+		*end++ = '\0';
+	arg1 = end ? strtok_r(end, "\n", &saveptr) : NULL;
+	arg2 = arg1 ? strtok_r(NULL, "\n", &saveptr) : NULL;
+
+	if (!strncmp(method, "Mock", 4)) {
+		if (ni_string_eq(method, "MockLog")) {
+			mock_reply(fd, log->string, NULL);
+			ni_stringbuf_truncate(log, 0);
+		} else
+		if (ni_string_eq(method, "MockPortDel") && arg1) {
+			ni_json_object_delete(ni_json_object_get_value(config, "ports"), arg1);
+			mock_reply(fd, NULL, NULL);
+		} else
+		if (ni_string_eq(method, "MockRestart")) {
+			mock_reply(fd, NULL, NULL);
+			return FALSE;
+		} else {
+			mock_reply(fd, NULL, "UnknownMethodName");
+		}
+		return TRUE;
+	}
+
+	if (log->len)
+		ni_stringbuf_putc(log, ',');
+	ni_stringbuf_puts(log, method);
+
+	ports = ni_json_object_get_value(config, "ports");
+	if (ni_string_eq(method, "ConfigDumpActual")) {
+		mock_reply_json(fd, config);
+	} else
+	if (ni_string_eq(method, "PortConfigDump") && arg1) {
+		if ((port = ni_json_object_get_value(ports, arg1)))
+			mock_reply_json(fd, port);
+		else
+			mock_reply(fd, NULL, "NoSuchPort");
+	} else
+	if (ni_string_eq(method, "PortAdd") && arg1) {
+		if (!ni_json_object_get_value(ports, arg1))
+			ni_json_object_set(ports, arg1, ni_json_new_object());
+		mock_reply(fd, NULL, NULL);
+	} else
+	if (ni_string_eq(method, "PortConfigUpdate") && arg1 && arg2) {
+		if (ni_json_object_get_value(ports, arg1) &&
+		    (port = ni_json_parse_string(arg2))) {
+			ni_json_object_set(ports, arg1, port);
+			mock_reply(fd, NULL, NULL);
+		} else {
+			mock_reply(fd, NULL, "InvalidPortConfig");
+		}
+	} else {
+		mock_reply(fd, NULL, "UnknownMethodName");
+	}
+	return TRUE;
+}
+
+static void
+mock_server(int lfd)
+{
+	ni_stringbuf_t log = NI_STRINGBUF_INIT_DYNAMIC;
+	struct pollfd pfd[1 + MOCK_CLIENTS_MAX];
+	unsigned int nclients = 0, i, j;
+	ni_json_t *config;
+	char *data;
+	ssize_t len;
+
+	if (!(config = ni_json_parse_string(mock_config)))
+		ni_fatal("mock: invalid team config");
+	data = xmalloc(MOCK_PACKET_MAX + 1);
+
+	pfd[0].fd = lfd;
+	pfd[0].events = POLLIN;
+	while (TRUE) {
+		for (i = 0; i <= nclients; ++i)
+			pfd[i].revents = 0;
+		if (poll(pfd, 1 + nclients, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ni_fatal("mock: poll: %m");
+		}
+
+		for (i = 1; i <= nclients; ++i) {
+			if (!pfd[i].revents)
+				continue;
+
+			len = recv(pfd[i].fd, data, MOCK_PACKET_MAX, 0);
+			if (len > 0) {
+				data[len] = '\0';
+				if (mock_request(config, &log, pfd[i].fd, data))
+					continue;
+
+				/* restart: drop all connections */
+				for (j = 1; j <= nclients; ++j)
+					close(pfd[j].fd);
+				nclients = 0;
+				break;
+			}
+
+			close(pfd[i].fd);
+			pfd[i] = pfd[nclients--];
+			--i;
+		}
+
+		if ((pfd[0].revents & POLLIN) && nclients < MOCK_CLIENTS_MAX) {
+			int fd;
+
+			if ((fd = accept(lfd, NULL, NULL)) >= 0) {
+				++nclients;
+				pfd[nclients].fd = fd;
+				pfd[nclients].events = POLLIN;
+			}
+		}
+	}
+}
+
+static int
+mock_listen(const char *path)
+{
+	struct sockaddr_un sun;
+	int fd;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if ((size_t)snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path) >= sizeof(sun.sun_path))
+		ni_fatal("Mock socket path %s too long", path);
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+		ni_fatal("Cannot create mock socket: %m");
+	if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+		ni_fatal("Cannot bind mock socket %s: %m", path);
+	if (listen(fd, MOCK_CLIENTS_MAX) < 0)
+		ni_fatal("Cannot listen on mock socket: %m");
+	return fd;
+}
+
+/*
+ * Calls a mock-only method over a connection of its own.
+ */
+static const char *
+mock_call(const char *path, const char *method, const char *arg)
+{
+	static char reply[MOCK_PACKET_MAX + 1];
+	struct sockaddr_un sun;
+	char req[256];
+	ssize_t len;
+	int fd;
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	reply[0] = '\0';
+	if ((size_t)snprintf(sun.sun_path, sizeof(sun.sun_path), "%s", path) >= sizeof(sun.sun_path))
+		return reply;
+
+	snprintf(req, sizeof(req), "REQUEST\n%s\n%s%s", method,
+			arg ? arg : "", arg ? "\n" : "");
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET, 0)) < 0)
+		return reply;
+	if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0 &&
+	    send(fd, req, strlen(req), 0) > 0 &&
+	    (len = recv(fd, reply, MOCK_PACKET_MAX, 0)) > 0)
+		reply[len] = '\0';
+	close(fd);
+
+	/* the log only, without the REPLY_SUCCESS line */
+	if (!strncmp(reply, "REPLY_SUCCESS\n", 14))
+		return reply + 14;
+	return reply;
+}
+
+/*
+ * checks
+ */
+static ni_bool_t
+check_log(const char *path, const char *expected, const char *what)
+{
+	const char *log = mock_call(path, "MockLog", NULL);
+	ni_bool_t ok = ni_string_eq(log, expected);
+
+	if (!ok)
+		printf("  requests: \"%s\", expected \"%s\"\n", log, expected);
+	check(ok, what);
+	return ok;
+}
+
+static int
+port_prio(ni_netdev_t *dev, const char *name)
+{
+	ni_team_port_t *port;
+
+	if (!dev->team || !(port = ni_team_port_array_find_by_name(&dev->team->ports, name)))
+		return -1;
+	return port->config.ab.prio;
+}
+
+static void
+check_discover(const char *path, ni_netdev_t *dev)
+{
+	check(ni_teamd_discover(dev) == 0, "discover team0");
+	check_log(path, "ConfigDumpActual", "first discovery dumps the config");
+	check(dev->team && dev->team->ports.count == 1 && port_prio(dev, "eth0") == 10,
+			"team0 has port eth0 with prio 10");
+
+	check(ni_teamd_discover(dev) == 0, "discover team0 again");
+	check_log(path, "", "cached config is reused");
+	check(dev->team && dev->team->ports.count == 1, "team0 still has one port");
+}
+
+static void
+check_ports(const char *path, ni_netdev_t *dev)
+{
+	ni_team_port_config_t config;
+	ni_netdev_t *eth1;
+
+	memset(&config, 0, sizeof(config));
+	config.ab.prio = 5;
+	eth1 = ni_netdev_new("eth1", 3);
+
+	check(ni_teamd_port_enslave(dev, eth1, &config) == 0, "enslave eth1 with prio 5");
+	check_log(path, "PortAdd,PortConfigUpdate", "enslave adds and configures the port");
+
+	ni_teamd_port_bind(dev, "eth1");
+	check(dev->team->ports.count == 2, "bind adds eth1 to team0");
+	check_log(path, "", "bind sends no requests");
+
+	check(ni_teamd_discover(dev) == 0, "discover team0 after bind");
+	check_log(path, "PortConfigDump", "bound port config is dumped only");
+	check(port_prio(dev, "eth1") == 5, "eth1 has prio 5");
+	check(port_prio(dev, "eth0") == 10, "eth0 still has prio 10");
+
+	mock_call(path, "MockPortDel", "eth1");
+	ni_teamd_port_unbind(dev, "eth1");
+	check(dev->team->ports.count == 1 && port_prio(dev, "eth1") == -1,
+			"unbind removes eth1 from team0");
+	check(ni_teamd_discover(dev) == 0, "discover team0 after unbind");
+	check_log(path, "", "unbind sends no requests");
+	check(dev->team->ports.count == 1 && port_prio(dev, "eth1") == -1,
+			"eth1 is not in the cached config");
+
+	ni_netdev_put(eth1);
+}
+
+static void
+check_invalidate(const char *path, ni_netdev_t *dev)
+{
+	dev->link.ifindex++;
+	check(ni_teamd_discover(dev) == 0, "discover new team0 device");
+	check_log(path, "ConfigDumpActual", "new team device dumps the config");
+
+	mock_call(path, "MockRestart", NULL);
+	check(ni_teamd_discover(dev) == 0, "discover team0 after teamd restart");
+	check_log(path, "", "cached config is reused until a request");
+
+	ni_teamd_port_bind(dev, "eth2");
+	mock_call(path, "MockRestart", NULL);
+	check(ni_teamd_discover(dev) == 0, "discover team0 after bind and teamd restart");
+	check_log(path, "PortConfigDump,ConfigDumpActual",
+			"reconnect drops the cached config");
+	check(dev->team->ports.count == 1 && port_prio(dev, "eth2") == -1,
+			"team0 ports are the ones of teamd");
+
+	ni_teamd_client_release(dev->name);
+	check(ni_teamd_discover(dev) == 0, "discover team0 after release");
+	check_log(path, "ConfigDumpActual", "release drops the cached config");
+}
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/teamd-ctl-test.XXXXXX";
+	char path[PATH_MAX];
+	ni_netdev_t *dev;
+	pid_t pid;
+	int c, fd;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./teamd-ctl-test [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	snprintf(path, sizeof(path), "%s/%s.sock", template, MOCK_TEAM);
+
+	fd = mock_listen(path);
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork server: %m");
+	if (pid == 0)
+		mock_server(fd);
+	close(fd);
+
+	ni_global.config = ni_config_new();
+	ni_config_teamd_enable(NI_CONFIG_TEAMD_CTL_UNIX);
+	ni_string_dup(&ni_global.config->teamd.usock_dir, template);
+
+	dev = ni_netdev_new(MOCK_TEAM, 7);
+	dev->link.type = NI_IFTYPE_TEAM;
+
+	check_discover(path, dev);
+	check_ports(path, dev);
+	check_invalidate(path, dev);
+
+	ni_teamd_client_release(dev->name);
+	ni_netdev_put(dev);
+	ni_config_free(ni_global.config);
+	ni_global.config = NULL;
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}
@@ -0,0 +1,94 @@
+/*
+ * Helpers shared by the test and benchmark programs.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+
+#include "test-util.h"
+
+unsigned int		test_failures;
+
+/*
+ * Prints the result of a check, counting the failed ones.
+ */
+void
+check(ni_bool_t ok, const char *what)
+{
+	printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+	if (!ok)
+		test_failures++;
+}
+
+/*
+ * Prints the number of failures, returns the exit code of the test.
+ */
+int
+test_summary(void)
+{
+	printf("%u failures\n", test_failures);
+	return test_failures ? 1 : 0;
+}
+
+int
+test_write_file(const char *path, const char *data)
+{
+	FILE *fp;
+	int ret;
+
+	if (!(fp = fopen(path, "w")))
+		return -1;
+	ret = fputs(data, fp) < 0 ? -1 : 0;
+	if (fclose(fp) < 0)
+		ret = -1;
+	return ret;
+}
+
+/*
+ * Enters a private mount and network namespace, using an unprivileged
+ * user namespace mapping the current user to root when needed.
+ */
+int
+test_enter_namespace(void)
+{
+	char map[64];
+	uid_t uid = getuid();
+	gid_t gid = getgid();
+
+	if (unshare(CLONE_NEWNS | CLONE_NEWNET) == 0)
+		return 0;
+	if (errno != EPERM)
+		return -1;
+
+	if (unshare(CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWNET) < 0)
+		return -1;
+
+	snprintf(map, sizeof(map), "0 %u 1\n", uid);
+	if (test_write_file("/proc/self/uid_map", map) < 0)
+		return -1;
+	test_write_file("/proc/self/setgroups", "deny\n");
+	snprintf(map, sizeof(map), "0 %u 1\n", gid);
+	return test_write_file("/proc/self/gid_map", map);
+}
+
+double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+bench_report(const char *what, unsigned int count, double elapsed)
+{
+	printf("%-8s %8u in %8.3fs: %10.0f/sec\n", what, count,
+			elapsed, elapsed > 0 ? count / elapsed : 0.0);
+}
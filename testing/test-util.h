@@ -0,0 +1,20 @@
+/*
+ * Helpers shared by the test and benchmark programs.
+ */
+#ifndef WICKED_TESTING_TEST_UTIL_H
+#define WICKED_TESTING_TEST_UTIL_H
+
+#include <wicked/types.h>
+
+extern unsigned int	test_failures;
+
+extern void		check(ni_bool_t, const char *);
+extern int		test_summary(void);
+
+extern int		test_write_file(const char *, const char *);
+extern int		test_enter_namespace(void);
+
+extern double		bench_now(void);
+extern void		bench_report(const char *, unsigned int, double);
+
+#endif /* WICKED_TESTING_TEST_UTIL_H */
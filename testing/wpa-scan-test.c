@@ -0,0 +1,524 @@
+/*
+ * wpa_supplicant scan results test.
+ *
+ * Starts a private dbus-daemon as system bus and a small stand-in
+ * wpa_supplicant in a child process on it, implementing the getInterface,
+ * state, capabilities, scan and scanResults methods of the legacy
+ * fi.epitest.hostap interface and the properties method of its BSS
+ * objects, plus a few mock-only methods to set the BSSes in range and
+ * to read the number of BSS properties calls.
+ *
+ * Checks that the properties of the BSSes are retrieved once, with a
+ * bounded number of calls in flight, and that a rescan reports changes
+ * only when a BSS appeared or disappeared.
+ *
+ *	wpa-scan-test [--debug FACILITY]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <dbus/dbus.h>
+
+#include <wicked/util.h>
+#include <wicked/logging.h>
+#include <wicked/netinfo.h>
+#include <wicked/wireless.h>
+#include <wicked/socket.h>
+#include <wicked/dbus.h>
+
+#include "wpa-supplicant.h"
+#include "util_priv.h"
+#include "test-util.h"
+
+enum {
+	OPT_DEBUG,
+};
+
+static struct option	options[] = {
+	{ "debug",		required_argument,	NULL,	OPT_DEBUG },
+
+	{ NULL }
+};
+
+#define MOCK_BUS_NAME		"fi.epitest.hostap.WPASupplicant"
+#define MOCK_OBJECT_PATH	"/fi/epitest/hostap/WPASupplicant"
+#define MOCK_IF_PATH		"/fi/epitest/hostap/WPASupplicant/Interfaces/1"
+#define MOCK_IF_INTERFACE	"fi.epitest.hostap.WPASupplicant.Interface"
+#define MOCK_BSS_PATH_PFX	MOCK_IF_PATH "/BSSIDs/"
+#define MOCK_TEST_INTERFACE	"org.opensuse.Network.WpaScanTest"
+#define MOCK_IFNAME		"wlan0"
+#define MOCK_BSS_MAX		64
+#define MOCK_SCAN_TIMEOUT	10000	/* msec */
+
+static const char *	mock_bus_config =
+	"<!DOCTYPE busconfig PUBLIC \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\"\n"
+	" \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+	"<busconfig>\n"
+	"  <type>system</type>\n"
+	"  <listen>unix:path=%s/bus</listen>\n"
+	"  <auth>EXTERNAL</auth>\n"
+	"  <policy context=\"default\">\n"
+	"    <allow user=\"*\"/>\n"
+	"    <allow own=\"*\"/>\n"
+	"    <allow send_destination=\"*\"/>\n"
+	"    <allow receive_sender=\"*\"/>\n"
+	"  </policy>\n"
+	"</busconfig>\n";
+
+/*
+ * private system bus
+ */
+static pid_t
+mock_bus_start(const char *dir)
+{
+	char config[PATH_MAX], confarg[PATH_MAX + 16], address[PATH_MAX], fdarg[32];
+	int pfd[2];
+	ssize_t len;
+	FILE *fp;
+	pid_t pid;
+
+	snprintf(config, sizeof(config), "%s/bus.conf", dir);
+	if (!(fp = fopen(config, "w")))
+		ni_fatal("Cannot create %s: %m", config);
+	fprintf(fp, mock_bus_config, dir);
+	fclose(fp);
+
+	if (pipe(pfd) < 0)
+		ni_fatal("Cannot create pipe: %m");
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork dbus-daemon: %m");
+	if (pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		close(pfd[0]);
+		snprintf(fdarg, sizeof(fdarg), "--print-address=%d", pfd[1]);
+		snprintf(confarg, sizeof(confarg), "--config-file=%s", config);
+		execlp("dbus-daemon", "dbus-daemon", "--nofork", confarg, fdarg, NULL);
+		ni_error("Cannot execute dbus-daemon: %m");
+		_exit(127);
+	}
+	close(pfd[1]);
+
+	len = read(pfd[0], address, sizeof(address) - 1);
+	close(pfd[0]);
+	if (len <= 0)
+		ni_fatal("dbus-daemon did not report its address");
+	address[len] = '\0';
+	address[strcspn(address, "\n")] = '\0';
+
+	setenv("DBUS_SYSTEM_BUS_ADDRESS", address, 1);
+	return pid;
+}
+
+/*
+ * stand-in wpa_supplicant
+ */
+static unsigned int	mock_bss[MOCK_BSS_MAX];
+static unsigned int	mock_bss_count;
+static unsigned int	mock_properties_calls;
+
+static void
+mock_bss_set(const char *list)
+{
+	char *copy = NULL, *s, *saveptr = NULL;
+
+	mock_bss_count = 0;
+	ni_string_dup(&copy, list);
+	for (s = strtok_r(copy, ",", &saveptr); s; s = strtok_r(NULL, ",", &saveptr)) {
+		if (mock_bss_count < MOCK_BSS_MAX)
+			mock_bss[mock_bss_count++] = strtoul(s, NULL, 16);
+	}
+	ni_string_free(&copy);
+}
+
+static void
+mock_dict_append(DBusMessageIter *dict, const char *key, int type, const void *value)
+{
+	DBusMessageIter entry, var, array;
+	char signature[3] = { DBUS_TYPE_ARRAY, DBUS_TYPE_BYTE, '\0' };
+
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, &entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &key);
+	if (type == DBUS_TYPE_ARRAY) {
+		const ni_opaque_t *data = value;
+		const unsigned char *ptr = data->data;
+
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, signature, &var);
+		dbus_message_iter_open_container(&var, DBUS_TYPE_ARRAY,
+				DBUS_TYPE_BYTE_AS_STRING, &array);
+		dbus_message_iter_append_fixed_array(&array, DBUS_TYPE_BYTE, &ptr, data->len);
+		dbus_message_iter_close_container(&var, &array);
+	} else {
+		signature[0] = type;
+		signature[1] = '\0';
+		dbus_message_iter_open_container(&entry, DBUS_TYPE_VARIANT, signature, &var);
+		dbus_message_iter_append_basic(&var, type, value);
+	}
+	dbus_message_iter_close_container(&entry, &var);
+	dbus_message_iter_close_container(dict, &entry);
+}
+
+static DBusMessage *
+mock_bss_properties(DBusMessage *call, unsigned int id)
+{
+	DBusMessageIter iter, dict;
+	DBusMessage *reply;
+	ni_opaque_t bssid, ssid;
+	dbus_int32_t frequency = 2412, level = -40, quality = 70, noise = -90;
+	dbus_int32_t maxrate = 54000000;
+	dbus_uint16_t capabilities = 0x0401;
+
+	bssid.len = 6;
+	memcpy(bssid.data, "\x02\x00\x00\x00\x00", 5);
+	bssid.data[5] = id;
+	ssid.len = snprintf((char *) ssid.data, sizeof(ssid.data), "mock-%02x", id);
+
+	reply = dbus_message_new_method_return(call);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+			DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+			DBUS_TYPE_STRING_AS_STRING
+			DBUS_TYPE_VARIANT_AS_STRING
+			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
+	mock_dict_append(&dict, "bssid", DBUS_TYPE_ARRAY, &bssid);
+	mock_dict_append(&dict, "ssid", DBUS_TYPE_ARRAY, &ssid);
+	mock_dict_append(&dict, "frequency", DBUS_TYPE_INT32, &frequency);
+	mock_dict_append(&dict, "level", DBUS_TYPE_INT32, &level);
+	mock_dict_append(&dict, "quality", DBUS_TYPE_INT32, &quality);
+	mock_dict_append(&dict, "noise", DBUS_TYPE_INT32, &noise);
+	mock_dict_append(&dict, "maxrate", DBUS_TYPE_INT32, &maxrate);
+	mock_dict_append(&dict, "capabilities", DBUS_TYPE_UINT16, &capabilities);
+	dbus_message_iter_close_container(&iter, &dict);
+	return reply;
+}
+
+static DBusMessage *
+mock_scan_results(DBusMessage *call)
+{
+	char paths[MOCK_BSS_MAX][sizeof(MOCK_BSS_PATH_PFX) + 16];
+	const char *ptrs[MOCK_BSS_MAX], **array = ptrs;
+	DBusMessage *reply;
+	unsigned int i;
+
+	for (i = 0; i < mock_bss_count; ++i) {
+		snprintf(paths[i], sizeof(paths[i]), MOCK_BSS_PATH_PFX "0200000000%02x", mock_bss[i]);
+		ptrs[i] = paths[i];
+	}
+
+	reply = dbus_message_new_method_return(call);
+	dbus_message_append_args(reply, DBUS_TYPE_ARRAY, DBUS_TYPE_OBJECT_PATH,
+			&array, mock_bss_count, DBUS_TYPE_INVALID);
+	return reply;
+}
+
+static DBusMessage *
+mock_empty_dict(DBusMessage *call)
+{
+	DBusMessageIter iter, dict;
+	DBusMessage *reply;
+
+	reply = dbus_message_new_method_return(call);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+	dbus_message_iter_close_container(&iter, &dict);
+	return reply;
+}
+
+static DBusMessage *
+mock_handle(DBusConnection *conn, DBusMessage *call)
+{
+	const char *path = dbus_message_get_path(call);
+	const char *member = dbus_message_get_member(call);
+	DBusMessage *reply = NULL, *signal;
+	const char *str;
+	dbus_uint32_t value;
+
+	if (!strcmp(member, "MockSetBSS")) {
+		if (dbus_message_get_args(call, NULL, DBUS_TYPE_STRING, &str, DBUS_TYPE_INVALID))
+			mock_bss_set(str);
+		reply = dbus_message_new_method_return(call);
+	} else
+	if (!strcmp(member, "MockLog")) {
+		value = mock_properties_calls;
+		mock_properties_calls = 0;
+		reply = dbus_message_new_method_return(call);
+		dbus_message_append_args(reply, DBUS_TYPE_UINT32, &value, DBUS_TYPE_INVALID);
+	} else
+	if (!strcmp(path, MOCK_OBJECT_PATH) && !strcmp(member, "getInterface")) {
+		str = MOCK_IF_PATH;
+		reply = dbus_message_new_method_return(call);
+		dbus_message_append_args(reply, DBUS_TYPE_OBJECT_PATH, &str, DBUS_TYPE_INVALID);
+	} else
+	if (!strcmp(path, MOCK_IF_PATH) && !strcmp(member, "state")) {
+		str = "DISCONNECTED";
+		reply = dbus_message_new_method_return(call);
+		dbus_message_append_args(reply, DBUS_TYPE_STRING, &str, DBUS_TYPE_INVALID);
+	} else
+	if (!strcmp(path, MOCK_IF_PATH) && !strcmp(member, "capabilities")) {
+		reply = mock_empty_dict(call);
+	} else
+	if (!strcmp(path, MOCK_IF_PATH) && !strcmp(member, "scan")) {
+		value = 0;
+		reply = dbus_message_new_method_return(call);
+		dbus_message_append_args(reply, DBUS_TYPE_UINT32, &value, DBUS_TYPE_INVALID);
+		dbus_connection_send(conn, reply, NULL);
+		dbus_message_unref(reply);
+
+		signal = dbus_message_new_signal(MOCK_IF_PATH, MOCK_IF_INTERFACE,
+						"ScanResultsAvailable");
+		dbus_connection_send(conn, signal, NULL);
+		dbus_message_unref(signal);
+		return NULL;
+	} else
+	if (!strcmp(path, MOCK_IF_PATH) && !strcmp(member, "scanResults")) {
+		reply = mock_scan_results(call);
+	} else
+	if (!strncmp(path, MOCK_BSS_PATH_PFX, sizeof(MOCK_BSS_PATH_PFX) - 1) &&
+	    !strcmp(member, "properties")) {
+		mock_properties_calls++;
+		value = strtoul(path + strlen(path) - 2, NULL, 16);
+		reply = mock_bss_properties(call, value);
+	} else {
+		reply = dbus_message_new_error(call, DBUS_ERROR_UNKNOWN_METHOD, member);
+	}
+	return reply;
+}
+
+static void
+mock_server(int ready)
+{
+	DBusConnection *conn;
+	DBusMessage *msg, *reply;
+	DBusError error = DBUS_ERROR_INIT;
+
+	if (!(conn = dbus_bus_get_private(DBUS_BUS_SYSTEM, &error))) {
+		ni_error("mock: cannot connect to bus: %s", error.message);
+		_exit(1);
+	}
+	if (dbus_bus_request_name(conn, MOCK_BUS_NAME, DBUS_NAME_FLAG_DO_NOT_QUEUE, &error) !=
+			DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+		ni_error("mock: cannot own %s: %s", MOCK_BUS_NAME, error.message);
+		_exit(1);
+	}
+	if (write(ready, "", 1) < 0)
+		_exit(1);
+	close(ready);
+
+	while (dbus_connection_read_write(conn, -1)) {
+		while ((msg = dbus_connection_pop_message(conn)) != NULL) {
+			if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_METHOD_CALL &&
+			    (reply = mock_handle(conn, msg)) != NULL) {
+				dbus_connection_send(conn, reply, NULL);
+				dbus_message_unref(reply);
+			}
+			dbus_message_unref(msg);
+		}
+	}
+	_exit(0);
+}
+
+/*
+ * test client side
+ */
+static ni_dbus_class_t	mock_class = {
+	.name		= "wpa-scan-test",
+};
+
+static unsigned int
+mock_call(ni_dbus_object_t *mock, const char *method, const char *arg)
+{
+	dbus_uint32_t value = 0;
+
+	if (arg) {
+		if (ni_dbus_object_call_simple(mock, MOCK_TEST_INTERFACE, method,
+					DBUS_TYPE_STRING, &arg, DBUS_TYPE_INVALID, NULL) < 0)
+			ni_fatal("mock %s call failed", method);
+	} else {
+		if (ni_dbus_object_call_simple(mock, MOCK_TEST_INTERFACE, method,
+					DBUS_TYPE_INVALID, NULL, DBUS_TYPE_UINT32, &value) < 0)
+			ni_fatal("mock %s call failed", method);
+	}
+	return value;
+}
+
+/*
+ * checks
+ */
+static ni_bool_t
+check_calls(ni_dbus_object_t *mock, unsigned int expected, const char *what)
+{
+	unsigned int calls = mock_call(mock, "MockLog", NULL);
+	ni_bool_t ok = calls == expected;
+
+	if (!ok)
+		printf("  properties calls: %u, expected %u\n", calls, expected);
+	check(ok, what);
+	return ok;
+}
+
+/*
+ * Request a scan and run the main loop until the BSS properties are in
+ */
+static unsigned int
+scan(ni_wpa_interface_t *wpa_dev, ni_wireless_scan_t *scan)
+{
+	unsigned int max_requests = 0;
+	struct timeval start, now;
+
+	if (ni_wpa_interface_request_scan(wpa_dev, scan) < 0)
+		ni_fatal("scan request failed");
+
+	ni_timer_get_time(&start);
+	while (ni_wpa_interface_scan_in_progress(wpa_dev)) {
+		ni_socket_wait(100);
+		if (wpa_dev->scan.requests > max_requests)
+			max_requests = wpa_dev->scan.requests;
+
+		ni_timer_get_time(&now);
+		if ((now.tv_sec - start.tv_sec) * 1000 > MOCK_SCAN_TIMEOUT)
+			ni_fatal("scan timed out");
+	}
+	return max_requests;
+}
+
+static ni_bool_t
+scan_has_bss(const ni_wireless_scan_t *scan, unsigned int id)
+{
+	unsigned int i;
+
+	for (i = 0; i < scan->networks.count; ++i) {
+		const ni_hwaddr_t *ap = &scan->networks.data[i]->access_point;
+
+		if (ap->len == 6 && ap->data[5] == id)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+check_scan(ni_wpa_interface_t *wpa_dev, ni_dbus_object_t *mock)
+{
+	ni_wireless_scan_t result;
+	unsigned int max_requests;
+	char list[MOCK_BSS_MAX * 3];
+	unsigned int i;
+
+	memset(&result, 0, sizeof(result));
+	result.interval = 60;
+
+	*list = '\0';
+	for (i = 1; i <= 20; ++i)
+		snprintf(list + strlen(list), sizeof(list) - strlen(list), "%s%02x", i > 1 ? "," : "", i);
+	mock_call(mock, "MockSetBSS", list);
+
+	max_requests = scan(wpa_dev, &result);
+	check_calls(mock, 20, "first scan retrieves the properties of all BSSes");
+	check(max_requests > 0 && max_requests <= 8, "at most 8 properties calls in flight");
+	check(ni_wpa_interface_retrieve_scan(wpa_dev, &result), "first scan reports a change");
+	check(result.networks.count == 20, "first scan has 20 BSSes");
+
+	scan(wpa_dev, &result);
+	check_calls(mock, 0, "rescan does not retrieve known BSSes");
+	check(!ni_wpa_interface_retrieve_scan(wpa_dev, &result), "rescan reports no change");
+	check(result.networks.count == 20, "rescan has 20 BSSes");
+
+	/* drop BSS 01, add BSS 15 */
+	*list = '\0';
+	for (i = 2; i <= 21; ++i)
+		snprintf(list + strlen(list), sizeof(list) - strlen(list), "%s%02x", i > 2 ? "," : "", i);
+	mock_call(mock, "MockSetBSS", list);
+
+	scan(wpa_dev, &result);
+	check_calls(mock, 1, "rescan retrieves the new BSS only");
+	check(ni_wpa_interface_retrieve_scan(wpa_dev, &result), "rescan reports the change");
+	check(result.networks.count == 20 && scan_has_bss(&result, 0x15) &&
+		!scan_has_bss(&result, 0x01), "rescan replaced BSS 01 by 15");
+
+	ni_wireless_network_array_destroy(&result.networks);
+}
+
+int
+main(int argc, char **argv)
+{
+	char template[] = "/tmp/wpa-scan-test.XXXXXX";
+	ni_wpa_client_t *wpa;
+	ni_wpa_interface_t *wpa_dev;
+	ni_dbus_object_t *mock;
+	ni_netdev_t *dev;
+	pid_t bus, pid;
+	int c, pfd[2];
+	char ready;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != EOF) {
+		switch (c) {
+		default:
+		usage:
+			fprintf(stderr, "./wpa-scan-test [--debug FACILITY]\n");
+			return 1;
+
+		case OPT_DEBUG:
+			if (ni_enable_debug(optarg) < 0) {
+				fprintf(stderr, "Bad debug facility \"%s\"\n", optarg);
+				return 1;
+			}
+			break;
+		}
+	}
+	if (optind < argc)
+		goto usage;
+
+	if (ni_init("wpa-scan-test") < 0)
+		return 1;
+
+	if (!mkdtemp(template))
+		ni_fatal("Cannot create temporary directory: %m");
+	bus = mock_bus_start(template);
+
+	if (pipe(pfd) < 0)
+		ni_fatal("Cannot create pipe: %m");
+	if ((pid = fork()) < 0)
+		ni_fatal("Cannot fork server: %m");
+	if (pid == 0) {
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+		close(pfd[0]);
+		mock_server(pfd[1]);
+	}
+	close(pfd[1]);
+	if (read(pfd[0], &ready, 1) != 1)
+		ni_fatal("mock wpa_supplicant did not start");
+	close(pfd[0]);
+
+	if (!(wpa = ni_wpa_client_open()))
+		ni_fatal("Cannot open wpa_supplicant client");
+	mock = ni_dbus_client_object_new(ni_wpa_client_dbus(wpa), &mock_class,
+			MOCK_OBJECT_PATH, MOCK_TEST_INTERFACE, NULL);
+
+	dev = ni_netdev_new(MOCK_IFNAME, 3);
+	dev->link.type = NI_IFTYPE_WIRELESS;
+	if (!(wpa_dev = ni_wpa_interface_bind(wpa, dev)))
+		ni_fatal("Cannot bind %s", MOCK_IFNAME);
+
+	check_scan(wpa_dev, mock);
+
+	ni_dbus_object_free(mock);
+	ni_wpa_client_free(wpa);
+	ni_netdev_put(dev);
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	kill(bus, SIGTERM);
+	waitpid(bus, NULL, 0);
+	ni_file_remove_recursively(template);
+
+	return test_summary();
+}